@@ -196,6 +196,18 @@
 #endif
 
 
+/**
+ * Use resizable hash tables (see pj_hash_create_resizable()) for the
+ * resolver's response cache and pending query tables, so that they don't
+ * degrade when there are many more entries than the initial table size.
+ *
+ * default: 1
+ */
+#ifndef PJ_DNS_RESOLVER_RESIZABLE_HTABLE
+#   define PJ_DNS_RESOLVER_RESIZABLE_HTABLE	    1
+#endif
+
+
 /* **************************************************************************
  * SCANNER CONFIGURATION
  */
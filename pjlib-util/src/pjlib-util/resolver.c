@@ -352,12 +352,21 @@ PJ_DEF(pj_status_t) pj_dns_resolver_create( pj_pool_factory *pf,
 	    goto on_error;
     }
 
+#if PJ_DNS_RESOLVER_RESIZABLE_HTABLE
+    /* Response cache hash table */
+    resv->hrescache = pj_hash_create_resizable(pool, RES_HASH_TABLE_SIZE);
+
+    /* Query hash table and free list. */
+    resv->hquerybyid = pj_hash_create_resizable(pool, Q_HASH_TABLE_SIZE);
+    resv->hquerybyres = pj_hash_create_resizable(pool, Q_HASH_TABLE_SIZE);
+#else
     /* Response cache hash table */
     resv->hrescache = pj_hash_create(pool, RES_HASH_TABLE_SIZE);
 
     /* Query hash table and free list. */
     resv->hquerybyid = pj_hash_create(pool, Q_HASH_TABLE_SIZE);
     resv->hquerybyres = pj_hash_create(pool, Q_HASH_TABLE_SIZE);
+#endif
     pj_list_init(&resv->query_free_nodes);
 
     /* Initialize the UDP socket */
@@ -50,6 +50,13 @@ PJ_BEGIN_DECL
  */
 typedef struct pj_activesock_t pj_activesock_t;
 
+/**
+ * This opaque structure describes a reference counted receive buffer that
+ * is lent by the active socket to the application, see the
+ * \a on_data_read_buf() callback.
+ */
+typedef struct pj_activesock_buf pj_activesock_buf;
+
 /**
  * This structure contains the callbacks to be called by the active socket.
  */
@@ -189,6 +196,99 @@ typedef struct pj_activesock_cb
     pj_bool_t (*on_connect_complete)(pj_activesock_t *asock,
 				     pj_status_t status);
 
+    /**
+     * This callback is called when one or more packets arrive as the
+     * result of pj_activesock_start_recvfrom(). When this callback is
+     * set, it is called instead of \a on_data_recvfrom(), and the active
+     * socket will try to read up to \a batch_cnt packets (see
+     * #pj_activesock_cfg) from the socket on each read completion using
+     * #pj_sock_recvmmsg(), so that the packets are delivered to
+     * application with a single callback.
+     *
+     * The buffers in the packet array are owned by the active socket and
+     * are only valid for the duration of the callback.
+     *
+     * @param asock	The active socket.
+     * @param pkt	Array of packets, each containing the packet buffer,
+     *			the packet length, and the source address.
+     * @param count	Number of packets in the array. If the status
+     *			argument is non-PJ_SUCCESS, this will be zero.
+     * @param status	The status of the read operation.
+     *
+     * @return		PJ_TRUE if further read is desired, and PJ_FALSE 
+     *			when application no longer wants to receive data.
+     *			Application may destroy the active socket in the
+     *			callback and return PJ_FALSE here.
+     */
+    pj_bool_t (*on_data_recvfrom_batch)(pj_activesock_t *asock,
+					const pj_sock_msg pkt[],
+					unsigned count,
+					pj_status_t status);
+
+    /**
+     * This callback is called instead of \a on_data_read() when data
+     * arrives as the result of pj_activesock_start_read(), and enables the
+     * buffer lending mode. In this mode the active socket reads into
+     * reference counted buffers taken from its own buffer pool, and hands
+     * each buffer over to the application instead of reusing it, so the
+     * application may keep the data beyond the callback without copying
+     * it, for example in a reassembly queue.
+     *
+     * The callback owns one reference to the buffer and must release it
+     * with #pj_activesock_buf_dec_ref() once it no longer needs the data,
+     * either before returning or later. Since the buffer is not reused,
+     * there is no remainder: data that can't be processed yet is kept by
+     * keeping the buffer. The buffers stay valid after the active socket
+     * is closed, until they are released.
+     *
+     * @param asock	The active socket.
+     * @param buf	The buffer, or NULL if the status argument is
+     *			non-PJ_SUCCESS.
+     * @param data	The data, at the start of the buffer.
+     * @param size	The length of the data.
+     * @param status	The status of the read operation, for example
+     *			PJ_EEOF when the connection has been closed.
+     *
+     * @return		PJ_TRUE if further read is desired, and PJ_FALSE 
+     *			when application no longer wants to receive data.
+     *			Application may destroy the active socket in the
+     *			callback and return PJ_FALSE here.
+     */
+    pj_bool_t (*on_data_read_buf)(pj_activesock_t *asock,
+				  pj_activesock_buf *buf,
+				  void *data,
+				  pj_size_t size,
+				  pj_status_t status);
+
+    /**
+     * This callback is called instead of \a on_data_recvfrom() when a
+     * packet arrives as the result of pj_activesock_start_recvfrom(), and
+     * enables the buffer lending mode for datagram sockets. See
+     * \a on_data_read_buf() for the buffer ownership rules. When this
+     * callback is set, \a on_data_recvfrom_batch() is not used.
+     *
+     * @param asock	The active socket.
+     * @param buf	The buffer containing the packet, or NULL if the
+     *			status argument is non-PJ_SUCCESS.
+     * @param data	The packet, at the start of the buffer.
+     * @param size	The length of the packet.
+     * @param src_addr	Source address of the packet.
+     * @param addr_len	Length of the source address.
+     * @param status	The status of the read operation.
+     *
+     * @return		PJ_TRUE if further read is desired, and PJ_FALSE 
+     *			when application no longer wants to receive data.
+     *			Application may destroy the active socket in the
+     *			callback and return PJ_FALSE here.
+     */
+    pj_bool_t (*on_data_recvfrom_buf)(pj_activesock_t *asock,
+				      pj_activesock_buf *buf,
+				      void *data,
+				      pj_size_t size,
+				      const pj_sockaddr_t *src_addr,
+				      int addr_len,
+				      pj_status_t status);
+
 } pj_activesock_cb;
 
 
@@ -247,6 +347,18 @@ typedef struct pj_activesock_cfg
      */
     pj_bool_t whole_data;
 
+    /**
+     * Maximum number of packets to be delivered in one
+     * \a on_data_recvfrom_batch() callback. This setting is only used
+     * for datagram sockets when the \a on_data_recvfrom_batch() callback
+     * is set, and in that case the active socket will allocate
+     * (batch_cnt - 1) additional packet buffers for each asynchronous
+     * read operation.
+     *
+     * The default value is PJ_ACTIVESOCK_RECV_BATCH.
+     */
+    unsigned batch_cnt;
+
 } pj_activesock_cfg;
 
 
@@ -424,6 +536,10 @@ PJ_DECL(pj_status_t) pj_activesock_start_read(pj_activesock_t *asock,
  * supplies the buffers for the read operation so that the acive socket
  * does not have to allocate the buffers.
  *
+ * In the buffer lending mode (see \a on_data_read_buf()), the buffers
+ * are allocated from a pool that the active socket creates with the
+ * factory of \a pool, and \a readbuf is ignored and may be NULL.
+ *
  * @param asock	    The active socket.
  * @param pool	    Pool used to allocate buffers for incoming data.
  * @param buff_size The size of each buffer, in bytes.
@@ -462,6 +578,10 @@ PJ_DECL(pj_status_t) pj_activesock_start_recvfrom(pj_activesock_t *asock,
  * operation takes the buffer from the argument rather than creating
  * new ones.
  *
+ * In the buffer lending mode (see \a on_data_recvfrom_buf()), the
+ * buffers are allocated from a pool that the active socket creates with
+ * the factory of \a pool, and \a readbuf is ignored and may be NULL.
+ *
  * @param asock	    The active socket.
  * @param pool	    Pool used to allocate buffers for incoming data.
  * @param buff_size The size of each buffer, in bytes.
@@ -477,6 +597,55 @@ PJ_DECL(pj_status_t) pj_activesock_start_recvfrom2(pj_activesock_t *asock,
 						   void *readbuf[],
 						   pj_uint32_t flags);
 
+/**
+ * Stop issuing further read operations on this active socket until
+ * #pj_activesock_resume_read() is called. This is typically called from
+ * the read callback when the data must be processed by another thread
+ * before more data is wanted. The read operations that are already
+ * pending are not cancelled, and their data will still be reported.
+ *
+ * @param asock	    The active socket.
+ *
+ * @return	    PJ_SUCCESS if the operation has been successful,
+ *		    or the appropriate error code on failure.
+ */
+PJ_DECL(pj_status_t) pj_activesock_pause_read(pj_activesock_t *asock);
+
+/**
+ * Resume the read operations that were stopped by
+ * #pj_activesock_pause_read(). This function may be called from any
+ * thread, the incoming data will be reported by the thread polling the
+ * ioqueue.
+ *
+ * @param asock	    The active socket.
+ *
+ * @return	    PJ_SUCCESS if the operation has been successful,
+ *		    or the appropriate error code on failure.
+ */
+PJ_DECL(pj_status_t) pj_activesock_resume_read(pj_activesock_t *asock);
+
+/**
+ * Add a reference to a buffer that has been lent by the active socket,
+ * for example when the data is shared by more than one owner.
+ *
+ * @param buf	    The buffer.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_activesock_buf_add_ref(pj_activesock_buf *buf);
+
+/**
+ * Release a reference to a buffer that has been lent by the active
+ * socket. When the last reference is released, the buffer is returned
+ * to the buffer pool of the active socket, and it must not be accessed
+ * anymore.
+ *
+ * @param buf	    The buffer.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_activesock_buf_dec_ref(pj_activesock_buf *buf);
+
 /**
  * Send data using the socket.
  *
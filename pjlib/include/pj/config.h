@@ -440,6 +440,79 @@
 #   define PJ_LOG_INDENT_CHAR	    '.'
 #endif
 
+/**
+ * Default size of the per-thread ring buffer used by the asynchronous
+ * logging mode (see #pj_log_start_async()), in bytes. It is rounded up
+ * to a power of two, and it must be able to hold at least two messages
+ * of PJ_LOG_MAX_SIZE. When the ring buffer of a thread is full, further
+ * messages from that thread are dropped and counted until the log thread
+ * catches up.
+ *
+ * Default: 65536
+ */
+#ifndef PJ_LOG_ASYNC_RING_SIZE
+#   define PJ_LOG_ASYNC_RING_SIZE   65536
+#endif
+
+/**
+ * The ring buffer of a thread is freed by the asynchronous logging when
+ * it has been empty and unused for at least this long (in msec), e.g.
+ * because the thread has exited. The thread gets a new ring buffer when
+ * it logs again.
+ *
+ * Default: 10000
+ */
+#ifndef PJ_LOG_ASYNC_RING_IDLE
+#   define PJ_LOG_ASYNC_RING_IDLE   10000
+#endif
+
+/**
+ * Maximum number of sender name prefixes that can have their own log
+ * level (see #pj_log_set_sender_level()). Set to zero to disable the
+ * per-sender log levels.
+ *
+ * Default: 16
+ */
+#ifndef PJ_LOG_MAX_SENDER_LEVELS
+#   define PJ_LOG_MAX_SENDER_LEVELS 16
+#endif
+
+/**
+ * Enable the tracing markers (PJ_TRACE_BEGIN(), PJ_TRACE_END() and
+ * PJ_TRACE_INSTANT()) in the library. When disabled, the markers compile
+ * to nothing. The tracing itself still has to be started at run-time with
+ * #pj_trace_start().
+ *
+ * Default: 0
+ */
+#ifndef PJ_HAS_TRACE
+#   define PJ_HAS_TRACE		    0
+#endif
+
+/**
+ * Default number of events in the per-thread ring buffer of the tracing
+ * facility (see #pj_trace_start()). It is rounded up to a power of two.
+ * When the ring buffer of a thread is full, its oldest events are
+ * overwritten.
+ *
+ * Default: 8192
+ */
+#ifndef PJ_TRACE_RING_SIZE
+#   define PJ_TRACE_RING_SIZE	    8192
+#endif
+
+/**
+ * The ring buffer of a thread is reused by the tracing facility for
+ * another thread when its thread hasn't recorded any event for at least
+ * this long (in msec), e.g. because the thread has exited. Its events are
+ * discarded then.
+ *
+ * Default: 10000
+ */
+#ifndef PJ_TRACE_RING_IDLE
+#   define PJ_TRACE_RING_IDLE	    10000
+#endif
+
 /**
  * Colorfull terminal (for logging etc).
  *
@@ -479,6 +552,116 @@
 #endif
 
 
+/**
+ * Default number of released pools of each size class to be kept in the
+ * per-thread magazine of the caching pool, to let threads create and
+ * release pools without taking the caching pool's global lock. Set to
+ * zero to disable the magazine layer. The setting can also be changed
+ * per caching pool with pj_caching_pool_set_magazine().
+ *
+ * Default: 0 (disabled)
+ */
+#ifndef PJ_CACHING_POOL_MAGAZINE_SIZE
+#  define PJ_CACHING_POOL_MAGAZINE_SIZE	    0
+#endif
+
+
+/**
+ * The pools in the per-thread magazine of the caching pool are moved to
+ * the free list when the magazine has not been used for at least this
+ * long (in msec), so that the pools kept for threads which have exited
+ * can be reused.
+ *
+ * Default: 1000
+ */
+#ifndef PJ_CACHING_POOL_MAGAZINE_IDLE
+#  define PJ_CACHING_POOL_MAGAZINE_IDLE	    1000
+#endif
+
+
+/**
+ * Maximum number of pool categories to be accounted by the caching pool,
+ * see pj_caching_pool_get_category_stat(). Pools of the categories that
+ * exceed this number are accounted together in an "other" category.
+ *
+ * Default: 32
+ */
+#ifndef PJ_CACHING_POOL_MAX_CATEGORY
+#  define PJ_CACHING_POOL_MAX_CATEGORY	    32
+#endif
+
+
+/**
+ * Number of entries in the caching pool's cache of the pool categories,
+ * indexed by the address of the pool name given to pj_pool_create(). It
+ * lets the pools created from the same place find their category without
+ * searching the category names.
+ *
+ * Default: 64
+ */
+#ifndef PJ_CACHING_POOL_CATEGORY_CACHE
+#  define PJ_CACHING_POOL_CATEGORY_CACHE    64
+#endif
+
+
+/**
+ * Maximum number of free objects to be kept in the per-thread cache of
+ * an object pool created with PJ_OBJPOOL_THREAD_CACHE flag. Half of the
+ * cache is refilled from, or flushed to, the shared free list at once.
+ *
+ * Default: 16
+ */
+#ifndef PJ_OBJPOOL_THREAD_CACHE_SIZE
+#  define PJ_OBJPOOL_THREAD_CACHE_SIZE	    16
+#endif
+
+
+/**
+ * The objects in the per-thread cache of an object pool are moved to the
+ * shared free list when the cache has not been used for at least this
+ * long (in msec), so that the objects kept for threads which have exited
+ * can be reused.
+ *
+ * Default: 1000
+ */
+#ifndef PJ_OBJPOOL_THREAD_CACHE_IDLE
+#  define PJ_OBJPOOL_THREAD_CACHE_IDLE	    1000
+#endif
+
+
+/**
+ * The CPU cache line size. Data that is written by different threads,
+ * such as the head and tail of #pj_ringbuf_t, is kept this far apart so
+ * that the threads don't invalidate each other's cache line.
+ *
+ * Default: 64
+ */
+#ifndef PJ_CACHE_LINE_SIZE
+#  define PJ_CACHE_LINE_SIZE		    64
+#endif
+
+
+/**
+ * Default number of worker threads of the executor (#pj_executor_t).
+ *
+ * Default: 2
+ */
+#ifndef PJ_EXECUTOR_THREAD_CNT
+#  define PJ_EXECUTOR_THREAD_CNT	    2
+#endif
+
+
+/**
+ * Default number of tasks that can be queued in each worker thread's
+ * deque of the executor, and in its shared submission queue.
+ *
+ * Default: 256
+ */
+#ifndef PJ_EXECUTOR_QUEUE_SIZE
+#  define PJ_EXECUTOR_QUEUE_SIZE	    256
+#endif
+
+
 /**
  * Enable timer heap debugging facility. When this is enabled, application
  * can call pj_timer_heap_dump() to show the contents of the timer heap
@@ -492,6 +675,55 @@
 #endif
 
 
+/*
+ * Types of timer heap backend implementation.
+ */
+
+/** Timer heap based on binary heap (ACE_Timer_Heap), see timer.c */
+#define PJ_TIMER_HEAP_BINARY	    1
+
+/** Timer heap based on hierarchical timing wheel, see timer_wheel.c */
+#define PJ_TIMER_HEAP_WHEEL	    2
+
+/**
+ * Select the timer heap backend implementation. Both backends implement
+ * the same timer heap API (see @ref PJ_TIMER). The binary heap schedules
+ * and cancels timers in O(log N), while the hierarchical timing wheel
+ * does it in O(1) at the expense of limiting the timer resolution to
+ * PJ_TIMER_WHEEL_RESOLUTION.
+ *
+ * Default: PJ_TIMER_HEAP_BINARY
+ */
+#ifndef PJ_TIMER_HEAP_IMPLEMENTATION
+#   define PJ_TIMER_HEAP_IMPLEMENTATION	    PJ_TIMER_HEAP_BINARY
+#endif
+
+
+/**
+ * The resolution of a tick in the timing wheel timer heap backend, in
+ * milliseconds. Timers are never fired before their expiration time,
+ * but may be fired up to this value later. The value must divide 1000.
+ *
+ * Default: 1
+ */
+#ifndef PJ_TIMER_WHEEL_RESOLUTION
+#   define PJ_TIMER_WHEEL_RESOLUTION	    1
+#endif
+
+
+/**
+ * The time, in milliseconds, after which a shard of a sharded timer heap
+ * whose owner thread has stopped polling is polled by the other threads
+ * (see pj_timer_heap_create_sharded()). Timers in such a shard may be
+ * fired up to this value late.
+ *
+ * Default: 500
+ */
+#ifndef PJ_TIMER_SHARD_IDLE_TIMEOUT
+#   define PJ_TIMER_SHARD_IDLE_TIMEOUT	    500
+#endif
+
+
 /**
  * Set this to 1 to enable debugging on the group lock. Default: 0
  */
@@ -500,6 +732,20 @@
 #endif
 
 
+/**
+ * Set this to 1 to collect contention statistics on each group lock: the
+ * number of acquisitions, how many of them had to wait for another
+ * thread, and the time spent waiting. The statistics can be retrieved
+ * with pj_grp_lock_get_stat(), and the most contended group locks can be
+ * logged with pj_grp_lock_dump_stat().
+ *
+ * Default: 0
+ */
+#ifndef PJ_GRP_LOCK_STAT
+#  define PJ_GRP_LOCK_STAT	0
+#endif
+
+
 /**
  * Specify this as \a stack_size argument in #pj_thread_create() to specify
  * that thread should use default stack size for the current platform.
@@ -573,6 +819,17 @@
 #   define PJ_ACTIVESOCK_MAX_CONSECUTIVE_ACCEPT_ERROR 50
 #endif
 
+/**
+ * Default maximum number of packets to be delivered in a single
+ * on_data_recvfrom_batch() callback of the active socket. See the
+ * \a batch_cnt field of pj_activesock_cfg.
+ *
+ * Default: 16
+ */
+#ifndef PJ_ACTIVESOCK_RECV_BATCH
+#   define PJ_ACTIVESOCK_RECV_BATCH	16
+#endif
+
 /**
  * Constants for declaring the maximum handles that can be supported by
  * a single IOQ framework. This constant might not be relevant to the 
@@ -632,6 +889,30 @@
 #endif
 
 
+/**
+ * Default one-shot setting for sockets/handles registered to the ioqueue,
+ * on implementation that supports it (currently epoll). See
+ * pj_ioqueue_set_oneshot() for more info.
+ *
+ * Default: 0
+ */
+#ifndef PJ_IOQUEUE_DEFAULT_ONESHOT
+#   define PJ_IOQUEUE_DEFAULT_ONESHOT		0
+#endif
+
+
+/**
+ * Maximum number of operations that a polling thread completes on a
+ * one-shot key in a row, before it re-arms the key and moves on to other
+ * keys. The key is reported again right away if it still has data.
+ *
+ * Default: 32
+ */
+#ifndef PJ_IOQUEUE_ONESHOT_MAX_DRAIN
+#   define PJ_IOQUEUE_ONESHOT_MAX_DRAIN	32
+#endif
+
+
 /**
  * When safe unregistration (PJ_IOQUEUE_HAS_SAFE_UNREG) is configured in
  * ioqueue, the PJ_IOQUEUE_KEY_FREE_DELAY macro specifies how long the
@@ -646,6 +927,65 @@
 #endif
 
 
+/**
+ * Enable the instrumentation of the ioqueue: the number of completed
+ * read, write and accept operations, the number of bytes and the
+ * histogram of the callback execution time of each key, and the time
+ * spent in dispatching the events. The statistics can be retrieved with
+ * pj_ioqueue_get_key_stat() and pj_ioqueue_get_stat(), and logged with
+ * pj_ioqueue_dump().
+ *
+ * This reads the timestamp twice for every callback, hence it is
+ * disabled by default.
+ *
+ * Default: 0
+ */
+#ifndef PJ_IOQUEUE_STAT
+#   define PJ_IOQUEUE_STAT		0
+#endif
+
+
+/**
+ * Number of submission queue entries of the io_uring ioqueue backend
+ * (ioqueue_uring.c, selected with "--enable-uring" configure option).
+ * Operations are submitted to the kernel in batches of up to this many
+ * entries. The value is rounded up to a power of two by the kernel.
+ *
+ * Default: 256
+ */
+#ifndef PJ_IOQUEUE_URING_SQ_SIZE
+#   define PJ_IOQUEUE_URING_SQ_SIZE	256
+#endif
+
+
+/**
+ * Number of receive buffers which the io_uring ioqueue backend registers
+ * to the kernel. Incoming packets are received by the kernel directly into
+ * these buffers, then copied to the application buffers. The value must be
+ * a power of two, not greater than 32768.
+ *
+ * Default: 256
+ */
+#ifndef PJ_IOQUEUE_URING_BUF_CNT
+#   define PJ_IOQUEUE_URING_BUF_CNT	256
+#endif
+
+
+/**
+ * Minimum size of each receive buffer of the io_uring ioqueue backend.
+ * The buffers are allocated when the first datagram socket starts
+ * receiving, large enough for the reads of that socket (up to 64 KB).
+ * Sockets whose reads are larger than the buffers are received directly
+ * into the application's buffer without multishot receive, so datagrams
+ * are never truncated by these buffers.
+ *
+ * Default: 4096
+ */
+#ifndef PJ_IOQUEUE_URING_BUF_SIZE
+#   define PJ_IOQUEUE_URING_BUF_SIZE	4096
+#endif
+
+
 /**
  * Determine if FD_SETSIZE is changeable/set-able. If so, then we will
  * set it to PJ_IOQUEUE_MAX_HANDLES. Currently we detect this by checking
@@ -714,6 +1054,25 @@
 #endif
 
 
+/**
+ * Implement atomic variables (#pj_atomic_t) with the compiler's native
+ * atomic builtins (GCC/Clang \a __atomic_xxx() functions) instead of
+ * protecting each variable with its own mutex. This makes increment and
+ * decrement of reference counters (group lock, ioqueue key, transport)
+ * lock free. When disabled, or when the compiler does not provide the
+ * builtins, the mutex based implementation is used.
+ *
+ * Default: 1 if the compiler supports __atomic builtins, otherwise 0.
+ */
+#ifndef PJ_HAS_ATOMIC_BUILTINS
+#   if defined(__ATOMIC_SEQ_CST) && defined(__GNUC__)
+#	define PJ_HAS_ATOMIC_BUILTINS	1
+#   else
+#	define PJ_HAS_ATOMIC_BUILTINS	0
+#   endif
+#endif
+
+
 /**
  * Maximum file name length.
  */
@@ -784,6 +1143,22 @@
 #   define PJ_TIMESTAMP_USE_RDTSC   0
 #endif
 
+/**
+ * Should pj_gettickcount_coarse() read CLOCK_MONOTONIC_COARSE instead of
+ * calling pj_gettickcount(), both when the calling thread is not
+ * dispatching events and when it caches its time for the current poll
+ * iteration (see pj_coarse_clock_enter()).
+ * On Linux this clock is read without a system call, but it only
+ * advances every timer interrupt (1-10 ms). Only enable this when
+ * pj_gettickcount() is based on CLOCK_MONOTONIC, which is the case on
+ * Linux unless PJ_TIMESTAMP_USE_RDTSC is set.
+ *
+ * Default: 0
+ */
+#ifndef PJ_COARSE_CLOCK_USE_MONOTONIC_COARSE
+#   define PJ_COARSE_CLOCK_USE_MONOTONIC_COARSE	0
+#endif
+
 /**
  * Is native platform error positive number?
  * Default: 1 (yes)
@@ -816,6 +1191,25 @@
 #endif
 
 
+/**
+ * Use SIMD instructions for the ASCII caseless comparison (pj_stricmp(),
+ * pj_strnicmp() and friends) and for the substring search (pj_strstr()
+ * and pj_stristr()). SSE2 is used on x86 CPUs, and AVX2 is used if the
+ * CPU supports it, which is detected at run time. Use pj_str_set_simd()
+ * to select the implementation.
+ *
+ * Default: 1 on x86 with GCC or Clang, otherwise 0.
+ */
+#ifndef PJ_HAS_SIMD_STRING
+#   if defined(__GNUC__) && defined(__SSE2__) && \
+       (defined(__x86_64__) || defined(__i386__))
+#	define PJ_HAS_SIMD_STRING   1
+#   else
+#	define PJ_HAS_SIMD_STRING   0
+#   endif
+#endif
+
+
 /*
  * Types of QoS backend implementation.
  */
@@ -858,6 +1252,41 @@
 #endif
 
 
+/**
+ * Maximum number of SSL contexts that are kept for sharing by the secure
+ * sockets after they are no longer used by any socket, so that the
+ * session cache survives reconnections (see \a sess_cache in
+ * pj_ssl_sock_param).
+ *
+ * Default: 8
+ */
+#ifndef PJ_SSL_SOCK_CTX_CACHE_SIZE
+#  define PJ_SSL_SOCK_CTX_CACHE_SIZE	    8
+#endif
+
+
+/**
+ * Maximum number of sessions in the server side session cache of each
+ * shared SSL context.
+ *
+ * Default: 1024
+ */
+#ifndef PJ_SSL_SOCK_SESS_CACHE_SIZE
+#  define PJ_SSL_SOCK_SESS_CACHE_SIZE	    1024
+#endif
+
+
+/**
+ * Maximum number of client sessions (one per remote address and server
+ * name) kept for resumption by each shared SSL context.
+ *
+ * Default: 32
+ */
+#ifndef PJ_SSL_SOCK_CLIENT_SESS_CNT
+#  define PJ_SSL_SOCK_CLIENT_SESS_CNT	    32
+#endif
+
+
 /**
  * Disable WSAECONNRESET error for UDP sockets on Win32 platforms. See
  * https://trac.pjsip.org/repos/ticket/1197.
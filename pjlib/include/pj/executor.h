@@ -0,0 +1,237 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_EXECUTOR_H__
+#define __PJ_EXECUTOR_H__
+
+/**
+ * @file executor.h
+ * @brief Task Executor (Thread Pool).
+ */
+
+#include <pj/types.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_EXECUTOR Task Executor
+ * @ingroup PJ_OS
+ * @{
+ *
+ * The executor runs tasks (a callback and its argument) on a fixed set of
+ * worker threads. It lets blocking or heavy work, such as file writes or
+ * codec initialization, be moved off the ioqueue polling thread without
+ * creating a thread for each subsystem.
+ *
+ * Each worker thread has its own deque of tasks. A task submitted from a
+ * worker thread goes to that thread's deque, and is run from the newest
+ * end, while its data is likely still in the cache. Tasks submitted from
+ * other threads go to the shared submission queue. A worker thread that
+ * runs out of tasks takes from the submission queue, then steals the
+ * oldest task from the other worker threads' deques, and waits only
+ * when all of them are empty. Hence there is no ordering guarantee
+ * between tasks.
+ *
+ * A task may be associated with a group lock. The executor keeps a
+ * reference to the group lock until the task has run, so the object
+ * can't be destroyed while the task is queued, and optionally holds the
+ * group lock while the callback is called (#PJ_EXECUTOR_HOLD_LOCK).
+ */
+
+/**
+ * Opaque data type for the executor.
+ */
+typedef struct pj_executor_t pj_executor_t;
+
+/**
+ * Type of the task callback.
+ *
+ * @param arg		The argument given to #pj_executor_submit().
+ */
+typedef void pj_executor_cb(void *arg);
+
+/**
+ * Task submission flags.
+ */
+typedef enum pj_executor_flag
+{
+    /**
+     * Acquire the task's group lock while its callback is called.
+     */
+    PJ_EXECUTOR_HOLD_LOCK = 1
+
+} pj_executor_flag;
+
+
+/**
+ * Executor settings. Application must initialize this structure with
+ * #pj_executor_param_default().
+ */
+typedef struct pj_executor_param
+{
+    /**
+     * Number of worker threads.
+     *
+     * Default: PJ_EXECUTOR_THREAD_CNT
+     */
+    unsigned	thread_cnt;
+
+    /**
+     * Maximum number of tasks in each worker thread's deque and in the
+     * submission queue. It is rounded up to the power of two.
+     *
+     * Default: PJ_EXECUTOR_QUEUE_SIZE
+     */
+    unsigned	queue_size;
+
+    /**
+     * Stack size of the worker threads, or zero to use the default.
+     *
+     * Default: 0
+     */
+    pj_size_t	stack_size;
+
+} pj_executor_param;
+
+
+/**
+ * Executor statistics, as returned by #pj_executor_get_stat().
+ */
+typedef struct pj_executor_stat
+{
+    /**
+     * Number of worker threads.
+     */
+    unsigned	thread_cnt;
+
+    /**
+     * Number of tasks that are queued and not yet started.
+     */
+    unsigned	pending_cnt;
+
+    /**
+     * Total number of tasks that have been submitted.
+     */
+    pj_uint32_t	submit_cnt;
+
+    /**
+     * Total number of tasks that have been run.
+     */
+    pj_uint32_t	exec_cnt;
+
+    /**
+     * Number of tasks that were run by a worker thread other than the
+     * one which deque they were submitted to.
+     */
+    pj_uint32_t	steal_cnt;
+
+    /**
+     * Number of submissions that were rejected because the queue was
+     * full.
+     */
+    pj_uint32_t	reject_cnt;
+
+} pj_executor_stat;
+
+
+/**
+ * Initialize the executor settings with the default values.
+ *
+ * @param param		The settings to be initialized.
+ */
+PJ_DECL(void) pj_executor_param_default(pj_executor_param *param);
+
+/**
+ * Create an executor and start its worker threads.
+ *
+ * @param pool		Pool to allocate the executor from.
+ * @param name		Name to identify the executor and its threads in
+ *			the log, or NULL.
+ * @param param		The settings, or NULL to use the default.
+ * @param p_exec	Pointer to receive the executor.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_executor_create(pj_pool_t *pool,
+					const char *name,
+					const pj_executor_param *param,
+					pj_executor_t **p_exec);
+
+/**
+ * Queue a task to be run by one of the worker threads. The function
+ * doesn't wait for the task to start.
+ *
+ * @param exec		The executor.
+ * @param cb		The callback to be called by the worker thread.
+ * @param arg		Argument to be passed to the callback.
+ * @param grp_lock	Optional group lock of the object that the task
+ *			works on. A reference to it is added here and
+ *			released after the callback returns.
+ * @param flags		Bitmask combination of #pj_executor_flag.
+ *
+ * @return		PJ_SUCCESS on success, PJ_ETOOMANY if the queue is
+ *			full, PJ_EINVALIDOP if the executor is being
+ *			destroyed, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_executor_submit(pj_executor_t *exec,
+					pj_executor_cb *cb,
+					void *arg,
+					pj_grp_lock_t *grp_lock,
+					unsigned flags);
+
+/**
+ * Check whether the calling thread is one of the executor's worker
+ * threads.
+ *
+ * @param exec		The executor.
+ *
+ * @return		PJ_TRUE if the calling thread is a worker thread.
+ */
+PJ_DECL(pj_bool_t) pj_executor_is_worker(pj_executor_t *exec);
+
+/**
+ * Get the executor statistics. The values are approximate while tasks
+ * are being submitted and run.
+ *
+ * @param exec		The executor.
+ * @param stat		Pointer to receive the statistics.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_executor_get_stat(pj_executor_t *exec,
+					  pj_executor_stat *stat);
+
+/**
+ * Destroy the executor. New submissions are rejected, the tasks that
+ * are already queued are run, then the worker threads are stopped. This
+ * function must not be called from a worker thread.
+ *
+ * @param exec		The executor.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_executor_destroy(pj_executor_t *exec);
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif	/* __PJ_EXECUTOR_H__ */
@@ -37,6 +37,10 @@ PJ_BEGIN_DECL
  * hash functions. Having the keys of more than one item map to the same 
  * position is called a collision. In this library, we will chain the nodes
  * that have the same key in a list.
+ *
+ * Hash table created with #pj_hash_create_resizable() uses open addressing
+ * instead, and it grows as entries are added. It is used with the same
+ * API as the fixed size hash table.
  */
 
 /**
@@ -96,6 +100,31 @@ PJ_DECL(pj_uint32_t) pj_hash_calc_tolower(pj_uint32_t hval,
 PJ_DECL(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size);
 
 
+/**
+ * Create a resizable hash table. The entries are stored in an array of
+ * slots with open addressing, so adding an entry doesn't allocate memory
+ * for the entry, and the entry buffer of #pj_hash_set_np() is not used.
+ * When the array is three quarters full, a new array (twice as large, or
+ * the same size if many entries have been deleted) is allocated from the
+ * pool, and the entries are moved to it a few at a time on the following
+ * insertions, so there is no long pause to rehash the whole table.
+ *
+ * Since the array is allocated from the pool when the table grows, the
+ * pool must not be used by other threads without holding the lock that
+ * protects the hash table. Arrays that are no longer used are reused if
+ * possible, otherwise they are kept until the pool is released. Also
+ * entries must not be added while iterating the hash table.
+ *
+ * @param pool	the pool from which the hash table and its slot arrays
+ *		will be allocated from.
+ * @param size	the initial number of slots, which will be round-up to
+ *		the nearest 2^n.
+ * @return the hash table.
+ */
+PJ_DECL(pj_hash_table_t*) pj_hash_create_resizable(pj_pool_t *pool,
+						   unsigned size);
+
+
 /**
  * Get the value associated with the specified key.
  *
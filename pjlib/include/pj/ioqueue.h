@@ -317,6 +317,34 @@ typedef enum pj_ioqueue_operation_e
 PJ_DECL(const char*) pj_ioqueue_name(void);
 
 
+/**
+ * Features of the ioqueue implementation, see #pj_ioqueue_get_features().
+ */
+typedef enum pj_ioqueue_feature
+{
+    /**
+     * The implementation reads the socket only when a pending read is
+     * dispatched (e.g. select and epoll, which wait for readiness), so
+     * the application may read more packets directly from the socket
+     * (e.g. with #pj_sock_recvmmsg()) in the read callback without
+     * reordering them. Implementations which submit the reads to the OS
+     * beforehand (e.g. io_uring or IOCP) don't have this feature, as
+     * packets read directly would overtake the ones they have already
+     * received.
+     */
+    PJ_IOQUEUE_FEATURE_DIRECT_READ = 1
+
+} pj_ioqueue_feature;
+
+
+/**
+ * Get the features of the ioqueue implementation.
+ *
+ * @return		Bitmask of #pj_ioqueue_feature.
+ */
+PJ_DECL(unsigned) pj_ioqueue_get_features(void);
+
+
 /**
  * Create a new I/O Queue framework.
  *
@@ -377,6 +405,185 @@ PJ_DECL(pj_status_t) pj_ioqueue_set_lock( pj_ioqueue_t *ioque,
 PJ_DECL(pj_status_t) pj_ioqueue_set_default_concurrency(pj_ioqueue_t *ioqueue,
 							pj_bool_t allow);
 
+/**
+ * Set the maximum number of events to be retrieved and dispatched by a
+ * single #pj_ioqueue_poll() call, on implementation that supports it
+ * (currently epoll). When this is set to one, each call to
+ * #pj_ioqueue_poll() dispatches at most one event, otherwise the ioqueue
+ * fetches up to the specified number of events with a single system call
+ * and dispatches them in the order they are reported. The value is capped
+ * to PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL, which is also the default.
+ *
+ * A key will only be dispatched by one polling thread at a time
+ * unless the key allows concurrency (see
+ * #pj_ioqueue_set_concurrency()): an event of a key that is being
+ * dispatched by another thread is left to be reported by a subsequent
+ * poll, so the polling thread does not block on the key and can process
+ * the events of other keys in the meantime.
+ *
+ * @param ioqueue	The ioqueue instance.
+ * @param max_events	Maximum number of events per poll, must be at least
+ *			one.
+ *
+ * @return		PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_set_max_events(pj_ioqueue_t *ioqueue,
+					       unsigned max_events);
+
+/**
+ * Set the one-shot mode for the subsequent key registrations, on
+ * implementation that supports it (currently epoll). If this function is
+ * not called, the default is controlled by compile time setting
+ * PJ_IOQUEUE_DEFAULT_ONESHOT.
+ *
+ * A one-shot key is registered edge-triggered and one-shot (EPOLLET and
+ * EPOLLONESHOT), so an event of the key wakes up only one polling thread,
+ * which then owns the key: it completes the pending read operations until
+ * the socket has no more data (or up to PJ_IOQUEUE_ONESHOT_MAX_DRAIN
+ * operations), and re-arms the key for the operations that are still
+ * pending. Other polling threads are not woken up by the key in the
+ * meantime, so multiple polling threads do not race for the same busy
+ * socket. Callbacks of a one-shot key are therefore never called in
+ * parallel, regardless of the key concurrency setting, although the
+ * key's lock is still held according to that setting.
+ *
+ * @param ioqueue	The ioqueue instance.
+ * @param enable	Non-zero to register keys in one-shot mode, or
+ *			PJ_FALSE for the default level-triggered mode.
+ *
+ * @return		PJ_SUCCESS on success, or PJ_ENOTSUP if enabling
+ *			is not supported by the implementation.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_set_oneshot(pj_ioqueue_t *ioqueue,
+					    pj_bool_t enable);
+
+/**
+ * This structure describes ioqueue statistics, which can be retrieved with
+ * #pj_ioqueue_get_stat().
+ */
+typedef struct pj_ioqueue_stat
+{
+    /** Number of polling system calls (e.g. epoll_wait()) which returned
+     *  at least one event. */
+    pj_uint32_t	    poll_cnt;
+
+    /** Total number of events returned by those system calls. Divide this
+     *  by poll_cnt to get the average number of events per system call. */
+    pj_uint32_t	    event_cnt;
+
+    /** Number of events that have been dispatched to the keys. */
+    pj_uint32_t	    dispatch_cnt;
+
+    /** Number of events that have been skipped because the key was being
+     *  dispatched by another thread. */
+    pj_uint32_t	    busy_cnt;
+
+    /** Largest number of events returned by a single system call. */
+    pj_uint32_t	    max_event_cnt;
+
+    /** Total time spent in dispatching the events to the keys, in
+     *  microseconds. Only collected when PJ_IOQUEUE_STAT is enabled. */
+    pj_uint64_t	    dispatch_usec;
+
+    /** Longest time spent in dispatching the events of one system call,
+     *  in microseconds. Only collected when PJ_IOQUEUE_STAT is enabled. */
+    pj_uint32_t	    max_dispatch_usec;
+
+} pj_ioqueue_stat;
+
+/**
+ * Get the statistics of the ioqueue, on implementation that supports it.
+ *
+ * @param ioqueue	The ioqueue instance.
+ * @param stat		Pointer to receive the statistics.
+ *
+ * @return		PJ_SUCCESS on success, PJ_ENOTSUP if statistics are
+ *			not supported by the ioqueue implementation, or the
+ *			appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_get_stat(pj_ioqueue_t *ioqueue,
+					 pj_ioqueue_stat *stat);
+
+/**
+ * Reset the statistics of the ioqueue.
+ *
+ * @param ioqueue	The ioqueue instance.
+ *
+ * @return		PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_reset_stat(pj_ioqueue_t *ioqueue);
+
+/**
+ * Number of buckets in the callback execution time histogram of
+ * #pj_ioqueue_key_stat.
+ */
+#define PJ_IOQUEUE_CB_HIST_CNT	8
+
+/**
+ * This structure describes the statistics of an ioqueue key, which can be
+ * retrieved with #pj_ioqueue_get_key_stat(). The statistics are only
+ * collected when PJ_IOQUEUE_STAT is enabled. Each counter is updated
+ * atomically when the compiler provides atomic builtins
+ * (PJ_HAS_ATOMIC_BUILTINS), otherwise the counters of a key that allows
+ * concurrency are approximate. The counters are read one by one, so they
+ * may not be consistent with each other while the key is in use.
+ */
+typedef struct pj_ioqueue_key_stat
+{
+    /** Number of completed read operations. */
+    pj_uint32_t	    read_cnt;
+
+    /** Number of bytes read. */
+    pj_uint64_t	    read_bytes;
+
+    /** Number of completed write operations. */
+    pj_uint32_t	    write_cnt;
+
+    /** Number of bytes written. */
+    pj_uint64_t	    write_bytes;
+
+    /** Number of completed accept operations. */
+    pj_uint32_t	    accept_cnt;
+
+    /** Number of callbacks called for the key. */
+    pj_uint32_t	    cb_cnt;
+
+    /** Total execution time of the callbacks, in microseconds. */
+    pj_uint64_t	    cb_usec;
+
+    /** Longest execution time of a callback, in microseconds. */
+    pj_uint32_t	    max_cb_usec;
+
+    /** Histogram of the callback execution time. The first bucket counts
+     *  the callbacks that took less than 16 microseconds, the limit of
+     *  each next bucket is four times the previous one (64, 256, ...),
+     *  and the last bucket counts the rest. */
+    pj_uint32_t	    cb_hist[PJ_IOQUEUE_CB_HIST_CNT];
+
+} pj_ioqueue_key_stat;
+
+/**
+ * Get the statistics of the ioqueue key.
+ *
+ * @param key		The ioqueue key.
+ * @param stat		Pointer to receive the statistics.
+ *
+ * @return		PJ_SUCCESS on success, PJ_ENOTSUP if PJ_IOQUEUE_STAT
+ *			is disabled or not supported by the ioqueue
+ *			implementation, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_get_key_stat(pj_ioqueue_key_t *key,
+					     pj_ioqueue_key_stat *stat);
+
+/**
+ * Log the statistics of the ioqueue, and when \a detail is set and
+ * PJ_IOQUEUE_STAT is enabled, the statistics of each registered key.
+ *
+ * @param ioqueue	The ioqueue instance.
+ * @param detail	Also log the statistics of the keys.
+ */
+PJ_DECL(void) pj_ioqueue_dump(pj_ioqueue_t *ioqueue, pj_bool_t detail);
+
 /**
  * Register a socket to the I/O queue framework. 
  * When a socket is registered to the IOQueue, it may be modified to use
@@ -363,6 +363,64 @@ PJ_DECL(int) pj_grp_lock_get_ref(pj_grp_lock_t *grp_lock);
 PJ_DECL(void) pj_grp_lock_dump(pj_grp_lock_t *grp_lock);
 
 
+/**
+ * Group lock contention statistics, as returned by
+ * #pj_grp_lock_get_stat(). The statistics are only collected when
+ * PJ_GRP_LOCK_STAT is enabled.
+ */
+typedef struct pj_grp_lock_stat
+{
+    /**
+     * Number of times the group lock has been acquired, including
+     * recursive acquisitions by the owner thread.
+     */
+    pj_uint32_t	acquire_cnt;
+
+    /**
+     * Number of acquisitions that had to wait because another thread was
+     * holding the group lock.
+     */
+    pj_uint32_t	contended_cnt;
+
+    /**
+     * Total time spent waiting for the group lock, in microseconds.
+     */
+    pj_uint64_t	total_wait_usec;
+
+    /**
+     * Longest single wait for the group lock, in microseconds.
+     */
+    pj_uint32_t	max_wait_usec;
+
+} pj_grp_lock_stat;
+
+
+/**
+ * Get the contention statistics of the group lock.
+ *
+ * @param grp_lock	The group lock.
+ * @param stat		Pointer to receive the statistics.
+ *
+ * @return		PJ_SUCCESS, or PJ_ENOTSUP if PJ_GRP_LOCK_STAT is
+ *			disabled.
+ */
+PJ_DECL(pj_status_t) pj_grp_lock_get_stat(pj_grp_lock_t *grp_lock,
+					  pj_grp_lock_stat *stat);
+
+
+/**
+ * Log the contention statistics of the group locks that have spent the
+ * longest time waiting, to find the hot locks in a running application.
+ * Each group lock is identified by its address and the name of the pool
+ * given to #pj_grp_lock_create(). This function does nothing if
+ * PJ_GRP_LOCK_STAT is disabled.
+ *
+ * @param max_cnt	Maximum number of group locks to log, or zero to
+ *			use the default (10).
+ */
+PJ_DECL(void) pj_grp_lock_dump_stat(unsigned max_cnt);
+
+
 /**
  * Synchronize an external lock with the group lock, by adding it to the
  * list of locks to be acquired by the group lock when the group lock is
@@ -86,6 +86,34 @@ enum pj_log_decoration
     PJ_LOG_HAS_INDENT     =16384  /**< Indentation. Say yes! [yes]            */
 };
 
+/**
+ * @def PJ_LOG_SENDER_CHECK_INLINE
+ * Internal: whether #PJ_LOG checks the per-sender log levels (see
+ * #pj_log_set_sender_level()) before the arguments are evaluated. This
+ * needs variadic macros to get the sender from the arguments. Without
+ * it, the sender is checked by #pj_log().
+ */
+#ifndef PJ_LOG_SENDER_CHECK_INLINE
+#   if PJ_LOG_MAX_SENDER_LEVELS && (defined(__GNUC__) || \
+	(defined(_MSC_VER) && _MSC_VER >= 1400) || \
+	(defined(__STDC_VERSION__) && __STDC_VERSION__ >= 199901L))
+#	define PJ_LOG_SENDER_CHECK_INLINE   1
+#   else
+#	define PJ_LOG_SENDER_CHECK_INLINE   0
+#   endif
+#endif
+
+/**
+ * Internal: get the sender from the arguments of #PJ_LOG, and replace the
+ * sender in the arguments with the value that has been checked, so that
+ * the sender expression is only evaluated once.
+ * @hideinitializer
+ */
+#if PJ_LOG_SENDER_CHECK_INLINE
+#   define pj_log_get_sender_(sender, ...)	(sender)
+#   define pj_log_checked_args_(sender, ...)	(pj_log_sender_, __VA_ARGS__)
+#endif
+
 /**
  * Write log message.
  * This is the main macro used to write text to the logging backend. 
@@ -104,10 +132,29 @@ enum pj_log_decoration
    \endverbatim
  * @hideinitializer
  */
+#if PJ_LOG_MAX_LEVEL >= 1 && PJ_LOG_SENDER_CHECK_INLINE
+#define PJ_LOG(level,arg)	do { \
+				    if (level <= pj_log_active_level) { \
+					const char *pj_log_sender_ = \
+					    pj_log_get_sender_ arg; \
+					if (pj_log_sender_level_cnt == 0 || \
+					    pj_log_sender_enabled( \
+						pj_log_sender_, level)) \
+					    pj_log_wrapper_##level( \
+						pj_log_checked_args_ arg); \
+				    } \
+				} while (0)
+#elif PJ_LOG_MAX_LEVEL >= 1
+#define PJ_LOG(level,arg)	do { \
+				    if (level <= pj_log_active_level) \
+					pj_log_wrapper_##level(arg); \
+				} while (0)
+#else
 #define PJ_LOG(level,arg)	do { \
 				    if (level <= pj_log_get_level()) \
 					pj_log_wrapper_##level(arg); \
 				} while (0)
+#endif
 
 /**
  * Signature for function to be registered to the logging subsystem to
@@ -132,6 +179,40 @@ typedef void pj_log_func(int level, const char *data, int len);
 PJ_DECL(void) pj_log_write(int level, const char *buffer, int len);
 
 
+/**
+ * Statistics of the asynchronous logging mode, as returned by
+ * #pj_log_get_async_stat().
+ */
+typedef struct pj_log_async_stat
+{
+    /**
+     * Number of per-thread ring buffers, i.e. the number of threads that
+     * have written log messages recently. The ring buffer of a thread is
+     * freed after it has been unused for PJ_LOG_ASYNC_RING_IDLE msec.
+     */
+    unsigned	    ring_cnt;
+
+    /**
+     * Number of messages passed to the log writer by the log thread or
+     * by #pj_log_flush().
+     */
+    pj_uint32_t	    written_cnt;
+
+    /**
+     * Number of messages dropped because the ring buffer of the calling
+     * thread was full.
+     */
+    pj_uint32_t	    dropped_cnt;
+
+    /**
+     * Number of messages that were formatted by the log thread from
+     * binary records (see #pj_log_set_async_binary()).
+     */
+    pj_uint32_t	    binary_cnt;
+
+} pj_log_async_stat;
+
+
 #if PJ_LOG_MAX_LEVEL >= 1
 
 /**
@@ -187,6 +268,64 @@ PJ_DECL_DATA(int) pj_log_max_level;
 #define pj_log_get_level()  pj_log_max_level
 #endif
 
+/**
+ * Internal: the highest level of the global log level and the per-sender
+ * log levels, checked by #PJ_LOG before anything else.
+ */
+PJ_DECL_DATA(int) pj_log_active_level;
+
+/**
+ * Internal: number of per-sender log levels.
+ */
+PJ_DECL_DATA(unsigned) pj_log_sender_level_cnt;
+
+/**
+ * Set the maximum log level for the senders whose name starts with the
+ * specified prefix, overriding the global level set with
+ * #pj_log_set_level(). The level may be higher or lower than the global
+ * level, for example to see the detailed log of the transactions only
+ * (sender names start with "tsx"), or to quiet a chatty module. When
+ * several prefixes match a sender, the longest prefix is used.
+ *
+ * The check is done by #PJ_LOG before the arguments are evaluated,
+ * so the arguments of messages that are filtered out aren't evaluated.
+ *
+ * The per-sender levels are not protected against concurrent access, so
+ * they should be set before the threads that write the log are started,
+ * or at least not from several threads at once.
+ *
+ * @param prefix    Sender name prefix, e.g. "tsx" or "stream".
+ * @param level	    The maximum log level for the matching senders, or
+ *		    negative value to remove the prefix.
+ *
+ * @return	    PJ_SUCCESS on success, PJ_ETOOMANY if there are
+ *		    already PJ_LOG_MAX_SENDER_LEVELS prefixes, or the
+ *		    appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_log_set_sender_level(const char *prefix, int level);
+
+/**
+ * Get the maximum log level that applies to the specified sender.
+ *
+ * @param sender    The sender name.
+ *
+ * @return	    The per-sender log level of the longest matching prefix,
+ *		    or the global log level.
+ */
+PJ_DECL(int) pj_log_get_sender_level(const char *sender);
+
+/**
+ * Internal: check whether the message with the specified level from the
+ * sender should be written. It is called by #PJ_LOG when there is a
+ * per-sender log level.
+ *
+ * @param sender    The sender name.
+ * @param level	    Level of the message.
+ *
+ * @return	    PJ_TRUE if the message should be written.
+ */
+PJ_DECL(pj_bool_t) pj_log_sender_enabled(const char *sender, int level);
+
 /**
  * Set log decoration. The log decoration flag controls what are printed
  * to output device alongside the actual message. For example, application
@@ -241,6 +380,84 @@ PJ_DECL(void) pj_log_set_color(int level, pj_color_t color);
  */
 PJ_DECL(pj_color_t) pj_log_get_color(int level);
 
+/**
+ * Start the asynchronous logging mode. In this mode, #pj_log() formats
+ * the message on the calling thread and puts it in a lock-free ring
+ * buffer owned by that thread, and a background log thread passes the
+ * messages to the log writer (see #pj_log_set_log_func()) in batches.
+ * Slow log writers (e.g. writing to file or console) then no longer
+ * block the threads that write the log.
+ *
+ * Messages from all threads are passed to the log writer in the order
+ * they were written. If the ring buffer of a thread is full, the
+ * message is dropped and counted, and the log thread reports the number
+ * of dropped messages once it catches up. Messages with level 0 (fatal)
+ * flush the pending messages and are written synchronously.
+ *
+ * The ring buffer of a thread is allocated when the thread writes its
+ * first message. It is released when the thread hasn't written any message
+ * for PJ_LOG_ASYNC_RING_IDLE msec (e.g. because the thread has exited),
+ * and by #pj_log_stop_async(). The asynchronous mode requires thread and atomic builtins support
+ * (PJ_HAS_THREADS and PJ_HAS_ATOMIC_BUILTINS).
+ *
+ * The asynchronous logging mode is stopped by #pj_shutdown() if the
+ * application doesn't stop it.
+ *
+ * @param ring_size Size of each per-thread ring buffer in bytes, or zero
+ *		    to use PJ_LOG_ASYNC_RING_SIZE.
+ *
+ * @return	    PJ_SUCCESS on success, PJ_ENOTSUP if the asynchronous
+ *		    mode is not available, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_log_start_async(unsigned ring_size);
+
+/**
+ * Write all pending messages of the asynchronous logging mode to the
+ * log writer now, from the calling thread. Application should call this
+ * e.g. before it aborts on a fatal error. This function does nothing if
+ * the asynchronous mode is not running.
+ */
+PJ_DECL(void) pj_log_flush(void);
+
+/**
+ * Stop the asynchronous logging mode. The pending messages are written,
+ * the log thread is stopped, and the ring buffers are released. After
+ * this function returns, the log writer is called synchronously again.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_log_stop_async(void);
+
+/**
+ * Enable or disable the binary record mode of the asynchronous logging.
+ * In this mode, the thread that logs doesn't format the message. It
+ * records the time, the sender, the format string pointer and a copy of
+ * the arguments in its ring buffer, and the log thread formats the
+ * message. String arguments (%s) are copied, all other arguments are
+ * copied by value.
+ *
+ * Since only the pointer of the format string is recorded, the format
+ * strings must stay valid until the message is written, which is the
+ * case for string literals. Messages with conversions that can't be
+ * recorded (e.g. wide strings or long double) and messages with level 0
+ * are formatted by the calling thread as usual.
+ *
+ * The binary record mode is disabled by default.
+ *
+ * @param enabled   PJ_TRUE to enable the binary record mode.
+ */
+PJ_DECL(void) pj_log_set_async_binary(pj_bool_t enabled);
+
+/**
+ * Get the statistics of the asynchronous logging mode.
+ *
+ * @param stat	    Pointer to receive the statistics.
+ *
+ * @return	    PJ_SUCCESS on success, or PJ_EINVALIDOP if the
+ *		    asynchronous mode is not running.
+ */
+PJ_DECL(pj_status_t) pj_log_get_async_stat(pj_log_async_stat *stat);
+
 /**
  * Internal function to be called by pj_init()
  */
@@ -342,6 +559,52 @@ pj_status_t pj_log_init(void);
  */
 #  define pj_log_get_color(level) 0
 
+/**
+ * Start the asynchronous logging mode.
+ *
+ * @param ring_size Size of each per-thread ring buffer.
+ */
+#  define pj_log_start_async(ring_size)	PJ_ENOTSUP
+
+/**
+ * Write all pending messages of the asynchronous logging mode.
+ */
+#  define pj_log_flush()
+
+/**
+ * Stop the asynchronous logging mode.
+ */
+#  define pj_log_stop_async()		PJ_SUCCESS
+
+/**
+ * Enable or disable the binary record mode of the asynchronous logging.
+ *
+ * @param enabled   PJ_TRUE to enable the binary record mode.
+ */
+#  define pj_log_set_async_binary(enabled)
+
+/**
+ * Set the maximum log level for the senders matching the prefix.
+ *
+ * @param prefix    Sender name prefix.
+ * @param level	    The maximum log level for the matching senders.
+ */
+#  define pj_log_set_sender_level(prefix, level)	PJ_ENOTSUP
+
+/**
+ * Get the maximum log level that applies to the specified sender.
+ *
+ * @param sender    The sender name.
+ */
+#  define pj_log_get_sender_level(sender)	0
+
+/**
+ * Get the statistics of the asynchronous logging mode.
+ *
+ * @param stat	    Pointer to receive the statistics.
+ */
+#  define pj_log_get_async_stat(stat)	PJ_EINVALIDOP
+
 
 /**
  * Internal.
@@ -0,0 +1,198 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_OBJPOOL_H__
+#define __PJ_OBJPOOL_H__
+
+/**
+ * @file objpool.h
+ * @brief Fixed-size Object Pool.
+ */
+
+#include <pj/types.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_OBJPOOL Fixed-size Object Pool
+ * @ingroup PJ_POOL_GROUP
+ * @{
+ *
+ * The object pool (slab allocator) allocates objects of one fixed size,
+ * and unlike @ref PJ_POOL_GROUP, the objects can be returned to the
+ * object pool individually with #pj_objpool_free(). It is suitable for
+ * objects that are allocated and released at high rate and that would
+ * otherwise make a short-lived pj_pool_t grow, such as packet buffers.
+ *
+ * The memory is taken from the pool factory in slabs of several objects.
+ * The slabs are only returned to the pool factory when the object pool is
+ * destroyed.
+ *
+ * The object pool is thread safe. Optionally, each thread may keep a small
+ * cache of free objects (see #PJ_OBJPOOL_THREAD_CACHE), so most
+ * allocations and releases don't need to acquire the object pool lock.
+ */
+
+/**
+ * Object pool creation flags.
+ */
+typedef enum pj_objpool_flag
+{
+    /**
+     * Keep a per-thread cache of free objects, with up to
+     * PJ_OBJPOOL_THREAD_CACHE_SIZE objects per thread. Free objects in
+     * the cache of a thread that has been idle for
+     * PJ_OBJPOOL_THREAD_CACHE_IDLE (e.g. because it has exited) are moved
+     * back to the shared free list. Each object pool with this flag uses
+     * one thread local storage index. The flag is ignored when atomic
+     * builtins are not available.
+     */
+    PJ_OBJPOOL_THREAD_CACHE = 1
+
+} pj_objpool_flag;
+
+
+/**
+ * Object pool usage statistics, as returned by #pj_objpool_get_stat().
+ */
+typedef struct pj_objpool_stat
+{
+    /**
+     * Size of each object, after it is rounded up to the alignment.
+     */
+    pj_size_t	obj_size;
+
+    /**
+     * Number of slabs allocated.
+     */
+    unsigned	slab_cnt;
+
+    /**
+     * Total number of objects in all slabs.
+     */
+    unsigned	capacity;
+
+    /**
+     * Number of objects currently allocated by application. Objects kept
+     * in the per-thread caches are not counted.
+     */
+    unsigned	used_cnt;
+
+    /**
+     * Number of free objects kept in the per-thread caches.
+     */
+    unsigned	cached_cnt;
+
+    /**
+     * Highest number of objects taken from the shared free list. When the
+     * per-thread cache is used, this includes the objects that were in
+     * the caches at that time.
+     */
+    unsigned	peak_cnt;
+
+    /**
+     * Total number of allocations.
+     */
+    pj_uint32_t	alloc_cnt;
+
+    /**
+     * Number of allocations served by the per-thread caches.
+     */
+    pj_uint32_t	cache_hit_cnt;
+
+} pj_objpool_stat;
+
+
+/**
+ * Create a fixed-size object pool.
+ *
+ * @param factory	The pool factory to get the slabs from.
+ * @param name		Name to identify the object pool in the log, or
+ *			NULL. It may contain "%p" like pool names.
+ * @param obj_size	Size of each object, in bytes.
+ * @param objs_per_slab	Number of objects to allocate in each slab.
+ * @param flags		Bitmask combination of #pj_objpool_flag.
+ * @param p_objpool	Pointer to receive the object pool.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_objpool_create(pj_pool_factory *factory,
+				       const char *name,
+				       pj_size_t obj_size,
+				       unsigned objs_per_slab,
+				       unsigned flags,
+				       pj_objpool_t **p_objpool);
+
+/**
+ * Allocate an object. The content of the object is not initialized.
+ *
+ * @param objpool	The object pool.
+ *
+ * @return		The object, or NULL if there is not enough memory.
+ */
+PJ_DECL(void*) pj_objpool_alloc(pj_objpool_t *objpool);
+
+/**
+ * Allocate an object and initialize its content with zero.
+ *
+ * @param objpool	The object pool.
+ *
+ * @return		The object, or NULL if there is not enough memory.
+ */
+PJ_DECL(void*) pj_objpool_zalloc(pj_objpool_t *objpool);
+
+/**
+ * Return an object to the object pool. The object must have been
+ * allocated from the same object pool.
+ *
+ * @param objpool	The object pool.
+ * @param obj		The object.
+ */
+PJ_DECL(void) pj_objpool_free(pj_objpool_t *objpool, void *obj);
+
+/**
+ * Get the object pool usage statistics. The per-thread caches are
+ * examined without synchronizing with their threads, so the values are
+ * approximate while other threads are using the object pool.
+ *
+ * @param objpool	The object pool.
+ * @param stat		Pointer to receive the statistics.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_objpool_get_stat(pj_objpool_t *objpool,
+					 pj_objpool_stat *stat);
+
+/**
+ * Destroy the object pool and return all slabs to the pool factory.
+ * Objects that are still allocated become invalid.
+ *
+ * @param objpool	The object pool.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_objpool_destroy(pj_objpool_t *objpool);
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif	/* __PJ_OBJPOOL_H__ */
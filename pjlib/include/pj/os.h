@@ -271,6 +271,128 @@ PJ_DECL(int) pj_thread_get_prio_min(pj_thread_t *thread);
 PJ_DECL(int) pj_thread_get_prio_max(pj_thread_t *thread);
 
 
+/**
+ * Thread scheduling policies, see #pj_thread_set_sched().
+ */
+typedef enum pj_thread_sched_policy
+{
+    /** The default time-sharing policy of the OS (SCHED_OTHER). */
+    PJ_THREAD_SCHED_DEFAULT,
+
+    /** Real-time first-in first-out policy (SCHED_FIFO). */
+    PJ_THREAD_SCHED_FIFO,
+
+    /** Real-time round-robin policy (SCHED_RR). */
+    PJ_THREAD_SCHED_RR
+
+} pj_thread_sched_policy;
+
+
+/**
+ * Bind the thread to the specified CPUs, so that it is only run on
+ * these CPUs.
+ *
+ * @param thread	Thread handle.
+ * @param cpu		Array of CPU numbers, starting from zero.
+ * @param cpu_cnt	Number of CPUs in the array, must not be zero.
+ *
+ * @return		PJ_SUCCESS on success, PJ_ENOTSUP if the platform
+ *			does not support thread affinity, or the error code.
+ */
+PJ_DECL(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread,
+					    const unsigned cpu[],
+					    unsigned cpu_cnt);
+
+
+/**
+ * Set the scheduling policy and the priority of the thread. Note that the
+ * real-time policies normally need privilege (e.g. CAP_SYS_NICE or
+ * RLIMIT_RTPRIO on Linux), otherwise the OS error for EPERM is returned.
+ *
+ * On Windows, the real-time policies set the thread priority to
+ * THREAD_PRIORITY_TIME_CRITICAL and the default policy to
+ * THREAD_PRIORITY_NORMAL, and \a prio is ignored.
+ *
+ * @param thread	Thread handle.
+ * @param policy	The scheduling policy.
+ * @param prio		The priority within the policy, or zero to use the
+ *			lowest priority of the policy (e.g. 1 to 99 for the
+ *			real-time policies on Linux). It is ignored for
+ *			PJ_THREAD_SCHED_DEFAULT.
+ *
+ * @return		PJ_SUCCESS on success, PJ_EINVAL if the priority is
+ *			out of range, PJ_ENOTSUP if the platform does not
+ *			support it, or the error code.
+ */
+PJ_DECL(pj_status_t) pj_thread_set_sched(pj_thread_t *thread,
+					 pj_thread_sched_policy policy,
+					 int prio);
+
+
+/**
+ * CPU affinity and scheduling settings of a thread, which can be kept in
+ * the configuration of the modules that create threads, and applied with
+ * #pj_thread_set_sched_param().
+ */
+typedef struct pj_thread_sched_param
+{
+    /**
+     * Bind the thread to \a cpu. The CPU affinity of the thread is left
+     * untouched when this is not set, so a zero initialized structure
+     * doesn't bind the thread.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t use_affinity;
+
+    /**
+     * The CPU to bind the thread to, starting from zero, when
+     * \a use_affinity is set.
+     *
+     * Default: 0
+     */
+    unsigned cpu;
+
+    /**
+     * The scheduling policy. The policy and priority of the thread are
+     * left untouched when it is PJ_THREAD_SCHED_DEFAULT.
+     *
+     * Default: PJ_THREAD_SCHED_DEFAULT
+     */
+    pj_thread_sched_policy policy;
+
+    /**
+     * The priority within the policy, see #pj_thread_set_sched().
+     *
+     * Default: 0
+     */
+    int prio;
+
+} pj_thread_sched_param;
+
+
+/**
+ * Initialize the thread scheduling settings with the default values,
+ * which leave the thread untouched.
+ *
+ * @param param		The settings to be initialized.
+ */
+PJ_DECL(void) pj_thread_sched_param_default(pj_thread_sched_param *param);
+
+
+/**
+ * Apply the CPU affinity and scheduling settings to the thread.
+ *
+ * @param thread	Thread handle.
+ * @param param		The settings.
+ *
+ * @return		PJ_SUCCESS on success, or the error code of
+ *			#pj_thread_set_affinity() or #pj_thread_set_sched().
+ */
+PJ_DECL(pj_status_t) pj_thread_set_sched_param(pj_thread_t *thread,
+					const pj_thread_sched_param *param);
+
+
 /**
  * Return native handle from pj_thread_t for manipulation using native
  * OS APIs.
@@ -1177,6 +1299,58 @@ PJ_DECL(pj_color_t) pj_term_get_color(void);
  */
 PJ_DECL(pj_status_t) pj_gettickcount(pj_time_val *tv);
 
+/**
+ * Get the monotonic time like #pj_gettickcount(), with millisecond
+ * accuracy, and without reading the clock in most cases.
+ *
+ * The ioqueue marks the polling thread as dispatching each time its poll
+ * returns with events (#pj_coarse_clock_enter()). The first call in the
+ * poll iteration's callbacks reads the clock and caches the time for the
+ * calling thread, and the later calls until the next poll return the
+ * cached time. Threads that are not dispatching events always read the
+ * clock. The clock is read with pj_gettickcount(), or as set by
+ * PJ_COARSE_CLOCK_USE_MONOTONIC_COARSE. The value may thus be behind by
+ * the time spent in the current poll iteration's callbacks, so this
+ * should only be used where that is tolerable, e.g. for packet arrival
+ * times, and not to measure durations or to schedule timers.
+ *
+ * @param tv	Variable to store the result.
+ *
+ * @return PJ_SUCCESS if successful.
+ */
+PJ_DECL(pj_status_t) pj_gettickcount_coarse(pj_time_val *tv);
+
+/**
+ * Get the wall clock time like #pj_gettimeofday(), with the accuracy of
+ * #pj_gettickcount_coarse(). The difference between the two clocks is
+ * only sampled once per second, so a change of the system time may take
+ * up to a second to be reflected.
+ *
+ * @param tv	Variable to store the result.
+ *
+ * @return PJ_SUCCESS if successful.
+ */
+PJ_DECL(pj_status_t) pj_gettimeofday_coarse(pj_time_val *tv);
+
+/**
+ * Mark the calling thread as dispatching events until
+ * #pj_coarse_clock_leave() is called, and start a new cached time for
+ * #pj_gettickcount_coarse() in this thread. The ioqueue calls this when
+ * its poll returns with events; an application with its own event loop
+ * may call it too. The calls may be nested.
+ *
+ * @param now	The current monotonic time if the caller has just read
+ *		it, to cache it right away, or NULL to read the clock
+ *		when the time is first needed.
+ */
+PJ_DECL(void) pj_coarse_clock_enter(const pj_time_val *now);
+
+/**
+ * Mark the end of the event dispatching started with
+ * #pj_coarse_clock_enter(), typically before waiting for events again.
+ */
+PJ_DECL(void) pj_coarse_clock_leave(void);
+
 /**
  * Acquire high resolution timer value. The time value are stored
  * in cycles.
@@ -725,6 +725,21 @@ struct pj_pool_factory
      */
     void (*on_block_free)(pj_pool_factory *factory, pj_size_t size);
 
+    /**
+     * This is optional callback to be called by the pool when its capacity
+     * changes after it has been created, that is when it allocates an
+     * additional memory block, or when it frees the additional blocks
+     * because it is reset. The factory may use this callback for example
+     * to keep track of the memory used by each kind of pool.
+     *
+     * @param factory	    The pool factory.
+     * @param pool	    The pool.
+     * @param delta	    The change of the pool capacity, positive when
+     *			    the pool grows and negative when it shrinks.
+     */
+    void (*on_pool_resize)(pj_pool_factory *factory, pj_pool_t *pool,
+			   pj_ssize_t delta);
+
 };
 
 /**
@@ -799,6 +814,56 @@ PJ_INLINE(void) pj_pool_factory_dump( pj_pool_factory *pf,
  */
 #define PJ_CACHING_POOL_ARRAY_SIZE	16
 
+/**
+ * Maximum length of a pool category name, including the NULL terminator.
+ */
+#define PJ_POOL_CATEGORY_NAME_LEN	16
+
+/**
+ * Memory accounting of a category of pools in the caching pool. The
+ * category of a pool is its name as given to #pj_pool_create(), up to the
+ * first '%' character, e.g. all pools created with the name "dlg%p" are
+ * counted in the "dlg" category. The counters are exact when the compiler
+ * provides atomic builtins (PJ_HAS_ATOMIC_BUILTINS), otherwise they may
+ * drift when pools are created and released by several threads at once.
+ */
+typedef struct pj_pool_category_stat
+{
+    /** The category name. */
+    char	name[PJ_POOL_CATEGORY_NAME_LEN];
+
+    /** Number of pools of the category currently held by application. */
+    pj_size_t	pool_cnt;
+
+    /** The maximum of @a pool_cnt. */
+    pj_size_t	peak_pool_cnt;
+
+    /** Total capacity of the pools currently held by application. */
+    pj_size_t	capacity;
+
+    /** The maximum of @a capacity. */
+    pj_size_t	peak_capacity;
+
+    /**
+     * Total size allocated by application from the pools currently held,
+     * so that (@a capacity - @a used_size) is the memory which is wasted
+     * because the pools are larger than needed. This is only calculated
+     * by #pj_caching_pool_get_category_stat().
+     */
+    pj_size_t	used_size;
+
+    /** Number of pools of the category created so far. */
+    pj_size_t	create_cnt;
+
+    /**
+     * Number of additional memory blocks allocated by the pools, i.e. the
+     * number of times the pools had to grow because the initial size is
+     * too small.
+     */
+    pj_size_t	grow_cnt;
+
+} pj_pool_category_stat;
+
 /**
  * Declaration for caching pool. Application doesn't normally need to
  * care about the contents of this struct, it is only provided here because
@@ -862,6 +927,46 @@ struct pj_caching_pool
      * Mutex.
      */
     pj_lock_t	   *lock;
+
+    /**
+     * Maximum number of released pools of each size class to be kept in
+     * the per-thread magazine, or zero if the magazine layer is disabled.
+     * Pools kept in the magazines are counted in @a capacity, not in
+     * @a used_count.
+     */
+    unsigned	    magazine_size;
+
+    /**
+     * Thread local storage index to get the magazine of current thread.
+     */
+    long	    magazine_tls;
+
+    /**
+     * List of all magazines created by this caching pool.
+     */
+    pj_list	    magazine_list;
+
+    /**
+     * Time of the next sweep of the idle magazines.
+     */
+    pj_time_val	    magazine_sweep;
+
+    /**
+     * Memory accounting per pool category. The last entry is used for the
+     * pools of all categories that do not fit in the array.
+     */
+    pj_pool_category_stat category[PJ_CACHING_POOL_MAX_CATEGORY];
+
+    /**
+     * Number of categories in @a category, excluding the last entry.
+     */
+    unsigned	    category_cnt;
+
+    /**
+     * Category index plus one of the recently created pools, indexed by
+     * a hash of the pool name pointer. Zero means empty.
+     */
+    unsigned	    category_cache[PJ_CACHING_POOL_CATEGORY_CACHE];
 };
 
 
@@ -889,6 +994,67 @@ PJ_DECL(void) pj_caching_pool_init( pj_caching_pool *ch_pool,
  */
 PJ_DECL(void) pj_caching_pool_destroy( pj_caching_pool *ch_pool );
 
+/**
+ * Set the number of released pools of each size class to be kept in the
+ * per-thread magazine. When a pool is released, it is put in the
+ * magazine of the calling thread if the magazine is not full, and
+ * #pj_pool_create() takes pools from the magazine of the calling thread
+ * first, so the caching pool lock is only used when the magazine is
+ * empty or full. The pools in the magazines count against the maximum
+ * capacity of the caching pool, and the pools of a magazine which has
+ * not been used for PJ_CACHING_POOL_MAGAZINE_IDLE msec (e.g. because its
+ * thread has exited) are moved to the free list by the next operation
+ * which takes the caching pool lock.
+ *
+ * This function must be called before any pool is created from the
+ * caching pool. The initial value is PJ_CACHING_POOL_MAGAZINE_SIZE.
+ * The magazines require PJ_HAS_ATOMIC_BUILTINS, otherwise PJ_ENOTSUP
+ * is returned.
+ *
+ * @param ch_pool	The caching pool.
+ * @param size		Maximum number of pools of each size class to be
+ *			kept per thread, or zero to disable the magazines.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_caching_pool_set_magazine(pj_caching_pool *ch_pool,
+						  unsigned size);
+
+/**
+ * Get the memory accounting of the pool categories of the caching pool,
+ * see #pj_pool_category_stat. Note that this walks all the pools which are
+ * held by application to calculate their used size.
+ *
+ * @param ch_pool	The caching pool.
+ * @param stat		Array to receive the accounting of each category.
+ * @param count		On input, the size of the array. On output, the
+ *			number of categories returned.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_caching_pool_get_category_stat(
+					    pj_caching_pool *ch_pool,
+					    pj_pool_category_stat stat[],
+					    unsigned *count);
+
+/**
+ * Print the memory accounting of the pool categories of the caching pool
+ * in JSON format, as an object with a "categories" array containing an
+ * object for each category, whose members are the fields of
+ * #pj_pool_category_stat, to be processed by tools, e.g. to find the
+ * right initial size of each kind of pool.
+ *
+ * @param ch_pool	The caching pool.
+ * @param buf		Buffer to receive the NULL terminated output.
+ * @param size		Size of the buffer.
+ *
+ * @return		The length of the output, or -1 if the buffer is
+ *			too small.
+ */
+PJ_DECL(int) pj_caching_pool_print_category_stat(pj_caching_pool *ch_pool,
+						 char *buf,
+						 pj_size_t size);
+
 /**
  * @}	// PJ_CACHING_POOL
  */
@@ -193,6 +193,9 @@ typedef struct pj_pool_block
 #define pj_caching_pool_init( cp, pol, mac)
 #define pj_caching_pool_destroy(cp)
 #define pj_pool_factory_dump(pf, detail)
+#define pj_caching_pool_get_category_stat(cp, stat, cnt) \
+	    (*(cnt) = 0, PJ_SUCCESS)
+#define pj_caching_pool_print_category_stat(cp, buf, size)	(-1)
 
 #endif	/* __PJ_POOL_ALT_H__ */
 
@@ -0,0 +1,188 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_RINGBUF_H__
+#define __PJ_RINGBUF_H__
+
+/**
+ * @file ringbuf.h
+ * @brief Lock-free Ring Buffer.
+ */
+
+#include <pj/types.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_RINGBUF Lock-free Ring Buffer
+ * @ingroup PJ_DS
+ * @{
+ *
+ * The ring buffer is a bounded FIFO queue of fixed-size slots, to hand
+ * data such as audio frames or events from one thread to another without
+ * locking. It has one consumer, and either one producer (the default) or
+ * several producers (#PJ_RINGBUF_MULTI_PRODUCER).
+ *
+ * The slots can be filled and read in place with #pj_ringbuf_acquire(),
+ * #pj_ringbuf_commit(), #pj_ringbuf_peek() and #pj_ringbuf_release(), or
+ * copied with #pj_ringbuf_push() and #pj_ringbuf_pop(). Neither blocks:
+ * the producer gets an error when the ring buffer is full, and the
+ * consumer when it is empty, so the application decides whether to drop
+ * or to wait (e.g. with a semaphore).
+ *
+ * The producer and consumer indexes are kept in separate cache lines (see
+ * #PJ_CACHE_LINE_SIZE). Each slot has its own sequence number, so the
+ * producers and the consumer only touch the slots they use. When the
+ * compiler doesn't provide atomic builtins (#PJ_HAS_ATOMIC_BUILTINS), the
+ * ring buffer uses a mutex instead.
+ */
+
+/**
+ * Opaque data type for the ring buffer.
+ */
+typedef struct pj_ringbuf_t pj_ringbuf_t;
+
+/**
+ * Ring buffer creation flags.
+ */
+typedef enum pj_ringbuf_flag
+{
+    /**
+     * Allow several threads to produce at the same time. Without this
+     * flag, only one thread at a time may call #pj_ringbuf_acquire() or
+     * #pj_ringbuf_push().
+     */
+    PJ_RINGBUF_MULTI_PRODUCER = 1
+
+} pj_ringbuf_flag;
+
+
+/**
+ * Create a ring buffer.
+ *
+ * @param pool		Pool to allocate the ring buffer from.
+ * @param slot_size	Size of each slot, in bytes.
+ * @param slot_cnt	Number of slots. It is rounded up to the power of
+ *			two.
+ * @param flags		Bitmask combination of #pj_ringbuf_flag.
+ * @param p_rb		Pointer to receive the ring buffer.
+ *
+ * @return		PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_ringbuf_create(pj_pool_t *pool,
+				       unsigned slot_size,
+				       unsigned slot_cnt,
+				       unsigned flags,
+				       pj_ringbuf_t **p_rb);
+
+/**
+ * Get a free slot to fill, at the end of the queue. The slot must be
+ * passed to #pj_ringbuf_commit() when it is filled, and until then the
+ * consumer can't see it, nor the slots acquired after it.
+ *
+ * @param rb		The ring buffer.
+ *
+ * @return		The slot, aligned to pointer size, or NULL if the
+ *			ring buffer is full.
+ */
+PJ_DECL(void*) pj_ringbuf_acquire(pj_ringbuf_t *rb);
+
+/**
+ * Make the slot from #pj_ringbuf_acquire() available to the consumer.
+ *
+ * @param rb		The ring buffer.
+ * @param slot		The slot.
+ */
+PJ_DECL(void) pj_ringbuf_commit(pj_ringbuf_t *rb, void *slot);
+
+/**
+ * Get the oldest slot, without removing it from the queue. Only the
+ * consumer thread may call this function.
+ *
+ * @param rb		The ring buffer.
+ *
+ * @return		The slot, or NULL if the ring buffer is empty.
+ */
+PJ_DECL(void*) pj_ringbuf_peek(pj_ringbuf_t *rb);
+
+/**
+ * Remove the oldest slot, which was returned by #pj_ringbuf_peek(), from
+ * the queue, so that it can be reused by the producers.
+ *
+ * @param rb		The ring buffer.
+ */
+PJ_DECL(void) pj_ringbuf_release(pj_ringbuf_t *rb);
+
+/**
+ * Copy the data to a free slot at the end of the queue.
+ *
+ * @param rb		The ring buffer.
+ * @param data		The data, which size is the slot size.
+ *
+ * @return		PJ_SUCCESS, or PJ_ETOOMANY if the ring buffer is
+ *			full.
+ */
+PJ_DECL(pj_status_t) pj_ringbuf_push(pj_ringbuf_t *rb, const void *data);
+
+/**
+ * Copy the oldest slot to the buffer and remove it from the queue. Only
+ * the consumer thread may call this function.
+ *
+ * @param rb		The ring buffer.
+ * @param data		Buffer to receive the data, which size is the slot
+ *			size.
+ *
+ * @return		PJ_SUCCESS, or PJ_ENOTFOUND if the ring buffer is
+ *			empty.
+ */
+PJ_DECL(pj_status_t) pj_ringbuf_pop(pj_ringbuf_t *rb, void *data);
+
+/**
+ * Get the number of slots in the queue. The value may be out of date
+ * by the time it is returned if other threads are using the ring buffer.
+ *
+ * @param rb		The ring buffer.
+ *
+ * @return		The number of slots in the queue.
+ */
+PJ_DECL(unsigned) pj_ringbuf_get_count(pj_ringbuf_t *rb);
+
+/**
+ * Get the capacity of the ring buffer.
+ *
+ * @param rb		The ring buffer.
+ *
+ * @return		The number of slots.
+ */
+PJ_DECL(unsigned) pj_ringbuf_get_capacity(pj_ringbuf_t *rb);
+
+/**
+ * Destroy the ring buffer. The memory is released with the pool.
+ *
+ * @param rb		The ring buffer.
+ */
+PJ_DECL(void) pj_ringbuf_destroy(pj_ringbuf_t *rb);
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif	/* __PJ_RINGBUF_H__ */
@@ -297,6 +297,11 @@ extern const pj_uint16_t PJ_TCP_NODELAY;
  *  @see pj_SO_REUSEADDR */
 extern const pj_uint16_t PJ_SO_REUSEADDR;
 
+/** Allows several sockets to be bound to the same address and port, with
+ *  the incoming traffic spread among them by the kernel. The value is
+ *  0xFFFF when it is not supported by the platform. @see pj_SO_REUSEPORT */
+extern const pj_uint16_t PJ_SO_REUSEPORT;
+
 /** Do not generate SIGPIPE. @see pj_SO_NOSIGPIPE */
 extern const pj_uint16_t PJ_SO_NOSIGPIPE;
 
@@ -336,6 +341,9 @@ extern const pj_uint16_t PJ_IP_DROP_MEMBERSHIP;
     /** Get #PJ_SO_REUSEADDR constant */
     PJ_DECL(pj_uint16_t) pj_SO_REUSEADDR(void);
 
+    /** Get #PJ_SO_REUSEPORT constant */
+    PJ_DECL(pj_uint16_t) pj_SO_REUSEPORT(void);
+
     /** Get #PJ_SO_NOSIGPIPE constant */
     PJ_DECL(pj_uint16_t) pj_SO_NOSIGPIPE(void);
 
@@ -372,6 +380,9 @@ extern const pj_uint16_t PJ_IP_DROP_MEMBERSHIP;
     /** Get #PJ_SO_REUSEADDR constant */
 #   define pj_SO_REUSEADDR() PJ_SO_REUSEADDR
 
+    /** Get #PJ_SO_REUSEPORT constant */
+#   define pj_SO_REUSEPORT() PJ_SO_REUSEPORT
+
     /** Get #PJ_SO_NOSIGPIPE constant */
 #   define pj_SO_NOSIGPIPE() PJ_SO_NOSIGPIPE
 
@@ -1404,6 +1415,85 @@ PJ_DECL(pj_status_t) pj_sock_sendto(pj_sock_t sockfd,
 				    const pj_sockaddr_t *to,
 				    int tolen);
 
+/**
+ * This structure describes one datagram in a batch receive or send
+ * operation, see #pj_sock_recvmmsg() and #pj_sock_sendmmsg().
+ */
+typedef struct pj_sock_msg
+{
+    /** The packet buffer. */
+    void	*buf;
+
+    /** For receive, on input this is the size of the buffer and upon
+     *  return it contains the size of the datagram. For send, this is
+     *  the length of the datagram on input and the number of bytes sent
+     *  upon return.
+     */
+    pj_ssize_t	 len;
+
+    /** The source address (receive) or the destination address (send). */
+    pj_sockaddr	 addr;
+
+    /** For receive, on input this is the size of the address buffer and
+     *  upon return it contains the length of the source address. For send,
+     *  this is the length of the destination address, or zero to send
+     *  to the peer address of a connected socket.
+     */
+    int		 addr_len;
+
+} pj_sock_msg;
+
+/**
+ * Receive multiple datagrams from the socket with a single call. On
+ * platforms that support recvmmsg() (see PJ_SOCK_HAS_RECVMMSG) this is done
+ * with one system call, otherwise the function is emulated by calling
+ * recvfrom() repeatedly until the socket would block. This function does
+ * not block waiting for more datagrams once at least one datagram has
+ * been received, however it will block waiting for the first datagram if
+ * the socket is in blocking mode. On platforms without MSG_DONTWAIT, the
+ * emulation requires the socket to be in non-blocking mode.
+ *
+ * @param sockfd	The socket descriptor.
+ * @param msg		Array of datagram descriptors. For each element,
+ *			application must set the \a buf, \a len, and
+ *			\a addr_len fields before calling this function.
+ * @param count		On input, the number of elements in the array.
+ *			Upon return, it will be filled with the number of
+ *			datagrams received.
+ * @param flags		Flags to be given to recvfrom()/recvmmsg().
+ *
+ * @return		PJ_SUCCESS if at least one datagram has been
+ *			received, or the status code of the first failure
+ *			(which can be EWOULDBLOCK) otherwise.
+ */
+PJ_DECL(pj_status_t) pj_sock_recvmmsg(pj_sock_t sockfd,
+				      pj_sock_msg msg[],
+				      unsigned *count,
+				      unsigned flags);
+
+/**
+ * Transmit multiple datagrams with a single call. On platforms that
+ * support sendmmsg() (see PJ_SOCK_HAS_SENDMMSG) this is done with one
+ * system call, otherwise the function is emulated by calling sendto()
+ * for each datagram. Transmission stops at the first datagram that
+ * fails to be sent.
+ *
+ * @param sockfd	The socket descriptor.
+ * @param msg		Array of datagram descriptors, each containing the
+ *			packet and its destination address.
+ * @param count		On input, the number of elements in the array.
+ *			Upon return, it will be filled with the number of
+ *			datagrams sent.
+ * @param flags		Flags to be given to sendto()/sendmmsg().
+ *
+ * @return		PJ_SUCCESS if at least one datagram has been sent,
+ *			or the status code of the first failure otherwise.
+ */
+PJ_DECL(pj_status_t) pj_sock_sendmmsg(pj_sock_t sockfd,
+				      pj_sock_msg msg[],
+				      unsigned *count,
+				      unsigned flags);
+
 #if PJ_HAS_TCP
 /**
  * The shutdown call causes all or part of a full-duplex connection on the
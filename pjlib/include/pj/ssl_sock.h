@@ -24,6 +24,7 @@
  * @brief Secure socket
  */
 
+#include <pj/executor.h>
 #include <pj/ioqueue.h>
 #include <pj/sock.h>
 #include <pj/sock_qos.h>
@@ -547,9 +548,50 @@ typedef struct pj_ssl_sock_info
      */
     unsigned long	last_native_err;
 
+    /**
+     * Describes whether the connection was established by resuming a
+     * previous session (abbreviated handshake), see \a sess_cache in
+     * #pj_ssl_sock_param.
+     */
+    pj_bool_t		sess_reused;
+
 } pj_ssl_sock_info;
 
 
+/**
+ * Session resumption statistics, see #pj_ssl_sock_get_sess_stat().
+ */
+typedef struct pj_ssl_sock_sess_stat
+{
+    /**
+     * Number of SSL contexts currently kept for sharing.
+     */
+    unsigned		ctx_cnt;
+
+    /**
+     * Number of accepted connections that resumed a session, either from
+     * the session cache or from a session ticket.
+     */
+    pj_uint32_t		server_hit;
+
+    /**
+     * Number of accepted connections that did a full handshake.
+     */
+    pj_uint32_t		server_miss;
+
+    /**
+     * Number of outgoing connections that resumed a session.
+     */
+    pj_uint32_t		client_hit;
+
+    /**
+     * Number of outgoing connections that did a full handshake.
+     */
+    pj_uint32_t		client_miss;
+
+} pj_ssl_sock_sess_stat;
+
+
 /**
  * Definition of secure socket creation parameters.
  */
@@ -744,6 +786,38 @@ typedef struct pj_ssl_sock_param
      */
     pj_bool_t qos_ignore_error;
 
+    /**
+     * Enable TLS session resumption. The secure sockets with the same
+     * protocol, role and certificate files will share one SSL context,
+     * instead of creating one for each socket, so that:
+     *  - as server, the sessions are kept in the context's session cache
+     *    and session tickets can be decrypted by any of the sockets.
+     *  - as client, the last session to each remote address and server
+     *    name is kept and offered again on the next connection.
+     *
+     * A resumed session skips the public key operations of the full
+     * handshake, see \a sess_reused in #pj_ssl_sock_info.
+     *
+     * Default: PJ_TRUE
+     */
+    pj_bool_t sess_cache;
+
+    /**
+     * Executor to run the SSL handshake on. When it is set, the handshake
+     * steps that process the data received from the peer, which contain
+     * the costly public key operations, are run by the executor's worker
+     * thread instead of the thread polling the ioqueue, and the socket
+     * doesn't read further data until the step has completed. The
+     * \a on_accept_complete() and \a on_connect_complete() callbacks
+     * may then be called by the worker thread.
+     *
+     * This prevents a burst of new connections from delaying the other
+     * sockets that share the ioqueue. The executor must outlive the
+     * secure sockets.
+     *
+     * Default: NULL (the handshake is run by the ioqueue thread)
+     */
+    pj_executor_t *handshake_exec;
 
 } pj_ssl_sock_param;
 
@@ -1050,6 +1124,17 @@ PJ_DECL(pj_status_t) pj_ssl_sock_start_connect(pj_ssl_sock_t *ssock,
 PJ_DECL(pj_status_t) pj_ssl_sock_renegotiate(pj_ssl_sock_t *ssock);
 
 
+/**
+ * Get the session resumption statistics of all secure sockets.
+ *
+ * @param stat		Pointer to receive the statistics.
+ *
+ * @return		PJ_SUCCESS on success, or PJ_ENOTSUP if the backend
+ *			doesn't support session resumption.
+ */
+PJ_DECL(pj_status_t) pj_ssl_sock_get_sess_stat(pj_ssl_sock_sess_stat *stat);
+
+
 /**
  * @}
  */
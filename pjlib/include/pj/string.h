@@ -342,7 +342,11 @@ PJ_IDECL(int) pj_strncmp2( const pj_str_t *str1, const char *str2,
 			   pj_size_t len);
 
 /**
- * Perform case-insensitive comparison to the strings.
+ * Perform case-insensitive comparison to the strings. Only the case of
+ * ASCII letters is ignored. Like pj_strcmp(), the comparison covers the
+ * whole length of the strings, including NULL characters inside the
+ * strings, so strings that only differ after an embedded NULL character
+ * are not equal (pj_ansi_strnicmp() would stop at the NULL character).
  *
  * @param str1	    The string to compare.
  * @param str2	    The string to compare.
@@ -497,6 +501,30 @@ PJ_DECL(char*) pj_strstr(const pj_str_t *str, const pj_str_t *substr);
  */
 PJ_DECL(char*) pj_stristr(const pj_str_t *str, const pj_str_t *substr);
 
+/**
+ * The implementations of the string comparison and search functions that
+ * use SIMD instructions (see #PJ_HAS_SIMD_STRING).
+ */
+typedef enum pj_str_simd
+{
+    PJ_STR_SIMD_NONE,	    /**< Scalar implementation.		    */
+    PJ_STR_SIMD_SSE2,	    /**< SSE2 implementation.		    */
+    PJ_STR_SIMD_AVX2	    /**< AVX2 implementation.		    */
+} pj_str_simd;
+
+/**
+ * Select the implementation of pj_memicmp(), pj_stricmp() and friends,
+ * pj_strstr() and pj_stristr(). By default the best implementation that
+ * the CPU supports is used. This is mainly useful for testing and
+ * benchmarking the implementations against each other.
+ *
+ * @param max	    The highest implementation to use.
+ *
+ * @return	    The implementation that is used, which is lower than
+ *		    \a max if the CPU or the build doesn't support it.
+ */
+PJ_DECL(pj_str_simd) pj_str_set_simd(pj_str_simd max);
+
 /**
  * Remove (trim) leading whitespaces from the string.
  *
@@ -682,6 +710,19 @@ PJ_INLINE(int) pj_memcmp(const void *buf1, const void *buf2, pj_size_t size)
     return memcmp(buf1, buf2, size);
 }
 
+/**
+ * Compare buffers, ignoring the case of ASCII letters. Unlike
+ * pj_ansi_strnicmp(), the comparison doesn't stop at NULL character and
+ * doesn't depend on the locale.
+ *
+ * @param buf1	    The first buffer.
+ * @param buf2	    The second buffer.
+ * @param size	    The size to compare.
+ *
+ * @return negative, zero, or positive value.
+ */
+PJ_DECL(int) pj_memicmp(const void *buf1, const void *buf2, pj_size_t size);
+
 /**
  * Find character in the buffer.
  *
@@ -52,6 +52,15 @@ PJ_BEGIN_DECL
  *
  * ACE is Copyright (C)1993-2006 Douglas C. Schmidt <d.schmidt@vanderbilt.edu>
  *
+ * Alternatively, the timer heap can be implemented with a hierarchical
+ * timing wheel, by setting PJ_TIMER_HEAP_IMPLEMENTATION to
+ * PJ_TIMER_HEAP_WHEEL in config_site.h. With the timing wheel, scheduling
+ * and canceling timers is O(1) regardless of the number of timers, which
+ * suits applications with very large number of timers (such as SIP
+ * servers with many concurrent transactions). The timer resolution is
+ * then limited to PJ_TIMER_WHEEL_RESOLUTION. The API is the same for
+ * both implementations.
+ *
  * @{
  *
  * \section pj_timer_examples_sec Examples
@@ -125,6 +134,13 @@ typedef struct pj_timer_entry
      */
     pj_grp_lock_t *_grp_lock;
 
+    /**
+     * Internal: the index of the shard where the entry is scheduled, when
+     * the entry is scheduled to a sharded timer heap (see
+     * #pj_timer_heap_create_sharded()).
+     */
+    unsigned _shard_id;
+
 #if PJ_TIMER_DEBUG
     const char	*src_file;
     int		 src_line;
@@ -159,6 +175,57 @@ PJ_DECL(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
 					   pj_size_t count,
                                            pj_timer_heap_t **ht);
 
+/**
+ * Create a sharded timer heap. A sharded timer heap consists of several
+ * timer heaps (shards), each with its own lock, so that threads which
+ * schedule and poll timers concurrently do not contend for a single lock.
+ *
+ * Each thread that polls the timer heap with #pj_timer_heap_poll() is
+ * bound to a shard (assigned in round robin fashion on its first poll, or
+ * explicitly with #pj_timer_heap_set_thread_shard()), and polls that
+ * shard and the shards that are not bound to any thread. Entries scheduled
+ * by a thread go to the shard of that thread, or to a shard selected in
+ * round robin fashion if the thread is not bound. The shard is recorded
+ * in the entry, so the entry can be cancelled from any thread.
+ *
+ * All timer heap functions can be used with a sharded timer heap. The
+ * timer heap passed to the entry's callback is the sharded timer heap.
+ * A shard whose owner thread has not polled it for
+ * PJ_TIMER_SHARD_IDLE_TIMEOUT msec is also polled by the other threads,
+ * so a thread may stop polling (or exit) without leaving its timers
+ * unprocessed, although they may be fired up to that long late.
+ *
+ * Each shard uses its own recursive mutex, so the lock set with
+ * #pj_timer_heap_set_lock() is not used for the shards.
+ *
+ * @param pool      The pool where allocations in the timer heap will be
+ *                  allocated.
+ * @param count     The maximum number of timer entries to be supported
+ *                  initially, which is divided among the shards.
+ * @param shard_cnt Number of shards, normally equal to the number of
+ *                  threads which poll the timer heap.
+ * @param ht        Pointer to receive the created timer heap.
+ *
+ * @return          PJ_SUCCESS, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_timer_heap_create_sharded( pj_pool_t *pool,
+						   pj_size_t count,
+						   unsigned shard_cnt,
+						   pj_timer_heap_t **ht);
+
+/**
+ * Bind the calling thread to the specified shard of a sharded timer heap.
+ * Entries scheduled by this thread will go to this shard, and
+ * #pj_timer_heap_poll() called by this thread will poll this shard.
+ *
+ * @param ht        The sharded timer heap.
+ * @param shard_id  The shard index, must be less than the shard count.
+ *
+ * @return          PJ_SUCCESS, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_timer_heap_set_thread_shard( pj_timer_heap_t *ht,
+						     unsigned shard_id );
+
 /**
  * Destroy the timer heap.
  *
@@ -0,0 +1,162 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef __PJ_TRACE_H__
+#define __PJ_TRACE_H__
+
+/**
+ * @file trace.h
+ * @brief Hot-path Tracing.
+ */
+
+#include <pj/types.h>
+
+PJ_BEGIN_DECL
+
+/**
+ * @defgroup PJ_TRACE Hot-path Tracing
+ * @ingroup PJ_MISC
+ * @{
+ *
+ * The tracing facility records timestamped events from the hot paths of
+ * the library, to see where a SIP message or a media frame spends its
+ * time across the layers. The events are written to the Chrome trace
+ * event format with #pj_trace_dump(), which can be loaded in
+ * chrome://tracing or Perfetto.
+ *
+ * A duration is marked with PJ_TRACE_BEGIN() and PJ_TRACE_END() with the
+ * same category and name, in the same thread, and a point in time with
+ * PJ_TRACE_INSTANT(). The category and name must be string literals (or
+ * otherwise stay valid until the trace is dumped), as only the pointers
+ * are recorded.
+ *
+ * Each thread records its events in its own ring buffer, without locking
+ * and without calling the pool, so tracing can be left running in
+ * production. When the ring buffer is full, the oldest events of the
+ * thread are overwritten, hence the dump contains the most recent events.
+ * The ring buffer is allocated when the thread records its first event.
+ * When the thread hasn't recorded any event for #PJ_TRACE_RING_IDLE msec,
+ * e.g. because it has exited, its events are discarded and the ring
+ * buffer is reused by the next thread that starts recording. The ring
+ * buffers of threads that are not registered with pjlib are only released
+ * by pj_shutdown().
+ *
+ * The markers compile to nothing unless #PJ_HAS_TRACE is enabled, and do
+ * nothing until #pj_trace_start() is called.
+ */
+
+/**
+ * Event phases, the values are the phase names of the Chrome trace event
+ * format.
+ */
+typedef enum pj_trace_phase
+{
+    /** Start of a duration. */
+    PJ_TRACE_PHASE_BEGIN = 'B',
+
+    /** End of a duration. */
+    PJ_TRACE_PHASE_END = 'E',
+
+    /** A point in time. */
+    PJ_TRACE_PHASE_INSTANT = 'i'
+
+} pj_trace_phase;
+
+#if PJ_HAS_TRACE
+/** Mark the start of a duration. */
+#   define PJ_TRACE_BEGIN(cat, name) \
+	    pj_trace_event(cat, name, PJ_TRACE_PHASE_BEGIN)
+/** Mark the end of a duration started with PJ_TRACE_BEGIN(). */
+#   define PJ_TRACE_END(cat, name) \
+	    pj_trace_event(cat, name, PJ_TRACE_PHASE_END)
+/** Mark a point in time. */
+#   define PJ_TRACE_INSTANT(cat, name) \
+	    pj_trace_event(cat, name, PJ_TRACE_PHASE_INSTANT)
+#else
+#   define PJ_TRACE_BEGIN(cat, name)
+#   define PJ_TRACE_END(cat, name)
+#   define PJ_TRACE_INSTANT(cat, name)
+#endif
+
+/**
+ * Start (or resume) recording the trace events.
+ *
+ * The ring buffers are allocated from a private pool factory, with the
+ * ring buffer size given to the first call, and are kept, along with the
+ * recorded events, until pj_shutdown(). The subsequent calls must give
+ * the same size, or zero.
+ *
+ * @param ring_size	Number of events in the ring buffer of each thread,
+ *			or zero to use #PJ_TRACE_RING_SIZE (or the size of
+ *			the first call). It is rounded up to a power of two.
+ *
+ * @return		PJ_SUCCESS on success, PJ_ENOTSUP if atomic builtins
+ *			are not available, PJ_EINVALIDOP if the ring buffer
+ *			size differs from the first call, or the appropriate
+ *			error code.
+ */
+PJ_DECL(pj_status_t) pj_trace_start(unsigned ring_size);
+
+/**
+ * Stop recording the trace events. The recorded events are kept, so they
+ * can be dumped without new events being added in the meantime.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_trace_stop(void);
+
+/**
+ * Discard the recorded events of all threads. Recording must be stopped.
+ *
+ * @return		PJ_SUCCESS on success, or PJ_EINVALIDOP if recording
+ *			is running.
+ */
+PJ_DECL(pj_status_t) pj_trace_clear(void);
+
+/**
+ * Record an event in the ring buffer of the calling thread. Application
+ * normally uses the PJ_TRACE_BEGIN(), PJ_TRACE_END() and
+ * PJ_TRACE_INSTANT() macros instead.
+ *
+ * @param cat		The category, e.g. "sip" or "media".
+ * @param name		The event name.
+ * @param phase		The event phase.
+ */
+PJ_DECL(void) pj_trace_event(const char *cat, const char *name,
+			     pj_trace_phase phase);
+
+/**
+ * Write the recorded events of all threads to a file in the Chrome trace
+ * event (JSON) format. Recording may be running, in which case the events
+ * that are overwritten while the dump is in progress are skipped.
+ *
+ * @param filename	The output file name.
+ *
+ * @return		PJ_SUCCESS on success, PJ_EINVALIDOP if the tracing
+ *			was never started, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_trace_dump(const char *filename);
+
+/**
+ * @}
+ */
+
+PJ_END_DECL
+
+#endif	/* __PJ_TRACE_H__ */
@@ -193,6 +193,11 @@ typedef struct pj_pool_factory pj_pool_factory;
  */
 typedef struct pj_pool_t pj_pool_t;
 
+/**
+ * Opaque data type for fixed-size object pool.
+ */
+typedef struct pj_objpool_t pj_objpool_t;
+
 /**
  * Forward declaration for caching pool, a pool factory implementation.
  */
@@ -33,6 +33,7 @@
 #include <pj/ctype.h>
 #include <pj/errno.h>
 #include <pj/except.h>
+#include <pj/executor.h>
 #include <pj/fifobuf.h>
 #include <pj/file_access.h>
 #include <pj/file_io.h>
@@ -44,17 +45,20 @@
 #include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/math.h>
+#include <pj/objpool.h>
 #include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/pool_buf.h>
 #include <pj/rand.h>
 #include <pj/rbtree.h>
+#include <pj/ringbuf.h>
 #include <pj/sock.h>
 #include <pj/sock_qos.h>
 #include <pj/sock_select.h>
 #include <pj/ssl_sock.h>
 #include <pj/string.h>
 #include <pj/timer.h>
+#include <pj/trace.h>
 #include <pj/unicode.h>
 
 #include <pj/compat/high_precision.h>
@@ -21,6 +21,8 @@
 #include <pj/compat/socket.h>
 #include <pj/assert.h>
 #include <pj/errno.h>
+#include <pj/list.h>
+#include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/pool.h>
 #include <pj/sock.h>
@@ -50,14 +52,39 @@ enum shutdown_dir
     SHUT_TX = 2
 };
 
+/* A buffer lent to the application (buffer lending mode) */
+struct pj_activesock_buf
+{
+    PJ_DECL_LIST_MEMBER(struct pj_activesock_buf);
+    struct buf_pool	*bp;
+    pj_uint8_t		*data;
+    unsigned		 ref_cnt;
+};
+
+/* The pool of lent buffers. It is referenced by the active socket and by
+ * each buffer that the application holds, so that the buffers outlive
+ * the active socket.
+ */
+struct buf_pool
+{
+    pj_pool_t		*pool;
+    pj_lock_t		*lock;
+    unsigned		 buf_size;
+    unsigned		 ref_cnt;
+    pj_activesock_buf	 free_list;
+};
+
 struct read_op
 {
     pj_ioqueue_op_key_t	 op_key;
+    pj_activesock_buf	*buf;
     pj_uint8_t		*pkt;
     unsigned		 max_size;
     pj_size_t		 size;
     pj_sockaddr		 src_addr;
     int			 src_addr_len;
+    pj_sock_msg		*batch;
+    pj_bool_t		 parked;
 };
 
 struct accept_op
@@ -79,6 +106,8 @@ struct send_data
 struct pj_activesock_t
 {
     pj_ioqueue_key_t	*key;
+    pj_grp_lock_t	*grp_lock;
+    pj_sock_t		 sock;
     pj_bool_t		 stream_oriented;
     pj_bool_t		 whole_data;
     pj_ioqueue_t	*ioqueue;
@@ -86,11 +115,11 @@ struct pj_activesock_t
     unsigned		 async_count;
     unsigned	 	 shutdown;
     unsigned		 max_loop;
+    unsigned		 batch_cnt;
     pj_activesock_cb	 cb;
 #if defined(PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT) && \
     PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT!=0
     int			 bg_setting;
-    pj_sock_t		 sock;
     CFReadStreamRef	 readStream;
 #endif
     
@@ -101,7 +130,9 @@ struct pj_activesock_t
 
     struct read_op	*read_op;
     pj_uint32_t		 read_flags;
+    pj_bool_t		 read_paused;
     enum read_type	 read_type;
+    struct buf_pool	*buf_pool;
 
     struct accept_op	*accept_op;
 };
@@ -128,6 +159,7 @@ PJ_DEF(void) pj_activesock_cfg_default(pj_activesock_cfg *cfg)
     cfg->async_cnt = 1;
     cfg->concurrency = -1;
     cfg->whole_data = PJ_TRUE;
+    cfg->batch_cnt = PJ_ACTIVESOCK_RECV_BATCH;
 }
 
 #if defined(PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT) && \
@@ -181,6 +213,122 @@ PJ_DEF(void) pj_activesock_enable_iphone_os_bg(pj_bool_t val)
 }
 #endif
 
+static void buf_pool_dec_ref(struct buf_pool *bp)
+{
+    pj_bool_t destroy;
+
+    pj_lock_acquire(bp->lock);
+    destroy = (--bp->ref_cnt == 0);
+    pj_lock_release(bp->lock);
+
+    if (destroy) {
+	pj_lock_destroy(bp->lock);
+	pj_pool_release(bp->pool);
+    }
+}
+
+static void buf_pool_on_destroy(void *arg)
+{
+    buf_pool_dec_ref((struct buf_pool*)arg);
+}
+
+static pj_status_t create_buf_pool(pj_activesock_t *asock,
+				   pj_pool_t *pool,
+				   unsigned buff_size)
+{
+    pj_pool_t *bp_pool;
+    struct buf_pool *bp;
+    pj_size_t size;
+    pj_status_t status;
+
+    /* Enough for the buffers of the pending reads, and grow in chunks of
+     * several buffers as the application holds more of them.
+     */
+    size = sizeof(pj_activesock_buf) + buff_size;
+    bp_pool = pj_pool_create(pool->factory, "asockbuf%p",
+			     sizeof(*bp) + asock->async_count * size + 512,
+			     8 * size, NULL);
+    if (!bp_pool)
+	return PJ_ENOMEM;
+
+    bp = PJ_POOL_ZALLOC_T(bp_pool, struct buf_pool);
+    bp->pool = bp_pool;
+    bp->buf_size = buff_size;
+    bp->ref_cnt = 1;
+    pj_list_init(&bp->free_list);
+
+    status = pj_lock_create_simple_mutex(bp_pool, NULL, &bp->lock);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(bp_pool);
+	return status;
+    }
+
+    if (asock->grp_lock) {
+	status = pj_grp_lock_add_handler(asock->grp_lock, pool, bp,
+					 &buf_pool_on_destroy);
+	if (status != PJ_SUCCESS) {
+	    pj_lock_destroy(bp->lock);
+	    pj_pool_release(bp_pool);
+	    return status;
+	}
+    }
+
+    asock->buf_pool = bp;
+    return PJ_SUCCESS;
+}
+
+/* Get a free buffer. The buffer pool lock must be held. */
+static pj_activesock_buf *get_buf(struct buf_pool *bp)
+{
+    pj_activesock_buf *buf;
+
+    if (!pj_list_empty(&bp->free_list)) {
+	buf = bp->free_list.next;
+	pj_list_erase(buf);
+    } else {
+	buf = PJ_POOL_ZALLOC_T(bp->pool, pj_activesock_buf);
+	buf->bp = bp;
+	buf->data = (pj_uint8_t*) pj_pool_alloc(bp->pool, bp->buf_size);
+    }
+
+    return buf;
+}
+
+PJ_DEF(pj_status_t) pj_activesock_buf_add_ref(pj_activesock_buf *buf)
+{
+    PJ_ASSERT_RETURN(buf && buf->ref_cnt > 0, PJ_EINVAL);
+
+    pj_lock_acquire(buf->bp->lock);
+    ++buf->ref_cnt;
+    pj_lock_release(buf->bp->lock);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_activesock_buf_dec_ref(pj_activesock_buf *buf)
+{
+    struct buf_pool *bp;
+    pj_bool_t released;
+
+    PJ_ASSERT_RETURN(buf && buf->ref_cnt > 0, PJ_EINVAL);
+
+    bp = buf->bp;
+    pj_lock_acquire(bp->lock);
+    released = (--buf->ref_cnt == 0);
+    if (released) {
+	/* Reuse the most recently released buffer first, as it is more
+	 * likely to be in the cache.
+	 */
+	pj_list_push_front(&bp->free_list, buf);
+    }
+    pj_lock_release(bp->lock);
+
+    if (released)
+	buf_pool_dec_ref(bp);
+
+    return PJ_SUCCESS;
+}
+
 PJ_DEF(pj_status_t) pj_activesock_create( pj_pool_t *pool,
 					  pj_sock_t sock,
 					  int sock_type,
@@ -201,12 +349,21 @@ PJ_DEF(pj_status_t) pj_activesock_create( pj_pool_t *pool,
     PJ_ASSERT_RETURN(!opt || opt->async_cnt >= 1, PJ_EINVAL);
 
     asock = PJ_POOL_ZALLOC_T(pool, pj_activesock_t);
+    asock->sock = sock;
     asock->ioqueue = ioqueue;
     asock->stream_oriented = (sock_type == pj_SOCK_STREAM());
     asock->async_count = (opt? opt->async_cnt : 1);
     asock->whole_data = (opt? opt->whole_data : 1);
     asock->max_loop = PJ_ACTIVESOCK_MAX_LOOP;
+    asock->batch_cnt = (opt && opt->batch_cnt ? opt->batch_cnt :
+			PJ_ACTIVESOCK_RECV_BATCH);
+    /* The rest of a batch is read directly from the socket, which would
+     * reorder the packets if the ioqueue has already submitted reads.
+     */
+    if ((pj_ioqueue_get_features() & PJ_IOQUEUE_FEATURE_DIRECT_READ) == 0)
+	asock->batch_cnt = 1;
     asock->user_data = user_data;
+    asock->grp_lock = (opt? opt->grp_lock : NULL);
     pj_memcpy(&asock->cb, cb, sizeof(*cb));
 
     pj_bzero(&ioq_cb, sizeof(ioq_cb));
@@ -234,8 +391,11 @@ PJ_DEF(pj_status_t) pj_activesock_create( pj_pool_t *pool,
 
 #if defined(PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT) && \
     PJ_IPHONE_OS_HAS_MULTITASKING_SUPPORT!=0
-    asock->sock = sock;
     asock->bg_setting = PJ_ACTIVESOCK_TCP_IPHONE_OS_BG;
+    /* The ioqueue may replace dead UDP sockets, so don't read from the
+     * socket descriptor directly.
+     */
+    asock->batch_cnt = 1;
 #endif
 
     *p_asock = asock;
@@ -305,6 +465,14 @@ PJ_DEF(pj_status_t) pj_activesock_close(pj_activesock_t *asock)
 	pj_ioqueue_unregister(asock->key);
 	asock->key = NULL;
     }
+
+    /* With a group lock, the buffer pool is released along with the rest
+     * of the active socket when the group lock is destroyed.
+     */
+    if (asock->buf_pool && !asock->grp_lock) {
+	buf_pool_dec_ref(asock->buf_pool);
+	asock->buf_pool = NULL;
+    }
     return PJ_SUCCESS;
 }
 
@@ -335,6 +503,10 @@ PJ_DEF(pj_status_t) pj_activesock_start_read(pj_activesock_t *asock,
 
     PJ_ASSERT_RETURN(asock && pool && buff_size, PJ_EINVAL);
 
+    /* The buffers are lent from the buffer pool instead */
+    if (asock->cb.on_data_read_buf)
+	return pj_activesock_start_read2(asock, pool, buff_size, NULL, flags);
+
     readbuf = (void**) pj_pool_calloc(pool, asock->async_count, 
 				      sizeof(void*));
 
@@ -358,6 +530,13 @@ PJ_DEF(pj_status_t) pj_activesock_start_read2( pj_activesock_t *asock,
     PJ_ASSERT_RETURN(asock && pool && buff_size, PJ_EINVAL);
     PJ_ASSERT_RETURN(asock->read_type == TYPE_NONE, PJ_EINVALIDOP);
     PJ_ASSERT_RETURN(asock->read_op == NULL, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(readbuf || asock->cb.on_data_read_buf, PJ_EINVAL);
+
+    if (asock->cb.on_data_read_buf) {
+	status = create_buf_pool(asock, pool, buff_size);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
 
     asock->read_op = (struct read_op*)
 		     pj_pool_calloc(pool, asock->async_count, 
@@ -369,7 +548,14 @@ PJ_DEF(pj_status_t) pj_activesock_start_read2( pj_activesock_t *asock,
 	struct read_op *r = &asock->read_op[i];
 	pj_ssize_t size_to_read;
 
-	r->pkt = (pj_uint8_t*)readbuf[i];
+	if (asock->buf_pool) {
+	    pj_lock_acquire(asock->buf_pool->lock);
+	    r->buf = get_buf(asock->buf_pool);
+	    pj_lock_release(asock->buf_pool->lock);
+	    r->pkt = r->buf->data;
+	} else {
+	    r->pkt = (pj_uint8_t*)readbuf[i];
+	}
 	size_to_read = r->max_size = buff_size;
 
 	status = pj_ioqueue_recv(asock->key, &r->op_key, r->pkt, &size_to_read,
@@ -394,6 +580,12 @@ PJ_DEF(pj_status_t) pj_activesock_start_recvfrom(pj_activesock_t *asock,
 
     PJ_ASSERT_RETURN(asock && pool && buff_size, PJ_EINVAL);
 
+    /* The buffers are lent from the buffer pool instead */
+    if (asock->cb.on_data_recvfrom_buf) {
+	return pj_activesock_start_recvfrom2(asock, pool, buff_size, NULL,
+					     flags);
+    }
+
     readbuf = (void**) pj_pool_calloc(pool, asock->async_count, 
 				      sizeof(void*));
 
@@ -417,6 +609,13 @@ PJ_DEF(pj_status_t) pj_activesock_start_recvfrom2( pj_activesock_t *asock,
 
     PJ_ASSERT_RETURN(asock && pool && buff_size, PJ_EINVAL);
     PJ_ASSERT_RETURN(asock->read_type == TYPE_NONE, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(readbuf || asock->cb.on_data_recvfrom_buf, PJ_EINVAL);
+
+    if (asock->cb.on_data_recvfrom_buf) {
+	status = create_buf_pool(asock, pool, buff_size);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
 
     asock->read_op = (struct read_op*)
 		     pj_pool_calloc(pool, asock->async_count, 
@@ -428,10 +627,31 @@ PJ_DEF(pj_status_t) pj_activesock_start_recvfrom2( pj_activesock_t *asock,
 	struct read_op *r = &asock->read_op[i];
 	pj_ssize_t size_to_read;
 
-	r->pkt = (pj_uint8_t*) readbuf[i];
+	if (asock->buf_pool) {
+	    pj_lock_acquire(asock->buf_pool->lock);
+	    r->buf = get_buf(asock->buf_pool);
+	    pj_lock_release(asock->buf_pool->lock);
+	    r->pkt = r->buf->data;
+	} else {
+	    r->pkt = (pj_uint8_t*) readbuf[i];
+	}
 	size_to_read = r->max_size = buff_size;
 	r->src_addr_len = sizeof(r->src_addr);
 
+	/* The first packet of a batch is always read into r->pkt by the
+	 * ioqueue, the rest are read directly from the socket.
+	 */
+	if (asock->cb.on_data_recvfrom_batch && !asock->buf_pool) {
+	    unsigned j;
+
+	    r->batch = (pj_sock_msg*)
+		       pj_pool_calloc(pool, asock->batch_cnt, 
+				      sizeof(pj_sock_msg));
+	    r->batch[0].buf = r->pkt;
+	    for (j=1; j<asock->batch_cnt; ++j)
+		r->batch[j].buf = pj_pool_alloc(pool, buff_size);
+	}
+
 	status = pj_ioqueue_recvfrom(asock->key, &r->op_key, r->pkt,
 				     &size_to_read, 
 				     PJ_IOQUEUE_ALWAYS_ASYNC | flags,
@@ -446,6 +666,75 @@ PJ_DEF(pj_status_t) pj_activesock_start_recvfrom2( pj_activesock_t *asock,
 }
 
 
+/* Deliver the packet in r->pkt, along with any other packets that are
+ * readily available in the socket, to on_data_recvfrom_batch().
+ */
+static pj_bool_t deliver_recvfrom_batch(pj_activesock_t *asock,
+					struct read_op *r)
+{
+    pj_sock_msg *batch = r->batch;
+    unsigned i, count = 1;
+
+    batch[0].len = r->size;
+    pj_memcpy(&batch[0].addr, &r->src_addr, r->src_addr_len);
+    batch[0].addr_len = r->src_addr_len;
+
+    if (asock->batch_cnt > 1) {
+	count = asock->batch_cnt - 1;
+	for (i=1; i<=count; ++i) {
+	    batch[i].len = r->max_size;
+	    batch[i].addr_len = sizeof(batch[i].addr);
+	}
+
+	/* The socket is non-blocking, so this won't block when the socket
+	 * has been drained.
+	 */
+	if (pj_sock_recvmmsg(asock->sock, &batch[1], &count, 
+			     asock->read_flags & ~PJ_IOQUEUE_ALWAYS_ASYNC)
+		== PJ_SUCCESS)
+	{
+	    ++count;
+	} else {
+	    count = 1;
+	}
+    }
+
+    return (*asock->cb.on_data_recvfrom_batch)(asock, batch, count,
+					       PJ_SUCCESS);
+}
+
+
+/* Lend the buffer containing the data to the application, and replace
+ * it with a free buffer for the next read.
+ */
+static pj_bool_t deliver_buf(pj_activesock_t *asock, struct read_op *r)
+{
+    pj_activesock_buf *buf = r->buf;
+    struct buf_pool *bp = buf->bp;
+
+    /* The buffer and the pool reference are owned by the application
+     * from now on. Replace the buffer before calling the callback, as
+     * the active socket may be destroyed there.
+     */
+    pj_lock_acquire(bp->lock);
+    buf->ref_cnt = 1;
+    ++bp->ref_cnt;
+    r->buf = get_buf(bp);
+    pj_lock_release(bp->lock);
+    r->pkt = r->buf->data;
+
+    if (asock->read_type == TYPE_RECV) {
+	return (*asock->cb.on_data_read_buf)(asock, buf, buf->data, r->size,
+					     PJ_SUCCESS);
+    } else {
+	return (*asock->cb.on_data_recvfrom_buf)(asock, buf, buf->data,
+						 r->size, &r->src_addr,
+						 r->src_addr_len,
+						 PJ_SUCCESS);
+    }
+}
+
+
 static void ioqueue_on_read_complete(pj_ioqueue_key_t *key, 
 				     pj_ioqueue_op_key_t *op_key, 
 				     pj_ssize_t bytes_read)
@@ -486,9 +775,17 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 	    ret = PJ_TRUE;
 
 	    /* Notify callback */
-	    if (asock->read_type == TYPE_RECV && asock->cb.on_data_read) {
+	    if (r->buf) {
+		ret = deliver_buf(asock, r);
+	    } else if (asock->read_type == TYPE_RECV &&
+		       asock->cb.on_data_read)
+	    {
 		ret = (*asock->cb.on_data_read)(asock, r->pkt, r->size,
 						PJ_SUCCESS, &remainder);
+	    } else if (asock->read_type == TYPE_RECV_FROM &&
+		       asock->cb.on_data_recvfrom_batch)
+	    {
+		ret = deliver_recvfrom_batch(asock, r);
 	    } else if (asock->read_type == TYPE_RECV_FROM && 
 		       asock->cb.on_data_recvfrom) 
 	    {
@@ -542,7 +839,19 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 	    ret = PJ_TRUE;
 
 	    /* Notify callback */
-	    if (asock->read_type == TYPE_RECV && asock->cb.on_data_read) {
+	    if (r->buf && asock->read_type == TYPE_RECV) {
+		/* Nothing is left in the buffer in the buffer lending mode */
+		ret = (*asock->cb.on_data_read_buf)(asock, NULL, NULL, 0,
+						    status);
+	    } else if (r->buf) {
+		if (status != PJ_SUCCESS) {
+		    ret = (*asock->cb.on_data_recvfrom_buf)(asock, NULL, NULL,
+							    0, NULL, 0,
+							    status);
+		}
+	    } else if (asock->read_type == TYPE_RECV &&
+		       asock->cb.on_data_read)
+	    {
 		/* For connection oriented socket, we still need to report 
 		 * the remainder data (if any) to the user to let user do 
 		 * processing with the remainder data before it closes the
@@ -560,7 +869,8 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 						status, &remainder);
 
 	    } else if (asock->read_type == TYPE_RECV_FROM && 
-		       asock->cb.on_data_recvfrom) 
+		       (asock->cb.on_data_recvfrom ||
+			asock->cb.on_data_recvfrom_batch))
 	    {
 		/* This would always be datagram oriented hence there's 
 		 * nothing in the packet. We can't be sure if there will be
@@ -572,7 +882,12 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 		 * with successful status and NULL data, so lets not call the
 		 * callback if the status is PJ_SUCCESS.
 		 */
-		if (status != PJ_SUCCESS ) {
+		if (status != PJ_SUCCESS &&
+		    asock->cb.on_data_recvfrom_batch)
+		{
+		    ret = (*asock->cb.on_data_recvfrom_batch)(asock, NULL, 0,
+							      status);
+		} else if (status != PJ_SUCCESS ) {
 		    ret = (*asock->cb.on_data_recvfrom)(asock, NULL, 0,
 							NULL, 0, status);
 		}
@@ -594,6 +909,19 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 	    }
 	}
 
+	/* Keep the read operation aside if reading has been paused, it
+	 * will be issued again by pj_activesock_resume_read().
+	 */
+	if (asock->read_paused) {
+	    pj_ioqueue_lock_key(key);
+	    if (asock->read_paused) {
+		r->parked = PJ_TRUE;
+		pj_ioqueue_unlock_key(key);
+		return;
+	    }
+	    pj_ioqueue_unlock_key(key);
+	}
+
 	/* Read next data. We limit ourselves to processing max_loop immediate
 	 * data, so when the loop counter has exceeded this value, force the
 	 * read()/recvfrom() to return pending operation to allow the program
@@ -628,6 +956,68 @@ static void ioqueue_on_read_complete(pj_ioqueue_key_t *key,
 }
 
 
+PJ_DEF(pj_status_t) pj_activesock_pause_read(pj_activesock_t *asock)
+{
+    PJ_ASSERT_RETURN(asock, PJ_EINVAL);
+
+    pj_ioqueue_lock_key(asock->key);
+    asock->read_paused = PJ_TRUE;
+    pj_ioqueue_unlock_key(asock->key);
+
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_activesock_resume_read(pj_activesock_t *asock)
+{
+    pj_status_t status = PJ_SUCCESS;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(asock, PJ_EINVAL);
+
+    pj_ioqueue_lock_key(asock->key);
+
+    asock->read_paused = PJ_FALSE;
+
+    for (i = 0; asock->read_op && i < asock->async_count; ++i) {
+	struct read_op *r = &asock->read_op[i];
+	pj_ssize_t size;
+	pj_status_t st;
+
+	if (!r->parked)
+	    continue;
+
+	r->parked = PJ_FALSE;
+	if (asock->shutdown & SHUT_RX)
+	    continue;
+
+	/* Always asynchronous, so that the data is reported by the
+	 * ioqueue polling thread.
+	 */
+	size = r->max_size - r->size;
+	if (asock->read_type == TYPE_RECV) {
+	    st = pj_ioqueue_recv(asock->key, &r->op_key, r->pkt + r->size,
+				 &size,
+				 asock->read_flags | PJ_IOQUEUE_ALWAYS_ASYNC);
+	} else {
+	    r->src_addr_len = sizeof(r->src_addr);
+	    st = pj_ioqueue_recvfrom(asock->key, &r->op_key, r->pkt + r->size,
+				     &size,
+				     asock->read_flags |
+					PJ_IOQUEUE_ALWAYS_ASYNC,
+				     &r->src_addr, &r->src_addr_len);
+	}
+
+	if (st != PJ_EPENDING && st != PJ_SUCCESS)
+	    status = st;
+    }
+
+    pj_ioqueue_unlock_key(asock->key);
+
+    return status;
+}
+
+
 static pj_status_t send_remaining(pj_activesock_t *asock, 
 				  pj_ioqueue_op_key_t *send_key)
 {
@@ -0,0 +1,494 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/executor.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+#define THIS_FILE	"executor.c"
+
+#if PJ_HAS_THREADS
+
+typedef struct task
+{
+    pj_executor_cb	*cb;
+    void		*arg;
+    pj_grp_lock_t	*grp_lock;
+    unsigned		 flags;
+} task;
+
+/* Bounded queue of tasks. The oldest task is at head, and the newest
+ * one is at tail-1. The worker thread takes its own tasks from the tail,
+ * while the submission queue and the stealers take from the head.
+ */
+typedef struct task_queue
+{
+    pj_mutex_t		*mutex;
+    task		*tasks;
+    unsigned		 mask;
+    unsigned		 head;
+    unsigned		 tail;
+    pj_uint32_t		 push_cnt;
+    pj_uint32_t		 reject_cnt;
+    char		 pad[PJ_CACHE_LINE_SIZE];
+} task_queue;
+
+typedef struct worker
+{
+    pj_executor_t	*exec;
+    unsigned		 idx;
+    pj_thread_t		*thread;
+    task_queue		 deque;
+
+    /* Only updated by the worker thread */
+    pj_uint32_t		 exec_cnt;
+    pj_uint32_t		 steal_cnt;
+} worker;
+
+struct pj_executor_t
+{
+    char		 obj_name[PJ_MAX_OBJ_NAME];
+    long		 tls_id;
+    unsigned		 thread_cnt;
+    worker		*workers;
+    task_queue		 submit_q;
+    pj_sem_t		*sem;
+    pj_bool_t volatile	 quitting;
+};
+
+
+PJ_DEF(void) pj_executor_param_default(pj_executor_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->thread_cnt = PJ_EXECUTOR_THREAD_CNT;
+    param->queue_size = PJ_EXECUTOR_QUEUE_SIZE;
+}
+
+static pj_status_t queue_init(pj_pool_t *pool, const char *name,
+			      unsigned size, task_queue *q)
+{
+    unsigned cnt;
+
+    for (cnt=1; cnt < size; cnt <<= 1)
+	;
+
+    q->tasks = (task*) pj_pool_calloc(pool, cnt, sizeof(task));
+    if (!q->tasks)
+	return PJ_ENOMEM;
+    q->mask = cnt - 1;
+
+    return pj_mutex_create_simple(pool, name, &q->mutex);
+}
+
+/* Must be called with the queue mutex held */
+static pj_status_t queue_push(task_queue *q, const task *t)
+{
+    if (q->tail - q->head > q->mask) {
+	++q->reject_cnt;
+	return PJ_ETOOMANY;
+    }
+
+    q->tasks[q->tail & q->mask] = *t;
+    ++q->tail;
+    ++q->push_cnt;
+    return PJ_SUCCESS;
+}
+
+/* Take the newest task (newest=PJ_TRUE) or the oldest task. */
+static pj_bool_t queue_pop(task_queue *q, pj_bool_t newest, task *t)
+{
+    pj_bool_t found = PJ_FALSE;
+
+    /* Checked without the mutex to avoid locking empty queues. A task
+     * that is being pushed now may be missed, but the semaphore will be
+     * posted for it.
+     */
+    if (q->head == q->tail)
+	return PJ_FALSE;
+
+    pj_mutex_lock(q->mutex);
+    if (q->head != q->tail) {
+	if (newest) {
+	    --q->tail;
+	    *t = q->tasks[q->tail & q->mask];
+	} else {
+	    *t = q->tasks[q->head & q->mask];
+	    ++q->head;
+	}
+	found = PJ_TRUE;
+    }
+    pj_mutex_unlock(q->mutex);
+
+    return found;
+}
+
+static pj_bool_t get_task(worker *w, task *t)
+{
+    pj_executor_t *exec = w->exec;
+    unsigned i;
+
+    if (queue_pop(&w->deque, PJ_TRUE, t))
+	return PJ_TRUE;
+
+    if (queue_pop(&exec->submit_q, PJ_FALSE, t))
+	return PJ_TRUE;
+
+    for (i=1; i<exec->thread_cnt; ++i) {
+	worker *victim = &exec->workers[(w->idx + i) % exec->thread_cnt];
+
+	if (queue_pop(&victim->deque, PJ_FALSE, t)) {
+	    ++w->steal_cnt;
+	    return PJ_TRUE;
+	}
+    }
+
+    return PJ_FALSE;
+}
+
+static void run_task(const task *t)
+{
+    if (t->grp_lock && (t->flags & PJ_EXECUTOR_HOLD_LOCK)) {
+	pj_grp_lock_acquire(t->grp_lock);
+	(*t->cb)(t->arg);
+	pj_grp_lock_release(t->grp_lock);
+    } else {
+	(*t->cb)(t->arg);
+    }
+
+    if (t->grp_lock)
+	pj_grp_lock_dec_ref(t->grp_lock);
+}
+
+static int worker_thread(void *arg)
+{
+    worker *w = (worker*) arg;
+    pj_executor_t *exec = w->exec;
+    task t;
+
+    pj_thread_local_set(exec->tls_id, w);
+
+    for (;;) {
+	if (get_task(w, &t)) {
+	    run_task(&t);
+	    ++w->exec_cnt;
+	    continue;
+	}
+
+	/* Only quit when all queues are drained */
+	if (exec->quitting)
+	    break;
+
+	pj_sem_wait(exec->sem);
+    }
+
+    pj_thread_local_set(exec->tls_id, NULL);
+    return 0;
+}
+
+PJ_DEF(pj_status_t) pj_executor_create(pj_pool_t *pool,
+				       const char *name,
+				       const pj_executor_param *param,
+				       pj_executor_t **p_exec)
+{
+    pj_executor_param default_param;
+    pj_executor_t *exec;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && p_exec, PJ_EINVAL);
+
+    if (!param) {
+	pj_executor_param_default(&default_param);
+	param = &default_param;
+    }
+    PJ_ASSERT_RETURN(param->thread_cnt > 0 && param->queue_size > 0 &&
+		     param->queue_size <= 0x10000000, PJ_EINVAL);
+
+    if (!name)
+	name = "exec%p";
+
+    exec = PJ_POOL_ZALLOC_T(pool, pj_executor_t);
+    pj_ansi_snprintf(exec->obj_name, sizeof(exec->obj_name), name, exec);
+    exec->tls_id = -1;
+    exec->thread_cnt = param->thread_cnt;
+
+    status = pj_thread_local_alloc(&exec->tls_id);
+    if (status != PJ_SUCCESS) {
+	exec->tls_id = -1;
+	goto on_error;
+    }
+
+    status = pj_sem_create(pool, exec->obj_name, 0, PJ_MAXINT32, &exec->sem);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    status = queue_init(pool, exec->obj_name, param->queue_size,
+			&exec->submit_q);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    exec->workers = (worker*) pj_pool_calloc(pool, exec->thread_cnt,
+					     sizeof(worker));
+    for (i=0; i<exec->thread_cnt; ++i) {
+	worker *w = &exec->workers[i];
+
+	w->exec = exec;
+	w->idx = i;
+	status = queue_init(pool, exec->obj_name, param->queue_size,
+			    &w->deque);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
+    /* Start the threads after all deques are ready to be stolen from */
+    for (i=0; i<exec->thread_cnt; ++i) {
+	worker *w = &exec->workers[i];
+
+	status = pj_thread_create(pool, exec->obj_name, &worker_thread, w,
+				  param->stack_size, 0, &w->thread);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
+    PJ_LOG(5,(exec->obj_name, "Executor created with %u threads",
+	      exec->thread_cnt));
+
+    *p_exec = exec;
+    return PJ_SUCCESS;
+
+on_error:
+    pj_executor_destroy(exec);
+    return status;
+}
+
+PJ_DEF(pj_status_t) pj_executor_submit(pj_executor_t *exec,
+				       pj_executor_cb *cb,
+				       void *arg,
+				       pj_grp_lock_t *grp_lock,
+				       unsigned flags)
+{
+    worker *w;
+    task t;
+    pj_status_t status = PJ_ETOOMANY;
+
+    PJ_ASSERT_RETURN(exec && cb, PJ_EINVAL);
+
+    t.cb = cb;
+    t.arg = arg;
+    t.grp_lock = grp_lock;
+    t.flags = flags;
+
+    if (grp_lock)
+	pj_grp_lock_add_ref(grp_lock);
+
+    /* Worker threads queue to their own deque first */
+    w = (worker*) pj_thread_local_get(exec->tls_id);
+    if (w) {
+	pj_mutex_lock(w->deque.mutex);
+	if (exec->quitting)
+	    status = PJ_EINVALIDOP;
+	else
+	    status = queue_push(&w->deque, &t);
+	pj_mutex_unlock(w->deque.mutex);
+    }
+
+    if (status == PJ_ETOOMANY) {
+	pj_mutex_lock(exec->submit_q.mutex);
+	if (exec->quitting)
+	    status = PJ_EINVALIDOP;
+	else
+	    status = queue_push(&exec->submit_q, &t);
+	pj_mutex_unlock(exec->submit_q.mutex);
+    }
+
+    if (status != PJ_SUCCESS) {
+	if (grp_lock)
+	    pj_grp_lock_dec_ref(grp_lock);
+	return status;
+    }
+
+    pj_sem_post(exec->sem);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_bool_t) pj_executor_is_worker(pj_executor_t *exec)
+{
+    PJ_ASSERT_RETURN(exec, PJ_FALSE);
+    return pj_thread_local_get(exec->tls_id) != NULL;
+}
+
+PJ_DEF(pj_status_t) pj_executor_get_stat(pj_executor_t *exec,
+					 pj_executor_stat *stat)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(exec && stat, PJ_EINVAL);
+
+    pj_bzero(stat, sizeof(*stat));
+    stat->thread_cnt = exec->thread_cnt;
+
+    for (i=0; i<=exec->thread_cnt; ++i) {
+	task_queue *q;
+
+	if (i < exec->thread_cnt) {
+	    worker *w = &exec->workers[i];
+
+	    stat->exec_cnt += w->exec_cnt;
+	    stat->steal_cnt += w->steal_cnt;
+	    q = &w->deque;
+	} else {
+	    q = &exec->submit_q;
+	}
+
+	pj_mutex_lock(q->mutex);
+	stat->pending_cnt += q->tail - q->head;
+	stat->submit_cnt += q->push_cnt;
+	stat->reject_cnt += q->reject_cnt;
+	pj_mutex_unlock(q->mutex);
+    }
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_executor_destroy(pj_executor_t *exec)
+{
+    unsigned i;
+
+    PJ_ASSERT_RETURN(exec, PJ_EINVAL);
+    PJ_ASSERT_RETURN(exec->tls_id == -1 || !pj_executor_is_worker(exec),
+		     PJ_EINVALIDOP);
+
+    if (exec->submit_q.mutex)
+	pj_mutex_lock(exec->submit_q.mutex);
+    exec->quitting = PJ_TRUE;
+    if (exec->submit_q.mutex)
+	pj_mutex_unlock(exec->submit_q.mutex);
+
+    for (i=0; exec->workers && i<exec->thread_cnt; ++i) {
+	if (exec->workers[i].thread)
+	    pj_sem_post(exec->sem);
+    }
+
+    for (i=0; exec->workers && i<exec->thread_cnt; ++i) {
+	worker *w = &exec->workers[i];
+
+	if (w->thread) {
+	    pj_thread_join(w->thread);
+	    pj_thread_destroy(w->thread);
+	    w->thread = NULL;
+	}
+	if (w->deque.mutex) {
+	    pj_mutex_destroy(w->deque.mutex);
+	    w->deque.mutex = NULL;
+	}
+    }
+
+    if (exec->submit_q.mutex) {
+	pj_mutex_destroy(exec->submit_q.mutex);
+	exec->submit_q.mutex = NULL;
+    }
+    if (exec->sem) {
+	pj_sem_destroy(exec->sem);
+	exec->sem = NULL;
+    }
+    if (exec->tls_id != -1) {
+	pj_thread_local_free(exec->tls_id);
+	exec->tls_id = -1;
+    }
+
+    return PJ_SUCCESS;
+}
+
+#else	/* PJ_HAS_THREADS */
+
+/* Without threads, the tasks are run synchronously by the caller. */
+
+struct pj_executor_t
+{
+    pj_uint32_t		 exec_cnt;
+};
+
+PJ_DEF(void) pj_executor_param_default(pj_executor_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->thread_cnt = PJ_EXECUTOR_THREAD_CNT;
+    param->queue_size = PJ_EXECUTOR_QUEUE_SIZE;
+}
+
+PJ_DEF(pj_status_t) pj_executor_create(pj_pool_t *pool,
+				       const char *name,
+				       const pj_executor_param *param,
+				       pj_executor_t **p_exec)
+{
+    PJ_ASSERT_RETURN(pool && p_exec, PJ_EINVAL);
+    PJ_UNUSED_ARG(name);
+    PJ_UNUSED_ARG(param);
+
+    *p_exec = PJ_POOL_ZALLOC_T(pool, pj_executor_t);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_executor_submit(pj_executor_t *exec,
+				       pj_executor_cb *cb,
+				       void *arg,
+				       pj_grp_lock_t *grp_lock,
+				       unsigned flags)
+{
+    PJ_ASSERT_RETURN(exec && cb, PJ_EINVAL);
+
+    if (grp_lock && (flags & PJ_EXECUTOR_HOLD_LOCK)) {
+	pj_grp_lock_acquire(grp_lock);
+	(*cb)(arg);
+	pj_grp_lock_release(grp_lock);
+    } else {
+	(*cb)(arg);
+    }
+    ++exec->exec_cnt;
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_bool_t) pj_executor_is_worker(pj_executor_t *exec)
+{
+    PJ_UNUSED_ARG(exec);
+    return PJ_FALSE;
+}
+
+PJ_DEF(pj_status_t) pj_executor_get_stat(pj_executor_t *exec,
+					 pj_executor_stat *stat)
+{
+    PJ_ASSERT_RETURN(exec && stat, PJ_EINVAL);
+
+    pj_bzero(stat, sizeof(*stat));
+    stat->submit_cnt = stat->exec_cnt = exec->exec_cnt;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_executor_destroy(pj_executor_t *exec)
+{
+    PJ_ASSERT_RETURN(exec, PJ_EINVAL);
+    return PJ_SUCCESS;
+}
+
+#endif	/* PJ_HAS_THREADS */
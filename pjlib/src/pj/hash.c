@@ -41,11 +41,45 @@ struct pj_hash_entry
 };
 
 
+/**
+ * Number of slots of the old array to move to the new array on every
+ * insertion while a resizable hash table is being resized.
+ */
+#define PJ_HASH_MIGRATE_STEP	8
+
+
+/* Slot of resizable hash table, which uses open addressing with linear
+ * probing. Empty slot has NULL key, deleted slot has deleted_key as key.
+ */
+typedef struct pj_hash_slot
+{
+    const void	*key;
+    void	*value;
+    pj_uint32_t	 hash;
+    pj_uint32_t	 keylen;
+} pj_hash_slot;
+
+static const char deleted_key[1] = { 0 };
+
+
 struct pj_hash_table_t
 {
     pj_hash_entry     **table;
     unsigned		count, rows;
     pj_hash_iterator_t	iterator;
+
+    /* Resizable hash table (table is NULL). While the table is being
+     * resized, entries that have not been moved are still in old_slots.
+     */
+    pj_pool_t	       *pool;
+    pj_hash_slot       *slots;
+    unsigned		mask;
+    unsigned		used;
+    pj_hash_slot       *old_slots;
+    unsigned		old_mask;
+    unsigned		migrate_pos;
+    pj_hash_slot       *spare_slots;
+    unsigned		spare_mask;
 };
 
 
@@ -130,25 +164,49 @@ PJ_DEF(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size)
     return h;
 }
 
-static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht, 
-				   const void *key, unsigned keylen,
-				   void *val, pj_uint32_t *hval,
-				   void *entry_buf, pj_bool_t lower)
+PJ_DEF(pj_hash_table_t*) pj_hash_create_resizable(pj_pool_t *pool,
+						  unsigned size)
+{
+    pj_hash_table_t *h;
+    unsigned cap;
+
+    PJ_ASSERT_RETURN(pool, NULL);
+
+    h = PJ_POOL_ZALLOC_T(pool, pj_hash_table_t);
+
+    cap = 16;
+    while (cap < size)
+	cap <<= 1;
+
+    h->pool = pool;
+    h->mask = cap - 1;
+    h->slots = (pj_hash_slot*) pj_pool_calloc(pool, cap, sizeof(pj_hash_slot));
+
+    PJ_LOG( 6, ("hashtbl", "resizable hash table %p created from pool %s, "
+		"capacity=%u", h, pj_pool_getobjname(pool), cap));
+
+    return h;
+}
+
+/* Get the hash value of the key, either from hval or by calculating it,
+ * and update keylen if the key is a NULL terminated string.
+ */
+static pj_uint32_t calc_key_hash( const void *key, unsigned *keylen,
+				  pj_uint32_t *hval, pj_bool_t lower )
 {
     pj_uint32_t hash;
-    pj_hash_entry **p_entry, *entry;
 
     if (hval && *hval != 0) {
 	hash = *hval;
-	if (keylen==PJ_HASH_KEY_STRING) {
-	    keylen = (unsigned)pj_ansi_strlen((const char*)key);
+	if (*keylen==PJ_HASH_KEY_STRING) {
+	    *keylen = (unsigned)pj_ansi_strlen((const char*)key);
 	}
     } else {
 	/* This slightly differs with pj_hash_calc() because we need 
 	 * to get the keylen when keylen is PJ_HASH_KEY_STRING.
 	 */
 	hash=0;
-	if (keylen==PJ_HASH_KEY_STRING) {
+	if (*keylen==PJ_HASH_KEY_STRING) {
 	    const pj_uint8_t *p = (const pj_uint8_t*)key;
 	    for ( ; *p; ++p ) {
                 if (lower)
@@ -156,10 +214,10 @@ static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht,
                 else 
 		    hash = hash * PJ_HASH_MULTIPLIER + *p;
 	    }
-	    keylen = (unsigned)(p - (const unsigned char*)key);
+	    *keylen = (unsigned)(p - (const unsigned char*)key);
 	} else {
 	    const pj_uint8_t *p = (const pj_uint8_t*)key,
-				  *end = p + keylen;
+				  *end = p + *keylen;
 	    for ( ; p!=end; ++p) {
 		if (lower)
                     hash = hash * PJ_HASH_MULTIPLIER + pj_tolower(*p);
@@ -173,6 +231,19 @@ static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht,
 	    *hval = hash;
     }
 
+    return hash;
+}
+
+static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht, 
+				   const void *key, unsigned keylen,
+				   void *val, pj_uint32_t *hval,
+				   void *entry_buf, pj_bool_t lower)
+{
+    pj_uint32_t hash;
+    pj_hash_entry **p_entry, *entry;
+
+    hash = calc_key_hash(key, &keylen, hval, lower);
+
     /* scan the linked list */
     for (p_entry = &ht->table[hash & ht->rows], entry=*p_entry; 
 	 entry; 
@@ -222,11 +293,235 @@ static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht,
     return p_entry;
 }
 
+/* Scramble all bits of the hash value into the low bits, which are used
+ * as the slot index (this is the finalizer of MurmurHash3). The hash
+ * value alone is too weak for open addressing, since keys that only
+ * differ in the last characters end up in neighbouring slots.
+ */
+static pj_uint32_t mix_hash(pj_uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static pj_hash_slot *find_slot( pj_hash_slot *slots, unsigned mask,
+				pj_uint32_t hash, const void *key,
+				unsigned keylen, pj_bool_t lower )
+{
+    unsigned i;
+
+    for (i = mix_hash(hash) & mask; slots[i].key; i = (i+1) & mask) {
+	pj_hash_slot *slot = &slots[i];
+
+	if (slot->key != deleted_key && slot->hash==hash &&
+	    slot->keylen==keylen &&
+            ((lower && pj_ansi_strnicmp((const char*)slot->key,
+        			        (const char*)key, keylen)==0) ||
+	     (!lower && pj_memcmp(slot->key, key, keylen)==0)))
+	{
+	    return slot;
+	}
+    }
+
+    return NULL;
+}
+
+/* Get a free slot for a key that is not in the table yet. */
+static pj_hash_slot *alloc_slot( pj_hash_table_t *ht, pj_uint32_t hash )
+{
+    unsigned i = mix_hash(hash) & ht->mask;
+
+    while (ht->slots[i].key && ht->slots[i].key != deleted_key)
+	i = (i+1) & ht->mask;
+
+    if (ht->slots[i].key == NULL)
+	++ht->used;
+
+    return &ht->slots[i];
+}
+
+/* Move up to cnt slots from the old array to the current array. */
+static void migrate_slots( pj_hash_table_t *ht, unsigned cnt )
+{
+    while (ht->old_slots && cnt--) {
+	pj_hash_slot *old = &ht->old_slots[ht->migrate_pos];
+
+	if (old->key && old->key != deleted_key) {
+	    *alloc_slot(ht, old->hash) = *old;
+	    old->key = deleted_key;
+	}
+
+	if (ht->migrate_pos++ == ht->old_mask) {
+	    /* Keep the old array for the next resize of the same size */
+	    ht->spare_slots = ht->old_slots;
+	    ht->spare_mask = ht->old_mask;
+	    ht->old_slots = NULL;
+	    ht->migrate_pos = 0;
+	}
+    }
+}
+
+/* Start moving the entries to a new array, which is larger if the table
+ * is at least half full, or otherwise the same size to get rid of the
+ * deleted slots.
+ */
+static void start_resize( pj_hash_table_t *ht )
+{
+    pj_hash_slot *slots;
+    unsigned cap = ht->mask + 1;
+
+    /* Finish the previous resize first. It normally has completed long
+     * before the new array fills up.
+     */
+    migrate_slots(ht, (unsigned)-1);
+
+    while ((ht->count + 1) * 2 > cap)
+	cap <<= 1;
+
+    if (ht->spare_slots && ht->spare_mask == cap - 1) {
+	slots = ht->spare_slots;
+	pj_bzero(slots, cap * sizeof(pj_hash_slot));
+    } else {
+	slots = (pj_hash_slot*)
+		pj_pool_calloc(ht->pool, cap, sizeof(pj_hash_slot));
+    }
+    ht->spare_slots = NULL;
+
+    PJ_LOG(6, ("hashtbl", "%p: resizing from %u to %u slots, count=%u",
+	       ht, ht->mask + 1, cap, ht->count));
+
+    ht->old_slots = ht->slots;
+    ht->old_mask = ht->mask;
+    ht->migrate_pos = 0;
+    ht->slots = slots;
+    ht->mask = cap - 1;
+    ht->used = 0;
+}
+
+static pj_hash_slot *oa_get( pj_hash_table_t *ht, const void *key,
+			     unsigned keylen, pj_uint32_t *hval,
+			     pj_bool_t lower )
+{
+    pj_uint32_t hash;
+    pj_hash_slot *slot;
+
+    hash = calc_key_hash(key, &keylen, hval, lower);
+    slot = find_slot(ht->slots, ht->mask, hash, key, keylen, lower);
+    if (!slot && ht->old_slots) {
+	slot = find_slot(ht->old_slots, ht->old_mask, hash, key, keylen,
+			 lower);
+    }
+
+    return slot;
+}
+
+static void oa_set( pj_pool_t *pool, pj_hash_table_t *ht,
+		    const void *key, unsigned keylen, pj_uint32_t hval,
+		    void *value, pj_bool_t lower )
+{
+    pj_uint32_t hash;
+    pj_hash_slot *slot;
+
+    hash = calc_key_hash(key, &keylen, &hval, lower);
+    slot = find_slot(ht->slots, ht->mask, hash, key, keylen, lower);
+    if (slot) {
+	if (value) {
+	    slot->value = value;
+	} else {
+	    unsigned i = (unsigned)(slot - ht->slots);
+
+	    slot->key = deleted_key;
+	    slot->value = NULL;
+	    --ht->count;
+
+	    /* Deleted slots at the end of a probe sequence can be reused */
+	    if (ht->slots[(i+1) & ht->mask].key == NULL) {
+		do {
+		    ht->slots[i].key = NULL;
+		    --ht->used;
+		    i = (i-1) & ht->mask;
+		} while (ht->slots[i].key == deleted_key);
+	    }
+	}
+	return;
+    }
+
+    if (ht->old_slots) {
+	slot = find_slot(ht->old_slots, ht->old_mask, hash, key, keylen,
+			 lower);
+	if (slot) {
+	    if (value) {
+		slot->value = value;
+	    } else {
+		slot->key = deleted_key;
+		slot->value = NULL;
+		--ht->count;
+	    }
+	    return;
+	}
+    }
+
+    if (value == NULL)
+	return;
+
+    /* Keep at least a quarter of the slots empty */
+    if ((ht->used + 1) * 4 > (ht->mask + 1) * 3)
+	start_resize(ht);
+    else if (ht->old_slots)
+	migrate_slots(ht, PJ_HASH_MIGRATE_STEP);
+
+    slot = alloc_slot(ht, hash);
+    if (pool) {
+	slot->key = pj_pool_alloc(pool, keylen);
+	pj_memcpy((void*)slot->key, key, keylen);
+    } else {
+	slot->key = key;
+    }
+    slot->hash = hash;
+    slot->keylen = keylen;
+    slot->value = value;
+
+    ++ht->count;
+}
+
+/* Get the next used slot, starting from the specified index. Slots of the
+ * old array come first.
+ */
+static pj_hash_iterator_t *oa_iterate( pj_hash_table_t *ht,
+				       pj_hash_iterator_t *it,
+				       unsigned index )
+{
+    unsigned old_cnt = ht->old_slots ? ht->old_mask + 1 : 0;
+
+    for (; index < old_cnt + ht->mask + 1; ++index) {
+	pj_hash_slot *slot = (index < old_cnt) ? &ht->old_slots[index] :
+						 &ht->slots[index - old_cnt];
+	if (slot->key && slot->key != deleted_key) {
+	    it->index = index;
+	    it->entry = (pj_hash_entry*)slot;
+	    return it;
+	}
+    }
+
+    it->entry = NULL;
+    return NULL;
+}
+
 PJ_DEF(void *) pj_hash_get( pj_hash_table_t *ht,
 			    const void *key, unsigned keylen,
 			    pj_uint32_t *hval)
 {
     pj_hash_entry *entry;
+
+    if (ht->table == NULL) {
+	pj_hash_slot *slot = oa_get(ht, key, keylen, hval, PJ_FALSE);
+	return slot ? slot->value : NULL;
+    }
+
     entry = *find_entry( NULL, ht, key, keylen, NULL, hval, NULL, PJ_FALSE);
     return entry ? entry->value : NULL;
 }
@@ -236,6 +531,12 @@ PJ_DEF(void *) pj_hash_get_lower( pj_hash_table_t *ht,
 			          pj_uint32_t *hval)
 {
     pj_hash_entry *entry;
+
+    if (ht->table == NULL) {
+	pj_hash_slot *slot = oa_get(ht, key, keylen, hval, PJ_TRUE);
+	return slot ? slot->value : NULL;
+    }
+
     entry = *find_entry( NULL, ht, key, keylen, NULL, hval, NULL, PJ_TRUE);
     return entry ? entry->value : NULL;
 }
@@ -246,6 +547,12 @@ static void hash_set( pj_pool_t *pool, pj_hash_table_t *ht,
 {
     pj_hash_entry **p_entry;
 
+    if (ht->table == NULL) {
+	/* Resizable table doesn't need entry_buf */
+	oa_set(pool, ht, key, keylen, hval, value, lower);
+	return;
+    }
+
     p_entry = find_entry( pool, ht, key, keylen, value, &hval, entry_buf,
                           lower);
     if (*p_entry) {
@@ -303,6 +610,9 @@ PJ_DEF(unsigned) pj_hash_count( pj_hash_table_t *ht )
 PJ_DEF(pj_hash_iterator_t*) pj_hash_first( pj_hash_table_t *ht,
 					   pj_hash_iterator_t *it )
 {
+    if (ht->table == NULL)
+	return oa_iterate(ht, it, 0);
+
     it->index = 0;
     it->entry = NULL;
 
@@ -319,6 +629,9 @@ PJ_DEF(pj_hash_iterator_t*) pj_hash_first( pj_hash_table_t *ht,
 PJ_DEF(pj_hash_iterator_t*) pj_hash_next( pj_hash_table_t *ht, 
 					  pj_hash_iterator_t *it )
 {
+    if (ht->table == NULL)
+	return oa_iterate(ht, it, it->index + 1);
+
     it->entry = it->entry->next;
     if (it->entry) {
 	return it;
@@ -337,7 +650,10 @@ PJ_DEF(pj_hash_iterator_t*) pj_hash_next( pj_hash_table_t *ht,
 PJ_DEF(void*) pj_hash_this( pj_hash_table_t *ht, pj_hash_iterator_t *it )
 {
     PJ_CHECK_STACK();
-    PJ_UNUSED_ARG(ht);
+
+    if (ht->table == NULL)
+	return ((pj_hash_slot*)it->entry)->value;
+
     return it->entry->value;
 }
 
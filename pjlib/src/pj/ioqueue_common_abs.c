@@ -22,7 +22,9 @@
  * ioqueue_common_abs.c
  *
  * This contains common functionalities to emulate proactor pattern with
- * various event dispatching mechanisms (e.g. select, epoll).
+ * various event dispatching mechanisms (e.g. select, epoll), and the
+ * functions which are common to all backends (see IOQUEUE_HAS_NATIVE_OPS
+ * in ioqueue_common_abs.h).
  *
  * This file will be included by the appropriate ioqueue implementation.
  * This file is NOT supposed to be compiled as stand-alone source.
@@ -35,6 +37,8 @@ static void ioqueue_init( pj_ioqueue_t *ioqueue )
     ioqueue->lock = NULL;
     ioqueue->auto_delete_lock = 0;
     ioqueue->default_concurrency = PJ_IOQUEUE_DEFAULT_ALLOW_CONCURRENCY;
+    ioqueue->max_events = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL;
+    pj_bzero(&ioqueue->stat, sizeof(ioqueue->stat));
 }
 
 static pj_status_t ioqueue_destroy(pj_ioqueue_t *ioqueue)
@@ -47,6 +51,58 @@ static pj_status_t ioqueue_destroy(pj_ioqueue_t *ioqueue)
     return PJ_SUCCESS;
 }
 
+#if PJ_IOQUEUE_STAT
+/* Account the execution time of a callback started at start. */
+static void key_stat_cb_done(pj_ioqueue_key_t *key, const pj_timestamp *start)
+{
+    pj_timestamp now;
+    pj_uint32_t usec, limit;
+    unsigned i;
+
+    pj_get_timestamp(&now);
+    usec = pj_elapsed_usec(start, &now);
+
+    KEY_STAT_ADD(key->stat.cb_cnt, 1);
+    KEY_STAT_ADD(key->stat.cb_usec, usec);
+#if PJ_HAS_ATOMIC_BUILTINS
+    {
+	pj_uint32_t cur = __atomic_load_n(&key->stat.max_cb_usec,
+					  __ATOMIC_RELAXED);
+	while (usec > cur &&
+	       !__atomic_compare_exchange_n(&key->stat.max_cb_usec, &cur,
+					    usec, PJ_TRUE, __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED))
+	{
+	}
+    }
+#else
+    if (usec > key->stat.max_cb_usec)
+	key->stat.max_cb_usec = usec;
+#endif
+
+    for (i=0, limit=16; i<PJ_IOQUEUE_CB_HIST_CNT-1 && usec>=limit; ++i)
+	limit <<= 2;
+    KEY_STAT_ADD(key->stat.cb_hist[i], 1);
+}
+
+/* Account the time spent in dispatching the events of one poll. */
+static void ioqueue_stat_dispatch_done(pj_ioqueue_t *ioqueue,
+				       const pj_timestamp *start)
+{
+    pj_timestamp now;
+    pj_uint32_t usec;
+
+    pj_get_timestamp(&now);
+    usec = pj_elapsed_usec(start, &now);
+
+    pj_lock_acquire(ioqueue->lock);
+    ioqueue->stat.dispatch_usec += usec;
+    if (usec > ioqueue->stat.max_dispatch_usec)
+	ioqueue->stat.max_dispatch_usec = usec;
+    pj_lock_release(ioqueue->lock);
+}
+#endif
+
 /*
  * pj_ioqueue_set_lock()
  */
@@ -92,6 +148,10 @@ static pj_status_t ioqueue_init_key( pj_pool_t *pool,
     /* Save callback. */
     pj_memcpy(&key->cb, cb, sizeof(pj_ioqueue_callback));
 
+#if PJ_IOQUEUE_STAT
+    pj_bzero(&key->stat, sizeof(key->stat));
+#endif
+
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
     /* Set initial reference count to 1 */
     pj_assert(key->ref_count == 0);
@@ -189,6 +249,7 @@ PJ_INLINE(int) key_has_pending_connect(pj_ioqueue_key_t *key)
 #endif
 
 
+#if !IOQUEUE_HAS_NATIVE_OPS
 /*
  * ioqueue_dispatch_event()
  *
@@ -276,8 +337,11 @@ void ioqueue_dispatch_write_event(pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h)
 	}
 
 	/* Call callback. */
-        if (h->cb.on_connect_complete && !IS_CLOSING(h))
+        if (h->cb.on_connect_complete && !IS_CLOSING(h)) {
+	    KEY_STAT_CB_BEGIN;
 	    (*h->cb.on_connect_complete)(h, status);
+	    KEY_STAT_CB_END(h);
+	}
 
 	/* Unlock if we still hold the lock */
 	if (has_lock) {
@@ -369,6 +433,7 @@ void ioqueue_dispatch_write_event(pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h)
 	    pj_bool_t has_lock;
 
 	    write_op->op = PJ_IOQUEUE_OP_NONE;
+	    KEY_STAT_WRITE(h, write_op->written);
 
             if (h->fd_type != pj_SOCK_DGRAM()) {
                 /* Write completion of the whole stream. */
@@ -396,9 +461,11 @@ void ioqueue_dispatch_write_event(pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h)
 
 	    /* Call callback. */
             if (h->cb.on_write_complete && !IS_CLOSING(h)) {
+		KEY_STAT_CB_BEGIN;
 	        (*h->cb.on_write_complete)(h, 
                                            (pj_ioqueue_op_key_t*)write_op,
                                            write_op->written);
+		KEY_STAT_CB_END(h);
             }
 
 	    if (has_lock) {
@@ -420,7 +487,14 @@ void ioqueue_dispatch_write_event(pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h)
     }
 }
 
-void ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h )
+/*
+ * Returns PJ_TRUE if an operation has been completed, or PJ_FALSE if there
+ * is no pending operation, or if the key is drained (see
+ * IOQUEUE_KEY_DRAINS()) and the socket has no more data (in which case the
+ * operation is kept pending).
+ */
+pj_bool_t ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue,
+				       pj_ioqueue_key_t *h )
 {
     pj_status_t rc;
 
@@ -429,7 +503,7 @@ void ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h )
 
     if (IS_CLOSING(h)) {
 	pj_ioqueue_unlock_key(h);
-	return;
+	return PJ_FALSE;
     }
 
 #   if PJ_HAS_TCP
@@ -449,11 +523,22 @@ void ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h )
 
 	rc=pj_sock_accept(h->fd, accept_op->accept_fd, 
                           accept_op->rmt_addr, accept_op->addrlen);
+	if (rc == PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL) &&
+	    IOQUEUE_KEY_DRAINS(h))
+	{
+	    /* No more connection to accept, keep the operation pending */
+	    accept_op->op = PJ_IOQUEUE_OP_ACCEPT;
+	    pj_list_insert_after(&h->accept_list, accept_op);
+	    ioqueue_add_to_set(ioqueue, h, READABLE_EVENT);
+	    pj_ioqueue_unlock_key(h);
+	    return PJ_FALSE;
+	}
 	if (rc==PJ_SUCCESS && accept_op->local_addr) {
 	    rc = pj_sock_getsockname(*accept_op->accept_fd, 
                                      accept_op->local_addr,
 				     accept_op->addrlen);
 	}
+	KEY_STAT_ACCEPT(h, rc);
 
 	/* Unlock; from this point we don't need to hold key's mutex
 	 * (unless concurrency is disabled, which in this case we should
@@ -471,20 +556,25 @@ void ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h )
 
 	/* Call callback. */
         if (h->cb.on_accept_complete && !IS_CLOSING(h)) {
+	    KEY_STAT_CB_BEGIN;
 	    (*h->cb.on_accept_complete)(h, 
                                         (pj_ioqueue_op_key_t*)accept_op,
                                         *accept_op->accept_fd, rc);
+	    KEY_STAT_CB_END(h);
 	}
 
 	if (has_lock) {
 	    pj_ioqueue_unlock_key(h);
 	}
+
+	return PJ_TRUE;
     }
     else
 #   endif
     if (key_has_pending_read(h)) {
         struct read_operation *read_op;
         pj_ssize_t bytes_read;
+	pj_ioqueue_operation_e op;
 	pj_bool_t has_lock;
 
         /* Get one pending read operation from the list. */
@@ -496,6 +586,7 @@ void ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h )
             ioqueue_remove_from_set(ioqueue, h, READABLE_EVENT);
 
         bytes_read = read_op->size;
+	op = read_op->op;
 
 	if ((read_op->op == PJ_IOQUEUE_OP_RECV_FROM)) {
 	    read_op->op = PJ_IOQUEUE_OP_NONE;
@@ -540,6 +631,17 @@ void ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h )
 #           endif
         }
 	
+	if (rc == PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL) &&
+	    IOQUEUE_KEY_DRAINS(h))
+	{
+	    /* The socket has been drained, keep the operation pending */
+	    read_op->op = op;
+	    pj_list_insert_after(&h->read_list, read_op);
+	    ioqueue_add_to_set(ioqueue, h, READABLE_EVENT);
+	    pj_ioqueue_unlock_key(h);
+	    return PJ_FALSE;
+	}
+
 	if (rc != PJ_SUCCESS) {
 #	    if (defined(PJ_WIN32) && PJ_WIN32 != 0) || \
 	       (defined(PJ_WIN64) && PJ_WIN64 != 0) 
@@ -571,6 +673,7 @@ void ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h )
 	    }
 #endif
 	}
+	KEY_STAT_READ(h, bytes_read);
 
 	/* Unlock; from this point we don't need to hold key's mutex
 	 * (unless concurrency is disabled, which in this case we should
@@ -588,15 +691,19 @@ void ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h )
 
 	/* Call callback. */
         if (h->cb.on_read_complete && !IS_CLOSING(h)) {
+	    KEY_STAT_CB_BEGIN;
 	    (*h->cb.on_read_complete)(h, 
                                       (pj_ioqueue_op_key_t*)read_op,
                                       bytes_read);
+	    KEY_STAT_CB_END(h);
         }
 
 	if (has_lock) {
 	    pj_ioqueue_unlock_key(h);
 	}
 
+	return PJ_TRUE;
+
     } else {
         /*
          * This is normal; execution may fall here when multiple threads
@@ -604,6 +711,7 @@ void ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h )
          * able to process the event.
          */
 	pj_ioqueue_unlock_key(h);
+	return PJ_FALSE;
     }
 }
 
@@ -662,7 +770,11 @@ void ioqueue_dispatch_exception_event( pj_ioqueue_t *ioqueue,
 	}
 #endif
 
-	(*h->cb.on_connect_complete)(h, status);
+	{
+	    KEY_STAT_CB_BEGIN;
+	    (*h->cb.on_connect_complete)(h, status);
+	    KEY_STAT_CB_END(h);
+	}
     }
 
     if (has_lock) {
@@ -707,6 +819,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_recv(  pj_ioqueue_key_t *key,
 	if (status == PJ_SUCCESS) {
 	    /* Yes! Data is available! */
 	    *length = size;
+	    KEY_STAT_READ(key, size);
 	    return PJ_SUCCESS;
 	} else {
 	    /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
@@ -781,6 +894,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_recvfrom( pj_ioqueue_key_t *key,
 	if (status == PJ_SUCCESS) {
 	    /* Yes! Data is available! */
 	    *length = size;
+	    KEY_STAT_READ(key, size);
 	    return PJ_SUCCESS;
 	} else {
 	    /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
@@ -869,6 +983,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_send( pj_ioqueue_key_t *key,
         if (status == PJ_SUCCESS) {
             /* Success! */
             *length = sent;
+            KEY_STAT_WRITE(key, sent);
             return PJ_SUCCESS;
         } else {
             /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
@@ -993,6 +1108,7 @@ retry_on_restart:
         if (status == PJ_SUCCESS) {
             /* Success! */
             *length = sent;
+            KEY_STAT_WRITE(key, sent);
             return PJ_SUCCESS;
         } else {
             /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
@@ -1119,6 +1235,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_accept( pj_ioqueue_key_t *key,
                     return status;
                 }
             }
+            KEY_STAT_ACCEPT(key, status);
             return PJ_SUCCESS;
         } else {
             /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
@@ -1206,6 +1323,8 @@ PJ_DEF(pj_status_t) pj_ioqueue_connect( pj_ioqueue_key_t *key,
 }
 #endif	/* PJ_HAS_TCP */
 
+#endif	/* !IOQUEUE_HAS_NATIVE_OPS */
+
 
 PJ_DEF(void) pj_ioqueue_op_key_init( pj_ioqueue_op_key_t *op_key,
 				     pj_size_t size )
@@ -1229,6 +1348,7 @@ PJ_DEF(pj_bool_t) pj_ioqueue_is_pending( pj_ioqueue_key_t *key,
 }
 
 
+#if !IOQUEUE_HAS_NATIVE_OPS
 /*
  * pj_ioqueue_post_completion()
  */
@@ -1292,6 +1412,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_post_completion( pj_ioqueue_key_t *key,
     
     return PJ_EINVALIDOP;
 }
+#endif	/* !IOQUEUE_HAS_NATIVE_OPS */
 
 PJ_DEF(pj_status_t) pj_ioqueue_set_default_concurrency( pj_ioqueue_t *ioqueue,
 							pj_bool_t allow)
@@ -1302,6 +1423,110 @@ PJ_DEF(pj_status_t) pj_ioqueue_set_default_concurrency( pj_ioqueue_t *ioqueue,
 }
 
 
+PJ_DEF(pj_status_t) pj_ioqueue_set_max_events(pj_ioqueue_t *ioqueue,
+					      unsigned max_events)
+{
+    PJ_ASSERT_RETURN(ioqueue && max_events, PJ_EINVAL);
+
+    if (max_events > PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL)
+	max_events = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL;
+    ioqueue->max_events = max_events;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_ioqueue_get_stat(pj_ioqueue_t *ioqueue,
+					pj_ioqueue_stat *stat)
+{
+    PJ_ASSERT_RETURN(ioqueue && stat, PJ_EINVAL);
+
+    pj_lock_acquire(ioqueue->lock);
+    pj_memcpy(stat, &ioqueue->stat, sizeof(*stat));
+    pj_lock_release(ioqueue->lock);
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_ioqueue_reset_stat(pj_ioqueue_t *ioqueue)
+{
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+
+    pj_lock_acquire(ioqueue->lock);
+    pj_bzero(&ioqueue->stat, sizeof(ioqueue->stat));
+    pj_lock_release(ioqueue->lock);
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_ioqueue_get_key_stat(pj_ioqueue_key_t *key,
+					    pj_ioqueue_key_stat *stat)
+{
+    PJ_ASSERT_RETURN(key && stat, PJ_EINVAL);
+
+#if PJ_IOQUEUE_STAT
+    pj_memcpy(stat, &key->stat, sizeof(*stat));
+    return PJ_SUCCESS;
+#else
+    return PJ_ENOTSUP;
+#endif
+}
+
+
+PJ_DEF(void) pj_ioqueue_dump(pj_ioqueue_t *ioqueue, pj_bool_t detail)
+{
+    pj_ioqueue_stat stat;
+
+    PJ_ASSERT_ON_FAIL(ioqueue, return);
+
+    pj_ioqueue_get_stat(ioqueue, &stat);
+
+    PJ_LOG(3,(THIS_FILE, "Ioqueue %s: %u keys", pj_ioqueue_name(),
+	      ioqueue->count));
+    PJ_LOG(3,(THIS_FILE, " polls: %u, events: %u (avg %u, max %u per poll)",
+	      stat.poll_cnt, stat.event_cnt,
+	      stat.poll_cnt ? stat.event_cnt / stat.poll_cnt : 0,
+	      stat.max_event_cnt));
+    PJ_LOG(3,(THIS_FILE, " dispatched: %u, busy: %u",
+	      stat.dispatch_cnt, stat.busy_cnt));
+
+#if PJ_IOQUEUE_STAT
+    PJ_LOG(3,(THIS_FILE, " dispatch time: %lu usec total, %u usec max",
+	      (unsigned long)stat.dispatch_usec, stat.max_dispatch_usec));
+
+    if (detail) {
+	pj_ioqueue_key_t *h;
+
+	pj_lock_acquire(ioqueue->lock);
+	h = ioqueue->active_list.next;
+	while (h != &ioqueue->active_list) {
+	    const pj_ioqueue_key_stat *ks = &h->stat;
+	    unsigned i;
+	    char hist[PJ_IOQUEUE_CB_HIST_CNT * 11];
+	    int len = 0;
+
+	    for (i=0; i<PJ_IOQUEUE_CB_HIST_CNT; ++i) {
+		len += pj_ansi_snprintf(hist+len, sizeof(hist)-len, " %u",
+					ks->cb_hist[i]);
+	    }
+
+	    PJ_LOG(3,(THIS_FILE, "  fd %ld: rd %u/%lu, wr %u/%lu, acc %u, "
+		      "cb %u, avg %u usec, max %u usec, hist%s",
+		      (long)h->fd, ks->read_cnt,
+		      (unsigned long)ks->read_bytes, ks->write_cnt,
+		      (unsigned long)ks->write_bytes, ks->accept_cnt,
+		      ks->cb_cnt,
+		      ks->cb_cnt ? (unsigned)(ks->cb_usec / ks->cb_cnt) : 0,
+		      ks->max_cb_usec, hist));
+	    h = h->next;
+	}
+	pj_lock_release(ioqueue->lock);
+    }
+#else
+    PJ_UNUSED_ARG(detail);
+#endif
+}
+
+
 PJ_DEF(pj_status_t) pj_ioqueue_set_concurrency(pj_ioqueue_key_t *key,
 					       pj_bool_t allow)
 {
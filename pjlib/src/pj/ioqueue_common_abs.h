@@ -23,10 +23,31 @@
  * This file contains private declarations for abstracting various 
  * event polling/dispatching mechanisms (e.g. select, poll, epoll) 
  * to the ioqueue. 
+ *
+ * A backend which submits the operations to the OS as real asynchronous
+ * operations (e.g. io_uring) defines IOQUEUE_HAS_NATIVE_OPS to 1 before
+ * including this file. It then gets the common declarations and the
+ * common functions, but not the emulation of the proactor pattern (the
+ * event dispatchers and the operation functions), which it must provide.
+ *
+ * A backend which reports a readable key to one thread only, and expects
+ * that thread to read until the socket would block (e.g. epoll with
+ * EPOLLET and EPOLLONESHOT), defines IOQUEUE_KEY_DRAINS(key) to be true
+ * for such key. The read event dispatcher then keeps the read or accept
+ * operation pending when the socket has no more data, instead of
+ * completing it with the EAGAIN error.
  */
 
 #include <pj/list.h>
 
+#ifndef IOQUEUE_HAS_NATIVE_OPS
+#   define IOQUEUE_HAS_NATIVE_OPS	0
+#endif
+
+#ifndef IOQUEUE_KEY_DRAINS
+#   define IOQUEUE_KEY_DRAINS(key)	0
+#endif
+
 /*
  * The select ioqueue relies on socket functions (pj_sock_xxx()) to return
  * the correct error code.
@@ -63,7 +84,7 @@ struct write_operation
     pj_size_t		    size;
     pj_ssize_t              written;
     unsigned                flags;
-    pj_sockaddr_in	    rmt_addr;
+    pj_sockaddr		    rmt_addr;
     int			    rmt_addrlen;
 };
 
@@ -98,6 +119,43 @@ union operation_key
 #   define UNREG_FIELDS
 #endif
 
+#if PJ_IOQUEUE_STAT
+#   define STAT_FIELDS			\
+	pj_ioqueue_key_stat stat;
+    /* Keys that allow concurrency are dispatched by several threads at
+     * once, and the operations may also complete in the caller's thread.
+     */
+#   if PJ_HAS_ATOMIC_BUILTINS
+#	define KEY_STAT_ADD(var,val)	__atomic_add_fetch(&(var), val, \
+						   __ATOMIC_RELAXED)
+#   else
+#	define KEY_STAT_ADD(var,val)	((var) += (val))
+#   endif
+    /* Failed operations (negative n) are not counted */
+#   define KEY_STAT_READ(h,n)		\
+	do { if ((n) >= 0) { KEY_STAT_ADD((h)->stat.read_cnt, 1); \
+			     KEY_STAT_ADD((h)->stat.read_bytes, (n)); } \
+	} while (0)
+#   define KEY_STAT_WRITE(h,n)		\
+	do { if ((n) >= 0) { KEY_STAT_ADD((h)->stat.write_cnt, 1); \
+			     KEY_STAT_ADD((h)->stat.write_bytes, (n)); } \
+	} while (0)
+#   define KEY_STAT_ACCEPT(h,rc)	\
+	do { if ((rc) == PJ_SUCCESS) \
+		KEY_STAT_ADD((h)->stat.accept_cnt, 1); } while (0)
+    /* Must be the first statement in the block calling the callback */
+#   define KEY_STAT_CB_BEGIN		pj_timestamp cb_start_; \
+					pj_get_timestamp(&cb_start_)
+#   define KEY_STAT_CB_END(h)		key_stat_cb_done(h, &cb_start_)
+#else
+#   define STAT_FIELDS
+#   define KEY_STAT_READ(h,n)
+#   define KEY_STAT_WRITE(h,n)
+#   define KEY_STAT_ACCEPT(h,rc)
+#   define KEY_STAT_CB_BEGIN
+#   define KEY_STAT_CB_END(h)
+#endif
+
 #define DECLARE_COMMON_KEY                          \
     PJ_DECL_LIST_MEMBER(struct pj_ioqueue_key_t);   \
     pj_ioqueue_t           *ioqueue;                \
@@ -114,15 +172,19 @@ union operation_key
     struct read_operation   read_list;              \
     struct write_operation  write_list;             \
     struct accept_operation accept_list;	    \
-    UNREG_FIELDS
+    UNREG_FIELDS				    \
+    STAT_FIELDS
 
 
 #define DECLARE_COMMON_IOQUEUE                      \
     pj_lock_t          *lock;                       \
     pj_bool_t           auto_delete_lock;	    \
-    pj_bool_t		default_concurrency;
+    pj_bool_t		default_concurrency;	    \
+    unsigned		max_events;		    \
+    pj_ioqueue_stat	stat;
 
 
+#if !IOQUEUE_HAS_NATIVE_OPS
 enum ioqueue_event_type
 {
     NO_EVENT,
@@ -137,4 +199,5 @@ static void ioqueue_add_to_set( pj_ioqueue_t *ioqueue,
 static void ioqueue_remove_from_set( pj_ioqueue_t *ioqueue,
                                      pj_ioqueue_key_t *key, 
                                      enum ioqueue_event_type event_type);
+#endif
 
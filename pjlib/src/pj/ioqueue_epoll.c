@@ -78,6 +78,8 @@
 	EPOLLOUT = 0x004,
 	EPOLLERR = 0x008,
     };
+#   define EPOLLONESHOT		(1u << 30)
+#   define EPOLLET		(1u << 31)
 #   define os_epoll_create		sys_epoll_create
     static int os_epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
     {
@@ -146,6 +148,9 @@
 //#define TRACE_(expr) PJ_LOG(3,expr)
 #define TRACE_(expr)
 
+/* One-shot keys are drained by the thread which dispatches them */
+#define IOQUEUE_KEY_DRAINS(key)	((key)->oneshot)
+
 /*
  * Include common ioqueue abstraction.
  */
@@ -157,12 +162,24 @@
 struct pj_ioqueue_key_t
 {
     DECLARE_COMMON_KEY
+
+    /* Set when the key is being dispatched by a polling thread, so that
+     * other polling threads leave the key alone (unless the key allows
+     * concurrency). Protected by the ioqueue's lock.
+     */
+    pj_bool_t		    dispatching;
+
+    /* The key is registered with EPOLLET and EPOLLONESHOT, and is re-armed
+     * by the thread which dispatches it.
+     */
+    pj_bool_t		    oneshot;
 };
 
 struct queue
 {
     pj_ioqueue_key_t	    *key;
     enum ioqueue_event_type  event_type;
+    pj_bool_t		     exclusive;
 };
 
 /*
@@ -173,6 +190,13 @@ struct pj_ioqueue_t
     DECLARE_COMMON_IOQUEUE
 
     unsigned		max, count;
+    pj_bool_t		default_oneshot;
+
+    /* Polling threads waiting for a busy key to be released, see
+     * pj_ioqueue_poll(). Protected by the ioqueue's lock.
+     */
+    pj_sem_t	       *busy_sem;
+    unsigned		busy_waiters;
     //pj_ioqueue_key_t	hlist;
     pj_ioqueue_key_t	active_list;    
     int			epfd;
@@ -208,6 +232,14 @@ PJ_DEF(const char*) pj_ioqueue_name(void)
 #endif
 }
 
+/*
+ * pj_ioqueue_get_features()
+ */
+PJ_DEF(unsigned) pj_ioqueue_get_features(void)
+{
+    return PJ_IOQUEUE_FEATURE_DIRECT_READ;
+}
+
 /*
  * pj_ioqueue_create()
  *
@@ -236,6 +268,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
 
     ioqueue->max = max_fd;
     ioqueue->count = 0;
+    ioqueue->default_oneshot = PJ_IOQUEUE_DEFAULT_ONESHOT;
     pj_list_init(&ioqueue->active_list);
 
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
@@ -286,8 +319,16 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
     if (rc != PJ_SUCCESS)
         return rc;
 
+    ioqueue->busy_waiters = 0;
+    rc = pj_sem_create(pool, "ioqbusy%p", 0, PJ_MAXINT32, &ioqueue->busy_sem);
+    if (rc != PJ_SUCCESS) {
+	ioqueue_destroy(ioqueue);
+	return rc;
+    }
+
     ioqueue->epfd = os_epoll_create(max_fd);
     if (ioqueue->epfd < 0) {
+	pj_sem_destroy(ioqueue->busy_sem);
 	ioqueue_destroy(ioqueue);
 	return PJ_RETURN_OS_ERROR(pj_get_native_os_error());
     }
@@ -342,9 +383,51 @@ PJ_DEF(pj_status_t) pj_ioqueue_destroy(pj_ioqueue_t *ioqueue)
 
     pj_mutex_destroy(ioqueue->ref_cnt_mutex);
 #endif
+    pj_sem_destroy(ioqueue->busy_sem);
     return ioqueue_destroy(ioqueue);
 }
 
+/*
+ * pj_ioqueue_set_oneshot()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_oneshot(pj_ioqueue_t *ioqueue,
+					   pj_bool_t enable)
+{
+    PJ_ASSERT_RETURN(ioqueue != NULL, PJ_EINVAL);
+    ioqueue->default_oneshot = enable;
+    return PJ_SUCCESS;
+}
+
+/* Get the events to arm a one-shot key with, according to its pending
+ * operations.
+ */
+static pj_uint32_t oneshot_events(pj_ioqueue_key_t *h)
+{
+    pj_uint32_t events = EPOLLERR | EPOLLET | EPOLLONESHOT;
+
+    if (key_has_pending_read(h) || key_has_pending_accept(h))
+	events |= EPOLLIN;
+    if (key_has_pending_write(h) || h->connecting)
+	events |= EPOLLOUT;
+
+    return events;
+}
+
+/* Arm a one-shot key, with the key's lock held. A key without pending
+ * operation is left disarmed until an operation is queued.
+ */
+static void oneshot_arm(pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h)
+{
+    struct epoll_event ev;
+
+    ev.events = oneshot_events(h);
+    if ((ev.events & (EPOLLIN | EPOLLOUT)) == 0)
+	return;
+
+    ev.epoll_data = (epoll_data_type)h;
+    os_epoll_ctl(ioqueue->epfd, EPOLL_CTL_MOD, h->fd, &ev);
+}
+
 /*
  * pj_ioqueue_register_sock()
  *
@@ -410,6 +493,8 @@ PJ_DEF(pj_status_t) pj_ioqueue_register_sock2(pj_pool_t *pool,
 	key = NULL;
 	goto on_return;
     }
+    key->dispatching = PJ_FALSE;
+    key->oneshot = ioqueue->default_oneshot;
 
     /* Create key's mutex */
  /*   rc = pj_mutex_create_recursive(pool, NULL, &key->mutex);
@@ -419,7 +504,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_register_sock2(pj_pool_t *pool,
     }
 */
     /* os_epoll_ctl. */
-    ev.events = EPOLLIN | EPOLLERR;
+    ev.events = key->oneshot ? oneshot_events(key) : EPOLLIN | EPOLLERR;
     ev.epoll_data = (epoll_data_type)key;
     status = os_epoll_ctl(ioqueue->epfd, EPOLL_CTL_ADD, sock, &ev);
     if (status < 0) {
@@ -590,6 +675,10 @@ static void ioqueue_remove_from_set( pj_ioqueue_t *ioqueue,
                                      pj_ioqueue_key_t *key, 
                                      enum ioqueue_event_type event_type)
 {
+    /* One-shot key is re-armed after it's dispatched */
+    if (key->oneshot)
+	return;
+
     if (event_type == WRITEABLE_EVENT) {
 	struct epoll_event ev;
 
@@ -609,6 +698,21 @@ static void ioqueue_add_to_set( pj_ioqueue_t *ioqueue,
                                 pj_ioqueue_key_t *key,
                                 enum ioqueue_event_type event_type )
 {
+    /* A one-shot key being dispatched will be re-armed by the polling
+     * thread once it's done.
+     */
+    if (key->oneshot) {
+	pj_bool_t dispatching;
+
+	pj_lock_acquire(ioqueue->lock);
+	dispatching = key->dispatching;
+	pj_lock_release(ioqueue->lock);
+
+	if (!dispatching)
+	    oneshot_arm(ioqueue, key);
+	return;
+    }
+
     if (event_type == WRITEABLE_EVENT) {
 	struct epoll_event ev;
 
@@ -645,29 +749,106 @@ static void scan_closing_keys(pj_ioqueue_t *ioqueue)
 }
 #endif
 
+/* Release a key that this thread has been dispatching exclusively, and
+ * wake up the polling threads which found nothing but busy keys.
+ */
+static void release_dispatching(pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h)
+{
+    unsigned waiters;
+
+    pj_lock_acquire(ioqueue->lock);
+    h->dispatching = PJ_FALSE;
+    waiters = ioqueue->busy_waiters;
+    ioqueue->busy_waiters = 0;
+    pj_lock_release(ioqueue->lock);
+
+    while (waiters--)
+	pj_sem_post(ioqueue->busy_sem);
+}
+
+/* Dispatch the event of a one-shot key. The calling thread owns the key
+ * until it's re-armed, as the key is disabled once its event has been
+ * reported. Read operations are completed until the socket has no more
+ * data, so the key only needs to be re-armed once for a burst of packets.
+ * Returns the number of operations completed.
+ */
+static int dispatch_oneshot(pj_ioqueue_t *ioqueue, pj_ioqueue_key_t *h,
+			    enum ioqueue_event_type event_type)
+{
+    int completed = 0;
+
+    switch (event_type) {
+    case READABLE_EVENT:
+	while (completed < PJ_IOQUEUE_ONESHOT_MAX_DRAIN &&
+	       ioqueue_dispatch_read_event(ioqueue, h))
+	{
+	    ++completed;
+	}
+	break;
+    case WRITEABLE_EVENT:
+	ioqueue_dispatch_write_event(ioqueue, h);
+	completed = 1;
+	break;
+    case EXCEPTION_EVENT:
+	ioqueue_dispatch_exception_event(ioqueue, h);
+	completed = 1;
+	break;
+    case NO_EVENT:
+	/* Nothing is pending, the key just needs to be re-armed */
+	break;
+    }
+
+    /* Re-arm the key for the operations which are still pending. The
+     * kernel reports the key right away if the socket is still ready.
+     */
+    pj_ioqueue_lock_key(h);
+    release_dispatching(ioqueue, h);
+    if (!IS_CLOSING(h))
+	oneshot_arm(ioqueue, h);
+    pj_ioqueue_unlock_key(h);
+
+    return completed;
+}
+
 /*
  * pj_ioqueue_poll()
  *
+ * Up to ioqueue->max_events events are retrieved with a single
+ * epoll_wait() and dispatched in the order they are reported. Since
+ * epoll moves the reported descriptors to the end of its ready list, keys
+ * are served in round robin fashion and a busy key can't starve the
+ * others. A key which is being dispatched by another thread is skipped
+ * (unless it allows concurrency); its event will be reported again by a
+ * subsequent poll. When all events are skipped that way, the thread blocks
+ * until a dispatching thread releases its key instead of polling again
+ * right away.
+ *
+ * A one-shot key is disabled by the kernel once its event is reported, so
+ * it's always queued to be dispatched and re-armed by this thread, even
+ * when it has no pending operation. Such key is not counted in the return
+ * value, which is the number of operations completed.
  */
 PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 {
-    int i, count, processed;
+    int i, count, queued, rearm, processed, busy;
+    pj_bool_t wait_busy = PJ_FALSE;
     int msec;
     //struct epoll_event *events = ioqueue->events;
     //struct queue *queue = ioqueue->queue;
     struct epoll_event events[PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL];
     struct queue queue[PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL];
-    pj_timestamp t1, t2;
+#if PJ_IOQUEUE_STAT
+    pj_timestamp dispatch_start;
+#endif
     
     PJ_CHECK_STACK();
 
     msec = timeout ? PJ_TIME_VAL_MSEC(*timeout) : 9000;
 
     TRACE_((THIS_FILE, "start os_epoll_wait, msec=%d", msec));
-    pj_get_timestamp(&t1);
  
     //count = os_epoll_wait( ioqueue->epfd, events, ioqueue->max, msec);
-    count = os_epoll_wait( ioqueue->epfd, events, PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL, msec);
+    count = os_epoll_wait( ioqueue->epfd, events, ioqueue->max_events, msec);
     if (count == 0) {
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
     /* Check the closing keys only when there's no activity and when there are
@@ -687,118 +868,146 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 	return -pj_get_netos_error();
     }
 
-    pj_get_timestamp(&t2);
-    TRACE_((THIS_FILE, "os_epoll_wait returns %d, time=%d usec",
-		       count, pj_elapsed_usec(&t1, &t2)));
+    TRACE_((THIS_FILE, "os_epoll_wait returns %d", count));
+
+    /* Let the callbacks use the cached clock instead of reading it */
+    pj_coarse_clock_enter(NULL);
 
     /* Lock ioqueue. */
     pj_lock_acquire(ioqueue->lock);
 
-    for (processed=0, i=0; i<count; ++i) {
+    for (queued=0, rearm=0, busy=0, i=0; i<count; ++i) {
 	pj_ioqueue_key_t *h = (pj_ioqueue_key_t*)(epoll_data_type)
 				events[i].epoll_data;
+	enum ioqueue_event_type event_type = NO_EVENT;
 
 	TRACE_((THIS_FILE, "event %d: events=%d", i, events[i].events));
 
+	if (IS_CLOSING(h))
+	    continue;
+
 	/*
 	 * Check readability.
 	 */
 	if ((events[i].events & EPOLLIN) && 
-	    (key_has_pending_read(h) || key_has_pending_accept(h)) && !IS_CLOSING(h) ) {
-
-#if PJ_IOQUEUE_HAS_SAFE_UNREG
-	    increment_counter(h);
-#endif
-	    queue[processed].key = h;
-	    queue[processed].event_type = READABLE_EVENT;
-	    ++processed;
-	    continue;
+	    (key_has_pending_read(h) || key_has_pending_accept(h)))
+	{
+	    event_type = READABLE_EVENT;
 	}
-
 	/*
 	 * Check for writeability.
 	 */
-	if ((events[i].events & EPOLLOUT) && key_has_pending_write(h) && !IS_CLOSING(h)) {
-
-#if PJ_IOQUEUE_HAS_SAFE_UNREG
-	    increment_counter(h);
-#endif
-	    queue[processed].key = h;
-	    queue[processed].event_type = WRITEABLE_EVENT;
-	    ++processed;
-	    continue;
+	else if ((events[i].events & EPOLLOUT) && key_has_pending_write(h)) {
+	    event_type = WRITEABLE_EVENT;
 	}
-
 #if PJ_HAS_TCP
 	/*
 	 * Check for completion of connect() operation.
 	 */
-	if ((events[i].events & EPOLLOUT) && (h->connecting) && !IS_CLOSING(h)) {
-
-#if PJ_IOQUEUE_HAS_SAFE_UNREG
-	    increment_counter(h);
-#endif
-	    queue[processed].key = h;
-	    queue[processed].event_type = WRITEABLE_EVENT;
-	    ++processed;
-	    continue;
+	else if ((events[i].events & EPOLLOUT) && (h->connecting)) {
+	    event_type = WRITEABLE_EVENT;
 	}
 #endif /* PJ_HAS_TCP */
-
 	/*
 	 * Check for error condition.
 	 */
-	if ((events[i].events & EPOLLERR) && !IS_CLOSING(h)) {
+	else if (events[i].events & EPOLLERR) {
 	    /*
 	     * We need to handle this exception event.  If it's related to us
 	     * connecting, report it as such.  If not, just report it as a
 	     * read event and the higher layers will handle it.
 	     */
 	    if (h->connecting) {
-#if PJ_IOQUEUE_HAS_SAFE_UNREG
-		increment_counter(h);
-#endif
-		queue[processed].key = h;
-		queue[processed].event_type = EXCEPTION_EVENT;
-		++processed;
+		event_type = EXCEPTION_EVENT;
 	    } else if (key_has_pending_read(h) || key_has_pending_accept(h)) {
-#if PJ_IOQUEUE_HAS_SAFE_UNREG
-		increment_counter(h);
-#endif
-		queue[processed].key = h;
-		queue[processed].event_type = READABLE_EVENT;
-		++processed;
+		event_type = READABLE_EVENT;
 	    }
+	}
+
+	if (event_type == NO_EVENT && !h->oneshot)
+	    continue;
+
+	/* Leave the key alone if another thread is dispatching it, rather
+	 * than blocking on the key's lock. For one-shot key, that thread
+	 * will re-arm it.
+	 */
+	if (h->dispatching) {
+	    ++busy;
 	    continue;
 	}
+
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+	increment_counter(h);
+#endif
+	queue[queued].key = h;
+	queue[queued].event_type = event_type;
+	queue[queued].exclusive = !h->allow_concurrent || h->oneshot;
+	if (queue[queued].exclusive)
+	    h->dispatching = PJ_TRUE;
+	if (event_type == NO_EVENT)
+	    ++rearm;
+	++queued;
     }
-    for (i=0; i<processed; ++i) {
+    for (i=0; i<queued; ++i) {
 	if (queue[i].key->grp_lock)
 	    pj_grp_lock_add_ref_dbg(queue[i].key->grp_lock, "ioqueue", 0);
     }
 
+    ++ioqueue->stat.poll_cnt;
+    ioqueue->stat.event_cnt += count;
+    /* One-shot keys with no event are only queued to be re-armed */
+    ioqueue->stat.dispatch_cnt += queued - rearm;
+    ioqueue->stat.busy_cnt += busy;
+    if ((unsigned)count > ioqueue->stat.max_event_cnt)
+	ioqueue->stat.max_event_cnt = count;
+
+    /* If all events were skipped because other threads are dispatching
+     * the keys, wait for one of them to be released (the busy flag is
+     * cleared under the ioqueue's lock, so the wakeup can't be missed),
+     * since the events would be reported again right away.
+     */
+    if (busy && !queued && msec > 0) {
+	++ioqueue->busy_waiters;
+	wait_busy = PJ_TRUE;
+    }
+
     PJ_RACE_ME(5);
 
     pj_lock_release(ioqueue->lock);
 
     PJ_RACE_ME(5);
 
-    /* Now process the events. */
-    for (i=0; i<processed; ++i) {
-	switch (queue[i].event_type) {
-        case READABLE_EVENT:
-            ioqueue_dispatch_read_event(ioqueue, queue[i].key);
-            break;
-        case WRITEABLE_EVENT:
-            ioqueue_dispatch_write_event(ioqueue, queue[i].key);
-            break;
-        case EXCEPTION_EVENT:
-            ioqueue_dispatch_exception_event(ioqueue, queue[i].key);
-            break;
-        case NO_EVENT:
-            pj_assert(!"Invalid event!");
-            break;
-        }
+#if PJ_IOQUEUE_STAT
+    pj_get_timestamp(&dispatch_start);
+#endif
+
+    /* Now process the events, counting the completed operations. */
+    for (processed=0, i=0; i<queued; ++i) {
+	if (queue[i].key->oneshot) {
+	    processed += dispatch_oneshot(ioqueue, queue[i].key,
+					  queue[i].event_type);
+	} else {
+	    switch (queue[i].event_type) {
+	    case READABLE_EVENT:
+		if (ioqueue_dispatch_read_event(ioqueue, queue[i].key))
+		    ++processed;
+		break;
+	    case WRITEABLE_EVENT:
+		ioqueue_dispatch_write_event(ioqueue, queue[i].key);
+		++processed;
+		break;
+	    case EXCEPTION_EVENT:
+		ioqueue_dispatch_exception_event(ioqueue, queue[i].key);
+		++processed;
+		break;
+	    case NO_EVENT:
+		pj_assert(!"Invalid event!");
+		break;
+	    }
+
+	    if (queue[i].exclusive)
+		release_dispatching(ioqueue, queue[i].key);
+	}
 
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
 	decrement_counter(queue[i].key);
@@ -809,17 +1018,23 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 	                            "ioqueue", 0);
     }
 
+#if PJ_IOQUEUE_STAT
+    if (queued)
+	ioqueue_stat_dispatch_done(ioqueue, &dispatch_start);
+#endif
+
+    pj_coarse_clock_leave();
+
     /* Special case:
      * When epoll returns > 0 but no descriptors are actually set!
      */
-    if (count > 0 && !processed && msec > 0) {
+    if (wait_busy) {
+	pj_sem_wait(ioqueue->busy_sem);
+    } else if (count > 0 && !queued && msec > 0) {
 	pj_thread_sleep(msec);
     }
 
-    pj_get_timestamp(&t1);
-    TRACE_((THIS_FILE, "ioqueue_poll() returns %d, time=%d usec",
-		       processed, pj_elapsed_usec(&t2, &t1)));
+    TRACE_((THIS_FILE, "ioqueue_poll() returns %d", processed));
 
     return processed;
 }
-
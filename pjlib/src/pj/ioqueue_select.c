@@ -149,6 +149,14 @@ PJ_DEF(const char*) pj_ioqueue_name(void)
     return "select";
 }
 
+/*
+ * pj_ioqueue_get_features()
+ */
+PJ_DEF(unsigned) pj_ioqueue_get_features(void)
+{
+    return PJ_IOQUEUE_FEATURE_DIRECT_READ;
+}
+
 /* 
  * Scan the socket descriptor sets for the largest descriptor.
  * This value is needed by select().
@@ -308,6 +316,18 @@ PJ_DEF(pj_status_t) pj_ioqueue_destroy(pj_ioqueue_t *ioqueue)
 }
 
 
+/*
+ * pj_ioqueue_set_oneshot()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_oneshot(pj_ioqueue_t *ioqueue,
+					   pj_bool_t enable)
+{
+    /* select() has no one-shot registration */
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+    return enable ? PJ_ENOTSUP : PJ_SUCCESS;
+}
+
+
 /*
  * pj_ioqueue_register_sock()
  *
@@ -837,6 +857,9 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
         pj_ioqueue_key_t	*key;
         enum ioqueue_event_type  event_type;
     } event[PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL];
+#if PJ_IOQUEUE_STAT
+    pj_timestamp dispatch_start;
+#endif
 
     PJ_ASSERT_RETURN(ioqueue, -PJ_EINVAL);
 
@@ -889,6 +912,9 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
     else if (count > PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL)
         count = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL;
 
+    /* Let the callbacks use the cached clock instead of reading it */
+    pj_coarse_clock_enter(NULL);
+
     /* Scan descriptor sets for event and add the events in the event
      * array to be processed later in this function. We do this so that
      * events can be processed in parallel without holding ioqueue lock.
@@ -946,6 +972,12 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 	    pj_grp_lock_add_ref_dbg(event[i].key->grp_lock, "ioqueue", 0);
     }
 
+    ++ioqueue->stat.poll_cnt;
+    ioqueue->stat.event_cnt += count;
+    ioqueue->stat.dispatch_cnt += counter;
+    if ((unsigned)count > ioqueue->stat.max_event_cnt)
+	ioqueue->stat.max_event_cnt = count;
+
     PJ_RACE_ME(5);
 
     pj_lock_release(ioqueue->lock);
@@ -954,6 +986,10 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 
     count = counter;
 
+#if PJ_IOQUEUE_STAT
+    pj_get_timestamp(&dispatch_start);
+#endif
+
     /* Now process all events. The dispatch functions will take care
      * of locking in each of the key
      */
@@ -982,6 +1018,12 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
 	                            "ioqueue", 0);
     }
 
+#if PJ_IOQUEUE_STAT
+    if (count)
+	ioqueue_stat_dispatch_done(ioqueue, &dispatch_start);
+#endif
+
+    pj_coarse_clock_leave();
 
     return count;
 }
@@ -455,6 +455,14 @@ PJ_DEF(const char*) pj_ioqueue_name(void)
     return "ioqueue-symbian";
 }
 
+/*
+ * Return the features of the ioqueue implementation.
+ */
+PJ_DEF(unsigned) pj_ioqueue_get_features(void)
+{
+    return 0;
+}
+
 
 /*
  * Create a new I/O Queue framework.
@@ -509,6 +517,51 @@ PJ_DEF(pj_status_t) pj_ioqueue_set_default_concurrency(pj_ioqueue_t *ioqueue,
 	return PJ_SUCCESS;
 }
 
+PJ_DEF(pj_status_t) pj_ioqueue_set_max_events(pj_ioqueue_t *ioqueue,
+					      unsigned max_events)
+{
+	/* Not supported, just return PJ_SUCCESS silently */
+	PJ_UNUSED_ARG(ioqueue);
+	PJ_UNUSED_ARG(max_events);
+	return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_oneshot(pj_ioqueue_t *ioqueue,
+					   pj_bool_t enable)
+{
+	/* Not supported */
+	PJ_UNUSED_ARG(ioqueue);
+	return enable ? PJ_ENOTSUP : PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_get_stat(pj_ioqueue_t *ioqueue,
+					pj_ioqueue_stat *stat)
+{
+	PJ_UNUSED_ARG(ioqueue);
+	PJ_UNUSED_ARG(stat);
+	return PJ_ENOTSUP;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_reset_stat(pj_ioqueue_t *ioqueue)
+{
+	PJ_UNUSED_ARG(ioqueue);
+	return PJ_ENOTSUP;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_get_key_stat(pj_ioqueue_key_t *key,
+					    pj_ioqueue_key_stat *stat)
+{
+	PJ_UNUSED_ARG(key);
+	PJ_UNUSED_ARG(stat);
+	return PJ_ENOTSUP;
+}
+
+PJ_DEF(void) pj_ioqueue_dump(pj_ioqueue_t *ioqueue, pj_bool_t detail)
+{
+	PJ_UNUSED_ARG(ioqueue);
+	PJ_UNUSED_ARG(detail);
+}
+
 /*
  * Register a socket to the I/O queue framework. 
  */
@@ -0,0 +1,2545 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/*
+ * ioqueue_uring.c
+ *
+ * This is the implementation of IOQueue framework using Linux io_uring.
+ * Unlike the select and epoll backends, which emulate the proactor
+ * pattern by waiting for readiness and then calling the socket function,
+ * operations here are submitted to the kernel as real asynchronous
+ * operations and the ioqueue only reaps their completions:
+ *
+ *  - datagram sockets use a multishot recvmsg into buffers provided to
+ *    the kernel by the ioqueue (kernel 6.0 or later), so one submission
+ *    keeps receiving packets for as long as the key is registered.
+ *    Packets arriving while the application has no pending read are kept
+ *    in the key's backlog. On older kernels, or for stream sockets, a
+ *    single-shot receive is submitted directly into the buffer of the
+ *    first pending read operation.
+ *  - send, accept and connect are tried immediately (except connect);
+ *    when they would block, one operation per key is submitted at a time
+ *    so ordering is preserved.
+ *  - submissions made from within a callback are batched and flushed by
+ *    the polling thread after the events are dispatched.
+ *
+ * The ring is driven with raw system calls, so liburing is not needed.
+ * Linux 5.11 or later is required (IORING_FEAT_EXT_ARG).
+ */
+
+#include <pj/ioqueue.h>
+#include <pj/os.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/list.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/sock.h>
+#include <pj/compat/socket.h>
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#if !PJ_IOQUEUE_HAS_SAFE_UNREG
+#   error "io_uring ioqueue requires PJ_IOQUEUE_HAS_SAFE_UNREG"
+#endif
+
+#if (PJ_IOQUEUE_URING_BUF_CNT & (PJ_IOQUEUE_URING_BUF_CNT-1)) != 0 || \
+    PJ_IOQUEUE_URING_BUF_CNT > 32768
+#   error "PJ_IOQUEUE_URING_BUF_CNT must be a power of two up to 32768"
+#endif
+
+#ifndef __NR_io_uring_setup
+#   define __NR_io_uring_setup		425
+#endif
+#ifndef __NR_io_uring_enter
+#   define __NR_io_uring_enter		426
+#endif
+#ifndef __NR_io_uring_register
+#   define __NR_io_uring_register	427
+#endif
+
+/* Multishot receive with provided buffer ring needs 6.0 kernel headers */
+#if defined(IORING_RECV_MULTISHOT)
+#   define HAS_MULTISHOT_RECV		1
+#else
+#   define HAS_MULTISHOT_RECV		0
+#endif
+
+#define THIS_FILE   "ioq_uring"
+
+//#define TRACE_(expr) PJ_LOG(3,expr)
+#define TRACE_(expr)
+
+/* Buffer group ID of the provided buffer ring */
+#define RX_BGID		0
+
+/* Maximum number of packets kept in a key's backlog before the multishot
+ * receive is stopped, leaving the rest in the socket buffer.
+ */
+#define RX_BACKLOG_MAX	(PJ_IOQUEUE_URING_BUF_CNT/8 ? \
+			 PJ_IOQUEUE_URING_BUF_CNT/8 : 1)
+
+/*
+ * The completion's user_data carries the key pointer and the type of the
+ * operation in its lowest bits. A zero key is used for cancel requests,
+ * whose completions are ignored.
+ */
+enum uring_tag
+{
+    TAG_NONE,
+    TAG_RECV,		/* single-shot receive into rx_op's buffer	*/
+    TAG_RECV_MULTI,	/* multishot receive into provided buffers	*/
+    TAG_SEND,
+    TAG_ACCEPT,
+    TAG_CONNECT,
+    TAG_KICK		/* NOP to get the key's backlog delivered	*/
+};
+#define TAG_MASK	7
+
+#define USER_DATA(key,tag)  ((pj_uint64_t)(pj_size_t)(key) | (tag))
+
+/*
+ * Include common ioqueue abstraction. The operations are submitted to the
+ * kernel, so the proactor emulation of the other backends is not used.
+ */
+#define IOQUEUE_HAS_NATIVE_OPS	1
+#include "ioqueue_common_abs.h"
+
+/*
+ * This describes each key.
+ */
+struct pj_ioqueue_key_t
+{
+    DECLARE_COMMON_KEY
+
+    /* Receive state, protected by ioqueue's rx_mutex. */
+    pj_bool_t		    rx_armed;	/* receive submission in flight	*/
+    int			    rx_tag;	/* .. and its tag		*/
+    pj_bool_t		    rx_cancel;	/* multishot is being cancelled	*/
+    pj_bool_t		    rx_starved;	/* waiting for free buffers	*/
+    pj_ioqueue_key_t	   *rx_starved_next;
+    int			    rx_head;	/* backlog of received buffers	*/
+    int			    rx_tail;
+    unsigned		    rx_cnt;
+    pj_size_t		    rx_max;	/* largest read requested	*/
+    pj_status_t		    rx_status;	/* receive error to report	*/
+    struct read_operation  *rx_op;	/* target of single-shot recv	*/
+    struct msghdr	    rx_msg;
+    struct iovec	    rx_iov;
+    pj_sockaddr		    rx_addr;
+
+    /* Send state, protected by key's lock. */
+    pj_bool_t		    tx_busy;
+    struct write_operation *tx_op;
+    struct msghdr	    tx_msg;
+    struct iovec	    tx_iov;
+
+#if PJ_HAS_TCP
+    /* Accept and connect state, protected by key's lock. */
+    pj_bool_t		    acc_busy;
+    struct accept_operation*acc_op;
+    pj_sockaddr		    acc_addr;
+    socklen_t		    acc_addrlen;
+    pj_sockaddr		    conn_addr;
+#endif
+};
+
+/* Info of a provided receive buffer while it's in a key's backlog. */
+struct rx_buf
+{
+    int			    next;
+    unsigned		    off;
+    unsigned		    len;
+    unsigned		    full_len;	/* > len if truncated		*/
+    int			    addrlen;
+};
+
+/* A completion, harvested from the completion queue to be dispatched. */
+struct event
+{
+    pj_ioqueue_key_t	   *key;
+    pj_grp_lock_t	   *grp_lock;
+    int			    tag;
+    int			    res;
+};
+
+/*
+ * This describes the I/O queue.
+ */
+struct pj_ioqueue_t
+{
+    DECLARE_COMMON_IOQUEUE
+
+    unsigned		max, count;
+    pj_ioqueue_key_t	active_list;
+    pj_mutex_t	       *ref_cnt_mutex;
+    pj_ioqueue_key_t	closing_list;
+    pj_ioqueue_key_t	free_list;
+
+    /* The ring */
+    int			ring_fd;
+    void	       *sq_ring;
+    pj_size_t		sq_ring_sz;
+    void	       *cq_ring;
+    pj_size_t		cq_ring_sz;
+    struct io_uring_sqe*sqes;
+    pj_size_t		sqes_sz;
+    unsigned	       *sq_khead;
+    unsigned	       *sq_ktail;
+    unsigned		sq_mask;
+    unsigned		sq_entries;
+    unsigned	       *cq_khead;
+    unsigned	       *cq_ktail;
+    unsigned		cq_mask;
+    struct io_uring_cqe*cqes;
+
+    /* Submission. Submissions are deferred while the thread is
+     * dispatching events of this ioqueue (tls_id is set).
+     */
+    pj_mutex_t	       *sq_mutex;
+    unsigned		sq_tail;
+    pj_bool_t		sq_deferred;
+    long		tls_id;
+
+    /* Provided receive buffers, protected by rx_mutex. They are set up
+     * when the first multishot receive is armed (buf_size is zero until
+     * then).
+     */
+    pj_bool_t		multishot;
+    pj_mutex_t	       *rx_mutex;
+#if HAS_MULTISHOT_RECV
+    struct io_uring_buf_ring *br;
+    pj_size_t		br_sz;
+    unsigned		br_tail;
+#endif
+    char	       *bufs;
+    pj_size_t		bufs_sz;
+    unsigned		buf_size;
+    struct rx_buf      *buf_info;
+    pj_ioqueue_key_t   *starved;
+};
+
+/* Include implementation for common abstraction after we declare
+ * pj_ioqueue_key_t and pj_ioqueue_t.
+ */
+#include "ioqueue_common_abs.c"
+
+
+static void scan_closing_keys(pj_ioqueue_t *ioqueue);
+static pj_status_t arm_rx(pj_ioqueue_key_t *key);
+static pj_status_t kick_key(pj_ioqueue_key_t *key);
+
+
+/*
+ * io_uring system calls.
+ */
+static int sys_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+			   unsigned flags, void *arg, pj_size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			flags, arg, argsz);
+}
+
+#if HAS_MULTISHOT_RECV
+static int sys_uring_register(int fd, unsigned opcode, void *arg,
+			      unsigned nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+#endif
+
+/*
+ * Submit the SQEs queued so far.
+ */
+static void flush_sqes(pj_ioqueue_t *ioqueue)
+{
+    int rc;
+
+    ioqueue->sq_deferred = PJ_FALSE;
+    do {
+	rc = sys_uring_enter(ioqueue->ring_fd, ioqueue->sq_entries, 0, 0,
+			     NULL, 0);
+    } while (rc < 0 && errno == EINTR);
+}
+
+/*
+ * Get a free SQE. On success, sq_mutex is held until commit_sqe().
+ */
+static struct io_uring_sqe *get_sqe(pj_ioqueue_t *ioqueue)
+{
+    struct io_uring_sqe *sqe;
+    unsigned retry;
+
+    pj_mutex_lock(ioqueue->sq_mutex);
+
+    for (retry=0; ioqueue->sq_tail - __atomic_load_n(ioqueue->sq_khead,
+						    __ATOMIC_ACQUIRE) >=
+		  ioqueue->sq_entries; ++retry)
+    {
+	/* Submission queue is full, submit the pending ones. */
+	if (retry == 4) {
+	    pj_mutex_unlock(ioqueue->sq_mutex);
+	    PJ_LOG(2,(THIS_FILE, "io_uring submission queue is full"));
+	    return NULL;
+	}
+	if (retry)
+	    pj_thread_sleep(0);
+	flush_sqes(ioqueue);
+    }
+
+    sqe = &ioqueue->sqes[ioqueue->sq_tail & ioqueue->sq_mask];
+    pj_bzero(sqe, sizeof(*sqe));
+    return sqe;
+}
+
+/*
+ * Queue the SQE returned by get_sqe() and release sq_mutex. The SQE is
+ * submitted immediately unless the calling thread is dispatching events
+ * of this ioqueue, in which case it will be submitted together with the
+ * others by pj_ioqueue_poll(). Set flush to always submit immediately.
+ */
+static void commit_sqe(pj_ioqueue_t *ioqueue, pj_bool_t flush)
+{
+    ++ioqueue->sq_tail;
+    __atomic_store_n(ioqueue->sq_ktail, ioqueue->sq_tail, __ATOMIC_RELEASE);
+
+    if (!flush && pj_thread_local_get(ioqueue->tls_id) == ioqueue) {
+	ioqueue->sq_deferred = PJ_TRUE;
+	pj_mutex_unlock(ioqueue->sq_mutex);
+    } else {
+	pj_mutex_unlock(ioqueue->sq_mutex);
+	flush_sqes(ioqueue);
+    }
+}
+
+/* Submit a request to cancel the operation with the specified tag. */
+static void submit_cancel(pj_ioqueue_key_t *key, int tag)
+{
+    struct io_uring_sqe *sqe;
+
+    sqe = get_sqe(key->ioqueue);
+    if (!sqe)
+	return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = USER_DATA(key, tag);
+    sqe->user_data = 0;
+    commit_sqe(key->ioqueue, PJ_TRUE);
+}
+
+/* Increment key's reference counter */
+static void increment_counter(pj_ioqueue_key_t *key)
+{
+    pj_mutex_lock(key->ioqueue->ref_cnt_mutex);
+    ++key->ref_count;
+    pj_mutex_unlock(key->ioqueue->ref_cnt_mutex);
+}
+
+/* Decrement the key's reference counter, and when the counter reach zero,
+ * destroy the key.
+ *
+ * Note: MUST NOT CALL THIS FUNCTION WHILE HOLDING ioqueue's LOCK.
+ */
+static void decrement_counter(pj_ioqueue_key_t *key)
+{
+    pj_lock_acquire(key->ioqueue->lock);
+    pj_mutex_lock(key->ioqueue->ref_cnt_mutex);
+    --key->ref_count;
+    if (key->ref_count == 0) {
+
+	pj_assert(key->closing == 1);
+	pj_gettickcount(&key->free_time);
+	key->free_time.msec += PJ_IOQUEUE_KEY_FREE_DELAY;
+	pj_time_val_normalize(&key->free_time);
+
+	pj_list_erase(key);
+	pj_list_push_back(&key->ioqueue->closing_list, key);
+
+    }
+    pj_mutex_unlock(key->ioqueue->ref_cnt_mutex);
+    pj_lock_release(key->ioqueue->lock);
+}
+
+
+/*
+ * Provided receive buffers.
+ */
+
+/* Give a buffer back to the kernel, and wake up a key which multishot
+ * receive was stopped because the kernel had run out of buffers.
+ * rx_mutex must be held.
+ */
+static void recycle_buf(pj_ioqueue_t *ioqueue, unsigned bid)
+{
+#if HAS_MULTISHOT_RECV
+    struct io_uring_buf *buf;
+    pj_ioqueue_key_t *key;
+
+    buf = &ioqueue->br->bufs[ioqueue->br_tail &
+			     (PJ_IOQUEUE_URING_BUF_CNT-1)];
+    buf->addr = (pj_uint64_t)(pj_size_t)
+		(ioqueue->bufs + bid * ioqueue->buf_size);
+    buf->len = ioqueue->buf_size;
+    buf->bid = (pj_uint16_t)bid;
+    ++ioqueue->br_tail;
+    __atomic_store_n(&ioqueue->br->tail, (pj_uint16_t)ioqueue->br_tail,
+		     __ATOMIC_RELEASE);
+
+    key = ioqueue->starved;
+    if (key) {
+	struct io_uring_sqe *sqe;
+
+	sqe = get_sqe(ioqueue);
+	if (!sqe)
+	    return;
+
+	ioqueue->starved = key->rx_starved_next;
+	key->rx_starved = PJ_FALSE;
+
+	/* The reference taken when the key was starved is passed to
+	 * the NOP.
+	 */
+	sqe->opcode = IORING_OP_NOP;
+	sqe->user_data = USER_DATA(key, TAG_KICK);
+	commit_sqe(ioqueue, PJ_FALSE);
+    }
+#else
+    PJ_UNUSED_ARG(ioqueue);
+    PJ_UNUSED_ARG(bid);
+#endif
+}
+
+/* Copy the first packet in the key's backlog to the application buffer,
+ * and recycle the packet's buffer. rx_mutex must be held. Returns the
+ * size of the packet, or negative error code if the packet had to be
+ * truncated by the provided buffer while the application buffer could
+ * have held more of it (a datagram larger than the application buffer is
+ * truncated, as with the other backends).
+ */
+static pj_ssize_t pop_rx_buf(pj_ioqueue_key_t *key, void *buf,
+			     pj_size_t size, pj_sockaddr_t *addr,
+			     int *addrlen)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+    struct rx_buf *info;
+    const char *p;
+    int bid;
+
+    pj_assert(key->rx_cnt);
+
+    bid = key->rx_head;
+    info = &ioqueue->buf_info[bid];
+    key->rx_head = info->next;
+    if (--key->rx_cnt == 0)
+	key->rx_tail = -1;
+
+    if (info->full_len > info->len && size > info->len) {
+	PJ_LOG(4,(THIS_FILE, "Datagram of %u bytes doesn't fit in the %u "
+		  "bytes receive buffer, dropped", info->full_len,
+		  info->len));
+	recycle_buf(ioqueue, bid);
+	return -PJ_RETURN_OS_ERROR(EMSGSIZE);
+    }
+
+    p = ioqueue->bufs + bid * ioqueue->buf_size;
+    if (size > info->len)
+	size = info->len;
+    pj_memcpy(buf, p + info->off, size);
+
+#if HAS_MULTISHOT_RECV
+    if (addr && addrlen) {
+	int len = info->addrlen < *addrlen ? info->addrlen : *addrlen;
+
+	pj_memcpy(addr, p + sizeof(struct io_uring_recvmsg_out), len);
+	*addrlen = info->addrlen;
+    }
+#else
+    PJ_UNUSED_ARG(addr);
+    PJ_UNUSED_ARG(addrlen);
+#endif
+
+    recycle_buf(ioqueue, bid);
+    return (pj_ssize_t)size;
+}
+
+/* Drop the key's backlog. rx_mutex must be held. */
+static void flush_rx_bufs(pj_ioqueue_key_t *key)
+{
+    while (key->rx_cnt) {
+	int bid = key->rx_head;
+
+	key->rx_head = key->ioqueue->buf_info[bid].next;
+	--key->rx_cnt;
+	recycle_buf(key->ioqueue, bid);
+    }
+    key->rx_tail = -1;
+    key->rx_status = PJ_SUCCESS;
+}
+
+#if HAS_MULTISHOT_RECV
+/* Size of the packet that fits in a provided buffer. */
+#define RX_BUF_PAYLOAD(ioq)  ((ioq)->buf_size - \
+			      sizeof(struct io_uring_recvmsg_out) - \
+			      sizeof(pj_sockaddr))
+
+/* No datagram is larger than this. */
+#define RX_DGRAM_MAX	65535
+
+/* Allocate the provided buffers, large enough for reads of read_size
+ * bytes, and give them to the kernel. rx_mutex must be held.
+ */
+static pj_status_t alloc_rx_bufs(pj_ioqueue_t *ioqueue, pj_size_t read_size)
+{
+    pj_size_t size;
+    void *bufs;
+    unsigned i;
+
+    if (read_size > RX_DGRAM_MAX)
+	read_size = RX_DGRAM_MAX;
+    size = read_size + sizeof(struct io_uring_recvmsg_out) +
+	   sizeof(pj_sockaddr);
+    if (size < PJ_IOQUEUE_URING_BUF_SIZE)
+	size = PJ_IOQUEUE_URING_BUF_SIZE;
+    /* Keep the header at the start of each buffer aligned. */
+    size = (size + 63) & ~((pj_size_t)63);
+
+    bufs = mmap(NULL, size * PJ_IOQUEUE_URING_BUF_CNT,
+		PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (bufs == MAP_FAILED)
+	return PJ_RETURN_OS_ERROR(errno);
+
+    ioqueue->bufs = (char*)bufs;
+    ioqueue->bufs_sz = size * PJ_IOQUEUE_URING_BUF_CNT;
+    ioqueue->buf_size = (unsigned)size;
+    for (i=0; i<PJ_IOQUEUE_URING_BUF_CNT; ++i)
+	recycle_buf(ioqueue, i);
+
+    TRACE_((THIS_FILE, "Provided buffers of %u bytes allocated",
+	    ioqueue->buf_size));
+    return PJ_SUCCESS;
+}
+
+/* Check if the key should use multishot receive. The provided buffers
+ * are sized by the reads of the first key using them; reads larger than
+ * that are received directly into the application's buffer, so that the
+ * datagrams are not truncated. rx_mutex must be held.
+ */
+static pj_bool_t use_multishot(pj_ioqueue_key_t *key)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+
+    if (!ioqueue->multishot || key->fd_type != pj_SOCK_DGRAM())
+	return PJ_FALSE;
+
+    if (ioqueue->buf_size == 0) {
+	pj_status_t status = alloc_rx_bufs(ioqueue, key->rx_max);
+	if (status != PJ_SUCCESS) {
+	    PJ_PERROR(4,(THIS_FILE, status, "Unable to allocate receive "
+			 "buffers, multishot receive is disabled"));
+	    ioqueue->multishot = PJ_FALSE;
+	    return PJ_FALSE;
+	}
+    }
+
+    return key->rx_max <= RX_BUF_PAYLOAD(ioqueue) ||
+	   RX_BUF_PAYLOAD(ioqueue) >= RX_DGRAM_MAX;
+}
+
+/*
+ * Process a completion of multishot receive. This is called when the
+ * completion is harvested, with ioqueue's lock held, so packets are
+ * put in the backlog in the order they were received.
+ */
+static void on_multishot_cqe(pj_ioqueue_key_t *key,
+			     const struct io_uring_cqe *cqe)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+
+    pj_mutex_lock(ioqueue->rx_mutex);
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+	unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+	const struct io_uring_recvmsg_out *out;
+	struct rx_buf *info = &ioqueue->buf_info[bid];
+	unsigned off;
+
+	out = (const struct io_uring_recvmsg_out*)
+	      (ioqueue->bufs + bid * ioqueue->buf_size);
+	off = sizeof(*out) + key->rx_msg.msg_namelen +
+	      key->rx_msg.msg_controllen;
+
+	if (key->closing || cqe->res < (int)off) {
+	    recycle_buf(ioqueue, bid);
+	} else {
+	    info->next = -1;
+	    info->off = off;
+	    info->len = cqe->res - off;
+	    if (info->len > out->payloadlen)
+		info->len = out->payloadlen;
+	    /* payloadlen is the size of the datagram even if it has been
+	     * truncated (MSG_TRUNC).
+	     */
+	    info->full_len = out->payloadlen;
+	    info->addrlen = out->namelen < key->rx_msg.msg_namelen ?
+			    out->namelen : key->rx_msg.msg_namelen;
+
+	    if (key->rx_cnt)
+		ioqueue->buf_info[key->rx_tail].next = bid;
+	    else
+		key->rx_head = bid;
+	    key->rx_tail = bid;
+	    ++key->rx_cnt;
+	}
+    }
+
+    if ((cqe->flags & IORING_CQE_F_MORE) == 0) {
+	/* Multishot receive has been terminated. */
+	key->rx_armed = PJ_FALSE;
+	key->rx_cancel = PJ_FALSE;
+
+	if (!key->closing && cqe->res < 0) {
+	    if (cqe->res == -ENOBUFS) {
+		/* Out of buffers. Receive will be resumed when a buffer is
+		 * recycled.
+		 */
+		if (!key->rx_starved) {
+		    key->rx_starved = PJ_TRUE;
+		    key->rx_starved_next = ioqueue->starved;
+		    ioqueue->starved = key;
+		    increment_counter(key);
+		}
+	    } else if (cqe->res == -EINVAL && ioqueue->multishot) {
+		/* Multishot recvmsg is not supported by the kernel. */
+		PJ_LOG(4,(THIS_FILE, "Multishot receive is not supported, "
+				     "using single-shot receive"));
+		ioqueue->multishot = PJ_FALSE;
+	    } else if (cqe->res != -ECANCELED) {
+		/* Cancelled requests (e.g. when the thread which submitted
+		 * the request exits) are simply resubmitted, other errors
+		 * are reported to the application.
+		 */
+		key->rx_status = PJ_RETURN_OS_ERROR(-cqe->res);
+	    }
+	}
+    } else if (key->rx_cnt >= RX_BACKLOG_MAX && !key->rx_cancel &&
+	       !key->closing)
+    {
+	/* The application is not reading fast enough. Stop receiving
+	 * and let the socket buffer keep the rest of the packets.
+	 */
+	key->rx_cancel = PJ_TRUE;
+	submit_cancel(key, TAG_RECV_MULTI);
+    }
+
+    pj_mutex_unlock(ioqueue->rx_mutex);
+}
+#endif	/* HAS_MULTISHOT_RECV */
+
+/*
+ * Submit receive operation for the key, unless one is already in flight.
+ * Key's lock must be held.
+ */
+static pj_status_t arm_rx(pj_ioqueue_key_t *key)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+    struct io_uring_sqe *sqe;
+    pj_bool_t multishot;
+
+    pj_mutex_lock(ioqueue->rx_mutex);
+
+    if (key->rx_armed || key->rx_starved) {
+	pj_mutex_unlock(ioqueue->rx_mutex);
+	return PJ_SUCCESS;
+    }
+
+    /* The kernel completes a receive in the context of the thread which
+     * submitted it, so leave the submission to a polling thread rather
+     * than, say, the application's main thread.
+     */
+    if (pj_thread_local_get(ioqueue->tls_id) != ioqueue) {
+	pj_mutex_unlock(ioqueue->rx_mutex);
+	return kick_key(key);
+    }
+
+#if HAS_MULTISHOT_RECV
+    multishot = use_multishot(key);
+#else
+    multishot = PJ_FALSE;
+#endif
+
+    sqe = get_sqe(ioqueue);
+    if (!sqe) {
+	pj_mutex_unlock(ioqueue->rx_mutex);
+	return PJ_ETOOMANY;
+    }
+
+    sqe->fd = key->fd;
+
+#if HAS_MULTISHOT_RECV
+    if (multishot) {
+	key->rx_msg.msg_name = NULL;
+	key->rx_msg.msg_namelen = sizeof(pj_sockaddr);
+	key->rx_msg.msg_iov = NULL;
+	key->rx_msg.msg_iovlen = 0;
+	key->rx_msg.msg_control = NULL;
+	key->rx_msg.msg_controllen = 0;
+
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->addr = (pj_uint64_t)(pj_size_t)&key->rx_msg;
+	sqe->len = 1;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = RX_BGID;
+	key->rx_tag = TAG_RECV_MULTI;
+    } else
+#endif
+    {
+	struct read_operation *read_op = key->read_list.next;
+
+	pj_assert(read_op != &key->read_list);
+
+	if (key->fd_type == pj_SOCK_DGRAM()) {
+	    key->rx_iov.iov_base = read_op->buf;
+	    key->rx_iov.iov_len = read_op->size;
+	    key->rx_msg.msg_name = &key->rx_addr;
+	    key->rx_msg.msg_namelen = sizeof(key->rx_addr);
+	    key->rx_msg.msg_iov = &key->rx_iov;
+	    key->rx_msg.msg_iovlen = 1;
+	    key->rx_msg.msg_control = NULL;
+	    key->rx_msg.msg_controllen = 0;
+	    key->rx_msg.msg_flags = 0;
+
+	    sqe->opcode = IORING_OP_RECVMSG;
+	    sqe->addr = (pj_uint64_t)(pj_size_t)&key->rx_msg;
+	    sqe->len = 1;
+	} else {
+	    sqe->opcode = IORING_OP_RECV;
+	    sqe->addr = (pj_uint64_t)(pj_size_t)read_op->buf;
+	    sqe->len = (pj_uint32_t)read_op->size;
+	}
+	sqe->msg_flags = read_op->flags;
+	key->rx_op = read_op;
+	key->rx_tag = TAG_RECV;
+    }
+
+    sqe->user_data = USER_DATA(key, key->rx_tag);
+    key->rx_armed = PJ_TRUE;
+    increment_counter(key);
+    commit_sqe(ioqueue, PJ_FALSE);
+
+    pj_mutex_unlock(ioqueue->rx_mutex);
+    return PJ_SUCCESS;
+}
+
+/* Submit a NOP so that the key's backlog is delivered by the poll. */
+static pj_status_t kick_key(pj_ioqueue_key_t *key)
+{
+    struct io_uring_sqe *sqe;
+
+    sqe = get_sqe(key->ioqueue);
+    if (!sqe)
+	return PJ_ETOOMANY;
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = USER_DATA(key, TAG_KICK);
+    increment_counter(key);
+    commit_sqe(key->ioqueue, PJ_FALSE);
+    return PJ_SUCCESS;
+}
+
+/* Submit the first pending write operation. Key's lock must be held. */
+static pj_status_t submit_tx(pj_ioqueue_key_t *key)
+{
+    struct write_operation *write_op = key->write_list.next;
+    struct io_uring_sqe *sqe;
+
+    pj_assert(write_op != &key->write_list && !key->tx_busy);
+
+    sqe = get_sqe(key->ioqueue);
+    if (!sqe)
+	return PJ_ETOOMANY;
+
+    sqe->fd = key->fd;
+    if (write_op->op == PJ_IOQUEUE_OP_SEND_TO) {
+	key->tx_iov.iov_base = write_op->buf + write_op->written;
+	key->tx_iov.iov_len = write_op->size - write_op->written;
+	key->tx_msg.msg_name = &write_op->rmt_addr;
+	key->tx_msg.msg_namelen = write_op->rmt_addrlen;
+	key->tx_msg.msg_iov = &key->tx_iov;
+	key->tx_msg.msg_iovlen = 1;
+	key->tx_msg.msg_control = NULL;
+	key->tx_msg.msg_controllen = 0;
+	key->tx_msg.msg_flags = 0;
+
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->addr = (pj_uint64_t)(pj_size_t)&key->tx_msg;
+	sqe->len = 1;
+    } else {
+	sqe->opcode = IORING_OP_SEND;
+	sqe->addr = (pj_uint64_t)(pj_size_t)(write_op->buf+write_op->written);
+	sqe->len = (pj_uint32_t)(write_op->size - write_op->written);
+    }
+    sqe->msg_flags = write_op->flags;
+    sqe->user_data = USER_DATA(key, TAG_SEND);
+
+    key->tx_op = write_op;
+    key->tx_busy = PJ_TRUE;
+    increment_counter(key);
+    commit_sqe(key->ioqueue, PJ_FALSE);
+
+    return PJ_SUCCESS;
+}
+
+#if PJ_HAS_TCP
+/* Submit accept for the first pending accept operation. Key's lock must
+ * be held.
+ */
+static pj_status_t submit_accept(pj_ioqueue_key_t *key)
+{
+    struct io_uring_sqe *sqe;
+
+    pj_assert(!pj_list_empty(&key->accept_list) && !key->acc_busy);
+
+    sqe = get_sqe(key->ioqueue);
+    if (!sqe)
+	return PJ_ETOOMANY;
+
+    key->acc_addrlen = sizeof(key->acc_addr);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = key->fd;
+    sqe->addr = (pj_uint64_t)(pj_size_t)&key->acc_addr;
+    sqe->off = (pj_uint64_t)(pj_size_t)&key->acc_addrlen;
+    sqe->user_data = USER_DATA(key, TAG_ACCEPT);
+
+    key->acc_op = key->accept_list.next;
+    key->acc_busy = PJ_TRUE;
+    increment_counter(key);
+    commit_sqe(key->ioqueue, PJ_FALSE);
+
+    return PJ_SUCCESS;
+}
+#endif
+
+
+/*
+ * pj_ioqueue_name()
+ */
+PJ_DEF(const char*) pj_ioqueue_name(void)
+{
+    return "io_uring";
+}
+
+/*
+ * pj_ioqueue_get_features()
+ *
+ * Receives are submitted to the kernel before the application asks for
+ * the data, so reading the socket directly would reorder the packets.
+ */
+PJ_DEF(unsigned) pj_ioqueue_get_features(void)
+{
+    return 0;
+}
+
+/* Map the rings of a newly created io_uring instance. */
+static pj_status_t map_rings(pj_ioqueue_t *ioqueue,
+			     const struct io_uring_params *p)
+{
+    unsigned *sq_array;
+    unsigned i;
+
+    ioqueue->sq_ring_sz = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    ioqueue->cq_ring_sz = p->cq_off.cqes +
+			  p->cq_entries * sizeof(struct io_uring_cqe);
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+	if (ioqueue->cq_ring_sz > ioqueue->sq_ring_sz)
+	    ioqueue->sq_ring_sz = ioqueue->cq_ring_sz;
+	ioqueue->cq_ring_sz = ioqueue->sq_ring_sz;
+    }
+
+    ioqueue->sq_ring = mmap(NULL, ioqueue->sq_ring_sz,
+			    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			    ioqueue->ring_fd, IORING_OFF_SQ_RING);
+    if (ioqueue->sq_ring == MAP_FAILED) {
+	ioqueue->sq_ring = NULL;
+	return PJ_RETURN_OS_ERROR(errno);
+    }
+
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+	ioqueue->cq_ring = ioqueue->sq_ring;
+    } else {
+	ioqueue->cq_ring = mmap(NULL, ioqueue->cq_ring_sz,
+				PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE,
+				ioqueue->ring_fd, IORING_OFF_CQ_RING);
+	if (ioqueue->cq_ring == MAP_FAILED) {
+	    ioqueue->cq_ring = NULL;
+	    return PJ_RETURN_OS_ERROR(errno);
+	}
+    }
+
+    ioqueue->sqes_sz = p->sq_entries * sizeof(struct io_uring_sqe);
+    ioqueue->sqes = (struct io_uring_sqe*)
+		    mmap(NULL, ioqueue->sqes_sz, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, ioqueue->ring_fd,
+			 IORING_OFF_SQES);
+    if (ioqueue->sqes == MAP_FAILED) {
+	ioqueue->sqes = NULL;
+	return PJ_RETURN_OS_ERROR(errno);
+    }
+
+    ioqueue->sq_khead = (unsigned*)((char*)ioqueue->sq_ring+p->sq_off.head);
+    ioqueue->sq_ktail = (unsigned*)((char*)ioqueue->sq_ring+p->sq_off.tail);
+    ioqueue->sq_mask = *(unsigned*)((char*)ioqueue->sq_ring +
+				    p->sq_off.ring_mask);
+    ioqueue->sq_entries = p->sq_entries;
+    ioqueue->sq_tail = *ioqueue->sq_ktail;
+
+    /* SQEs are always used in order, so the index array is fixed. */
+    sq_array = (unsigned*)((char*)ioqueue->sq_ring + p->sq_off.array);
+    for (i=0; i<p->sq_entries; ++i)
+	sq_array[i] = i;
+
+    ioqueue->cq_khead = (unsigned*)((char*)ioqueue->cq_ring+p->cq_off.head);
+    ioqueue->cq_ktail = (unsigned*)((char*)ioqueue->cq_ring+p->cq_off.tail);
+    ioqueue->cq_mask = *(unsigned*)((char*)ioqueue->cq_ring +
+				    p->cq_off.ring_mask);
+    ioqueue->cqes = (struct io_uring_cqe*)((char*)ioqueue->cq_ring +
+					   p->cq_off.cqes);
+
+    return PJ_SUCCESS;
+}
+
+/* Register the provided buffer ring for multishot receive. The buffers
+ * are allocated when the first multishot receive is armed, once the size
+ * of the reads is known (see alloc_rx_bufs()).
+ */
+static pj_status_t setup_rx_bufs(pj_pool_t *pool, pj_ioqueue_t *ioqueue)
+{
+    ioqueue->buf_info = (struct rx_buf*)
+			pj_pool_calloc(pool, PJ_IOQUEUE_URING_BUF_CNT,
+				       sizeof(struct rx_buf));
+    if (!ioqueue->buf_info)
+	return PJ_ENOMEM;
+
+#if HAS_MULTISHOT_RECV
+    {
+	struct io_uring_buf_reg reg;
+
+	ioqueue->br_sz = PJ_IOQUEUE_URING_BUF_CNT *
+			 sizeof(struct io_uring_buf);
+	ioqueue->br = (struct io_uring_buf_ring*)
+		      mmap(NULL, ioqueue->br_sz, PROT_READ | PROT_WRITE,
+			   MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (ioqueue->br == MAP_FAILED) {
+	    ioqueue->br = NULL;
+	    return PJ_RETURN_OS_ERROR(errno);
+	}
+
+	pj_bzero(&reg, sizeof(reg));
+	reg.ring_addr = (pj_uint64_t)(pj_size_t)ioqueue->br;
+	reg.ring_entries = PJ_IOQUEUE_URING_BUF_CNT;
+	reg.bgid = RX_BGID;
+	if (sys_uring_register(ioqueue->ring_fd, IORING_REGISTER_PBUF_RING,
+			       &reg, 1) < 0)
+	{
+	    pj_status_t status = PJ_RETURN_OS_ERROR(errno);
+	    munmap(ioqueue->br, ioqueue->br_sz);
+	    ioqueue->br = NULL;
+	    return status;
+	}
+
+	ioqueue->br_tail = 0;
+	ioqueue->multishot = PJ_TRUE;
+    }
+#endif
+
+    return PJ_SUCCESS;
+}
+
+static void destroy_ring(pj_ioqueue_t *ioqueue)
+{
+    if (ioqueue->ring_fd >= 0) {
+	close(ioqueue->ring_fd);
+	ioqueue->ring_fd = -1;
+    }
+#if HAS_MULTISHOT_RECV
+    if (ioqueue->br) {
+	munmap(ioqueue->br, ioqueue->br_sz);
+	ioqueue->br = NULL;
+    }
+#endif
+    if (ioqueue->bufs) {
+	munmap(ioqueue->bufs, ioqueue->bufs_sz);
+	ioqueue->bufs = NULL;
+    }
+    if (ioqueue->sqes) {
+	munmap(ioqueue->sqes, ioqueue->sqes_sz);
+	ioqueue->sqes = NULL;
+    }
+    if (ioqueue->cq_ring && ioqueue->cq_ring != ioqueue->sq_ring)
+	munmap(ioqueue->cq_ring, ioqueue->cq_ring_sz);
+    ioqueue->cq_ring = NULL;
+    if (ioqueue->sq_ring) {
+	munmap(ioqueue->sq_ring, ioqueue->sq_ring_sz);
+	ioqueue->sq_ring = NULL;
+    }
+}
+
+static void destroy_ioqueue(pj_ioqueue_t *ioqueue)
+{
+    pj_ioqueue_key_t *key;
+
+    destroy_ring(ioqueue);
+
+    key = ioqueue->active_list.next;
+    while (key != &ioqueue->active_list) {
+	pj_lock_destroy(key->lock);
+	key = key->next;
+    }
+
+    key = ioqueue->closing_list.next;
+    while (key != &ioqueue->closing_list) {
+	pj_lock_destroy(key->lock);
+	key = key->next;
+    }
+
+    key = ioqueue->free_list.next;
+    while (key != &ioqueue->free_list) {
+	pj_lock_destroy(key->lock);
+	key = key->next;
+    }
+
+    if (ioqueue->ref_cnt_mutex)
+	pj_mutex_destroy(ioqueue->ref_cnt_mutex);
+    if (ioqueue->sq_mutex)
+	pj_mutex_destroy(ioqueue->sq_mutex);
+    if (ioqueue->rx_mutex)
+	pj_mutex_destroy(ioqueue->rx_mutex);
+    if (ioqueue->tls_id != -1)
+	pj_thread_local_free(ioqueue->tls_id);
+}
+
+/*
+ * pj_ioqueue_create()
+ *
+ * Create io_uring ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
+                                       pj_size_t max_fd,
+                                       pj_ioqueue_t **p_ioqueue)
+{
+    pj_ioqueue_t *ioqueue;
+    struct io_uring_params params;
+    pj_lock_t *lock;
+    pj_status_t rc;
+    unsigned i;
+
+    /* Check that arguments are valid. */
+    PJ_ASSERT_RETURN(pool != NULL && p_ioqueue != NULL &&
+                     max_fd > 0, PJ_EINVAL);
+
+    /* Check that size of pj_ioqueue_op_key_t is sufficient */
+    PJ_ASSERT_RETURN(sizeof(pj_ioqueue_op_key_t)-sizeof(void*) >=
+                     sizeof(union operation_key), PJ_EBUG);
+
+    ioqueue = PJ_POOL_ZALLOC_T(pool, pj_ioqueue_t);
+    ioqueue_init(ioqueue);
+    ioqueue->max = (unsigned)max_fd;
+    ioqueue->ring_fd = -1;
+    ioqueue->tls_id = -1;
+    pj_list_init(&ioqueue->active_list);
+    pj_list_init(&ioqueue->free_list);
+    pj_list_init(&ioqueue->closing_list);
+
+    /* Mutex to protect key's reference counter
+     * We don't want to use key's mutex or ioqueue's mutex because
+     * that would create deadlock situation in some cases.
+     */
+    rc = pj_mutex_create_simple(pool, NULL, &ioqueue->ref_cnt_mutex);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = pj_mutex_create_simple(pool, NULL, &ioqueue->sq_mutex);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = pj_mutex_create_simple(pool, NULL, &ioqueue->rx_mutex);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = pj_thread_local_alloc(&ioqueue->tls_id);
+    if (rc != PJ_SUCCESS) {
+	ioqueue->tls_id = -1;
+	goto on_error;
+    }
+
+    /* Pre-create all keys according to max_fd */
+    for (i=0; i<max_fd; ++i) {
+	pj_ioqueue_key_t *key;
+
+	key = PJ_POOL_ZALLOC_T(pool, pj_ioqueue_key_t);
+	rc = pj_lock_create_recursive_mutex(pool, NULL, &key->lock);
+	if (rc != PJ_SUCCESS)
+	    goto on_error;
+
+	pj_list_push_back(&ioqueue->free_list, key);
+    }
+
+    rc = pj_lock_create_simple_mutex(pool, "ioq%p", &lock);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = pj_ioqueue_set_lock(ioqueue, lock, PJ_TRUE);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    /* Create the ring. The completion queue must be able to hold the
+     * completions of all submissions plus a completion for each of the
+     * provided buffers.
+     */
+    pj_bzero(&params, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    params.cq_entries = 2 * (PJ_IOQUEUE_URING_SQ_SIZE +
+			     PJ_IOQUEUE_URING_BUF_CNT);
+    ioqueue->ring_fd = sys_uring_setup(PJ_IOQUEUE_URING_SQ_SIZE, &params);
+    if (ioqueue->ring_fd < 0) {
+	rc = PJ_RETURN_OS_ERROR(errno);
+	ioqueue->ring_fd = -1;
+	goto on_error;
+    }
+
+    /* The timeout argument of io_uring_enter() is needed for polling. */
+    if ((params.features & IORING_FEAT_EXT_ARG) == 0) {
+	PJ_LOG(2,(THIS_FILE, "io_uring in this kernel is too old"));
+	rc = PJ_ENOTSUP;
+	goto on_error;
+    }
+
+    rc = map_rings(ioqueue, &params);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = setup_rx_bufs(pool, ioqueue);
+    if (rc == PJ_ENOMEM) {
+	goto on_error;
+    } else if (rc != PJ_SUCCESS) {
+	PJ_PERROR(4,(THIS_FILE, rc, "Unable to register receive buffers, "
+				    "multishot receive is disabled"));
+    }
+
+    PJ_LOG(4, ("pjlib", "io_uring I/O Queue created (%p), multishot "
+			"receive %s", ioqueue,
+	       (ioqueue->multishot ? "enabled" : "disabled")));
+
+    *p_ioqueue = ioqueue;
+    return PJ_SUCCESS;
+
+on_error:
+    destroy_ioqueue(ioqueue);
+    if (ioqueue->auto_delete_lock && ioqueue->lock)
+	pj_lock_destroy(ioqueue->lock);
+    return rc;
+}
+
+/*
+ * pj_ioqueue_destroy()
+ *
+ * Destroy ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_destroy(pj_ioqueue_t *ioqueue)
+{
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+    PJ_ASSERT_RETURN(ioqueue->ring_fd >= 0, PJ_EINVALIDOP);
+
+    pj_lock_acquire(ioqueue->lock);
+    destroy_ioqueue(ioqueue);
+
+    return ioqueue_destroy(ioqueue);
+}
+
+/*
+ * pj_ioqueue_register_sock()
+ *
+ * Register a socket to ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_register_sock2(pj_pool_t *pool,
+					      pj_ioqueue_t *ioqueue,
+					      pj_sock_t sock,
+					      pj_grp_lock_t *grp_lock,
+					      void *user_data,
+					      const pj_ioqueue_callback *cb,
+                                              pj_ioqueue_key_t **p_key)
+{
+    pj_ioqueue_key_t *key = NULL;
+    int value;
+    pj_status_t rc = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(pool && ioqueue && sock != PJ_INVALID_SOCKET &&
+                     cb && p_key, PJ_EINVAL);
+
+    pj_lock_acquire(ioqueue->lock);
+
+    if (ioqueue->count >= ioqueue->max) {
+        rc = PJ_ETOOMANY;
+	TRACE_((THIS_FILE, "pj_ioqueue_register_sock error: too many files"));
+	goto on_return;
+    }
+
+    /* Set socket to nonblocking, for the immediate operations. */
+    value = 1;
+    if (ioctl(sock, FIONBIO, &value)) {
+        rc = pj_get_netos_error();
+	goto on_return;
+    }
+
+    /* Scan closing_keys first to let them come back to free_list */
+    scan_closing_keys(ioqueue);
+
+    pj_assert(!pj_list_empty(&ioqueue->free_list));
+    if (pj_list_empty(&ioqueue->free_list)) {
+	rc = PJ_ETOOMANY;
+	goto on_return;
+    }
+
+    key = ioqueue->free_list.next;
+    pj_list_erase(key);
+
+    rc = ioqueue_init_key(pool, ioqueue, key, sock, grp_lock, user_data, cb);
+    if (rc != PJ_SUCCESS) {
+	pj_list_push_back(&ioqueue->free_list, key);
+	key->ref_count = 0;
+	key = NULL;
+	goto on_return;
+    }
+
+    key->rx_armed = PJ_FALSE;
+    key->rx_tag = TAG_NONE;
+    key->rx_cancel = PJ_FALSE;
+    key->rx_starved = PJ_FALSE;
+    key->rx_starved_next = NULL;
+    key->rx_head = key->rx_tail = -1;
+    key->rx_cnt = 0;
+    key->rx_max = 0;
+    key->rx_status = PJ_SUCCESS;
+    key->rx_op = NULL;
+    key->tx_busy = PJ_FALSE;
+    key->tx_op = NULL;
+#if PJ_HAS_TCP
+    key->acc_busy = PJ_FALSE;
+    key->acc_op = NULL;
+#endif
+
+    /* Register */
+    pj_list_insert_before(&ioqueue->active_list, key);
+    ++ioqueue->count;
+
+on_return:
+    *p_key = key;
+    pj_lock_release(ioqueue->lock);
+
+    return rc;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_register_sock( pj_pool_t *pool,
+					      pj_ioqueue_t *ioqueue,
+					      pj_sock_t sock,
+					      void *user_data,
+					      const pj_ioqueue_callback *cb,
+					      pj_ioqueue_key_t **p_key)
+{
+    return pj_ioqueue_register_sock2(pool, ioqueue, sock, NULL, user_data,
+                                     cb, p_key);
+}
+
+/*
+ * pj_ioqueue_unregister()
+ *
+ * Unregister handle from ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_unregister( pj_ioqueue_key_t *key)
+{
+    pj_ioqueue_t *ioqueue;
+
+    PJ_ASSERT_RETURN(key != NULL, PJ_EINVAL);
+
+    ioqueue = key->ioqueue;
+
+    /* Lock the key to make sure no callback is simultaneously modifying
+     * the key. We need to lock the key before ioqueue here to prevent
+     * deadlock.
+     */
+    pj_ioqueue_lock_key(key);
+
+    /* Also lock ioqueue */
+    pj_lock_acquire(ioqueue->lock);
+
+    pj_assert(ioqueue->count > 0);
+    --ioqueue->count;
+
+    /* Mark key is closing, and release the received packets. */
+    pj_mutex_lock(ioqueue->rx_mutex);
+    key->closing = 1;
+    flush_rx_bufs(key);
+    if (key->rx_armed)
+	submit_cancel(key, key->rx_tag);
+    key->rx_op = NULL;
+    pj_mutex_unlock(ioqueue->rx_mutex);
+
+    /* Cancel the operations in flight. The cancel requests are submitted
+     * immediately, so the kernel is done with the application's buffers
+     * once this function returns.
+     */
+    if (key->tx_busy)
+	submit_cancel(key, TAG_SEND);
+#if PJ_HAS_TCP
+    if (key->acc_busy)
+	submit_cancel(key, TAG_ACCEPT);
+    if (key->connecting)
+	submit_cancel(key, TAG_CONNECT);
+#endif
+
+    /* Destroy the key. */
+    pj_sock_close(key->fd);
+
+    pj_lock_release(ioqueue->lock);
+
+    /* Decrement counter. The key will be put in the free list once the
+     * completions of all operations in flight have been reaped.
+     */
+    decrement_counter(key);
+
+    /* Done. */
+    if (key->grp_lock) {
+	/* just dec_ref and unlock. we will set grp_lock to NULL
+	 * elsewhere */
+	pj_grp_lock_t *grp_lock = key->grp_lock;
+	// Don't set grp_lock to NULL otherwise the other thread
+	// will crash. Just leave it as dangling pointer, but this
+	// should be safe
+	//key->grp_lock = NULL;
+	pj_grp_lock_dec_ref_dbg(grp_lock, "ioqueue", 0);
+	pj_grp_lock_release(grp_lock);
+    } else {
+	pj_ioqueue_unlock_key(key);
+    }
+
+    return PJ_SUCCESS;
+}
+
+/* Scan closing keys to be put to free list again */
+static void scan_closing_keys(pj_ioqueue_t *ioqueue)
+{
+    pj_time_val now;
+    pj_ioqueue_key_t *h;
+
+    pj_gettickcount(&now);
+    h = ioqueue->closing_list.next;
+    while (h != &ioqueue->closing_list) {
+	pj_ioqueue_key_t *next = h->next;
+
+	pj_assert(h->closing != 0);
+
+	if (PJ_TIME_VAL_GTE(now, h->free_time)) {
+	    pj_list_erase(h);
+	    // Don't set grp_lock to NULL otherwise the other thread
+	    // will crash. Just leave it as dangling pointer, but this
+	    // should be safe
+	    //h->grp_lock = NULL;
+	    pj_list_push_back(&ioqueue->free_list, h);
+	}
+	h = next;
+    }
+}
+
+
+/*
+ * Completion handlers. These are called by pj_ioqueue_poll() without
+ * holding any lock, and return the number of callbacks called.
+ */
+
+/* Deliver the key's backlog to the pending read operations. */
+static int deliver_rx(pj_ioqueue_key_t *h)
+{
+    pj_ioqueue_t *ioqueue = h->ioqueue;
+    int count = 0;
+
+    pj_ioqueue_lock_key(h);
+
+    while (!h->closing) {
+        struct read_operation *read_op;
+        pj_ssize_t bytes_read;
+	pj_bool_t has_lock;
+
+	pj_mutex_lock(ioqueue->rx_mutex);
+	if (pj_list_empty(&h->read_list) ||
+	    (h->rx_cnt == 0 && h->rx_status == PJ_SUCCESS))
+	{
+	    pj_mutex_unlock(ioqueue->rx_mutex);
+	    break;
+	}
+
+        read_op = h->read_list.next;
+        pj_list_erase(read_op);
+
+	if (h->rx_cnt) {
+	    bytes_read = pop_rx_buf(h, read_op->buf, read_op->size,
+				    read_op->rmt_addr, read_op->rmt_addrlen);
+	} else {
+	    bytes_read = -h->rx_status;
+	    h->rx_status = PJ_SUCCESS;
+	}
+	pj_mutex_unlock(ioqueue->rx_mutex);
+
+	read_op->op = PJ_IOQUEUE_OP_NONE;
+	++count;
+	KEY_STAT_READ(h, bytes_read);
+
+	/* Unlock; from this point we don't need to hold key's mutex
+	 * (unless concurrency is disabled, which in this case we should
+	 * hold the mutex while calling the callback) */
+	if (h->allow_concurrent) {
+	    /* concurrency may be changed while we're in the callback, so
+	     * save it to a flag.
+	     */
+	    has_lock = PJ_FALSE;
+	    pj_ioqueue_unlock_key(h);
+	    PJ_RACE_ME(5);
+	} else {
+	    has_lock = PJ_TRUE;
+	}
+
+	/* Call callback. */
+        if (h->cb.on_read_complete && !h->closing) {
+	    KEY_STAT_CB_BEGIN;
+	    (*h->cb.on_read_complete)(h,
+                                      (pj_ioqueue_op_key_t*)read_op,
+                                      bytes_read);
+	    KEY_STAT_CB_END(h);
+        }
+
+	if (!has_lock) {
+	    pj_ioqueue_lock_key(h);
+	}
+    }
+
+    /* Resume receiving if the application still wants more. */
+    if (!h->closing && !pj_list_empty(&h->read_list))
+	arm_rx(h);
+
+    pj_ioqueue_unlock_key(h);
+
+    return count;
+}
+
+/* Completion of single-shot receive. */
+static int on_recv_complete(pj_ioqueue_key_t *h, int res)
+{
+    struct read_operation *read_op;
+    pj_ssize_t bytes_read = 0;
+    pj_bool_t has_lock;
+
+    pj_ioqueue_lock_key(h);
+
+    pj_mutex_lock(h->ioqueue->rx_mutex);
+    h->rx_armed = PJ_FALSE;
+    read_op = h->rx_op;
+    h->rx_op = NULL;
+    pj_mutex_unlock(h->ioqueue->rx_mutex);
+
+    if (h->closing) {
+	pj_ioqueue_unlock_key(h);
+	return 0;
+    }
+
+    /* A cancelled request (e.g. the thread which submitted it has exited)
+     * is simply resubmitted.
+     */
+    if (read_op && res != -ECANCELED) {
+	pj_list_erase(read_op);
+	read_op->op = PJ_IOQUEUE_OP_NONE;
+
+	if (res >= 0) {
+	    bytes_read = res;
+	    if (read_op->rmt_addr && read_op->rmt_addrlen &&
+		h->fd_type == pj_SOCK_DGRAM())
+	    {
+		int len = (int)h->rx_msg.msg_namelen;
+
+		if (len > *read_op->rmt_addrlen)
+		    len = *read_op->rmt_addrlen;
+		pj_memcpy(read_op->rmt_addr, &h->rx_addr, len);
+		*read_op->rmt_addrlen = h->rx_msg.msg_namelen;
+	    }
+	} else {
+	    bytes_read = -PJ_RETURN_OS_ERROR(-res);
+	}
+	KEY_STAT_READ(h, bytes_read);
+    } else {
+	read_op = NULL;
+    }
+
+    if (!pj_list_empty(&h->read_list))
+	arm_rx(h);
+
+    if (!read_op) {
+	pj_ioqueue_unlock_key(h);
+	return 0;
+    }
+
+    /* Unlock; from this point we don't need to hold key's mutex
+     * (unless concurrency is disabled, which in this case we should
+     * hold the mutex while calling the callback) */
+    if (h->allow_concurrent) {
+	/* concurrency may be changed while we're in the callback, so
+	 * save it to a flag.
+	 */
+	has_lock = PJ_FALSE;
+	pj_ioqueue_unlock_key(h);
+	PJ_RACE_ME(5);
+    } else {
+	has_lock = PJ_TRUE;
+    }
+
+    /* Call callback. */
+    if (h->cb.on_read_complete && !h->closing) {
+	KEY_STAT_CB_BEGIN;
+	(*h->cb.on_read_complete)(h, (pj_ioqueue_op_key_t*)read_op,
+				  bytes_read);
+	KEY_STAT_CB_END(h);
+    }
+
+    if (has_lock) {
+	pj_ioqueue_unlock_key(h);
+    }
+
+    return 1;
+}
+
+/* Completion of send. */
+static int on_send_complete(pj_ioqueue_key_t *h, int res)
+{
+    struct write_operation *write_op;
+    pj_bool_t has_lock;
+
+    pj_ioqueue_lock_key(h);
+
+    write_op = h->tx_op;
+    h->tx_op = NULL;
+    h->tx_busy = PJ_FALSE;
+
+    if (h->closing) {
+	pj_ioqueue_unlock_key(h);
+	return 0;
+    }
+
+    if (write_op && res != -ECANCELED) {
+	if (res < 0) {
+	    write_op->written = -PJ_RETURN_OS_ERROR(-res);
+	} else {
+	    write_op->written += res;
+	    if (write_op->written < (pj_ssize_t)write_op->size &&
+		h->fd_type != pj_SOCK_DGRAM())
+	    {
+		/* Partial write of stream, the rest is submitted below */
+		write_op = NULL;
+	    }
+	}
+    } else {
+	write_op = NULL;
+    }
+
+    if (write_op) {
+	pj_list_erase(write_op);
+	write_op->op = PJ_IOQUEUE_OP_NONE;
+	KEY_STAT_WRITE(h, write_op->written);
+    }
+
+    if (!pj_list_empty(&h->write_list))
+	submit_tx(h);
+
+    if (!write_op) {
+	pj_ioqueue_unlock_key(h);
+	return 0;
+    }
+
+    /* Unlock; from this point we don't need to hold key's mutex
+     * (unless concurrency is disabled, which in this case we should
+     * hold the mutex while calling the callback) */
+    if (h->allow_concurrent) {
+	/* concurrency may be changed while we're in the callback, so
+	 * save it to a flag.
+	 */
+	has_lock = PJ_FALSE;
+	pj_ioqueue_unlock_key(h);
+	PJ_RACE_ME(5);
+    } else {
+	has_lock = PJ_TRUE;
+    }
+
+    /* Call callback. */
+    if (h->cb.on_write_complete && !h->closing) {
+	KEY_STAT_CB_BEGIN;
+	(*h->cb.on_write_complete)(h, (pj_ioqueue_op_key_t*)write_op,
+				   write_op->written);
+	KEY_STAT_CB_END(h);
+    }
+
+    if (has_lock) {
+	pj_ioqueue_unlock_key(h);
+    }
+
+    return 1;
+}
+
+#if PJ_HAS_TCP
+/* Completion of accept. */
+static int on_accept_complete(pj_ioqueue_key_t *h, int res)
+{
+    struct accept_operation *accept_op;
+    pj_status_t rc = PJ_SUCCESS;
+    pj_bool_t has_lock;
+
+    pj_ioqueue_lock_key(h);
+
+    accept_op = h->acc_op;
+    h->acc_op = NULL;
+    h->acc_busy = PJ_FALSE;
+
+    if (h->closing || !accept_op || res == -ECANCELED) {
+	/* Nobody wants the connection anymore. */
+	if (res >= 0)
+	    close(res);
+	if (!h->closing && !pj_list_empty(&h->accept_list))
+	    submit_accept(h);
+	pj_ioqueue_unlock_key(h);
+	return 0;
+    }
+
+    pj_list_erase(accept_op);
+    accept_op->op = PJ_IOQUEUE_OP_NONE;
+
+    if (res >= 0) {
+	*accept_op->accept_fd = res;
+	if (accept_op->addrlen) {
+	    if (accept_op->rmt_addr) {
+		int len = (int)h->acc_addrlen;
+
+		if (len > *accept_op->addrlen)
+		    len = *accept_op->addrlen;
+		pj_memcpy(accept_op->rmt_addr, &h->acc_addr, len);
+	    }
+	    *accept_op->addrlen = h->acc_addrlen;
+	    if (accept_op->local_addr) {
+		rc = pj_sock_getsockname(res, accept_op->local_addr,
+					 accept_op->addrlen);
+	    }
+	}
+    } else {
+	*accept_op->accept_fd = PJ_INVALID_SOCKET;
+	rc = PJ_RETURN_OS_ERROR(-res);
+    }
+    KEY_STAT_ACCEPT(h, rc);
+
+    if (!pj_list_empty(&h->accept_list))
+	submit_accept(h);
+
+    /* Unlock; from this point we don't need to hold key's mutex
+     * (unless concurrency is disabled, which in this case we should
+     * hold the mutex while calling the callback) */
+    if (h->allow_concurrent) {
+	/* concurrency may be changed while we're in the callback, so
+	 * save it to a flag.
+	 */
+	has_lock = PJ_FALSE;
+	pj_ioqueue_unlock_key(h);
+	PJ_RACE_ME(5);
+    } else {
+	has_lock = PJ_TRUE;
+    }
+
+    /* Call callback. */
+    if (h->cb.on_accept_complete && !h->closing) {
+	KEY_STAT_CB_BEGIN;
+	(*h->cb.on_accept_complete)(h, (pj_ioqueue_op_key_t*)accept_op,
+				    *accept_op->accept_fd, rc);
+	KEY_STAT_CB_END(h);
+    }
+
+    if (has_lock) {
+	pj_ioqueue_unlock_key(h);
+    }
+
+    return 1;
+}
+
+/* Completion of connect. */
+static int on_connect_complete(pj_ioqueue_key_t *h, int res)
+{
+    pj_bool_t has_lock;
+
+    pj_ioqueue_lock_key(h);
+
+    if (!h->connecting || h->closing) {
+	pj_ioqueue_unlock_key(h);
+	return 0;
+    }
+    h->connecting = PJ_FALSE;
+
+    /* Unlock; from this point we don't need to hold key's mutex
+     * (unless concurrency is disabled, which in this case we should
+     * hold the mutex while calling the callback) */
+    if (h->allow_concurrent) {
+	/* concurrency may be changed while we're in the callback, so
+	 * save it to a flag.
+	 */
+	has_lock = PJ_FALSE;
+	pj_ioqueue_unlock_key(h);
+	PJ_RACE_ME(5);
+    } else {
+	has_lock = PJ_TRUE;
+    }
+
+    /* Call callback. */
+    if (h->cb.on_connect_complete && !h->closing) {
+	KEY_STAT_CB_BEGIN;
+	(*h->cb.on_connect_complete)(h, res==0 ? PJ_SUCCESS :
+					PJ_RETURN_OS_ERROR(-res));
+	KEY_STAT_CB_END(h);
+    }
+
+    if (has_lock) {
+	pj_ioqueue_unlock_key(h);
+    }
+
+    return 1;
+}
+#endif	/* PJ_HAS_TCP */
+
+/*
+ * Reap up to max completions. Must be called with ioqueue's lock held.
+ */
+static unsigned harvest(pj_ioqueue_t *ioqueue, struct event events[],
+			unsigned max)
+{
+    unsigned head, tail, cqe_cnt = 0, count = 0;
+
+    head = *ioqueue->cq_khead;
+    tail = __atomic_load_n(ioqueue->cq_ktail, __ATOMIC_ACQUIRE);
+
+    while (head != tail && count < max) {
+	const struct io_uring_cqe *cqe = &ioqueue->cqes[head &
+							ioqueue->cq_mask];
+	pj_ioqueue_key_t *key;
+	int tag;
+
+	++head;
+	++cqe_cnt;
+
+	key = (pj_ioqueue_key_t*)(pj_size_t)(cqe->user_data & ~TAG_MASK);
+	tag = (int)(cqe->user_data & TAG_MASK);
+	if (!key)
+	    continue;
+
+	/* Each submission holds a reference to the key, which is passed
+	 * to the event of its last completion.
+	 */
+	if (cqe->flags & IORING_CQE_F_MORE)
+	    increment_counter(key);
+
+#if HAS_MULTISHOT_RECV
+	if (tag == TAG_RECV_MULTI)
+	    on_multishot_cqe(key, cqe);
+#endif
+
+	events[count].key = key;
+	events[count].tag = tag;
+	events[count].res = cqe->res;
+	events[count].grp_lock = NULL;
+	if (!key->closing && key->grp_lock) {
+	    events[count].grp_lock = key->grp_lock;
+	    pj_grp_lock_add_ref_dbg(key->grp_lock, "ioqueue", 0);
+	}
+	++count;
+    }
+
+    __atomic_store_n(ioqueue->cq_khead, head, __ATOMIC_RELEASE);
+
+    if (cqe_cnt) {
+	++ioqueue->stat.poll_cnt;
+	ioqueue->stat.event_cnt += cqe_cnt;
+	ioqueue->stat.dispatch_cnt += count;
+	if (cqe_cnt > ioqueue->stat.max_event_cnt)
+	    ioqueue->stat.max_event_cnt = cqe_cnt;
+    }
+
+    return count;
+}
+
+/*
+ * pj_ioqueue_poll()
+ *
+ * Up to ioqueue->max_events completions are reaped at once, waiting in
+ * io_uring_enter() (which also submits the pending operations) only when
+ * there is none. The return value is the number of callbacks called.
+ */
+PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
+{
+    struct event events[PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL];
+    pj_time_val end;
+    unsigned i, count;
+    int processed = 0;
+    void *prev_tls;
+#if PJ_IOQUEUE_STAT
+    pj_timestamp dispatch_start;
+#endif
+
+    PJ_CHECK_STACK();
+
+    pj_gettickcount(&end);
+    if (timeout) {
+	PJ_TIME_VAL_ADD(end, *timeout);
+    } else {
+	end.sec += 9;
+    }
+
+    for (;;) {
+	pj_lock_acquire(ioqueue->lock);
+	count = harvest(ioqueue, events, ioqueue->max_events);
+	pj_lock_release(ioqueue->lock);
+
+	if (count == 0) {
+	    struct io_uring_getevents_arg arg;
+	    struct __kernel_timespec ts;
+	    pj_time_val now;
+	    int rc;
+
+	    pj_gettickcount(&now);
+	    if (PJ_TIME_VAL_GT(end, now)) {
+		pj_time_val left = end;
+
+		PJ_TIME_VAL_SUB(left, now);
+		ts.tv_sec = left.sec;
+		ts.tv_nsec = left.msec * 1000000L;
+	    } else {
+		ts.tv_sec = 0;
+		ts.tv_nsec = 0;
+	    }
+
+	    pj_bzero(&arg, sizeof(arg));
+	    arg.sigmask_sz = _NSIG / 8;
+	    arg.ts = (pj_uint64_t)(pj_size_t)&ts;
+
+	    TRACE_((THIS_FILE, "start io_uring_enter"));
+	    rc = sys_uring_enter(ioqueue->ring_fd, ioqueue->sq_entries, 1,
+				 IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+				 &arg, sizeof(arg));
+	    if (rc < 0 && errno != ETIME && errno != EINTR &&
+		errno != EBUSY)
+	    {
+		TRACE_((THIS_FILE, "io_uring_enter error"));
+		return -pj_get_os_error();
+	    }
+
+	    pj_lock_acquire(ioqueue->lock);
+	    count = harvest(ioqueue, events, ioqueue->max_events);
+	    if (count == 0) {
+		/* Check the closing keys only when there's no activity and
+		 * when there are pending closing keys.
+		 */
+		if (!pj_list_empty(&ioqueue->closing_list))
+		    scan_closing_keys(ioqueue);
+		pj_lock_release(ioqueue->lock);
+
+		pj_gettickcount(&now);
+		if (PJ_TIME_VAL_GTE(now, end))
+		    break;
+		continue;
+	    }
+	    pj_lock_release(ioqueue->lock);
+	}
+
+	/* Now process the events. Operations submitted by the callbacks
+	 * are flushed together afterwards.
+	 */
+	prev_tls = pj_thread_local_get(ioqueue->tls_id);
+	pj_thread_local_set(ioqueue->tls_id, ioqueue);
+	pj_coarse_clock_enter(NULL);
+#if PJ_IOQUEUE_STAT
+	pj_get_timestamp(&dispatch_start);
+#endif
+
+	for (i=0; i<count; ++i) {
+	    pj_ioqueue_key_t *h = events[i].key;
+
+	    switch (events[i].tag) {
+	    case TAG_RECV_MULTI:
+	    case TAG_KICK:
+		processed += deliver_rx(h);
+		break;
+	    case TAG_RECV:
+		processed += on_recv_complete(h, events[i].res);
+		break;
+	    case TAG_SEND:
+		processed += on_send_complete(h, events[i].res);
+		break;
+#if PJ_HAS_TCP
+	    case TAG_ACCEPT:
+		processed += on_accept_complete(h, events[i].res);
+		break;
+	    case TAG_CONNECT:
+		processed += on_connect_complete(h, events[i].res);
+		break;
+#endif
+	    default:
+		pj_assert(!"Invalid event!");
+		break;
+	    }
+
+	    decrement_counter(h);
+
+	    if (events[i].grp_lock)
+		pj_grp_lock_dec_ref_dbg(events[i].grp_lock, "ioqueue", 0);
+	}
+
+#if PJ_IOQUEUE_STAT
+	ioqueue_stat_dispatch_done(ioqueue, &dispatch_start);
+#endif
+
+	pj_coarse_clock_leave();
+	pj_thread_local_set(ioqueue->tls_id, prev_tls);
+
+	if (ioqueue->sq_deferred)
+	    flush_sqes(ioqueue);
+
+	/* Completions such as cancellations don't call any callback, keep
+	 * waiting for the rest of the timeout in that case.
+	 */
+	if (processed) {
+	    break;
+	} else {
+	    pj_time_val now;
+
+	    pj_gettickcount(&now);
+	    if (PJ_TIME_VAL_GTE(now, end))
+		break;
+	}
+    }
+
+    TRACE_((THIS_FILE, "ioqueue_poll() returns %d", processed));
+
+    return processed;
+}
+
+/*
+ * Start asynchronous recv() or recvfrom().
+ */
+static pj_status_t start_read(pj_ioqueue_key_t *key,
+			      pj_ioqueue_op_key_t *op_key,
+			      void *buffer,
+			      pj_ssize_t *length,
+			      unsigned flags,
+			      pj_sockaddr_t *addr,
+			      int *addrlen,
+			      pj_ioqueue_operation_e op)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+    struct read_operation *read_op;
+    pj_bool_t has_backlog;
+    pj_status_t status;
+
+    /* Check if key is closing (need to do this first before accessing
+     * other variables, since they might have been destroyed. See ticket
+     * #469).
+     */
+    if (key->closing)
+	return PJ_ECANCELLED;
+
+    read_op = (struct read_operation*)op_key;
+    read_op->op = PJ_IOQUEUE_OP_NONE;
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app.
+     */
+    if (key->closing) {
+	pj_ioqueue_unlock_key(key);
+	return PJ_ECANCELLED;
+    }
+
+    /* Try to see if there's data immediately available, either already
+     * received by the kernel into the key's backlog or in the socket.
+     */
+    if ((flags & PJ_IOQUEUE_ALWAYS_ASYNC) == 0 &&
+	pj_list_empty(&key->read_list))
+    {
+	pj_bool_t armed;
+
+	pj_mutex_lock(ioqueue->rx_mutex);
+	if (key->rx_cnt) {
+	    pj_ssize_t size = pop_rx_buf(key, buffer, *length, addr, addrlen);
+	    pj_mutex_unlock(ioqueue->rx_mutex);
+	    pj_ioqueue_unlock_key(key);
+	    if (size < 0)
+		return (pj_status_t)-size;
+	    KEY_STAT_READ(key, size);
+	    *length = size;
+	    return PJ_SUCCESS;
+	} else if (key->rx_status != PJ_SUCCESS) {
+	    status = key->rx_status;
+	    key->rx_status = PJ_SUCCESS;
+	    pj_mutex_unlock(ioqueue->rx_mutex);
+	    pj_ioqueue_unlock_key(key);
+	    return status;
+	}
+	armed = key->rx_armed;
+	pj_mutex_unlock(ioqueue->rx_mutex);
+
+	/* Reading the socket while a receive is in flight would reorder
+	 * the data.
+	 */
+	if (!armed) {
+	    pj_ssize_t size = *length;
+
+	    if (op == PJ_IOQUEUE_OP_RECV_FROM) {
+		status = pj_sock_recvfrom(key->fd, buffer, &size, flags,
+					  addr, addrlen);
+	    } else {
+		status = pj_sock_recv(key->fd, buffer, &size, flags);
+	    }
+
+	    if (status == PJ_SUCCESS) {
+		/* Yes! Data is available! */
+		pj_ioqueue_unlock_key(key);
+		KEY_STAT_READ(key, size);
+		*length = size;
+		return PJ_SUCCESS;
+	    } else if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+		/* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+		 * the error to caller.
+		 */
+		pj_ioqueue_unlock_key(key);
+		return status;
+	    }
+	}
+    }
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /*
+     * No data is immediately available.
+     * Must schedule asynchronous operation to the ioqueue.
+     */
+    read_op->op = op;
+    read_op->buf = buffer;
+    read_op->size = *length;
+    read_op->flags = flags;
+    read_op->rmt_addr = addr;
+    read_op->rmt_addrlen = addrlen;
+    pj_list_insert_before(&key->read_list, read_op);
+
+    pj_mutex_lock(ioqueue->rx_mutex);
+    has_backlog = (key->rx_cnt || key->rx_status != PJ_SUCCESS);
+    if (read_op->size > key->rx_max) {
+	key->rx_max = read_op->size;
+#if HAS_MULTISHOT_RECV
+	/* The provided buffers are too small for this read, switch to
+	 * single-shot receive into the application's buffer once the
+	 * multishot receive in flight is cancelled.
+	 */
+	if (key->rx_armed && key->rx_tag == TAG_RECV_MULTI &&
+	    !key->rx_cancel && ioqueue->buf_size &&
+	    key->rx_max > RX_BUF_PAYLOAD(ioqueue) &&
+	    RX_BUF_PAYLOAD(ioqueue) < RX_DGRAM_MAX)
+	{
+	    key->rx_cancel = PJ_TRUE;
+	    submit_cancel(key, TAG_RECV_MULTI);
+	}
+#endif
+    }
+    pj_mutex_unlock(ioqueue->rx_mutex);
+
+    status = has_backlog ? kick_key(key) : arm_rx(key);
+    if (status != PJ_SUCCESS) {
+	pj_list_erase(read_op);
+	read_op->op = PJ_IOQUEUE_OP_NONE;
+	pj_ioqueue_unlock_key(key);
+	return status;
+    }
+
+    pj_ioqueue_unlock_key(key);
+
+    return PJ_EPENDING;
+}
+
+/*
+ * pj_ioqueue_recv()
+ *
+ * Start asynchronous recv() from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recv(  pj_ioqueue_key_t *key,
+                                      pj_ioqueue_op_key_t *op_key,
+				      void *buffer,
+				      pj_ssize_t *length,
+				      unsigned flags )
+{
+    PJ_ASSERT_RETURN(key && op_key && buffer && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    return start_read(key, op_key, buffer, length, flags, NULL, NULL,
+		      PJ_IOQUEUE_OP_RECV);
+}
+
+/*
+ * pj_ioqueue_recvfrom()
+ *
+ * Start asynchronous recvfrom() from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recvfrom( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key,
+				         void *buffer,
+				         pj_ssize_t *length,
+                                         unsigned flags,
+				         pj_sockaddr_t *addr,
+				         int *addrlen)
+{
+    PJ_ASSERT_RETURN(key && op_key && buffer && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    return start_read(key, op_key, buffer, length, flags, addr, addrlen,
+		      PJ_IOQUEUE_OP_RECV_FROM);
+}
+
+/*
+ * Queue asynchronous send() or sendto().
+ */
+static pj_status_t start_write(pj_ioqueue_key_t *key,
+			       pj_ioqueue_op_key_t *op_key,
+			       const void *data,
+			       pj_ssize_t *length,
+			       unsigned flags,
+			       const pj_sockaddr_t *addr,
+			       int addrlen,
+			       pj_ioqueue_operation_e op)
+{
+    struct write_operation *write_op;
+    unsigned retry;
+    pj_status_t status;
+
+    write_op = (struct write_operation*)op_key;
+
+    /* Spin if write_op has pending operation */
+    for (retry=0; write_op->op != 0 && retry<PENDING_RETRY; ++retry)
+	pj_thread_sleep(0);
+
+    /* Last chance */
+    if (write_op->op) {
+	/* Unable to send packet because there is already pending write in
+	 * the write_op. Aplication should specify multiple write operation
+	 * keys on situation like this.
+	 */
+	return PJ_EBUSY;
+    }
+
+    write_op->op = op;
+    write_op->buf = (char*)data;
+    write_op->size = *length;
+    write_op->written = 0;
+    write_op->flags = flags;
+    if (addr) {
+	pj_memcpy(&write_op->rmt_addr, addr, addrlen);
+	write_op->rmt_addrlen = addrlen;
+    }
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app.
+     */
+    if (key->closing) {
+	write_op->op = PJ_IOQUEUE_OP_NONE;
+	pj_ioqueue_unlock_key(key);
+	return PJ_ECANCELLED;
+    }
+    pj_list_insert_before(&key->write_list, write_op);
+    if (!key->tx_busy) {
+	status = submit_tx(key);
+	if (status != PJ_SUCCESS) {
+	    pj_list_erase(write_op);
+	    write_op->op = PJ_IOQUEUE_OP_NONE;
+	    pj_ioqueue_unlock_key(key);
+	    return status;
+	}
+    }
+    pj_ioqueue_unlock_key(key);
+
+    return PJ_EPENDING;
+}
+
+/*
+ * pj_ioqueue_send()
+ *
+ * Start asynchronous send() to the descriptor.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_send( pj_ioqueue_key_t *key,
+                                     pj_ioqueue_op_key_t *op_key,
+			             const void *data,
+			             pj_ssize_t *length,
+                                     unsigned flags)
+{
+    pj_status_t status;
+    pj_ssize_t sent;
+
+    PJ_ASSERT_RETURN(key && op_key && data && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (key->closing)
+	return PJ_ECANCELLED;
+
+    /* We can not use PJ_IOQUEUE_ALWAYS_ASYNC for socket write. */
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /* Fast track:
+     *   Try to send data immediately, only if there's no pending write!
+     *   Like the other backends, the emptiness of the list is speculated
+     *   without holding the key's lock.
+     */
+    if (pj_list_empty(&key->write_list) && !key->tx_busy) {
+        sent = *length;
+        status = pj_sock_send(key->fd, data, &sent, flags);
+        if (status == PJ_SUCCESS) {
+            /* Success! */
+            KEY_STAT_WRITE(key, sent);
+            *length = sent;
+            return PJ_SUCCESS;
+        } else if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+	    return status;
+        }
+    }
+
+    /*
+     * Schedule asynchronous send.
+     */
+    return start_write(key, op_key, data, length, flags, NULL, 0,
+		       PJ_IOQUEUE_OP_SEND);
+}
+
+
+/*
+ * pj_ioqueue_sendto()
+ *
+ * Start asynchronous write() to the descriptor.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
+                                       pj_ioqueue_op_key_t *op_key,
+			               const void *data,
+			               pj_ssize_t *length,
+                                       pj_uint32_t flags,
+			               const pj_sockaddr_t *addr,
+			               int addrlen)
+{
+    pj_status_t status;
+    pj_ssize_t sent;
+
+    PJ_ASSERT_RETURN(key && op_key && data && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (key->closing)
+	return PJ_ECANCELLED;
+
+    /* We can not use PJ_IOQUEUE_ALWAYS_ASYNC for socket write */
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /* Fast track:
+     *   Try to send data immediately, only if there's no pending write!
+     */
+    if (pj_list_empty(&key->write_list) && !key->tx_busy) {
+        sent = *length;
+        status = pj_sock_sendto(key->fd, data, &sent, flags, addr, addrlen);
+        if (status == PJ_SUCCESS) {
+            /* Success! */
+            KEY_STAT_WRITE(key, sent);
+            *length = sent;
+            return PJ_SUCCESS;
+        } else if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+	    return status;
+        }
+    }
+
+    /*
+     * Check that address storage can hold the address parameter.
+     */
+    PJ_ASSERT_RETURN(addrlen <= (int)sizeof(pj_sockaddr), PJ_EBUG);
+
+    /*
+     * Schedule asynchronous send.
+     */
+    return start_write(key, op_key, data, length, flags, addr, addrlen,
+		       PJ_IOQUEUE_OP_SEND_TO);
+}
+
+#if PJ_HAS_TCP
+/*
+ * Initiate overlapped accept() operation.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_accept( pj_ioqueue_key_t *key,
+                                       pj_ioqueue_op_key_t *op_key,
+			               pj_sock_t *new_sock,
+			               pj_sockaddr_t *local,
+			               pj_sockaddr_t *remote,
+			               int *addrlen)
+{
+    struct accept_operation *accept_op;
+    pj_status_t status;
+
+    /* check parameters. All must be specified! */
+    PJ_ASSERT_RETURN(key && op_key && new_sock, PJ_EINVAL);
+
+    /* Check if key is closing. */
+    if (key->closing)
+	return PJ_ECANCELLED;
+
+    accept_op = (struct accept_operation*)op_key;
+    accept_op->op = PJ_IOQUEUE_OP_NONE;
+
+    /* Fast track:
+     *  See if there's new connection available immediately.
+     */
+    if (pj_list_empty(&key->accept_list) && !key->acc_busy) {
+        status = pj_sock_accept(key->fd, new_sock, remote, addrlen);
+        if (status == PJ_SUCCESS) {
+            /* Yes! New connection is available! */
+            if (local && addrlen) {
+                status = pj_sock_getsockname(*new_sock, local, addrlen);
+                if (status != PJ_SUCCESS) {
+                    pj_sock_close(*new_sock);
+                    *new_sock = PJ_INVALID_SOCKET;
+                    return status;
+                }
+            }
+            KEY_STAT_ACCEPT(key, status);
+            return PJ_SUCCESS;
+        } else if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+	    return status;
+        }
+    }
+
+    /*
+     * No connection is available immediately.
+     * Submit accept() to be completed when there is incoming connection.
+     */
+    accept_op->op = PJ_IOQUEUE_OP_ACCEPT;
+    accept_op->accept_fd = new_sock;
+    accept_op->rmt_addr = remote;
+    accept_op->addrlen= addrlen;
+    accept_op->local_addr = local;
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app.
+     */
+    if (key->closing) {
+	accept_op->op = PJ_IOQUEUE_OP_NONE;
+	pj_ioqueue_unlock_key(key);
+	return PJ_ECANCELLED;
+    }
+    pj_list_insert_before(&key->accept_list, accept_op);
+    if (!key->acc_busy) {
+	status = submit_accept(key);
+	if (status != PJ_SUCCESS) {
+	    pj_list_erase(accept_op);
+	    accept_op->op = PJ_IOQUEUE_OP_NONE;
+	    pj_ioqueue_unlock_key(key);
+	    return status;
+	}
+    }
+    pj_ioqueue_unlock_key(key);
+
+    return PJ_EPENDING;
+}
+
+/*
+ * Initiate asynchronous connect() operation.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_connect( pj_ioqueue_key_t *key,
+					const pj_sockaddr_t *addr,
+					int addrlen )
+{
+    struct io_uring_sqe *sqe;
+
+    /* check parameters. All must be specified! */
+    PJ_ASSERT_RETURN(key && addr && addrlen, PJ_EINVAL);
+    PJ_ASSERT_RETURN(addrlen <= (int)sizeof(pj_sockaddr), PJ_EINVAL);
+
+    /* Check if key is closing. */
+    if (key->closing)
+	return PJ_ECANCELLED;
+
+    /* Check if socket has not been marked for connecting */
+    if (key->connecting != 0)
+        return PJ_EPENDING;
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous
+     * check in multithreaded app.
+     */
+    if (key->closing) {
+	pj_ioqueue_unlock_key(key);
+	return PJ_ECANCELLED;
+    }
+
+    sqe = get_sqe(key->ioqueue);
+    if (!sqe) {
+	pj_ioqueue_unlock_key(key);
+	return PJ_ETOOMANY;
+    }
+
+    pj_memcpy(&key->conn_addr, addr, addrlen);
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = key->fd;
+    sqe->addr = (pj_uint64_t)(pj_size_t)&key->conn_addr;
+    sqe->off = addrlen;
+    sqe->user_data = USER_DATA(key, TAG_CONNECT);
+
+    key->connecting = PJ_TRUE;
+    increment_counter(key);
+    commit_sqe(key->ioqueue, PJ_FALSE);
+
+    pj_ioqueue_unlock_key(key);
+
+    return PJ_EPENDING;
+}
+#endif	/* PJ_HAS_TCP */
+
+
+/*
+ * pj_ioqueue_post_completion()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_post_completion( pj_ioqueue_key_t *key,
+                                                pj_ioqueue_op_key_t *op_key,
+                                                pj_ssize_t bytes_status )
+{
+    struct generic_operation *op_rec;
+
+    /*
+     * Find the operation key in all pending operation list to
+     * really make sure that it's still there; then call the callback.
+     * If the operation is in flight, it is cancelled first.
+     */
+    pj_ioqueue_lock_key(key);
+
+    /* Find the operation in the pending read list. */
+    op_rec = (struct generic_operation*)key->read_list.next;
+    while (op_rec != (void*)&key->read_list) {
+        if (op_rec == (void*)op_key) {
+            pj_list_erase(op_rec);
+            op_rec->op = PJ_IOQUEUE_OP_NONE;
+
+	    pj_mutex_lock(key->ioqueue->rx_mutex);
+	    if (key->rx_op == (void*)op_rec) {
+		key->rx_op = NULL;
+		submit_cancel(key, TAG_RECV);
+	    }
+	    pj_mutex_unlock(key->ioqueue->rx_mutex);
+
+            pj_ioqueue_unlock_key(key);
+
+            (*key->cb.on_read_complete)(key, op_key, bytes_status);
+            return PJ_SUCCESS;
+        }
+        op_rec = op_rec->next;
+    }
+
+    /* Find the operation in the pending write list. */
+    op_rec = (struct generic_operation*)key->write_list.next;
+    while (op_rec != (void*)&key->write_list) {
+        if (op_rec == (void*)op_key) {
+            pj_list_erase(op_rec);
+            op_rec->op = PJ_IOQUEUE_OP_NONE;
+
+	    if (key->tx_op == (void*)op_rec) {
+		key->tx_op = NULL;
+		submit_cancel(key, TAG_SEND);
+	    }
+
+            pj_ioqueue_unlock_key(key);
+
+            (*key->cb.on_write_complete)(key, op_key, bytes_status);
+            return PJ_SUCCESS;
+        }
+        op_rec = op_rec->next;
+    }
+
+#if PJ_HAS_TCP
+    /* Find the operation in the pending accept list. */
+    op_rec = (struct generic_operation*)key->accept_list.next;
+    while (op_rec != (void*)&key->accept_list) {
+        if (op_rec == (void*)op_key) {
+            pj_list_erase(op_rec);
+            op_rec->op = PJ_IOQUEUE_OP_NONE;
+
+	    if (key->acc_op == (void*)op_rec) {
+		key->acc_op = NULL;
+		submit_cancel(key, TAG_ACCEPT);
+	    }
+
+            pj_ioqueue_unlock_key(key);
+
+            (*key->cb.on_accept_complete)(key, op_key,
+                                          PJ_INVALID_SOCKET,
+                                          (pj_status_t)bytes_status);
+            return PJ_SUCCESS;
+        }
+        op_rec = op_rec->next;
+    }
+#endif
+
+    pj_ioqueue_unlock_key(key);
+
+    return PJ_EINVALIDOP;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_oneshot(pj_ioqueue_t *ioqueue,
+					   pj_bool_t enable)
+{
+    /* Completions are already reaped by one thread each */
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+    return enable ? PJ_ENOTSUP : PJ_SUCCESS;
+}
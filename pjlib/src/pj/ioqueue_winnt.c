@@ -320,6 +320,15 @@ PJ_DEF(const char*) pj_ioqueue_name(void)
     return "iocp";
 }
 
+/*
+ * pj_ioqueue_get_features()
+ */
+PJ_DEF(unsigned) pj_ioqueue_get_features(void)
+{
+    /* The overlapped reads are submitted beforehand */
+    return 0;
+}
+
 /*
  * pj_ioqueue_create()
  */
@@ -472,6 +481,51 @@ PJ_DEF(pj_status_t) pj_ioqueue_set_default_concurrency(pj_ioqueue_t *ioqueue,
     return PJ_SUCCESS;
 }
 
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_max_events(pj_ioqueue_t *ioqueue,
+					      unsigned max_events)
+{
+    /* IOCP dispatches one completion at a time, just return PJ_SUCCESS */
+    PJ_ASSERT_RETURN(ioqueue && max_events, PJ_EINVAL);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_oneshot(pj_ioqueue_t *ioqueue,
+					   pj_bool_t enable)
+{
+    /* IOCP already wakes up one thread per completion */
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+    return enable ? PJ_ENOTSUP : PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_get_stat(pj_ioqueue_t *ioqueue,
+					pj_ioqueue_stat *stat)
+{
+    PJ_UNUSED_ARG(ioqueue);
+    PJ_UNUSED_ARG(stat);
+    return PJ_ENOTSUP;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_reset_stat(pj_ioqueue_t *ioqueue)
+{
+    PJ_UNUSED_ARG(ioqueue);
+    return PJ_ENOTSUP;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_get_key_stat(pj_ioqueue_key_t *key,
+					    pj_ioqueue_key_stat *stat)
+{
+    PJ_UNUSED_ARG(key);
+    PJ_UNUSED_ARG(stat);
+    return PJ_ENOTSUP;
+}
+
+PJ_DEF(void) pj_ioqueue_dump(pj_ioqueue_t *ioqueue, pj_bool_t detail)
+{
+    PJ_UNUSED_ARG(ioqueue);
+    PJ_UNUSED_ARG(detail);
+}
+
 /*
  * pj_ioqueue_set_lock()
  */
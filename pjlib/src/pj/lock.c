@@ -230,14 +230,33 @@ typedef struct grp_lock_ref
 } grp_lock_ref;
 #endif
 
+#if PJ_GRP_LOCK_STAT
+/* Entry in the list of all group locks */
+typedef struct grp_lock_node
+{
+    PJ_DECL_LIST_MEMBER(struct grp_lock_node);
+    pj_grp_lock_t	*glock;
+} grp_lock_node;
+
+static grp_lock_node grp_lock_all = { &grp_lock_all, &grp_lock_all, NULL };
+
+#define GRP_LOCK_DUMP_MAX	32
+#endif
+
 /* The group lock */
 struct pj_grp_lock_t
 {
     pj_lock_t	 	 base;
 
     pj_pool_t		*pool;
+#if PJ_HAS_ATOMIC_BUILTINS
+    pj_atomic_value_t	 ref_cnt;
+#else
     pj_atomic_t		*ref_cnt;
+#endif
     pj_lock_t		*own_lock;
+    pj_mutex_t		*own_mutex;	/* The mutex of own_lock	    */
+    unsigned		 chain_cnt;	/* Number of chained external locks */
 
     pj_thread_t		*owner;
     int			 owner_cnt;
@@ -249,8 +268,26 @@ struct pj_grp_lock_t
     grp_lock_ref	 ref_list;
     grp_lock_ref	 ref_free_list;
 #endif
+
+#if PJ_GRP_LOCK_STAT
+    grp_lock_node	 node;
+    char		 name[PJ_MAX_OBJ_NAME];
+    pj_grp_lock_stat	 stat;		/* Protected by own_mutex	    */
+#endif
 };
 
+#if PJ_HAS_ATOMIC_BUILTINS
+#   define GRP_REF_INC(g)   __atomic_add_fetch(&(g)->ref_cnt, 1, \
+					       __ATOMIC_RELAXED)
+#   define GRP_REF_DEC(g)   __atomic_sub_fetch(&(g)->ref_cnt, 1, \
+					       __ATOMIC_ACQ_REL)
+#   define GRP_REF_GET(g)   __atomic_load_n(&(g)->ref_cnt, __ATOMIC_RELAXED)
+#else
+#   define GRP_REF_INC(g)   pj_atomic_inc_and_get((g)->ref_cnt)
+#   define GRP_REF_DEC(g)   pj_atomic_dec_and_get((g)->ref_cnt)
+#   define GRP_REF_GET(g)   pj_atomic_get((g)->ref_cnt)
+#endif
+
 
 PJ_DEF(void) pj_grp_lock_config_default(pj_grp_lock_config *cfg)
 {
@@ -278,18 +315,59 @@ static void grp_lock_unset_owner_thread(pj_grp_lock_t *glock)
     }
 }
 
+/* Lock the group lock's own mutex, and count the contention */
+static void grp_lock_own_acquire(pj_grp_lock_t *glock)
+{
+#if PJ_GRP_LOCK_STAT
+    if (pj_mutex_trylock(glock->own_mutex) != PJ_SUCCESS) {
+	pj_timestamp t0, t1;
+	pj_uint32_t usec;
+
+	pj_get_timestamp(&t0);
+	pj_mutex_lock(glock->own_mutex);
+	pj_get_timestamp(&t1);
+
+	usec = pj_elapsed_usec(&t0, &t1);
+	++glock->stat.contended_cnt;
+	glock->stat.total_wait_usec += usec;
+	if (usec > glock->stat.max_wait_usec)
+	    glock->stat.max_wait_usec = usec;
+    }
+    ++glock->stat.acquire_cnt;
+#else
+    pj_mutex_lock(glock->own_mutex);
+#endif
+}
+
 static pj_status_t grp_lock_acquire(LOCK_OBJ *p)
 {
     pj_grp_lock_t *glock = (pj_grp_lock_t*)p;
     grp_lock_item *lck;
 
-    pj_assert(pj_atomic_get(glock->ref_cnt) > 0);
+    pj_assert(GRP_REF_GET(glock) > 0);
+
+    /* Most group locks don't have external locks chained to them, so
+     * only the own mutex needs to be locked. The count is checked again
+     * once the mutex is held, since it is changed with the group lock
+     * held.
+     */
+    if (glock->chain_cnt == 0) {
+	grp_lock_own_acquire(glock);
+	if (glock->chain_cnt == 0)
+	    goto on_acquired;
+	pj_mutex_unlock(glock->own_mutex);
+    }
 
     lck = glock->lock_list.next;
     while (lck != &glock->lock_list) {
-	pj_lock_acquire(lck->lock);
+	if (lck->lock == glock->own_lock)
+	    grp_lock_own_acquire(glock);
+	else
+	    pj_lock_acquire(lck->lock);
 	lck = lck->next;
     }
+
+on_acquired:
     grp_lock_set_owner_thread(glock);
     pj_grp_lock_add_ref(glock);
     return PJ_SUCCESS;
@@ -300,7 +378,16 @@ static pj_status_t grp_lock_tryacquire(LOCK_OBJ *p)
     pj_grp_lock_t *glock = (pj_grp_lock_t*)p;
     grp_lock_item *lck;
 
-    pj_assert(pj_atomic_get(glock->ref_cnt) > 0);
+    pj_assert(GRP_REF_GET(glock) > 0);
+
+    if (glock->chain_cnt == 0) {
+	pj_status_t status = pj_mutex_trylock(glock->own_mutex);
+	if (status != PJ_SUCCESS)
+	    return status;
+	if (glock->chain_cnt == 0)
+	    goto on_acquired;
+	pj_mutex_unlock(glock->own_mutex);
+    }
 
     lck = glock->lock_list.next;
     while (lck != &glock->lock_list) {
@@ -315,6 +402,11 @@ static pj_status_t grp_lock_tryacquire(LOCK_OBJ *p)
 	}
 	lck = lck->next;
     }
+
+on_acquired:
+#if PJ_GRP_LOCK_STAT
+    ++glock->stat.acquire_cnt;
+#endif
     grp_lock_set_owner_thread(glock);
     pj_grp_lock_add_ref(glock);
     return PJ_SUCCESS;
@@ -327,10 +419,14 @@ static pj_status_t grp_lock_release(LOCK_OBJ *p)
 
     grp_lock_unset_owner_thread(glock);
 
-    lck = glock->lock_list.prev;
-    while (lck != &glock->lock_list) {
-	pj_lock_release(lck->lock);
-	lck = lck->prev;
+    if (glock->chain_cnt == 0) {
+	pj_mutex_unlock(glock->own_mutex);
+    } else {
+	lck = glock->lock_list.prev;
+	while (lck != &glock->lock_list) {
+	    pj_lock_release(lck->lock);
+	    lck = lck->prev;
+	}
     }
     return pj_grp_lock_dec_ref(glock);
 }
@@ -366,8 +462,20 @@ static pj_status_t grp_lock_destroy(LOCK_OBJ *p)
 	cb = next;
     }
 
-    pj_lock_destroy(glock->own_lock);
-    pj_atomic_destroy(glock->ref_cnt);
+#if PJ_GRP_LOCK_STAT
+    if (glock->node.next) {
+	pj_enter_critical_section();
+	pj_list_erase(&glock->node);
+	pj_leave_critical_section();
+    }
+#endif
+
+    if (glock->own_lock)
+	pj_lock_destroy(glock->own_lock);
+#if !PJ_HAS_ATOMIC_BUILTINS
+    if (glock->ref_cnt)
+	pj_atomic_destroy(glock->ref_cnt);
+#endif
     glock->pool = NULL;
     pj_pool_release(pool);
 
@@ -381,12 +489,19 @@ PJ_DEF(pj_status_t) pj_grp_lock_create( pj_pool_t *pool,
 {
     pj_grp_lock_t *glock;
     grp_lock_item *own_lock;
+#if PJ_GRP_LOCK_STAT
+    const char *owner_name;
+#endif
     pj_status_t status;
 
     PJ_ASSERT_RETURN(pool && p_grp_lock, PJ_EINVAL);
 
     PJ_UNUSED_ARG(cfg);
 
+#if PJ_GRP_LOCK_STAT
+    owner_name = pool->obj_name;
+#endif
+
     pool = pj_pool_create(pool->factory, "glck%p", 512, 512, NULL);
     if (!pool)
 	return PJ_ENOMEM;
@@ -406,19 +521,31 @@ PJ_DEF(pj_status_t) pj_grp_lock_create( pj_pool_t *pool,
     pj_list_init(&glock->ref_free_list);
 #endif
 
+#if !PJ_HAS_ATOMIC_BUILTINS
     status = pj_atomic_create(pool, 0, &glock->ref_cnt);
     if (status != PJ_SUCCESS)
 	goto on_error;
+#endif
 
     status = pj_lock_create_recursive_mutex(pool, pool->obj_name,
                                             &glock->own_lock);
     if (status != PJ_SUCCESS)
 	goto on_error;
+    glock->own_mutex = (pj_mutex_t*) glock->own_lock->lock_object;
 
     own_lock = PJ_POOL_ZALLOC_T(pool, grp_lock_item);
     own_lock->lock = glock->own_lock;
     pj_list_push_back(&glock->lock_list, own_lock);
 
+#if PJ_GRP_LOCK_STAT
+    pj_ansi_strncpy(glock->name, owner_name, sizeof(glock->name));
+    glock->name[sizeof(glock->name)-1] = '\0';
+    glock->node.glock = glock;
+    pj_enter_critical_section();
+    pj_list_push_back(&grp_lock_all, &glock->node);
+    pj_leave_critical_section();
+#endif
+
     *p_grp_lock = glock;
     return PJ_SUCCESS;
 
@@ -516,14 +643,14 @@ PJ_DEF(pj_status_t) pj_grp_lock_del_handler( pj_grp_lock_t *glock,
 
 static pj_status_t grp_lock_add_ref(pj_grp_lock_t *glock)
 {
-    pj_atomic_inc(glock->ref_cnt);
+    GRP_REF_INC(glock);
     return PJ_SUCCESS;
 }
 
 static pj_status_t grp_lock_dec_ref(pj_grp_lock_t *glock)
 {
     int cnt; /* for debugging */
-    if ((cnt=pj_atomic_dec_and_get(glock->ref_cnt)) == 0) {
+    if ((cnt=(int)GRP_REF_DEC(glock)) == 0) {
 	grp_lock_destroy(glock);
 	return PJ_EGONE;
     }
@@ -606,7 +733,7 @@ PJ_DEF(pj_status_t) pj_grp_lock_dec_ref(pj_grp_lock_t *glock)
 
 PJ_DEF(int) pj_grp_lock_get_ref(pj_grp_lock_t *glock)
 {
-    return pj_atomic_get(glock->ref_cnt);
+    return (int)GRP_REF_GET(glock);
 }
 
 PJ_DEF(pj_status_t) pj_grp_lock_chain_lock( pj_grp_lock_t *glock,
@@ -632,6 +759,7 @@ PJ_DEF(pj_status_t) pj_grp_lock_chain_lock( pj_grp_lock_t *glock,
     new_lck->prio = pos;
     new_lck->lock = lock;
     pj_list_insert_before(lck, new_lck);
+    ++glock->chain_cnt;
 
     /* this will also release the new lock */
     grp_lock_release(glock);
@@ -656,6 +784,7 @@ PJ_DEF(pj_status_t) pj_grp_lock_unchain_lock( pj_grp_lock_t *glock,
 	int i;
 
 	pj_list_erase(lck);
+	--glock->chain_cnt;
 	for (i=0; i<glock->owner_cnt; ++i)
 	    pj_lock_release(lck->lock);
     }
@@ -713,3 +842,75 @@ PJ_DEF(void) pj_grp_lock_dump(pj_grp_lock_t *grp_lock)
     PJ_UNUSED_ARG(grp_lock);
 #endif
 }
+
+PJ_DEF(pj_status_t) pj_grp_lock_get_stat(pj_grp_lock_t *glock,
+					 pj_grp_lock_stat *stat)
+{
+    PJ_ASSERT_RETURN(glock && stat, PJ_EINVAL);
+
+#if PJ_GRP_LOCK_STAT
+    pj_mutex_lock(glock->own_mutex);
+    pj_memcpy(stat, &glock->stat, sizeof(*stat));
+    pj_mutex_unlock(glock->own_mutex);
+    return PJ_SUCCESS;
+#else
+    pj_bzero(stat, sizeof(*stat));
+    return PJ_ENOTSUP;
+#endif
+}
+
+PJ_DEF(void) pj_grp_lock_dump_stat(unsigned max_cnt)
+{
+#if PJ_GRP_LOCK_STAT
+    struct {
+	pj_grp_lock_t	*glock;
+	char		 name[PJ_MAX_OBJ_NAME];
+	pj_grp_lock_stat stat;
+    } top[GRP_LOCK_DUMP_MAX];
+    unsigned i, cnt = 0, total = 0;
+    grp_lock_node *node;
+
+    if (max_cnt == 0)
+	max_cnt = 10;
+    if (max_cnt > GRP_LOCK_DUMP_MAX)
+	max_cnt = GRP_LOCK_DUMP_MAX;
+
+    /* Keep the group locks sorted by total wait time. The statistics are
+     * read without the group locks' mutexes, so they are approximate.
+     */
+    pj_enter_critical_section();
+    for (node=grp_lock_all.next; node!=&grp_lock_all; node=node->next) {
+	pj_grp_lock_t *glock = node->glock;
+
+	++total;
+	for (i=cnt; i>0; --i) {
+	    if (top[i-1].stat.total_wait_usec >= glock->stat.total_wait_usec)
+		break;
+	    if (i < max_cnt)
+		top[i] = top[i-1];
+	}
+	if (i < max_cnt) {
+	    top[i].glock = glock;
+	    pj_ansi_strcpy(top[i].name, glock->name);
+	    top[i].stat = glock->stat;
+	    if (cnt < max_cnt)
+		++cnt;
+	}
+    }
+    pj_leave_critical_section();
+
+    PJ_LOG(3,(THIS_FILE, "Group lock contention (%u of %u group locks):",
+	      cnt, total));
+    for (i=0; i<cnt; ++i) {
+	PJ_LOG(3,(THIS_FILE, " %p %-16s acquired=%u contended=%u "
+		  "wait_total=%lu.%03lums wait_max=%uus",
+		  top[i].glock, top[i].name, top[i].stat.acquire_cnt,
+		  top[i].stat.contended_cnt,
+		  (unsigned long)(top[i].stat.total_wait_usec / 1000),
+		  (unsigned long)(top[i].stat.total_wait_usec % 1000),
+		  top[i].stat.max_wait_usec));
+    }
+#else
+    PJ_UNUSED_ARG(max_cnt);
+#endif
+}
@@ -19,6 +19,11 @@
  */
 #include <pj/types.h>
 #include <pj/log.h>
+#include <pj/assert.h>
+#include <pj/ctype.h>
+#include <pj/errno.h>
+#include <pj/list.h>
+#include <pj/pool.h>
 #include <pj/string.h>
 #include <pj/os.h>
 #include <pj/compat/stdarg.h>
@@ -31,6 +36,19 @@ PJ_DEF_DATA(int) pj_log_max_level = PJ_LOG_MAX_LEVEL;
 static int pj_log_max_level = PJ_LOG_MAX_LEVEL;
 #endif
 
+PJ_DEF_DATA(int) pj_log_active_level = PJ_LOG_MAX_LEVEL;
+PJ_DEF_DATA(unsigned) pj_log_sender_level_cnt;
+
+#if PJ_LOG_MAX_SENDER_LEVELS
+/* Log level of the senders whose name starts with the prefix */
+static struct sender_level
+{
+    char	prefix[PJ_MAX_OBJ_NAME];
+    pj_size_t	len;
+    int		level;
+} sender_levels[PJ_LOG_MAX_SENDER_LEVELS];
+#endif
+
 static void *g_last_thread;
 
 #if PJ_HAS_THREADS
@@ -84,6 +102,9 @@ static char log_buffer[PJ_LOG_MAX_SIZE];
 
 #define LOG_MAX_INDENT		80
 
+/* Asynchronous logging needs a thread and lock-free ring buffers */
+#define LOG_HAS_ASYNC		(PJ_HAS_THREADS && PJ_HAS_ATOMIC_BUILTINS)
+
 #if PJ_HAS_THREADS
 static void logging_shutdown(void)
 {
@@ -230,9 +251,25 @@ PJ_DEF(pj_color_t) pj_log_get_color(int level)
     }
 }
 
+/* Update the level that PJ_LOG checks first */
+static void update_active_level(void)
+{
+    int level = pj_log_max_level;
+#if PJ_LOG_MAX_SENDER_LEVELS
+    unsigned i;
+
+    for (i=0; i<pj_log_sender_level_cnt; ++i) {
+	if (sender_levels[i].level > level)
+	    level = sender_levels[i].level;
+    }
+#endif
+    pj_log_active_level = level;
+}
+
 PJ_DEF(void) pj_log_set_level(int level)
 {
     pj_log_max_level = level;
+    update_active_level();
 }
 
 #if 1
@@ -242,6 +279,79 @@ PJ_DEF(int) pj_log_get_level(void)
 }
 #endif
 
+PJ_DEF(pj_status_t) pj_log_set_sender_level(const char *prefix, int level)
+{
+#if PJ_LOG_MAX_SENDER_LEVELS
+    pj_size_t len;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(prefix && *prefix, PJ_EINVAL);
+
+    len = pj_ansi_strlen(prefix);
+    PJ_ASSERT_RETURN(len < PJ_MAX_OBJ_NAME, PJ_ENAMETOOLONG);
+
+    for (i=0; i<pj_log_sender_level_cnt; ++i) {
+	if (sender_levels[i].len == len &&
+	    pj_memcmp(sender_levels[i].prefix, prefix, len) == 0)
+	{
+	    break;
+	}
+    }
+
+    if (level < 0) {
+	/* Remove */
+	if (i == pj_log_sender_level_cnt)
+	    return PJ_ENOTFOUND;
+	sender_levels[i] = sender_levels[pj_log_sender_level_cnt-1];
+	--pj_log_sender_level_cnt;
+    } else if (i < pj_log_sender_level_cnt) {
+	sender_levels[i].level = level;
+    } else {
+	if (pj_log_sender_level_cnt == PJ_LOG_MAX_SENDER_LEVELS)
+	    return PJ_ETOOMANY;
+	pj_memcpy(sender_levels[i].prefix, prefix, len + 1);
+	sender_levels[i].len = len;
+	sender_levels[i].level = level;
+	++pj_log_sender_level_cnt;
+    }
+
+    update_active_level();
+    return PJ_SUCCESS;
+#else
+    PJ_UNUSED_ARG(prefix);
+    PJ_UNUSED_ARG(level);
+    return PJ_ENOTSUP;
+#endif
+}
+
+PJ_DEF(int) pj_log_get_sender_level(const char *sender)
+{
+    int level = pj_log_max_level;
+#if PJ_LOG_MAX_SENDER_LEVELS
+    pj_size_t best_len = 0;
+    unsigned i;
+
+    for (i=0; i<pj_log_sender_level_cnt; ++i) {
+	const struct sender_level *sl = &sender_levels[i];
+
+	if (sl->len > best_len &&
+	    pj_ansi_strncmp(sender, sl->prefix, sl->len) == 0)
+	{
+	    level = sl->level;
+	    best_len = sl->len;
+	}
+    }
+#else
+    PJ_UNUSED_ARG(sender);
+#endif
+    return level;
+}
+
+PJ_DEF(pj_bool_t) pj_log_sender_enabled(const char *sender, int level)
+{
+    return level <= pj_log_get_sender_level(sender);
+}
+
 PJ_DEF(void) pj_log_set_log_func( pj_log_func *func )
 {
     log_writer = func;
@@ -312,34 +422,17 @@ static pj_bool_t is_logging_suspended(void)
     }
 }
 
-PJ_DEF(void) pj_log( const char *sender, int level, 
-		     const char *format, va_list marker)
+/* Print the decoration before the message according to log_decor, and
+ * return the length.
+ */
+static int log_print_prefix(char *log_buffer, const char *sender, int level,
+			    const pj_time_val *now, const char *thread_name,
+			    pj_bool_t thread_switched, int indent)
 {
-    pj_time_val now;
     pj_parsed_time ptime;
     char *pre;
-#if PJ_LOG_USE_STACK_BUFFER
-    char log_buffer[PJ_LOG_MAX_SIZE];
-#endif
-    int saved_level, len, print_len, indent;
-
-    PJ_CHECK_STACK();
-
-    if (level > pj_log_max_level)
-	return;
-
-    if (is_logging_suspended())
-	return;
-
-    /* Temporarily disable logging for this thread. Some of PJLIB APIs that
-     * this function calls below will recursively call the logging function 
-     * back, hence it will cause infinite recursive calls if we allow that.
-     */
-    suspend_logging(&saved_level);
 
-    /* Get current date/time. */
-    pj_gettimeofday(&now);
-    pj_time_decode(&now, &ptime);
+    pj_time_decode(now, &ptime);
 
     pre = log_buffer;
     if (log_decor & PJ_LOG_HAS_LEVEL_TEXT) {
@@ -395,7 +488,6 @@ PJ_DEF(void) pj_log( const char *sender, int level,
     }
     if (log_decor & PJ_LOG_HAS_THREAD_ID) {
 	enum { THREAD_WIDTH = 12 };
-	const char *thread_name = pj_thread_get_name(pj_thread_this());
 	pj_size_t thread_len = strlen(thread_name);
 	*pre++ = ' ';
 	if (thread_len <= THREAD_WIDTH) {
@@ -414,42 +506,35 @@ PJ_DEF(void) pj_log( const char *sender, int level,
 	*pre++ = ' ';
 
     if (log_decor & PJ_LOG_HAS_THREAD_SWC) {
-	void *current_thread = (void*)pj_thread_this();
-	if (current_thread != g_last_thread) {
-	    *pre++ = '!';
-	    g_last_thread = current_thread;
-	} else {
-	    *pre++ = ' ';
-	}
+	*pre++ = thread_switched ? '!' : ' ';
     } else if (log_decor & PJ_LOG_HAS_SPACE) {
 	*pre++ = ' ';
     }
 
 #if PJ_LOG_ENABLE_INDENT
     if (log_decor & PJ_LOG_HAS_INDENT) {
-	indent = log_get_indent();
 	if (indent > 0) {
 	    pj_memset(pre, PJ_LOG_INDENT_CHAR, indent);
 	    pre += indent;
 	}
     }
+#else
+    PJ_UNUSED_ARG(indent);
 #endif
 
-    len = (int)(pre - log_buffer);
+    return (int)(pre - log_buffer);
+}
 
-    /* Print the whole message to the string log_buffer. */
-    print_len = pj_ansi_vsnprintf(pre, sizeof(log_buffer)-len, format, 
-				  marker);
-    if (print_len < 0) {
-	level = 1;
-	print_len = pj_ansi_snprintf(pre, sizeof(log_buffer)-len, 
-				     "<logging error: msg too long>");
-    }
-    if (print_len < 1 || print_len >= (int)(sizeof(log_buffer)-len)) {
-	print_len = sizeof(log_buffer) - len - 1;
+/* Add the line termination after the message that was printed after the
+ * prefix of length len, and return the total length.
+ */
+static int log_terminate(char *log_buffer, int len, int print_len)
+{
+    if (print_len < 1 || print_len >= (int)(PJ_LOG_MAX_SIZE-len)) {
+	print_len = PJ_LOG_MAX_SIZE - len - 1;
     }
     len = len + print_len;
-    if (len > 0 && len < (int)sizeof(log_buffer)-2) {
+    if (len > 0 && len < (int)PJ_LOG_MAX_SIZE-2) {
 	if (log_decor & PJ_LOG_HAS_CR) {
 	    log_buffer[len++] = '\r';
 	}
@@ -458,16 +543,1290 @@ PJ_DEF(void) pj_log( const char *sender, int level,
 	}
 	log_buffer[len] = '\0';
     } else {
-	len = sizeof(log_buffer)-1;
+	len = PJ_LOG_MAX_SIZE-1;
 	if (log_decor & PJ_LOG_HAS_CR) {
-	    log_buffer[sizeof(log_buffer)-3] = '\r';
+	    log_buffer[PJ_LOG_MAX_SIZE-3] = '\r';
 	}
 	if (log_decor & PJ_LOG_HAS_NEWLINE) {
-	    log_buffer[sizeof(log_buffer)-2] = '\n';
+	    log_buffer[PJ_LOG_MAX_SIZE-2] = '\n';
+	}
+	log_buffer[PJ_LOG_MAX_SIZE-1] = '\0';
+    }
+
+    return len;
+}
+
+/* Get the thread switch mark, and remember the calling thread. */
+static pj_bool_t log_thread_switched(void)
+{
+    void *current_thread = (void*)pj_thread_this();
+
+    if (current_thread != g_last_thread) {
+	g_last_thread = current_thread;
+	return PJ_TRUE;
+    }
+    return PJ_FALSE;
+}
+
+/* Check the message level against the global and per-sender levels */
+static pj_bool_t log_level_enabled(const char *sender, int level)
+{
+    if (level > pj_log_active_level)
+	return PJ_FALSE;
+    if (pj_log_sender_level_cnt == 0)
+	return level <= pj_log_max_level;
+    return level <= pj_log_get_sender_level(sender);
+}
+
+#if LOG_HAS_ASYNC
+
+/* Maximum number of messages to write before the log thread releases the
+ * write mutex, so that other threads can flush the log.
+ */
+#define LOG_ASYNC_BATCH		64
+
+/* Message record in the ring buffer, followed by the NULL terminated
+ * message, or by the binary record (see log_bin). Records are aligned to
+ * the header size, hence the header of the next record always fits
+ * before the end of the buffer.
+ */
+typedef struct log_rec
+{
+    pj_uint32_t	    len;	/* Message length, or LOG_REC_WRAP	    */
+    pj_uint32_t	    seq;	/* Sequence number across all threads	    */
+    pj_int32_t	    level;
+    pj_uint32_t	    type;	/* LOG_REC_TEXT or LOG_REC_BIN		    */
+} log_rec;
+
+/* Record types */
+#define LOG_REC_TEXT		0
+#define LOG_REC_BIN		1
+
+/* Marks the rest of the buffer as unused, the next record is at the start
+ * of the buffer.
+ */
+#define LOG_REC_WRAP		0xFFFFFFFF
+
+#define LOG_REC_SIZE(len)	(((pj_uint32_t)sizeof(log_rec) + (len) + 1 + \
+				  (pj_uint32_t)sizeof(log_rec) - 1) & \
+				 ~((pj_uint32_t)sizeof(log_rec) - 1))
+
+/* Ring buffer of a thread. Only the owner thread writes records, and only
+ * the thread holding log_async.write_mutex reads them. The head and tail
+ * are free running byte counters.
+ *
+ * The owner claims the ring with the busy flag while writing a record.
+ * The reader frees the buffer of a ring which has been empty and unused
+ * for PJ_LOG_ASYNC_RING_IDLE msec, e.g. because its thread has exited,
+ * and keeps the ring header for reuse by another thread. The owner then
+ * fails to claim the ring and gets a new one.
+ */
+typedef struct log_ring
+{
+    PJ_DECL_LIST_MEMBER(struct log_ring);
+    char	   *buf;
+    pj_uint32_t	    size;
+    pj_uint32_t	    head;	    /* Updated by the owner thread	    */
+    pj_uint32_t	    tail;	    /* Updated by the reader		    */
+    pj_uint32_t	    dropped;	    /* Updated by the owner thread	    */
+    pj_uint32_t	    reported;	    /* Dropped count already reported	    */
+    int		    busy;	    /* Claimed by the owner, or RING_FREE   */
+    int		    active;	    /* Used since the last sweep	    */
+    pj_thread_t	   *owner;
+} log_ring;
+
+/* Value of the busy flag of a ring which has no buffer */
+#define RING_FREE		2
+
+static struct log_async
+{
+    int		    enabled;	    /* Producers may use the ring buffers   */
+    int		    busy;	    /* Number of producers in the rings	    */
+    int		    sleeping;	    /* Log thread is waiting for messages   */
+    pj_bool_t	    quit;
+    pj_uint32_t	    seq;
+    pj_bool_t	    atexit_registered;
+    int		    binary;	    /* Binary record mode		    */
+
+    pj_caching_pool cp;
+    pj_pool_t	   *pool;
+    pj_mutex_t	   *mutex;	    /* Protects the ring lists		    */
+    pj_mutex_t	   *write_mutex;    /* Held by the reader and log writer    */
+    pj_sem_t	   *sem;
+    pj_thread_t	   *thread;
+    long	    ring_tls;
+    pj_uint32_t	    ring_size;
+    pj_uint32_t	    written_cnt;
+    pj_uint32_t	    binary_cnt;
+
+    /* Protected by mutex */
+    log_ring	    ring_list;
+    log_ring	    free_ring_list;
+    unsigned	    ring_cnt;
+    pj_uint32_t	    freed_dropped;  /* Dropped count of the freed rings	    */
+
+    /* Protected by write_mutex */
+    pj_bool_t	    draining;
+    pj_time_val	    next_sweep;
+    char	    bin_buf[PJ_LOG_MAX_SIZE];
+} log_async;
+
+/* Claim the ring buffer for writing a record. */
+static pj_bool_t log_async_claim_ring(log_ring *ring, pj_thread_t *self)
+{
+    int idle = 0;
+
+    if (!__atomic_compare_exchange_n(&ring->busy, &idle, 1, PJ_FALSE,
+				     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+	return PJ_FALSE;
+    }
+
+    /* The ring may have been freed and given to another thread */
+    if (ring->owner != self) {
+	__atomic_store_n(&ring->busy, 0, __ATOMIC_RELEASE);
+	return PJ_FALSE;
+    }
+
+    __atomic_store_n(&ring->active, 1, __ATOMIC_RELAXED);
+    return PJ_TRUE;
+}
+
+/* Get and claim the ring buffer of the calling thread, creating it if
+ * necessary. Returns NULL if the buffer can't be allocated.
+ */
+static log_ring *log_async_get_ring(void)
+{
+    pj_thread_t *self = pj_thread_this();
+    pj_pool_factory *pf = &log_async.cp.factory;
+    log_ring *ring;
+
+    ring = (log_ring*) pj_thread_local_get(log_async.ring_tls);
+    if (ring && log_async_claim_ring(ring, self))
+	return ring;
+
+    pj_mutex_lock(log_async.mutex);
+    if (!pj_list_empty(&log_async.free_ring_list)) {
+	ring = log_async.free_ring_list.next;
+	pj_list_erase(ring);
+    } else {
+	ring = PJ_POOL_ZALLOC_T(log_async.pool, log_ring);
+	ring->busy = RING_FREE;
+    }
+
+    ring->buf = (char*) (*pf->policy.block_alloc)(pf, log_async.ring_size);
+    if (!ring->buf) {
+	pj_list_push_back(&log_async.free_ring_list, ring);
+	pj_mutex_unlock(log_async.mutex);
+	return NULL;
+    }
+
+    /* The ring is claimed until the first record is written */
+    ring->size = log_async.ring_size;
+    ring->head = ring->tail = 0;
+    ring->dropped = ring->reported = 0;
+    ring->active = 1;
+    ring->owner = self;
+    __atomic_store_n(&ring->busy, 1, __ATOMIC_RELEASE);
+    pj_list_push_back(&log_async.ring_list, ring);
+    ++log_async.ring_cnt;
+    pj_mutex_unlock(log_async.mutex);
+
+    pj_thread_local_set(log_async.ring_tls, ring);
+    return ring;
+}
+
+/* Put the record in the ring buffer of the calling thread. */
+static void log_async_push(unsigned type, int level, const char *data,
+			   int len)
+{
+    log_ring *ring = log_async_get_ring();
+    pj_uint32_t head, tail, need, offset, skip = 0;
+    log_rec *rec;
+
+    if (!ring)
+	return;
+
+    need = LOG_REC_SIZE(len);
+    head = ring->head;
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    offset = head & (ring->size - 1);
+
+    /* The record must be contiguous */
+    if (ring->size - offset < need)
+	skip = ring->size - offset;
+
+    if (ring->size - (head - tail) < skip + need) {
+	__atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&ring->busy, 0, __ATOMIC_RELEASE);
+	return;
+    }
+
+    if (skip) {
+	rec = (log_rec*) (ring->buf + offset);
+	rec->len = LOG_REC_WRAP;
+	head += skip;
+	offset = 0;
+    }
+
+    rec = (log_rec*) (ring->buf + offset);
+    rec->len = len;
+    rec->level = level;
+    rec->type = type;
+    rec->seq = __atomic_fetch_add(&log_async.seq, 1, __ATOMIC_RELAXED);
+    pj_memcpy(rec + 1, data, len);
+    ((char*)(rec + 1))[len] = '\0';
+
+    /* Publish the record, then wake up the log thread if it is (about
+     * to be) waiting. Both are sequentially consistent, so either the log
+     * thread sees the record or we see it sleeping.
+     */
+    __atomic_store_n(&ring->head, head + need, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ring->busy, 0, __ATOMIC_RELEASE);
+    if (__atomic_load_n(&log_async.sleeping, __ATOMIC_SEQ_CST) &&
+	__atomic_exchange_n(&log_async.sleeping, 0, __ATOMIC_SEQ_CST))
+    {
+	pj_sem_post(log_async.sem);
+    }
+}
+
+/* Get the oldest record in the ring buffer, or NULL if it's empty. */
+static log_rec *log_async_peek(log_ring *ring)
+{
+    pj_uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+    log_rec *rec;
+
+    if (ring->tail == head)
+	return NULL;
+
+    rec = (log_rec*) (ring->buf + (ring->tail & (ring->size - 1)));
+    if (rec->len == LOG_REC_WRAP) {
+	pj_uint32_t skip = ring->size - (ring->tail & (ring->size - 1));
+	__atomic_store_n(&ring->tail, ring->tail + skip, __ATOMIC_RELEASE);
+	rec = (log_rec*) ring->buf;
+    }
+
+    return rec;
+}
+
+/* Report messages that were dropped since the last report. */
+static void log_async_report_dropped(void)
+{
+    log_ring *ring;
+    pj_uint32_t dropped = 0;
+
+    pj_mutex_lock(log_async.mutex);
+    for (ring=log_async.ring_list.next; ring!=&log_async.ring_list;
+	 ring=ring->next)
+    {
+	pj_uint32_t cnt = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+	dropped += cnt - ring->reported;
+	ring->reported = cnt;
+    }
+    pj_mutex_unlock(log_async.mutex);
+
+    if (dropped && log_writer) {
+	char msg[80];
+	int len;
+
+	len = pj_ansi_snprintf(msg, sizeof(msg),
+			       "log.c: %u log message(s) dropped, "
+			       "async log buffer full%s",
+			       dropped,
+			       (log_decor & PJ_LOG_HAS_NEWLINE) ? "\n" : "");
+	(*log_writer)(2, msg, len);
+    }
+}
+
+/* Free the buffers of the rings which are empty and have not been used
+ * since the previous sweep. Write mutex must be held.
+ */
+static void log_async_sweep_rings(void)
+{
+    pj_uint32_t size = log_async.ring_size;
+    pj_pool_factory *pf = &log_async.cp.factory;
+    log_ring *ring, *next;
+    pj_time_val now;
+
+    pj_gettickcount(&now);
+    if (PJ_TIME_VAL_LT(now, log_async.next_sweep))
+	return;
+
+    log_async.next_sweep = now;
+    log_async.next_sweep.msec += PJ_LOG_ASYNC_RING_IDLE;
+    pj_time_val_normalize(&log_async.next_sweep);
+
+    pj_mutex_lock(log_async.mutex);
+    for (ring=log_async.ring_list.next; ring!=&log_async.ring_list;
+	 ring=next)
+    {
+	int idle = 0;
+
+	next = ring->next;
+	if (__atomic_exchange_n(&ring->active, 0, __ATOMIC_RELAXED) ||
+	    !__atomic_compare_exchange_n(&ring->busy, &idle, RING_FREE,
+					 PJ_FALSE, __ATOMIC_ACQUIRE,
+					 __ATOMIC_RELAXED))
+	{
+	    continue;
+	}
+
+	/* The owner may have written a record before the ring was taken */
+	if (ring->tail != ring->head) {
+	    __atomic_store_n(&ring->busy, 0, __ATOMIC_RELEASE);
+	    continue;
+	}
+
+	log_async.freed_dropped += ring->dropped;
+	(*pf->policy.block_free)(pf, ring->buf, size);
+	ring->buf = NULL;
+	pj_list_erase(ring);
+	pj_list_push_back(&log_async.free_ring_list, ring);
+	--log_async.ring_cnt;
+    }
+    pj_mutex_unlock(log_async.mutex);
+}
+
+/* Header of the binary record, followed by the arguments of the message.
+ * Integer, floating point and pointer arguments take LOG_BIN_SLOT bytes
+ * each. String arguments are stored as 32bit length followed by the NULL
+ * terminated string, padded to LOG_BIN_SLOT.
+ */
+typedef struct log_bin
+{
+    pj_time_val	    now;
+    const char	   *format;
+    int		    indent;
+    pj_bool_t	    thread_switched;
+    char	    sender[PJ_MAX_OBJ_NAME];
+    char	    thread_name[PJ_MAX_OBJ_NAME];
+} log_bin;
+
+#define LOG_BIN_SLOT		8
+#define LOG_BIN_PAD(len)	(((len) + LOG_BIN_SLOT - 1) & ~(LOG_BIN_SLOT-1))
+
+/* Longest conversion specification that can be recorded */
+#define LOG_BIN_MAX_SPEC	32
+
+#ifndef va_copy
+#   define va_copy(dst, src)	__va_copy(dst, src)
+#endif
+
+enum log_mod
+{
+    LOG_MOD_NONE,
+    LOG_MOD_HH,
+    LOG_MOD_H,
+    LOG_MOD_L,
+    LOG_MOD_LL,
+    LOG_MOD_Z,
+    LOG_MOD_J,
+    LOG_MOD_T,
+    LOG_MOD_LD
+};
+
+/* Conversion specification of the format string */
+typedef struct log_spec
+{
+    const char	   *flags;	/* After the '%'			    */
+    const char	   *width;	/* Width, or end of the flags		    */
+    const char	   *prec;	/* Precision with '.', or end of the width  */
+    const char	   *end;	/* After the conversion			    */
+    enum log_mod    mod;
+    char	    conv;
+} log_spec;
+
+/* Parse the conversion specification starting at the '%'. Returns the
+ * position after the specification, or NULL if the format is truncated.
+ */
+static const char *log_parse_spec(const char *p, log_spec *spec)
+{
+    spec->flags = ++p;
+    while (*p && strchr("-+ #0'", *p))
+	++p;
+
+    spec->width = p;
+    if (*p == '*') {
+	++p;
+    } else {
+	while (pj_isdigit(*p))
+	    ++p;
+    }
+
+    spec->prec = p;
+    if (*p == '.') {
+	++p;
+	if (*p == '*') {
+	    ++p;
+	} else {
+	    while (pj_isdigit(*p))
+		++p;
+	}
+    }
+
+    switch (*p) {
+    case 'h':
+	if (p[1] == 'h') {
+	    spec->mod = LOG_MOD_HH;
+	    ++p;
+	} else {
+	    spec->mod = LOG_MOD_H;
+	}
+	++p;
+	break;
+    case 'l':
+	if (p[1] == 'l') {
+	    spec->mod = LOG_MOD_LL;
+	    ++p;
+	} else {
+	    spec->mod = LOG_MOD_L;
+	}
+	++p;
+	break;
+    case 'q':
+	spec->mod = LOG_MOD_LL;
+	++p;
+	break;
+    case 'z':
+	spec->mod = LOG_MOD_Z;
+	++p;
+	break;
+    case 'j':
+	spec->mod = LOG_MOD_J;
+	++p;
+	break;
+    case 't':
+	spec->mod = LOG_MOD_T;
+	++p;
+	break;
+    case 'L':
+	spec->mod = LOG_MOD_LD;
+	++p;
+	break;
+    default:
+	spec->mod = LOG_MOD_NONE;
+	break;
+    }
+
+    if (*p == '\0')
+	return NULL;
+
+    spec->conv = *p;
+    spec->end = p + 1;
+    return spec->end;
+}
+
+/* Append the argument slot to the binary record. */
+static pj_bool_t log_bin_put(char *buf, int size, int *pos,
+			     const void *data, int len)
+{
+    if (*pos + LOG_BIN_PAD(len) > size)
+	return PJ_FALSE;
+    pj_memcpy(buf + *pos, data, len);
+    *pos += LOG_BIN_PAD(len);
+    return PJ_TRUE;
+}
+
+/* Record the arguments of the message. Returns the length of the
+ * arguments, or -1 if the message can't be recorded.
+ */
+static int log_bin_encode(char *buf, int size, const char *format,
+			  va_list marker)
+{
+    const char *p = format;
+    va_list arg;
+    int pos = 0;
+    pj_bool_t ok = PJ_TRUE;
+
+    va_copy(arg, marker);
+
+    while (ok && (p = strchr(p, '%')) != NULL) {
+	const char *start = p;
+	log_spec spec;
+	pj_int64_t ival;
+	pj_uint64_t uval;
+	double dval;
+	void *pval;
+	int prec = -1;
+
+	p = log_parse_spec(p, &spec);
+	if (!p || p - start > LOG_BIN_MAX_SPEC) {
+	    ok = PJ_FALSE;
+	    break;
+	}
+
+	if (spec.conv == '%')
+	    continue;
+
+	if (*spec.width == '*') {
+	    ival = va_arg(arg, int);
+	    ok = log_bin_put(buf, size, &pos, &ival, sizeof(ival));
+	}
+	if (ok && spec.prec[0] == '.' && spec.prec[1] == '*') {
+	    prec = va_arg(arg, int);
+	    ival = prec;
+	    ok = log_bin_put(buf, size, &pos, &ival, sizeof(ival));
+	} else if (spec.prec[0] == '.') {
+	    const char *d;
+	    for (prec=0, d=spec.prec+1; pj_isdigit(*d); ++d)
+		prec = prec * 10 + (*d - '0');
+	}
+	if (!ok)
+	    break;
+
+	switch (spec.conv) {
+	case 'd':
+	case 'i':
+	    switch (spec.mod) {
+	    case LOG_MOD_HH:
+		ival = (signed char) va_arg(arg, int);
+		break;
+	    case LOG_MOD_H:
+		ival = (short) va_arg(arg, int);
+		break;
+	    case LOG_MOD_L:
+		ival = va_arg(arg, long);
+		break;
+	    case LOG_MOD_LL:
+	    case LOG_MOD_J:
+		ival = va_arg(arg, pj_int64_t);
+		break;
+	    case LOG_MOD_Z:
+	    case LOG_MOD_T:
+		ival = va_arg(arg, pj_ssize_t);
+		break;
+	    case LOG_MOD_NONE:
+		ival = va_arg(arg, int);
+		break;
+	    default:
+		ok = PJ_FALSE;
+		continue;
+	    }
+	    ok = log_bin_put(buf, size, &pos, &ival, sizeof(ival));
+	    break;
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+	    switch (spec.mod) {
+	    case LOG_MOD_HH:
+		uval = (unsigned char) va_arg(arg, unsigned);
+		break;
+	    case LOG_MOD_H:
+		uval = (unsigned short) va_arg(arg, unsigned);
+		break;
+	    case LOG_MOD_L:
+		uval = va_arg(arg, unsigned long);
+		break;
+	    case LOG_MOD_LL:
+	    case LOG_MOD_J:
+		uval = va_arg(arg, pj_uint64_t);
+		break;
+	    case LOG_MOD_Z:
+	    case LOG_MOD_T:
+		uval = va_arg(arg, pj_size_t);
+		break;
+	    case LOG_MOD_NONE:
+		uval = va_arg(arg, unsigned);
+		break;
+	    default:
+		ok = PJ_FALSE;
+		continue;
+	    }
+	    ok = log_bin_put(buf, size, &pos, &uval, sizeof(uval));
+	    break;
+	case 'c':
+	    if (spec.mod != LOG_MOD_NONE) {
+		ok = PJ_FALSE;
+		break;
+	    }
+	    ival = va_arg(arg, int);
+	    ok = log_bin_put(buf, size, &pos, &ival, sizeof(ival));
+	    break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+	    if (spec.mod != LOG_MOD_NONE && spec.mod != LOG_MOD_L) {
+		ok = PJ_FALSE;
+		break;
+	    }
+	    dval = va_arg(arg, double);
+	    ok = log_bin_put(buf, size, &pos, &dval, sizeof(dval));
+	    break;
+	case 'p':
+	    pval = va_arg(arg, void*);
+	    ok = log_bin_put(buf, size, &pos, &pval, sizeof(pval));
+	    break;
+	case 's':
+	    if (spec.mod != LOG_MOD_NONE) {
+		ok = PJ_FALSE;
+	    } else {
+		const char *str = va_arg(arg, const char*);
+		pj_uint32_t len;
+
+		if (!str)
+		    str = "(null)";
+		if (prec >= 0) {
+		    const char *nul = (const char*) memchr(str, 0, prec);
+		    len = nul ? (pj_uint32_t)(nul - str) : (pj_uint32_t)prec;
+		} else {
+		    len = (pj_uint32_t)strlen(str);
+		}
+
+		if (pos + LOG_BIN_PAD(sizeof(len) + len + 1) > size) {
+		    ok = PJ_FALSE;
+		} else {
+		    pj_memcpy(buf + pos, &len, sizeof(len));
+		    pj_memcpy(buf + pos + sizeof(len), str, len);
+		    buf[pos + sizeof(len) + len] = '\0';
+		    pos += LOG_BIN_PAD(sizeof(len) + len + 1);
+		}
+	    }
+	    break;
+	default:
+	    /* %n, or unknown conversion */
+	    ok = PJ_FALSE;
+	    break;
+	}
+    }
+
+    va_end(arg);
+
+    return ok ? pos : -1;
+}
+
+/* Get the argument slot from the binary record. */
+static void log_bin_get(const char **args, void *data, int len)
+{
+    pj_memcpy(data, *args, len);
+    *args += LOG_BIN_PAD(len);
+}
+
+/* Format the message from the binary record. Returns the length of the
+ * message, which may be larger than the buffer like vsnprintf().
+ */
+static int log_bin_format(char *buf, int size, const char *format,
+			  const char *args)
+{
+    const char *p = format;
+    int pos = 0;
+
+    while (*p && pos < size) {
+	const char *pct = strchr(p, '%');
+	char fmt[LOG_BIN_MAX_SPEC + 32], *f;
+	log_spec spec;
+	pj_int64_t ival;
+	int n = -1;
+
+	if (!pct)
+	    pct = p + strlen(p);
+
+	if (pct != p) {
+	    n = (int)(pct - p);
+	    if (pos + n < size) {
+		pj_memcpy(buf + pos, p, n);
+		buf[pos + n] = '\0';
+	    } else {
+		pj_memcpy(buf + pos, p, size - pos - 1);
+		buf[size - 1] = '\0';
+	    }
+	    pos += n;
+	    p = pct;
+	    continue;
+	}
+
+	/* The format was checked when the record was made */
+	p = log_parse_spec(pct, &spec);
+
+	/* Rebuild the specification, with the width and precision from the
+	 * arguments and the length modifier of the recorded type.
+	 */
+	f = fmt;
+	*f++ = '%';
+	pj_memcpy(f, spec.flags, spec.width - spec.flags);
+	f += spec.width - spec.flags;
+	if (*spec.width == '*') {
+	    log_bin_get(&args, &ival, sizeof(ival));
+	    f += pj_ansi_sprintf(f, "%d", (int)ival);
+	} else {
+	    pj_memcpy(f, spec.width, spec.prec - spec.width);
+	    f += spec.prec - spec.width;
+	}
+	if (spec.prec[0] == '.' && spec.prec[1] == '*') {
+	    /* Negative precision is taken as if it were omitted */
+	    log_bin_get(&args, &ival, sizeof(ival));
+	    if (ival >= 0)
+		f += pj_ansi_sprintf(f, ".%d", (int)ival);
+	} else if (spec.prec[0] == '.') {
+	    const char *prec_end = spec.prec + 1;
+	    while (pj_isdigit(*prec_end))
+		++prec_end;
+	    pj_memcpy(f, spec.prec, prec_end - spec.prec);
+	    f += prec_end - spec.prec;
+	}
+
+	switch (spec.conv) {
+	case '%':
+	    n = pj_ansi_snprintf(buf + pos, size - pos, "%%");
+	    break;
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+	    log_bin_get(&args, &ival, sizeof(ival));
+	    *f++ = 'l';
+	    *f++ = 'l';
+	    *f++ = spec.conv;
+	    *f = '\0';
+	    if (spec.conv == 'd' || spec.conv == 'i')
+		n = pj_ansi_snprintf(buf + pos, size - pos, fmt,
+				     (long long)ival);
+	    else
+		n = pj_ansi_snprintf(buf + pos, size - pos, fmt,
+				     (unsigned long long)ival);
+	    break;
+	case 'c':
+	    log_bin_get(&args, &ival, sizeof(ival));
+	    *f++ = spec.conv;
+	    *f = '\0';
+	    n = pj_ansi_snprintf(buf + pos, size - pos, fmt, (int)ival);
+	    break;
+	case 'p':
+	    {
+		void *pval;
+		log_bin_get(&args, &pval, sizeof(pval));
+		*f++ = spec.conv;
+		*f = '\0';
+		n = pj_ansi_snprintf(buf + pos, size - pos, fmt, pval);
+	    }
+	    break;
+	case 's':
+	    {
+		pj_uint32_t len;
+		pj_memcpy(&len, args, sizeof(len));
+		*f++ = spec.conv;
+		*f = '\0';
+		n = pj_ansi_snprintf(buf + pos, size - pos, fmt,
+				     args + sizeof(len));
+		args += LOG_BIN_PAD(sizeof(len) + len + 1);
+	    }
+	    break;
+	default:
+	    {
+		double dval;
+		log_bin_get(&args, &dval, sizeof(dval));
+		*f++ = spec.conv;
+		*f = '\0';
+		n = pj_ansi_snprintf(buf + pos, size - pos, fmt, dval);
+	    }
+	    break;
+	}
+
+	if (n < 0)
+	    return -1;
+	pos += n;
+    }
+
+    return pos;
+}
+
+/* Format and write the binary record. Mutex must be held. */
+static void log_bin_write(const log_rec *rec)
+{
+    char *buf = log_async.bin_buf;
+    log_bin bin;
+    int len, print_len;
+
+    pj_memcpy(&bin, rec + 1, sizeof(bin));
+
+    len = log_print_prefix(buf, bin.sender, rec->level, &bin.now,
+			   bin.thread_name, bin.thread_switched, bin.indent);
+    print_len = log_bin_format(buf + len, PJ_LOG_MAX_SIZE - len, bin.format,
+			       (const char*)(rec + 1) + sizeof(bin));
+    if (print_len < 0) {
+	print_len = pj_ansi_snprintf(buf + len, PJ_LOG_MAX_SIZE - len,
+				     "<logging error: msg too long>");
+    }
+    len = log_terminate(buf, len, print_len);
+
+    __atomic_add_fetch(&log_async.binary_cnt, 1, __ATOMIC_RELAXED);
+    if (log_writer)
+	(*log_writer)(rec->level, buf, len);
+}
+
+/* Write up to max_cnt pending messages to the log writer, oldest first.
+ * Write mutex must be held, the ring list mutex is only held to pick the
+ * next message. Returns the number of messages written.
+ */
+static unsigned log_async_drain(unsigned max_cnt)
+{
+    unsigned cnt = 0;
+
+    /* The log writer may log and flush recursively */
+    if (log_async.draining)
+	return 0;
+    log_async.draining = PJ_TRUE;
+
+    log_async_report_dropped();
+    log_async_sweep_rings();
+
+    while (cnt < max_cnt) {
+	log_ring *ring, *oldest = NULL;
+	log_rec *rec, *oldest_rec = NULL;
+
+	/* Only this thread frees the rings, so the record stays valid
+	 * after the mutex is released.
+	 */
+	pj_mutex_lock(log_async.mutex);
+	for (ring=log_async.ring_list.next; ring!=&log_async.ring_list;
+	     ring=ring->next)
+	{
+	    rec = log_async_peek(ring);
+	    if (rec && (!oldest_rec ||
+			(pj_int32_t)(rec->seq - oldest_rec->seq) < 0))
+	    {
+		oldest = ring;
+		oldest_rec = rec;
+	    }
+	}
+	pj_mutex_unlock(log_async.mutex);
+
+	if (!oldest)
+	    break;
+
+	if (oldest_rec->type == LOG_REC_BIN) {
+	    log_bin_write(oldest_rec);
+	} else if (log_writer) {
+	    (*log_writer)(oldest_rec->level, (const char*)(oldest_rec + 1),
+			  oldest_rec->len);
 	}
-	log_buffer[sizeof(log_buffer)-1] = '\0';
+	__atomic_store_n(&oldest->tail,
+			 oldest->tail + LOG_REC_SIZE(oldest_rec->len),
+			 __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&log_async.written_cnt, 1, __ATOMIC_RELAXED);
+	++cnt;
+    }
+
+    log_async.draining = PJ_FALSE;
+    return cnt;
+}
+
+static int log_async_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    /* The log thread doesn't log, otherwise its own messages (e.g. from
+     * the semaphore) would keep waking it up.
+     */
+    if (thread_suspended_tls_id != -1)
+	pj_thread_local_set(thread_suspended_tls_id, (void*)(pj_ssize_t)1);
+
+    while (!log_async.quit) {
+	unsigned cnt;
+
+	pj_mutex_lock(log_async.write_mutex);
+	cnt = log_async_drain(LOG_ASYNC_BATCH);
+	pj_mutex_unlock(log_async.write_mutex);
+
+	if (cnt)
+	    continue;
+
+	/* Announce that we're going to sleep, then check again for records
+	 * that were published before the producers could see the flag.
+	 */
+	__atomic_store_n(&log_async.sleeping, 1, __ATOMIC_SEQ_CST);
+
+	pj_mutex_lock(log_async.write_mutex);
+	cnt = log_async_drain(LOG_ASYNC_BATCH);
+	pj_mutex_unlock(log_async.write_mutex);
+
+	if (cnt == 0 && !log_async.quit)
+	    pj_sem_wait(log_async.sem);
+
+	__atomic_store_n(&log_async.sleeping, 0, __ATOMIC_SEQ_CST);
+    }
+
+    return 0;
+}
+
+/* Pass the message to the asynchronous logging if it's running. Returns
+ * PJ_FALSE if the message should be written synchronously.
+ */
+static pj_bool_t log_async_write(int level, const char *data, int len)
+{
+    pj_bool_t written = PJ_FALSE;
+
+    __atomic_add_fetch(&log_async.busy, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&log_async.enabled, __ATOMIC_SEQ_CST)) {
+	if (level == 0) {
+	    /* Fatal error, write everything now */
+	    pj_mutex_lock(log_async.write_mutex);
+	    log_async_drain((unsigned)-1);
+	    if (log_writer)
+		(*log_writer)(level, data, len);
+	    pj_mutex_unlock(log_async.write_mutex);
+	} else {
+	    log_async_push(LOG_REC_TEXT, level, data, len);
+	}
+	written = PJ_TRUE;
+    }
+
+    __atomic_sub_fetch(&log_async.busy, 1, __ATOMIC_SEQ_CST);
+
+    return written;
+}
+
+/* Record the message in binary form if the binary record mode is enabled.
+ * Returns PJ_FALSE if the message should be formatted by the caller. The
+ * buf is used to build the record.
+ */
+static pj_bool_t log_async_write_bin(const char *sender, int level,
+				     const pj_time_val *now,
+				     const char *thread_name,
+				     pj_bool_t thread_switched, int indent,
+				     const char *format, va_list marker,
+				     char *buf)
+{
+    pj_bool_t written = PJ_FALSE;
+
+    if (!__atomic_load_n(&log_async.binary, __ATOMIC_RELAXED))
+	return PJ_FALSE;
+
+    __atomic_add_fetch(&log_async.busy, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&log_async.enabled, __ATOMIC_SEQ_CST)) {
+	log_bin bin;
+	int len;
+
+	pj_bzero(&bin, sizeof(bin));
+	bin.now = *now;
+	bin.format = format;
+	bin.indent = indent;
+	bin.thread_switched = thread_switched;
+	pj_ansi_strncpy(bin.sender, sender, sizeof(bin.sender)-1);
+	pj_ansi_strncpy(bin.thread_name, thread_name,
+			sizeof(bin.thread_name)-1);
+
+	len = log_bin_encode(buf + sizeof(bin),
+			     PJ_LOG_MAX_SIZE - (int)sizeof(bin),
+			     format, marker);
+	if (len >= 0) {
+	    pj_memcpy(buf, &bin, sizeof(bin));
+	    log_async_push(LOG_REC_BIN, level, buf, (int)sizeof(bin) + len);
+	    written = PJ_TRUE;
+	}
+    }
+
+    __atomic_sub_fetch(&log_async.busy, 1, __ATOMIC_SEQ_CST);
+
+    return written;
+}
+
+static void log_async_shutdown(void)
+{
+    pj_log_stop_async();
+    log_async.atexit_registered = PJ_FALSE;
+}
+
+PJ_DEF(pj_status_t) pj_log_start_async(unsigned ring_size)
+{
+    pj_uint32_t size;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(log_async.thread == NULL, PJ_EINVALIDOP);
+
+    if (ring_size == 0)
+	ring_size = PJ_LOG_ASYNC_RING_SIZE;
+
+    /* The ring must hold at least two messages of maximum size */
+    size = LOG_REC_SIZE(PJ_LOG_MAX_SIZE) * 2;
+    while (size < ring_size)
+	size <<= 1;
+    for (ring_size=256; ring_size < size; ring_size <<= 1)
+	;
+    log_async.ring_size = ring_size;
+
+    /* Use a private pool factory, so that the ring buffers don't depend
+     * on the lifetime of application's pool factory.
+     */
+    pj_caching_pool_init(&log_async.cp, NULL, 0);
+    log_async.pool = pj_pool_create(&log_async.cp.factory, "logasync",
+				    1024, 1024, NULL);
+    if (!log_async.pool) {
+	pj_caching_pool_destroy(&log_async.cp);
+	return PJ_ENOMEM;
     }
 
+    pj_list_init(&log_async.ring_list);
+    pj_list_init(&log_async.free_ring_list);
+    log_async.ring_cnt = 0;
+    log_async.freed_dropped = 0;
+    log_async.written_cnt = 0;
+    log_async.binary_cnt = 0;
+    log_async.next_sweep.sec = log_async.next_sweep.msec = 0;
+    log_async.quit = PJ_FALSE;
+    log_async.sleeping = 0;
+    log_async.ring_tls = -1;
+
+    status = pj_mutex_create_recursive(log_async.pool, "logasync",
+				       &log_async.mutex);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    status = pj_mutex_create_recursive(log_async.pool, "logwrite",
+				       &log_async.write_mutex);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    status = pj_sem_create(log_async.pool, "logasync", 0, 0x7FFFFFFF,
+			   &log_async.sem);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    status = pj_thread_local_alloc(&log_async.ring_tls);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    status = pj_thread_create(log_async.pool, "logasync", &log_async_thread,
+			      NULL, 0, 0, &log_async.thread);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    if (!log_async.atexit_registered) {
+	pj_atexit(&log_async_shutdown);
+	log_async.atexit_registered = PJ_TRUE;
+    }
+
+    __atomic_store_n(&log_async.enabled, 1, __ATOMIC_SEQ_CST);
+
+    return PJ_SUCCESS;
+
+on_error:
+    if (log_async.ring_tls != -1) {
+	pj_thread_local_free(log_async.ring_tls);
+	log_async.ring_tls = -1;
+    }
+    if (log_async.sem) {
+	pj_sem_destroy(log_async.sem);
+	log_async.sem = NULL;
+    }
+    if (log_async.write_mutex) {
+	pj_mutex_destroy(log_async.write_mutex);
+	log_async.write_mutex = NULL;
+    }
+    if (log_async.mutex) {
+	pj_mutex_destroy(log_async.mutex);
+	log_async.mutex = NULL;
+    }
+    pj_pool_release(log_async.pool);
+    log_async.pool = NULL;
+    pj_caching_pool_destroy(&log_async.cp);
+    return status;
+}
+
+PJ_DEF(void) pj_log_flush(void)
+{
+    __atomic_add_fetch(&log_async.busy, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&log_async.enabled, __ATOMIC_SEQ_CST)) {
+	pj_mutex_lock(log_async.write_mutex);
+	log_async_drain((unsigned)-1);
+	pj_mutex_unlock(log_async.write_mutex);
+    }
+
+    __atomic_sub_fetch(&log_async.busy, 1, __ATOMIC_SEQ_CST);
+}
+
+PJ_DEF(pj_status_t) pj_log_stop_async(void)
+{
+    if (log_async.thread == NULL)
+	return PJ_SUCCESS;
+
+    /* Wait until no thread is using the ring buffers */
+    __atomic_store_n(&log_async.enabled, 0, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&log_async.busy, __ATOMIC_SEQ_CST))
+	pj_thread_sleep(0);
+
+    log_async.quit = PJ_TRUE;
+    pj_sem_post(log_async.sem);
+    pj_thread_join(log_async.thread);
+    pj_thread_destroy(log_async.thread);
+    log_async.thread = NULL;
+
+    /* Write the remaining messages */
+    log_async_drain((unsigned)-1);
+
+    while (!pj_list_empty(&log_async.ring_list)) {
+	pj_pool_factory *pf = &log_async.cp.factory;
+	log_ring *ring = log_async.ring_list.next;
+
+	(*pf->policy.block_free)(pf, ring->buf, log_async.ring_size);
+	pj_list_erase(ring);
+    }
+
+    pj_thread_local_free(log_async.ring_tls);
+    log_async.ring_tls = -1;
+    pj_sem_destroy(log_async.sem);
+    log_async.sem = NULL;
+    pj_mutex_destroy(log_async.write_mutex);
+    log_async.write_mutex = NULL;
+    pj_mutex_destroy(log_async.mutex);
+    log_async.mutex = NULL;
+    pj_pool_release(log_async.pool);
+    log_async.pool = NULL;
+    pj_caching_pool_destroy(&log_async.cp);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_log_set_async_binary(pj_bool_t enabled)
+{
+    __atomic_store_n(&log_async.binary, enabled ? 1 : 0, __ATOMIC_SEQ_CST);
+}
+
+PJ_DEF(pj_status_t) pj_log_get_async_stat(pj_log_async_stat *stat)
+{
+    log_ring *ring;
+
+    PJ_ASSERT_RETURN(stat, PJ_EINVAL);
+
+    pj_bzero(stat, sizeof(*stat));
+
+    if (log_async.thread == NULL)
+	return PJ_EINVALIDOP;
+
+    pj_mutex_lock(log_async.mutex);
+    stat->dropped_cnt = log_async.freed_dropped;
+    for (ring=log_async.ring_list.next; ring!=&log_async.ring_list;
+	 ring=ring->next)
+    {
+	stat->dropped_cnt += __atomic_load_n(&ring->dropped,
+					     __ATOMIC_RELAXED);
+    }
+    stat->ring_cnt = log_async.ring_cnt;
+    pj_mutex_unlock(log_async.mutex);
+
+    stat->written_cnt = __atomic_load_n(&log_async.written_cnt,
+					__ATOMIC_RELAXED);
+    stat->binary_cnt = __atomic_load_n(&log_async.binary_cnt,
+				       __ATOMIC_RELAXED);
+
+    return PJ_SUCCESS;
+}
+
+#else	/* LOG_HAS_ASYNC */
+
+PJ_DEF(pj_status_t) pj_log_start_async(unsigned ring_size)
+{
+    PJ_UNUSED_ARG(ring_size);
+    return PJ_ENOTSUP;
+}
+
+PJ_DEF(void) pj_log_flush(void)
+{
+}
+
+PJ_DEF(pj_status_t) pj_log_stop_async(void)
+{
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_log_set_async_binary(pj_bool_t enabled)
+{
+    PJ_UNUSED_ARG(enabled);
+}
+
+PJ_DEF(pj_status_t) pj_log_get_async_stat(pj_log_async_stat *stat)
+{
+    PJ_ASSERT_RETURN(stat, PJ_EINVAL);
+    pj_bzero(stat, sizeof(*stat));
+    return PJ_EINVALIDOP;
+}
+
+#endif	/* LOG_HAS_ASYNC */
+
+PJ_DEF(void) pj_log( const char *sender, int level, 
+		     const char *format, va_list marker)
+{
+    pj_time_val now;
+#if PJ_LOG_USE_STACK_BUFFER
+    char log_buffer[PJ_LOG_MAX_SIZE];
+#endif
+    const char *thread_name = "";
+    pj_bool_t thread_switched = PJ_FALSE;
+    int saved_level, len, print_len, indent = 0;
+
+    PJ_CHECK_STACK();
+
+    if (!log_level_enabled(sender, level))
+	return;
+
+    if (is_logging_suspended())
+	return;
+
+    /* Temporarily disable logging for this thread. Some of PJLIB APIs that
+     * this function calls below will recursively call the logging function 
+     * back, hence it will cause infinite recursive calls if we allow that.
+     */
+    suspend_logging(&saved_level);
+
+    /* Get current date/time. */
+    pj_gettimeofday(&now);
+
+    if (log_decor & PJ_LOG_HAS_THREAD_ID)
+	thread_name = pj_thread_get_name(pj_thread_this());
+    if (log_decor & PJ_LOG_HAS_THREAD_SWC)
+	thread_switched = log_thread_switched();
+#if PJ_LOG_ENABLE_INDENT
+    if (log_decor & PJ_LOG_HAS_INDENT)
+	indent = log_get_indent();
+#endif
+
+#if LOG_HAS_ASYNC
+    /* Let the log thread format the message if the binary record mode is
+     * enabled.
+     */
+    if (level != 0 &&
+	log_async_write_bin(sender, level, &now, thread_name,
+			    thread_switched, indent, format, marker,
+			    log_buffer))
+    {
+	resume_logging(&saved_level);
+	return;
+    }
+#endif
+
+    len = log_print_prefix(log_buffer, sender, level, &now, thread_name,
+			   thread_switched, indent);
+
+    /* Print the whole message to the string log_buffer. */
+    print_len = pj_ansi_vsnprintf(log_buffer+len, PJ_LOG_MAX_SIZE-len,
+				  format, marker);
+    if (print_len < 0) {
+	level = 1;
+	print_len = pj_ansi_snprintf(log_buffer+len, PJ_LOG_MAX_SIZE-len, 
+				     "<logging error: msg too long>");
+    }
+    len = log_terminate(log_buffer, len, print_len);
+
+#if LOG_HAS_ASYNC
+    /* Logging is still suspended here, so that the functions used by the
+     * asynchronous logging don't log recursively.
+     */
+    if (log_async_write(level, log_buffer, len)) {
+	resume_logging(&saved_level);
+	return;
+    }
+#endif
+
     /* It should be safe to resume logging at this point. Application can
      * recursively call the logging function inside the callback.
      */
@@ -0,0 +1,443 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/objpool.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/list.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+#define THIS_FILE	"objpool.c"
+
+/* Free objects are linked through their first word. */
+typedef struct free_obj
+{
+    struct free_obj *next;
+} free_obj;
+
+/* Per-thread cache of free objects.
+ *
+ * As with the magazines of the caching pool, the owner thread claims the
+ * cache with the busy flag, so that the objects of an idle cache (e.g.
+ * of a thread which has exited) can be moved to the shared free list by
+ * another thread (see sweep_caches()). The active flag is set on every
+ * use. The counters are also read by pj_objpool_get_stat(), so they are
+ * updated atomically.
+ */
+typedef struct objpool_cache
+{
+    PJ_DECL_LIST_MEMBER(struct objpool_cache);
+    int		 busy;
+    int		 active;
+    unsigned	 cnt;
+    pj_uint32_t	 alloc_cnt;
+    void	*obj[PJ_OBJPOOL_THREAD_CACHE_SIZE];
+} objpool_cache;
+
+#if PJ_HAS_ATOMIC_BUILTINS
+#   define CACHE_GET(var)	__atomic_load_n(&(var), __ATOMIC_RELAXED)
+#   define CACHE_SET(var,val)	__atomic_store_n(&(var), val, __ATOMIC_RELAXED)
+#else
+#   define CACHE_GET(var)	(var)
+#   define CACHE_SET(var,val)	((var) = (val))
+#endif
+
+struct pj_objpool_t
+{
+    char	     obj_name[PJ_MAX_OBJ_NAME];
+    pj_pool_t	    *pool;
+    pj_lock_t	    *lock;
+    pj_size_t	     obj_size;
+    unsigned	     objs_per_slab;
+
+    /* Shared free list, protected by lock */
+    free_obj	    *free_list;
+    unsigned	     slab_cnt;
+    unsigned	     out_cnt;	    /* Objects not in the shared free list */
+    unsigned	     peak_cnt;
+    pj_uint32_t	     alloc_cnt;	    /* Allocations from the shared list */
+
+    /* Per-thread caches, or cache_tls is -1 if disabled */
+    long	     cache_tls;
+    objpool_cache    cache_list;
+    pj_time_val	     cache_sweep;   /* Time of the next sweep */
+};
+
+
+PJ_DEF(pj_status_t) pj_objpool_create(pj_pool_factory *factory,
+				      const char *name,
+				      pj_size_t obj_size,
+				      unsigned objs_per_slab,
+				      unsigned flags,
+				      pj_objpool_t **p_objpool)
+{
+    pj_pool_t *pool;
+    pj_objpool_t *op;
+    pj_size_t slab_size;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(factory && obj_size && objs_per_slab && p_objpool,
+		     PJ_EINVAL);
+
+    if (name == NULL)
+	name = "objpool%p";
+
+    /* Round up the object size so every object in the slab is aligned
+     * and can hold the free list pointer.
+     */
+    if (obj_size < sizeof(free_obj))
+	obj_size = sizeof(free_obj);
+    obj_size = (obj_size + PJ_POOL_ALIGNMENT - 1) & ~(PJ_POOL_ALIGNMENT - 1);
+
+    /* Make every slab occupy exactly one pool block */
+    slab_size = obj_size * objs_per_slab;
+    pool = pj_pool_create(factory, name, 512,
+			  slab_size + sizeof(pj_pool_block) + PJ_POOL_ALIGNMENT,
+			  NULL);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    op = PJ_POOL_ZALLOC_T(pool, pj_objpool_t);
+    pj_ansi_strncpy(op->obj_name, pool->obj_name, PJ_MAX_OBJ_NAME);
+    op->pool = pool;
+    op->obj_size = obj_size;
+    op->objs_per_slab = objs_per_slab;
+    op->cache_tls = -1;
+    pj_list_init(&op->cache_list);
+
+    status = pj_lock_create_simple_mutex(pool, op->obj_name, &op->lock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* The caches can't be swept without atomic operations, so they are
+     * not used then.
+     */
+    if ((flags & PJ_OBJPOOL_THREAD_CACHE) && PJ_HAS_ATOMIC_BUILTINS) {
+	status = pj_thread_local_alloc(&op->cache_tls);
+	if (status != PJ_SUCCESS) {
+	    op->cache_tls = -1;
+	    goto on_error;
+	}
+    }
+
+    PJ_LOG(5,(op->obj_name, "Object pool created, obj_size=%u, "
+	      "objs_per_slab=%u", (unsigned)obj_size, objs_per_slab));
+
+    *p_objpool = op;
+    return PJ_SUCCESS;
+
+on_error:
+    if (op->lock)
+	pj_lock_destroy(op->lock);
+    pj_pool_release(pool);
+    return status;
+}
+
+/* Get an object from the shared free list, allocating a new slab if the
+ * list is empty. Object pool lock must be held.
+ */
+static free_obj *get_shared_obj(pj_objpool_t *op)
+{
+    free_obj *obj;
+
+    if (op->free_list == NULL) {
+	char *slab;
+	unsigned i;
+
+	slab = (char*) pj_pool_alloc(op->pool,
+				     op->obj_size * op->objs_per_slab);
+	if (!slab)
+	    return NULL;
+
+	for (i=op->objs_per_slab; i>0; --i) {
+	    obj = (free_obj*) (slab + (i-1) * op->obj_size);
+	    obj->next = op->free_list;
+	    op->free_list = obj;
+	}
+	++op->slab_cnt;
+
+	PJ_LOG(6,(op->obj_name, "New slab allocated, slab_cnt=%u",
+		  op->slab_cnt));
+    }
+
+    obj = op->free_list;
+    op->free_list = obj->next;
+    if (++op->out_cnt > op->peak_cnt)
+	op->peak_cnt = op->out_cnt;
+
+    return obj;
+}
+
+/* Claim a cache, failing if another thread is sweeping it. */
+static pj_bool_t cache_claim(objpool_cache *cache, pj_bool_t owner)
+{
+#if PJ_HAS_ATOMIC_BUILTINS
+    int idle = 0;
+
+    if (owner)
+	__atomic_store_n(&cache->active, 1, __ATOMIC_RELAXED);
+    return __atomic_compare_exchange_n(&cache->busy, &idle, 1, PJ_FALSE,
+				       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+#else
+    PJ_UNUSED_ARG(cache);
+    PJ_UNUSED_ARG(owner);
+    return PJ_FALSE;
+#endif
+}
+
+static void cache_unclaim(objpool_cache *cache)
+{
+#if PJ_HAS_ATOMIC_BUILTINS
+    __atomic_store_n(&cache->busy, 0, __ATOMIC_RELEASE);
+#else
+    PJ_UNUSED_ARG(cache);
+#endif
+}
+
+/* Move the objects of the caches which have not been used since the
+ * previous sweep to the shared free list, so that the objects kept for
+ * threads which have exited are reused. Object pool lock must be held.
+ */
+static void sweep_caches(pj_objpool_t *op)
+{
+#if PJ_HAS_ATOMIC_BUILTINS
+    objpool_cache *cache;
+    pj_time_val now;
+
+    if (pj_list_empty(&op->cache_list))
+	return;
+
+    pj_gettickcount(&now);
+    if (PJ_TIME_VAL_LT(now, op->cache_sweep))
+	return;
+
+    op->cache_sweep = now;
+    op->cache_sweep.msec += PJ_OBJPOOL_THREAD_CACHE_IDLE;
+    pj_time_val_normalize(&op->cache_sweep);
+
+    for (cache=op->cache_list.next; cache!=&op->cache_list;
+	 cache=cache->next)
+    {
+	unsigned cnt;
+
+	if (__atomic_exchange_n(&cache->active, 0, __ATOMIC_RELAXED) ||
+	    !cache_claim(cache, PJ_FALSE))
+	{
+	    continue;
+	}
+
+	for (cnt = cache->cnt; cnt > 0; --cnt) {
+	    free_obj *fo = (free_obj*) cache->obj[cnt-1];
+	    fo->next = op->free_list;
+	    op->free_list = fo;
+	    --op->out_cnt;
+	}
+	CACHE_SET(cache->cnt, 0);
+
+	cache_unclaim(cache);
+    }
+#else
+    PJ_UNUSED_ARG(op);
+#endif
+}
+
+/* Get the cache of the calling thread, creating it if necessary. */
+static objpool_cache *get_cache(pj_objpool_t *op)
+{
+    objpool_cache *cache;
+
+    cache = (objpool_cache*) pj_thread_local_get(op->cache_tls);
+    if (cache)
+	return cache;
+
+    pj_lock_acquire(op->lock);
+    cache = PJ_POOL_ZALLOC_T(op->pool, objpool_cache);
+    if (cache)
+	pj_list_push_back(&op->cache_list, cache);
+    pj_lock_release(op->lock);
+
+    if (cache && pj_thread_local_set(op->cache_tls, cache) != PJ_SUCCESS)
+	return NULL;
+
+    return cache;
+}
+
+PJ_DEF(void*) pj_objpool_alloc(pj_objpool_t *op)
+{
+    objpool_cache *cache = NULL;
+    void *obj;
+
+    PJ_ASSERT_RETURN(op, NULL);
+
+    if (op->cache_tls != -1) {
+	cache = get_cache(op);
+	if (cache && !cache_claim(cache, PJ_TRUE)) {
+	    /* Being swept, use the shared list this time */
+	    cache = NULL;
+	}
+	if (cache && cache->cnt) {
+	    unsigned cnt = cache->cnt - 1;
+
+	    obj = cache->obj[cnt];
+	    CACHE_SET(cache->cnt, cnt);
+	    CACHE_SET(cache->alloc_cnt, cache->alloc_cnt + 1);
+	    cache_unclaim(cache);
+	    return obj;
+	}
+    }
+
+    pj_lock_acquire(op->lock);
+
+    obj = get_shared_obj(op);
+    if (obj) {
+	++op->alloc_cnt;
+
+	/* Refill half of the cache while we're holding the lock */
+	if (cache) {
+	    unsigned cnt = cache->cnt;
+
+	    while (cnt < PJ_OBJPOOL_THREAD_CACHE_SIZE / 2) {
+		void *p = get_shared_obj(op);
+		if (!p)
+		    break;
+		cache->obj[cnt++] = p;
+	    }
+	    CACHE_SET(cache->cnt, cnt);
+	}
+    }
+
+    sweep_caches(op);
+    pj_lock_release(op->lock);
+
+    if (cache)
+	cache_unclaim(cache);
+
+    return obj;
+}
+
+PJ_DEF(void*) pj_objpool_zalloc(pj_objpool_t *op)
+{
+    void *obj = pj_objpool_alloc(op);
+    if (obj)
+	pj_bzero(obj, op->obj_size);
+    return obj;
+}
+
+PJ_DEF(void) pj_objpool_free(pj_objpool_t *op, void *obj)
+{
+    objpool_cache *cache = NULL;
+    free_obj *fo;
+
+    PJ_ASSERT_ON_FAIL(op && obj, return);
+
+    if (op->cache_tls != -1) {
+	cache = get_cache(op);
+	if (cache && !cache_claim(cache, PJ_TRUE)) {
+	    /* Being swept, use the shared list this time */
+	    cache = NULL;
+	}
+	if (cache && cache->cnt < PJ_OBJPOOL_THREAD_CACHE_SIZE) {
+	    cache->obj[cache->cnt] = obj;
+	    CACHE_SET(cache->cnt, cache->cnt + 1);
+	    cache_unclaim(cache);
+	    return;
+	}
+    }
+
+    pj_lock_acquire(op->lock);
+
+    fo = (free_obj*) obj;
+    fo->next = op->free_list;
+    op->free_list = fo;
+    --op->out_cnt;
+
+    /* Flush half of the full cache to the shared list */
+    if (cache) {
+	unsigned cnt = cache->cnt;
+
+	while (cnt > PJ_OBJPOOL_THREAD_CACHE_SIZE / 2) {
+	    fo = (free_obj*) cache->obj[--cnt];
+	    fo->next = op->free_list;
+	    op->free_list = fo;
+	    --op->out_cnt;
+	}
+	CACHE_SET(cache->cnt, cnt);
+    }
+
+    sweep_caches(op);
+    pj_lock_release(op->lock);
+
+    if (cache)
+	cache_unclaim(cache);
+}
+
+PJ_DEF(pj_status_t) pj_objpool_get_stat(pj_objpool_t *op,
+					pj_objpool_stat *stat)
+{
+    objpool_cache *cache;
+    unsigned cached = 0;
+
+    PJ_ASSERT_RETURN(op && stat, PJ_EINVAL);
+
+    pj_bzero(stat, sizeof(*stat));
+
+    pj_lock_acquire(op->lock);
+
+    for (cache=op->cache_list.next; cache!=&op->cache_list;
+	 cache=cache->next)
+    {
+	/* The owner threads update these without the lock */
+	cached += CACHE_GET(cache->cnt);
+	stat->cache_hit_cnt += CACHE_GET(cache->alloc_cnt);
+    }
+
+    stat->obj_size = op->obj_size;
+    stat->slab_cnt = op->slab_cnt;
+    stat->capacity = op->slab_cnt * op->objs_per_slab;
+    stat->used_cnt = (op->out_cnt > cached) ? op->out_cnt - cached : 0;
+    stat->cached_cnt = cached;
+    stat->peak_cnt = op->peak_cnt;
+    stat->alloc_cnt = op->alloc_cnt + stat->cache_hit_cnt;
+
+    pj_lock_release(op->lock);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_objpool_destroy(pj_objpool_t *op)
+{
+    PJ_ASSERT_RETURN(op, PJ_EINVAL);
+
+    PJ_LOG(5,(op->obj_name, "Object pool destroyed, slab_cnt=%u, "
+	      "peak_cnt=%u", op->slab_cnt, op->peak_cnt));
+
+    if (op->cache_tls != -1) {
+	pj_thread_local_free(op->cache_tls);
+	op->cache_tls = -1;
+    }
+
+    pj_lock_destroy(op->lock);
+    pj_pool_release(op->pool);
+
+    return PJ_SUCCESS;
+}
@@ -563,6 +563,34 @@ PJ_DEF(int) pj_thread_get_prio_max(pj_thread_t *thread)
 }
 
 
+/*
+ * Bind the thread to the specified CPUs.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread,
+					   const unsigned cpu[],
+					   unsigned cpu_cnt)
+{
+    PJ_UNUSED_ARG(thread);
+    PJ_UNUSED_ARG(cpu);
+    PJ_UNUSED_ARG(cpu_cnt);
+    return PJ_ENOTSUP;
+}
+
+
+/*
+ * Set the scheduling policy and priority of the thread.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_sched(pj_thread_t *thread,
+					pj_thread_sched_policy policy,
+					int prio)
+{
+    PJ_UNUSED_ARG(thread);
+    PJ_UNUSED_ARG(policy);
+    PJ_UNUSED_ARG(prio);
+    return PJ_ENOTSUP;
+}
+
+
 /*
  * pj_thread_get_os_handle()
  */
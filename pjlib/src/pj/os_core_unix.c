@@ -69,9 +69,21 @@ struct pj_thread_t
 #endif
 };
 
+/* Atomic variables are protected with a mutex only when threading is
+ * enabled and the compiler does not provide native atomic builtins.
+ */
+#if PJ_HAS_THREADS && (!defined(PJ_HAS_ATOMIC_BUILTINS) || \
+		       PJ_HAS_ATOMIC_BUILTINS==0)
+#   define ATOMIC_USE_MUTEX	1
+#else
+#   define ATOMIC_USE_MUTEX	0
+#endif
+
 struct pj_atomic_t
 {
+#if ATOMIC_USE_MUTEX
     pj_mutex_t	       *mutex;
+#endif
     pj_atomic_value_t	value;
 };
 
@@ -379,6 +391,97 @@ PJ_DEF(int) pj_thread_get_prio_max(pj_thread_t *thread)
 }
 
 
+/*
+ * Bind the thread to the specified CPUs.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread,
+					   const unsigned cpu[],
+					   unsigned cpu_cnt)
+{
+#if PJ_HAS_THREADS && defined(__GLIBC__) && defined(CPU_SET)
+    cpu_set_t cpuset;
+    unsigned i;
+    int rc;
+
+    PJ_ASSERT_RETURN(thread && cpu && cpu_cnt, PJ_EINVAL);
+
+    CPU_ZERO(&cpuset);
+    for (i=0; i<cpu_cnt; ++i) {
+	PJ_ASSERT_RETURN(cpu[i] < CPU_SETSIZE, PJ_EINVAL);
+	CPU_SET(cpu[i], &cpuset);
+    }
+
+    rc = pthread_setaffinity_np(thread->thread, sizeof(cpuset), &cpuset);
+    if (rc != 0)
+	return PJ_RETURN_OS_ERROR(rc);
+
+    return PJ_SUCCESS;
+#else
+    PJ_UNUSED_ARG(thread);
+    PJ_UNUSED_ARG(cpu);
+    PJ_UNUSED_ARG(cpu_cnt);
+    return PJ_ENOTSUP;
+#endif
+}
+
+
+/*
+ * Set the scheduling policy and priority of the thread.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_sched(pj_thread_t *thread,
+					pj_thread_sched_policy policy,
+					int prio)
+{
+#if PJ_HAS_THREADS && defined(_POSIX_PRIORITY_SCHEDULING)
+    struct sched_param param;
+    int os_policy, min, max;
+    int rc;
+
+    PJ_ASSERT_RETURN(thread, PJ_EINVAL);
+
+    switch (policy) {
+    case PJ_THREAD_SCHED_DEFAULT:
+	os_policy = SCHED_OTHER;
+	prio = 0;
+	break;
+    case PJ_THREAD_SCHED_FIFO:
+	os_policy = SCHED_FIFO;
+	break;
+    case PJ_THREAD_SCHED_RR:
+	os_policy = SCHED_RR;
+	break;
+    default:
+	pj_assert(!"Invalid scheduling policy");
+	return PJ_EINVAL;
+    }
+
+    min = sched_get_priority_min(os_policy);
+    max = sched_get_priority_max(os_policy);
+    if (min < 0 || max < 0)
+	return PJ_RETURN_OS_ERROR(pj_get_native_os_error());
+
+    if (prio == 0)
+	prio = min;
+    else if (prio < min || prio > max)
+	return PJ_EINVAL;
+
+    pj_bzero(&param, sizeof(param));
+    param.sched_priority = prio;
+
+    rc = pthread_setschedparam(thread->thread, os_policy, &param);
+    if (rc != 0)
+	return PJ_RETURN_OS_ERROR(rc);
+
+    return PJ_SUCCESS;
+#else
+    PJ_UNUSED_ARG(thread);
+    PJ_UNUSED_ARG(policy);
+    PJ_UNUSED_ARG(prio);
+    return PJ_ENOTSUP;
+#endif
+}
+
+
 /*
  * Get native thread handle
  */
@@ -835,17 +938,21 @@ PJ_DEF(pj_status_t) pj_atomic_create( pj_pool_t *pool,
 				      pj_atomic_value_t initial,
 				      pj_atomic_t **ptr_atomic)
 {
-    pj_status_t rc;
     pj_atomic_t *atomic_var;
 
     atomic_var = PJ_POOL_ZALLOC_T(pool, pj_atomic_t);
 
     PJ_ASSERT_RETURN(atomic_var, PJ_ENOMEM);
 
-#if PJ_HAS_THREADS
-    rc = pj_mutex_create(pool, "atm%p", PJ_MUTEX_SIMPLE, &atomic_var->mutex);
-    if (rc != PJ_SUCCESS)
-	return rc;
+#if ATOMIC_USE_MUTEX
+    {
+	pj_status_t rc;
+
+	rc = pj_mutex_create(pool, "atm%p", PJ_MUTEX_SIMPLE,
+			     &atomic_var->mutex);
+	if (rc != PJ_SUCCESS)
+	    return rc;
+    }
 #endif
     atomic_var->value = initial;
 
@@ -859,7 +966,7 @@ PJ_DEF(pj_status_t) pj_atomic_create( pj_pool_t *pool,
 PJ_DEF(pj_status_t) pj_atomic_destroy( pj_atomic_t *atomic_var )
 {
     PJ_ASSERT_RETURN(atomic_var, PJ_EINVAL);
-#if PJ_HAS_THREADS
+#if ATOMIC_USE_MUTEX
     return pj_mutex_destroy( atomic_var->mutex );
 #else
     return 0;
@@ -873,12 +980,14 @@ PJ_DEF(void) pj_atomic_set(pj_atomic_t *atomic_var, pj_atomic_value_t value)
 {
     PJ_CHECK_STACK();
 
-#if PJ_HAS_THREADS
+#if ATOMIC_USE_MUTEX
     pj_mutex_lock( atomic_var->mutex );
-#endif
     atomic_var->value = value;
-#if PJ_HAS_THREADS
     pj_mutex_unlock( atomic_var->mutex);
+#elif PJ_HAS_ATOMIC_BUILTINS
+    __atomic_store_n(&atomic_var->value, value, __ATOMIC_SEQ_CST);
+#else
+    atomic_var->value = value;
 #endif
 }
 
@@ -891,12 +1000,14 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_get(pj_atomic_t *atomic_var)
 
     PJ_CHECK_STACK();
 
-#if PJ_HAS_THREADS
+#if ATOMIC_USE_MUTEX
     pj_mutex_lock( atomic_var->mutex );
-#endif
     oldval = atomic_var->value;
-#if PJ_HAS_THREADS
     pj_mutex_unlock( atomic_var->mutex);
+#elif PJ_HAS_ATOMIC_BUILTINS
+    oldval = __atomic_load_n(&atomic_var->value, __ATOMIC_SEQ_CST);
+#else
+    oldval = atomic_var->value;
 #endif
     return oldval;
 }
@@ -906,26 +1017,16 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_get(pj_atomic_t *atomic_var)
  */
 PJ_DEF(pj_atomic_value_t) pj_atomic_inc_and_get(pj_atomic_t *atomic_var)
 {
-    pj_atomic_value_t new_value;
-
     PJ_CHECK_STACK();
 
-#if PJ_HAS_THREADS
-    pj_mutex_lock( atomic_var->mutex );
-#endif
-    new_value = ++atomic_var->value;
-#if PJ_HAS_THREADS
-    pj_mutex_unlock( atomic_var->mutex);
-#endif
-
-    return new_value;
+    return pj_atomic_add_and_get(atomic_var, 1);
 }
 /*
  * pj_atomic_inc()
  */
 PJ_DEF(void) pj_atomic_inc(pj_atomic_t *atomic_var)
 {
-    pj_atomic_inc_and_get(atomic_var);
+    pj_atomic_add_and_get(atomic_var, 1);
 }
 
 /*
@@ -933,19 +1034,9 @@ PJ_DEF(void) pj_atomic_inc(pj_atomic_t *atomic_var)
  */
 PJ_DEF(pj_atomic_value_t) pj_atomic_dec_and_get(pj_atomic_t *atomic_var)
 {
-    pj_atomic_value_t new_value;
-
     PJ_CHECK_STACK();
 
-#if PJ_HAS_THREADS
-    pj_mutex_lock( atomic_var->mutex );
-#endif
-    new_value = --atomic_var->value;
-#if PJ_HAS_THREADS
-    pj_mutex_unlock( atomic_var->mutex);
-#endif
-
-    return new_value;
+    return pj_atomic_add_and_get(atomic_var, -1);
 }
 
 /*
@@ -953,7 +1044,7 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_dec_and_get(pj_atomic_t *atomic_var)
  */
 PJ_DEF(void) pj_atomic_dec(pj_atomic_t *atomic_var)
 {
-    pj_atomic_dec_and_get(atomic_var);
+    pj_atomic_add_and_get(atomic_var, -1);
 }
 
 /*
@@ -964,15 +1055,17 @@ PJ_DEF(pj_atomic_value_t) pj_atomic_add_and_get( pj_atomic_t *atomic_var,
 {
     pj_atomic_value_t new_value;
 
-#if PJ_HAS_THREADS
+#if ATOMIC_USE_MUTEX
     pj_mutex_lock(atomic_var->mutex);
-#endif
-
     atomic_var->value += value;
     new_value = atomic_var->value;
-
-#if PJ_HAS_THREADS
     pj_mutex_unlock(atomic_var->mutex);
+#elif PJ_HAS_ATOMIC_BUILTINS
+    new_value = __atomic_add_fetch(&atomic_var->value, value,
+				   __ATOMIC_SEQ_CST);
+#else
+    atomic_var->value += value;
+    new_value = atomic_var->value;
 #endif
 
     return new_value;
@@ -346,6 +346,61 @@ PJ_DEF(int) pj_thread_get_prio_max(pj_thread_t *thread)
 }
 
 
+/*
+ * Bind the thread to the specified CPUs.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_affinity(pj_thread_t *thread,
+					   const unsigned cpu[],
+					   unsigned cpu_cnt)
+{
+#if PJ_HAS_THREADS
+    DWORD_PTR mask = 0;
+    unsigned i;
+
+    PJ_ASSERT_RETURN(thread && cpu && cpu_cnt, PJ_EINVAL);
+
+    for (i=0; i<cpu_cnt; ++i) {
+	PJ_ASSERT_RETURN(cpu[i] < sizeof(mask) * 8, PJ_EINVAL);
+	mask |= ((DWORD_PTR)1 << cpu[i]);
+    }
+
+    if (SetThreadAffinityMask(thread->hthread, mask) == 0)
+	return PJ_RETURN_OS_ERROR(GetLastError());
+
+    return PJ_SUCCESS;
+#else
+    PJ_UNUSED_ARG(thread);
+    PJ_UNUSED_ARG(cpu);
+    PJ_UNUSED_ARG(cpu_cnt);
+    return PJ_ENOTSUP;
+#endif
+}
+
+
+/*
+ * Set the scheduling policy and priority of the thread. Windows has no
+ * scheduling policies, so the real-time policies map to the highest
+ * priority.
+ */
+PJ_DEF(pj_status_t) pj_thread_set_sched(pj_thread_t *thread,
+					pj_thread_sched_policy policy,
+					int prio)
+{
+    PJ_UNUSED_ARG(prio);
+
+    switch (policy) {
+    case PJ_THREAD_SCHED_DEFAULT:
+	return pj_thread_set_prio(thread, THREAD_PRIORITY_NORMAL);
+    case PJ_THREAD_SCHED_FIFO:
+    case PJ_THREAD_SCHED_RR:
+	return pj_thread_set_prio(thread, THREAD_PRIORITY_TIME_CRITICAL);
+    default:
+	pj_assert(!"Invalid scheduling policy");
+	return PJ_EINVAL;
+    }
+}
+
+
 /*
  * Get native thread handle
  */
@@ -0,0 +1,54 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/os.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/string.h>
+
+
+PJ_DEF(void) pj_thread_sched_param_default(pj_thread_sched_param *param)
+{
+    pj_bzero(param, sizeof(*param));
+    param->use_affinity = PJ_FALSE;
+    param->policy = PJ_THREAD_SCHED_DEFAULT;
+}
+
+
+PJ_DEF(pj_status_t) pj_thread_set_sched_param(pj_thread_t *thread,
+					const pj_thread_sched_param *param)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(thread && param, PJ_EINVAL);
+
+    if (param->use_affinity) {
+	status = pj_thread_set_affinity(thread, &param->cpu, 1);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+
+    if (param->policy != PJ_THREAD_SCHED_DEFAULT) {
+	status = pj_thread_set_sched(thread, param->policy, param->prio);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+
+    return PJ_SUCCESS;
+}
+
@@ -20,6 +20,11 @@
 #include <pj/os.h>
 #include <pj/compat/high_precision.h>
 
+#if defined(PJ_COARSE_CLOCK_USE_MONOTONIC_COARSE) && \
+    PJ_COARSE_CLOCK_USE_MONOTONIC_COARSE != 0
+#   include <time.h>
+#endif
+
 #if defined(PJ_HAS_HIGH_RES_TIMER) && PJ_HAS_HIGH_RES_TIMER != 0
 
 #define U32MAX  (0xFFFFFFFFUL)
@@ -202,5 +207,240 @@ PJ_DEF(pj_status_t) pj_gettickcount(pj_time_val *tv)
     return PJ_SUCCESS;
 }
 
+/*
+ * Coarse clock.
+ *
+ * Each dispatching thread has its own cached time, so a thread never sees
+ * the time cached by another thread's (possibly long) dispatching. The
+ * cached time is only read when the thread first needs it after
+ * pj_coarse_clock_enter(), so a poll iteration whose callbacks don't use
+ * the coarse clock doesn't read the clock at all. The thread local storage
+ * keeps the nesting depth, a flag whether the time has been cached, and
+ * the lower 32 bits of the cached time in milliseconds. The upper bits
+ * are taken from the latest time of all threads, which is kept in a
+ * 64-bit variable that is updated atomically. Without atomic builtins (or lock-free 64-bit
+ * compare-and-swap) the clock is always read.
+ */
+#if defined(PJ_HAS_ATOMIC_BUILTINS) && PJ_HAS_ATOMIC_BUILTINS != 0 && \
+    defined(PJ_HAS_INT64) && PJ_HAS_INT64 != 0 && \
+    defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_8)
+#   define COARSE_HAS_CACHE     1
+#else
+#   define COARSE_HAS_CACHE     0
+#endif
+
+#if COARSE_HAS_CACHE
+static struct
+{
+    pj_int64_t  tick_msec;      /* Latest monotonic time of all threads */
+    pj_int64_t  wall_ofs_msec;  /* Wall clock minus monotonic time.     */
+    pj_int64_t  wall_sec;       /* Monotonic second of the offset.      */
+    long        tls_msec;       /* Cached time of the thread.           */
+    long        tls_depth;      /* Nesting depth and cached flag.       */
+} coarse_clock = { 0, 0, -1, -1, -1 };
+
+/* The depth slot holds the nesting depth in units of DEPTH_UNIT, plus
+ * TIME_CACHED when tls_msec is valid for the current dispatching.
+ */
+#define TIME_CACHED     1
+#define DEPTH_UNIT      2
+
+static pj_status_t coarse_clock_read(pj_time_val *tv);
+
+static void coarse_clock_shutdown(void)
+{
+    pj_thread_local_free(coarse_clock.tls_msec);
+    pj_thread_local_free(coarse_clock.tls_depth);
+    coarse_clock.tls_msec = -1;
+    __atomic_store_n(&coarse_clock.tls_depth, -1, __ATOMIC_RELEASE);
+}
+
+/* Allocate the thread local storage on first use. */
+static pj_bool_t coarse_clock_init(void)
+{
+    if (__atomic_load_n(&coarse_clock.tls_depth, __ATOMIC_ACQUIRE) != -1)
+        return PJ_TRUE;
+
+    pj_enter_critical_section();
+    if (coarse_clock.tls_depth == -1) {
+        long msec_id, depth_id;
+
+        if (pj_thread_local_alloc(&msec_id) == PJ_SUCCESS) {
+            if (pj_thread_local_alloc(&depth_id) == PJ_SUCCESS) {
+                coarse_clock.tls_msec = msec_id;
+                __atomic_store_n(&coarse_clock.tls_depth, depth_id,
+                                 __ATOMIC_RELEASE);
+                pj_atexit(&coarse_clock_shutdown);
+            } else {
+                pj_thread_local_free(msec_id);
+            }
+        }
+    }
+    pj_leave_critical_section();
+
+    return coarse_clock.tls_depth != -1;
+}
+
+/* Cache the time for the calling thread. */
+static void coarse_clock_store(pj_int64_t msec)
+{
+    pj_int64_t old;
+
+    /* Several threads may refresh the latest time, never let it go
+     * backwards.
+     */
+    old = __atomic_load_n(&coarse_clock.tick_msec, __ATOMIC_RELAXED);
+    while (msec > old &&
+           !__atomic_compare_exchange_n(&coarse_clock.tick_msec, &old, msec,
+                                        1, __ATOMIC_RELAXED,
+                                        __ATOMIC_RELAXED))
+    {
+    }
+
+    /* Sample the wall clock offset once per second. The second is only
+     * updated after the offset, so readers never see a stale offset
+     * marked as current (two threads may sample it, which is harmless).
+     */
+    if (msec / MSEC != __atomic_load_n(&coarse_clock.wall_sec,
+                                       __ATOMIC_ACQUIRE))
+    {
+        pj_time_val wall;
+
+        pj_gettimeofday(&wall);
+        __atomic_store_n(&coarse_clock.wall_ofs_msec,
+                         (pj_int64_t)wall.sec * MSEC + wall.msec - msec,
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&coarse_clock.wall_sec, msec / MSEC,
+                         __ATOMIC_RELEASE);
+    }
+
+    pj_thread_local_set(coarse_clock.tls_msec,
+                        (void*)(pj_size_t)(pj_uint32_t)msec);
+}
+
+/* Get the cached time of the calling thread, if it is dispatching. The
+ * time is read on the first call after pj_coarse_clock_enter(NULL).
+ */
+static pj_bool_t coarse_clock_get(pj_int64_t *msec)
+{
+    long depth_id = __atomic_load_n(&coarse_clock.tls_depth,
+                                    __ATOMIC_ACQUIRE);
+    pj_size_t state;
+    pj_int64_t latest;
+    pj_uint32_t low;
+
+    if (depth_id == -1)
+        return PJ_FALSE;
+
+    state = (pj_size_t)pj_thread_local_get(depth_id);
+    if (state < DEPTH_UNIT)
+        return PJ_FALSE;
+
+    if ((state & TIME_CACHED) == 0) {
+        pj_time_val tv;
+
+        if (coarse_clock_read(&tv) != PJ_SUCCESS)
+            return PJ_FALSE;
+        coarse_clock_store((pj_int64_t)tv.sec * MSEC + tv.msec);
+        pj_thread_local_set(depth_id, (void*)(state | TIME_CACHED));
+    }
+
+    /* The cached time is not ahead of the latest time, and it is
+     * refreshed far more often than the lower bits wrap around.
+     */
+    low = (pj_uint32_t)(pj_size_t)pj_thread_local_get(coarse_clock.tls_msec);
+    latest = __atomic_load_n(&coarse_clock.tick_msec, __ATOMIC_RELAXED);
+    *msec = latest - (pj_uint32_t)((pj_uint32_t)latest - low);
+    return PJ_TRUE;
+}
+#endif
+
+static pj_status_t coarse_clock_read(pj_time_val *tv)
+{
+#if defined(PJ_COARSE_CLOCK_USE_MONOTONIC_COARSE) && \
+    PJ_COARSE_CLOCK_USE_MONOTONIC_COARSE != 0 && \
+    defined(CLOCK_MONOTONIC_COARSE)
+    struct timespec tp;
+
+    if (clock_gettime(CLOCK_MONOTONIC_COARSE, &tp) == 0) {
+        tv->sec = (long)tp.tv_sec;
+        tv->msec = (long)(tp.tv_nsec / 1000000);
+        return PJ_SUCCESS;
+    }
+#endif
+
+    return pj_gettickcount(tv);
+}
+
+PJ_DEF(void) pj_coarse_clock_enter(const pj_time_val *now)
+{
+#if COARSE_HAS_CACHE
+    pj_size_t state;
+
+    if (!coarse_clock_init())
+        return;
+
+    state = (pj_size_t)pj_thread_local_get(coarse_clock.tls_depth);
+    if (now) {
+        coarse_clock_store((pj_int64_t)now->sec * MSEC + now->msec);
+        state |= TIME_CACHED;
+    } else {
+        /* Read the clock when it is first needed */
+        state &= ~(pj_size_t)TIME_CACHED;
+    }
+    pj_thread_local_set(coarse_clock.tls_depth, (void*)(state + DEPTH_UNIT));
+#else
+    PJ_UNUSED_ARG(now);
+#endif
+}
+
+PJ_DEF(void) pj_coarse_clock_leave(void)
+{
+#if COARSE_HAS_CACHE
+    long depth_id = __atomic_load_n(&coarse_clock.tls_depth,
+                                    __ATOMIC_ACQUIRE);
+    pj_size_t state;
+
+    if (depth_id == -1)
+        return;
+
+    state = (pj_size_t)pj_thread_local_get(depth_id);
+    if (state >= DEPTH_UNIT)
+        pj_thread_local_set(depth_id, (void*)(state - DEPTH_UNIT));
+#endif
+}
+
+PJ_DEF(pj_status_t) pj_gettickcount_coarse(pj_time_val *tv)
+{
+#if COARSE_HAS_CACHE
+    pj_int64_t msec;
+
+    if (coarse_clock_get(&msec)) {
+        tv->sec = (long)(msec / MSEC);
+        tv->msec = (long)(msec % MSEC);
+        return PJ_SUCCESS;
+    }
+#endif
+
+    return coarse_clock_read(tv);
+}
+
+PJ_DEF(pj_status_t) pj_gettimeofday_coarse(pj_time_val *tv)
+{
+#if COARSE_HAS_CACHE
+    pj_int64_t msec;
+
+    if (coarse_clock_get(&msec)) {
+        msec += __atomic_load_n(&coarse_clock.wall_ofs_msec,
+                                __ATOMIC_RELAXED);
+        tv->sec = (long)(msec / MSEC);
+        tv->msec = (long)(msec % MSEC);
+        return PJ_SUCCESS;
+    }
+#endif
+
+    return pj_gettimeofday(tv);
+}
+
 #endif  /* PJ_HAS_HIGH_RES_TIMER */
 
@@ -66,6 +66,8 @@ static pj_pool_block *pj_pool_create_block( pj_pool_t *pool, pj_size_t size)
 
     /* Add capacity. */
     pool->capacity += size;
+    if (pool->factory->on_pool_resize)
+	(*pool->factory->on_pool_resize)(pool->factory, pool, size);
 
     /* Set start and end of buffer. */
     block->buf = ((unsigned char*)block) + sizeof(pj_pool_block);
@@ -236,6 +238,7 @@ PJ_DEF(pj_pool_t*) pj_pool_create_int( pj_pool_factory *f, const char *name,
 static void reset_pool(pj_pool_t *pool)
 {
     pj_pool_block *block;
+    pj_size_t old_capacity = pool->capacity;
 
     PJ_CHECK_STACK();
 
@@ -262,6 +265,12 @@ static void reset_pool(pj_pool_t *pool)
     block->cur = ALIGN_PTR(block->buf, PJ_POOL_ALIGNMENT);
 
     pool->capacity = block->end - (unsigned char*)pool;
+
+    if (pool->capacity != old_capacity && pool->factory->on_pool_resize) {
+	(*pool->factory->on_pool_resize)(pool->factory, pool,
+			    (pj_ssize_t)pool->capacity -
+			    (pj_ssize_t)old_capacity);
+    }
 }
 
 /*
@@ -21,6 +21,7 @@
 #include <pj/log.h>
 #include <pj/string.h>
 #include <pj/assert.h>
+#include <pj/errno.h>
 #include <pj/lock.h>
 #include <pj/os.h>
 #include <pj/pool_buf.h>
@@ -36,6 +37,8 @@ static void cpool_release_pool(pj_pool_factory *pf, pj_pool_t *pool);
 static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail );
 static pj_bool_t cpool_on_block_alloc(pj_pool_factory *f, pj_size_t sz);
 static void cpool_on_block_free(pj_pool_factory *f, pj_size_t sz);
+static void cpool_on_pool_resize(pj_pool_factory *f, pj_pool_t *pool,
+				 pj_ssize_t delta);
 
 
 static pj_size_t pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE] = 
@@ -49,6 +52,59 @@ static pj_size_t pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE] =
  */
 #define START_SIZE  5
 
+/* The factory data of a pool keeps the index of its size class in the
+ * lower bits, and the index of its category in the upper bits. Released
+ * pools have no category.
+ */
+#define FD_MAKE(idx,cat)    ((void*)(pj_ssize_t)((idx) | ((cat) << 8)))
+#define FD_IDX(pool)	((unsigned)((pj_ssize_t)(pool)->factory_data&0xFF))
+#define FD_CAT(pool)	((unsigned)((pj_ssize_t)(pool)->factory_data>>8))
+#define NO_CAT		    PJ_CACHING_POOL_MAX_CATEGORY
+#define OTHER_CAT	    (PJ_CACHING_POOL_MAX_CATEGORY-1)
+
+/* The category counters are updated without the caching pool lock, since
+ * pools grow and go to the magazines without the lock.
+ */
+#if PJ_HAS_ATOMIC_BUILTINS
+#   define STAT_ADD(var,val)	__atomic_add_fetch(&(var), val, \
+						   __ATOMIC_RELAXED)
+#   define STAT_SUB(var,val)	__atomic_sub_fetch(&(var), val, \
+						   __ATOMIC_RELAXED)
+#   define GET_CAT_CNT(cp)	__atomic_load_n(&(cp)->category_cnt, \
+						__ATOMIC_ACQUIRE)
+#   define SET_CAT_CNT(cp,cnt)	__atomic_store_n(&(cp)->category_cnt, \
+						 cnt, __ATOMIC_RELEASE)
+#   define GET_CAT_CACHE(cp,h)	__atomic_load_n(&(cp)->category_cache[h], \
+						__ATOMIC_ACQUIRE)
+#   define SET_CAT_CACHE(cp,h,v) __atomic_store_n(&(cp)->category_cache[h], \
+						  v, __ATOMIC_RELEASE)
+#else
+#   define STAT_ADD(var,val)	((var) += (val))
+#   define STAT_SUB(var,val)	((var) -= (val))
+#   define GET_CAT_CNT(cp)	((cp)->category_cnt)
+#   define SET_CAT_CNT(cp,cnt)	((cp)->category_cnt = (cnt))
+#   define GET_CAT_CACHE(cp,h)	((cp)->category_cache[h])
+#   define SET_CAT_CACHE(cp,h,v) ((cp)->category_cache[h] = (v))
+#endif
+
+/* Per-thread cache of released pools. The pools are kept in a
+ * [PJ_CACHING_POOL_ARRAY_SIZE][magazine_size] array, and they stay in the
+ * caching pool's used list while they are in the magazine, but they are
+ * counted in the capacity rather than in the used count.
+ *
+ * The owner thread claims the magazine with the busy flag, so that the
+ * pools of an idle magazine can be moved to the free list by another
+ * thread (see sweep_magazines()). The active flag is set on every use.
+ */
+typedef struct cpool_magazine
+{
+    PJ_DECL_LIST_MEMBER(struct cpool_magazine);
+    int		 busy;
+    int		 active;
+    unsigned	 cnt[PJ_CACHING_POOL_ARRAY_SIZE];
+    pj_pool_t	*pool[1];
+} cpool_magazine;
+
 
 PJ_DEF(void) pj_caching_pool_init( pj_caching_pool *cp, 
 				   const pj_pool_factory_policy *policy,
@@ -76,9 +132,223 @@ PJ_DEF(void) pj_caching_pool_init( pj_caching_pool *cp,
     cp->factory.dump_status = &cpool_dump_status;
     cp->factory.on_block_alloc = &cpool_on_block_alloc;
     cp->factory.on_block_free = &cpool_on_block_free;
+    cp->factory.on_pool_resize = &cpool_on_pool_resize;
+    pj_ansi_strcpy(cp->category[OTHER_CAT].name, "other");
 
     pool = pj_pool_create_on_buf("cachingpool", cp->pool_buf, sizeof(cp->pool_buf));
     pj_lock_create_simple_mutex(pool, "cachingpool", &cp->lock);
+
+    pj_list_init(&cp->magazine_list);
+    cp->magazine_tls = -1;
+    if (PJ_CACHING_POOL_MAGAZINE_SIZE)
+	pj_caching_pool_set_magazine(cp, PJ_CACHING_POOL_MAGAZINE_SIZE);
+}
+
+PJ_DEF(pj_status_t) pj_caching_pool_set_magazine(pj_caching_pool *cp,
+						 unsigned size)
+{
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(cp, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cp->used_count == 0 && 
+		     pj_list_empty(&cp->magazine_list), PJ_EINVALIDOP);
+
+    /* The magazines are used without the lock */
+#if !PJ_HAS_ATOMIC_BUILTINS
+    if (size)
+	return PJ_ENOTSUP;
+#endif
+
+    if (size && cp->magazine_tls == -1) {
+	status = pj_thread_local_alloc(&cp->magazine_tls);
+	if (status != PJ_SUCCESS) {
+	    cp->magazine_tls = -1;
+	    return status;
+	}
+    }
+
+    cp->magazine_size = size;
+    return PJ_SUCCESS;
+}
+
+/* Add the capacity of a released pool to the capacity of the caching
+ * pool, unless it would exceed the maximum capacity. The capacity is
+ * also updated by the magazines without the lock.
+ */
+static pj_bool_t capacity_add(pj_caching_pool *cp, pj_size_t size)
+{
+#if PJ_HAS_ATOMIC_BUILTINS
+    pj_size_t cur = __atomic_load_n(&cp->capacity, __ATOMIC_RELAXED);
+
+    do {
+	if (cur + size > cp->max_capacity)
+	    return PJ_FALSE;
+    } while (!__atomic_compare_exchange_n(&cp->capacity, &cur, cur + size,
+					  PJ_TRUE, __ATOMIC_RELAXED,
+					  __ATOMIC_RELAXED));
+#else
+    if (cp->capacity + size > cp->max_capacity)
+	return PJ_FALSE;
+    cp->capacity += size;
+#endif
+    return PJ_TRUE;
+}
+
+/* Remove the capacity of a reused pool from the caching pool capacity. */
+static void capacity_sub(pj_caching_pool *cp, pj_size_t size)
+{
+#if PJ_HAS_ATOMIC_BUILTINS
+    pj_size_t cur = __atomic_load_n(&cp->capacity, __ATOMIC_RELAXED);
+
+    while (!__atomic_compare_exchange_n(&cp->capacity, &cur,
+					(cur > size ? cur - size : 0),
+					PJ_TRUE, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED))
+    {
+    }
+#else
+    cp->capacity = (cp->capacity > size ? cp->capacity - size : 0);
+#endif
+}
+
+/* Claim a magazine, failing if another thread is sweeping it. */
+static pj_bool_t magazine_claim(cpool_magazine *mag, pj_bool_t owner)
+{
+#if PJ_HAS_ATOMIC_BUILTINS
+    int idle = 0;
+
+    if (owner)
+	__atomic_store_n(&mag->active, 1, __ATOMIC_RELAXED);
+    return __atomic_compare_exchange_n(&mag->busy, &idle, 1, PJ_FALSE,
+				       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+#else
+    PJ_UNUSED_ARG(mag);
+    PJ_UNUSED_ARG(owner);
+    return PJ_FALSE;
+#endif
+}
+
+static void magazine_unclaim(cpool_magazine *mag)
+{
+#if PJ_HAS_ATOMIC_BUILTINS
+    __atomic_store_n(&mag->busy, 0, __ATOMIC_RELEASE);
+#else
+    PJ_UNUSED_ARG(mag);
+#endif
+}
+
+/* Move the pools of the magazines which have not been used since the
+ * previous sweep to the free list, so that the pools kept for threads
+ * which have exited are reused. This is called with the lock held.
+ */
+static void sweep_magazines(pj_caching_pool *cp)
+{
+#if PJ_HAS_ATOMIC_BUILTINS
+    cpool_magazine *mag;
+    pj_time_val now;
+
+    if (pj_list_empty(&cp->magazine_list))
+	return;
+
+    pj_gettickcount(&now);
+    if (PJ_TIME_VAL_LT(now, cp->magazine_sweep))
+	return;
+
+    cp->magazine_sweep = now;
+    cp->magazine_sweep.msec += PJ_CACHING_POOL_MAGAZINE_IDLE;
+    pj_time_val_normalize(&cp->magazine_sweep);
+
+    for (mag = cp->magazine_list.next; 
+	 mag != (cpool_magazine*)&cp->magazine_list;
+	 mag = mag->next)
+    {
+	unsigned i, j;
+
+	if (__atomic_exchange_n(&mag->active, 0, __ATOMIC_RELAXED) ||
+	    !magazine_claim(mag, PJ_FALSE))
+	{
+	    continue;
+	}
+
+	/* The pools are already counted in the capacity. */
+	for (i=0; i<PJ_CACHING_POOL_ARRAY_SIZE; ++i) {
+	    for (j=0; j<mag->cnt[i]; ++j) {
+		pj_pool_t *pool = mag->pool[i*cp->magazine_size + j];
+
+		pj_list_erase(pool);
+		pj_list_insert_after(&cp->free_list[i], pool);
+	    }
+	    mag->cnt[i] = 0;
+	}
+
+	magazine_unclaim(mag);
+    }
+#else
+    PJ_UNUSED_ARG(cp);
+#endif
+}
+
+/* Get the magazine of the calling thread, optionally creating it. */
+static cpool_magazine *get_magazine(pj_caching_pool *cp, pj_bool_t create)
+{
+    cpool_magazine *mag;
+    pj_size_t size;
+
+    mag = (cpool_magazine*) pj_thread_local_get(cp->magazine_tls);
+    if (mag || !create)
+	return mag;
+
+    size = sizeof(cpool_magazine) + 
+	   (PJ_CACHING_POOL_ARRAY_SIZE * cp->magazine_size - 1) * 
+	   sizeof(pj_pool_t*);
+    mag = (cpool_magazine*) 
+	  (*cp->factory.policy.block_alloc)(&cp->factory, size);
+    if (!mag)
+	return NULL;
+
+    pj_bzero(mag, size);
+    if (pj_thread_local_set(cp->magazine_tls, mag) != PJ_SUCCESS) {
+	(*cp->factory.policy.block_free)(&cp->factory, mag, size);
+	return NULL;
+    }
+
+    pj_lock_acquire(cp->lock);
+    pj_list_push_back(&cp->magazine_list, mag);
+    pj_lock_release(cp->lock);
+
+    return mag;
+}
+
+/* Destroy all pools in the magazines and the magazines themselves. */
+static void destroy_magazines(pj_caching_pool *cp)
+{
+    pj_size_t size;
+
+    size = sizeof(cpool_magazine) + 
+	   (PJ_CACHING_POOL_ARRAY_SIZE * cp->magazine_size - 1) * 
+	   sizeof(pj_pool_t*);
+
+    while (!pj_list_empty(&cp->magazine_list)) {
+	cpool_magazine *mag = cp->magazine_list.next;
+	unsigned i, j;
+
+	for (i=0; i<PJ_CACHING_POOL_ARRAY_SIZE; ++i) {
+	    for (j=0; j<mag->cnt[i]; ++j) {
+		pj_pool_t *pool = mag->pool[i*cp->magazine_size + j];
+
+		pj_list_erase(pool);
+		pj_pool_destroy_int(pool);
+	    }
+	}
+
+	pj_list_erase(mag);
+	(*cp->factory.policy.block_free)(&cp->factory, mag, size);
+    }
+
+    if (cp->magazine_tls != -1) {
+	pj_thread_local_free(cp->magazine_tls);
+	cp->magazine_tls = -1;
+    }
 }
 
 PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
@@ -88,6 +358,9 @@ PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
 
     PJ_CHECK_STACK();
 
+    /* Delete all pools in the per-thread magazines */
+    destroy_magazines(cp);
+
     /* Delete all pool in free list */
     for (i=0; i < PJ_CACHING_POOL_ARRAY_SIZE; ++i) {
 	pj_pool_t *pool = (pj_pool_t*) cp->free_list[i].next;
@@ -116,6 +389,134 @@ PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
     }
 }
 
+/* Raise the peak value to the current value. */
+static void update_peak(pj_size_t *peak, pj_size_t val)
+{
+#if PJ_HAS_ATOMIC_BUILTINS
+    pj_size_t cur = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+    while (val > cur &&
+	   !__atomic_compare_exchange_n(peak, &cur, val, PJ_TRUE,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+#else
+    if (val > *peak)
+	*peak = val;
+#endif
+}
+
+/* Check whether the pool name belongs to the category. */
+static pj_bool_t category_match(const char *category, const char *name)
+{
+    unsigned i;
+
+    for (i=0; i<PJ_POOL_CATEGORY_NAME_LEN-1; ++i) {
+	char c = (name[i] == '%') ? '\0' : name[i];
+
+	if (category[i] != c)
+	    return PJ_FALSE;
+	if (c == '\0')
+	    return PJ_TRUE;
+    }
+
+    /* The category name is truncated */
+    return PJ_TRUE;
+}
+
+/* Get the category of the pool name, adding the category when it's new.
+ * This must not be called with the caching pool lock held.
+ */
+static unsigned get_category(pj_caching_pool *cp, const char *name)
+{
+    unsigned i, cnt, h;
+
+    if (name == NULL || *name == '\0' || *name == '%')
+	name = "pool";
+
+    /* Most pool names are string literals, so the pools created from the
+     * same place have the same name pointer. The cached category is still
+     * matched against the name, as the pointer may be a reused buffer.
+     */
+    h = (unsigned)(((pj_size_t)name >> 3) % PJ_CACHING_POOL_CATEGORY_CACHE);
+    i = GET_CAT_CACHE(cp, h);
+    if (i && category_match(cp->category[i-1].name, name))
+	return i-1;
+
+    /* The categories are only added, so the ones already added can be
+     * searched without the lock.
+     */
+    cnt = GET_CAT_CNT(cp);
+    for (i=0; i<cnt; ++i) {
+	if (category_match(cp->category[i].name, name)) {
+	    SET_CAT_CACHE(cp, h, i+1);
+	    return i;
+	}
+    }
+
+    pj_lock_acquire(cp->lock);
+
+    /* Another thread may have added it in the meantime. */
+    for (; i<cp->category_cnt; ++i) {
+	if (category_match(cp->category[i].name, name))
+	    break;
+    }
+
+    if (i == cp->category_cnt) {
+	if (i < OTHER_CAT) {
+	    char *cat_name = cp->category[i].name;
+	    unsigned len;
+
+	    for (len=0; len < PJ_POOL_CATEGORY_NAME_LEN-1 && 
+			name[len] && name[len] != '%'; ++len)
+	    {
+		cat_name[len] = name[len];
+	    }
+	    cat_name[len] = '\0';
+	    SET_CAT_CNT(cp, i+1);
+	} else {
+	    i = OTHER_CAT;
+	}
+    }
+
+    /* The "other" category doesn't match the names it accounts */
+    if (i != OTHER_CAT)
+	SET_CAT_CACHE(cp, h, i+1);
+
+    pj_lock_release(cp->lock);
+    return i;
+}
+
+/* Account a pool which is given to application. */
+static void category_add_pool(pj_caching_pool *cp, pj_pool_t *pool,
+			      unsigned idx, unsigned cat)
+{
+    pj_pool_category_stat *stat = &cp->category[cat];
+
+    pool->factory_data = FD_MAKE(idx, cat);
+
+    update_peak(&stat->peak_pool_cnt, STAT_ADD(stat->pool_cnt, 1));
+    update_peak(&stat->peak_capacity,
+		STAT_ADD(stat->capacity, pj_pool_get_capacity(pool)));
+    STAT_ADD(stat->create_cnt, 1);
+}
+
+/* Account a pool which is released by application. */
+static void category_del_pool(pj_caching_pool *cp, pj_pool_t *pool)
+{
+    unsigned cat = FD_CAT(pool);
+    pj_pool_category_stat *stat;
+
+    if (cat >= NO_CAT)
+	return;
+
+    stat = &cp->category[cat];
+    STAT_SUB(stat->pool_cnt, 1);
+    STAT_SUB(stat->capacity, pj_pool_get_capacity(pool));
+
+    pool->factory_data = FD_MAKE(FD_IDX(pool), NO_CAT);
+}
+
 static pj_pool_t* cpool_create_pool(pj_pool_factory *pf, 
 					      const char *name, 
 					      pj_size_t initial_size, 
@@ -124,17 +525,18 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
 {
     pj_caching_pool *cp = (pj_caching_pool*)pf;
     pj_pool_t *pool;
+    unsigned cat;
     int idx;
 
     PJ_CHECK_STACK();
 
-    pj_lock_acquire(cp->lock);
-
     /* Use pool factory's policy when callback is NULL */
     if (callback == NULL) {
 	callback = pf->policy.callback;
     }
 
+    cat = get_category(cp, name);
+
     /* Search the suitable size for the pool. 
      * We'll just do linear search to the size array, as the array size itself
      * is only a few elements. Binary search I suspect will be less efficient
@@ -154,6 +556,34 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
 	    ;
     }
 
+    /* Try the magazine of this thread first, without locking. */
+    if (cp->magazine_size && idx < PJ_CACHING_POOL_ARRAY_SIZE) {
+	cpool_magazine *mag = get_magazine(cp, PJ_FALSE);
+
+	if (mag && magazine_claim(mag, PJ_TRUE)) {
+	    pool = NULL;
+	    if (mag->cnt[idx])
+		pool = mag->pool[idx*cp->magazine_size + (--mag->cnt[idx])];
+	    magazine_unclaim(mag);
+
+	    if (pool) {
+		capacity_sub(cp, pj_pool_get_capacity(pool));
+		STAT_ADD(cp->used_count, 1);
+		pj_pool_init_int(pool, name, increment_sz, callback);
+		category_add_pool(cp, pool, idx, cat);
+		PJ_LOG(6, (pool->obj_name, 
+			   "pool reused from magazine, size=%u",
+			   pool->capacity));
+		return pool;
+	    }
+	}
+    }
+
+    pj_lock_acquire(cp->lock);
+
+    /* Reclaim the pools of the idle magazines. */
+    sweep_magazines(cp);
+
     /* Check whether there's a pool in the list. */
     if (idx==PJ_CACHING_POOL_ARRAY_SIZE || pj_list_empty(&cp->free_list[idx])) {
 	/* No pool is available. */
@@ -178,11 +608,7 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
 	pj_pool_init_int(pool, name, increment_sz, callback);
 
 	/* Update pool manager's free capacity. */
-	if (cp->capacity > pj_pool_get_capacity(pool)) {
-	    cp->capacity -= pj_pool_get_capacity(pool);
-	} else {
-	    cp->capacity = 0;
-	}
+	capacity_sub(cp, pj_pool_get_capacity(pool));
 
 	PJ_LOG(6, (pool->obj_name, "pool reused, size=%u", pool->capacity));
     }
@@ -190,11 +616,11 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
     /* Put in used list. */
     pj_list_insert_before( &cp->used_list, pool );
 
-    /* Mark factory data */
-    pool->factory_data = (void*) (pj_ssize_t) idx;
+    /* Mark factory data and account the pool in its category */
+    category_add_pool(cp, pool, idx, cat);
 
     /* Increment used count. */
-    ++cp->used_count;
+    STAT_ADD(cp->used_count, 1);
 
     pj_lock_release(cp->lock);
     return pool;
@@ -210,8 +636,43 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
 
     PJ_ASSERT_ON_FAIL(pf && pool, return);
 
+    /* The pool no longer counts in its category. */
+    category_del_pool(cp, pool);
+
+    /* Keep the pool in the magazine of this thread if there's room. */
+#if !PJ_SAFE_POOL
+    if (cp->magazine_size) {
+	i = FD_IDX(pool);
+
+	if (i < PJ_CACHING_POOL_ARRAY_SIZE &&
+	    pj_pool_get_capacity(pool) <= pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE-1])
+	{
+	    cpool_magazine *mag = get_magazine(cp, PJ_TRUE);
+
+	    if (mag && magazine_claim(mag, PJ_TRUE)) {
+		if (mag->cnt[i] < cp->magazine_size) {
+		    pj_pool_reset(pool);
+
+		    /* The magazine counts against the maximum capacity */
+		    if (capacity_add(cp, pj_pool_get_capacity(pool))) {
+			mag->pool[i*cp->magazine_size + (mag->cnt[i]++)] =
+			    pool;
+			magazine_unclaim(mag);
+			STAT_SUB(cp->used_count, 1);
+			return;
+		    }
+		}
+		magazine_unclaim(mag);
+	    }
+	}
+    }
+#endif
+
     pj_lock_acquire(cp->lock);
 
+    /* Reclaim the pools of the idle magazines. */
+    sweep_magazines(cp);
+
 #if PJ_SAFE_POOL
     /* Make sure pool is still in our used list */
     if (pj_list_find_node(&cp->used_list, pool) != pool) {
@@ -224,7 +685,7 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
     pj_list_erase(pool);
 
     /* Decrement used count. */
-    --cp->used_count;
+    STAT_SUB(cp->used_count, 1);
 
     pool_capacity = pj_pool_get_capacity(pool);
 
@@ -251,7 +712,7 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
     /*
      * Otherwise put the pool in our recycle list.
      */
-    i = (unsigned) (unsigned long) (pj_ssize_t) pool->factory_data;
+    i = FD_IDX(pool);
 
     pj_assert(i<PJ_CACHING_POOL_ARRAY_SIZE);
     if (i >= PJ_CACHING_POOL_ARRAY_SIZE ) {
@@ -261,12 +722,117 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
 	return;
     }
 
+    /* The magazines may have used up the capacity in the meantime. */
+    if (!capacity_add(cp, pool_capacity)) {
+	pj_pool_destroy_int(pool);
+	pj_lock_release(cp->lock);
+	return;
+    }
+
     pj_list_insert_after(&cp->free_list[i], pool);
-    cp->capacity += pool_capacity;
 
     pj_lock_release(cp->lock);
 }
 
+/* Get the category accounting, with the caching pool lock held. */
+static unsigned get_category_stat(pj_caching_pool *cp,
+				  pj_pool_category_stat stat[],
+				  unsigned max_cnt)
+{
+    unsigned stat_idx[PJ_CACHING_POOL_MAX_CATEGORY];
+    pj_pool_t *pool;
+    unsigned i, cnt = 0;
+
+    for (i=0; i<PJ_CACHING_POOL_MAX_CATEGORY; ++i) {
+	stat_idx[i] = max_cnt;
+
+	if (cnt == max_cnt)
+	    continue;
+	if (i >= cp->category_cnt &&
+	    (i != OTHER_CAT || cp->category[i].create_cnt == 0))
+	{
+	    continue;
+	}
+
+	pj_memcpy(&stat[cnt], &cp->category[i], sizeof(stat[cnt]));
+	stat[cnt].used_size = 0;
+	stat_idx[i] = cnt++;
+    }
+
+    /* Sum the used size of the pools held by application. The pools in
+     * the magazines have no category.
+     */
+    pool = (pj_pool_t*) cp->used_list.next;
+    while (pool != (void*)&cp->used_list) {
+	unsigned cat = FD_CAT(pool);
+
+	if (cat < NO_CAT && stat_idx[cat] < max_cnt)
+	    stat[stat_idx[cat]].used_size += pj_pool_get_used_size(pool);
+	pool = pool->next;
+    }
+
+    return cnt;
+}
+
+PJ_DEF(pj_status_t) pj_caching_pool_get_category_stat(
+					    pj_caching_pool *cp,
+					    pj_pool_category_stat stat[],
+					    unsigned *count)
+{
+    PJ_ASSERT_RETURN(cp && stat && count, PJ_EINVAL);
+
+    pj_lock_acquire(cp->lock);
+    *count = get_category_stat(cp, stat, *count);
+    pj_lock_release(cp->lock);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(int) pj_caching_pool_print_category_stat(pj_caching_pool *cp,
+						char *buf,
+						pj_size_t size)
+{
+    pj_pool_category_stat stat[PJ_CACHING_POOL_MAX_CATEGORY];
+    unsigned i, cnt = PJ_ARRAY_SIZE(stat);
+    char *p = buf, *end = buf + size;
+    int len;
+
+    PJ_ASSERT_RETURN(cp && buf && size, -1);
+
+    pj_caching_pool_get_category_stat(cp, stat, &cnt);
+
+    len = pj_ansi_snprintf(p, end-p, "{\"categories\":[");
+    if (len < 0 || len >= end-p)
+	return -1;
+    p += len;
+
+    for (i=0; i<cnt; ++i) {
+	len = pj_ansi_snprintf(p, end-p,
+			       "%s\n{\"name\":\"%s\",\"pool_cnt\":%lu,"
+			       "\"peak_pool_cnt\":%lu,\"capacity\":%lu,"
+			       "\"peak_capacity\":%lu,\"used_size\":%lu,"
+			       "\"create_cnt\":%lu,\"grow_cnt\":%lu}",
+			       (i ? "," : ""), stat[i].name,
+			       (unsigned long)stat[i].pool_cnt,
+			       (unsigned long)stat[i].peak_pool_cnt,
+			       (unsigned long)stat[i].capacity,
+			       (unsigned long)stat[i].peak_capacity,
+			       (unsigned long)stat[i].used_size,
+			       (unsigned long)stat[i].create_cnt,
+			       (unsigned long)stat[i].grow_cnt);
+	if (len < 0 || len >= end-p)
+	    return -1;
+	p += len;
+    }
+
+    len = pj_ansi_snprintf(p, end-p, "\n]}\n");
+    if (len < 0 || len >= end-p)
+	return -1;
+    p += len;
+
+    return (int)(p - buf);
+}
+
 static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
 {
 #if PJ_LOG_MAX_LEVEL >= 3
@@ -277,6 +843,33 @@ static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
     PJ_LOG(3,("cachpool", " Dumping caching pool:"));
     PJ_LOG(3,("cachpool", "   Capacity=%u, max_capacity=%u, used_cnt=%u", \
 			     cp->capacity, cp->max_capacity, cp->used_count));
+    if (cp->magazine_size) {
+	PJ_LOG(3,("cachpool", "   Magazines: %u, size=%u",
+			      pj_list_size(&cp->magazine_list),
+			      cp->magazine_size));
+    }
+    if (detail) {
+	pj_pool_category_stat stat[PJ_CACHING_POOL_MAX_CATEGORY];
+	unsigned i, cnt;
+
+	cnt = get_category_stat(cp, stat, PJ_ARRAY_SIZE(stat));
+	PJ_LOG(3,("cachpool", "  Dumping pool categories:"));
+	for (i=0; i<cnt; ++i) {
+	    PJ_LOG(3,("cachpool", "   %15s: %5u pools (peak %5u), "
+				  "%9u of %9u (%d%%) used (peak %9u), "
+				  "%u grows",
+				  stat[i].name,
+				  (unsigned)stat[i].pool_cnt,
+				  (unsigned)stat[i].peak_pool_cnt,
+				  (unsigned)stat[i].used_size,
+				  (unsigned)stat[i].capacity,
+				  (stat[i].capacity ? 
+				   (int)(stat[i].used_size * 100 /
+					 stat[i].capacity) : 0),
+				  (unsigned)stat[i].peak_capacity,
+				  (unsigned)stat[i].grow_cnt));
+	}
+    }
     if (detail) {
 	pj_pool_t *pool = (pj_pool_t*) cp->used_list.next;
 	pj_size_t total_used = 0, total_capacity = 0;
@@ -334,5 +927,26 @@ static void cpool_on_block_free(pj_pool_factory *f, pj_size_t sz)
 }
 
 
+static void cpool_on_pool_resize(pj_pool_factory *f, pj_pool_t *pool,
+				 pj_ssize_t delta)
+{
+    pj_caching_pool *cp = (pj_caching_pool*)f;
+    unsigned cat = FD_CAT(pool);
+    pj_pool_category_stat *stat;
+
+    if (cat >= NO_CAT)
+	return;
+
+    stat = &cp->category[cat];
+    if (delta > 0) {
+	STAT_ADD(stat->grow_cnt, 1);
+	update_peak(&stat->peak_capacity,
+		    STAT_ADD(stat->capacity, (pj_size_t)delta));
+    } else {
+	STAT_SUB(stat->capacity, (pj_size_t)-delta);
+    }
+}
+
+
 #endif	/* PJ_HAS_POOL_ALT_API */
 
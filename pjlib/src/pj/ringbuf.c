@@ -0,0 +1,273 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/ringbuf.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/lock.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+/* Without the atomic builtins, the sequence numbers and indexes are
+ * accessed with a mutex held.
+ */
+#define RB_HAS_LOCK	(PJ_HAS_THREADS && !PJ_HAS_ATOMIC_BUILTINS)
+
+/* Each slot starts with its sequence number:
+ *  - seq == pos: the slot is free for the producer at position pos.
+ *  - seq == pos + 1: the slot at position pos is filled, for the consumer.
+ * The consumer releases the slot for the next round, pos + slot_cnt.
+ */
+typedef struct slot_hdr
+{
+    pj_uint32_t	    seq;
+    pj_uint32_t	    pos;	/* Position, while the slot is acquired	    */
+} slot_hdr;
+
+#define SLOT_ALIGN	8
+#define SLOT_HDR_SIZE	((sizeof(slot_hdr) + SLOT_ALIGN-1) & ~(SLOT_ALIGN-1))
+
+struct pj_ringbuf_t
+{
+    /* Read only after creation */
+    char	   *slots;
+    unsigned	    slot_size;
+    unsigned	    stride;
+    pj_uint32_t	    slot_cnt;
+    pj_uint32_t	    mask;
+    unsigned	    flags;
+    pj_lock_t	   *lock;
+
+    char	    pad0[PJ_CACHE_LINE_SIZE];
+
+    /* Next position to produce */
+    pj_uint32_t	    tail;
+    char	    pad1[PJ_CACHE_LINE_SIZE];
+
+    /* Next position to consume, only used by the consumer */
+    pj_uint32_t	    head;
+    char	    pad2[PJ_CACHE_LINE_SIZE];
+};
+
+#define SLOT(rb, pos)	((slot_hdr*)((rb)->slots + \
+				     ((pos) & (rb)->mask) * (rb)->stride))
+
+#if RB_HAS_LOCK
+#   define RB_LOCK(rb)		pj_lock_acquire((rb)->lock)
+#   define RB_UNLOCK(rb)	pj_lock_release((rb)->lock)
+#else
+#   define RB_LOCK(rb)
+#   define RB_UNLOCK(rb)
+#endif
+
+#if PJ_HAS_ATOMIC_BUILTINS
+#   define LOAD_ACQ(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#   define LOAD_RLX(p)		__atomic_load_n(p, __ATOMIC_RELAXED)
+#   define STORE_REL(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+#   define STORE_RLX(p, v)	__atomic_store_n(p, v, __ATOMIC_RELAXED)
+#else
+#   define LOAD_ACQ(p)		(*(p))
+#   define LOAD_RLX(p)		(*(p))
+#   define STORE_REL(p, v)	(*(p) = (v))
+#   define STORE_RLX(p, v)	(*(p) = (v))
+#endif
+
+PJ_DEF(pj_status_t) pj_ringbuf_create(pj_pool_t *pool,
+				      unsigned slot_size,
+				      unsigned slot_cnt,
+				      unsigned flags,
+				      pj_ringbuf_t **p_rb)
+{
+    pj_ringbuf_t *rb;
+    pj_uint32_t cnt, i;
+    char *buf;
+
+    PJ_ASSERT_RETURN(pool && slot_size && slot_cnt && p_rb, PJ_EINVAL);
+    PJ_ASSERT_RETURN(slot_cnt <= 0x40000000, PJ_ETOOBIG);
+
+    for (cnt=1; cnt < slot_cnt; cnt <<= 1)
+	;
+
+    rb = PJ_POOL_ZALLOC_T(pool, pj_ringbuf_t);
+    rb->slot_size = slot_size;
+    rb->stride = (SLOT_HDR_SIZE + slot_size + SLOT_ALIGN-1) &
+		 ~(SLOT_ALIGN-1);
+    rb->slot_cnt = cnt;
+    rb->mask = cnt - 1;
+    rb->flags = flags;
+
+    /* Start the slots at cache line boundary */
+    buf = (char*) pj_pool_alloc(pool, rb->stride * cnt + PJ_CACHE_LINE_SIZE);
+    if (!buf)
+	return PJ_ENOMEM;
+    rb->slots = buf + ((PJ_CACHE_LINE_SIZE -
+			((pj_size_t)buf & (PJ_CACHE_LINE_SIZE-1))) &
+		       (PJ_CACHE_LINE_SIZE-1));
+
+    for (i=0; i<cnt; ++i)
+	SLOT(rb, i)->seq = i;
+
+#if RB_HAS_LOCK
+    {
+	pj_status_t status;
+
+	status = pj_lock_create_simple_mutex(pool, "ringbuf", &rb->lock);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+#endif
+
+    *p_rb = rb;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void*) pj_ringbuf_acquire(pj_ringbuf_t *rb)
+{
+    pj_uint32_t pos;
+    slot_hdr *slot;
+
+    RB_LOCK(rb);
+
+    pos = LOAD_RLX(&rb->tail);
+    for (;;) {
+	pj_int32_t dif;
+
+	slot = SLOT(rb, pos);
+	dif = (pj_int32_t)(LOAD_ACQ(&slot->seq) - pos);
+
+	if (dif < 0) {
+	    /* The consumer hasn't released the slot yet, full */
+	    RB_UNLOCK(rb);
+	    return NULL;
+	} else if (dif > 0) {
+	    /* Another producer took the position */
+	    pos = LOAD_RLX(&rb->tail);
+	} else if ((rb->flags & PJ_RINGBUF_MULTI_PRODUCER) == 0) {
+	    STORE_RLX(&rb->tail, pos + 1);
+	    break;
+	} else {
+#if PJ_HAS_ATOMIC_BUILTINS
+	    if (__atomic_compare_exchange_n(&rb->tail, &pos, pos + 1, 0,
+					    __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED))
+	    {
+		break;
+	    }
+#else
+	    rb->tail = pos + 1;
+	    break;
+#endif
+	}
+    }
+
+    RB_UNLOCK(rb);
+
+    slot->pos = pos;
+    return (char*)slot + SLOT_HDR_SIZE;
+}
+
+PJ_DEF(void) pj_ringbuf_commit(pj_ringbuf_t *rb, void *data)
+{
+    slot_hdr *slot = (slot_hdr*)((char*)data - SLOT_HDR_SIZE);
+
+    PJ_UNUSED_ARG(rb);
+    RB_LOCK(rb);
+    STORE_REL(&slot->seq, slot->pos + 1);
+    RB_UNLOCK(rb);
+}
+
+PJ_DEF(void*) pj_ringbuf_peek(pj_ringbuf_t *rb)
+{
+    slot_hdr *slot = SLOT(rb, rb->head);
+    pj_uint32_t seq;
+
+    RB_LOCK(rb);
+    seq = LOAD_ACQ(&slot->seq);
+    RB_UNLOCK(rb);
+
+    if (seq != rb->head + 1)
+	return NULL;
+
+    return (char*)slot + SLOT_HDR_SIZE;
+}
+
+PJ_DEF(void) pj_ringbuf_release(pj_ringbuf_t *rb)
+{
+    slot_hdr *slot = SLOT(rb, rb->head);
+
+    RB_LOCK(rb);
+    STORE_REL(&slot->seq, rb->head + rb->slot_cnt);
+    RB_UNLOCK(rb);
+
+    STORE_RLX(&rb->head, rb->head + 1);
+}
+
+PJ_DEF(pj_status_t) pj_ringbuf_push(pj_ringbuf_t *rb, const void *data)
+{
+    void *slot = pj_ringbuf_acquire(rb);
+
+    if (!slot)
+	return PJ_ETOOMANY;
+
+    pj_memcpy(slot, data, rb->slot_size);
+    pj_ringbuf_commit(rb, slot);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ringbuf_pop(pj_ringbuf_t *rb, void *data)
+{
+    void *slot = pj_ringbuf_peek(rb);
+
+    if (!slot)
+	return PJ_ENOTFOUND;
+
+    pj_memcpy(data, slot, rb->slot_size);
+    pj_ringbuf_release(rb);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(unsigned) pj_ringbuf_get_count(pj_ringbuf_t *rb)
+{
+    pj_uint32_t head, tail;
+
+    RB_LOCK(rb);
+    head = LOAD_RLX(&rb->head);
+    tail = LOAD_RLX(&rb->tail);
+    RB_UNLOCK(rb);
+
+    /* The tail counts the slots that are acquired but not committed yet */
+    return (pj_int32_t)(tail - head) > 0 ? tail - head : 0;
+}
+
+PJ_DEF(unsigned) pj_ringbuf_get_capacity(pj_ringbuf_t *rb)
+{
+    return rb->slot_cnt;
+}
+
+PJ_DEF(void) pj_ringbuf_destroy(pj_ringbuf_t *rb)
+{
+    PJ_ASSERT_ON_FAIL(rb, return);
+
+#if RB_HAS_LOCK
+    if (rb->lock) {
+	pj_lock_destroy(rb->lock);
+	rb->lock = NULL;
+    }
+#endif
+}
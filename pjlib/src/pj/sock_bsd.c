@@ -17,6 +17,10 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
  */
+/* Needed for recvmmsg()/sendmmsg() declarations on glibc */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif
 #include <pj/sock.h>
 #include <pj/os.h>
 #include <pj/assert.h>
@@ -135,6 +139,11 @@ const pj_uint16_t PJ_SO_RCVBUF  = SO_RCVBUF;
 const pj_uint16_t PJ_SO_SNDBUF  = SO_SNDBUF;
 const pj_uint16_t PJ_TCP_NODELAY= TCP_NODELAY;
 const pj_uint16_t PJ_SO_REUSEADDR= SO_REUSEADDR;
+#ifdef SO_REUSEPORT
+const pj_uint16_t PJ_SO_REUSEPORT = SO_REUSEPORT;
+#else
+const pj_uint16_t PJ_SO_REUSEPORT = 0xFFFF;
+#endif
 #ifdef SO_NOSIGPIPE
 const pj_uint16_t PJ_SO_NOSIGPIPE = SO_NOSIGPIPE;
 #else
@@ -738,6 +747,194 @@ PJ_DEF(pj_status_t) pj_sock_recvfrom(pj_sock_t sock,
     }
 }
 
+/*
+ * Maximum number of datagrams given to a single recvmmsg()/sendmmsg()
+ * call. Larger batches are split into several calls.
+ */
+#define MMSG_CHUNK	64
+
+/*
+ * Used to stop the batch receive from blocking after the first datagram.
+ * Without MSG_DONTWAIT, the emulation relies on the socket being
+ * non-blocking.
+ */
+#ifdef MSG_DONTWAIT
+#   define MMSG_DONTWAIT	MSG_DONTWAIT
+#else
+#   define MMSG_DONTWAIT	0
+#endif
+
+/*
+ * Receive multiple datagrams.
+ */
+PJ_DEF(pj_status_t) pj_sock_recvmmsg(pj_sock_t sock,
+				     pj_sock_msg msg[],
+				     unsigned *count,
+				     unsigned flags)
+{
+#if defined(PJ_SOCK_HAS_RECVMMSG) && PJ_SOCK_HAS_RECVMMSG!=0
+    struct mmsghdr hdr[MMSG_CHUNK];
+    struct iovec iov[MMSG_CHUNK];
+    unsigned total = 0;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msg && count && *count, PJ_EINVAL);
+
+    while (total < *count) {
+	unsigned i, n = *count - total;
+	int rc;
+
+	if (n > MMSG_CHUNK)
+	    n = MMSG_CHUNK;
+
+	pj_bzero(hdr, n * sizeof(hdr[0]));
+	for (i=0; i<n; ++i) {
+	    pj_sock_msg *m = &msg[total+i];
+
+	    iov[i].iov_base = m->buf;
+	    iov[i].iov_len = m->len;
+	    hdr[i].msg_hdr.msg_iov = &iov[i];
+	    hdr[i].msg_hdr.msg_iovlen = 1;
+	    hdr[i].msg_hdr.msg_name = &m->addr;
+	    hdr[i].msg_hdr.msg_namelen = m->addr_len;
+	}
+
+	/* Only wait for the first datagram (and only in the first call) */
+	rc = recvmmsg(sock, hdr, n, 
+		      flags | (total ? MMSG_DONTWAIT : MSG_WAITFORONE), NULL);
+	if (rc < 0) {
+	    if (total)
+		break;
+	    *count = 0;
+	    return PJ_RETURN_OS_ERROR(pj_get_native_netos_error());
+	}
+
+	for (i=0; i<(unsigned)rc; ++i) {
+	    pj_sock_msg *m = &msg[total+i];
+
+	    m->len = hdr[i].msg_len;
+	    m->addr_len = hdr[i].msg_hdr.msg_namelen;
+	    PJ_SOCKADDR_RESET_LEN(&m->addr);
+	}
+
+	total += rc;
+	if ((unsigned)rc < n)
+	    break;
+    }
+
+    *count = total;
+    return PJ_SUCCESS;
+
+#else
+    unsigned i;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msg && count && *count, PJ_EINVAL);
+
+    for (i=0; i<*count; ++i) {
+	pj_status_t status;
+
+	status = pj_sock_recvfrom(sock, msg[i].buf, &msg[i].len,
+				  (i ? (flags | MMSG_DONTWAIT) : flags),
+				  &msg[i].addr, &msg[i].addr_len);
+	if (status != PJ_SUCCESS) {
+	    if (i)
+		break;
+	    *count = 0;
+	    return status;
+	}
+    }
+
+    *count = i;
+    return PJ_SUCCESS;
+#endif
+}
+
+/*
+ * Send multiple datagrams.
+ */
+PJ_DEF(pj_status_t) pj_sock_sendmmsg(pj_sock_t sock,
+				     pj_sock_msg msg[],
+				     unsigned *count,
+				     unsigned flags)
+{
+#if defined(PJ_SOCK_HAS_SENDMMSG) && PJ_SOCK_HAS_SENDMMSG!=0
+    struct mmsghdr hdr[MMSG_CHUNK];
+    struct iovec iov[MMSG_CHUNK];
+    unsigned total = 0;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msg && count && *count, PJ_EINVAL);
+
+    while (total < *count) {
+	unsigned i, n = *count - total;
+	int rc;
+
+	if (n > MMSG_CHUNK)
+	    n = MMSG_CHUNK;
+
+	pj_bzero(hdr, n * sizeof(hdr[0]));
+	for (i=0; i<n; ++i) {
+	    pj_sock_msg *m = &msg[total+i];
+
+	    iov[i].iov_base = m->buf;
+	    iov[i].iov_len = m->len;
+	    hdr[i].msg_hdr.msg_iov = &iov[i];
+	    hdr[i].msg_hdr.msg_iovlen = 1;
+	    if (m->addr_len) {
+		CHECK_ADDR_LEN(&m->addr, m->addr_len);
+		hdr[i].msg_hdr.msg_name = &m->addr;
+		hdr[i].msg_hdr.msg_namelen = m->addr_len;
+	    }
+	}
+
+	rc = sendmmsg(sock, hdr, n, flags);
+	if (rc < 0) {
+	    if (total)
+		break;
+	    *count = 0;
+	    return PJ_RETURN_OS_ERROR(pj_get_native_netos_error());
+	}
+
+	for (i=0; i<(unsigned)rc; ++i)
+	    msg[total+i].len = hdr[i].msg_len;
+
+	total += rc;
+	if ((unsigned)rc < n)
+	    break;
+    }
+
+    *count = total;
+    return PJ_SUCCESS;
+
+#else
+    unsigned i;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(msg && count && *count, PJ_EINVAL);
+
+    for (i=0; i<*count; ++i) {
+	pj_status_t status;
+
+	if (msg[i].addr_len) {
+	    status = pj_sock_sendto(sock, msg[i].buf, &msg[i].len, flags,
+				    &msg[i].addr, msg[i].addr_len);
+	} else {
+	    status = pj_sock_send(sock, msg[i].buf, &msg[i].len, flags);
+	}
+	if (status != PJ_SUCCESS) {
+	    if (i)
+		break;
+	    *count = 0;
+	    return status;
+	}
+    }
+
+    *count = i;
+    return PJ_SUCCESS;
+#endif
+}
+
 /*
  * Get socket option.
  */
@@ -43,6 +43,7 @@ PJ_DEF(void) pj_ssl_sock_param_default(pj_ssl_sock_param *param)
 
     /* Security config */
     param->proto = PJ_SSL_SOCK_PROTO_DEFAULT;
+    param->sess_cache = PJ_TRUE;
 }
 
 
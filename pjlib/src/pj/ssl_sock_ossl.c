@@ -171,6 +171,15 @@ struct pj_ssl_sock_t
     SSL			 *ossl_ssl;
     BIO			 *ossl_rbio;
     BIO			 *ossl_wbio;
+
+    struct ssl_ctx_entry *ctx_entry;	/* shared SSL context, if any	    */
+    pj_str_t		  sess_key;	/* client session key		    */
+
+    pj_grp_lock_t	 *grp_lock;	/* handshake task ref, also key lock*/
+    pj_bool_t		  closed;
+    pj_bool_t		  hs_busy;	/* handshake task is queued/running */
+    pj_bool_t		  hs_again;	/* new data while task is running   */
+    pj_status_t		  hs_read_err;	/* read error for handshake task    */
 };
 
 
@@ -292,6 +301,53 @@ static struct openssl_ciphers_t {
 static int sslsock_idx;
 
 
+/*
+ * Shared SSL contexts for session resumption. The contexts are shared by
+ * the secure sockets with the same protocol, role, verification settings
+ * and certificate files, and the recently used ones are kept after their
+ * last socket is gone. The list and the statistics are protected by the
+ * pjlib critical section, as they are only accessed once per connection.
+ */
+
+/* Client session, to be resumed on the next connection with the key */
+typedef struct client_sess_t
+{
+    char		 key[PJ_INET6_ADDRSTRLEN + 10 + 256];
+    SSL_SESSION		*sess;
+    pj_uint32_t		 last_use;
+} client_sess_t;
+
+typedef struct ssl_ctx_entry
+{
+    PJ_DECL_LIST_MEMBER(struct ssl_ctx_entry);
+    pj_pool_t		*pool;
+    SSL_CTX		*ctx;
+    pj_ssl_sock_proto	 proto;
+    pj_bool_t		 is_server;
+    pj_bool_t		 verify_peer;
+    pj_bool_t		 require_client_cert;
+    pj_ssl_cert_t	 cert;
+    unsigned		 ref_cnt;
+    client_sess_t	*client_sess;
+    pj_uint32_t		 sess_clock;
+} ssl_ctx_entry;
+
+/* Shared SSL contexts, most recently used first */
+static ssl_ctx_entry ssl_ctx_list;
+static unsigned ssl_ctx_cnt;
+static pj_ssl_sock_sess_stat sess_stat;
+
+/* Private pool factory of the shared SSL contexts. The contexts outlive
+ * the sockets that created them and are only freed on pj_shutdown(), by
+ * which time the application's pool factory may already be gone.
+ */
+static pj_caching_pool ssl_ctx_cp;
+static pj_bool_t ssl_ctx_cp_inited;
+static pj_bool_t ssl_ctx_cleanup_registered;
+
+static void ssl_ctx_cache_cleanup(void);
+
+
 /* Initialize OpenSSL */
 static pj_status_t init_openssl(void)
 {
@@ -359,6 +415,9 @@ static pj_status_t init_openssl(void)
     /* Create OpenSSL application data index for SSL socket */
     sslsock_idx = SSL_get_ex_new_index(0, "SSL socket", NULL, NULL, NULL);
 
+    /* Init shared SSL contexts */
+    pj_list_init(&ssl_ctx_list);
+
     return PJ_SUCCESS;
 }
 
@@ -484,21 +543,14 @@ static int verify_cb(int preverify_ok, X509_STORE_CTX *x509_ctx)
 static pj_status_t set_cipher_list(pj_ssl_sock_t *ssock);
 
 
-/* Create and initialize new SSL context and instance */
-static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
+/* Create new SSL context */
+static pj_status_t create_ssl_ctx(pj_ssl_sock_t *ssock, pj_ssl_cert_t *cert,
+				  SSL_CTX **p_ctx)
 {
     SSL_METHOD *ssl_method;
     SSL_CTX *ctx;
-    pj_ssl_cert_t *cert;
-    int mode, rc;
+    int rc;
     pj_status_t status;
-        
-    pj_assert(ssock);
-
-    cert = ssock->cert;
-
-    /* Make sure OpenSSL library has been initialized */
-    init_openssl();
 
     /* Determine SSL method to use */
     switch (ssock->param.proto) {
@@ -585,8 +637,335 @@ static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
 	}
     }
 
+    *p_ctx = ctx;
+    return PJ_SUCCESS;
+}
+
+
+/* Check if the shared SSL context can be used by the SSL socket */
+static pj_bool_t match_shared_ctx(const ssl_ctx_entry *e,
+				  const pj_ssl_sock_t *ssock,
+				  const pj_ssl_cert_t *cert)
+{
+    return e->proto == ssock->param.proto &&
+	   e->is_server == ssock->is_server &&
+	   e->verify_peer == ssock->param.verify_peer &&
+	   e->require_client_cert == ssock->param.require_client_cert &&
+	   pj_strcmp(&e->cert.CA_file, &cert->CA_file) == 0 &&
+	   pj_strcmp(&e->cert.cert_file, &cert->cert_file) == 0 &&
+	   pj_strcmp(&e->cert.privkey_file, &cert->privkey_file) == 0 &&
+	   pj_strcmp(&e->cert.privkey_pass, &cert->privkey_pass) == 0;
+}
+
+static ssl_ctx_entry *find_shared_ctx(const pj_ssl_sock_t *ssock,
+				      const pj_ssl_cert_t *cert)
+{
+    ssl_ctx_entry *e;
+
+    for (e = ssl_ctx_list.next; e != &ssl_ctx_list; e = e->next) {
+	if (match_shared_ctx(e, ssock, cert))
+	    return e;
+    }
+    return NULL;
+}
+
+static void destroy_shared_ctx(ssl_ctx_entry *e)
+{
+    if (e->client_sess) {
+	unsigned i;
+
+	for (i = 0; i < PJ_SSL_SOCK_CLIENT_SESS_CNT; ++i) {
+	    if (e->client_sess[i].sess)
+		SSL_SESSION_free(e->client_sess[i].sess);
+	}
+    }
+    SSL_CTX_free(e->ctx);
+    pj_pool_release(e->pool);
+}
+
+/* Free the shared SSL contexts that are no longer used, on pj_shutdown() */
+static void ssl_ctx_cache_cleanup(void)
+{
+    ssl_ctx_entry *e;
+
+    pj_enter_critical_section();
+    e = ssl_ctx_list.next;
+    while (e != &ssl_ctx_list) {
+	ssl_ctx_entry *next = e->next;
+
+	if (e->ref_cnt == 0) {
+	    pj_list_erase(e);
+	    --ssl_ctx_cnt;
+	    destroy_shared_ctx(e);
+	}
+	e = next;
+    }
+
+    /* Contexts still used by open sockets keep the factory alive */
+    if (ssl_ctx_cp_inited && pj_list_empty(&ssl_ctx_list)) {
+	pj_caching_pool_destroy(&ssl_ctx_cp);
+	ssl_ctx_cp_inited = PJ_FALSE;
+    }
+    ssl_ctx_cleanup_registered = PJ_FALSE;
+    pj_leave_critical_section();
+}
+
+/* Keep the session of an outgoing connection, to resume it later */
+static int on_new_client_sess(SSL *ossl_ssl, SSL_SESSION *sess)
+{
+    pj_ssl_sock_t *ssock;
+    ssl_ctx_entry *e;
+    client_sess_t *slot = NULL;
+    SSL_SESSION *old_sess;
+    unsigned i;
+
+    ssock = (pj_ssl_sock_t*) SSL_get_ex_data(ossl_ssl, sslsock_idx);
+    if (!ssock || !ssock->ctx_entry || !ssock->sess_key.slen)
+	return 0;
+
+    e = ssock->ctx_entry;
+
+    pj_enter_critical_section();
+
+    /* Replace the session with the same key, or the least recently used
+     * one (unused slots come first).
+     */
+    for (i = 0; i < PJ_SSL_SOCK_CLIENT_SESS_CNT; ++i) {
+	client_sess_t *cs = &e->client_sess[i];
+
+	if (cs->sess && pj_ansi_strcmp(cs->key, ssock->sess_key.ptr) == 0) {
+	    slot = cs;
+	    break;
+	}
+	if (!slot || cs->last_use < slot->last_use)
+	    slot = cs;
+    }
+
+    old_sess = slot->sess;
+    slot->sess = sess;
+    pj_ansi_strcpy(slot->key, ssock->sess_key.ptr);
+    slot->last_use = ++e->sess_clock;
+
+    pj_leave_critical_section();
+
+    if (old_sess)
+	SSL_SESSION_free(old_sess);
+
+    /* We keep the reference to the session */
+    return 1;
+}
+
+/* Offer the last session with the remote address and server name */
+static void resume_client_sess(pj_ssl_sock_t *ssock)
+{
+    ssl_ctx_entry *e = ssock->ctx_entry;
+    char addr[PJ_INET6_ADDRSTRLEN+10];
+    unsigned i;
+
+    if (!e || !e->client_sess)
+	return;
+
+    if (!ssock->sess_key.ptr) {
+	ssock->sess_key.ptr = (char*)
+			      pj_pool_alloc(ssock->pool,
+					    sizeof(e->client_sess[0].key));
+    }
+    ssock->sess_key.slen = pj_ansi_snprintf(
+				ssock->sess_key.ptr,
+				sizeof(e->client_sess[0].key), "%s/%.*s",
+				pj_sockaddr_print(&ssock->rem_addr, addr,
+						  sizeof(addr), 3),
+				(int)ssock->param.server_name.slen,
+				ssock->param.server_name.ptr);
+
+    pj_enter_critical_section();
+    for (i = 0; i < PJ_SSL_SOCK_CLIENT_SESS_CNT; ++i) {
+	client_sess_t *cs = &e->client_sess[i];
+
+	if (cs->sess && pj_ansi_strcmp(cs->key, ssock->sess_key.ptr) == 0) {
+	    SSL_set_session(ssock->ossl_ssl, cs->sess);
+	    cs->last_use = ++e->sess_clock;
+	    break;
+	}
+    }
+    pj_leave_critical_section();
+}
+
+/* Get the shared SSL context for the SSL socket, creating it if needed */
+static pj_status_t get_shared_ctx(pj_ssl_sock_t *ssock)
+{
+    pj_ssl_cert_t no_cert;
+    pj_ssl_cert_t *cert = ssock->cert;
+    ssl_ctx_entry *e, *other;
+    pj_pool_t *pool;
+    pj_status_t status;
+
+    if (!cert) {
+	pj_bzero(&no_cert, sizeof(no_cert));
+	cert = &no_cert;
+    }
+
+    pj_enter_critical_section();
+    e = find_shared_ctx(ssock, cert);
+    if (e) {
+	++e->ref_cnt;
+	pj_list_erase(e);
+	pj_list_push_front(&ssl_ctx_list, e);
+    }
+    pj_leave_critical_section();
+
+    if (e) {
+	ssock->ctx_entry = e;
+	ssock->ossl_ctx = e->ctx;
+	return PJ_SUCCESS;
+    }
+
+    /* Create the context outside the critical section, as loading the
+     * certificate files may take a while.
+     */
+    pj_enter_critical_section();
+    if (!ssl_ctx_cp_inited) {
+	pj_caching_pool_init(&ssl_ctx_cp, NULL, 0);
+	ssl_ctx_cp_inited = PJ_TRUE;
+    }
+    if (!ssl_ctx_cleanup_registered) {
+	/* pj_shutdown() clears the exit handlers, register again after
+	 * the library is re-initialized.
+	 */
+	pj_atexit(&ssl_ctx_cache_cleanup);
+	ssl_ctx_cleanup_registered = PJ_TRUE;
+    }
+    pool = pj_pool_create(&ssl_ctx_cp.factory, "sslctx%p", 512, 512, NULL);
+    pj_leave_critical_section();
+    if (!pool)
+	return PJ_ENOMEM;
+
+    e = PJ_POOL_ZALLOC_T(pool, ssl_ctx_entry);
+    e->pool = pool;
+    e->proto = ssock->param.proto;
+    e->is_server = ssock->is_server;
+    e->verify_peer = ssock->param.verify_peer;
+    e->require_client_cert = ssock->param.require_client_cert;
+    pj_strdup_with_null(pool, &e->cert.CA_file, &cert->CA_file);
+    pj_strdup_with_null(pool, &e->cert.cert_file, &cert->cert_file);
+    pj_strdup_with_null(pool, &e->cert.privkey_file, &cert->privkey_file);
+    pj_strdup_with_null(pool, &e->cert.privkey_pass, &cert->privkey_pass);
+    e->ref_cnt = 1;
+
+    /* The password callback uses the copy of the credential */
+    status = create_ssl_ctx(ssock, &e->cert, &e->ctx);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return status;
+    }
+
+    if (e->is_server) {
+	/* Session cache. Session tickets are enabled by default, and the
+	 * ticket keys are per context, hence shared too.
+	 */
+	SSL_CTX_set_session_cache_mode(e->ctx, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_sess_set_cache_size(e->ctx, PJ_SSL_SOCK_SESS_CACHE_SIZE);
+	SSL_CTX_set_session_id_context(e->ctx,
+				       (const unsigned char*)"pjlib", 5);
+    } else {
+	e->client_sess = (client_sess_t*)
+			 pj_pool_calloc(pool, PJ_SSL_SOCK_CLIENT_SESS_CNT,
+					sizeof(client_sess_t));
+	SSL_CTX_set_session_cache_mode(e->ctx, SSL_SESS_CACHE_CLIENT |
+					       SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(e->ctx, &on_new_client_sess);
+    }
+
+    /* Another socket may have created the same context meanwhile */
+    pj_enter_critical_section();
+    other = find_shared_ctx(ssock, cert);
+    if (other) {
+	++other->ref_cnt;
+    } else {
+	pj_list_push_front(&ssl_ctx_list, e);
+	++ssl_ctx_cnt;
+    }
+    pj_leave_critical_section();
+
+    if (other) {
+	destroy_shared_ctx(e);
+	e = other;
+    }
+
+    ssock->ctx_entry = e;
+    ssock->ossl_ctx = e->ctx;
+    return PJ_SUCCESS;
+}
+
+/* Release the shared SSL context, and free the least recently used unused
+ * context when there are too many of them.
+ */
+static void release_shared_ctx(ssl_ctx_entry *e)
+{
+    ssl_ctx_entry *victim = NULL;
+
+    pj_enter_critical_section();
+    if (--e->ref_cnt == 0 && ssl_ctx_cnt > PJ_SSL_SOCK_CTX_CACHE_SIZE) {
+	for (victim = ssl_ctx_list.prev; victim != &ssl_ctx_list;
+	     victim = victim->prev)
+	{
+	    if (victim->ref_cnt == 0)
+		break;
+	}
+	if (victim != &ssl_ctx_list) {
+	    pj_list_erase(victim);
+	    --ssl_ctx_cnt;
+	} else {
+	    victim = NULL;
+	}
+    }
+    pj_leave_critical_section();
+
+    if (victim)
+	destroy_shared_ctx(victim);
+}
+
+/* Update session resumption statistics on successful handshake */
+static void update_sess_stat(pj_ssl_sock_t *ssock)
+{
+    pj_bool_t reused = SSL_session_reused(ssock->ossl_ssl);
+
+    pj_enter_critical_section();
+    if (ssock->is_server) {
+	if (reused) ++sess_stat.server_hit; else ++sess_stat.server_miss;
+    } else {
+	if (reused) ++sess_stat.client_hit; else ++sess_stat.client_miss;
+    }
+    pj_leave_critical_section();
+}
+
+
+/* Create and initialize new SSL context and instance */
+static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
+{
+    int mode;
+    pj_status_t status;
+        
+    pj_assert(ssock);
+
+    /* Make sure OpenSSL library has been initialized */
+    init_openssl();
+
+    /* Get SSL context */
+    if (ssock->param.sess_cache) {
+	status = get_shared_ctx(ssock);
+    } else {
+	status = create_ssl_ctx(ssock, ssock->cert, &ssock->ossl_ctx);
+#ifdef SSL_OP_NO_TICKET
+	/* The tickets couldn't be decrypted by other contexts anyway */
+	if (status == PJ_SUCCESS && ssock->is_server)
+	    SSL_CTX_set_options(ssock->ossl_ctx, SSL_OP_NO_TICKET);
+#endif
+    }
+    if (status != PJ_SUCCESS)
+	return status;
+
     /* Create SSL instance */
-    ssock->ossl_ctx = ctx;
     ssock->ossl_ssl = SSL_new(ssock->ossl_ctx);
     if (ssock->ossl_ssl == NULL) {
 	return GET_SSL_STATUS(ssock);
@@ -621,15 +1000,23 @@ static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
 /* Destroy SSL context and instance */
 static void destroy_ssl(pj_ssl_sock_t *ssock)
 {
-    /* Destroy SSL instance */
+    /* Destroy SSL instance, the handshake task may be using it */
     if (ssock->ossl_ssl) {
+	pj_lock_acquire(ssock->write_mutex);
 	SSL_shutdown(ssock->ossl_ssl);
 	SSL_free(ssock->ossl_ssl); /* this will also close BIOs */
 	ssock->ossl_ssl = NULL;
+	ssock->ossl_rbio = NULL;
+	ssock->ossl_wbio = NULL;
+	pj_lock_release(ssock->write_mutex);
     }
 
-    /* Destroy SSL context */
-    if (ssock->ossl_ctx) {
+    /* Destroy or release SSL context */
+    if (ssock->ctx_entry) {
+	release_shared_ctx(ssock->ctx_entry);
+	ssock->ctx_entry = NULL;
+	ssock->ossl_ctx = NULL;
+    } else if (ssock->ossl_ctx) {
 	SSL_CTX_free(ssock->ossl_ctx);
 	ssock->ossl_ctx = NULL;
     }
@@ -970,8 +1357,10 @@ static pj_bool_t on_handshake_complete(pj_ssl_sock_t *ssock,
     }
 
     /* Update certificates info on successful handshake */
-    if (status == PJ_SUCCESS)
+    if (status == PJ_SUCCESS) {
 	update_certs_info(ssock);
+	update_sess_stat(ssock);
+    }
 
     /* Accepting */
     if (ssock->is_server) {
@@ -1239,7 +1628,7 @@ static pj_status_t flush_write_bio(pj_ssl_sock_t *ssock,
     pj_lock_acquire(ssock->write_mutex);
 
     /* Check if there is data in write BIO, flush it if any */
-    if (!BIO_pending(ssock->ossl_wbio)) {
+    if (!ssock->ossl_wbio || !BIO_pending(ssock->ossl_wbio)) {
 	pj_lock_release(ssock->write_mutex);
 	return PJ_SUCCESS;
     }
@@ -1334,11 +1723,23 @@ static void on_timer(pj_timer_heap_t *th, struct pj_timer_entry *te)
 static pj_status_t do_handshake(pj_ssl_sock_t *ssock)
 {
     pj_status_t status;
+    pj_bool_t finished;
     int err;
 
-    /* Perform SSL handshake */
+    /* Perform SSL handshake. The SSL instance may have been destroyed
+     * if this is run by the handshake task.
+     */
     pj_lock_acquire(ssock->write_mutex);
+    if (!ssock->ossl_ssl) {
+	pj_lock_release(ssock->write_mutex);
+	return PJ_ECANCELLED;
+    }
     err = SSL_do_handshake(ssock->ossl_ssl);
+    if (err < 0)
+	err = SSL_get_error(ssock->ossl_ssl, err);
+    else
+	err = SSL_ERROR_NONE;
+    finished = SSL_is_init_finished(ssock->ossl_ssl);
     pj_lock_release(ssock->write_mutex);
 
     /* SSL_do_handshake() may put some pending data into SSL write BIO, 
@@ -1349,18 +1750,14 @@ static pj_status_t do_handshake(pj_ssl_sock_t *ssock)
 	return status;
     }
 
-    if (err < 0) {
-	err = SSL_get_error(ssock->ossl_ssl, err);
-	if (err != SSL_ERROR_NONE && err != SSL_ERROR_WANT_READ) 
-	{
-	    /* Handshake fails */
-	    status = STATUS_FROM_SSL_ERR(ssock, err);
-	    return status;
-	}
+    if (err != SSL_ERROR_NONE && err != SSL_ERROR_WANT_READ) {
+	/* Handshake fails */
+	status = STATUS_FROM_SSL_ERR(ssock, err);
+	return status;
     }
 
     /* Check if handshake has been completed */
-    if (SSL_is_init_finished(ssock->ossl_ssl)) {
+    if (finished) {
 	ssock->ssl_state = SSL_STATE_ESTABLISHED;
 	return PJ_SUCCESS;
     }
@@ -1369,6 +1766,95 @@ static pj_status_t do_handshake(pj_ssl_sock_t *ssock)
 }
 
 
+/* Run by the handshake executor: perform the handshake step(s) for the
+ * data received so far, notify the result, then resume reading.
+ */
+static void handshake_task(void *arg)
+{
+    pj_ssl_sock_t *ssock = (pj_ssl_sock_t*)arg;
+    pj_status_t status;
+
+    for (;;) {
+	pj_lock_acquire(ssock->write_mutex);
+	if (ssock->closed || ssock->ssl_state != SSL_STATE_HANDSHAKING) {
+	    ssock->hs_busy = PJ_FALSE;
+	    pj_lock_release(ssock->write_mutex);
+	    return;
+	}
+	ssock->hs_again = PJ_FALSE;
+	status = ssock->hs_read_err;
+	pj_lock_release(ssock->write_mutex);
+
+	/* Don't hold the mutex here, as do_handshake() sends data */
+	if (status == PJ_SUCCESS)
+	    status = do_handshake(ssock);
+
+	pj_lock_acquire(ssock->write_mutex);
+	if (status != PJ_EPENDING || !ssock->hs_again) {
+	    ssock->hs_busy = PJ_FALSE;
+	    pj_lock_release(ssock->write_mutex);
+	    break;
+	}
+	pj_lock_release(ssock->write_mutex);
+    }
+
+    /* The group lock is also the lock of the active socket's ioqueue
+     * key. Holding it keeps pj_ssl_sock_close() from closing the active
+     * socket until the reads are resumed.
+     */
+    pj_grp_lock_acquire(ssock->grp_lock);
+
+    if (ssock->closed ||
+	(status != PJ_EPENDING && !on_handshake_complete(ssock, status)))
+    {
+	pj_grp_lock_release(ssock->grp_lock);
+	return;
+    }
+
+    /* The application may have closed the socket in the callback */
+    if (!ssock->closed && ssock->asock)
+	pj_activesock_resume_read(ssock->asock);
+
+    pj_grp_lock_release(ssock->grp_lock);
+}
+
+
+/* Queue the handshake step to the handshake executor, pausing the reads
+ * until it is done. If the task is already queued or running, it will
+ * pick up the new data by itself.
+ */
+static pj_status_t queue_handshake(pj_ssl_sock_t *ssock,
+				   pj_status_t read_status)
+{
+    pj_status_t status;
+
+    pj_lock_acquire(ssock->write_mutex);
+    if (read_status != PJ_SUCCESS)
+	ssock->hs_read_err = read_status;
+    if (ssock->hs_busy) {
+	ssock->hs_again = PJ_TRUE;
+	pj_lock_release(ssock->write_mutex);
+	return PJ_SUCCESS;
+    }
+    ssock->hs_busy = PJ_TRUE;
+    pj_lock_release(ssock->write_mutex);
+
+    pj_activesock_pause_read(ssock->asock);
+
+    status = pj_executor_submit(ssock->param.handshake_exec,
+				&handshake_task, ssock, ssock->grp_lock, 0);
+    if (status != PJ_SUCCESS) {
+	/* Do it here then */
+	pj_lock_acquire(ssock->write_mutex);
+	ssock->hs_busy = PJ_FALSE;
+	pj_lock_release(ssock->write_mutex);
+	pj_activesock_resume_read(ssock->asock);
+    }
+
+    return status;
+}
+
+
 /*
  *******************************************************************
  * Active socket callbacks.
@@ -1387,8 +1873,12 @@ static pj_bool_t asock_on_data_read (pj_activesock_t *asock,
 
     /* Socket error or closed */
     if (data && size > 0) {
-	/* Consume the whole data */
+	/* Consume the whole data. The read BIO may be in use by the
+	 * handshake task.
+	 */
+	pj_lock_acquire(ssock->write_mutex);
 	nwritten = BIO_write(ssock->ossl_rbio, data, (int)size);
+	pj_lock_release(ssock->write_mutex);
 	if (nwritten < size) {
 	    status = GET_SSL_STATUS(ssock);
 	    goto on_error;
@@ -1399,6 +1889,13 @@ static pj_bool_t asock_on_data_read (pj_activesock_t *asock,
     if (ssock->ssl_state == SSL_STATE_HANDSHAKING) {
 	pj_bool_t ret = PJ_TRUE;
 
+	/* The handshake task will notify the result */
+	if (ssock->param.handshake_exec &&
+	    queue_handshake(ssock, status) == PJ_SUCCESS)
+	{
+	    return PJ_TRUE;
+	}
+
 	if (status == PJ_SUCCESS)
 	    status = do_handshake(ssock);
 
@@ -1536,7 +2033,14 @@ static pj_bool_t asock_on_data_sent (pj_activesock_t *asock,
     if (ssock->ssl_state == SSL_STATE_HANDSHAKING) {
 	/* Initial handshaking */
 	pj_status_t status;
-	
+
+	/* Don't run the handshake alongside the handshake task */
+	if (ssock->param.handshake_exec &&
+	    queue_handshake(ssock, PJ_SUCCESS) == PJ_SUCCESS)
+	{
+	    return PJ_TRUE;
+	}
+
 	status = do_handshake(ssock);
 	/* Not pending is either success or failed */
 	if (status != PJ_EPENDING)
@@ -1645,6 +2149,7 @@ static pj_bool_t asock_on_accept_complete (pj_activesock_t *asock,
     asock_cfg.async_cnt = ssock->param.async_cnt;
     asock_cfg.concurrency = ssock->param.concurrency;
     asock_cfg.whole_data = PJ_TRUE;
+    asock_cfg.grp_lock = ssock->grp_lock;
 
     pj_bzero(&asock_cb, sizeof(asock_cb));
     asock_cb.on_data_read = asock_on_data_read;
@@ -1774,6 +2279,9 @@ static pj_bool_t asock_on_connect_complete (pj_activesock_t *asock,
     }
 #endif
 
+    /* Resume the previous session with the server, if any */
+    resume_client_sess(ssock);
+
     /* Start SSL handshake */
     ssock->ssl_state = SSL_STATE_HANDSHAKING;
     SSL_set_connect_state(ssock->ossl_ssl);
@@ -1907,6 +2415,18 @@ PJ_DEF(pj_bool_t) pj_ssl_cipher_is_supported(pj_ssl_cipher cipher)
 }
 
 
+/* Group lock destroy handler */
+static void ssl_sock_on_destroy(void *arg)
+{
+    pj_ssl_sock_t *ssock = (pj_ssl_sock_t*)arg;
+    pj_pool_t *pool = ssock->pool;
+
+    pj_lock_destroy(ssock->write_mutex);
+    ssock->pool = NULL;
+    pj_pool_release(pool);
+}
+
+
 /*
  * Create SSL socket instance. 
  */
@@ -1940,6 +2460,17 @@ PJ_DEF(pj_status_t) pj_ssl_sock_create (pj_pool_t *pool,
     if (status != PJ_SUCCESS)
 	return status;
 
+    /* The handshake task holds a reference while it is queued */
+    if (param->handshake_exec) {
+	status = pj_grp_lock_create(pool, NULL, &ssock->grp_lock);
+	if (status != PJ_SUCCESS)
+	    return status;
+
+	pj_grp_lock_add_ref(ssock->grp_lock);
+	pj_grp_lock_add_handler(ssock->grp_lock, pool, ssock,
+				&ssl_sock_on_destroy);
+    }
+
     /* Init secure socket param */
     ssock->param = *param;
     ssock->param.read_buffer_size = ((ssock->param.read_buffer_size+7)>>3)<<3;
@@ -1973,15 +2504,29 @@ PJ_DEF(pj_status_t) pj_ssl_sock_close(pj_ssl_sock_t *ssock)
 
     PJ_ASSERT_RETURN(ssock, PJ_EINVAL);
 
-    if (!ssock->pool)
+    if (!ssock->pool || ssock->closed)
 	return PJ_SUCCESS;
 
+    /* Wait for the handshake task to finish with the active socket */
+    if (ssock->grp_lock) {
+	pj_grp_lock_acquire(ssock->grp_lock);
+	ssock->closed = PJ_TRUE;
+    }
+
     if (ssock->timer.id != TIMER_NONE) {
 	pj_timer_heap_cancel(ssock->param.timer_heap, &ssock->timer);
 	ssock->timer.id = TIMER_NONE;
     }
 
     reset_ssl_sock_state(ssock);
+
+    /* The rest is destroyed after the queued handshake task, if any */
+    if (ssock->grp_lock) {
+	pj_grp_lock_release(ssock->grp_lock);
+	pj_grp_lock_dec_ref(ssock->grp_lock);
+	return PJ_SUCCESS;
+    }
+
     pj_lock_destroy(ssock->write_mutex);
     
     pool = ssock->pool;
@@ -2051,6 +2596,9 @@ PJ_DEF(pj_status_t) pj_ssl_sock_get_info (pj_ssl_sock_t *ssock,
 
 	/* Verification status */
 	info->verify_status = ssock->verify_status;
+
+	/* Session resumption */
+	info->sess_reused = SSL_session_reused(ssock->ossl_ssl);
     }
 
     /* Last known OpenSSL error code */
@@ -2412,6 +2960,7 @@ PJ_DEF(pj_status_t) pj_ssl_sock_start_accept (pj_ssl_sock_t *ssock,
     asock_cfg.async_cnt = ssock->param.async_cnt;
     asock_cfg.concurrency = ssock->param.concurrency;
     asock_cfg.whole_data = PJ_TRUE;
+    asock_cfg.grp_lock = ssock->grp_lock;
 
     pj_bzero(&asock_cb, sizeof(asock_cb));
     asock_cb.on_accept_complete = asock_on_accept_complete;
@@ -2489,6 +3038,7 @@ PJ_DECL(pj_status_t) pj_ssl_sock_start_connect(pj_ssl_sock_t *ssock,
     asock_cfg.async_cnt = ssock->param.async_cnt;
     asock_cfg.concurrency = ssock->param.concurrency;
     asock_cfg.whole_data = PJ_TRUE;
+    asock_cfg.grp_lock = ssock->grp_lock;
 
     pj_bzero(&asock_cb, sizeof(asock_cb));
     asock_cb.on_connect_complete = asock_on_connect_complete;
@@ -2554,6 +3104,19 @@ on_error:
 }
 
 
+PJ_DEF(pj_status_t) pj_ssl_sock_get_sess_stat(pj_ssl_sock_sess_stat *stat)
+{
+    PJ_ASSERT_RETURN(stat, PJ_EINVAL);
+
+    pj_enter_critical_section();
+    *stat = sess_stat;
+    stat->ctx_cnt = ssl_ctx_cnt;
+    pj_leave_critical_section();
+
+    return PJ_SUCCESS;
+}
+
+
 PJ_DEF(pj_status_t) pj_ssl_sock_renegotiate(pj_ssl_sock_t *ssock)
 {
     int ret;
@@ -1424,3 +1424,9 @@ PJ_DEF(pj_status_t) pj_ssl_sock_renegotiate(pj_ssl_sock_t *ssock)
     PJ_UNUSED_ARG(ssock);
     return PJ_ENOTSUP;
 }
+
+PJ_DEF(pj_status_t) pj_ssl_sock_get_sess_stat(pj_ssl_sock_sess_stat *stat)
+{
+    PJ_UNUSED_ARG(stat);
+    return PJ_ENOTSUP;
+}
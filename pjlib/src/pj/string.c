@@ -29,41 +29,326 @@
 #endif
 
 
-PJ_DEF(char*) pj_strstr(const pj_str_t *str, const pj_str_t *substr)
-{
-    const char *s, *ends;
+#if PJ_HAS_SIMD_STRING
+#  include <emmintrin.h>
+#  if defined(__clang__) || __GNUC__ > 4 || \
+      (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#    include <immintrin.h>
+#    define STR_HAS_AVX2	1
+#  else
+#    define STR_HAS_AVX2	0
+#  endif
+#endif
 
-    /* Special case when substr is zero */
-    if (substr->slen == 0) {
-	return (char*)str->ptr;
+/* Fold ASCII upper case letter to lower case */
+#define FOLD(c)	    ((c) >= 'A' && (c) <= 'Z' ? (c) | 0x20 : (c))
+
+typedef int (*memicmp_func)(const char *p1, const char *p2, pj_size_t len);
+typedef char *(*find_func)(const char *s, pj_size_t slen,
+			   const char *sub, pj_size_t sublen,
+			   pj_bool_t icase);
+
+static int memicmp_scalar(const char *p1, const char *p2, pj_size_t len)
+{
+    for (; len; --len, ++p1, ++p2) {
+	if (*p1 != *p2) {
+	    int c1 = (unsigned char)*p1, c2 = (unsigned char)*p2;
+	    c1 = FOLD(c1);
+	    c2 = FOLD(c2);
+	    if (c1 != c2)
+		return c1 - c2;
+	}
     }
+    return 0;
+}
 
-    s = str->ptr;
-    ends = str->ptr + str->slen - substr->slen;
+/* Find sub (which is not empty) in s. */
+static char *find_scalar(const char *s, pj_size_t slen,
+			 const char *sub, pj_size_t sublen,
+			 pj_bool_t icase)
+{
+    const char *ends;
+
+    if (slen < sublen)
+	return NULL;
+
+    ends = s + slen - sublen;
     for (; s<=ends; ++s) {
-	if (pj_ansi_strncmp(s, substr->ptr, substr->slen)==0)
-	    return (char*)s;
+	if (icase) {
+	    if (memicmp_scalar(s, sub, sublen) == 0)
+		return (char*)s;
+	} else {
+	    if (pj_memcmp(s, sub, sublen) == 0)
+		return (char*)s;
+	}
     }
     return NULL;
 }
 
+#if PJ_HAS_SIMD_STRING
 
-PJ_DEF(char*) pj_stristr(const pj_str_t *str, const pj_str_t *substr)
+/* Fold the ASCII upper case letters in the vector to lower case. The
+ * letters are moved to the bottom of the signed range, so that one signed
+ * comparison finds them.
+ */
+static __m128i fold_sse2(__m128i v)
 {
-    const char *s, *ends;
+    __m128i upper = _mm_cmplt_epi8(
+			_mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - 'A'))),
+			_mm_set1_epi8((char)(0x80 + 26)));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+static int memicmp_sse2(const char *p1, const char *p2, pj_size_t len)
+{
+    while (len >= 16) {
+	__m128i v1 = fold_sse2(_mm_loadu_si128((const __m128i*)p1));
+	__m128i v2 = fold_sse2(_mm_loadu_si128((const __m128i*)p2));
+	unsigned diff = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v1, v2)) ^
+			0xFFFF;
+
+	if (diff) {
+	    unsigned i = __builtin_ctz(diff);
+	    int c1 = (unsigned char)p1[i], c2 = (unsigned char)p2[i];
+	    return FOLD(c1) - FOLD(c2);
+	}
+	p1 += 16;
+	p2 += 16;
+	len -= 16;
+    }
+    return memicmp_scalar(p1, p2, len);
+}
 
+/* Compare the first and the last character of sub at each position of a
+ * block, and only compare the whole sub at the positions where both match.
+ */
+static char *find_sse2(const char *s, pj_size_t slen,
+		       const char *sub, pj_size_t sublen,
+		       pj_bool_t icase)
+{
+    int first = (unsigned char)sub[0], last = (unsigned char)sub[sublen-1];
+    __m128i vfirst, vlast;
+    pj_size_t i;
+
+    if (icase) {
+	first = FOLD(first);
+	last = FOLD(last);
+    }
+    vfirst = _mm_set1_epi8((char)first);
+    vlast = _mm_set1_epi8((char)last);
+
+    for (i=0; i + sublen - 1 + 16 <= slen; i += 16) {
+	__m128i bfirst = _mm_loadu_si128((const __m128i*)(s + i));
+	__m128i blast = _mm_loadu_si128((const __m128i*)(s + i + sublen-1));
+	unsigned mask;
+
+	if (icase) {
+	    bfirst = fold_sse2(bfirst);
+	    blast = fold_sse2(blast);
+	}
+	mask = (unsigned)_mm_movemask_epi8(
+			    _mm_and_si128(_mm_cmpeq_epi8(bfirst, vfirst),
+					  _mm_cmpeq_epi8(blast, vlast)));
+	while (mask) {
+	    const char *p = s + i + __builtin_ctz(mask);
+
+	    if (sublen <= 2)
+		return (char*)p;
+	    if (icase) {
+		if (memicmp_sse2(p + 1, sub + 1, sublen - 2) == 0)
+		    return (char*)p;
+	    } else {
+		if (pj_memcmp(p + 1, sub + 1, sublen - 2) == 0)
+		    return (char*)p;
+	    }
+	    mask &= mask - 1;
+	}
+    }
+
+    return find_scalar(s + i, slen - i, sub, sublen, icase);
+}
+
+#  if STR_HAS_AVX2
+#    define AVX2_FUNC	__attribute__((target("avx2")))
+
+AVX2_FUNC static __m256i fold_avx2(__m256i v)
+{
+    __m256i upper = _mm256_cmpgt_epi8(
+			_mm256_set1_epi8((char)(0x80 + 26)),
+			_mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80-'A'))));
+    return _mm256_or_si256(v, _mm256_and_si256(upper,
+					       _mm256_set1_epi8(0x20)));
+}
+
+AVX2_FUNC static int memicmp_avx2(const char *p1, const char *p2,
+				  pj_size_t len)
+{
+    while (len >= 32) {
+	__m256i v1 = fold_avx2(_mm256_loadu_si256((const __m256i*)p1));
+	__m256i v2 = fold_avx2(_mm256_loadu_si256((const __m256i*)p2));
+	unsigned diff = ~(unsigned)_mm256_movemask_epi8(
+					_mm256_cmpeq_epi8(v1, v2));
+
+	if (diff) {
+	    unsigned i = __builtin_ctz(diff);
+	    int c1 = (unsigned char)p1[i], c2 = (unsigned char)p2[i];
+	    return FOLD(c1) - FOLD(c2);
+	}
+	p1 += 32;
+	p2 += 32;
+	len -= 32;
+    }
+    return memicmp_sse2(p1, p2, len);
+}
+
+AVX2_FUNC static char *find_avx2(const char *s, pj_size_t slen,
+				 const char *sub, pj_size_t sublen,
+				 pj_bool_t icase)
+{
+    int first = (unsigned char)sub[0], last = (unsigned char)sub[sublen-1];
+    __m256i vfirst, vlast;
+    pj_size_t i;
+
+    if (icase) {
+	first = FOLD(first);
+	last = FOLD(last);
+    }
+    vfirst = _mm256_set1_epi8((char)first);
+    vlast = _mm256_set1_epi8((char)last);
+
+    for (i=0; i + sublen - 1 + 32 <= slen; i += 32) {
+	__m256i bfirst = _mm256_loadu_si256((const __m256i*)(s + i));
+	__m256i blast = _mm256_loadu_si256((const __m256i*)
+					   (s + i + sublen - 1));
+	unsigned mask;
+
+	if (icase) {
+	    bfirst = fold_avx2(bfirst);
+	    blast = fold_avx2(blast);
+	}
+	mask = (unsigned)_mm256_movemask_epi8(
+			_mm256_and_si256(_mm256_cmpeq_epi8(bfirst, vfirst),
+					 _mm256_cmpeq_epi8(blast, vlast)));
+	while (mask) {
+	    const char *p = s + i + __builtin_ctz(mask);
+
+	    if (sublen <= 2)
+		return (char*)p;
+	    if (icase) {
+		if (memicmp_avx2(p + 1, sub + 1, sublen - 2) == 0)
+		    return (char*)p;
+	    } else {
+		if (pj_memcmp(p + 1, sub + 1, sublen - 2) == 0)
+		    return (char*)p;
+	    }
+	    mask &= mask - 1;
+	}
+    }
+
+    return find_sse2(s + i, slen - i, sub, sublen, icase);
+}
+#  endif	/* STR_HAS_AVX2 */
+
+#endif	/* PJ_HAS_SIMD_STRING */
+
+static int memicmp_init(const char *p1, const char *p2, pj_size_t len);
+static char *find_init(const char *s, pj_size_t slen,
+		       const char *sub, pj_size_t sublen,
+		       pj_bool_t icase);
+
+/* The implementations in use. They are selected on the first call. */
+static struct
+{
+    memicmp_func    memicmp;
+    find_func	    find;
+} str_impl = { &memicmp_init, &find_init };
+
+static int memicmp_init(const char *p1, const char *p2, pj_size_t len)
+{
+    pj_str_set_simd(PJ_STR_SIMD_AVX2);
+    return (*str_impl.memicmp)(p1, p2, len);
+}
+
+static char *find_init(const char *s, pj_size_t slen,
+		       const char *sub, pj_size_t sublen,
+		       pj_bool_t icase)
+{
+    pj_str_set_simd(PJ_STR_SIMD_AVX2);
+    return (*str_impl.find)(s, slen, sub, sublen, icase);
+}
+
+PJ_DEF(pj_str_simd) pj_str_set_simd(pj_str_simd max)
+{
+    pj_str_simd level = PJ_STR_SIMD_NONE;
+
+#if PJ_HAS_SIMD_STRING
+    level = max;
+#  if STR_HAS_AVX2
+    if (level >= PJ_STR_SIMD_AVX2 && !__builtin_cpu_supports("avx2"))
+	level = PJ_STR_SIMD_SSE2;
+#  else
+    if (level >= PJ_STR_SIMD_AVX2)
+	level = PJ_STR_SIMD_SSE2;
+#  endif
+#else
+    PJ_UNUSED_ARG(max);
+#endif
+
+    switch (level) {
+#if PJ_HAS_SIMD_STRING
+#  if STR_HAS_AVX2
+    case PJ_STR_SIMD_AVX2:
+	str_impl.memicmp = &memicmp_avx2;
+	str_impl.find = &find_avx2;
+	break;
+#  endif
+    case PJ_STR_SIMD_SSE2:
+	str_impl.memicmp = &memicmp_sse2;
+	str_impl.find = &find_sse2;
+	break;
+#endif
+    default:
+	str_impl.memicmp = &memicmp_scalar;
+	str_impl.find = &find_scalar;
+	level = PJ_STR_SIMD_NONE;
+	break;
+    }
+
+    return level;
+}
+
+PJ_DEF(int) pj_memicmp(const void *buf1, const void *buf2, pj_size_t size)
+{
+    return (*str_impl.memicmp)((const char*)buf1, (const char*)buf2, size);
+}
+
+PJ_DEF(char*) pj_strstr(const pj_str_t *str, const pj_str_t *substr)
+{
     /* Special case when substr is zero */
     if (substr->slen == 0) {
 	return (char*)str->ptr;
     }
 
-    s = str->ptr;
-    ends = str->ptr + str->slen - substr->slen;
-    for (; s<=ends; ++s) {
-	if (pj_ansi_strnicmp(s, substr->ptr, substr->slen)==0)
-	    return (char*)s;
+    if (substr->slen > str->slen)
+	return NULL;
+
+    return (*str_impl.find)(str->ptr, str->slen, substr->ptr, substr->slen,
+			    PJ_FALSE);
+}
+
+
+PJ_DEF(char*) pj_stristr(const pj_str_t *str, const pj_str_t *substr)
+{
+    /* Special case when substr is zero */
+    if (substr->slen == 0) {
+	return (char*)str->ptr;
     }
-    return NULL;
+
+    if (substr->slen > str->slen)
+	return NULL;
+
+    return (*str_impl.find)(str->ptr, str->slen, substr->ptr, substr->slen,
+			    PJ_TRUE);
 }
 
 
@@ -57,6 +57,16 @@ PJ_EXPORT_SYMBOL(pj_exception_id_alloc)
 PJ_EXPORT_SYMBOL(pj_exception_id_free)
 PJ_EXPORT_SYMBOL(pj_exception_id_name)
 
+/*
+ * executor.h
+ */
+PJ_EXPORT_SYMBOL(pj_executor_param_default)
+PJ_EXPORT_SYMBOL(pj_executor_create)
+PJ_EXPORT_SYMBOL(pj_executor_submit)
+PJ_EXPORT_SYMBOL(pj_executor_is_worker)
+PJ_EXPORT_SYMBOL(pj_executor_get_stat)
+PJ_EXPORT_SYMBOL(pj_executor_destroy)
+
 
 /*
  * fifobuf.h
@@ -78,6 +88,7 @@ PJ_EXPORT_SYMBOL(pj_create_unique_string)
  */
 PJ_EXPORT_SYMBOL(pj_hash_calc)
 PJ_EXPORT_SYMBOL(pj_hash_create)
+PJ_EXPORT_SYMBOL(pj_hash_create_resizable)
 PJ_EXPORT_SYMBOL(pj_hash_get)
 PJ_EXPORT_SYMBOL(pj_hash_set)
 PJ_EXPORT_SYMBOL(pj_hash_count)
@@ -129,8 +140,16 @@ PJ_EXPORT_SYMBOL(pj_log_set_log_func)
 PJ_EXPORT_SYMBOL(pj_log_get_log_func)
 PJ_EXPORT_SYMBOL(pj_log_set_level)
 PJ_EXPORT_SYMBOL(pj_log_get_level)
+PJ_EXPORT_SYMBOL(pj_log_set_sender_level)
+PJ_EXPORT_SYMBOL(pj_log_get_sender_level)
+PJ_EXPORT_SYMBOL(pj_log_sender_enabled)
 PJ_EXPORT_SYMBOL(pj_log_set_decor)
 PJ_EXPORT_SYMBOL(pj_log_get_decor)
+PJ_EXPORT_SYMBOL(pj_log_start_async)
+PJ_EXPORT_SYMBOL(pj_log_flush)
+PJ_EXPORT_SYMBOL(pj_log_stop_async)
+PJ_EXPORT_SYMBOL(pj_log_set_async_binary)
+PJ_EXPORT_SYMBOL(pj_log_get_async_stat)
 PJ_EXPORT_SYMBOL(pj_log_1)
 #endif
 #if PJ_LOG_MAX_LEVEL >= 2
@@ -162,6 +181,10 @@ PJ_EXPORT_SYMBOL(pj_thread_this)
 PJ_EXPORT_SYMBOL(pj_thread_join)
 PJ_EXPORT_SYMBOL(pj_thread_destroy)
 PJ_EXPORT_SYMBOL(pj_thread_sleep)
+PJ_EXPORT_SYMBOL(pj_thread_set_affinity)
+PJ_EXPORT_SYMBOL(pj_thread_set_sched)
+PJ_EXPORT_SYMBOL(pj_thread_sched_param_default)
+PJ_EXPORT_SYMBOL(pj_thread_set_sched_param)
 #if defined(PJ_OS_HAS_CHECK_STACK) && PJ_OS_HAS_CHECK_STACK != 0
 PJ_EXPORT_SYMBOL(pj_thread_check_stack)
 PJ_EXPORT_SYMBOL(pj_thread_get_stack_max_usage)
@@ -198,6 +221,10 @@ PJ_EXPORT_SYMBOL(pj_gettimeofday)
 PJ_EXPORT_SYMBOL(pj_time_decode)
 #if defined(PJ_HAS_HIGH_RES_TIMER) && PJ_HAS_HIGH_RES_TIMER != 0
 PJ_EXPORT_SYMBOL(pj_gettickcount)
+PJ_EXPORT_SYMBOL(pj_gettickcount_coarse)
+PJ_EXPORT_SYMBOL(pj_gettimeofday_coarse)
+PJ_EXPORT_SYMBOL(pj_coarse_clock_enter)
+PJ_EXPORT_SYMBOL(pj_coarse_clock_leave)
 PJ_EXPORT_SYMBOL(pj_get_timestamp)
 PJ_EXPORT_SYMBOL(pj_get_timestamp_freq)
 PJ_EXPORT_SYMBOL(pj_elapsed_time)
@@ -224,6 +251,18 @@ PJ_EXPORT_SYMBOL(pj_pool_init_int)
 PJ_EXPORT_SYMBOL(pj_pool_destroy_int)
 PJ_EXPORT_SYMBOL(pj_caching_pool_init)
 PJ_EXPORT_SYMBOL(pj_caching_pool_destroy)
+PJ_EXPORT_SYMBOL(pj_caching_pool_get_category_stat)
+PJ_EXPORT_SYMBOL(pj_caching_pool_print_category_stat)
+
+/*
+ * objpool.h
+ */
+PJ_EXPORT_SYMBOL(pj_objpool_create)
+PJ_EXPORT_SYMBOL(pj_objpool_alloc)
+PJ_EXPORT_SYMBOL(pj_objpool_zalloc)
+PJ_EXPORT_SYMBOL(pj_objpool_free)
+PJ_EXPORT_SYMBOL(pj_objpool_get_stat)
+PJ_EXPORT_SYMBOL(pj_objpool_destroy)
 
 /*
  * rand.h
@@ -231,6 +270,20 @@ PJ_EXPORT_SYMBOL(pj_caching_pool_destroy)
 PJ_EXPORT_SYMBOL(pj_rand)
 PJ_EXPORT_SYMBOL(pj_srand)
 
+/*
+ * ringbuf.h
+ */
+PJ_EXPORT_SYMBOL(pj_ringbuf_create)
+PJ_EXPORT_SYMBOL(pj_ringbuf_acquire)
+PJ_EXPORT_SYMBOL(pj_ringbuf_commit)
+PJ_EXPORT_SYMBOL(pj_ringbuf_peek)
+PJ_EXPORT_SYMBOL(pj_ringbuf_release)
+PJ_EXPORT_SYMBOL(pj_ringbuf_push)
+PJ_EXPORT_SYMBOL(pj_ringbuf_pop)
+PJ_EXPORT_SYMBOL(pj_ringbuf_get_count)
+PJ_EXPORT_SYMBOL(pj_ringbuf_get_capacity)
+PJ_EXPORT_SYMBOL(pj_ringbuf_destroy)
+
 /*
  * rbtree.h
  */
@@ -289,8 +342,10 @@ PJ_EXPORT_SYMBOL(pj_sock_getsockopt)
 PJ_EXPORT_SYMBOL(pj_sock_setsockopt)
 PJ_EXPORT_SYMBOL(pj_sock_recv)
 PJ_EXPORT_SYMBOL(pj_sock_recvfrom)
+PJ_EXPORT_SYMBOL(pj_sock_recvmmsg)
 PJ_EXPORT_SYMBOL(pj_sock_send)
 PJ_EXPORT_SYMBOL(pj_sock_sendto)
+PJ_EXPORT_SYMBOL(pj_sock_sendmmsg)
 
 /*
  * sock_select.h
@@ -321,6 +376,10 @@ PJ_EXPORT_SYMBOL(pj_stricmp2)
 PJ_EXPORT_SYMBOL(pj_strnicmp)
 PJ_EXPORT_SYMBOL(pj_strnicmp2)
 PJ_EXPORT_SYMBOL(pj_strcat)
+PJ_EXPORT_SYMBOL(pj_strstr)
+PJ_EXPORT_SYMBOL(pj_stristr)
+PJ_EXPORT_SYMBOL(pj_str_set_simd)
+PJ_EXPORT_SYMBOL(pj_memicmp)
 PJ_EXPORT_SYMBOL(pj_strltrim)
 PJ_EXPORT_SYMBOL(pj_strrtrim)
 PJ_EXPORT_SYMBOL(pj_strtrim)
@@ -334,6 +393,8 @@ PJ_EXPORT_SYMBOL(pj_utoa_pad)
  */
 PJ_EXPORT_SYMBOL(pj_timer_heap_mem_size)
 PJ_EXPORT_SYMBOL(pj_timer_heap_create)
+PJ_EXPORT_SYMBOL(pj_timer_heap_create_sharded)
+PJ_EXPORT_SYMBOL(pj_timer_heap_set_thread_shard)
 PJ_EXPORT_SYMBOL(pj_timer_entry_init)
 PJ_EXPORT_SYMBOL(pj_timer_heap_schedule)
 PJ_EXPORT_SYMBOL(pj_timer_heap_cancel)
@@ -341,6 +402,15 @@ PJ_EXPORT_SYMBOL(pj_timer_heap_count)
 PJ_EXPORT_SYMBOL(pj_timer_heap_earliest_time)
 PJ_EXPORT_SYMBOL(pj_timer_heap_poll)
 
+/*
+ * trace.h
+ */
+PJ_EXPORT_SYMBOL(pj_trace_start)
+PJ_EXPORT_SYMBOL(pj_trace_stop)
+PJ_EXPORT_SYMBOL(pj_trace_clear)
+PJ_EXPORT_SYMBOL(pj_trace_event)
+PJ_EXPORT_SYMBOL(pj_trace_dump)
+
 /*
  * types.h
  */
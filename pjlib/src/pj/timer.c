@@ -36,6 +36,13 @@
 #include <pj/lock.h>
 #include <pj/log.h>
 #include <pj/rand.h>
+#include "timer_shard.h"
+
+/* This is the binary heap implementation of the timer heap. See
+ * timer_wheel.c for the timing wheel implementation.
+ */
+#if !defined(PJ_TIMER_HEAP_IMPLEMENTATION) || \
+    PJ_TIMER_HEAP_IMPLEMENTATION==PJ_TIMER_HEAP_BINARY
 
 #define THIS_FILE	"timer.c"
 
@@ -105,6 +112,8 @@ struct pj_timer_heap_t
     /** Callback to be called when a timer expires. */
     pj_timer_heap_callback *callback;
 
+    /** Shard fields, see timer_shard.c */
+    DECLARE_TIMER_SHARD_FIELDS
 };
 
 
@@ -123,6 +132,8 @@ PJ_INLINE(void) unlock_timer_heap( pj_timer_heap_t *ht )
     }
 }
 
+#include "timer_shard.c"
+
 
 static void copy_node( pj_timer_heap_t *ht, pj_size_t slot, 
 		       pj_timer_entry *moved_node )
@@ -400,6 +411,8 @@ PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
     ht->lock = NULL;
     ht->auto_delete_lock = 0;
 
+    INIT_TIMER_SHARD_FIELDS(ht);
+
     // Create the heap array.
     ht->heap = (pj_timer_entry**)
     	       pj_pool_alloc(pool, sizeof(pj_timer_entry*) * size);
@@ -424,6 +437,9 @@ PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
 
 PJ_DEF(void) pj_timer_heap_destroy( pj_timer_heap_t *ht )
 {
+    if (ht->shards)
+	shard_destroy(ht);
+
     if (ht->lock && ht->auto_delete_lock) {
         pj_lock_destroy(ht->lock);
         ht->lock = NULL;
@@ -447,6 +463,8 @@ PJ_DEF(unsigned) pj_timer_heap_set_max_timed_out_per_poll(pj_timer_heap_t *ht,
 {
     unsigned old_count = ht->max_entries_per_poll;
     ht->max_entries_per_poll = count;
+    if (ht->shards)
+	shard_set_max_timed_out_per_poll(ht, count);
     return old_count;
 }
 
@@ -462,6 +480,7 @@ PJ_DEF(pj_timer_entry*) pj_timer_entry_init( pj_timer_entry *entry,
     entry->user_data = user_data;
     entry->cb = cb;
     entry->_grp_lock = NULL;
+    entry->_shard_id = 0;
 
     return entry;
 }
@@ -495,6 +514,10 @@ static pj_status_t schedule_w_grp_lock(pj_timer_heap_t *ht,
     PJ_ASSERT_RETURN(ht && entry && delay, PJ_EINVAL);
     PJ_ASSERT_RETURN(entry->cb != NULL, PJ_EINVAL);
 
+    /* Schedule to the shard of the calling thread */
+    if (ht->shards)
+	ht = shard_for_schedule(ht, entry);
+
     /* Prevent same entry from being scheduled more than once */
     PJ_ASSERT_RETURN(entry->_timer_id < 1, PJ_EINVALIDOP);
 
@@ -572,6 +595,9 @@ static int cancel_timer(pj_timer_heap_t *ht,
 
     PJ_ASSERT_RETURN(ht && entry, PJ_EINVAL);
 
+    if (ht->shards)
+	ht = shard_of_entry(ht, entry);
+
     lock_timer_heap(ht);
     count = cancel(ht, entry, flags | F_DONT_CALL);
     if (flags & F_SET_ID) {
@@ -608,6 +634,9 @@ PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
 
     PJ_ASSERT_RETURN(ht, 0);
 
+    if (ht->shards)
+	return shard_poll(ht, next_delay);
+
     lock_timer_heap(ht);
     if (!ht->cur_size && next_delay) {
 	next_delay->sec = next_delay->msec = PJ_MAXINT32;
@@ -635,7 +664,7 @@ PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
 	PJ_RACE_ME(5);
 
 	if (node->cb)
-	    (*node->cb)(ht, node);
+	    (*node->cb)(CALLBACK_HEAP(ht), node);
 
 	if (grp_lock)
 	    pj_grp_lock_dec_ref(grp_lock);
@@ -659,12 +688,18 @@ PJ_DEF(pj_size_t) pj_timer_heap_count( pj_timer_heap_t *ht )
 {
     PJ_ASSERT_RETURN(ht, 0);
 
+    if (ht->shards)
+	return shard_count(ht);
+
     return ht->cur_size;
 }
 
 PJ_DEF(pj_status_t) pj_timer_heap_earliest_time( pj_timer_heap_t * ht,
 					         pj_time_val *timeval)
 {
+    if (ht->shards)
+	return shard_earliest_time(ht, timeval);
+
     pj_assert(ht->cur_size != 0);
     if (ht->cur_size == 0)
         return PJ_ENOTFOUND;
@@ -679,6 +714,11 @@ PJ_DEF(pj_status_t) pj_timer_heap_earliest_time( pj_timer_heap_t * ht,
 #if PJ_TIMER_DEBUG
 PJ_DEF(void) pj_timer_heap_dump(pj_timer_heap_t *ht)
 {
+    if (ht->shards) {
+	shard_dump(ht);
+	return;
+    }
+
     lock_timer_heap(ht);
 
     PJ_LOG(3,(THIS_FILE, "Dumping timer heap:"));
@@ -717,3 +757,5 @@ PJ_DEF(void) pj_timer_heap_dump(pj_timer_heap_t *ht)
 }
 #endif
 
+#endif	/* PJ_TIMER_HEAP_IMPLEMENTATION==PJ_TIMER_HEAP_BINARY */
+
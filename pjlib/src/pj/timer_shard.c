@@ -0,0 +1,298 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * timer_shard.c
+ *
+ * Sharded timer heap. A sharded timer heap is a timer heap which owns a
+ * number of ordinary timer heaps (the shards), each with its own lock.
+ * A thread which polls the timer heap is bound to a shard (in a round
+ * robin fashion, or explicitly with pj_timer_heap_set_thread_shard()),
+ * and entries scheduled by that thread go to its shard. The shard index
+ * is saved in the entry, so the entry can be cancelled from any thread.
+ *
+ * Shards which are not owned by any polling thread, or whose owner has
+ * not polled for PJ_TIMER_SHARD_IDLE_TIMEOUT msec, are polled by all
+ * threads, so entries are never left unprocessed when a thread stops
+ * polling.
+ *
+ * This file is included by the timer heap backends after the declaration
+ * of struct pj_timer_heap_t, which must contain DECLARE_TIMER_SHARD_FIELDS.
+ */
+
+#if PJ_HAS_ATOMIC_BUILTINS
+#   define SHARD_STAMP_GET(ht,i)	__atomic_load_n(&(ht)->shard_last_poll[i],\
+						__ATOMIC_RELAXED)
+#   define SHARD_STAMP_SET(ht,i,v)	__atomic_store_n(&(ht)->shard_last_poll[i],\
+						 v, __ATOMIC_RELAXED)
+#else
+#   define SHARD_STAMP_GET(ht,i)	((ht)->shard_last_poll[i])
+#   define SHARD_STAMP_SET(ht,i,v)	((ht)->shard_last_poll[i] = (v))
+#endif
+
+/* Current time in msec to be recorded as the last poll time of a shard.
+ * Zero is reserved for shards which have never been owned.
+ */
+static pj_uint32_t shard_now(void)
+{
+    pj_time_val now;
+    pj_uint32_t msec;
+
+    pj_gettickcount(&now);
+    msec = (pj_uint32_t)PJ_TIME_VAL_MSEC(now);
+    return msec ? msec : 1;
+}
+
+/* Check if the shard has an owner thread which is still polling it. */
+PJ_INLINE(pj_bool_t) shard_is_owned(pj_timer_heap_t *ht, unsigned idx,
+				     pj_uint32_t now)
+{
+    pj_uint32_t last = SHARD_STAMP_GET(ht, idx);
+
+    return last != 0 &&
+	   (pj_int32_t)(now - last) < (pj_int32_t)PJ_TIMER_SHARD_IDLE_TIMEOUT;
+}
+
+/* Get the index of the shard bound to the calling thread. If the thread
+ * is not bound yet, a shard is selected in round robin fashion, and the
+ * thread is bound to it if "bind" is set.
+ */
+static unsigned shard_of_thread(pj_timer_heap_t *ht, pj_bool_t bind)
+{
+    void *val;
+    unsigned idx;
+
+    val = pj_thread_local_get(ht->shard_tls_id);
+    if (val)
+	return (unsigned)((pj_ssize_t)val - 1);
+
+    idx = (unsigned)pj_atomic_inc_and_get(ht->next_shard) % ht->shard_cnt;
+    if (bind) {
+	pj_thread_local_set(ht->shard_tls_id, (void*)(pj_ssize_t)(idx + 1));
+	SHARD_STAMP_SET(ht, idx, shard_now());
+    }
+
+    return idx;
+}
+
+/* Get the shard where the entry is scheduled. */
+PJ_INLINE(pj_timer_heap_t*) shard_of_entry(pj_timer_heap_t *ht,
+					    pj_timer_entry *entry)
+{
+    return ht->shards[entry->_shard_id < ht->shard_cnt ?
+		      entry->_shard_id : 0];
+}
+
+/* Select the shard to schedule the entry to. */
+static pj_timer_heap_t *shard_for_schedule(pj_timer_heap_t *ht,
+					   pj_timer_entry *entry)
+{
+    /* Don't overwrite the shard id of an entry which is still scheduled,
+     * the schedule will fail anyway.
+     */
+    if (entry->_timer_id >= 1)
+	return shard_of_entry(ht, entry);
+
+    entry->_shard_id = shard_of_thread(ht, PJ_FALSE);
+    return ht->shards[entry->_shard_id];
+}
+
+static unsigned shard_poll(pj_timer_heap_t *ht, pj_time_val *next_delay)
+{
+    unsigned own, i, count;
+    pj_uint32_t now;
+
+    own = shard_of_thread(ht, PJ_TRUE);
+    now = shard_now();
+    SHARD_STAMP_SET(ht, own, now);
+    count = pj_timer_heap_poll(ht->shards[own], next_delay);
+
+    /* Also poll shards which don't have owner thread, or whose owner
+     * has stopped polling.
+     */
+    for (i=0; i<ht->shard_cnt; ++i) {
+	pj_time_val delay;
+
+	if (i == own || shard_is_owned(ht, i, now))
+	    continue;
+
+	count += pj_timer_heap_poll(ht->shards[i], next_delay ? &delay : NULL);
+	if (next_delay && PJ_TIME_VAL_LT(delay, *next_delay))
+	    *next_delay = delay;
+    }
+
+    return count;
+}
+
+static pj_size_t shard_count(pj_timer_heap_t *ht)
+{
+    pj_size_t count = 0;
+    unsigned i;
+
+    for (i=0; i<ht->shard_cnt; ++i)
+	count += pj_timer_heap_count(ht->shards[i]);
+
+    return count;
+}
+
+static pj_status_t shard_earliest_time(pj_timer_heap_t *ht,
+				       pj_time_val *timeval)
+{
+    pj_bool_t found = PJ_FALSE;
+    unsigned i;
+
+    for (i=0; i<ht->shard_cnt; ++i) {
+	pj_time_val t;
+
+	if (pj_timer_heap_count(ht->shards[i]) == 0 ||
+	    pj_timer_heap_earliest_time(ht->shards[i], &t) != PJ_SUCCESS)
+	{
+	    continue;
+	}
+
+	if (!found || PJ_TIME_VAL_LT(t, *timeval)) {
+	    *timeval = t;
+	    found = PJ_TRUE;
+	}
+    }
+
+    return found ? PJ_SUCCESS : PJ_ENOTFOUND;
+}
+
+static void shard_set_max_timed_out_per_poll(pj_timer_heap_t *ht,
+					     unsigned count)
+{
+    unsigned i;
+
+    for (i=0; i<ht->shard_cnt; ++i)
+	pj_timer_heap_set_max_timed_out_per_poll(ht->shards[i], count);
+}
+
+static void shard_destroy(pj_timer_heap_t *ht)
+{
+    unsigned i;
+
+    for (i=0; i<ht->shard_cnt; ++i)
+	pj_timer_heap_destroy(ht->shards[i]);
+
+    if (ht->next_shard) {
+	pj_atomic_destroy(ht->next_shard);
+	ht->next_shard = NULL;
+    }
+    if (ht->shard_tls_id != -1) {
+	pj_thread_local_free(ht->shard_tls_id);
+	ht->shard_tls_id = -1;
+    }
+    ht->shard_cnt = 0;
+    ht->shards = NULL;
+}
+
+#if PJ_TIMER_DEBUG
+static void shard_dump(pj_timer_heap_t *ht)
+{
+    pj_uint32_t now = shard_now();
+    unsigned i;
+
+    for (i=0; i<ht->shard_cnt; ++i) {
+	PJ_LOG(3,(THIS_FILE, "Shard %d (%s):", i,
+		  (shard_is_owned(ht, i, now) ? "owned" :
+		   (SHARD_STAMP_GET(ht, i) ? "idle" : "not owned"))));
+	pj_timer_heap_dump(ht->shards[i]);
+    }
+}
+#endif
+
+/*
+ * Create a sharded timer heap.
+ */
+PJ_DEF(pj_status_t) pj_timer_heap_create_sharded( pj_pool_t *pool,
+						  pj_size_t count,
+						  unsigned shard_cnt,
+						  pj_timer_heap_t **p_heap)
+{
+    pj_timer_heap_t *ht;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(pool && p_heap && shard_cnt, PJ_EINVAL);
+
+    *p_heap = NULL;
+
+    status = pj_timer_heap_create(pool, 0, &ht);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    ht->shards = (pj_timer_heap_t**)
+		 pj_pool_calloc(pool, shard_cnt, sizeof(pj_timer_heap_t*));
+    ht->shard_last_poll = (pj_uint32_t*)
+			  pj_pool_calloc(pool, shard_cnt, sizeof(pj_uint32_t));
+
+    status = pj_thread_local_alloc(&ht->shard_tls_id);
+    if (status != PJ_SUCCESS) {
+	ht->shard_tls_id = -1;
+	goto on_error;
+    }
+
+    status = pj_atomic_create(pool, -1, &ht->next_shard);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    for (i=0; i<shard_cnt; ++i) {
+	pj_timer_heap_t *shard;
+	pj_lock_t *lock;
+
+	status = pj_timer_heap_create(pool, count / shard_cnt + 1, &shard);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	ht->shards[i] = shard;
+	ht->shard_cnt = i + 1;
+	shard->parent = ht;
+
+	status = pj_lock_create_recursive_mutex(pool, "tshard%p", &lock);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	pj_timer_heap_set_lock(shard, lock, PJ_TRUE);
+    }
+
+    *p_heap = ht;
+    return PJ_SUCCESS;
+
+on_error:
+    shard_destroy(ht);
+    return status;
+}
+
+/*
+ * Bind the calling thread to a shard.
+ */
+PJ_DEF(pj_status_t) pj_timer_heap_set_thread_shard( pj_timer_heap_t *ht,
+						    unsigned shard_id )
+{
+    PJ_ASSERT_RETURN(ht, PJ_EINVAL);
+    PJ_ASSERT_RETURN(ht->shards, PJ_EINVALIDOP);
+    PJ_ASSERT_RETURN(shard_id < ht->shard_cnt, PJ_EINVAL);
+
+    SHARD_STAMP_SET(ht, shard_id, shard_now());
+    return pj_thread_local_set(ht->shard_tls_id,
+			       (void*)(pj_ssize_t)(shard_id + 1));
+}
+
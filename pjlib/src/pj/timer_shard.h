@@ -0,0 +1,71 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* timer_shard.h
+ *
+ * This file contains private declarations for the sharded timer heap,
+ * which is shared by all timer heap backends (timer.c, timer_wheel.c).
+ * The implementation is in timer_shard.c, which is included by the
+ * backends after the declaration of struct pj_timer_heap_t.
+ */
+
+#include <pj/os.h>
+
+/*
+ * These fields must be declared in struct pj_timer_heap_t of the backend.
+ */
+#define DECLARE_TIMER_SHARD_FIELDS				    \
+    /** Shards of a sharded timer heap, or NULL. */		    \
+    pj_timer_heap_t	   **shards;				    \
+								    \
+    /** Number of shards. */					    \
+    unsigned		     shard_cnt;				    \
+								    \
+    /** Last poll time (msec) of each shard by its owner, 0 if none. */\
+    pj_uint32_t		    *shard_last_poll;			    \
+								    \
+    /** Thread local index of the shard bound to calling thread. */ \
+    long		     shard_tls_id;			    \
+								    \
+    /** Counter to distribute shards to threads. */		    \
+    pj_atomic_t		    *next_shard;			    \
+								    \
+    /** The sharded timer heap owning this shard, or NULL. */	    \
+    pj_timer_heap_t	    *parent;
+
+/*
+ * Initialize the shard fields of a newly created timer heap.
+ */
+#define INIT_TIMER_SHARD_FIELDS(ht)	do {			    \
+					    (ht)->shards = NULL;    \
+					    (ht)->shard_cnt = 0;    \
+					    (ht)->shard_last_poll = NULL; \
+					    (ht)->shard_tls_id = -1;  \
+					    (ht)->next_shard = NULL;  \
+					    (ht)->parent = NULL;    \
+					} while (0)
+
+/*
+ * The timer heap to be passed to the entry's callback. For a shard, this
+ * is the sharded timer heap, so that the callback may reschedule the
+ * entry with the timer heap that it knows.
+ */
+#define CALLBACK_HEAP(ht)   ((ht)->parent ? (ht)->parent : (ht))
+
@@ -0,0 +1,869 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/timer.h>
+#include <pj/pool.h>
+#include <pj/os.h>
+#include <pj/string.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include "timer_shard.h"
+
+/*
+ * This is the hierarchical timing wheel implementation of the timer heap
+ * API, selected with PJ_TIMER_HEAP_IMPLEMENTATION==PJ_TIMER_HEAP_WHEEL.
+ *
+ * Time is divided into ticks of PJ_TIMER_WHEEL_RESOLUTION msec. The wheel
+ * has four levels: the first level has 256 slots of one tick each, and
+ * each of the upper levels has 64 slots covering the whole span of the
+ * level below it, giving total range of 2^26 ticks. An entry is put in
+ * the slot list of the level that covers its expiration, so scheduling
+ * and cancelling are O(1). When the first level wraps around, the current
+ * slot of the next level is "cascaded" (its entries are redistributed to
+ * the lower levels). Entries which expire beyond the wheel range are
+ * parked in the last level and re-cascaded until they are in range.
+ *
+ * Like the binary heap implementation, slot lists are kept in a node
+ * array indexed by the entry's _timer_id, so no memory allocation is
+ * needed except when the array needs to grow.
+ */
+#if defined(PJ_TIMER_HEAP_IMPLEMENTATION) && \
+    PJ_TIMER_HEAP_IMPLEMENTATION==PJ_TIMER_HEAP_WHEEL
+
+#define THIS_FILE	"timer_wheel.c"
+
+#if (1000 % PJ_TIMER_WHEEL_RESOLUTION) != 0
+#   error "PJ_TIMER_WHEEL_RESOLUTION must divide 1000"
+#endif
+
+#define DEFAULT_MAX_TIMED_OUT_PER_POLL  (64)
+
+#define TICKS_PER_SEC	(1000 / PJ_TIMER_WHEEL_RESOLUTION)
+
+#define WHEEL_LEVELS	4
+#define WHEEL0_BITS	8
+#define WHEEL0_SIZE	(1 << WHEEL0_BITS)
+#define WHEEL0_MASK	(WHEEL0_SIZE - 1)
+#define WHEELN_BITS	6
+#define WHEELN_SIZE	(1 << WHEELN_BITS)
+#define WHEELN_MASK	(WHEELN_SIZE - 1)
+#define WHEEL_SLOT_CNT	(WHEEL0_SIZE + (WHEEL_LEVELS-1) * WHEELN_SIZE)
+
+/* Number of bits shifted to get the slot index in level lvl (lvl >= 1) */
+#define LEVEL_SHIFT(lvl)    (WHEEL0_BITS + ((lvl)-1) * WHEELN_BITS)
+
+/* Span of ticks covered by levels 0..lvl */
+#define LEVEL_SPAN(lvl)	    ((pj_uint32_t)1 << (WHEEL0_BITS + (lvl)*WHEELN_BITS))
+
+/* Maximum number of ticks that can be represented by the wheel */
+#define MAX_TICKS	    (LEVEL_SPAN(WHEEL_LEVELS-1) - 1)
+
+/* First slot of level lvl (lvl >= 1) in the slots array */
+#define LEVEL_BASE(lvl)	    (WHEEL0_SIZE + ((lvl)-1) * WHEELN_SIZE)
+
+/* Get the level of a slot */
+#define SLOT_LEVEL(slot)    ((slot) < WHEEL0_SIZE ? 0 : \
+			     1 + ((slot) - WHEEL0_SIZE) / WHEELN_SIZE)
+
+/* Tick comparison that is safe against wrap around */
+#define TICK_GT(a,b)	    ((pj_int32_t)((a) - (b)) > 0)
+
+enum
+{
+    F_DONT_CALL = 1,
+    F_DONT_ASSERT = 2,
+    F_SET_ID = 4
+};
+
+
+/* Timer node, indexed by entry's _timer_id. Node 0 is never used, so that
+ * zero can be used as list terminator.
+ */
+typedef struct wheel_node
+{
+    /** The entry, or NULL if the node is in the freelist. */
+    pj_timer_entry *entry;
+
+    /** Previous node in the slot list. */
+    pj_timer_id_t   prev;
+
+    /** Next node in the slot list, or in the freelist. */
+    pj_timer_id_t   next;
+
+    /** Expiration time, in ticks. */
+    pj_uint32_t	    expires;
+
+    /** Index of the slot where the node is linked. */
+    unsigned	    slot;
+
+} wheel_node;
+
+
+/**
+ * The implementation of timer heap.
+ */
+struct pj_timer_heap_t
+{
+    /** Pool from which the timer heap resize will get the storage from */
+    pj_pool_t *pool;
+
+    /** Number of nodes allocated. */
+    pj_size_t max_size;
+
+    /** Number of entries currently scheduled. */
+    pj_size_t cur_size;
+
+    /** Max timed out entries to process per poll. */
+    unsigned max_entries_per_poll;
+
+    /** Lock object. */
+    pj_lock_t *lock;
+
+    /** Autodelete lock. */
+    pj_bool_t auto_delete_lock;
+
+    /** Array of nodes, indexed by timer id. */
+    wheel_node *nodes;
+
+    /** First node in the freelist, or zero if the freelist is empty. */
+    pj_timer_id_t freelist;
+
+    /** The tick currently being processed. */
+    pj_uint32_t cur_tick;
+
+    /** Number of entries in each level. */
+    pj_size_t level_cnt[WHEEL_LEVELS];
+
+    /** Heads of the slot lists of all levels. */
+    pj_timer_id_t slots[WHEEL_SLOT_CNT];
+
+    /** Shard fields, see timer_shard.c */
+    DECLARE_TIMER_SHARD_FIELDS
+};
+
+
+
+PJ_INLINE(void) lock_timer_heap( pj_timer_heap_t *ht )
+{
+    if (ht->lock) {
+	pj_lock_acquire(ht->lock);
+    }
+}
+
+PJ_INLINE(void) unlock_timer_heap( pj_timer_heap_t *ht )
+{
+    if (ht->lock) {
+	pj_lock_release(ht->lock);
+    }
+}
+
+#include "timer_shard.c"
+
+
+/* Convert time to ticks. */
+PJ_INLINE(pj_uint32_t) time_to_tick( const pj_time_val *t, pj_bool_t ceil )
+{
+    return (pj_uint32_t)t->sec * TICKS_PER_SEC +
+	   (pj_uint32_t)(t->msec + (ceil ? PJ_TIMER_WHEEL_RESOLUTION-1 : 0)) /
+	   PJ_TIMER_WHEEL_RESOLUTION;
+}
+
+static void grow_nodes(pj_timer_heap_t *ht)
+{
+    pj_size_t new_size = ht->max_size * 2;
+    wheel_node *new_nodes;
+    pj_size_t i;
+
+    new_nodes = (wheel_node*)
+		pj_pool_alloc(ht->pool, new_size * sizeof(wheel_node));
+    pj_memcpy(new_nodes, ht->nodes, ht->max_size * sizeof(wheel_node));
+    ht->nodes = new_nodes;
+
+    /* Put the new nodes in the freelist */
+    for (i = ht->max_size; i < new_size; ++i) {
+	new_nodes[i].entry = NULL;
+	new_nodes[i].next = (pj_timer_id_t)(i + 1);
+    }
+    new_nodes[new_size-1].next = ht->freelist;
+    ht->freelist = (pj_timer_id_t)ht->max_size;
+
+    ht->max_size = new_size;
+}
+
+static pj_timer_id_t pop_freelist( pj_timer_heap_t *ht )
+{
+    pj_timer_id_t id;
+
+    if (ht->freelist == 0)
+	grow_nodes(ht);
+
+    id = ht->freelist;
+    ht->freelist = ht->nodes[id].next;
+    return id;
+}
+
+static void push_freelist( pj_timer_heap_t *ht, pj_timer_id_t id )
+{
+    ht->nodes[id].entry = NULL;
+    ht->nodes[id].next = ht->freelist;
+    ht->freelist = id;
+}
+
+/* Link the node to the appropriate slot, relative to cur_tick. */
+static void link_node( pj_timer_heap_t *ht, pj_timer_id_t id )
+{
+    wheel_node *node = &ht->nodes[id];
+    pj_uint32_t expires = node->expires;
+    pj_uint32_t idx = expires - ht->cur_tick;
+    unsigned slot, level;
+
+    if ((pj_int32_t)idx < 0) {
+	/* Already expired, put in the slot currently being processed */
+	expires = ht->cur_tick;
+	idx = 0;
+    } else if (idx > MAX_TICKS) {
+	/* Too far in the future, park it at the end of the wheel. It will
+	 * be re-cascaded with its real expiration time.
+	 */
+	expires = ht->cur_tick + MAX_TICKS;
+	idx = MAX_TICKS;
+    }
+
+    if (idx < WHEEL0_SIZE) {
+	level = 0;
+	slot = expires & WHEEL0_MASK;
+    } else {
+	for (level = 1; level < WHEEL_LEVELS-1; ++level) {
+	    if (idx < LEVEL_SPAN(level))
+		break;
+	}
+	slot = LEVEL_BASE(level) +
+	       ((expires >> LEVEL_SHIFT(level)) & WHEELN_MASK);
+    }
+
+    node->slot = slot;
+    node->prev = 0;
+    node->next = ht->slots[slot];
+    if (node->next)
+	ht->nodes[node->next].prev = id;
+    ht->slots[slot] = id;
+    ht->level_cnt[level]++;
+}
+
+/* Unlink the node from its slot. */
+static void unlink_node( pj_timer_heap_t *ht, pj_timer_id_t id )
+{
+    wheel_node *node = &ht->nodes[id];
+
+    if (node->prev)
+	ht->nodes[node->prev].next = node->next;
+    else
+	ht->slots[node->slot] = node->next;
+
+    if (node->next)
+	ht->nodes[node->next].prev = node->prev;
+
+    ht->level_cnt[SLOT_LEVEL(node->slot)]--;
+}
+
+/* Redistribute the entries in the current slot of the specified level
+ * to the lower levels. Returns the index of the slot.
+ */
+static unsigned cascade( pj_timer_heap_t *ht, unsigned level )
+{
+    unsigned index = (ht->cur_tick >> LEVEL_SHIFT(level)) & WHEELN_MASK;
+    unsigned slot = LEVEL_BASE(level) + index;
+    pj_timer_id_t id = ht->slots[slot];
+
+    ht->slots[slot] = 0;
+    while (id) {
+	pj_timer_id_t next = ht->nodes[id].next;
+
+	ht->level_cnt[level]--;
+	link_node(ht, id);
+	id = next;
+    }
+
+    return index;
+}
+
+/* Advance the wheel by one tick. */
+static void advance_tick( pj_timer_heap_t *ht )
+{
+    unsigned level;
+
+    ++ht->cur_tick;
+    if ((ht->cur_tick & WHEEL0_MASK) != 0)
+	return;
+
+    for (level = 1; level < WHEEL_LEVELS; ++level) {
+	if (cascade(ht, level) != 0)
+	    break;
+    }
+}
+
+static pj_timer_entry *remove_node( pj_timer_heap_t *ht, pj_timer_id_t id )
+{
+    pj_timer_entry *removed_node = ht->nodes[id].entry;
+
+    unlink_node(ht, id);
+    push_freelist(ht, id);
+    ht->cur_size--;
+
+    removed_node->_timer_id = -1;
+
+    return removed_node;
+}
+
+static pj_status_t schedule_entry( pj_timer_heap_t *ht,
+				   pj_timer_entry *entry,
+				   const pj_time_val *future_time )
+{
+    pj_timer_id_t id = pop_freelist(ht);
+    wheel_node *node = &ht->nodes[id];
+
+    node->entry = entry;
+    node->expires = time_to_tick(future_time, PJ_TRUE);
+    entry->_timer_id = id;
+    entry->_timer_value = *future_time;
+
+    link_node(ht, id);
+    ht->cur_size++;
+
+    return PJ_SUCCESS;
+}
+
+static int cancel( pj_timer_heap_t *ht,
+		   pj_timer_entry *entry,
+		   unsigned flags)
+{
+    PJ_CHECK_STACK();
+
+    /* Check to see if the timer_id is out of range */
+    if (entry->_timer_id < 1 || (pj_size_t)entry->_timer_id >= ht->max_size)
+	return 0;
+
+    if (ht->nodes[entry->_timer_id].entry != entry) {
+	if ((flags & F_DONT_ASSERT) == 0)
+	    pj_assert(ht->nodes[entry->_timer_id].entry == entry);
+	return 0;
+    }
+
+    remove_node(ht, entry->_timer_id);
+    return 1;
+}
+
+/* Get the tick of the earliest entry in the first level, but not later
+ * than the next cascade if there are entries in the upper levels (they
+ * all expire after that).
+ */
+static pj_bool_t next_expiry_tick( pj_timer_heap_t *ht, pj_uint32_t *tick )
+{
+    pj_bool_t has_upper = (ht->cur_size > ht->level_cnt[0]);
+    unsigned i;
+
+    if (ht->cur_size == 0)
+	return PJ_FALSE;
+
+    for (i=0; i<WHEEL0_SIZE; ++i) {
+	pj_uint32_t t = ht->cur_tick + i;
+
+	if (has_upper && i != 0 && (t & WHEEL0_MASK) == 0) {
+	    *tick = t;
+	    return PJ_TRUE;
+	}
+	if (ht->slots[t & WHEEL0_MASK]) {
+	    *tick = t;
+	    return PJ_TRUE;
+	}
+    }
+
+    /* Only upper levels left. */
+    *tick = (ht->cur_tick | WHEEL0_MASK) + 1;
+    return PJ_TRUE;
+}
+
+/* Get the earliest expiration time of the entries in the slot list. */
+static void slot_earliest_time( pj_timer_heap_t *ht, unsigned slot,
+				pj_bool_t *found, pj_time_val *timeval )
+{
+    pj_timer_id_t id;
+
+    for (id = ht->slots[slot]; id; id = ht->nodes[id].next) {
+	const pj_time_val *t = &ht->nodes[id].entry->_timer_value;
+
+	if (!*found || PJ_TIME_VAL_LT(*t, *timeval)) {
+	    *timeval = *t;
+	    *found = PJ_TRUE;
+	}
+    }
+}
+
+
+/*
+ * Calculate memory size required to create a timer heap.
+ */
+PJ_DEF(pj_size_t) pj_timer_heap_mem_size(pj_size_t count)
+{
+    return /* size of the timer heap itself: */
+           sizeof(pj_timer_heap_t) +
+           /* size of each entry: */
+           (count+2) * sizeof(wheel_node) +
+           /* lock, pool etc: */
+           132;
+}
+
+/*
+ * Create a new timer heap.
+ */
+PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
+					  pj_size_t size,
+                                          pj_timer_heap_t **p_heap)
+{
+    pj_timer_heap_t *ht;
+    pj_time_val now;
+    pj_size_t i;
+
+    PJ_ASSERT_RETURN(pool && p_heap, PJ_EINVAL);
+
+    *p_heap = NULL;
+
+    /* Node zero is reserved */
+    size += 2;
+
+    /* Allocate timer heap data structure from the pool */
+    ht = PJ_POOL_ZALLOC_T(pool, pj_timer_heap_t);
+    if (!ht)
+        return PJ_ENOMEM;
+
+    /* Initialize timer heap sizes */
+    ht->max_size = size;
+    ht->cur_size = 0;
+    ht->max_entries_per_poll = DEFAULT_MAX_TIMED_OUT_PER_POLL;
+    ht->pool = pool;
+
+    /* Lock. */
+    ht->lock = NULL;
+    ht->auto_delete_lock = 0;
+
+    INIT_TIMER_SHARD_FIELDS(ht);
+
+    /* Create the node array and initialize the freelist */
+    ht->nodes = (wheel_node*) pj_pool_alloc(pool, size * sizeof(wheel_node));
+    if (!ht->nodes)
+        return PJ_ENOMEM;
+
+    for (i=0; i<size; ++i) {
+	ht->nodes[i].entry = NULL;
+	ht->nodes[i].next = (pj_timer_id_t)(i + 1);
+    }
+    ht->nodes[size-1].next = 0;
+    ht->freelist = 1;
+
+    pj_gettickcount(&now);
+    ht->cur_tick = time_to_tick(&now, PJ_FALSE);
+
+    *p_heap = ht;
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_timer_heap_destroy( pj_timer_heap_t *ht )
+{
+    if (ht->shards)
+	shard_destroy(ht);
+
+    if (ht->lock && ht->auto_delete_lock) {
+        pj_lock_destroy(ht->lock);
+        ht->lock = NULL;
+    }
+}
+
+PJ_DEF(void) pj_timer_heap_set_lock(  pj_timer_heap_t *ht,
+                                      pj_lock_t *lock,
+                                      pj_bool_t auto_del )
+{
+    if (ht->lock && ht->auto_delete_lock)
+        pj_lock_destroy(ht->lock);
+
+    ht->lock = lock;
+    ht->auto_delete_lock = auto_del;
+}
+
+
+PJ_DEF(unsigned) pj_timer_heap_set_max_timed_out_per_poll(pj_timer_heap_t *ht,
+                                                          unsigned count )
+{
+    unsigned old_count = ht->max_entries_per_poll;
+    ht->max_entries_per_poll = count;
+    if (ht->shards)
+	shard_set_max_timed_out_per_poll(ht, count);
+    return old_count;
+}
+
+PJ_DEF(pj_timer_entry*) pj_timer_entry_init( pj_timer_entry *entry,
+                                             int id,
+                                             void *user_data,
+                                             pj_timer_heap_callback *cb )
+{
+    pj_assert(entry && cb);
+
+    entry->_timer_id = -1;
+    entry->id = id;
+    entry->user_data = user_data;
+    entry->cb = cb;
+    entry->_grp_lock = NULL;
+    entry->_shard_id = 0;
+
+    return entry;
+}
+
+PJ_DEF(pj_bool_t) pj_timer_entry_running( pj_timer_entry *entry )
+{
+    return (entry->_timer_id >= 1);
+}
+
+#if PJ_TIMER_DEBUG
+static pj_status_t schedule_w_grp_lock_dbg(pj_timer_heap_t *ht,
+                                           pj_timer_entry *entry,
+                                           const pj_time_val *delay,
+                                           pj_bool_t set_id,
+                                           int id_val,
+					   pj_grp_lock_t *grp_lock,
+					   const char *src_file,
+					   int src_line)
+#else
+static pj_status_t schedule_w_grp_lock(pj_timer_heap_t *ht,
+                                       pj_timer_entry *entry,
+                                       const pj_time_val *delay,
+                                       pj_bool_t set_id,
+                                       int id_val,
+                                       pj_grp_lock_t *grp_lock)
+#endif
+{
+    pj_status_t status;
+    pj_time_val expires;
+
+    PJ_ASSERT_RETURN(ht && entry && delay, PJ_EINVAL);
+    PJ_ASSERT_RETURN(entry->cb != NULL, PJ_EINVAL);
+
+    /* Schedule to the shard of the calling thread */
+    if (ht->shards)
+	ht = shard_for_schedule(ht, entry);
+
+    /* Prevent same entry from being scheduled more than once */
+    PJ_ASSERT_RETURN(entry->_timer_id < 1, PJ_EINVALIDOP);
+
+#if PJ_TIMER_DEBUG
+    entry->src_file = src_file;
+    entry->src_line = src_line;
+#endif
+    pj_gettickcount(&expires);
+    PJ_TIME_VAL_ADD(expires, *delay);
+
+    lock_timer_heap(ht);
+    status = schedule_entry(ht, entry, &expires);
+    if (status == PJ_SUCCESS) {
+	if (set_id)
+	    entry->id = id_val;
+	entry->_grp_lock = grp_lock;
+	if (entry->_grp_lock) {
+	    pj_grp_lock_add_ref(entry->_grp_lock);
+	}
+    }
+    unlock_timer_heap(ht);
+
+    return status;
+}
+
+
+#if PJ_TIMER_DEBUG
+PJ_DEF(pj_status_t) pj_timer_heap_schedule_dbg( pj_timer_heap_t *ht,
+						pj_timer_entry *entry,
+						const pj_time_val *delay,
+						const char *src_file,
+						int src_line)
+{
+    return schedule_w_grp_lock_dbg(ht, entry, delay, PJ_FALSE, 1, NULL,
+                                   src_file, src_line);
+}
+
+PJ_DEF(pj_status_t) pj_timer_heap_schedule_w_grp_lock_dbg(
+						pj_timer_heap_t *ht,
+						pj_timer_entry *entry,
+						const pj_time_val *delay,
+						int id_val,
+                                                pj_grp_lock_t *grp_lock,
+						const char *src_file,
+						int src_line)
+{
+    return schedule_w_grp_lock_dbg(ht, entry, delay, PJ_TRUE, id_val,
+                                   grp_lock, src_file, src_line);
+}
+
+#else
+PJ_DEF(pj_status_t) pj_timer_heap_schedule( pj_timer_heap_t *ht,
+                                            pj_timer_entry *entry,
+                                            const pj_time_val *delay)
+{
+    return schedule_w_grp_lock(ht, entry, delay, PJ_FALSE, 1, NULL);
+}
+
+PJ_DEF(pj_status_t) pj_timer_heap_schedule_w_grp_lock(pj_timer_heap_t *ht,
+                                                      pj_timer_entry *entry,
+                                                      const pj_time_val *delay,
+                                                      int id_val,
+                                                      pj_grp_lock_t *grp_lock)
+{
+    return schedule_w_grp_lock(ht, entry, delay, PJ_TRUE, id_val, grp_lock);
+}
+#endif
+
+static int cancel_timer(pj_timer_heap_t *ht,
+			pj_timer_entry *entry,
+			unsigned flags,
+			int id_val)
+{
+    int count;
+
+    PJ_ASSERT_RETURN(ht && entry, PJ_EINVAL);
+
+    if (ht->shards)
+	ht = shard_of_entry(ht, entry);
+
+    lock_timer_heap(ht);
+    count = cancel(ht, entry, flags | F_DONT_CALL);
+    if (flags & F_SET_ID) {
+	entry->id = id_val;
+    }
+    if (entry->_grp_lock) {
+	pj_grp_lock_t *grp_lock = entry->_grp_lock;
+	entry->_grp_lock = NULL;
+	pj_grp_lock_dec_ref(grp_lock);
+    }
+    unlock_timer_heap(ht);
+
+    return count;
+}
+
+PJ_DEF(int) pj_timer_heap_cancel( pj_timer_heap_t *ht,
+				  pj_timer_entry *entry)
+{
+    return cancel_timer(ht, entry, 0, 0);
+}
+
+PJ_DEF(int) pj_timer_heap_cancel_if_active(pj_timer_heap_t *ht,
+                                           pj_timer_entry *entry,
+                                           int id_val)
+{
+    return cancel_timer(ht, entry, F_SET_ID | F_DONT_ASSERT, id_val);
+}
+
+PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
+                                     pj_time_val *next_delay )
+{
+    pj_time_val now;
+    pj_uint32_t now_tick, next_tick;
+    unsigned count;
+
+    PJ_ASSERT_RETURN(ht, 0);
+
+    if (ht->shards)
+	return shard_poll(ht, next_delay);
+
+    lock_timer_heap(ht);
+    pj_gettickcount(&now);
+    now_tick = time_to_tick(&now, PJ_FALSE);
+
+    if (!ht->cur_size) {
+	/* Nothing to expire, just move the wheel to current time */
+	if (TICK_GT(now_tick, ht->cur_tick))
+	    ht->cur_tick = now_tick;
+	if (next_delay)
+	    next_delay->sec = next_delay->msec = PJ_MAXINT32;
+        unlock_timer_heap(ht);
+	return 0;
+    }
+
+    count = 0;
+    while (count < ht->max_entries_per_poll) {
+	pj_timer_id_t id = ht->slots[ht->cur_tick & WHEEL0_MASK];
+	pj_timer_entry *node;
+	pj_grp_lock_t *grp_lock;
+
+	if (id == 0) {
+	    /* Current slot is empty, advance the wheel */
+	    if (!TICK_GT(now_tick, ht->cur_tick) || ht->cur_size == 0)
+		break;
+	    advance_tick(ht);
+	    continue;
+	}
+
+	node = remove_node(ht, id);
+
+	++count;
+
+	grp_lock = node->_grp_lock;
+	node->_grp_lock = NULL;
+
+	unlock_timer_heap(ht);
+
+	PJ_RACE_ME(5);
+
+	if (node->cb)
+	    (*node->cb)(CALLBACK_HEAP(ht), node);
+
+	if (grp_lock)
+	    pj_grp_lock_dec_ref(grp_lock);
+
+	lock_timer_heap(ht);
+    }
+
+    if (next_delay) {
+	if (next_expiry_tick(ht, &next_tick)) {
+	    pj_int32_t ticks = (pj_int32_t)(next_tick - now_tick);
+	    pj_int32_t msec;
+
+	    msec = ticks * PJ_TIMER_WHEEL_RESOLUTION -
+		   (now.msec % PJ_TIMER_WHEEL_RESOLUTION);
+	    if (msec < 0)
+		msec = 0;
+	    next_delay->sec = msec / 1000;
+	    next_delay->msec = msec % 1000;
+	} else {
+	    next_delay->sec = next_delay->msec = PJ_MAXINT32;
+	}
+    }
+    unlock_timer_heap(ht);
+
+    return count;
+}
+
+PJ_DEF(pj_size_t) pj_timer_heap_count( pj_timer_heap_t *ht )
+{
+    PJ_ASSERT_RETURN(ht, 0);
+
+    if (ht->shards)
+	return shard_count(ht);
+
+    return ht->cur_size;
+}
+
+PJ_DEF(pj_status_t) pj_timer_heap_earliest_time( pj_timer_heap_t * ht,
+					         pj_time_val *timeval)
+{
+    pj_bool_t found = PJ_FALSE;
+    unsigned level, i;
+
+    if (ht->shards)
+	return shard_earliest_time(ht, timeval);
+
+    pj_assert(ht->cur_size != 0);
+    if (ht->cur_size == 0)
+        return PJ_ENOTFOUND;
+
+    lock_timer_heap(ht);
+
+    /* First level: the first non-empty slot from current tick */
+    for (i=0; i<WHEEL0_SIZE; ++i) {
+	unsigned slot = (ht->cur_tick + i) & WHEEL0_MASK;
+	if (ht->slots[slot]) {
+	    slot_earliest_time(ht, slot, &found, timeval);
+	    break;
+	}
+    }
+
+    /* Upper levels: the first non-empty slot after the current slot (the
+     * current slot itself contains the furthest entries of the level).
+     */
+    for (level=1; level<WHEEL_LEVELS; ++level) {
+	unsigned index = (ht->cur_tick >> LEVEL_SHIFT(level)) & WHEELN_MASK;
+
+	if (ht->level_cnt[level] == 0)
+	    continue;
+
+	for (i=1; i<=WHEELN_SIZE; ++i) {
+	    unsigned slot = LEVEL_BASE(level) + ((index + i) & WHEELN_MASK);
+	    if (ht->slots[slot]) {
+		slot_earliest_time(ht, slot, &found, timeval);
+		break;
+	    }
+	}
+    }
+
+    unlock_timer_heap(ht);
+
+    return found ? PJ_SUCCESS : PJ_ENOTFOUND;
+}
+
+#if PJ_TIMER_DEBUG
+PJ_DEF(void) pj_timer_heap_dump(pj_timer_heap_t *ht)
+{
+    if (ht->shards) {
+	shard_dump(ht);
+	return;
+    }
+
+    lock_timer_heap(ht);
+
+    PJ_LOG(3,(THIS_FILE, "Dumping timer wheel:"));
+    PJ_LOG(3,(THIS_FILE, "  Cur size: %d entries, max: %d",
+			 (int)ht->cur_size, (int)ht->max_size));
+    PJ_LOG(3,(THIS_FILE, "  Entries per level: %d, %d, %d, %d",
+			 (int)ht->level_cnt[0], (int)ht->level_cnt[1],
+			 (int)ht->level_cnt[2], (int)ht->level_cnt[3]));
+
+    if (ht->cur_size) {
+	pj_size_t i;
+	pj_time_val now;
+
+	PJ_LOG(3,(THIS_FILE, "  Entries: "));
+	PJ_LOG(3,(THIS_FILE, "    _id\tId\tElapsed\tSource"));
+	PJ_LOG(3,(THIS_FILE, "    ----------------------------------"));
+
+	pj_gettickcount(&now);
+
+	for (i=1; i<ht->max_size; ++i) {
+	    pj_timer_entry *e = ht->nodes[i].entry;
+	    pj_time_val delta;
+
+	    if (!e)
+		continue;
+
+	    if (PJ_TIME_VAL_LTE(e->_timer_value, now))
+		delta.sec = delta.msec = 0;
+	    else {
+		delta = e->_timer_value;
+		PJ_TIME_VAL_SUB(delta, now);
+	    }
+
+	    PJ_LOG(3,(THIS_FILE, "    %d\t%d\t%d.%03d\t%s:%d",
+		      e->_timer_id, e->id,
+		      (int)delta.sec, (int)delta.msec,
+		      e->src_file, e->src_line));
+	}
+    }
+
+    unlock_timer_heap(ht);
+}
+#endif
+
+#endif	/* PJ_TIMER_HEAP_IMPLEMENTATION==PJ_TIMER_HEAP_WHEEL */
+
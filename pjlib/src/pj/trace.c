@@ -0,0 +1,562 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include <pj/trace.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/file_io.h>
+#include <pj/list.h>
+#include <pj/os.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+
+#define THIS_FILE	"trace.c"
+
+#if PJ_HAS_ATOMIC_BUILTINS
+
+/* Recorded event. The category and name are not copied. */
+typedef struct trace_rec
+{
+    pj_timestamp	 ts;
+    const char		*cat;
+    const char		*name;
+    int			 phase;
+} trace_rec;
+
+/* Ring buffer of a thread. Only the owner thread writes the records, the
+ * oldest ones are overwritten when it's full. The head is a free running
+ * counter of the records written so far.
+ *
+ * The owner claims the ring with the active flag while writing a record.
+ * When a new thread needs a ring, the rings of registered threads which
+ * have not recorded anything for PJ_TRACE_RING_IDLE msec, e.g. because
+ * the thread has exited, are taken back with their events discarded, and
+ * reused. Their owner then fails to claim the ring and gets a new one.
+ */
+typedef struct trace_ring
+{
+    PJ_DECL_LIST_MEMBER(struct trace_ring);
+    trace_rec		*recs;
+    pj_uint32_t		 mask;
+    pj_uint32_t		 head;
+    int			 active;	/* Claimed by owner, or RING_FREE   */
+    pj_thread_t		*owner;		/* NULL if not registered	    */
+    pj_timestamp	 reset_ts;	/* When the ring was (re)started    */
+    unsigned		 tid;
+    char		 thread_name[PJ_MAX_OBJ_NAME];
+} trace_ring;
+
+/* Value of the active flag of a ring which is being taken back */
+#define RING_FREE	2
+
+static struct trace
+{
+    int			 enabled;
+    pj_bool_t		 initialized;
+
+    pj_caching_pool	 cp;
+    pj_pool_t		*pool;
+    pj_mutex_t		*mutex;
+    long		 ring_tls;
+    pj_uint32_t		 ring_size;
+    pj_timestamp	 start;
+    pj_timestamp	 freq;
+
+    /* Protected by mutex */
+    trace_ring		 ring_list;
+    trace_ring		 free_ring_list;
+    unsigned		 ring_cnt;
+} trace;
+
+/* Wait until the owners are done with the records they are writing.
+ * Recording must have been disabled.
+ */
+static void trace_wait_idle(void)
+{
+    trace_ring *ring;
+
+    for (ring=trace.ring_list.next; ring!=&trace.ring_list;
+	 ring=ring->next)
+    {
+	while (__atomic_load_n(&ring->active, __ATOMIC_SEQ_CST) == 1)
+	    pj_thread_sleep(0);
+    }
+}
+
+static void trace_shutdown(void)
+{
+    __atomic_store_n(&trace.enabled, 0, __ATOMIC_SEQ_CST);
+
+    pj_mutex_lock(trace.mutex);
+    trace_wait_idle();
+    pj_mutex_unlock(trace.mutex);
+
+    pj_thread_local_free(trace.ring_tls);
+    trace.ring_tls = -1;
+    pj_mutex_destroy(trace.mutex);
+    trace.mutex = NULL;
+    pj_pool_release(trace.pool);
+    trace.pool = NULL;
+    pj_caching_pool_destroy(&trace.cp);
+    trace.initialized = PJ_FALSE;
+}
+
+/* Get the ring buffer size for the size given to pj_trace_start() */
+static pj_uint32_t trace_ring_size(unsigned ring_size)
+{
+    pj_uint32_t size;
+
+    if (ring_size == 0)
+	ring_size = PJ_TRACE_RING_SIZE;
+    for (size=64; size < ring_size; size <<= 1)
+	;
+    return size;
+}
+
+static pj_status_t trace_init(unsigned ring_size)
+{
+    pj_uint32_t size;
+    pj_status_t status;
+
+    size = trace.ring_size = trace_ring_size(ring_size);
+
+    /* Use a private pool factory, so that the ring buffers don't depend
+     * on the lifetime of application's pool factory.
+     */
+    pj_caching_pool_init(&trace.cp, NULL, 0);
+    trace.pool = pj_pool_create(&trace.cp.factory, "trace", 1024,
+				size * sizeof(trace_rec) + 1024, NULL);
+    if (!trace.pool) {
+	pj_caching_pool_destroy(&trace.cp);
+	return PJ_ENOMEM;
+    }
+
+    pj_list_init(&trace.ring_list);
+    pj_list_init(&trace.free_ring_list);
+    trace.ring_cnt = 0;
+    trace.ring_tls = -1;
+
+    status = pj_mutex_create_simple(trace.pool, "trace", &trace.mutex);
+    if (status == PJ_SUCCESS)
+	status = pj_thread_local_alloc(&trace.ring_tls);
+    if (status != PJ_SUCCESS) {
+	if (trace.mutex) {
+	    pj_mutex_destroy(trace.mutex);
+	    trace.mutex = NULL;
+	}
+	pj_pool_release(trace.pool);
+	trace.pool = NULL;
+	pj_caching_pool_destroy(&trace.cp);
+	return status;
+    }
+
+    pj_get_timestamp_freq(&trace.freq);
+    pj_get_timestamp(&trace.start);
+
+    pj_atexit(&trace_shutdown);
+    trace.initialized = PJ_TRUE;
+
+    return PJ_SUCCESS;
+}
+
+/* Claim the ring buffer for writing a record. */
+static pj_bool_t trace_claim_ring(trace_ring *ring)
+{
+    int idle = 0;
+
+    /* Announce the write before checking the enabled flag, so that
+     * pj_trace_stop() either sees us active or we see it disabled.
+     */
+    if (!__atomic_compare_exchange_n(&ring->active, &idle, 1, PJ_FALSE,
+				     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    {
+	return PJ_FALSE;
+    }
+
+    /* The ring may have been taken back and given to another thread.
+     * The rings of unregistered threads are never taken back.
+     */
+    if (ring->owner && ring->owner != pj_thread_this()) {
+	__atomic_store_n(&ring->active, 0, __ATOMIC_RELEASE);
+	return PJ_FALSE;
+    }
+
+    return PJ_TRUE;
+}
+
+/* Take back the rings which have been idle for PJ_TRACE_RING_IDLE msec.
+ * Mutex must be held.
+ */
+static void trace_sweep_rings(void)
+{
+    pj_uint64_t idle_ts = trace.freq.u64 * PJ_TRACE_RING_IDLE / 1000;
+    trace_ring *ring, *next;
+    pj_timestamp now;
+
+    pj_get_timestamp(&now);
+
+    for (ring=trace.ring_list.next; ring!=&trace.ring_list; ring=next) {
+	pj_uint32_t head;
+	pj_uint64_t last;
+	int idle = 0;
+
+	next = ring->next;
+	if (!ring->owner ||
+	    !__atomic_compare_exchange_n(&ring->active, &idle, RING_FREE,
+					 PJ_FALSE, __ATOMIC_ACQUIRE,
+					 __ATOMIC_RELAXED))
+	{
+	    continue;
+	}
+
+	head = ring->head;
+	last = head ? ring->recs[(head - 1) & ring->mask].ts.u64 :
+		      ring->reset_ts.u64;
+	if (now.u64 - last < idle_ts) {
+	    __atomic_store_n(&ring->active, 0, __ATOMIC_RELEASE);
+	    continue;
+	}
+
+	pj_list_erase(ring);
+	pj_list_push_back(&trace.free_ring_list, ring);
+    }
+}
+
+/* Get a ring buffer for the calling thread, and claim it. */
+static trace_ring *trace_get_ring(void)
+{
+    trace_ring *ring;
+
+    pj_mutex_lock(trace.mutex);
+
+    trace_sweep_rings();
+    if (!pj_list_empty(&trace.free_ring_list)) {
+	ring = trace.free_ring_list.next;
+	pj_list_erase(ring);
+    } else {
+	ring = PJ_POOL_ZALLOC_T(trace.pool, trace_ring);
+	ring->recs = (trace_rec*) pj_pool_calloc(trace.pool, trace.ring_size,
+						 sizeof(trace_rec));
+	ring->mask = trace.ring_size - 1;
+    }
+
+    /* The ring is claimed until the first record is written */
+    ring->head = 0;
+    ring->tid = ++trace.ring_cnt;
+    pj_get_timestamp(&ring->reset_ts);
+    if (pj_thread_is_registered()) {
+	ring->owner = pj_thread_this();
+	pj_ansi_strncpy(ring->thread_name,
+			pj_thread_get_name(ring->owner),
+			sizeof(ring->thread_name) - 1);
+    } else {
+	ring->owner = NULL;
+	pj_ansi_snprintf(ring->thread_name, sizeof(ring->thread_name),
+			 "thread%u", ring->tid);
+    }
+    __atomic_store_n(&ring->active, 1, __ATOMIC_SEQ_CST);
+    pj_list_push_back(&trace.ring_list, ring);
+
+    pj_mutex_unlock(trace.mutex);
+
+    pj_thread_local_set(trace.ring_tls, ring);
+    return ring;
+}
+
+PJ_DEF(pj_status_t) pj_trace_start(unsigned ring_size)
+{
+    if (!trace.initialized) {
+	pj_status_t status = trace_init(ring_size);
+	if (status != PJ_SUCCESS)
+	    return status;
+    } else if (ring_size && trace_ring_size(ring_size) != trace.ring_size) {
+	/* The ring buffers are only allocated once */
+	return PJ_EINVALIDOP;
+    }
+
+    __atomic_store_n(&trace.enabled, 1, __ATOMIC_SEQ_CST);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_trace_stop(void)
+{
+    if (!trace.initialized)
+	return PJ_SUCCESS;
+
+    __atomic_store_n(&trace.enabled, 0, __ATOMIC_SEQ_CST);
+
+    pj_mutex_lock(trace.mutex);
+    trace_wait_idle();
+    pj_mutex_unlock(trace.mutex);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_trace_clear(void)
+{
+    trace_ring *ring;
+
+    if (!trace.initialized)
+	return PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(!__atomic_load_n(&trace.enabled, __ATOMIC_SEQ_CST),
+		     PJ_EINVALIDOP);
+
+    pj_mutex_lock(trace.mutex);
+    trace_wait_idle();
+    for (ring=trace.ring_list.next; ring!=&trace.ring_list;
+	 ring=ring->next)
+    {
+	pj_get_timestamp(&ring->reset_ts);
+	__atomic_store_n(&ring->head, 0, __ATOMIC_SEQ_CST);
+    }
+    pj_mutex_unlock(trace.mutex);
+
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_trace_event(const char *cat, const char *name,
+			    pj_trace_phase phase)
+{
+    trace_ring *ring;
+    trace_rec *rec;
+    pj_uint32_t head;
+
+    if (!__atomic_load_n(&trace.enabled, __ATOMIC_RELAXED))
+	return;
+
+    ring = (trace_ring*) pj_thread_local_get(trace.ring_tls);
+    if (!ring || !trace_claim_ring(ring))
+	ring = trace_get_ring();
+
+    if (__atomic_load_n(&trace.enabled, __ATOMIC_SEQ_CST)) {
+	head = ring->head;
+	rec = &ring->recs[head & ring->mask];
+	pj_get_timestamp(&rec->ts);
+	rec->cat = cat;
+	rec->name = name;
+	rec->phase = phase;
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&ring->active, 0, __ATOMIC_RELEASE);
+}
+
+/* Output buffer of the dump */
+typedef struct trace_out
+{
+    pj_oshandle_t	 fd;
+    char		 buf[2048];
+    pj_size_t		 len;
+    pj_status_t		 status;
+} trace_out;
+
+static void out_flush(trace_out *out)
+{
+    pj_ssize_t size = (pj_ssize_t)out->len;
+
+    if (out->len && out->status == PJ_SUCCESS)
+	out->status = pj_file_write(out->fd, out->buf, &size);
+    out->len = 0;
+}
+
+static void out_str(trace_out *out, const char *str)
+{
+    for (; *str; ++str) {
+	if (out->len + 2 > sizeof(out->buf))
+	    out_flush(out);
+	out->buf[out->len++] = *str;
+    }
+}
+
+/* Append a JSON string value, without the quotes. */
+static void out_json_str(trace_out *out, const char *str)
+{
+    for (; *str; ++str) {
+	if (out->len + 2 > sizeof(out->buf))
+	    out_flush(out);
+	if (*str == '"' || *str == '\\')
+	    out->buf[out->len++] = '\\';
+	out->buf[out->len++] = ((unsigned char)*str < 0x20) ? ' ' : *str;
+    }
+}
+
+/* Append the timestamp in microseconds since the start of the trace. */
+static void out_ts(trace_out *out, const pj_timestamp *ts)
+{
+    pj_uint64_t elapsed, sec, nsec;
+    char num[40];
+
+    elapsed = ts->u64 - trace.start.u64;
+    sec = elapsed / trace.freq.u64;
+    nsec = (elapsed % trace.freq.u64) * 1000000000 / trace.freq.u64;
+
+    if (sec) {
+	pj_ansi_snprintf(num, sizeof(num), "%u%06u.%03u", (unsigned)sec,
+			 (unsigned)(nsec / 1000), (unsigned)(nsec % 1000));
+    } else {
+	pj_ansi_snprintf(num, sizeof(num), "%u.%03u",
+			 (unsigned)(nsec / 1000), (unsigned)(nsec % 1000));
+    }
+    out_str(out, num);
+}
+
+/* Write the events of a ring buffer. The records that may have been
+ * overwritten by the owner while they were being copied are skipped.
+ */
+static void dump_ring(trace_out *out, trace_ring *ring, trace_rec *copy,
+		      pj_bool_t *first)
+{
+    pj_uint32_t size = ring->mask + 1;
+    pj_uint32_t head, start, i;
+    char num[16];
+
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (head == 0)
+	return;
+
+    pj_ansi_snprintf(num, sizeof(num), "%u", ring->tid);
+
+    /* Thread name metadata */
+    out_str(out, *first ? "\n" : ",\n");
+    *first = PJ_FALSE;
+    out_str(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+		 "\"tid\":");
+    out_str(out, num);
+    out_str(out, ",\"args\":{\"name\":\"");
+    out_json_str(out, ring->thread_name);
+    out_str(out, "\"}}");
+
+    start = head > size ? head - size : 0;
+    for (i=start; i!=head; ++i)
+	copy[i & ring->mask] = ring->recs[i & ring->mask];
+
+    /* The owner may be writing the record at the new head, which
+     * overwrites the one a ring size before.
+     */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    i = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (i - start >= size)
+	start = i - size + 1;
+
+    for (i=start; (pj_int32_t)(head - i) > 0; ++i) {
+	const trace_rec *rec = &copy[i & ring->mask];
+	char ph[2];
+
+	ph[0] = (char)rec->phase;
+	ph[1] = '\0';
+
+	out_str(out, ",\n{\"name\":\"");
+	out_json_str(out, rec->name);
+	out_str(out, "\",\"cat\":\"");
+	out_json_str(out, rec->cat);
+	out_str(out, "\",\"ph\":\"");
+	out_str(out, ph);
+	out_str(out, "\",\"ts\":");
+	out_ts(out, &rec->ts);
+	out_str(out, ",\"pid\":1,\"tid\":");
+	out_str(out, num);
+	if (rec->phase == PJ_TRACE_PHASE_INSTANT)
+	    out_str(out, ",\"s\":\"t\"");
+	out_str(out, "}");
+    }
+}
+
+PJ_DEF(pj_status_t) pj_trace_dump(const char *filename)
+{
+    trace_out *out;
+    trace_rec *copy;
+    trace_ring *ring;
+    pj_pool_t *pool;
+    pj_bool_t first = PJ_TRUE;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(filename, PJ_EINVAL);
+
+    if (!trace.initialized)
+	return PJ_EINVALIDOP;
+
+    pool = pj_pool_create(&trace.cp.factory, "tracedump",
+			  trace.ring_size * sizeof(trace_rec) + 4096, 1024,
+			  NULL);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    out = PJ_POOL_ZALLOC_T(pool, trace_out);
+    copy = (trace_rec*) pj_pool_alloc(pool,
+				      trace.ring_size * sizeof(trace_rec));
+
+    status = pj_file_open(pool, filename, PJ_O_WRONLY, &out->fd);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return status;
+    }
+
+    out_str(out, "{\"traceEvents\":[");
+
+    pj_mutex_lock(trace.mutex);
+    for (ring=trace.ring_list.next; ring!=&trace.ring_list;
+	 ring=ring->next)
+    {
+	dump_ring(out, ring, copy, &first);
+    }
+    pj_mutex_unlock(trace.mutex);
+
+    out_str(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    out_flush(out);
+
+    status = out->status;
+    pj_file_close(out->fd);
+    pj_pool_release(pool);
+
+    return status;
+}
+
+#else	/* PJ_HAS_ATOMIC_BUILTINS */
+
+PJ_DEF(pj_status_t) pj_trace_start(unsigned ring_size)
+{
+    PJ_UNUSED_ARG(ring_size);
+    return PJ_ENOTSUP;
+}
+
+PJ_DEF(pj_status_t) pj_trace_stop(void)
+{
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_trace_clear(void)
+{
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(void) pj_trace_event(const char *cat, const char *name,
+			    pj_trace_phase phase)
+{
+    PJ_UNUSED_ARG(cat);
+    PJ_UNUSED_ARG(name);
+    PJ_UNUSED_ARG(phase);
+}
+
+PJ_DEF(pj_status_t) pj_trace_dump(const char *filename)
+{
+    PJ_ASSERT_RETURN(filename, PJ_EINVAL);
+    return PJ_EINVALIDOP;
+}
+
+#endif	/* PJ_HAS_ATOMIC_BUILTINS */
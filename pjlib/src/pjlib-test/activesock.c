@@ -494,6 +494,508 @@ on_return:
 
 
 
+/*******************************************************************
+ * UDP batch receive test: a burst of packets sent with
+ * pj_sock_sendmmsg() must all be delivered by on_data_recvfrom_batch(),
+ * with more than one packet per callback.
+ */
+struct udp_batch_rx
+{
+    unsigned		 rx_cnt;
+    unsigned		 cb_cnt;
+    unsigned		 max_batch;
+    unsigned		 err_cnt;
+    unsigned		 order_err;
+    pj_uint32_t		 seen;
+};
+
+static pj_bool_t udp_batch_on_data_recvfrom_batch(pj_activesock_t *asock,
+						  const pj_sock_msg pkt[],
+						  unsigned count,
+						  pj_status_t status)
+{
+    struct udp_batch_rx *rx;
+    unsigned i;
+
+    rx = (struct udp_batch_rx*) pj_activesock_get_user_data(asock);
+
+    if (status != PJ_SUCCESS) {
+	rx->err_cnt++;
+	udp_echo_err("recvfrom batch callback", status);
+	return PJ_TRUE;
+    }
+
+    rx->cb_cnt++;
+    if (count > rx->max_batch)
+	rx->max_batch = count;
+
+    for (i=0; i<count; ++i) {
+	pj_uint32_t seq;
+
+	if (pkt[i].len != sizeof(seq) || 
+	    pkt[i].addr.addr.sa_family != pj_AF_INET())
+	{
+	    rx->err_cnt++;
+	    continue;
+	}
+	pj_memcpy(&seq, pkt[i].buf, sizeof(seq));
+	if (seq != rx->rx_cnt)
+	    rx->order_err++;
+	if (seq < 32)
+	    rx->seen |= (1 << seq);
+	rx->rx_cnt++;
+    }
+
+    return PJ_TRUE;
+}
+
+static int udp_batch_test(void)
+{
+    enum { PKT_CNT = 32, BATCH = 8 };
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_pool_t *pool = NULL;
+    pj_activesock_t *asock = NULL;
+    pj_activesock_cfg cfg;
+    pj_activesock_cb cb;
+    struct udp_batch_rx rx;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_sockaddr addr;
+    pj_sock_msg msg[PKT_CNT];
+    pj_uint32_t seq[PKT_CNT];
+    pj_str_t loopback;
+    unsigned i, cnt, min_batch, max_batch;
+    int ret = 0;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "udpbatch", 512, 512, NULL);
+    if (!pool)
+	return -200;
+
+    status = pj_ioqueue_create(pool, 4, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	ret = -210;
+	udp_echo_err("pj_ioqueue_create()", status);
+	goto on_return;
+    }
+
+    pj_bzero(&rx, sizeof(rx));
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_data_recvfrom_batch = &udp_batch_on_data_recvfrom_batch;
+
+    pj_activesock_cfg_default(&cfg);
+    cfg.batch_cnt = BATCH;
+
+    loopback = pj_str("127.0.0.1");
+    pj_sockaddr_in_init(&addr.ipv4, &loopback, 0);
+    status = pj_activesock_create_udp(pool, &addr, &cfg, ioqueue, &cb,
+				      &rx, &asock, &addr);
+    if (status != PJ_SUCCESS) {
+	ret = -220;
+	udp_echo_err("pj_activesock_create_udp()", status);
+	goto on_return;
+    }
+
+    status = pj_activesock_start_recvfrom(asock, pool, 32, 0);
+    if (status != PJ_SUCCESS) {
+	ret = -230;
+	udp_echo_err("pj_activesock_start_recvfrom()", status);
+	goto on_return;
+    }
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock);
+    if (status != PJ_SUCCESS) {
+	ret = -240;
+	goto on_return;
+    }
+
+    /* Send the whole burst before polling the ioqueue */
+    for (i=0; i<PKT_CNT; ++i) {
+	seq[i] = i;
+	msg[i].buf = &seq[i];
+	msg[i].len = sizeof(seq[i]);
+	pj_memcpy(&msg[i].addr, &addr, sizeof(pj_sockaddr_in));
+	msg[i].addr_len = sizeof(pj_sockaddr_in);
+    }
+    cnt = PKT_CNT;
+    status = pj_sock_sendmmsg(sock, msg, &cnt, 0);
+    if (status != PJ_SUCCESS || cnt != PKT_CNT) {
+	ret = -250;
+	udp_echo_err("pj_sock_sendmmsg()", status);
+	goto on_return;
+    }
+
+    for (i=0; i<100 && rx.rx_cnt < PKT_CNT; ++i) {
+	pj_time_val delay = {0, 10};
+	pj_ioqueue_poll(ioqueue, &delay);
+    }
+
+    if (rx.err_cnt) {
+	ret = -260;
+	goto on_return;
+    }
+
+    if (rx.rx_cnt != PKT_CNT || rx.seen != 0xFFFFFFFF) {
+	PJ_LOG(3,("", "...error: received %u of %u packets",
+		  rx.rx_cnt, PKT_CNT));
+	ret = -270;
+	goto on_return;
+    }
+
+    /* The rest of the burst is only read with recvmmsg() if the backend
+     * allows reading the socket directly. Otherwise (e.g. io_uring) every
+     * batch has one packet.
+     */
+    if (rx.order_err) {
+	PJ_LOG(3,("", "...error: %u packets out of order", rx.order_err));
+	ret = -275;
+	goto on_return;
+    }
+
+    if (pj_ioqueue_get_features() & PJ_IOQUEUE_FEATURE_DIRECT_READ) {
+	min_batch = 2;
+	max_batch = BATCH;
+    } else {
+	min_batch = max_batch = 1;
+    }
+
+    if (rx.max_batch < min_batch || rx.max_batch > max_batch) {
+	PJ_LOG(3,("", "...error: unexpected batch size %u", rx.max_batch));
+	ret = -280;
+	goto on_return;
+    }
+
+    PJ_LOG(3,("", "...%u packets in %u callbacks, max batch=%u",
+	      rx.rx_cnt, rx.cb_cnt, rx.max_batch));
+
+on_return:
+    if (sock != PJ_INVALID_SOCKET)
+	pj_sock_close(sock);
+    if (asock)
+	pj_activesock_close(asock);
+    if (ioqueue)
+	pj_ioqueue_destroy(ioqueue);
+    if (pool)
+	pj_pool_release(pool);
+    return ret;
+}
+
+
+/*******************************************************************
+ * Buffer lending test: the received packets are kept by the
+ * application beyond the callback, and must not be overwritten by the
+ * subsequent reads until they are released, even after the active
+ * socket has been closed.
+ */
+#define LEND_PKT_CNT	16
+
+struct udp_lend_rx
+{
+    unsigned		 rx_cnt;
+    unsigned		 err_cnt;
+    pj_activesock_buf	*buf[LEND_PKT_CNT];
+    pj_uint32_t		*seq[LEND_PKT_CNT];
+};
+
+static pj_bool_t udp_lend_on_data_recvfrom_buf(pj_activesock_t *asock,
+					       pj_activesock_buf *buf,
+					       void *data,
+					       pj_size_t size,
+					       const pj_sockaddr_t *src_addr,
+					       int addr_len,
+					       pj_status_t status)
+{
+    struct udp_lend_rx *rx;
+
+    PJ_UNUSED_ARG(src_addr);
+    PJ_UNUSED_ARG(addr_len);
+
+    rx = (struct udp_lend_rx*) pj_activesock_get_user_data(asock);
+
+    if (status != PJ_SUCCESS || !buf || size != sizeof(pj_uint32_t) ||
+	rx->rx_cnt >= LEND_PKT_CNT)
+    {
+	rx->err_cnt++;
+	if (buf)
+	    pj_activesock_buf_dec_ref(buf);
+	return PJ_TRUE;
+    }
+
+    /* Keep the buffer, the data is checked later */
+    rx->buf[rx->rx_cnt] = buf;
+    rx->seq[rx->rx_cnt] = (pj_uint32_t*) data;
+    rx->rx_cnt++;
+
+    return PJ_TRUE;
+}
+
+static int udp_lend_test(void)
+{
+    pj_caching_pool *cp = (pj_caching_pool*) mem;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_pool_t *pool = NULL;
+    pj_activesock_t *asock = NULL;
+    pj_activesock_cb cb;
+    struct udp_lend_rx rx;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_sockaddr addr;
+    pj_str_t loopback;
+    pj_size_t used_cnt;
+    unsigned i;
+    int ret = 0;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "udplend", 512, 512, NULL);
+    if (!pool)
+	return -300;
+
+    status = pj_ioqueue_create(pool, 4, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	ret = -310;
+	udp_echo_err("pj_ioqueue_create()", status);
+	goto on_return;
+    }
+
+    pj_bzero(&rx, sizeof(rx));
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_data_recvfrom_buf = &udp_lend_on_data_recvfrom_buf;
+
+    loopback = pj_str("127.0.0.1");
+    pj_sockaddr_in_init(&addr.ipv4, &loopback, 0);
+    status = pj_activesock_create_udp(pool, &addr, NULL, ioqueue, &cb,
+				      &rx, &asock, &addr);
+    if (status != PJ_SUCCESS) {
+	ret = -320;
+	udp_echo_err("pj_activesock_create_udp()", status);
+	goto on_return;
+    }
+
+    status = pj_activesock_start_recvfrom(asock, pool, 32, 0);
+    if (status != PJ_SUCCESS) {
+	ret = -330;
+	udp_echo_err("pj_activesock_start_recvfrom()", status);
+	goto on_return;
+    }
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock);
+    if (status != PJ_SUCCESS) {
+	ret = -340;
+	goto on_return;
+    }
+
+    /* Send the packets one at a time, so that each one is received into
+     * the buffer that replaced the previous one.
+     */
+    for (i=0; i<LEND_PKT_CNT; ++i) {
+	pj_uint32_t seq = i;
+	pj_ssize_t len = sizeof(seq);
+	unsigned j;
+
+	status = pj_sock_sendto(sock, &seq, &len, 0, &addr,
+				pj_sockaddr_get_len(&addr));
+	if (status != PJ_SUCCESS) {
+	    ret = -350;
+	    goto on_return;
+	}
+
+	for (j=0; j<100 && rx.rx_cnt <= i; ++j) {
+	    pj_time_val delay = {0, 10};
+	    pj_ioqueue_poll(ioqueue, &delay);
+	}
+
+	/* Release every other buffer right away, so that it is reused */
+	if (rx.rx_cnt == i+1 && (i % 2) == 1) {
+	    pj_activesock_buf_dec_ref(rx.buf[i]);
+	    rx.buf[i] = NULL;
+	}
+    }
+
+    if (rx.err_cnt || rx.rx_cnt != LEND_PKT_CNT) {
+	PJ_LOG(3,("", "...error: received %u of %u packets, %u errors",
+		  rx.rx_cnt, LEND_PKT_CNT, rx.err_cnt));
+	ret = -360;
+	goto on_return;
+    }
+
+    /* Close the active socket, the held buffers must stay intact */
+    pj_activesock_close(asock);
+    asock = NULL;
+
+    for (i=0; i<LEND_PKT_CNT; i+=2) {
+	if (*rx.seq[i] != i) {
+	    PJ_LOG(3,("", "...error: held buffer %u was overwritten", i));
+	    ret = -370;
+	    goto on_return;
+	}
+    }
+
+    /* The extra reference keeps the buffer after the first release */
+    pj_activesock_buf_add_ref(rx.buf[0]);
+    pj_activesock_buf_dec_ref(rx.buf[0]);
+    if (*rx.seq[0] != 0) {
+	ret = -380;
+	goto on_return;
+    }
+
+    /* The buffer pool is released with the last buffer */
+    used_cnt = cp->used_count;
+    for (i=0; i<LEND_PKT_CNT; i+=2) {
+	pj_activesock_buf_dec_ref(rx.buf[i]);
+	rx.buf[i] = NULL;
+    }
+    if (cp->used_count != used_cnt - 1) {
+	PJ_LOG(3,("", "...error: buffer pool was not released"));
+	ret = -390;
+	goto on_return;
+    }
+
+on_return:
+    for (i=0; i<LEND_PKT_CNT; ++i) {
+	if (rx.buf[i])
+	    pj_activesock_buf_dec_ref(rx.buf[i]);
+    }
+    if (sock != PJ_INVALID_SOCKET)
+	pj_sock_close(sock);
+    if (asock)
+	pj_activesock_close(asock);
+    if (ioqueue)
+	pj_ioqueue_destroy(ioqueue);
+    if (pool)
+	pj_pool_release(pool);
+    return ret;
+}
+
+
+/*******************************************************************
+ * UDP pause/resume read test.
+ */
+#define PAUSE_PKT_CNT	4
+
+static pj_bool_t udp_pause_on_data_recvfrom(pj_activesock_t *asock,
+					    void *data,
+					    pj_size_t size,
+					    const pj_sockaddr_t *src_addr,
+					    int addr_len,
+					    pj_status_t status)
+{
+    unsigned *rx_cnt = (unsigned*) pj_activesock_get_user_data(asock);
+
+    PJ_UNUSED_ARG(data);
+    PJ_UNUSED_ARG(size);
+    PJ_UNUSED_ARG(src_addr);
+    PJ_UNUSED_ARG(addr_len);
+
+    if (status != PJ_SUCCESS)
+	return PJ_TRUE;
+
+    /* Stop reading after the first packet */
+    if (++(*rx_cnt) == 1)
+	pj_activesock_pause_read(asock);
+
+    return PJ_TRUE;
+}
+
+static int udp_pause_test(void)
+{
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_pool_t *pool = NULL;
+    pj_activesock_t *asock = NULL;
+    pj_activesock_cb cb;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_sockaddr addr;
+    pj_str_t loopback;
+    unsigned i, rx_cnt = 0;
+    int ret = 0;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "udppause", 512, 512, NULL);
+    if (!pool)
+	return -400;
+
+    status = pj_ioqueue_create(pool, 4, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	ret = -410;
+	udp_echo_err("pj_ioqueue_create()", status);
+	goto on_return;
+    }
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_data_recvfrom = &udp_pause_on_data_recvfrom;
+
+    loopback = pj_str("127.0.0.1");
+    pj_sockaddr_in_init(&addr.ipv4, &loopback, 0);
+    status = pj_activesock_create_udp(pool, &addr, NULL, ioqueue, &cb,
+				      &rx_cnt, &asock, &addr);
+    if (status != PJ_SUCCESS) {
+	ret = -420;
+	udp_echo_err("pj_activesock_create_udp()", status);
+	goto on_return;
+    }
+
+    status = pj_activesock_start_recvfrom(asock, pool, 32, 0);
+    if (status != PJ_SUCCESS) {
+	ret = -430;
+	goto on_return;
+    }
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock);
+    if (status != PJ_SUCCESS) {
+	ret = -440;
+	goto on_return;
+    }
+
+    for (i=0; i<PAUSE_PKT_CNT; ++i) {
+	pj_uint32_t seq = i;
+	pj_ssize_t len = sizeof(seq);
+
+	status = pj_sock_sendto(sock, &seq, &len, 0, &addr,
+				pj_sockaddr_get_len(&addr));
+	if (status != PJ_SUCCESS) {
+	    ret = -450;
+	    goto on_return;
+	}
+    }
+
+    /* Only the first packet is read while paused */
+    for (i=0; i<20; ++i) {
+	pj_time_val delay = {0, 10};
+	pj_ioqueue_poll(ioqueue, &delay);
+    }
+    if (rx_cnt != 1) {
+	PJ_LOG(3,("", "...error: received %u packets while paused", rx_cnt));
+	ret = -460;
+	goto on_return;
+    }
+
+    /* The rest are read after resuming */
+    status = pj_activesock_resume_read(asock);
+    if (status != PJ_SUCCESS) {
+	ret = -470;
+	goto on_return;
+    }
+    for (i=0; i<100 && rx_cnt < PAUSE_PKT_CNT; ++i) {
+	pj_time_val delay = {0, 10};
+	pj_ioqueue_poll(ioqueue, &delay);
+    }
+    if (rx_cnt != PAUSE_PKT_CNT) {
+	PJ_LOG(3,("", "...error: received %u of %u packets after resume",
+		  rx_cnt, PAUSE_PKT_CNT));
+	ret = -480;
+	goto on_return;
+    }
+
+on_return:
+    if (sock != PJ_INVALID_SOCKET)
+	pj_sock_close(sock);
+    if (asock)
+	pj_activesock_close(asock);
+    if (ioqueue)
+	pj_ioqueue_destroy(ioqueue);
+    if (pool)
+	pj_pool_release(pool);
+    return ret;
+}
+
+
 int activesock_test(void)
 {
     int ret;
@@ -503,6 +1005,21 @@ int activesock_test(void)
     if (ret != 0)
 	return ret;
 
+    PJ_LOG(3,("", "..udp batch receive test"));
+    ret = udp_batch_test();
+    if (ret != 0)
+	return ret;
+
+    PJ_LOG(3,("", "..udp buffer lending test"));
+    ret = udp_lend_test();
+    if (ret != 0)
+	return ret;
+
+    PJ_LOG(3,("", "..udp pause/resume read test"));
+    ret = udp_pause_test();
+    if (ret != 0)
+	return ret;
+
     PJ_LOG(3,("", "..tcp perf test"));
     ret = tcp_perf_test();
     if (ret != 0)
@@ -36,6 +36,11 @@
  *  - pj_atomic_set()
  *  - pj_atomic_destroy()
  *
+ * It also contains a contention benchmark which increments a shared
+ * atomic variable from 1 up to 16 threads, and compares the result
+ * against a counter protected by a mutex (which is what #pj_atomic_t
+ * falls back to when PJ_HAS_ATOMIC_BUILTINS is disabled).
+ *
  *
  * This file is <b>pjlib-test/atomic.c</b>
  *
@@ -45,6 +50,162 @@
 
 #if INCLUDE_ATOMIC_TEST
 
+#define THIS_FILE	    "atomic.c"
+#define PERF_MAX_THREADS    16
+#define PERF_COUNT	    200000
+
+#if PJ_HAS_THREADS
+
+typedef struct perf_param
+{
+    pj_atomic_t	*atomic_var;
+    pj_mutex_t	*mutex;
+    long	*counter;
+    unsigned	 count;
+} perf_param;
+
+static int atomic_perf_thread(void *arg)
+{
+    perf_param *prm = (perf_param*) arg;
+    unsigned i;
+
+    for (i=0; i<prm->count; ++i)
+	pj_atomic_inc(prm->atomic_var);
+
+    return 0;
+}
+
+static int mutex_perf_thread(void *arg)
+{
+    perf_param *prm = (perf_param*) arg;
+    unsigned i;
+
+    for (i=0; i<prm->count; ++i) {
+	pj_mutex_lock(prm->mutex);
+	++(*prm->counter);
+	pj_mutex_unlock(prm->mutex);
+    }
+
+    return 0;
+}
+
+/* Run thread_cnt threads, each incrementing the shared counter.
+ * Returns the elapsed time in usec, or negative on error.
+ */
+static long run_perf(pj_pool_t *pool, pj_thread_proc *proc,
+		     perf_param *prm, unsigned thread_cnt)
+{
+    pj_thread_t *threads[PERF_MAX_THREADS];
+    pj_timestamp t1, t2;
+    unsigned i;
+    pj_status_t rc;
+
+    pj_get_timestamp(&t1);
+
+    for (i=0; i<thread_cnt; ++i) {
+	rc = pj_thread_create(pool, "atmperf", proc, prm, 0, 0,
+			      &threads[i]);
+	if (rc != PJ_SUCCESS) {
+	    app_perror("...error: pj_thread_create", rc);
+	    while (i > 0) {
+		pj_thread_join(threads[--i]);
+		pj_thread_destroy(threads[i]);
+	    }
+	    return -1;
+	}
+    }
+
+    for (i=0; i<thread_cnt; ++i) {
+	pj_thread_join(threads[i]);
+	pj_thread_destroy(threads[i]);
+    }
+
+    pj_get_timestamp(&t2);
+
+    return (long)pj_elapsed_usec(&t1, &t2);
+}
+
+static int atomic_perf_test(void)
+{
+    static const unsigned thread_cnts[] = { 1, 2, 4, 8, 16 };
+    pj_pool_t *pool;
+    perf_param prm;
+    long counter;
+    unsigned i;
+    pj_status_t rc;
+
+    PJ_LOG(3,(THIS_FILE, "...atomic contention benchmark (native=%d), "
+			 "%d increments per thread:",
+			 PJ_HAS_ATOMIC_BUILTINS, PERF_COUNT));
+    PJ_LOG(3,(THIS_FILE, "    threads  atomic(usec)  mutex(usec)  speedup"));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+	return -190;
+
+    pj_bzero(&prm, sizeof(prm));
+    prm.counter = &counter;
+    prm.count = PERF_COUNT;
+
+    rc = pj_atomic_create(pool, 0, &prm.atomic_var);
+    if (rc != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return -200;
+    }
+
+    rc = pj_mutex_create_simple(pool, "atmperf", &prm.mutex);
+    if (rc != PJ_SUCCESS) {
+	pj_atomic_destroy(prm.atomic_var);
+	pj_pool_release(pool);
+	return -210;
+    }
+
+    for (i=0; i<PJ_ARRAY_SIZE(thread_cnts); ++i) {
+	unsigned cnt = thread_cnts[i];
+	long atomic_usec, mutex_usec;
+
+	pj_atomic_set(prm.atomic_var, 0);
+	atomic_usec = run_perf(pool, &atomic_perf_thread, &prm, cnt);
+	if (atomic_usec < 0) {
+	    rc = -220;
+	    break;
+	}
+	if (pj_atomic_get(prm.atomic_var) != (pj_atomic_value_t)(cnt*PERF_COUNT)) {
+	    PJ_LOG(3,(THIS_FILE, "...error: atomic counter is %ld, "
+				 "expecting %ld",
+				 (long)pj_atomic_get(prm.atomic_var),
+				 (long)(cnt*PERF_COUNT)));
+	    rc = -230;
+	    break;
+	}
+
+	counter = 0;
+	mutex_usec = run_perf(pool, &mutex_perf_thread, &prm, cnt);
+	if (mutex_usec < 0) {
+	    rc = -240;
+	    break;
+	}
+	if (counter != (long)(cnt*PERF_COUNT)) {
+	    rc = -250;
+	    break;
+	}
+
+	if (atomic_usec == 0) atomic_usec = 1;
+	PJ_LOG(3,(THIS_FILE, "    %7d  %12ld  %11ld  %5ld.%02ldx",
+		  cnt, atomic_usec, mutex_usec,
+		  mutex_usec / atomic_usec,
+		  (mutex_usec * 100 / atomic_usec) % 100));
+    }
+
+    pj_mutex_destroy(prm.mutex);
+    pj_atomic_destroy(prm.atomic_var);
+    pj_pool_release(pool);
+
+    return rc;
+}
+
+#endif	/* PJ_HAS_THREADS */
+
 int atomic_test(void)
 {
     pj_pool_t *pool;
@@ -89,6 +250,14 @@ int atomic_test(void)
     if (pj_atomic_get(atomic_var) != 221)
         return -70;
 
+    /* inc_and_get() and dec_and_get() */
+    if (pj_atomic_inc_and_get(atomic_var) != 222)
+        return -72;
+    if (pj_atomic_dec_and_get(atomic_var) != 221)
+        return -74;
+    if (pj_atomic_add_and_get(atomic_var, -21) != 200)
+        return -76;
+
     /* destroy */
     rc = pj_atomic_destroy(atomic_var);
     if (rc != 0)
@@ -96,6 +265,12 @@ int atomic_test(void)
 
     pj_pool_release(pool);
 
+#if PJ_HAS_THREADS
+    rc = atomic_perf_test();
+    if (rc != 0)
+        return rc;
+#endif
+
     return 0;
 }
 
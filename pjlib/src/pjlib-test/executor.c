@@ -0,0 +1,424 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+/**
+ * \page page_pjlib_executor_test Test: Task Executor
+ *
+ * This file provides implementation of \b executor_test(). It tests the
+ * task executor:
+ *  - tasks submitted from a non-worker thread are all run.
+ *  - tasks submitted from the worker threads, which spread to the other
+ *    workers by stealing.
+ *  - group lock reference and locking around the task.
+ *  - destroying the executor runs the pending tasks.
+ *  - throughput and latency benchmark with 1, 2 and 4 worker threads.
+ *
+ *
+ * This file is <b>pjlib-test/executor.c</b>
+ *
+ * \include pjlib-test/executor.c
+ */
+
+#if INCLUDE_EXECUTOR_TEST
+
+#include <pjlib.h>
+
+#define THIS_FILE	"executor.c"
+#define TASK_CNT	10000
+#define FANOUT_DEPTH	10
+#define LOCK_TASK_CNT	1000
+#define BENCH_CNT	200000
+#define LATENCY_CNT	2000
+
+static struct
+{
+    pj_executor_t   *exec;
+    pj_atomic_t	    *counter;
+    pj_sem_t	    *done;
+    long	     target;
+    pj_bool_t	     not_worker;
+} g;
+
+/* Count the task and signal when the target count is reached */
+static void count_task(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    if (!pj_executor_is_worker(g.exec))
+	g.not_worker = PJ_TRUE;
+
+    if (pj_atomic_inc_and_get(g.counter) == g.target)
+	pj_sem_post(g.done);
+}
+
+static int wait_done(unsigned msec)
+{
+    pj_time_val timeout, now;
+
+    pj_gettickcount(&timeout);
+    timeout.msec += msec;
+    pj_time_val_normalize(&timeout);
+
+    while (pj_sem_trywait(g.done) != PJ_SUCCESS) {
+	pj_gettickcount(&now);
+	if (PJ_TIME_VAL_GT(now, timeout))
+	    return -1;
+	pj_thread_sleep(1);
+    }
+    return 0;
+}
+
+static pj_status_t submit_retry(pj_executor_cb *cb, void *arg)
+{
+    pj_status_t status;
+
+    while ((status = pj_executor_submit(g.exec, cb, arg, NULL, 0)) ==
+	   PJ_ETOOMANY)
+    {
+	pj_thread_sleep(0);
+    }
+    return status;
+}
+
+static int submit_test(void)
+{
+    pj_executor_stat stat;
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, "  submit test.."));
+
+    pj_atomic_set(g.counter, 0);
+    g.target = TASK_CNT;
+    g.not_worker = PJ_FALSE;
+
+    if (pj_executor_is_worker(g.exec))
+	return -10;
+
+    for (i=0; i<TASK_CNT; ++i) {
+	if (submit_retry(&count_task, NULL) != PJ_SUCCESS)
+	    return -20;
+    }
+
+    if (wait_done(5000) != 0)
+	return -30;
+    if (g.not_worker)
+	return -40;
+
+    pj_executor_get_stat(g.exec, &stat);
+    if (stat.exec_cnt < TASK_CNT ||
+	stat.submit_cnt != stat.exec_cnt + stat.pending_cnt)
+    {
+	return -50;
+    }
+
+    return 0;
+}
+
+/* Each task submits two children from the worker thread, until the
+ * depth is reached.
+ */
+static void fanout_task(void *arg)
+{
+    unsigned depth = (unsigned)(pj_ssize_t)arg;
+
+    if (depth < FANOUT_DEPTH) {
+	void *child_arg = (void*)(pj_ssize_t)(depth + 1);
+
+	if (submit_retry(&fanout_task, child_arg) != PJ_SUCCESS ||
+	    submit_retry(&fanout_task, child_arg) != PJ_SUCCESS)
+	{
+	    g.not_worker = PJ_TRUE;
+	}
+    }
+
+    count_task(NULL);
+}
+
+static int fanout_test(void)
+{
+    pj_executor_stat stat;
+
+    PJ_LOG(3,(THIS_FILE, "  fan out test.."));
+
+    pj_atomic_set(g.counter, 0);
+    g.target = (1 << (FANOUT_DEPTH+1)) - 1;
+    g.not_worker = PJ_FALSE;
+
+    if (submit_retry(&fanout_task, (void*)(pj_ssize_t)0) != PJ_SUCCESS)
+	return -110;
+
+    if (wait_done(5000) != 0)
+	return -120;
+    if (g.not_worker)
+	return -130;
+
+    pj_executor_get_stat(g.exec, &stat);
+    PJ_LOG(3,(THIS_FILE, "   %ld tasks, %u stolen", g.target,
+	      stat.steal_cnt));
+
+    return 0;
+}
+
+static struct
+{
+    pj_grp_lock_t   *grp_lock;
+    unsigned	     run_cnt;
+    pj_bool_t	     held;
+    pj_bool_t	     overlap;
+    pj_bool_t	     destroyed_early;
+} lk;
+
+static void lock_task(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    /* The group lock is held, so only one task may be here */
+    if (lk.held)
+	lk.overlap = PJ_TRUE;
+    lk.held = PJ_TRUE;
+    ++lk.run_cnt;
+    pj_thread_sleep(0);
+    lk.held = PJ_FALSE;
+
+    count_task(NULL);
+}
+
+static void lock_destroy_handler(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    if (lk.run_cnt != LOCK_TASK_CNT)
+	lk.destroyed_early = PJ_TRUE;
+    pj_sem_post(g.done);
+}
+
+static int grp_lock_test(pj_pool_t *pool)
+{
+    unsigned i;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  group lock test.."));
+
+    pj_bzero(&lk, sizeof(lk));
+    pj_atomic_set(g.counter, 0);
+    g.target = -1;
+
+    status = pj_grp_lock_create(pool, NULL, &lk.grp_lock);
+    if (status != PJ_SUCCESS)
+	return -200;
+    pj_grp_lock_add_ref(lk.grp_lock);
+    pj_grp_lock_add_handler(lk.grp_lock, pool, NULL, &lock_destroy_handler);
+
+    for (i=0; i<LOCK_TASK_CNT; ++i) {
+	while ((status = pj_executor_submit(g.exec, &lock_task, NULL,
+					    lk.grp_lock,
+					    PJ_EXECUTOR_HOLD_LOCK)) ==
+	       PJ_ETOOMANY)
+	{
+	    pj_thread_sleep(0);
+	}
+	if (status != PJ_SUCCESS) {
+	    pj_grp_lock_dec_ref(lk.grp_lock);
+	    return -210;
+	}
+    }
+
+    /* The pending tasks keep the group lock alive */
+    pj_grp_lock_dec_ref(lk.grp_lock);
+
+    if (wait_done(5000) != 0)
+	return -220;
+    if (lk.destroyed_early)
+	return -230;
+    if (lk.overlap)
+	return -240;
+
+    return 0;
+}
+
+static void slow_task(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+    pj_thread_sleep(1);
+    count_task(NULL);
+}
+
+static int destroy_test(pj_pool_t *pool)
+{
+    pj_executor_param param;
+    pj_status_t status;
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, "  destroy test.."));
+
+    pj_executor_param_default(&param);
+    param.thread_cnt = 2;
+    status = pj_executor_create(pool, "exec-destroy", &param, &g.exec);
+    if (status != PJ_SUCCESS)
+	return -300;
+
+    pj_atomic_set(g.counter, 0);
+    g.target = -1;
+
+    for (i=0; i<50; ++i) {
+	if (submit_retry(&slow_task, NULL) != PJ_SUCCESS)
+	    return -310;
+    }
+
+    /* Destroy must wait for the queued tasks */
+    pj_executor_destroy(g.exec);
+    g.exec = NULL;
+
+    if (pj_atomic_get(g.counter) != 50)
+	return -320;
+
+    return 0;
+}
+
+static pj_timestamp submit_ts;
+static pj_uint32_t latency_usec;
+
+static void latency_task(void *arg)
+{
+    pj_timestamp now;
+
+    PJ_UNUSED_ARG(arg);
+
+    pj_get_timestamp(&now);
+    latency_usec = pj_elapsed_usec(&submit_ts, &now);
+    pj_sem_post(g.done);
+}
+
+static int benchmark(pj_pool_t *pool, unsigned thread_cnt)
+{
+    pj_executor_param param;
+    pj_timestamp t0, t1;
+    pj_uint32_t msec, lat_total = 0, lat_max = 0;
+    unsigned i;
+    pj_status_t status;
+    int rc = 0;
+
+    pj_executor_param_default(&param);
+    param.thread_cnt = thread_cnt;
+    status = pj_executor_create(pool, "exec-bench", &param, &g.exec);
+    if (status != PJ_SUCCESS)
+	return -400;
+
+    /* Throughput: tiny tasks submitted as fast as possible */
+    pj_atomic_set(g.counter, 0);
+    g.target = BENCH_CNT;
+
+    pj_get_timestamp(&t0);
+    for (i=0; i<BENCH_CNT; ++i) {
+	if (submit_retry(&count_task, NULL) != PJ_SUCCESS) {
+	    rc = -410;
+	    goto on_return;
+	}
+    }
+    if (wait_done(30000) != 0) {
+	rc = -420;
+	goto on_return;
+    }
+    pj_get_timestamp(&t1);
+
+    msec = pj_elapsed_msec(&t0, &t1);
+    if (msec == 0)
+	msec = 1;
+
+    /* Latency: time from submission until an idle worker starts it */
+    for (i=0; i<LATENCY_CNT; ++i) {
+	pj_get_timestamp(&submit_ts);
+	if (submit_retry(&latency_task, NULL) != PJ_SUCCESS) {
+	    rc = -430;
+	    goto on_return;
+	}
+	pj_sem_wait(g.done);
+
+	lat_total += latency_usec;
+	if (latency_usec > lat_max)
+	    lat_max = latency_usec;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "   %u thread(s): %u tasks/sec, latency avg %u "
+	      "usec, max %u usec", thread_cnt,
+	      (unsigned)(BENCH_CNT * 1000.0 / msec),
+	      lat_total / LATENCY_CNT, lat_max));
+
+on_return:
+    pj_executor_destroy(g.exec);
+    g.exec = NULL;
+    return rc;
+}
+
+int executor_test(void)
+{
+    pj_pool_t *pool;
+    pj_status_t status;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+	return -1;
+
+    status = pj_atomic_create(pool, 0, &g.counter);
+    if (status == PJ_SUCCESS)
+	status = pj_sem_create(pool, NULL, 0, 1, &g.done);
+    if (status == PJ_SUCCESS)
+	status = pj_executor_create(pool, NULL, NULL, &g.exec);
+    if (status != PJ_SUCCESS) {
+	app_perror("...error creating executor", status);
+	pj_pool_release(pool);
+	return -2;
+    }
+
+    rc = submit_test();
+    if (rc == 0)
+	rc = fanout_test();
+    if (rc == 0)
+	rc = grp_lock_test(pool);
+
+    pj_executor_destroy(g.exec);
+    g.exec = NULL;
+
+    if (rc == 0)
+	rc = destroy_test(pool);
+
+    if (rc == 0) {
+	PJ_LOG(3,(THIS_FILE, "  benchmark.."));
+	rc = benchmark(pool, 1);
+	if (rc == 0)
+	    rc = benchmark(pool, 2);
+	if (rc == 0)
+	    rc = benchmark(pool, 4);
+    }
+
+    pj_sem_destroy(g.done);
+    pj_atomic_destroy(g.counter);
+    pj_pool_release(pool);
+    return rc;
+}
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_executor_test;
+#endif	/* INCLUDE_EXECUTOR_TEST */
@@ -21,20 +21,32 @@
 #include <pj/rand.h>
 #include <pj/log.h>
 #include <pj/pool.h>
+#include <pj/os.h>
+#include <pj/string.h>
 #include "test.h"
 
 #if INCLUDE_HASH_TEST
 
 #define HASH_COUNT  31
 
-static int hash_test_with_key(pj_pool_t *pool, unsigned char key)
+static pj_hash_table_t *create_table(pj_pool_t *pool, unsigned size,
+				     pj_bool_t resizable)
+{
+    if (resizable)
+	return pj_hash_create_resizable(pool, size);
+    else
+	return pj_hash_create(pool, size);
+}
+
+static int hash_test_with_key(pj_pool_t *pool, unsigned char key,
+			      pj_bool_t resizable)
 {
     pj_hash_table_t *ht;
     unsigned value = 0x12345;
     pj_hash_iterator_t it_buf, *it;
     unsigned *entry;
 
-    ht = pj_hash_create(pool, HASH_COUNT);
+    ht = create_table(pool, HASH_COUNT, resizable);
     if (!ht)
 	return -10;
 
@@ -83,7 +95,7 @@ static int hash_test_with_key(pj_pool_t *pool, unsigned char key)
 }
 
 
-static int hash_collision_test(pj_pool_t *pool)
+static int hash_collision_test(pj_pool_t *pool, pj_bool_t resizable)
 {
     enum {
 	COUNT = HASH_COUNT * 4
@@ -93,7 +105,7 @@ static int hash_collision_test(pj_pool_t *pool)
     unsigned char *values;
     unsigned i;
 
-    ht = pj_hash_create(pool, HASH_COUNT);
+    ht = create_table(pool, HASH_COUNT, resizable);
     if (!ht)
 	return -200;
 
@@ -130,31 +142,199 @@ static int hash_collision_test(pj_pool_t *pool)
 }
 
 
+/*
+ * Grow the resizable hash table well beyond its initial size, with
+ * deletions and lowercase lookups while it is being resized.
+ */
+static int hash_resize_test(pj_pool_t *pool)
+{
+    enum { COUNT = 21000 };
+    pj_hash_table_t *ht;
+    pj_hash_iterator_t it_buf, *it;
+    char (*keys)[16];
+    unsigned i;
+
+    ht = pj_hash_create_resizable(pool, 16);
+    if (!ht)
+	return -300;
+
+    keys = (char(*)[16]) pj_pool_alloc(pool, COUNT * sizeof(keys[0]));
+    for (i=0; i<COUNT; ++i) {
+	pj_ansi_snprintf(keys[i], sizeof(keys[i]), "Key-%u", i);
+	pj_hash_set_lower(NULL, ht, keys[i], PJ_HASH_KEY_STRING, 0, &keys[i]);
+
+	/* Delete every third entry as we go */
+	if (i % 3 == 2) {
+	    pj_hash_set_lower(NULL, ht, keys[i-1], PJ_HASH_KEY_STRING, 0,
+			      NULL);
+	}
+    }
+
+    if (pj_hash_count(ht) != COUNT - COUNT / 3)
+	return -310;
+
+    for (i=0; i<COUNT; ++i) {
+	char upper[16];
+	pj_uint32_t hval = 0;
+	void *entry;
+
+	pj_ansi_strcpy(upper, keys[i]);
+	upper[0] = 'k';
+	upper[1] = 'E';
+	entry = pj_hash_get_lower(ht, upper, PJ_HASH_KEY_STRING, &hval);
+	if ((i % 3 == 1 && entry != NULL) || (i % 3 != 1 && entry != keys[i]))
+	    return -320;
+
+	/* Lookup with the returned hash value must give the same result */
+	if (pj_hash_get_lower(ht, keys[i], PJ_HASH_KEY_STRING, &hval) != entry)
+	    return -330;
+    }
+
+    /* Overwrite */
+    pj_hash_set_lower(NULL, ht, keys[0], PJ_HASH_KEY_STRING, 0, &keys[1]);
+    if (pj_hash_get_lower(ht, keys[0], PJ_HASH_KEY_STRING, NULL) != keys[1] ||
+	pj_hash_count(ht) != COUNT - COUNT / 3)
+    {
+	return -340;
+    }
+
+    /* Delete everything while iterating */
+    i = 0;
+    it = pj_hash_first(ht, &it_buf);
+    while (it) {
+	char *key = (char*) pj_hash_this(ht, it);
+
+	if (key == keys[1])
+	    key = keys[0];
+	it = pj_hash_next(ht, it);
+	pj_hash_set_lower(NULL, ht, key, PJ_HASH_KEY_STRING, 0, NULL);
+	++i;
+    }
+
+    if (i != COUNT - COUNT / 3 || pj_hash_count(ht) != 0)
+	return -350;
+
+    if (pj_hash_first(ht, &it_buf) != NULL)
+	return -360;
+
+    return 0;
+}
+
+
+/*
+ * Compare the fixed size and the resizable hash tables with many more
+ * entries than the initial size, like the transaction table under load.
+ */
+static int hash_perf_test(pj_bool_t resizable, char (*keys)[24],
+			  unsigned count)
+{
+    enum { LOOKUPS = 4 };
+    pj_pool_t *pool;
+    pj_hash_table_t *ht;
+    pj_timestamp t0, t1, t2, t3;
+    unsigned i, j;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, "hashperf", 64000, 64000, NULL);
+    ht = create_table(pool, 1023, resizable);
+    if (!ht) {
+	pj_pool_release(pool);
+	return -400;
+    }
+
+    pj_get_timestamp(&t0);
+
+    for (i=0; i<count; ++i) {
+	pj_hash_set_lower(pool, ht, keys[i], PJ_HASH_KEY_STRING, 0,
+			  keys[i]);
+    }
+
+    pj_get_timestamp(&t1);
+
+    for (j=0; j<LOOKUPS; ++j) {
+	for (i=0; i<count; ++i) {
+	    if (pj_hash_get_lower(ht, keys[i], PJ_HASH_KEY_STRING,
+				  NULL) != keys[i])
+	    {
+		rc = -410;
+		goto on_return;
+	    }
+	}
+    }
+
+    pj_get_timestamp(&t2);
+
+    for (i=0; i<count; ++i) {
+	pj_hash_set_lower(NULL, ht, keys[i], PJ_HASH_KEY_STRING, 0, NULL);
+    }
+
+    pj_get_timestamp(&t3);
+    if (pj_hash_count(ht) != 0) {
+	rc = -420;
+	goto on_return;
+    }
+
+    PJ_LOG(3,("", "   %s table, %u entries: insert %u usec, %u lookups "
+	      "%u usec, delete %u usec",
+	      (resizable ? "resizable" : "fixed size"), count,
+	      pj_elapsed_usec(&t0, &t1), count * LOOKUPS,
+	      pj_elapsed_usec(&t1, &t2), pj_elapsed_usec(&t2, &t3)));
+
+on_return:
+    pj_pool_release(pool);
+    return rc;
+}
+
+
 /*
  * Hash table test.
  */
 int hash_test(void)
 {
+    enum { PERF_COUNT = 50000 };
     pj_pool_t *pool = pj_pool_create(mem, "hash", 512, 512, NULL);
+    char (*keys)[24];
     int rc;
-    unsigned i;
+    unsigned i, resizable;
+
+    for (resizable=0; resizable<2; ++resizable) {
+	/* Test to fill in each row in the table */
+	for (i=0; i<=HASH_COUNT; ++i) {
+	    rc = hash_test_with_key(pool, (unsigned char)i, resizable);
+	    if (rc != 0) {
+		pj_pool_release(pool);
+		return rc;
+	    }
+	}
 
-    /* Test to fill in each row in the table */
-    for (i=0; i<=HASH_COUNT; ++i) {
-	rc = hash_test_with_key(pool, (unsigned char)i);
+	/* Collision test */
+	rc = hash_collision_test(pool, resizable);
 	if (rc != 0) {
 	    pj_pool_release(pool);
 	    return rc;
 	}
     }
 
-    /* Collision test */
-    rc = hash_collision_test(pool);
+    rc = hash_resize_test(pool);
     if (rc != 0) {
 	pj_pool_release(pool);
 	return rc;
     }
 
+    /* Keys that look like transaction keys */
+    keys = (char(*)[24]) pj_pool_alloc(pool, PERF_COUNT * sizeof(keys[0]));
+    for (i=0; i<PERF_COUNT; ++i) {
+	pj_ansi_snprintf(keys[i], sizeof(keys[i]), "c$INVITE$z9hG4bK%07u", i);
+    }
+
+    for (resizable=0; resizable<2; ++resizable) {
+	rc = hash_perf_test(resizable, keys, PERF_COUNT);
+	if (rc != 0) {
+	    pj_pool_release(pool);
+	    return rc;
+	}
+    }
+
     pj_pool_release(pool);
     return 0;
 }
@@ -226,6 +226,8 @@ static int perform_test(pj_bool_t allow_concur,
 			int sock_type, const char *type_name,
                         unsigned thread_cnt, unsigned sockpair_cnt,
                         pj_size_t buffer_size, 
+			unsigned max_events,
+			pj_bool_t oneshot,
                         pj_size_t *p_bandwidth)
 {
     enum { MSEC_DURATION = 5000 };
@@ -238,6 +240,7 @@ static int perform_test(pj_bool_t allow_concur,
     pj_uint32_t total_elapsed_usec, total_received;
     pj_highprec_t bandwidth;
     pj_timestamp start, stop;
+    pj_ioqueue_stat stat;
     unsigned i;
 
     TRACE_((THIS_FILE, "    starting test.."));
@@ -268,6 +271,22 @@ static int perform_test(pj_bool_t allow_concur,
         return -16;
     }
 
+    if (max_events) {
+	rc = pj_ioqueue_set_max_events(ioqueue, max_events);
+	if (rc != PJ_SUCCESS) {
+	    app_perror("...error: pj_ioqueue_set_max_events()", rc);
+	    return -17;
+	}
+    }
+
+    if (oneshot) {
+	rc = pj_ioqueue_set_oneshot(ioqueue, PJ_TRUE);
+	if (rc != PJ_SUCCESS) {
+	    app_perror("...error: pj_ioqueue_set_oneshot()", rc);
+	    return -18;
+	}
+    }
+
     /* Initialize each producer-consumer pair. */
     for (i=0; i<sockpair_cnt; ++i) {
         pj_ssize_t bytes;
@@ -414,6 +433,10 @@ static int perform_test(pj_bool_t allow_concur,
         pj_thread_destroy(thread[i]);
     }
 
+    /* Get the statistics before the ioqueue is destroyed */
+    if (pj_ioqueue_get_stat(ioqueue, &stat) != PJ_SUCCESS)
+	pj_bzero(&stat, sizeof(stat));
+
     /* Destroy ioqueue. */
     TRACE_((THIS_FILE, "     destroying ioqueue.."));
     pj_ioqueue_destroy(ioqueue);
@@ -434,9 +457,20 @@ static int perform_test(pj_bool_t allow_concur,
     
     *p_bandwidth = (pj_uint32_t)bandwidth;
 
-    PJ_LOG(3,(THIS_FILE, "   %.4s    %2d        %2d       %8d KB/s",
-              type_name, thread_cnt, sockpair_cnt,
-              *p_bandwidth));
+    if (max_events == 0) {
+	PJ_LOG(3,(THIS_FILE, "   %.4s    %2d        %2d       %8d KB/s",
+		  type_name, thread_cnt, sockpair_cnt,
+		  *p_bandwidth));
+    } else {
+	PJ_LOG(3,(THIS_FILE, "   %.4s    %2d        %2d     %2d  %-7s"
+			     "  %8d KB/s  %5u.%02u  %8u",
+		  type_name, thread_cnt, sockpair_cnt, max_events,
+		  (oneshot ? "oneshot" : "level"), *p_bandwidth,
+		  (stat.poll_cnt ? stat.event_cnt / stat.poll_cnt : 0),
+		  (stat.poll_cnt ? stat.event_cnt * 100 / stat.poll_cnt % 100
+				 : 0),
+		  stat.busy_cnt));
+    }
 
     /* Done. */
     pj_pool_release(pool);
@@ -520,6 +554,7 @@ static int ioqueue_perf_test_imp(pj_bool_t allow_concur)
                           test_param[i].thread_cnt, 
                           test_param[i].sockpair_cnt, 
                           BUF_SIZE, 
+			  0, PJ_FALSE,
                           &bandwidth);
         if (rc != 0)
             return rc;
@@ -544,6 +579,104 @@ static int ioqueue_perf_test_imp(pj_bool_t allow_concur)
     return 0;
 }
 
+/* Compare single event and batched event dispatching of the ioqueue,
+ * i.e. retrieving one event or several events per polling system call,
+ * under heavy UDP load.
+ */
+static int ioqueue_perf_batch_test(void)
+{
+    enum { BUF_SIZE = 512, SOCKPAIR_CNT = 16 };
+    const unsigned thread_cnt[] = { 1, 4 };
+    const unsigned max_events[] = { 1, PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL };
+    unsigned i, j;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "   Benchmarking %s ioqueue batched dispatch:",
+	      pj_ioqueue_name()));
+    PJ_LOG(3,(THIS_FILE, "   ==========================================="
+			 "================================"));
+    PJ_LOG(3,(THIS_FILE, "   Type  Threads  Skt.Pairs  Batch  Mode     "
+			 "    Bandwidth  Ev/poll      Busy"));
+    PJ_LOG(3,(THIS_FILE, "   ==========================================="
+			 "================================"));
+
+    for (i=0; i<PJ_ARRAY_SIZE(thread_cnt); ++i) {
+	for (j=0; j<PJ_ARRAY_SIZE(max_events); ++j) {
+	    pj_size_t bandwidth;
+
+	    rc = perform_test(PJ_FALSE, pj_SOCK_DGRAM(), "udp", 
+			      thread_cnt[i], SOCKPAIR_CNT, BUF_SIZE,
+			      max_events[j], PJ_FALSE, &bandwidth);
+	    if (rc != 0)
+		return rc;
+
+	    pj_thread_sleep(500);
+	}
+    }
+
+    return 0;
+}
+
+/* Compare the default level-triggered mode against the one-shot mode,
+ * where a ready key wakes up only one polling thread, with a few busy
+ * UDP sockets shared by an increasing number of polling threads.
+ */
+static int ioqueue_perf_oneshot_test(void)
+{
+    enum { BUF_SIZE = 512, SOCKPAIR_CNT = 4 };
+    const unsigned thread_cnt[] = { 1, 4, 8 };
+    pj_pool_t *pool;
+    pj_ioqueue_t *ioqueue;
+    pj_status_t status;
+    unsigned i, j;
+    int rc;
+
+    /* Check if the ioqueue implementation supports one-shot mode */
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+	return -200;
+    status = pj_ioqueue_create(pool, 4, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	pj_pool_release(pool);
+	return -210;
+    }
+    status = pj_ioqueue_set_oneshot(ioqueue, PJ_TRUE);
+    pj_ioqueue_destroy(ioqueue);
+    pj_pool_release(pool);
+
+    if (status == PJ_ENOTSUP) {
+	PJ_LOG(3,(THIS_FILE, "   One-shot mode is not supported by %s "
+			     "ioqueue, skipped", pj_ioqueue_name()));
+	return 0;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "   Benchmarking %s ioqueue one-shot mode:",
+	      pj_ioqueue_name()));
+    PJ_LOG(3,(THIS_FILE, "   ==========================================="
+			 "================================"));
+    PJ_LOG(3,(THIS_FILE, "   Type  Threads  Skt.Pairs  Batch  Mode     "
+			 "    Bandwidth  Ev/poll      Busy"));
+    PJ_LOG(3,(THIS_FILE, "   ==========================================="
+			 "================================"));
+
+    for (i=0; i<PJ_ARRAY_SIZE(thread_cnt); ++i) {
+	for (j=0; j<2; ++j) {
+	    pj_size_t bandwidth;
+
+	    rc = perform_test(PJ_FALSE, pj_SOCK_DGRAM(), "udp", 
+			      thread_cnt[i], SOCKPAIR_CNT, BUF_SIZE,
+			      PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL,
+			      (j == 1), &bandwidth);
+	    if (rc != 0)
+		return rc;
+
+	    pj_thread_sleep(500);
+	}
+    }
+
+    return 0;
+}
+
 /*
  * main test entry.
  */
@@ -559,6 +692,14 @@ int ioqueue_perf_test(void)
     if (rc != 0)
 	return rc;
 
+    rc = ioqueue_perf_batch_test();
+    if (rc != 0)
+	return rc;
+
+    rc = ioqueue_perf_oneshot_test();
+    if (rc != 0)
+	return rc;
+
     return 0;
 }
 
@@ -320,6 +320,35 @@ static int compliance_test(pj_bool_t allow_concur)
             send_pending = 0;
 	}
     } 
+
+    /* The pending read must have been dispatched by a poll, and the
+     * received datagram accounted in the key statistics when they are
+     * enabled.
+     */
+    {
+	pj_ioqueue_stat qstat;
+	pj_ioqueue_key_stat kstat;
+
+	if (pj_ioqueue_get_stat(ioque, &qstat) == PJ_SUCCESS &&
+	    (qstat.poll_cnt == 0 || qstat.dispatch_cnt == 0))
+	{
+	    status=-79; goto on_error;
+	}
+
+	rc = pj_ioqueue_get_key_stat(skey, &kstat);
+#if PJ_IOQUEUE_STAT
+	if (rc == PJ_SUCCESS &&
+	    (kstat.read_cnt != 1 || kstat.read_bytes != (pj_uint64_t)bufsize ||
+	     kstat.cb_cnt != 1))
+	{
+	    status=-80; goto on_error;
+	}
+#else
+	if (rc != PJ_ENOTSUP) {
+	    status=-81; goto on_error;
+	}
+#endif
+    }
     
     // Success
     status = 0;
@@ -870,6 +899,251 @@ on_error:
     return -1;
 }
 
+/*
+ * oneshot_test()
+ * Test the one-shot mode: a burst of packets must be received completely
+ * by draining the socket, and the key must be re-armed for the next burst.
+ */
+static unsigned oneshot_recv_cnt;
+static char oneshot_buf[BUF_MIN_SIZE];
+
+static void on_oneshot_read(pj_ioqueue_key_t *key, 
+                            pj_ioqueue_op_key_t *op_key,
+                            pj_ssize_t bytes_read)
+{
+    pj_status_t rc;
+
+    if (bytes_read <= 0)
+	return;
+
+    ++oneshot_recv_cnt;
+
+    /* Always queue the next read, so that the ioqueue does the draining */
+    bytes_read = sizeof(oneshot_buf);
+    rc = pj_ioqueue_recv(key, op_key, oneshot_buf, &bytes_read,
+			 PJ_IOQUEUE_ALWAYS_ASYNC);
+    pj_assert(rc == PJ_EPENDING);
+    PJ_UNUSED_ARG(rc);
+}
+
+static int oneshot_test(pj_bool_t allow_concur)
+{
+    enum { BURST = 20, ROUND = 3 };
+    pj_sock_t ssock = PJ_INVALID_SOCKET, csock = PJ_INVALID_SOCKET;
+    pj_sockaddr_in addr;
+    int addrlen;
+    pj_pool_t *pool;
+    pj_ioqueue_t *ioque = NULL;
+    pj_ioqueue_key_t *skey = NULL;
+    pj_ioqueue_op_key_t read_op;
+    pj_ioqueue_callback cb;
+    pj_str_t localhost = pj_str("127.0.0.1");
+    pj_ssize_t bytes;
+    unsigned round, i;
+    int status = 0;
+    pj_status_t rc;
+
+    pool = pj_pool_create(mem, NULL, POOL_SIZE, 4000, NULL);
+
+    rc = pj_ioqueue_create(pool, 4, &ioque);
+    if (rc != PJ_SUCCESS) {
+	status = -400; goto on_return;
+    }
+
+    rc = pj_ioqueue_set_oneshot(ioque, PJ_TRUE);
+    if (rc == PJ_ENOTSUP) {
+	PJ_LOG(3,(THIS_FILE, "....one-shot mode is not supported, skipped"));
+	goto on_return;
+    }
+    pj_ioqueue_set_default_concurrency(ioque, allow_concur);
+
+    rc = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &ssock);
+    if (rc == PJ_SUCCESS)
+	rc = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &csock);
+    if (rc != PJ_SUCCESS) {
+	status = -410; goto on_return;
+    }
+
+    pj_sockaddr_in_init(&addr, &localhost, 0);
+    if (pj_sock_bind(ssock, &addr, sizeof(addr)) != PJ_SUCCESS) {
+	status = -420; goto on_return;
+    }
+    addrlen = sizeof(addr);
+    pj_sock_getsockname(ssock, &addr, &addrlen);
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_read_complete = &on_oneshot_read;
+    rc = pj_ioqueue_register_sock(pool, ioque, ssock, NULL, &cb, &skey);
+    if (rc != PJ_SUCCESS) {
+	status = -430; goto on_return;
+    }
+    ssock = PJ_INVALID_SOCKET;
+
+    oneshot_recv_cnt = 0;
+    pj_ioqueue_op_key_init(&read_op, sizeof(read_op));
+    bytes = sizeof(oneshot_buf);
+    rc = pj_ioqueue_recv(skey, &read_op, oneshot_buf, &bytes,
+			 PJ_IOQUEUE_ALWAYS_ASYNC);
+    if (rc != PJ_EPENDING) {
+	status = -440; goto on_return;
+    }
+
+    for (round=1; round<=ROUND; ++round) {
+	pj_time_val timeout = { 0, 10 };
+	pj_timestamp t1, t2;
+
+	for (i=0; i<BURST; ++i) {
+	    bytes = sizeof(oneshot_buf);
+	    rc = pj_sock_sendto(csock, oneshot_buf, &bytes, 0, &addr,
+				sizeof(addr));
+	    if (rc != PJ_SUCCESS) {
+		status = -450; goto on_return;
+	    }
+	}
+
+	pj_get_timestamp(&t1);
+	do {
+	    pj_ioqueue_poll(ioque, &timeout);
+	    pj_get_timestamp(&t2);
+	} while (oneshot_recv_cnt < round * BURST &&
+		 pj_elapsed_msec(&t1, &t2) < 2000);
+
+	if (oneshot_recv_cnt != round * BURST) {
+	    PJ_LOG(3,(THIS_FILE, "....error: received %u of %u packets",
+		      oneshot_recv_cnt, round * BURST));
+	    status = -460; goto on_return;
+	}
+    }
+
+on_return:
+    if (skey)
+	pj_ioqueue_unregister(skey);
+    if (ssock != PJ_INVALID_SOCKET)
+	pj_sock_close(ssock);
+    if (csock != PJ_INVALID_SOCKET)
+	pj_sock_close(csock);
+    if (ioque)
+	pj_ioqueue_destroy(ioque);
+    pj_pool_release(pool);
+    return status;
+}
+
+/*
+ * large_dgram_test()
+ * A datagram must be received completely when the read is larger than
+ * the previous reads of the key (backends receiving into their own
+ * buffers size them from the reads).
+ */
+static pj_ssize_t large_read_size;
+
+static void on_large_read(pj_ioqueue_key_t *key, 
+                          pj_ioqueue_op_key_t *op_key,
+                          pj_ssize_t bytes_read)
+{
+    PJ_UNUSED_ARG(key);
+    PJ_UNUSED_ARG(op_key);
+    large_read_size = bytes_read;
+}
+
+static int large_dgram_test(pj_bool_t allow_concur)
+{
+    enum { SMALL = 512, LARGE = 8000 };
+    static char send_buf[LARGE], recv_buf[LARGE];
+    const pj_ssize_t sizes[] = { SMALL, LARGE };
+    pj_sock_t ssock = PJ_INVALID_SOCKET, csock = PJ_INVALID_SOCKET;
+    pj_sockaddr_in addr;
+    int addrlen;
+    pj_pool_t *pool;
+    pj_ioqueue_t *ioque = NULL;
+    pj_ioqueue_key_t *skey = NULL;
+    pj_ioqueue_op_key_t read_op;
+    pj_ioqueue_callback cb;
+    pj_str_t localhost = pj_str("127.0.0.1");
+    pj_ssize_t bytes;
+    unsigned i;
+    int status = 0;
+    pj_status_t rc;
+
+    pool = pj_pool_create(mem, NULL, POOL_SIZE, 4000, NULL);
+
+    rc = pj_ioqueue_create(pool, 4, &ioque);
+    if (rc != PJ_SUCCESS) {
+	status = -500; goto on_return;
+    }
+    pj_ioqueue_set_default_concurrency(ioque, allow_concur);
+
+    rc = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &ssock);
+    if (rc == PJ_SUCCESS)
+	rc = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &csock);
+    if (rc != PJ_SUCCESS) {
+	status = -510; goto on_return;
+    }
+
+    pj_sockaddr_in_init(&addr, &localhost, 0);
+    if (pj_sock_bind(ssock, &addr, sizeof(addr)) != PJ_SUCCESS) {
+	status = -520; goto on_return;
+    }
+    addrlen = sizeof(addr);
+    pj_sock_getsockname(ssock, &addr, &addrlen);
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_read_complete = &on_large_read;
+    rc = pj_ioqueue_register_sock(pool, ioque, ssock, NULL, &cb, &skey);
+    if (rc != PJ_SUCCESS) {
+	status = -530; goto on_return;
+    }
+    ssock = PJ_INVALID_SOCKET;
+
+    pj_memset(send_buf, 'A', sizeof(send_buf));
+    pj_ioqueue_op_key_init(&read_op, sizeof(read_op));
+
+    for (i=0; i<PJ_ARRAY_SIZE(sizes); ++i) {
+	pj_time_val timeout = { 0, 10 };
+	pj_timestamp t1, t2;
+
+	large_read_size = 0;
+	bytes = sizes[i];
+	rc = pj_ioqueue_recv(skey, &read_op, recv_buf, &bytes,
+			     PJ_IOQUEUE_ALWAYS_ASYNC);
+	if (rc != PJ_EPENDING) {
+	    status = -540; goto on_return;
+	}
+
+	/* Let the read be submitted before the packet arrives */
+	pj_ioqueue_poll(ioque, &timeout);
+
+	bytes = sizes[i];
+	rc = pj_sock_sendto(csock, send_buf, &bytes, 0, &addr, sizeof(addr));
+	if (rc != PJ_SUCCESS) {
+	    status = -550; goto on_return;
+	}
+
+	pj_get_timestamp(&t1);
+	do {
+	    pj_ioqueue_poll(ioque, &timeout);
+	    pj_get_timestamp(&t2);
+	} while (large_read_size == 0 && pj_elapsed_msec(&t1, &t2) < 2000);
+
+	if (large_read_size != sizes[i]) {
+	    PJ_LOG(3,(THIS_FILE, "....error: received %ld of %ld bytes",
+		      (long)large_read_size, (long)sizes[i]));
+	    status = -560; goto on_return;
+	}
+    }
+
+on_return:
+    if (skey)
+	pj_ioqueue_unregister(skey);
+    if (ssock != PJ_INVALID_SOCKET)
+	pj_sock_close(ssock);
+    if (csock != PJ_INVALID_SOCKET)
+	pj_sock_close(csock);
+    if (ioque)
+	pj_ioqueue_destroy(ioque);
+    pj_pool_release(pool);
+    return status;
+}
+
 static int udp_ioqueue_test_imp(pj_bool_t allow_concur)
 {
     int status;
@@ -892,6 +1166,18 @@ static int udp_ioqueue_test_imp(pj_bool_t allow_concur)
     }
     PJ_LOG(3, (THIS_FILE, "....unregister test ok"));
 
+    PJ_LOG(3, (THIS_FILE, "...one-shot test (%s)", pj_ioqueue_name()));
+    if ((status=oneshot_test(allow_concur)) != 0) {
+	return status;
+    }
+    PJ_LOG(3, (THIS_FILE, "....one-shot test ok"));
+
+    PJ_LOG(3, (THIS_FILE, "...large datagram test (%s)", pj_ioqueue_name()));
+    if ((status=large_dgram_test(allow_concur)) != 0) {
+	return status;
+    }
+    PJ_LOG(3, (THIS_FILE, "....large datagram test ok"));
+
     if ((status=many_handles_test(allow_concur)) != 0) {
 	return status;
     }
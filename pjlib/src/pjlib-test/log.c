@@ -0,0 +1,546 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+/**
+ * \page page_pjlib_log_test Test: Logging
+ *
+ * This file provides implementation of \b log_test(). It tests the
+ * asynchronous logging mode:
+ *  - messages from several threads are all written, in order.
+ *  - messages are dropped and reported when the ring buffer is full.
+ *  - fatal messages flush the pending messages.
+ *  - time spent in the logging thread with a slow log writer, compared
+ *    to the synchronous mode.
+ *  - per-sender log levels, and that the arguments of filtered messages
+ *    are not evaluated.
+ *  - messages formatted by the log thread from binary records are the
+ *    same as the messages formatted synchronously.
+ *
+ *
+ * This file is <b>pjlib-test/log.c</b>
+ *
+ * \include pjlib-test/log.c
+ */
+
+#if INCLUDE_LOG_TEST
+
+#include <pjlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define THIS_FILE	"log_test"
+#define MAX_THREADS	4
+#define MSG_CNT		2000
+
+/* What the test log writer has seen */
+static struct
+{
+    unsigned	    msg_cnt;
+    unsigned	    dropped_report_cnt;
+    unsigned	    fatal_cnt;
+    unsigned	    fatal_pending;	/* Messages seen before fatal */
+    int		    last_msg[MAX_THREADS];
+    pj_bool_t	    out_of_order;
+    unsigned	    delay_loop;
+} wr;
+
+static pj_log_func *saved_writer;
+static int saved_level;
+static unsigned saved_decor;
+
+static void test_writer(int level, const char *data, int len)
+{
+    int thread, msg;
+    volatile unsigned i;
+
+    PJ_UNUSED_ARG(len);
+
+    /* Simulate slow log device */
+    for (i=0; i<wr.delay_loop; ++i)
+	;
+
+    if (level == 0) {
+	++wr.fatal_cnt;
+	wr.fatal_pending = wr.msg_cnt;
+	return;
+    }
+
+    if (strstr(data, "dropped")) {
+	++wr.dropped_report_cnt;
+	return;
+    }
+
+    if (sscanf(data, "T%d M%d", &thread, &msg) != 2 ||
+	thread < 0 || thread >= MAX_THREADS)
+    {
+	wr.out_of_order = PJ_TRUE;
+	return;
+    }
+
+    if (msg <= wr.last_msg[thread])
+	wr.out_of_order = PJ_TRUE;
+    wr.last_msg[thread] = msg;
+    ++wr.msg_cnt;
+}
+
+static void reset_writer(unsigned delay_loop)
+{
+    unsigned i;
+
+    pj_bzero(&wr, sizeof(wr));
+    for (i=0; i<MAX_THREADS; ++i)
+	wr.last_msg[i] = -1;
+    wr.delay_loop = delay_loop;
+}
+
+static void log_fatal(const char *format, ...)
+{
+    va_list arg;
+    va_start(arg, format);
+    pj_log(THIS_FILE, 0, format, arg);
+    va_end(arg);
+}
+
+static int log_thread(void *arg)
+{
+    int id = (int)(pj_ssize_t)arg;
+    int i;
+
+    for (i=0; i<MSG_CNT; ++i) {
+	PJ_LOG(3,(THIS_FILE, "T%d M%d", id, i));
+    }
+    return 0;
+}
+
+/* Log from several threads and check that all messages are written in
+ * the order of each thread.
+ */
+static int order_test(pj_pool_t *pool)
+{
+    pj_thread_t *thread[MAX_THREADS];
+    pj_log_async_stat stat;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  ordering test.."));
+
+    reset_writer(0);
+    pj_log_set_log_func(&test_writer);
+
+    status = pj_log_start_async(0);
+    if (status != PJ_SUCCESS) {
+	pj_log_set_log_func(saved_writer);
+	app_perror("...error: pj_log_start_async()", status);
+	return -10;
+    }
+
+    for (i=0; i<MAX_THREADS; ++i) {
+	status = pj_thread_create(pool, "logtest", &log_thread,
+				  (void*)(pj_ssize_t)i, 0, 0, &thread[i]);
+	if (status != PJ_SUCCESS)
+	    break;
+    }
+    while (i > 0) {
+	pj_thread_join(thread[--i]);
+	pj_thread_destroy(thread[i]);
+    }
+
+    pj_log_flush();
+    pj_log_get_async_stat(&stat);
+    pj_log_stop_async();
+    pj_log_set_log_func(saved_writer);
+
+    if (status != PJ_SUCCESS) {
+	app_perror("...error: pj_thread_create()", status);
+	return -20;
+    }
+
+    PJ_LOG(3,(THIS_FILE, "   %u rings, %u written, %u dropped",
+	      stat.ring_cnt, stat.written_cnt, stat.dropped_cnt));
+
+    if (wr.out_of_order) {
+	PJ_LOG(3,(THIS_FILE, "...error: messages out of order"));
+	return -30;
+    }
+    if (wr.msg_cnt + stat.dropped_cnt != MAX_THREADS * MSG_CNT) {
+	PJ_LOG(3,(THIS_FILE, "...error: %u messages written, expecting %u",
+		  wr.msg_cnt + stat.dropped_cnt, MAX_THREADS * MSG_CNT));
+	return -40;
+    }
+    if (stat.dropped_cnt && wr.dropped_report_cnt == 0) {
+	PJ_LOG(3,(THIS_FILE, "...error: dropped messages not reported"));
+	return -50;
+    }
+
+    return 0;
+}
+
+/* Overflow a small ring buffer with a slow writer, then check the drop
+ * accounting and that a fatal message flushes everything before it.
+ */
+static int overflow_test(void)
+{
+    pj_log_async_stat stat;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  overflow and fatal flush test.."));
+
+    reset_writer(200000);
+    pj_log_set_log_func(&test_writer);
+
+    /* Smallest ring buffer */
+    status = pj_log_start_async(1);
+    if (status != PJ_SUCCESS) {
+	pj_log_set_log_func(saved_writer);
+	app_perror("...error: pj_log_start_async()", status);
+	return -110;
+    }
+
+    for (i=0; i<MSG_CNT; ++i) {
+	PJ_LOG(3,(THIS_FILE, "T0 M%d %0*d", i, PJ_LOG_MAX_SIZE/4, 0));
+    }
+
+    pj_log_get_async_stat(&stat);
+
+    /* Level 0 must write everything synchronously */
+    log_fatal("fatal");
+
+    pj_log_stop_async();
+    pj_log_set_log_func(saved_writer);
+
+    PJ_LOG(3,(THIS_FILE, "   %u written, %u dropped, fatal after %u",
+	      wr.msg_cnt, stat.dropped_cnt, wr.fatal_pending));
+
+    if (stat.dropped_cnt == 0) {
+	PJ_LOG(3,(THIS_FILE, "...error: expecting dropped messages"));
+	return -120;
+    }
+    if (wr.dropped_report_cnt == 0) {
+	PJ_LOG(3,(THIS_FILE, "...error: dropped messages not reported"));
+	return -130;
+    }
+    if (wr.fatal_cnt != 1 ||
+	wr.fatal_pending + stat.dropped_cnt != MSG_CNT)
+    {
+	PJ_LOG(3,(THIS_FILE, "...error: fatal message didn't flush"));
+	return -140;
+    }
+    if (wr.out_of_order) {
+	PJ_LOG(3,(THIS_FILE, "...error: messages out of order"));
+	return -150;
+    }
+
+    return 0;
+}
+
+/* Measure the time spent by the logging thread with a slow writer */
+static int latency_test(void)
+{
+    enum { COUNT = 200, DELAY = 20000 };
+    pj_timestamp t0, t1;
+    pj_uint32_t sync_usec, async_usec;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  latency test.."));
+
+    reset_writer(DELAY);
+    pj_log_set_log_func(&test_writer);
+
+    pj_get_timestamp(&t0);
+    for (i=0; i<COUNT; ++i) {
+	PJ_LOG(3,(THIS_FILE, "T0 M%d", i));
+    }
+    pj_get_timestamp(&t1);
+    sync_usec = pj_elapsed_usec(&t0, &t1);
+
+    reset_writer(DELAY);
+    status = pj_log_start_async(0);
+    if (status != PJ_SUCCESS) {
+	pj_log_set_log_func(saved_writer);
+	app_perror("...error: pj_log_start_async()", status);
+	return -210;
+    }
+
+    pj_get_timestamp(&t0);
+    for (i=0; i<COUNT; ++i) {
+	PJ_LOG(3,(THIS_FILE, "T0 M%d", i));
+    }
+    pj_get_timestamp(&t1);
+    async_usec = pj_elapsed_usec(&t0, &t1);
+
+    pj_log_stop_async();
+    pj_log_set_log_func(saved_writer);
+
+    PJ_LOG(3,(THIS_FILE, "   %d messages with slow writer: sync %u usec, "
+	      "async %u usec", COUNT, sync_usec, async_usec));
+
+    if (wr.msg_cnt != COUNT) {
+	PJ_LOG(3,(THIS_FILE, "...error: %u messages written, expecting %u",
+		  wr.msg_cnt, COUNT));
+	return -220;
+    }
+
+    return 0;
+}
+
+/* Messages captured by capture_writer() */
+#define CAPTURE_CNT	8
+#define CAPTURE_LEN	200
+
+static struct
+{
+    unsigned	    cnt;
+    char	    msg[CAPTURE_CNT][CAPTURE_LEN];
+} cap;
+
+static void capture_writer(int level, const char *data, int len)
+{
+    PJ_UNUSED_ARG(level);
+
+    if (cap.cnt < CAPTURE_CNT) {
+	if (len >= CAPTURE_LEN)
+	    len = CAPTURE_LEN - 1;
+	pj_memcpy(cap.msg[cap.cnt], data, len);
+	cap.msg[cap.cnt][len] = '\0';
+    }
+    ++cap.cnt;
+}
+
+static unsigned eval_cnt;
+static unsigned sender_eval_cnt;
+
+static int eval_arg(void)
+{
+    return ++eval_cnt;
+}
+
+static const char *eval_sender(const char *sender)
+{
+    ++sender_eval_cnt;
+    return sender;
+}
+
+/* Per-sender log levels */
+static int sender_level_test(void)
+{
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  per-sender log level test.."));
+
+    pj_log_set_level(3);
+
+    if (pj_log_set_sender_level("logtest.x", 5) != PJ_SUCCESS ||
+	pj_log_set_sender_level("logtest.xy", 2) != PJ_SUCCESS ||
+	pj_log_set_sender_level("logtest.q", 1) != PJ_SUCCESS)
+    {
+	PJ_LOG(3,(THIS_FILE, "...error: pj_log_set_sender_level()"));
+	rc = -310;
+	goto on_return;
+    }
+
+    if (pj_log_get_sender_level("logtest.x1") != 5 ||
+	pj_log_get_sender_level("logtest.xyz") != 2 ||
+	pj_log_get_sender_level("logtest.quiet") != 1 ||
+	pj_log_get_sender_level("other") != 3)
+    {
+	PJ_LOG(3,(THIS_FILE, "...error: wrong sender level"));
+	rc = -320;
+	goto on_return;
+    }
+
+    cap.cnt = 0;
+    eval_cnt = 0;
+    pj_log_set_log_func(&capture_writer);
+
+    /* Written: above the global level, but within the sender level */
+    PJ_LOG(5,("logtest.x1", "%d", eval_arg()));
+    /* Filtered by the longest prefix */
+    PJ_LOG(3,("logtest.xyz", "%d", eval_arg()));
+    /* Filtered by the sender level, below the global level */
+    PJ_LOG(2,("logtest.quiet", "%d", eval_arg()));
+    /* Filtered by the global level */
+    PJ_LOG(4,("other", "%d", eval_arg()));
+    /* Written */
+    PJ_LOG(1,("logtest.quiet", "%d", eval_arg()));
+    /* Written, and filtered by the sender level */
+    sender_eval_cnt = 0;
+    PJ_LOG(5,(eval_sender("logtest.x1"), "%d", eval_arg()));
+    PJ_LOG(2,(eval_sender("logtest.quiet"), "%d", eval_arg()));
+
+    pj_log_set_log_func(saved_writer);
+
+    if (cap.cnt != 3) {
+	PJ_LOG(3,(THIS_FILE, "...error: %u messages written, expecting 3",
+		  cap.cnt));
+	rc = -330;
+	goto on_return;
+    }
+    if (sender_eval_cnt != 2) {
+	PJ_LOG(3,(THIS_FILE, "...error: sender evaluated %u times, "
+		  "expecting 2", sender_eval_cnt));
+	rc = -335;
+	goto on_return;
+    }
+#if PJ_LOG_SENDER_CHECK_INLINE
+    if (eval_cnt != 3) {
+	PJ_LOG(3,(THIS_FILE, "...error: arguments of %u filtered message(s) "
+		  "were evaluated", eval_cnt - 3));
+	rc = -340;
+	goto on_return;
+    }
+#endif
+
+on_return:
+    pj_log_set_sender_level("logtest.x", -1);
+    pj_log_set_sender_level("logtest.xy", -1);
+    pj_log_set_sender_level("logtest.q", -1);
+
+    if (rc == 0 && pj_log_get_sender_level("logtest.x1") != 3) {
+	PJ_LOG(3,(THIS_FILE, "...error: sender level not removed"));
+	rc = -350;
+    }
+
+    return rc;
+}
+
+/* Messages for the binary record test. The last one can't be recorded. */
+static void log_bin_cases(void)
+{
+    static const char *str = "string";
+    char stack_str[16];
+
+    pj_ansi_strcpy(stack_str, "on stack");
+
+    PJ_LOG(3,(THIS_FILE, "T%d %s %5.2f %-6x|%%", 1, str, 3.14159, 255));
+    PJ_LOG(3,(THIS_FILE, "%.*s|%*d|%p|%s", 3, str, 6, -42, (void*)str,
+	      stack_str));
+    PJ_LOG(3,(THIS_FILE, "%lu %ld %hhd %c %08.3e %s", 123456789UL, -9876L,
+	      300, 'z', 1.5e-7, (char*)NULL));
+    PJ_LOG(3,("logtest.longer.sender", "%.10s|%-*.*s|", "short",
+	      -8, 2, str));
+    PJ_LOG(3,(THIS_FILE, "%Lf", (long double)1.5));
+}
+
+/* Compare the messages formatted by the log thread from the binary records
+ * with the messages formatted synchronously.
+ */
+static int binary_test(void)
+{
+    enum { CASE_CNT = 5 };
+    char sync_msg[CASE_CNT][CAPTURE_LEN];
+    pj_log_async_stat stat;
+    unsigned i;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  binary record test.."));
+
+    pj_log_set_decor(PJ_LOG_HAS_LEVEL_TEXT | PJ_LOG_HAS_SENDER |
+		     PJ_LOG_HAS_THREAD_ID | PJ_LOG_HAS_NEWLINE);
+    pj_log_set_log_func(&capture_writer);
+
+    cap.cnt = 0;
+    log_bin_cases();
+    pj_memcpy(sync_msg, cap.msg, sizeof(sync_msg));
+
+    status = pj_log_start_async(0);
+    if (status != PJ_SUCCESS) {
+	pj_log_set_log_func(saved_writer);
+	pj_log_set_decor(PJ_LOG_HAS_NEWLINE);
+	app_perror("...error: pj_log_start_async()", status);
+	return -410;
+    }
+    pj_log_set_async_binary(PJ_TRUE);
+
+    cap.cnt = 0;
+    log_bin_cases();
+
+    pj_log_flush();
+    pj_log_get_async_stat(&stat);
+    pj_log_set_async_binary(PJ_FALSE);
+    pj_log_stop_async();
+    pj_log_set_log_func(saved_writer);
+    pj_log_set_decor(PJ_LOG_HAS_NEWLINE);
+
+    if (cap.cnt != CASE_CNT) {
+	PJ_LOG(3,(THIS_FILE, "...error: %u messages written, expecting %u",
+		  cap.cnt, CASE_CNT));
+	return -420;
+    }
+
+    for (i=0; i<CASE_CNT; ++i) {
+	if (pj_ansi_strcmp(sync_msg[i], cap.msg[i]) != 0) {
+	    PJ_LOG(3,(THIS_FILE, "...error: message %u mismatch, "
+		      "expecting \"%s\", got \"%s\"", i, sync_msg[i],
+		      cap.msg[i]));
+	    return -430;
+	}
+    }
+
+    if (stat.binary_cnt != CASE_CNT - 1) {
+	PJ_LOG(3,(THIS_FILE, "...error: %u binary records, expecting %u",
+		  stat.binary_cnt, CASE_CNT - 1));
+	return -440;
+    }
+
+    return 0;
+}
+
+int log_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    saved_writer = pj_log_get_log_func();
+    saved_level = pj_log_get_level();
+    saved_decor = pj_log_get_decor();
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+
+    /* Only the message goes to the test writer */
+    pj_log_set_decor(PJ_LOG_HAS_NEWLINE);
+    if (saved_level < 3)
+	pj_log_set_level(3);
+
+    rc = order_test(pool);
+    if (rc == 0)
+	rc = overflow_test();
+    if (rc == 0)
+	rc = latency_test();
+    if (rc == 0)
+	rc = sender_level_test();
+    if (rc == 0)
+	rc = binary_test();
+
+    pj_log_set_decor(saved_decor);
+    pj_log_set_level(saved_level);
+    pj_pool_release(pool);
+
+    return rc;
+}
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_log_test;
+#endif	/* INCLUDE_LOG_TEST */
@@ -202,6 +202,159 @@ static int semaphore_test(pj_pool_t *pool)
 #endif	/* PJ_HAS_SEMAPHORE */
 
 
+/* Test with group lock. */
+static struct
+{
+    pj_grp_lock_t   *grp_lock;
+    pj_lock_t	    *ext_lock;
+    pj_status_t	     try_status;
+    pj_bool_t	     destroyed;
+} gl;
+
+static void grp_lock_destroy_handler(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+    gl.destroyed = PJ_TRUE;
+}
+
+static int ext_lock_try_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    gl.try_status = pj_lock_tryacquire(gl.ext_lock);
+    if (gl.try_status == PJ_SUCCESS)
+	pj_lock_release(gl.ext_lock);
+    return 0;
+}
+
+static int grp_lock_holder_thread(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    pj_grp_lock_acquire(gl.grp_lock);
+    pj_thread_sleep(50);
+    pj_grp_lock_release(gl.grp_lock);
+    return 0;
+}
+
+/* Check whether the external lock can be taken by another thread */
+static pj_bool_t ext_lock_is_free(pj_pool_t *pool)
+{
+    pj_thread_t *thread;
+
+    if (pj_thread_create(pool, "gltry", &ext_lock_try_thread, NULL, 0, 0,
+			 &thread) != PJ_SUCCESS)
+    {
+	return PJ_FALSE;
+    }
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+
+    return gl.try_status == PJ_SUCCESS;
+}
+
+static int grp_lock_test(pj_pool_t *pool)
+{
+    pj_thread_t *thread;
+    pj_timestamp t0, t1;
+    pj_grp_lock_stat stat;
+    pj_status_t rc;
+    unsigned i;
+
+    PJ_LOG(3,("", "...testing group lock"));
+
+    pj_bzero(&gl, sizeof(gl));
+
+    rc = pj_grp_lock_create(pool, NULL, &gl.grp_lock);
+    if (rc != PJ_SUCCESS) {
+	app_perror("...error: pj_grp_lock_create", rc);
+	return -200;
+    }
+    pj_grp_lock_add_ref(gl.grp_lock);
+    pj_grp_lock_add_handler(gl.grp_lock, pool, NULL,
+			    &grp_lock_destroy_handler);
+
+    rc = pj_lock_create_recursive_mutex(pool, NULL, &gl.ext_lock);
+    if (rc != PJ_SUCCESS)
+	return -205;
+
+    /* Recursive acquire, and the reference held by each acquisition */
+    pj_grp_lock_acquire(gl.grp_lock);
+    if (pj_grp_lock_tryacquire(gl.grp_lock) != PJ_SUCCESS)
+	return -210;
+    if (pj_grp_lock_get_ref(gl.grp_lock) != 3)
+	return -215;
+    pj_grp_lock_release(gl.grp_lock);
+    pj_grp_lock_release(gl.grp_lock);
+    if (pj_grp_lock_get_ref(gl.grp_lock) != 1)
+	return -220;
+
+    /* Chained lock is held with the group lock, while the group lock is
+     * already held.
+     */
+    pj_grp_lock_acquire(gl.grp_lock);
+    pj_grp_lock_chain_lock(gl.grp_lock, gl.ext_lock, -1);
+    if (ext_lock_is_free(pool))
+	return -225;
+    pj_grp_lock_release(gl.grp_lock);
+    if (!ext_lock_is_free(pool))
+	return -230;
+
+    pj_grp_lock_acquire(gl.grp_lock);
+    if (ext_lock_is_free(pool))
+	return -235;
+    pj_grp_lock_unchain_lock(gl.grp_lock, gl.ext_lock);
+    if (!ext_lock_is_free(pool))
+	return -240;
+    pj_grp_lock_release(gl.grp_lock);
+    if (!ext_lock_is_free(pool))
+	return -245;
+
+    /* Uncontended acquire and release */
+    pj_get_timestamp(&t0);
+    for (i=0; i<1000000; ++i) {
+	pj_grp_lock_acquire(gl.grp_lock);
+	pj_grp_lock_release(gl.grp_lock);
+    }
+    pj_get_timestamp(&t1);
+    PJ_LOG(3,("", "....1000000 acquire/release in %u msec",
+	      pj_elapsed_msec(&t0, &t1)));
+
+    /* Contention statistics */
+    rc = pj_thread_create(pool, "glhold", &grp_lock_holder_thread, NULL,
+			  0, 0, &thread);
+    if (rc != PJ_SUCCESS)
+	return -250;
+    pj_thread_sleep(10);
+    pj_grp_lock_acquire(gl.grp_lock);
+    pj_grp_lock_release(gl.grp_lock);
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+
+    rc = pj_grp_lock_get_stat(gl.grp_lock, &stat);
+#if PJ_GRP_LOCK_STAT
+    if (rc != PJ_SUCCESS || stat.acquire_cnt < 1000000 ||
+	stat.contended_cnt < 1 || stat.max_wait_usec < 10000)
+    {
+	return -255;
+    }
+    pj_grp_lock_dump_stat(0);
+#else
+    if (rc != PJ_ENOTSUP)
+	return -255;
+#endif
+
+    /* The last reference destroys the group lock */
+    if (gl.destroyed)
+	return -260;
+    pj_grp_lock_dec_ref(gl.grp_lock);
+    if (!gl.destroyed)
+	return -265;
+
+    pj_lock_destroy(gl.ext_lock);
+    return 0;
+}
+
 int mutex_test(void)
 {
     pj_pool_t *pool;
@@ -217,6 +370,10 @@ int mutex_test(void)
     if (rc != 0)
 	return rc;
 
+    rc = grp_lock_test(pool);
+    if (rc != 0)
+	return rc;
+
 #if PJ_HAS_SEMAPHORE
     rc = semaphore_test(pool);
     if (rc != 0)
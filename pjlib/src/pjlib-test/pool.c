@@ -19,6 +19,9 @@
  */
 #include <pj/pool.h>
 #include <pj/pool_buf.h>
+#include <pj/objpool.h>
+#include <pj/os.h>
+#include <pj/string.h>
 #include <pj/rand.h>
 #include <pj/log.h>
 #include <pj/except.h>
@@ -278,6 +281,557 @@ static int pool_buf_test(void)
 }
 
 
+/* The pool released by magazine_worker() */
+static pj_pool_t *mag_thread_pool;
+
+/* Release a pool into the magazine of a thread which then exits */
+static int magazine_worker(void *arg)
+{
+    pj_caching_pool *cp = (pj_caching_pool*)arg;
+
+    mag_thread_pool = pj_pool_create(&cp->factory, "magthread", 3000, 1000,
+				     NULL);
+    if (mag_thread_pool)
+	pj_pool_release(mag_thread_pool);
+    return 0;
+}
+
+/* Test the per-thread magazine of the caching pool */
+static int magazine_test(void)
+{
+    enum { CNT = 6, MAG = 4 };
+    pj_caching_pool cp;
+    pj_pool_t *pool[CNT], *reused, *thread_pool;
+    pj_thread_t *thread;
+    pj_size_t capacity;
+    unsigned i;
+    int rc = 0;
+
+    pj_caching_pool_init(&cp, NULL, 1024*1024);
+    if (pj_caching_pool_set_magazine(&cp, MAG) != PJ_SUCCESS) {
+	pj_caching_pool_destroy(&cp);
+	return -300;
+    }
+
+    for (i=0; i<CNT; ++i) {
+	pool[i] = pj_pool_create(&cp.factory, "mag", 1000, 1000, NULL);
+	if (!pool[i]) {
+	    rc = -310;
+	    goto on_return;
+	}
+    }
+
+    /* The magazine holds MAG pools, the rest are released to the global
+     * free list, and all of them count in the capacity.
+     */
+    for (i=0; i<CNT; ++i)
+	pj_pool_release(pool[i]);
+
+    if (cp.used_count != 0 || cp.capacity < CNT * 1000) {
+	rc = -320;
+	goto on_return;
+    }
+
+    /* The last pool released to the magazine is reused first */
+    capacity = cp.capacity;
+    reused = pj_pool_create(&cp.factory, "mag", 1000, 1000, NULL);
+    if (reused != pool[MAG-1] || cp.used_count != 1 ||
+	cp.capacity != capacity - pj_pool_get_capacity(reused))
+    {
+	rc = -330;
+	goto on_return;
+    }
+    if (pj_pool_get_used_size(reused) != pj_pool_get_used_size(pool[0]) &&
+	pj_pool_alloc(reused, 1) == NULL)
+    {
+	rc = -340;
+	goto on_return;
+    }
+
+    /* Different size class must not come from the same magazine slot */
+    pool[0] = pj_pool_create(&cp.factory, "mag", 16000, 1000, NULL);
+    if (!pool[0] || pool[0] == pool[MAG-2] || cp.used_count != 2) {
+	rc = -350;
+	goto on_return;
+    }
+    pj_pool_release(pool[0]);
+
+    /* The magazine must not exceed the maximum capacity */
+    cp.max_capacity = capacity = cp.capacity;
+    pj_pool_release(reused);
+    if (cp.used_count != 0 || cp.capacity != capacity) {
+	rc = -360;
+	goto on_return;
+    }
+    cp.max_capacity = 1024*1024;
+
+    /* The pool kept in the magazine of a thread which has exited is
+     * reused after the magazine has been idle for two sweeps.
+     */
+    thread_pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    mag_thread_pool = pool[0] = pool[1] = NULL;
+    if (pj_thread_create(thread_pool, "magthread", &magazine_worker, &cp,
+			 0, 0, &thread) != PJ_SUCCESS)
+    {
+	pj_pool_release(thread_pool);
+	rc = -370;
+	goto on_return;
+    }
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+    pj_pool_release(thread_pool);
+    thread_pool = mag_thread_pool;
+
+    for (i=0; i<2; ++i) {
+	pj_thread_sleep(PJ_CACHING_POOL_MAGAZINE_IDLE + 100);
+	pool[i] = pj_pool_create(&cp.factory, "mag", 3000, 1000, NULL);
+    }
+    if (!thread_pool || pool[0] == thread_pool || pool[1] != thread_pool) {
+	rc = -380;
+    }
+    for (i=0; i<2; ++i) {
+	if (pool[i])
+	    pj_pool_release(pool[i]);
+    }
+
+on_return:
+    /* Destroy must release the pools in the magazines too, along with
+     * the pool that is still held.
+     */
+    pj_caching_pool_destroy(&cp);
+    return rc;
+}
+
+
+/* Find the category accounting by name */
+static pj_pool_category_stat *find_category(pj_pool_category_stat stat[],
+					    unsigned cnt, const char *name)
+{
+    unsigned i;
+
+    for (i=0; i<cnt; ++i) {
+	if (pj_ansi_strcmp(stat[i].name, name) == 0)
+	    return &stat[i];
+    }
+    return NULL;
+}
+
+/* Test the per-category accounting of the caching pool */
+static int category_test(void)
+{
+    pj_caching_pool cp;
+    pj_pool_category_stat stat[PJ_CACHING_POOL_MAX_CATEGORY], *st;
+    pj_pool_t *pool[3], *anon;
+    char buf[1024];
+    pj_str_t json, pattern;
+    unsigned cnt;
+    int len, rc = 0;
+
+    PJ_LOG(3,("test", "...category test"));
+
+    pj_caching_pool_init(&cp, NULL, 0);
+
+    pool[0] = pj_pool_create(&cp.factory, "cat%p", 1000, 1000, NULL);
+    pool[1] = pj_pool_create(&cp.factory, "cat%p", 1000, 1000, NULL);
+    pool[2] = pj_pool_create(&cp.factory, "tsx", 2000, 1000, NULL);
+    anon = pj_pool_create(&cp.factory, NULL, 1000, 1000, NULL);
+    if (!pool[0] || !pool[1] || !pool[2] || !anon) {
+	rc = -400;
+	goto on_return;
+    }
+
+    /* Grow the first pool */
+    if (pj_pool_alloc(pool[0], 3000) == NULL) {
+	rc = -405;
+	goto on_return;
+    }
+
+    cnt = PJ_ARRAY_SIZE(stat);
+    if (pj_caching_pool_get_category_stat(&cp, stat, &cnt) != PJ_SUCCESS) {
+	rc = -410;
+	goto on_return;
+    }
+
+    st = find_category(stat, cnt, "cat");
+    if (!st || st->pool_cnt != 2 || st->create_cnt != 2 ||
+	st->grow_cnt < 1 || st->used_size < 3000 ||
+	st->capacity != pj_pool_get_capacity(pool[0]) +
+			pj_pool_get_capacity(pool[1]) ||
+	st->peak_capacity != st->capacity)
+    {
+	rc = -420;
+	goto on_return;
+    }
+
+    st = find_category(stat, cnt, "tsx");
+    if (!st || st->pool_cnt != 1 ||
+	st->capacity != pj_pool_get_capacity(pool[2]))
+    {
+	rc = -430;
+	goto on_return;
+    }
+
+    /* Unnamed pools have their own category */
+    st = find_category(stat, cnt, "pool");
+    if (!st || st->pool_cnt != 1) {
+	rc = -440;
+	goto on_return;
+    }
+
+    /* A name buffer that is reused for another name doesn't keep the
+     * category that was cached for its address.
+     */
+    {
+	char name[8];
+	pj_pool_t *p1, *p2;
+
+	pj_ansi_strcpy(name, "tsx");
+	p1 = pj_pool_create(&cp.factory, name, 1000, 1000, NULL);
+	pj_ansi_strcpy(name, "buf");
+	p2 = pj_pool_create(&cp.factory, name, 1000, 1000, NULL);
+	if (p1) pj_pool_release(p1);
+	if (p2) pj_pool_release(p2);
+
+	cnt = PJ_ARRAY_SIZE(stat);
+	pj_caching_pool_get_category_stat(&cp, stat, &cnt);
+	st = find_category(stat, cnt, "tsx");
+	if (!p1 || !p2 || !st || st->create_cnt != 2) {
+	    rc = -445;
+	    goto on_return;
+	}
+	st = find_category(stat, cnt, "buf");
+	if (!st || st->create_cnt != 1) {
+	    rc = -446;
+	    goto on_return;
+	}
+    }
+
+    /* Released pools are no longer counted, but the peaks stay */
+    pj_pool_release(pool[0]);
+    pool[0] = NULL;
+
+    cnt = PJ_ARRAY_SIZE(stat);
+    pj_caching_pool_get_category_stat(&cp, stat, &cnt);
+    st = find_category(stat, cnt, "cat");
+    if (!st || st->pool_cnt != 1 || st->peak_pool_cnt != 2 ||
+	st->capacity != pj_pool_get_capacity(pool[1]) ||
+	st->peak_capacity <= st->capacity)
+    {
+	rc = -450;
+	goto on_return;
+    }
+
+    /* Machine readable dump */
+    len = pj_caching_pool_print_category_stat(&cp, buf, sizeof(buf));
+    if (len <= 0 || len != (int)pj_ansi_strlen(buf)) {
+	rc = -460;
+	goto on_return;
+    }
+    json = pj_str(buf);
+    pattern = pj_str("\"name\":\"cat\",\"pool_cnt\":1,\"peak_pool_cnt\":2");
+    if (pj_strstr(&json, &pattern) == NULL) {
+	rc = -465;
+	goto on_return;
+    }
+    if (pj_caching_pool_print_category_stat(&cp, buf, 16) != -1) {
+	rc = -470;
+	goto on_return;
+    }
+
+on_return:
+    if (pool[0]) pj_pool_release(pool[0]);
+    if (pool[1]) pj_pool_release(pool[1]);
+    if (pool[2]) pj_pool_release(pool[2]);
+    if (anon) pj_pool_release(anon);
+    pj_caching_pool_destroy(&cp);
+    return rc;
+}
+
+
+/* Test the fixed-size object pool */
+static int objpool_basic_test(unsigned flags)
+{
+    enum { CNT = 50, SLAB = 8, OBJ_SIZE = 30 };
+    pj_objpool_t *op;
+    pj_objpool_stat stat;
+    char *obj[CNT];
+    unsigned i, j;
+    int rc = 0;
+
+    if (pj_objpool_create(mem, NULL, OBJ_SIZE, SLAB, flags,
+			  &op) != PJ_SUCCESS)
+    {
+	return -400;
+    }
+
+    for (i=0; i<CNT; ++i) {
+	obj[i] = (char*) pj_objpool_alloc(op);
+	if (!obj[i]) {
+	    rc = -410;
+	    goto on_return;
+	}
+	if (((pj_size_t)obj[i]) % PJ_POOL_ALIGNMENT != 0) {
+	    rc = -415;
+	    goto on_return;
+	}
+	pj_memset(obj[i], i, OBJ_SIZE);
+    }
+
+    /* Objects must not overlap */
+    for (i=0; i<CNT; ++i) {
+	for (j=0; j<OBJ_SIZE; ++j) {
+	    if (obj[i][j] != (char)i) {
+		rc = -420;
+		goto on_return;
+	    }
+	}
+    }
+
+    pj_objpool_get_stat(op, &stat);
+    if (stat.obj_size < OBJ_SIZE || stat.capacity < CNT ||
+	stat.slab_cnt != (stat.capacity + SLAB - 1) / SLAB ||
+	stat.used_cnt != CNT || stat.alloc_cnt != CNT)
+    {
+	rc = -430;
+	goto on_return;
+    }
+
+    /* Freed objects are reused without allocating new slabs */
+    for (i=0; i<CNT; ++i)
+	pj_objpool_free(op, obj[i]);
+    for (i=0; i<CNT; ++i)
+	obj[i] = (char*) pj_objpool_zalloc(op);
+    for (i=0; i<CNT; ++i) {
+	if (obj[i][0] != 0 || obj[i][OBJ_SIZE-1] != 0) {
+	    rc = -440;
+	    goto on_return;
+	}
+    }
+
+    j = stat.slab_cnt;
+    pj_objpool_get_stat(op, &stat);
+    if (stat.slab_cnt != j || stat.used_cnt != CNT ||
+	stat.alloc_cnt != 2 * CNT)
+    {
+	rc = -450;
+	goto on_return;
+    }
+
+    for (i=0; i<CNT; ++i)
+	pj_objpool_free(op, obj[i]);
+    pj_objpool_get_stat(op, &stat);
+    if (stat.used_cnt != 0 || stat.peak_cnt < CNT) {
+	rc = -460;
+	goto on_return;
+    }
+
+    if ((flags & PJ_OBJPOOL_THREAD_CACHE) && stat.cache_hit_cnt == 0) {
+	rc = -470;
+	goto on_return;
+    }
+
+on_return:
+    pj_objpool_destroy(op);
+    return rc;
+}
+
+typedef struct objpool_thread_arg
+{
+    pj_objpool_t    *op;
+    unsigned	     id;
+    int		     rc;
+} objpool_thread_arg;
+
+static int objpool_worker(void *p)
+{
+    enum { LOOP = 2000, HOLD = 40 };
+    objpool_thread_arg *arg = (objpool_thread_arg*) p;
+    pj_uint32_t *obj[HOLD];
+    unsigned i, j;
+
+    for (i=0; i<LOOP; ++i) {
+	unsigned n = (pj_rand() % HOLD) + 1;
+
+	for (j=0; j<n; ++j) {
+	    obj[j] = (pj_uint32_t*) pj_objpool_alloc(arg->op);
+	    if (!obj[j]) {
+		arg->rc = -510;
+		return 0;
+	    }
+	    obj[j][0] = (arg->id << 16) | j;
+	}
+	if ((i & 63) == 0)
+	    pj_thread_sleep(0);
+	for (j=0; j<n; ++j) {
+	    if (obj[j][0] != ((arg->id << 16) | j)) {
+		arg->rc = -520;
+		return 0;
+	    }
+	    pj_objpool_free(arg->op, obj[j]);
+	}
+    }
+
+    return 0;
+}
+
+/* Allocate and free from several threads, the objects must not be shared */
+static int objpool_mt_test(unsigned flags)
+{
+    enum { THREADS = 4 };
+    pj_objpool_t *op;
+    pj_objpool_stat stat;
+    pj_pool_t *pool;
+    pj_thread_t *thread[THREADS];
+    objpool_thread_arg arg[THREADS];
+    unsigned i;
+    int rc = 0;
+
+    pool = pj_pool_create(mem, NULL, 1000, 1000, NULL);
+    if (pj_objpool_create(mem, "objmt", sizeof(pj_uint32_t), 16, flags,
+			  &op) != PJ_SUCCESS)
+    {
+	pj_pool_release(pool);
+	return -500;
+    }
+
+    for (i=0; i<THREADS; ++i) {
+	arg[i].op = op;
+	arg[i].id = i;
+	arg[i].rc = 0;
+	if (pj_thread_create(pool, "objmt", &objpool_worker, &arg[i], 0, 0,
+			     &thread[i]) != PJ_SUCCESS)
+	{
+	    rc = -505;
+	    break;
+	}
+    }
+
+    while (i-- > 0) {
+	pj_thread_join(thread[i]);
+	pj_thread_destroy(thread[i]);
+    }
+
+    for (i=0; rc==0 && i<THREADS; ++i)
+	rc = arg[i].rc;
+
+    if (rc == 0) {
+	pj_objpool_get_stat(op, &stat);
+	PJ_LOG(3,("", "    objpool flags=%u: %u allocs, %u from cache, "
+		  "%u slabs, peak %u", flags, stat.alloc_cnt,
+		  stat.cache_hit_cnt, stat.slab_cnt, stat.peak_cnt));
+	if (stat.used_cnt != 0)
+	    rc = -530;
+    }
+
+    pj_objpool_destroy(op);
+    pj_pool_release(pool);
+    return rc;
+}
+
+/* Keep objects in the cache of a thread which then exits */
+static int objpool_exit_worker(void *p)
+{
+    pj_objpool_t *op = (pj_objpool_t*) p;
+
+    pj_objpool_free(op, pj_objpool_alloc(op));
+    return 0;
+}
+
+/* The objects kept in the cache of a thread which has exited are moved
+ * back to the shared free list after the cache has been idle for two
+ * sweeps.
+ */
+static int objpool_exit_test(void)
+{
+    enum { CNT = PJ_OBJPOOL_THREAD_CACHE_SIZE / 2 + 2 };
+    pj_objpool_t *op;
+    pj_objpool_stat stat;
+    pj_pool_t *pool;
+    pj_thread_t *thread;
+    void *obj[CNT];
+    unsigned i, exit_cached;
+    int rc = 0;
+
+    if (!PJ_HAS_ATOMIC_BUILTINS)
+	return 0;
+
+    pool = pj_pool_create(mem, NULL, 1000, 1000, NULL);
+    if (pj_objpool_create(mem, "objexit", 16, 16, PJ_OBJPOOL_THREAD_CACHE,
+			  &op) != PJ_SUCCESS)
+    {
+	pj_pool_release(pool);
+	return -600;
+    }
+
+    if (pj_thread_create(pool, "objexit", &objpool_exit_worker, op, 0, 0,
+			 &thread) != PJ_SUCCESS)
+    {
+	rc = -610;
+	goto on_return;
+    }
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+
+    pj_objpool_get_stat(op, &stat);
+    exit_cached = stat.cached_cnt;
+    if (exit_cached == 0 || stat.used_cnt != 0) {
+	rc = -620;
+	goto on_return;
+    }
+
+    /* The first sweep clears the active flag of the exited thread's
+     * cache, the second one reclaims the objects. Sweeps only run when
+     * the shared free list is used, i.e. when this thread's cache is
+     * refilled.
+     */
+    pj_thread_sleep(PJ_OBJPOOL_THREAD_CACHE_IDLE + 100);
+    pj_objpool_free(op, pj_objpool_alloc(op));
+
+    pj_thread_sleep(PJ_OBJPOOL_THREAD_CACHE_IDLE + 100);
+    for (i=0; i<CNT; ++i)
+	obj[i] = pj_objpool_alloc(op);
+    for (i=0; i<CNT; ++i) {
+	if (obj[i])
+	    pj_objpool_free(op, obj[i]);
+    }
+
+    /* Only this thread's cache is left */
+    pj_objpool_get_stat(op, &stat);
+    if (stat.used_cnt != 0 || stat.cached_cnt >= 2 * exit_cached) {
+	PJ_LOG(3,("", "    error: %u objects cached, %u by the exited "
+		  "thread", stat.cached_cnt, exit_cached));
+	rc = -630;
+    }
+
+on_return:
+    pj_objpool_destroy(op);
+    pj_pool_release(pool);
+    return rc;
+}
+
+static int objpool_test(void)
+{
+    int rc;
+
+    rc = objpool_basic_test(0);
+    if (rc != 0)
+	return rc;
+
+    rc = objpool_basic_test(PJ_OBJPOOL_THREAD_CACHE);
+    if (rc != 0)
+	return rc - 1000;
+
+    rc = objpool_mt_test(0);
+    if (rc != 0)
+	return rc;
+
+    rc = objpool_mt_test(PJ_OBJPOOL_THREAD_CACHE);
+    if (rc != 0)
+	return rc;
+
+    return objpool_exit_test();
+}
+
 int pool_test(void)
 {
     enum { LOOP = 2 };
@@ -309,6 +863,18 @@ int pool_test(void)
     if (rc != 0)
 	return rc;
 
+    rc = magazine_test();
+    if (rc != 0)
+	return rc;
+
+    rc = category_test();
+    if (rc != 0)
+	return rc;
+
+    rc = objpool_test();
+    if (rc != 0)
+	return rc;
+
 
     return 0;
 }
@@ -118,6 +118,99 @@ static int pool_test_malloc_free()
 
 #endif /* PJ_SYMBIAN */
 
+/*
+ * Multi-threaded benchmark: each thread repeatedly creates a small set of
+ * pools of typical SIP object sizes and releases them again.
+ */
+#define MT_LOOP	    20000
+#define MT_SET	    4
+
+static pj_caching_pool mt_cp;
+
+static int mt_worker(void *arg)
+{
+    static const pj_size_t set_sizes[MT_SET] = { 512, 1000, 4000, 8000 };
+    pj_pool_t *pools[MT_SET];
+    unsigned i, j;
+
+    PJ_UNUSED_ARG(arg);
+
+    for (i=0; i<MT_LOOP; ++i) {
+	for (j=0; j<MT_SET; ++j) {
+	    pools[j] = pj_pool_create(&mt_cp.factory, "mt", set_sizes[j],
+				      set_sizes[j], NULL);
+	    if (!pools[j])
+		return -1;
+	    pj_pool_alloc(pools[j], 64);
+	}
+	for (j=0; j<MT_SET; ++j)
+	    pj_pool_release(pools[j]);
+    }
+    return 0;
+}
+
+static int pool_mt_perf(unsigned thread_cnt, unsigned magazine_size,
+			pj_uint32_t *p_rate)
+{
+    enum { MAX_THREADS = 8 };
+    pj_pool_t *pool;
+    pj_thread_t *threads[MAX_THREADS];
+    pj_timestamp start, end;
+    pj_highprec_t rate;
+    pj_uint32_t elapsed;
+    pj_status_t status;
+    unsigned i;
+    int rc = 0;
+
+    PJ_ASSERT_RETURN(thread_cnt <= MAX_THREADS, -10);
+
+    pj_caching_pool_init(&mt_cp, NULL, 1024*1024);
+    status = pj_caching_pool_set_magazine(&mt_cp, magazine_size);
+    if (status != PJ_SUCCESS) {
+	pj_caching_pool_destroy(&mt_cp);
+	return -20;
+    }
+
+    /* Threads are allocated from the global pool factory */
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+
+    pj_get_timestamp(&start);
+    for (i=0; i<thread_cnt; ++i) {
+	status = pj_thread_create(pool, "pmt", &mt_worker, NULL, 0, 0,
+				  &threads[i]);
+	if (status != PJ_SUCCESS) {
+	    thread_cnt = i;
+	    rc = -30;
+	    break;
+	}
+    }
+    for (i=0; i<thread_cnt; ++i) {
+	pj_thread_join(threads[i]);
+	pj_thread_destroy(threads[i]);
+    }
+    pj_get_timestamp(&end);
+
+    if (mt_cp.used_count != 0) {
+	PJ_LOG(3,(THIS_FILE, "...error: %u pools are not released",
+		  (unsigned)mt_cp.used_count));
+	rc = -40;
+    }
+
+    pj_pool_release(pool);
+    pj_caching_pool_destroy(&mt_cp);
+
+    /* rate = create and release operations per msec */
+    elapsed = pj_elapsed_msec(&start, &end);
+    if (elapsed == 0)
+	elapsed = 1;
+    rate = thread_cnt;
+    pj_highprec_mul(rate, MT_LOOP * MT_SET);
+    pj_highprec_div(rate, elapsed);
+    *p_rate = (pj_uint32_t)rate;
+
+    return rc;
+}
+
 int pool_perf_test()
 {
     unsigned i;
@@ -186,6 +279,29 @@ int pool_perf_test()
     PJ_LOG(3, (THIS_FILE, "..pool speedup over malloc best=%dx, worst=%dx", 
 			  (int)(malloc_time/best),
 			  (int)(malloc_time/worst)));
+
+    /* Multi-threaded create/release, with and without magazines */
+    PJ_LOG(3, (THIS_FILE, "..caching pool create/release, pools/msec:"));
+    PJ_LOG(3, (THIS_FILE, "  threads  no magazine  magazine=4"));
+    {
+	unsigned threads[] = { 1, 2, 4, 8 };
+
+	for (i=0; i<PJ_ARRAY_SIZE(threads); ++i) {
+	    pj_uint32_t rate1, rate2;
+	    int rc;
+
+	    rc = pool_mt_perf(threads[i], 0, &rate1);
+	    if (rc != 0)
+		return rc;
+	    rc = pool_mt_perf(threads[i], 4, &rate2);
+	    if (rc != 0)
+		return rc;
+
+	    PJ_LOG(3, (THIS_FILE, "  %7u  %11u  %10u", 
+		       threads[i], rate1, rate2));
+	}
+    }
+
     return 0;
 }
 
@@ -0,0 +1,290 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+/**
+ * \page page_pjlib_ringbuf_test Test: Ring Buffer
+ *
+ * This file provides implementation of \b ringbuf_test(). It tests the
+ * ring buffer:
+ *  - push and pop until full and empty, with wrap around.
+ *  - in place access with acquire/commit and peek/release.
+ *  - one producer thread and one consumer thread.
+ *  - several producer threads and one consumer thread.
+ *
+ *
+ * This file is <b>pjlib-test/ringbuf.c</b>
+ *
+ * \include pjlib-test/ringbuf.c
+ */
+
+#if INCLUDE_RINGBUF_TEST
+
+#include <pjlib.h>
+
+#define THIS_FILE	"ringbuf.c"
+#define SLOT_CNT	64
+#define MAX_PRODUCERS	4
+#define ITEM_CNT	200000
+
+typedef struct item
+{
+    unsigned	producer;
+    unsigned	seq;
+    char	payload[20];
+} item;
+
+static int basic_test(pj_pool_t *pool)
+{
+    pj_ringbuf_t *rb;
+    item it, *slot;
+    unsigned i, round, next_push = 0, next_pop = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  basic test.."));
+
+    /* Capacity is rounded up to power of two */
+    status = pj_ringbuf_create(pool, sizeof(item), SLOT_CNT - 3, 0, &rb);
+    if (status != PJ_SUCCESS)
+	return -10;
+    if (pj_ringbuf_get_capacity(rb) != SLOT_CNT)
+	return -20;
+
+    if (pj_ringbuf_pop(rb, &it) != PJ_ENOTFOUND || pj_ringbuf_peek(rb))
+	return -30;
+
+    /* Fill and drain by different amounts, so the positions wrap around
+     * at different slots.
+     */
+    for (round=0; round<10; ++round) {
+	unsigned push_cnt = SLOT_CNT - pj_ringbuf_get_count(rb);
+
+	for (i=0; i<push_cnt; ++i) {
+	    pj_bzero(&it, sizeof(it));
+	    it.seq = next_push++;
+	    if (pj_ringbuf_push(rb, &it) != PJ_SUCCESS)
+		return -40;
+	}
+
+	pj_bzero(&it, sizeof(it));
+	if (pj_ringbuf_push(rb, &it) != PJ_ETOOMANY)
+	    return -50;
+	if (pj_ringbuf_acquire(rb) != NULL)
+	    return -60;
+	if (pj_ringbuf_get_count(rb) != SLOT_CNT)
+	    return -70;
+
+	for (i=0; i<(round % 7) + 10; ++i) {
+	    if (pj_ringbuf_pop(rb, &it) != PJ_SUCCESS)
+		return -80;
+	    if (it.seq != next_pop++)
+		return -90;
+	}
+    }
+
+    /* In place access */
+    slot = (item*) pj_ringbuf_peek(rb);
+    if (!slot || slot->seq != next_pop)
+	return -100;
+    pj_ringbuf_release(rb);
+    ++next_pop;
+
+    slot = (item*) pj_ringbuf_acquire(rb);
+    if (!slot || ((pj_size_t)slot & (sizeof(void*)-1)) != 0)
+	return -110;
+    slot->seq = next_push++;
+    pj_ringbuf_commit(rb, slot);
+
+    while ((slot = (item*) pj_ringbuf_peek(rb)) != NULL) {
+	if (slot->seq != next_pop++)
+	    return -120;
+	pj_ringbuf_release(rb);
+    }
+    if (next_pop != next_push || pj_ringbuf_get_count(rb) != 0)
+	return -130;
+
+    pj_ringbuf_destroy(rb);
+    return 0;
+}
+
+#if PJ_HAS_THREADS
+
+static struct
+{
+    pj_ringbuf_t    *rb;
+    unsigned	     producer_cnt;
+    pj_bool_t	     in_place;
+} tp;
+
+static int producer_thread(void *arg)
+{
+    unsigned id = (unsigned)(pj_ssize_t)arg;
+    unsigned i;
+
+    for (i=0; i<ITEM_CNT/tp.producer_cnt; ++i) {
+	if (tp.in_place) {
+	    item *slot;
+
+	    while ((slot = (item*) pj_ringbuf_acquire(tp.rb)) == NULL)
+		pj_thread_sleep(0);
+	    slot->producer = id;
+	    slot->seq = i;
+	    pj_ringbuf_commit(tp.rb, slot);
+	} else {
+	    item it;
+
+	    pj_bzero(&it, sizeof(it));
+	    it.producer = id;
+	    it.seq = i;
+	    while (pj_ringbuf_push(tp.rb, &it) != PJ_SUCCESS)
+		pj_thread_sleep(0);
+	}
+    }
+
+    return 0;
+}
+
+/* Producers and the consumer in different threads. Check that nothing is
+ * lost, and that each producer's items come in order.
+ */
+static int transfer_test(pj_pool_t *pool, unsigned producer_cnt,
+			 pj_bool_t in_place)
+{
+    pj_thread_t *thread[MAX_PRODUCERS];
+    unsigned next[MAX_PRODUCERS];
+    unsigned i, total, expected;
+    pj_timestamp t0, t1;
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  %s test with %u producer(s)%s..",
+	      producer_cnt > 1 ? "MPSC" : "SPSC", producer_cnt,
+	      in_place ? ", in place" : ""));
+
+    status = pj_ringbuf_create(pool, sizeof(item), SLOT_CNT,
+			       producer_cnt > 1 ? PJ_RINGBUF_MULTI_PRODUCER : 0,
+			       &tp.rb);
+    if (status != PJ_SUCCESS)
+	return -200;
+
+    tp.producer_cnt = producer_cnt;
+    tp.in_place = in_place;
+    expected = ITEM_CNT / producer_cnt * producer_cnt;
+    pj_bzero(next, sizeof(next));
+
+    pj_get_timestamp(&t0);
+
+    for (i=0; i<producer_cnt; ++i) {
+	status = pj_thread_create(pool, "rbprod", &producer_thread,
+				  (void*)(pj_ssize_t)i, 0, 0, &thread[i]);
+	if (status != PJ_SUCCESS) {
+	    /* Can't wait for the items of the producers not created */
+	    producer_cnt = i;
+	    rc = -210;
+	    break;
+	}
+    }
+
+    for (total=0; rc==0 && total<expected; ) {
+	item it;
+
+	if (pj_ringbuf_pop(tp.rb, &it) != PJ_SUCCESS) {
+	    pj_thread_sleep(0);
+	    continue;
+	}
+
+	if (it.producer >= producer_cnt || it.seq != next[it.producer]) {
+	    PJ_LOG(3,(THIS_FILE, "...error: producer %u item %u, "
+		      "expecting item %u", it.producer, it.seq,
+		      it.producer < producer_cnt ? next[it.producer] : 0));
+	    rc = -220;
+	    break;
+	}
+	++next[it.producer];
+	++total;
+    }
+
+    /* Let the producers finish if the consumer stopped early */
+    if (rc != 0) {
+	item it;
+
+	for (i=0; i<producer_cnt; ++i) {
+	    while (next[i] < ITEM_CNT / tp.producer_cnt) {
+		if (pj_ringbuf_pop(tp.rb, &it) == PJ_SUCCESS)
+		    ++next[i];
+		else
+		    pj_thread_sleep(0);
+	    }
+	}
+    }
+
+    for (i=0; i<producer_cnt; ++i) {
+	pj_thread_join(thread[i]);
+	pj_thread_destroy(thread[i]);
+    }
+
+    pj_get_timestamp(&t1);
+
+    if (rc == 0 && pj_ringbuf_get_count(tp.rb) != 0)
+	rc = -230;
+
+    if (rc == 0) {
+	pj_uint32_t msec = pj_elapsed_msec(&t0, &t1);
+	PJ_LOG(3,(THIS_FILE, "   %u items in %u msec", total, msec));
+    }
+
+    pj_ringbuf_destroy(tp.rb);
+    return rc;
+}
+
+#endif	/* PJ_HAS_THREADS */
+
+int ringbuf_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+	return -1;
+
+    rc = basic_test(pool);
+
+#if PJ_HAS_THREADS
+    if (rc == 0)
+	rc = transfer_test(pool, 1, PJ_FALSE);
+    if (rc == 0)
+	rc = transfer_test(pool, 1, PJ_TRUE);
+    if (rc == 0)
+	rc = transfer_test(pool, MAX_PRODUCERS, PJ_FALSE);
+    if (rc == 0)
+	rc = transfer_test(pool, MAX_PRODUCERS, PJ_TRUE);
+#endif
+
+    pj_pool_release(pool);
+    return rc;
+}
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_ringbuf_test;
+#endif	/* INCLUDE_RINGBUF_TEST */
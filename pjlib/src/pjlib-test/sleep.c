@@ -30,6 +30,7 @@
  *  - whether pj_thread_sleep() works.
  *  - whether pj_gettimeofday() works.
  *  - whether pj_get_timestamp() and friends works.
+ *  - whether the coarse clock stays close to the accurate clock.
  *
  * API tested:
  *  - pj_thread_sleep()
@@ -40,6 +41,8 @@
  *  - pj_get_timestamp_freq() (implicitly)
  *  - pj_elapsed_time()
  *  - pj_elapsed_usec()
+ *  - pj_gettickcount_coarse()
+ *  - pj_gettimeofday_coarse()
  *
  *
  * This file is <b>pjlib-test/sleep.c</b>
@@ -201,6 +204,138 @@ static int sleep_duration_test(void)
     return 0;
 }
 
+/* Return how far the coarse time is behind the accurate time, in msec */
+static long coarse_lag(const pj_time_val *coarse, const pj_time_val *now)
+{
+    pj_time_val diff = *now;
+
+    PJ_TIME_VAL_SUB(diff, *coarse);
+    return PJ_TIME_VAL_MSEC(diff);
+}
+
+/* Another thread must not see the time cached by a dispatching thread */
+static int coarse_lag_thread(void *arg)
+{
+    pj_time_val coarse, now;
+
+    pj_gettickcount_coarse(&coarse);
+    pj_gettickcount(&now);
+    *(long*)arg = coarse_lag(&coarse, &now);
+    return 0;
+}
+
+static int coarse_clock_test(void)
+{
+    enum { MAX_LAG = 20, SLEEP = 50 };
+    pj_time_val coarse, now;
+    pj_thread_t *thread;
+    pj_pool_t *pool;
+    long lag;
+
+    PJ_LOG(3,(THIS_FILE, "...testing coarse clock"));
+
+    /* Outside dispatching, the clock is read */
+    pj_gettickcount_coarse(&coarse);
+    pj_gettickcount(&now);
+    lag = coarse_lag(&coarse, &now);
+    if (lag < 0 || lag > MAX_LAG) {
+	PJ_LOG(3,(THIS_FILE, "...error: tick count lag is %ld ms", lag));
+	return -80;
+    }
+
+    pj_gettimeofday_coarse(&coarse);
+    pj_gettimeofday(&now);
+    lag = coarse_lag(&coarse, &now);
+    if (lag < -MAX_LAG || lag > MAX_LAG) {
+	PJ_LOG(3,(THIS_FILE, "...error: time of day lag is %ld ms", lag));
+	return -81;
+    }
+
+    /* While dispatching, the clock is read when it is first needed, and
+     * the cached value then falls behind by the time spent since, but
+     * never goes ahead.
+     */
+    pj_coarse_clock_enter(NULL);
+    pj_thread_sleep(SLEEP);
+
+    pj_gettickcount_coarse(&coarse);
+    pj_gettickcount(&now);
+    lag = coarse_lag(&coarse, &now);
+    if (lag < 0 || lag > MAX_LAG) {
+	PJ_LOG(3,(THIS_FILE, "...error: first cached tick count lag is "
+		  "%ld ms", lag));
+	pj_coarse_clock_leave();
+	return -87;
+    }
+
+    pj_thread_sleep(SLEEP);
+
+    pj_gettickcount_coarse(&coarse);
+    pj_gettickcount(&now);
+    lag = coarse_lag(&coarse, &now);
+    if (lag < SLEEP / 2 || lag > SLEEP + MAX_LAG * 5) {
+	PJ_LOG(3,(THIS_FILE, "...error: cached tick count lag is %ld ms",
+		  lag));
+	pj_coarse_clock_leave();
+	return -82;
+    }
+
+    /* The cached time is per thread */
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    lag = -1;
+    if (pj_thread_create(pool, "coarse", &coarse_lag_thread, &lag, 0, 0,
+			 &thread) == PJ_SUCCESS)
+    {
+	pj_thread_join(thread);
+	pj_thread_destroy(thread);
+    }
+    pj_pool_release(pool);
+    if (lag < 0 || lag > MAX_LAG) {
+	PJ_LOG(3,(THIS_FILE, "...error: tick count lag of another thread "
+		  "is %ld ms", lag));
+	pj_coarse_clock_leave();
+	return -86;
+    }
+
+    /* Nested refresh with the caller's time */
+    pj_gettickcount(&now);
+    pj_coarse_clock_enter(&now);
+    pj_gettickcount_coarse(&coarse);
+    if (PJ_TIME_VAL_LT(coarse, now)) {
+	PJ_LOG(3,(THIS_FILE, "...error: coarse clock was not refreshed"));
+	pj_coarse_clock_leave();
+	pj_coarse_clock_leave();
+	return -83;
+    }
+
+    pj_gettimeofday_coarse(&coarse);
+    pj_gettimeofday(&now);
+    lag = coarse_lag(&coarse, &now);
+    if (lag < -MAX_LAG || lag > MAX_LAG * 5) {
+	PJ_LOG(3,(THIS_FILE, "...error: cached time of day lag is %ld ms",
+		  lag));
+	pj_coarse_clock_leave();
+	pj_coarse_clock_leave();
+	return -84;
+    }
+
+    pj_coarse_clock_leave();
+    pj_coarse_clock_leave();
+
+    /* Back to reading the clock */
+    pj_thread_sleep(SLEEP);
+    pj_gettickcount_coarse(&coarse);
+    pj_gettickcount(&now);
+    lag = coarse_lag(&coarse, &now);
+    if (lag < 0 || lag > MAX_LAG) {
+	PJ_LOG(3,(THIS_FILE, "...error: tick count lag is %ld ms after "
+		  "dispatching", lag));
+	return -85;
+    }
+
+    return 0;
+}
+
 int sleep_test()
 {
     int rc;
@@ -213,6 +348,10 @@ int sleep_test()
     if (rc != PJ_SUCCESS)
 	return rc;
 
+    rc = coarse_clock_test();
+    if (rc != PJ_SUCCESS)
+	return rc;
+
     return 0;
 }
 
@@ -146,6 +146,127 @@ static int sock_producer_consumer(int sock_type,
     return 0;
 }
 
+/*
+ * sock_batch_pps()
+ *
+ * Measure the UDP packet rate when packets are sent and received in
+ * batches of batch_cnt packets with pj_sock_sendmmsg()/pj_sock_recvmmsg(),
+ * or one by one with send()/recv() when batch_cnt is zero.
+ */
+static int sock_batch_pps(unsigned batch_cnt,
+			  pj_size_t pkt_size,
+			  unsigned loop,
+			  unsigned *p_pps)
+{
+    enum { MAX_BATCH = 64 };
+    pj_sock_t consumer, producer;
+    pj_pool_t *pool;
+    pj_sock_msg tx_msg[MAX_BATCH], rx_msg[MAX_BATCH];
+    unsigned rounds, per_round, total_received, i;
+    pj_timestamp start, stop;
+    pj_highprec_t elapsed, pps;
+    pj_status_t rc;
+
+    PJ_ASSERT_RETURN(batch_cnt <= MAX_BATCH, -5);
+    per_round = batch_cnt ? batch_cnt : 1;
+
+    pool = pj_pool_create(mem, NULL, 4096, 4096, NULL);
+    if (!pool)
+        return -10;
+
+    rc = app_socketpair(pj_AF_INET(), pj_SOCK_DGRAM(), 0, 
+			&consumer, &producer);
+    if (rc != PJ_SUCCESS) {
+        app_perror("...error: create socket pair", rc);
+	pj_pool_release(pool);
+        return -20;
+    }
+
+    pj_bzero(tx_msg, sizeof(tx_msg));
+    for (i=0; i<per_round; ++i) {
+	/* addr_len is zero since the producer is connected */
+	tx_msg[i].buf = pj_pool_zalloc(pool, pkt_size);
+	rx_msg[i].buf = pj_pool_alloc(pool, pkt_size);
+    }
+
+    total_received = 0;
+    pj_get_timestamp(&start);
+    for (rounds=0; rounds < loop / per_round; ++rounds) {
+	unsigned received = 0;
+
+	if (batch_cnt) {
+	    unsigned cnt = batch_cnt;
+
+	    for (i=0; i<batch_cnt; ++i)
+		tx_msg[i].len = pkt_size;
+
+	    rc = pj_sock_sendmmsg(producer, tx_msg, &cnt, 0);
+	    if (rc != PJ_SUCCESS || cnt != batch_cnt) {
+		app_perror("...error: sendmmsg()", rc);
+		rc = -30;
+		goto on_return;
+	    }
+
+	    /* Packets may be returned in several calls */
+	    while (received < batch_cnt) {
+		cnt = batch_cnt - received;
+		for (i=0; i<cnt; ++i) {
+		    rx_msg[i].len = pkt_size;
+		    rx_msg[i].addr_len = sizeof(rx_msg[i].addr);
+		}
+		rc = pj_sock_recvmmsg(consumer, rx_msg, &cnt, 0);
+		if (rc != PJ_SUCCESS) {
+		    app_perror("...error: recvmmsg()", rc);
+		    rc = -40;
+		    goto on_return;
+		}
+		received += cnt;
+	    }
+
+	} else {
+	    pj_ssize_t len = pkt_size;
+
+	    rc = pj_sock_send(producer, tx_msg[0].buf, &len, 0);
+	    if (rc != PJ_SUCCESS) {
+		app_perror("...error: send()", rc);
+		rc = -50;
+		goto on_return;
+	    }
+
+	    len = pkt_size;
+	    rc = pj_sock_recv(consumer, rx_msg[0].buf, &len, 0);
+	    if (rc != PJ_SUCCESS) {
+		app_perror("...error: recv()", rc);
+		rc = -60;
+		goto on_return;
+	    }
+	    received = 1;
+	}
+
+	total_received += received;
+    }
+    pj_get_timestamp(&stop);
+
+    elapsed = pj_elapsed_usec(&start, &stop);
+    if (elapsed == 0)
+	elapsed = 1;
+
+    /* pps = total_received * 1000000 / elapsed */
+    pps = total_received;
+    pj_highprec_mul(pps, 1000000);
+    pj_highprec_div(pps, elapsed);
+
+    *p_pps = (unsigned)pps;
+    rc = 0;
+
+on_return:
+    pj_sock_close(consumer);
+    pj_sock_close(producer);
+    pj_pool_release(pool);
+
+    return rc;
+}
+
 /*
  * sock_perf_test()
  *
@@ -158,7 +279,8 @@ int sock_perf_test(void)
     unsigned bandwidth;
 
     PJ_LOG(3,("", "...benchmarking socket "
-                  "(2 sockets, packet=512, single threaded):"));
+                  "(2 sockets, packet=512 (160 for packet rate), "
+		  "single threaded):"));
 
     /* Disable this test on Symbian since UDP connect()/send() failed
      * with S60 3rd edition (including MR2).
@@ -169,6 +291,24 @@ int sock_perf_test(void)
     rc = sock_producer_consumer(pj_SOCK_DGRAM(), 512, LOOP, &bandwidth);
     if (rc != 0) return rc;
     PJ_LOG(3,("", "....bandwidth UDP = %d KB/s", bandwidth));
+
+    /* Benchmarking UDP packet rate with batch send/receive */
+    {
+	unsigned batch[] = { 0, 4, 16, 64 };
+	unsigned i, pps;
+
+	for (i=0; i<PJ_ARRAY_SIZE(batch); ++i) {
+	    rc = sock_batch_pps(batch[i], 160, LOOP * 2, &pps);
+	    if (rc != 0) return rc;
+	    if (batch[i]) {
+		PJ_LOG(3,("", "....packet rate UDP mmsg batch=%-2u = %u pkt/s",
+			  batch[i], pps));
+	    } else {
+		PJ_LOG(3,("", "....packet rate UDP send/recv    = %u pkt/s",
+			  pps));
+	    }
+	}
+    }
 #endif
 
     /* Benchmarking TCP */
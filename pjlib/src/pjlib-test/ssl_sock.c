@@ -683,6 +683,171 @@ on_return:
 }
 
 
+/* Connect to the same SSL server twice, the second connection should
+ * resume the session established by the first one.
+ */
+static int sess_resume_test(void)
+{
+    pj_pool_t *pool = NULL;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_ssl_sock_t *ssock_serv = NULL;
+    pj_ssl_sock_t *ssock_cli = NULL;
+    pj_ssl_sock_param param;
+    pj_ssl_sock_sess_stat stat0, stat1;
+    struct test_state state_serv = { 0 };
+    struct test_state state_cli = { 0 };
+    pj_sockaddr addr, listen_addr;
+    pj_ssl_cert_t *cert = NULL;
+    pj_str_t tmp1, tmp2, tmp3, tmp4;
+    unsigned i;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, "ssl_resume", 256, 256, NULL);
+
+    /* Keys of the closed connections are only reused after a while */
+    status = pj_ioqueue_create(pool, 8, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    pj_ssl_sock_param_default(&param);
+    param.cb.on_accept_complete = &ssl_on_accept_complete;
+    param.cb.on_connect_complete = &ssl_on_connect_complete;
+    param.cb.on_data_read = &ssl_on_data_read;
+    param.cb.on_data_sent = &ssl_on_data_sent;
+    param.ioqueue = ioqueue;
+
+    pj_sockaddr_init(PJ_AF_INET, &addr, pj_strset2(&tmp1, "127.0.0.1"), 0);
+
+    /* === SERVER === */
+    param.user_data = &state_serv;
+
+    state_serv.pool = pool;
+    state_serv.echo = PJ_TRUE;
+    state_serv.is_server = PJ_TRUE;
+
+    status = pj_ssl_sock_create(pool, &param, &ssock_serv);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    status = pj_ssl_cert_load_from_files(pool, 
+					 pj_strset2(&tmp1, (char*)CERT_CA_FILE), 
+					 pj_strset2(&tmp2, (char*)CERT_FILE), 
+					 pj_strset2(&tmp3, (char*)CERT_PRIVKEY_FILE), 
+					 pj_strset2(&tmp4, (char*)CERT_PRIVKEY_PASS), 
+					 &cert);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    status = pj_ssl_sock_set_certificate(ssock_serv, pool, cert);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    status = pj_ssl_sock_start_accept(ssock_serv, pool, &addr,
+				      pj_sockaddr_get_len(&addr));
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    {
+	pj_ssl_sock_info info;
+
+	pj_ssl_sock_get_info(ssock_serv, &info);
+	pj_sockaddr_cp(&listen_addr, &info.local_addr);
+    }
+
+    /* Client only needs the CA */
+    pj_strset2(&tmp2, NULL);
+    status = pj_ssl_cert_load_from_files(pool, &tmp1, &tmp2, &tmp2, &tmp2,
+					 &cert);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    pj_ssl_sock_get_sess_stat(&stat0);
+
+    /* === CLIENTS === */
+    for (i = 0; i < 2; ++i) {
+	pj_bzero(&state_cli, sizeof(state_cli));
+	state_cli.pool = pool;
+	state_cli.check_echo = PJ_TRUE;
+	state_cli.send_str_len = 1024;
+	state_cli.send_str = (char*)pj_pool_zalloc(pool,
+						   state_cli.send_str_len);
+	state_serv.done = PJ_FALSE;
+	param.user_data = &state_cli;
+
+	status = pj_ssl_sock_create(pool, &param, &ssock_cli);
+	if (status != PJ_SUCCESS) {
+	    goto on_return;
+	}
+
+	status = pj_ssl_sock_set_certificate(ssock_cli, pool, cert);
+	if (status != PJ_SUCCESS) {
+	    goto on_return;
+	}
+
+	status = pj_ssl_sock_start_connect(ssock_cli, pool, &addr,
+					   &listen_addr,
+					   pj_sockaddr_get_len(&addr));
+	if (status == PJ_SUCCESS) {
+	    ssl_on_connect_complete(ssock_cli, PJ_SUCCESS);
+	} else if (status == PJ_EPENDING) {
+	    status = PJ_SUCCESS;
+	} else {
+	    goto on_return;
+	}
+
+	while (!state_serv.err && !state_cli.err && !state_cli.done) {
+	    pj_time_val delay = {0, 100};
+	    pj_ioqueue_poll(ioqueue, &delay);
+	}
+
+	/* The client socket is closed by the callback once done */
+	if (state_cli.done)
+	    ssock_cli = NULL;
+
+	if (state_serv.err || state_cli.err) {
+	    status = state_serv.err? state_serv.err : state_cli.err;
+	    goto on_return;
+	}
+
+	{
+	    pj_time_val delay = {0, 100};
+	    while (pj_ioqueue_poll(ioqueue, &delay) > 0);
+	}
+    }
+
+    pj_ssl_sock_get_sess_stat(&stat1);
+    PJ_LOG(3, ("", "...client hit/miss: %u/%u, server hit/miss: %u/%u",
+	       stat1.client_hit - stat0.client_hit,
+	       stat1.client_miss - stat0.client_miss,
+	       stat1.server_hit - stat0.server_hit,
+	       stat1.server_miss - stat0.server_miss));
+
+    if (stat1.client_hit == stat0.client_hit ||
+	stat1.server_hit == stat0.server_hit)
+    {
+	status = PJ_EBUG;
+    }
+
+on_return:
+    if (ssock_serv)
+	pj_ssl_sock_close(ssock_serv);
+    if (ssock_cli && !state_cli.err && !state_cli.done)
+	pj_ssl_sock_close(ssock_cli);
+    if (ioqueue)
+	pj_ioqueue_destroy(ioqueue);
+    if (pool)
+	pj_pool_release(pool);
+
+    return status;
+}
+
+
 static pj_bool_t asock_on_data_read(pj_activesock_t *asock,
 				    void *data,
 				    pj_size_t size,
@@ -1330,6 +1495,479 @@ on_return:
     return status;
 }
 
+/* Handshake latency test: open many TLS connections at once to a
+ * listener that shares its ioqueue with a UDP echo socket, and measure
+ * how much the UDP round trip time grows while the handshakes run, with
+ * and without the handshake executor.
+ */
+static struct
+{
+    pj_bool_t	     quit;
+    pj_atomic_t	    *done_cnt;
+    pj_sock_t	     echo_sock;
+    pj_ssl_sock_t  **accepted;
+    pj_atomic_t	    *accepted_cnt;
+    unsigned	     max_accepted;
+} hs;
+
+static int hs_poll_thread(void *arg)
+{
+    pj_ioqueue_t *ioqueue = (pj_ioqueue_t*)arg;
+
+    while (!hs.quit) {
+	pj_time_val delay = {0, 10};
+	pj_ioqueue_poll(ioqueue, &delay);
+    }
+    return 0;
+}
+
+static pj_bool_t hs_on_echo(pj_activesock_t *asock, void *data,
+			    pj_size_t size, const pj_sockaddr_t *src_addr,
+			    int addr_len, pj_status_t status)
+{
+    PJ_UNUSED_ARG(asock);
+
+    if (status == PJ_SUCCESS) {
+	pj_ssize_t len = size;
+	pj_sock_sendto(hs.echo_sock, data, &len, 0, src_addr, addr_len);
+    }
+    return PJ_TRUE;
+}
+
+static pj_bool_t hs_on_accept_complete(pj_ssl_sock_t *ssock,
+				       pj_ssl_sock_t *newsock,
+				       const pj_sockaddr_t *src_addr,
+				       int src_addr_len)
+{
+    int idx = pj_atomic_inc_and_get(hs.accepted_cnt) - 1;
+
+    PJ_UNUSED_ARG(ssock);
+    PJ_UNUSED_ARG(src_addr);
+    PJ_UNUSED_ARG(src_addr_len);
+
+    if ((unsigned)idx >= hs.max_accepted) {
+	pj_ssl_sock_close(newsock);
+	return PJ_FALSE;
+    }
+    hs.accepted[idx] = newsock;
+    return PJ_TRUE;
+}
+
+static pj_bool_t hs_on_connect_complete(pj_ssl_sock_t *ssock,
+					pj_status_t status)
+{
+    PJ_UNUSED_ARG(ssock);
+
+    if (status != PJ_SUCCESS)
+	app_perror("...ERROR hs_on_connect_complete()", status);
+    pj_atomic_inc(hs.done_cnt);
+    return PJ_TRUE;
+}
+
+/* Send a ping to the echo socket, return the round trip time in usec */
+static int hs_ping(pj_sock_t sock, const pj_sockaddr *echo_addr)
+{
+    char pkt[32];
+    pj_ssize_t len = sizeof(pkt);
+    pj_timestamp t0, t1;
+    pj_fd_set_t rset;
+    pj_time_val timeout = {1, 0};
+
+    pj_bzero(pkt, sizeof(pkt));
+    pj_get_timestamp(&t0);
+    if (pj_sock_sendto(sock, pkt, &len, 0, echo_addr,
+		       pj_sockaddr_get_len(echo_addr)) != PJ_SUCCESS)
+    {
+	return -1;
+    }
+
+    PJ_FD_ZERO(&rset);
+    PJ_FD_SET(sock, &rset);
+    if (pj_sock_select((int)sock+1, &rset, NULL, NULL, &timeout) != 1)
+	return -1;
+
+    len = sizeof(pkt);
+    if (pj_sock_recv(sock, pkt, &len, 0) != PJ_SUCCESS)
+	return -1;
+    pj_get_timestamp(&t1);
+
+    return (int)pj_elapsed_usec(&t0, &t1);
+}
+
+static int handshake_latency_test(unsigned clients, pj_bool_t offload)
+{
+    enum { IDLE_PING = 50 };
+    pj_pool_t *pool = NULL;
+    pj_ioqueue_t *ioq_serv = NULL, *ioq_cli = NULL;
+    pj_thread_t *thread_serv = NULL, *thread_cli = NULL;
+    pj_executor_t *exec = NULL;
+    pj_activesock_t *echo = NULL;
+    pj_activesock_cb echo_cb;
+    pj_sock_t ping_sock = PJ_INVALID_SOCKET;
+    pj_ssl_sock_t *ssock_serv = NULL;
+    pj_ssl_sock_t **ssock_cli = NULL;
+    pj_ssl_sock_param param;
+    pj_ssl_cert_t *cert = NULL;
+    pj_sockaddr addr, listen_addr, echo_addr;
+    pj_str_t tmp1, tmp2, tmp3, tmp4;
+    pj_timestamp t0, t1;
+    unsigned i, idle_avg = 0, ping_cnt = 0, ping_max = 0;
+    pj_uint32_t ping_total = 0;
+    pj_status_t status;
+
+    pj_bzero(&hs, sizeof(hs));
+    hs.echo_sock = PJ_INVALID_SOCKET;
+
+    pool = pj_pool_create(mem, "ssl_hs", 256, 256, NULL);
+
+    status = pj_atomic_create(pool, 0, &hs.done_cnt);
+    if (status == PJ_SUCCESS)
+	status = pj_atomic_create(pool, 0, &hs.accepted_cnt);
+    if (status == PJ_SUCCESS)
+	status = pj_ioqueue_create(pool, PJ_IOQUEUE_MAX_HANDLES, &ioq_serv);
+    if (status == PJ_SUCCESS)
+	status = pj_ioqueue_create(pool, PJ_IOQUEUE_MAX_HANDLES, &ioq_cli);
+    if (status == PJ_SUCCESS && offload)
+	status = pj_executor_create(pool, "ssl_hs", NULL, &exec);
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    pj_sockaddr_init(PJ_AF_INET, &addr, pj_strset2(&tmp1, "127.0.0.1"), 0);
+
+    /* UDP echo socket on the server's ioqueue */
+    pj_bzero(&echo_cb, sizeof(echo_cb));
+    echo_cb.on_data_recvfrom = &hs_on_echo;
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0,
+			    &hs.echo_sock);
+    if (status == PJ_SUCCESS)
+	status = pj_sock_bind(hs.echo_sock, &addr,
+			      pj_sockaddr_get_len(&addr));
+    if (status == PJ_SUCCESS)
+	status = pj_activesock_create(pool, hs.echo_sock, pj_SOCK_DGRAM(),
+				      NULL, ioq_serv, &echo_cb, NULL, &echo);
+    if (status == PJ_SUCCESS)
+	status = pj_activesock_start_recvfrom(echo, pool, 64, 0);
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    {
+	int addr_len = sizeof(echo_addr);
+	status = pj_sock_getsockname(hs.echo_sock, &echo_addr, &addr_len);
+	if (status == PJ_SUCCESS)
+	    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0,
+				    &ping_sock);
+	if (status != PJ_SUCCESS)
+	    goto on_return;
+    }
+
+    /* TLS listener, every handshake is a full one */
+    status = pj_ssl_cert_load_from_files(pool, 
+					 pj_strset2(&tmp1, (char*)CERT_CA_FILE), 
+					 pj_strset2(&tmp2, (char*)CERT_FILE), 
+					 pj_strset2(&tmp3, (char*)CERT_PRIVKEY_FILE), 
+					 pj_strset2(&tmp4, (char*)CERT_PRIVKEY_PASS), 
+					 &cert);
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    pj_ssl_sock_param_default(&param);
+    param.cb.on_accept_complete = &hs_on_accept_complete;
+    param.cb.on_connect_complete = &hs_on_connect_complete;
+    param.ioqueue = ioq_serv;
+    param.sess_cache = PJ_FALSE;
+    param.handshake_exec = exec;
+
+    status = pj_ssl_sock_create(pool, &param, &ssock_serv);
+    if (status == PJ_SUCCESS)
+	status = pj_ssl_sock_set_certificate(ssock_serv, pool, cert);
+    if (status == PJ_SUCCESS)
+	status = pj_ssl_sock_start_accept(ssock_serv, pool, &addr,
+					  pj_sockaddr_get_len(&addr));
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    {
+	pj_ssl_sock_info info;
+
+	pj_ssl_sock_get_info(ssock_serv, &info);
+	pj_sockaddr_cp(&listen_addr, &info.local_addr);
+    }
+
+    hs.accepted = (pj_ssl_sock_t**)pj_pool_calloc(pool, clients,
+						  sizeof(pj_ssl_sock_t*));
+    hs.max_accepted = clients;
+    ssock_cli = (pj_ssl_sock_t**)pj_pool_calloc(pool, clients,
+						sizeof(pj_ssl_sock_t*));
+
+    status = pj_thread_create(pool, "hs_serv", &hs_poll_thread, ioq_serv,
+			      0, 0, &thread_serv);
+    if (status == PJ_SUCCESS)
+	status = pj_thread_create(pool, "hs_cli", &hs_poll_thread, ioq_cli,
+				  0, 0, &thread_cli);
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    /* Round trip time without the handshakes */
+    for (i = 0; i < IDLE_PING; ++i) {
+	int rtt = hs_ping(ping_sock, &echo_addr);
+	if (rtt < 0) {
+	    status = PJ_ETIMEDOUT;
+	    goto on_return;
+	}
+	idle_avg += rtt;
+    }
+    idle_avg /= IDLE_PING;
+
+    /* Connect all clients at once */
+    param.ioqueue = ioq_cli;
+    param.handshake_exec = NULL;
+    pj_get_timestamp(&t0);
+    for (i = 0; i < clients; ++i) {
+	status = pj_ssl_sock_create(pool, &param, &ssock_cli[i]);
+	if (status != PJ_SUCCESS)
+	    goto on_return;
+
+	status = pj_ssl_sock_start_connect(ssock_cli[i], pool, &addr,
+					   &listen_addr,
+					   pj_sockaddr_get_len(&addr));
+	if (status != PJ_SUCCESS && status != PJ_EPENDING)
+	    goto on_return;
+    }
+
+    /* Keep pinging until all the handshakes are done */
+    while ((unsigned)pj_atomic_get(hs.done_cnt) < clients) {
+	int rtt = hs_ping(ping_sock, &echo_addr);
+	if (rtt < 0) {
+	    status = PJ_ETIMEDOUT;
+	    goto on_return;
+	}
+	ping_total += rtt;
+	if ((unsigned)rtt > ping_max)
+	    ping_max = rtt;
+	++ping_cnt;
+
+	pj_get_timestamp(&t1);
+	if (pj_elapsed_msec(&t0, &t1) > 60000) {
+	    status = PJ_ETIMEDOUT;
+	    goto on_return;
+	}
+    }
+    pj_get_timestamp(&t1);
+    status = PJ_SUCCESS;
+
+    PJ_LOG(3, ("", "...%s: %u handshakes in %u ms, UDP rtt idle %u usec, "
+	       "during handshakes avg %u usec, max %u usec",
+	       (offload? "executor" : "ioqueue thread"), clients,
+	       pj_elapsed_msec(&t0, &t1), idle_avg,
+	       (ping_cnt? ping_total / ping_cnt : 0), ping_max));
+
+on_return:
+    hs.quit = PJ_TRUE;
+    if (thread_serv) {
+	pj_thread_join(thread_serv);
+	pj_thread_destroy(thread_serv);
+    }
+    if (thread_cli) {
+	pj_thread_join(thread_cli);
+	pj_thread_destroy(thread_cli);
+    }
+    if (exec)
+	pj_executor_destroy(exec);
+
+    for (i = 0; ssock_cli && i < clients; ++i) {
+	if (ssock_cli[i])
+	    pj_ssl_sock_close(ssock_cli[i]);
+    }
+    for (i = 0; hs.accepted && i < clients; ++i) {
+	if (hs.accepted[i])
+	    pj_ssl_sock_close(hs.accepted[i]);
+    }
+    if (ssock_serv)
+	pj_ssl_sock_close(ssock_serv);
+    if (echo)
+	pj_activesock_close(echo);
+    else if (hs.echo_sock != PJ_INVALID_SOCKET)
+	pj_sock_close(hs.echo_sock);
+    if (ping_sock != PJ_INVALID_SOCKET)
+	pj_sock_close(ping_sock);
+    if (ioq_cli)
+	pj_ioqueue_destroy(ioq_cli);
+    if (ioq_serv)
+	pj_ioqueue_destroy(ioq_serv);
+    if (hs.accepted_cnt)
+	pj_atomic_destroy(hs.accepted_cnt);
+    if (hs.done_cnt)
+	pj_atomic_destroy(hs.done_cnt);
+    if (pool)
+	pj_pool_release(pool);
+
+    return status;
+}
+
+
+/* Close the client sockets from the application thread while their
+ * handshakes are being run by the executor, to check that the handshake
+ * task never resumes the reads of a closed socket.
+ */
+static pj_bool_t hs_on_close_connect(pj_ssl_sock_t *ssock,
+				     pj_status_t status)
+{
+    PJ_UNUSED_ARG(ssock);
+    PJ_UNUSED_ARG(status);
+
+    pj_atomic_inc(hs.done_cnt);
+    return PJ_TRUE;
+}
+
+static int handshake_close_test(unsigned clients)
+{
+    pj_pool_t *pool = NULL;
+    pj_ioqueue_t *ioq_serv = NULL, *ioq_cli = NULL;
+    pj_thread_t *thread_serv = NULL, *thread_cli = NULL;
+    pj_executor_t *exec = NULL;
+    pj_ssl_sock_t *ssock_serv = NULL;
+    pj_ssl_sock_t **ssock_cli = NULL;
+    pj_ssl_sock_param param;
+    pj_ssl_cert_t *cert = NULL;
+    pj_sockaddr addr, listen_addr;
+    pj_str_t tmp1, tmp2, tmp3, tmp4;
+    pj_executor_stat stat;
+    unsigned i;
+    pj_status_t status;
+
+    pj_bzero(&hs, sizeof(hs));
+    hs.echo_sock = PJ_INVALID_SOCKET;
+
+    pool = pj_pool_create(mem, "ssl_hsclose", 256, 256, NULL);
+
+    status = pj_atomic_create(pool, 0, &hs.done_cnt);
+    if (status == PJ_SUCCESS)
+	status = pj_atomic_create(pool, 0, &hs.accepted_cnt);
+    if (status == PJ_SUCCESS)
+	status = pj_ioqueue_create(pool, PJ_IOQUEUE_MAX_HANDLES, &ioq_serv);
+    if (status == PJ_SUCCESS)
+	status = pj_ioqueue_create(pool, PJ_IOQUEUE_MAX_HANDLES, &ioq_cli);
+    if (status == PJ_SUCCESS)
+	status = pj_executor_create(pool, "ssl_hsclose", NULL, &exec);
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    pj_sockaddr_init(PJ_AF_INET, &addr, pj_strset2(&tmp1, "127.0.0.1"), 0);
+
+    status = pj_ssl_cert_load_from_files(pool, 
+					 pj_strset2(&tmp1, (char*)CERT_CA_FILE), 
+					 pj_strset2(&tmp2, (char*)CERT_FILE), 
+					 pj_strset2(&tmp3, (char*)CERT_PRIVKEY_FILE), 
+					 pj_strset2(&tmp4, (char*)CERT_PRIVKEY_PASS), 
+					 &cert);
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    pj_ssl_sock_param_default(&param);
+    param.cb.on_accept_complete = &hs_on_accept_complete;
+    param.cb.on_connect_complete = &hs_on_close_connect;
+    param.ioqueue = ioq_serv;
+    param.sess_cache = PJ_FALSE;
+
+    status = pj_ssl_sock_create(pool, &param, &ssock_serv);
+    if (status == PJ_SUCCESS)
+	status = pj_ssl_sock_set_certificate(ssock_serv, pool, cert);
+    if (status == PJ_SUCCESS)
+	status = pj_ssl_sock_start_accept(ssock_serv, pool, &addr,
+					  pj_sockaddr_get_len(&addr));
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    {
+	pj_ssl_sock_info info;
+
+	pj_ssl_sock_get_info(ssock_serv, &info);
+	pj_sockaddr_cp(&listen_addr, &info.local_addr);
+    }
+
+    hs.accepted = (pj_ssl_sock_t**)pj_pool_calloc(pool, clients,
+						  sizeof(pj_ssl_sock_t*));
+    hs.max_accepted = clients;
+    ssock_cli = (pj_ssl_sock_t**)pj_pool_calloc(pool, clients,
+						sizeof(pj_ssl_sock_t*));
+
+    status = pj_thread_create(pool, "hs_serv", &hs_poll_thread, ioq_serv,
+			      0, 0, &thread_serv);
+    if (status == PJ_SUCCESS)
+	status = pj_thread_create(pool, "hs_cli", &hs_poll_thread, ioq_cli,
+				  0, 0, &thread_cli);
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    /* The clients run their handshakes on the executor */
+    param.ioqueue = ioq_cli;
+    param.handshake_exec = exec;
+    for (i = 0; i < clients; ++i) {
+	status = pj_ssl_sock_create(pool, &param, &ssock_cli[i]);
+	if (status != PJ_SUCCESS)
+	    goto on_return;
+
+	status = pj_ssl_sock_start_connect(ssock_cli[i], pool, &addr,
+					   &listen_addr,
+					   pj_sockaddr_get_len(&addr));
+	if (status != PJ_SUCCESS && status != PJ_EPENDING)
+	    goto on_return;
+    }
+    status = PJ_SUCCESS;
+
+    /* Close them at different points of their handshakes */
+    for (i = 0; i < clients; ++i) {
+	pj_thread_sleep(10 + (i % 3) * 10);
+	pj_ssl_sock_close(ssock_cli[i]);
+	ssock_cli[i] = NULL;
+    }
+
+    /* Let the queued tasks run on the closed sockets */
+    pj_thread_sleep(500);
+
+    pj_executor_get_stat(exec, &stat);
+    PJ_LOG(3, ("", "...%u clients closed, %d handshakes completed, "
+	       "%u tasks run", clients, (int)pj_atomic_get(hs.done_cnt),
+	       stat.exec_cnt));
+
+on_return:
+    hs.quit = PJ_TRUE;
+    if (thread_serv) {
+	pj_thread_join(thread_serv);
+	pj_thread_destroy(thread_serv);
+    }
+    if (thread_cli) {
+	pj_thread_join(thread_cli);
+	pj_thread_destroy(thread_cli);
+    }
+    if (exec)
+	pj_executor_destroy(exec);
+
+    for (i = 0; ssock_cli && i < clients; ++i) {
+	if (ssock_cli[i])
+	    pj_ssl_sock_close(ssock_cli[i]);
+    }
+    for (i = 0; hs.accepted && i < clients; ++i) {
+	if (hs.accepted[i])
+	    pj_ssl_sock_close(hs.accepted[i]);
+    }
+    if (ssock_serv)
+	pj_ssl_sock_close(ssock_serv);
+    if (ioq_cli)
+	pj_ioqueue_destroy(ioq_cli);
+    if (ioq_serv)
+	pj_ioqueue_destroy(ioq_serv);
+    if (hs.accepted_cnt)
+	pj_atomic_destroy(hs.accepted_cnt);
+    if (hs.done_cnt)
+	pj_atomic_destroy(hs.done_cnt);
+    if (pool)
+	pj_pool_release(pool);
+
+    return status;
+}
+
+
 #if 0 && (!defined(PJ_SYMBIAN) || PJ_SYMBIAN==0)
 pj_status_t pj_ssl_sock_ossl_test_send_buf(pj_pool_t *pool);
 static int ossl_test_send_buf()
@@ -1418,11 +2056,28 @@ int ssl_sock_test(void)
     if (ret != 0)
 	return ret;
 
+    PJ_LOG(3,("", "..session resumption test"));
+    ret = sess_resume_test();
+    if (ret != 0)
+	return ret;
+
     PJ_LOG(3,("", "..performance test"));
     ret = perf_test(PJ_IOQUEUE_MAX_HANDLES/2 - 1, 0);
     if (ret != 0)
 	return ret;
 
+    PJ_LOG(3,("", "..handshake latency test"));
+    ret = handshake_latency_test(PJ_IOQUEUE_MAX_HANDLES/2 - 2, PJ_FALSE);
+    if (ret == 0)
+	ret = handshake_latency_test(PJ_IOQUEUE_MAX_HANDLES/2 - 2, PJ_TRUE);
+    if (ret != 0)
+	return ret;
+
+    PJ_LOG(3,("", "..closing sockets during offloaded handshakes"));
+    ret = handshake_close_test(PJ_IOQUEUE_MAX_HANDLES/2 - 2);
+    if (ret != 0)
+	return ret;
+
     PJ_LOG(3,("", "..client non-SSL (handshake timeout 5 secs)"));
     ret = client_non_ssl(5000);
     /* PJ_TIMEDOUT won't be returned as accepted socket is deleted silently */
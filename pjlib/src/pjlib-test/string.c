@@ -21,6 +21,8 @@
 #include <pj/pool.h>
 #include <pj/log.h>
 #include <pj/os.h>
+#include <pj/ctype.h>
+#include <pj/rand.h>
 #include "test.h"
 
 #define THIS_FILE	"string.c"
@@ -42,6 +44,9 @@
  *  - pj_strncmp()
  *  - pj_strnicmp()
  *  - pj_strchr()
+ *  - pj_strstr()
+ *  - pj_stristr()
+ *  - pj_memicmp()
  *  - pj_strdup()
  *  - pj_strdup2()
  *  - pj_strcpy()
@@ -232,6 +237,22 @@ static int stricmp_test(void)
     STRTEST( -1, -1, "aaaaa", buf+15, -646);
     STRTEST( -1, -1, "aaaaa", buf+20, -648);
 
+    /* Embedded NULL characters are compared like the other characters,
+     * as pj_strcmp() does.
+     */
+    s1.ptr = "ab\0cd"; s1.slen = 5;
+    s2.ptr = "AB\0CE"; s2.slen = 5;
+    if (pj_stricmp(&s1, &s2) >= 0 || pj_stricmp(&s2, &s1) <= 0)
+	return -650;
+    if (pj_strnicmp(&s1, &s2, 4) != 0 || pj_strnicmp(&s1, &s2, 5) >= 0)
+	return -652;
+    s2.ptr = "AB\0CD";
+    if (pj_stricmp(&s1, &s2) != 0)
+	return -654;
+    s2.slen = 3;
+    if (pj_stricmp(&s1, &s2) <= 0 || pj_stricmp(&s2, &s1) >= 0)
+	return -656;
+
     zero.u32.hi = zero.u32.lo = 0;
     c1 = pj_elapsed_cycle(&zero, &e1);
     c2 = pj_elapsed_cycle(&zero, &e2);
@@ -290,6 +311,186 @@ static int strcmp_test(void)
 #undef STR_TEST
 }
 
+/* Reference implementations, one byte at a time */
+static int ref_memicmp(const char *p1, const char *p2, pj_size_t len)
+{
+    for (; len; --len, ++p1, ++p2) {
+	int c1 = (unsigned char)*p1, c2 = (unsigned char)*p2;
+	if (c1 >= 'A' && c1 <= 'Z') c1 += 'a' - 'A';
+	if (c2 >= 'A' && c2 <= 'Z') c2 += 'a' - 'A';
+	if (c1 != c2)
+	    return c1 - c2;
+    }
+    return 0;
+}
+
+static char *ref_strstr(const pj_str_t *str, const pj_str_t *sub,
+			pj_bool_t icase)
+{
+    pj_ssize_t i;
+
+    for (i=0; i + sub->slen <= str->slen; ++i) {
+	if (icase) {
+	    if (ref_memicmp(str->ptr + i, sub->ptr, sub->slen) == 0)
+		return str->ptr + i;
+	} else {
+	    if (pj_memcmp(str->ptr + i, sub->ptr, sub->slen) == 0)
+		return str->ptr + i;
+	}
+    }
+    return NULL;
+}
+
+/* Random string from a small alphabet, so that there are many partial
+ * matches, including the characters around the ASCII letters.
+ */
+static void simd_random_str(char *buf, int len)
+{
+    static const char chars[] = "aAbBzZ@[`{\x80\xC1 ";
+    int i;
+
+    for (i=0; i<len; ++i)
+	buf[i] = chars[pj_rand() % (sizeof(chars)-1)];
+}
+
+/* Compare the implementation in use with the reference implementation */
+static int simd_check(void)
+{
+    enum { LOOP = 4000, MAX_LEN = 100 };
+    char buf1[MAX_LEN+1], buf2[MAX_LEN+1];
+    pj_str_t s1, s2;
+    int i;
+
+    for (i=0; i<LOOP; ++i) {
+	int len = pj_rand() % MAX_LEN, pos, r1, r2;
+
+	/* Caseless comparison: flip the case of some letters, and change
+	 * one character at random position.
+	 */
+	simd_random_str(buf1, len);
+	for (pos=0; pos<len; ++pos) {
+	    buf2[pos] = buf1[pos];
+	    if (pj_isalpha(buf2[pos]) && (pj_rand() & 1))
+		buf2[pos] ^= 0x20;
+	}
+	if (len && (pj_rand() & 1))
+	    buf2[pj_rand() % len] = (char)pj_rand();
+
+	s1.ptr = buf1; s1.slen = len;
+	s2.ptr = buf2; s2.slen = len;
+	r1 = pj_stricmp(&s1, &s2);
+	r2 = ref_memicmp(buf1, buf2, len);
+	if ((r1 < 0) != (r2 < 0) || (r1 > 0) != (r2 > 0))
+	    return -810;
+	if (pj_memicmp(buf1, buf2, len) != r2)
+	    return -820;
+
+	/* Substring search: needle is a piece of the haystack, or random */
+	s2.slen = len ? 1 + pj_rand() % (len < 20 ? len : 20) : 0;
+	if (pj_rand() & 1) {
+	    pos = pj_rand() % (len - s2.slen + 1);
+	    pj_memcpy(buf2, buf1 + pos, s2.slen);
+	    if (s2.slen)
+		buf2[0] ^= (pj_isalpha(buf2[0]) ? 0x20 : 0);
+	} else {
+	    simd_random_str(buf2, (int)s2.slen);
+	}
+
+	if (pj_strstr(&s1, &s2) != ref_strstr(&s1, &s2, PJ_FALSE))
+	    return -830;
+	if (pj_stristr(&s1, &s2) != ref_strstr(&s1, &s2, PJ_TRUE))
+	    return -840;
+    }
+
+    return 0;
+}
+
+/* Benchmark of the implementations with strings that are typical to SIP
+ * messages.
+ */
+static pj_uint32_t simd_bench(pj_uint32_t *stricmp_cycle,
+			      pj_uint32_t *stristr_cycle)
+{
+    enum { LOOP = 20000 };
+    static const char uri1[] = "sip:alice.longer-user-name@"
+			       "proxy01.Example.COM:5060;transport=TCP";
+    static const char uri2[] = "sip:Alice.Longer-User-Name@"
+			       "PROXY01.example.com:5060;TRANSPORT=tcp";
+    char msg[512];
+    pj_str_t s1, s2, hay, needle;
+    pj_timestamp t1, t2;
+    unsigned i;
+    int r = 0;
+
+    s1 = pj_str((char*)uri1);
+    s2 = pj_str((char*)uri2);
+
+    pj_memset(msg, 'x', sizeof(msg));
+    pj_memcpy(msg + sizeof(msg) - 12, "Call-ID: 123", 12);
+    hay.ptr = msg;
+    hay.slen = sizeof(msg);
+    needle = pj_str("call-id:");
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<LOOP; ++i)
+	r += pj_stricmp(&s1, &s2);
+    pj_get_timestamp(&t2);
+    *stricmp_cycle = pj_elapsed_cycle(&t1, &t2);
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<LOOP; ++i)
+	r += (pj_stristr(&hay, &needle) == NULL);
+    pj_get_timestamp(&t2);
+    *stristr_cycle = pj_elapsed_cycle(&t1, &t2);
+
+    return r;
+}
+
+/* This tests and benchmarks the SIMD implementations of pj_stricmp(),
+ * pj_memicmp(), pj_strstr() and pj_stristr() against the scalar ones.
+ */
+static int simd_test(void)
+{
+    static const char *names[] = { "scalar", "SSE2", "AVX2" };
+    pj_uint32_t stricmp_cycle[3], stristr_cycle[3];
+    int level, used, rc = 0;
+
+    for (level=PJ_STR_SIMD_NONE; level<=PJ_STR_SIMD_AVX2; ++level) {
+	used = pj_str_set_simd((pj_str_simd)level);
+	if (used != level) {
+	    PJ_LOG(3,("", "  info: %s string functions not available",
+		      names[level]));
+	    break;
+	}
+
+	rc = simd_check();
+	if (rc != 0) {
+	    PJ_LOG(3,("", "   error: %s string functions failed",
+		      names[level]));
+	    break;
+	}
+
+	if (simd_bench(&stricmp_cycle[level], &stristr_cycle[level]) != 0) {
+	    rc = -850;
+	    break;
+	}
+	if (stricmp_cycle[level] == 0) stricmp_cycle[level] = 1;
+	if (stristr_cycle[level] == 0) stristr_cycle[level] = 1;
+
+	PJ_LOG(3,("", "  time: %s: stricmp=%u, stristr=%u "
+		  "(speedup=%u.%02ux, %u.%02ux)",
+		  names[level], stricmp_cycle[level], stristr_cycle[level],
+		  stricmp_cycle[0] * 100 / stricmp_cycle[level] / 100,
+		  stricmp_cycle[0] * 100 / stricmp_cycle[level] % 100,
+		  stristr_cycle[0] * 100 / stristr_cycle[level] / 100,
+		  stristr_cycle[0] * 100 / stristr_cycle[level] % 100));
+    }
+
+    /* Back to the best implementation */
+    pj_str_set_simd(PJ_STR_SIMD_AVX2);
+    return rc;
+}
+
 int string_test(void)
 {
     const pj_str_t hello_world = { HELLO_WORLD, HELLO_WORLD_LEN };
@@ -426,6 +627,11 @@ int string_test(void)
     if (i != 0)
 	return i;
 
+    /* SIMD string functions test. */
+    i = simd_test();
+    if (i != 0)
+	return i;
+
     return 0;
 }
 
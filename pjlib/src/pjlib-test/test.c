@@ -107,6 +107,10 @@ int test_inner(void)
     DO_TEST( rbtree_test() );
 #endif
 
+#if INCLUDE_RINGBUF_TEST
+    DO_TEST( ringbuf_test() );
+#endif
+
 #if INCLUDE_HASH_TEST
     DO_TEST( hash_test() );
 #endif
@@ -135,6 +139,18 @@ int test_inner(void)
     DO_TEST( thread_test() );
 #endif
 
+#if INCLUDE_EXECUTOR_TEST
+    DO_TEST( executor_test() );
+#endif
+
+#if INCLUDE_LOG_TEST
+    DO_TEST( log_test() );
+#endif
+
+#if INCLUDE_TRACE_TEST
+    DO_TEST( trace_test() );
+#endif
+
 #if INCLUDE_SOCK_TEST
     DO_TEST( sock_test() );
 #endif
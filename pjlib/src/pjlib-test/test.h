@@ -43,12 +43,16 @@
 #define INCLUDE_STRING_TEST	    GROUP_DATA_STRUCTURE
 #define INCLUDE_FIFOBUF_TEST	    0	// GROUP_DATA_STRUCTURE
 #define INCLUDE_RBTREE_TEST	    GROUP_DATA_STRUCTURE
+#define INCLUDE_RINGBUF_TEST	    GROUP_DATA_STRUCTURE
 #define INCLUDE_TIMER_TEST	    GROUP_DATA_STRUCTURE
 #define INCLUDE_ATOMIC_TEST         GROUP_OS
 #define INCLUDE_MUTEX_TEST	    (PJ_HAS_THREADS && GROUP_OS)
 #define INCLUDE_SLEEP_TEST          GROUP_OS
 #define INCLUDE_OS_TEST             GROUP_OS
+#define INCLUDE_LOG_TEST	    (PJ_HAS_THREADS && GROUP_OS)
 #define INCLUDE_THREAD_TEST         (PJ_HAS_THREADS && GROUP_OS)
+#define INCLUDE_EXECUTOR_TEST	    (PJ_HAS_THREADS && GROUP_OS)
+#define INCLUDE_TRACE_TEST	    (PJ_HAS_THREADS && GROUP_OS)
 #define INCLUDE_SOCK_TEST	    GROUP_NETWORK
 #define INCLUDE_SOCK_PERF_TEST	    GROUP_NETWORK
 #define INCLUDE_SELECT_TEST	    GROUP_NETWORK
@@ -80,16 +84,20 @@ extern int rand_test(void);
 extern int list_test(void);
 extern int hash_test(void);
 extern int os_test(void);
+extern int log_test(void);
 extern int pool_test(void);
 extern int pool_perf_test(void);
 extern int string_test(void);
 extern int fifobuf_test(void);
 extern int timer_test(void);
 extern int rbtree_test(void);
+extern int ringbuf_test(void);
 extern int atomic_test(void);
 extern int mutex_test(void);
 extern int sleep_test(void);
 extern int thread_test(void);
+extern int executor_test(void);
+extern int trace_test(void);
 extern int sock_test(void);
 extern int sock_perf_test(void);
 extern int select_test(void);
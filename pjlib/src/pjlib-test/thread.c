@@ -30,6 +30,8 @@
  *  - whether multithreading works.
  *  - whether thread timeslicing works, and threads have equal
  *    time-slice proportion.
+ *  - whether the CPU affinity and scheduling policy can be set, when
+ *    the platform and the privilege allow it.
  *
  * APIs tested:
  *  - pj_thread_create()
@@ -41,6 +43,9 @@
  *  - pj_thread_sleep()
  *  - pj_thread_join()
  *  - pj_thread_destroy()
+ *  - pj_thread_set_affinity()
+ *  - pj_thread_set_sched()
+ *  - pj_thread_set_sched_param()
  *
  *
  * This file is <b>pjlib-test/thread.c</b>
@@ -308,6 +313,113 @@ static int timeslice_test(void)
     return 0;
 }
 
+/*
+ * The entry point of the thread for sched_test().
+ */
+static int idle_thread_proc(void *arg)
+{
+    PJ_UNUSED_ARG(arg);
+
+    while (!quit_flag)
+	pj_thread_sleep(10);
+
+    return 0;
+}
+
+/*
+ * sched_test()
+ */
+static int sched_test(void)
+{
+    pj_pool_t *pool;
+    pj_thread_t *thread;
+    pj_thread_sched_param param;
+    unsigned cpu = 0;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "..affinity and scheduling test"));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+	return -2000;
+
+    quit_flag = 0;
+
+    status = pj_thread_create(pool, "thread", &idle_thread_proc, NULL,
+			      PJ_THREAD_DEFAULT_STACK_SIZE, 0, &thread);
+    if (status != PJ_SUCCESS) {
+	app_perror("...error: unable to create thread", status);
+	pj_pool_release(pool);
+	return -2010;
+    }
+
+    /* The settings by default leave the thread untouched */
+    pj_thread_sched_param_default(&param);
+    status = pj_thread_set_sched_param(thread, &param);
+    if (status != PJ_SUCCESS) {
+	app_perror("...error: pj_thread_set_sched_param() error", status);
+	rc = -2020;
+	goto on_return;
+    }
+
+    /* CPU 0 may be excluded from the CPUs allowed for the process, so
+     * only the invalid argument error is fatal.
+     */
+    status = pj_thread_set_affinity(thread, &cpu, 1);
+    if (status == PJ_ENOTSUP) {
+	PJ_LOG(3,(THIS_FILE, "...info: thread affinity is not supported"));
+    } else if (status == PJ_EINVAL) {
+	app_perror("...error: pj_thread_set_affinity() error", status);
+	rc = -2030;
+	goto on_return;
+    } else if (status != PJ_SUCCESS) {
+	app_perror("...info: unable to bind thread to CPU 0", status);
+    }
+
+#if !defined(PJ_WIN32) || PJ_WIN32==0
+    /* Priority out of range */
+    status = pj_thread_set_sched(thread, PJ_THREAD_SCHED_FIFO, 100000);
+    if (status != PJ_EINVAL && status != PJ_ENOTSUP) {
+	PJ_LOG(3,(THIS_FILE, "...error: invalid priority is accepted"));
+	rc = -2040;
+	goto on_return;
+    }
+#endif
+
+    /* The real-time policies normally need privilege */
+    status = pj_thread_set_sched(thread, PJ_THREAD_SCHED_RR, 0);
+    if (status == PJ_ENOTSUP) {
+	PJ_LOG(3,(THIS_FILE, "...info: scheduling policy is not "
+			     "supported"));
+	goto on_return;
+    } else if (status == PJ_EINVAL) {
+	app_perror("...error: pj_thread_set_sched() error", status);
+	rc = -2050;
+	goto on_return;
+    } else if (status != PJ_SUCCESS) {
+	app_perror("...info: unable to set real-time policy", status);
+    }
+
+    /* Going back to the default policy is always allowed */
+    status = pj_thread_set_sched(thread, PJ_THREAD_SCHED_DEFAULT, 0);
+    if (status != PJ_SUCCESS) {
+	app_perror("...error: unable to set default policy", status);
+	rc = -2060;
+	goto on_return;
+    }
+
+on_return:
+    quit_flag = 1;
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+    pj_pool_release(pool);
+
+    if (rc == 0)
+	PJ_LOG(3,(THIS_FILE, "...affinity and scheduling test success"));
+    return rc;
+}
+
 int thread_test(void)
 {
     int rc;
@@ -324,6 +436,10 @@ int thread_test(void)
     if (rc != PJ_SUCCESS)
 	return rc;
 
+    rc = sched_test();
+    if (rc != PJ_SUCCESS)
+	return rc;
+
     return rc;
 }
 
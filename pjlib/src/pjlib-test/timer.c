@@ -23,7 +23,9 @@
  * \page page_pjlib_timer_test Test: Timer
  *
  * This file provides implementation of \b timer_test(). It tests the
- * functionality of the timer heap.
+ * functionality of the timer heap, and benchmarks the schedule, cancel
+ * and poll throughput of the timer heap backend with large number of
+ * entries.
  *
  *
  * This file is <b>pjlib-test/timer.c</b>
@@ -182,9 +184,455 @@ static int test_timer_heap(void)
 }
 
 
+/*
+ * Stress/benchmark test.
+ */
+static unsigned stress_fired;
+static unsigned stress_early;
+
+static void stress_callback(pj_timer_heap_t *ht, pj_timer_entry *e)
+{
+    pj_time_val now;
+
+    PJ_UNUSED_ARG(ht);
+
+    pj_gettickcount(&now);
+    if (PJ_TIME_VAL_LT(now, e->_timer_value))
+	++stress_early;
+    ++stress_fired;
+}
+
+/* Print number of operations per second */
+static void print_rate(const char *op, unsigned count, pj_uint32_t usec)
+{
+    if (usec == 0) usec = 1;
+    PJ_LOG(3,(THIS_FILE, "    %-7s: %8u usec, %9u op/sec",
+	      op, usec, (unsigned)((pj_uint64_t)count * 1000000 / usec)));
+}
+
+static int stress_test(unsigned count)
+{
+    pj_pool_t *pool;
+    pj_timer_heap_t *timer;
+    pj_timer_entry *entry;
+    pj_timestamp t1, t2;
+    pj_time_val delay;
+    pj_size_t size;
+    unsigned i, polled;
+    pj_status_t rc;
+    int err = 0;
+
+    PJ_LOG(3,(THIS_FILE, "...stress test with %u entries", count));
+
+    size = pj_timer_heap_mem_size(count) + count*sizeof(pj_timer_entry);
+    pool = pj_pool_create( mem, NULL, size + 4000, 4000, NULL);
+    if (!pool) {
+	PJ_LOG(3,(THIS_FILE, "...error: unable to create pool of %u bytes",
+		  size));
+	return -100;
+    }
+
+    entry = (pj_timer_entry*)pj_pool_calloc(pool, count, sizeof(*entry));
+    if (!entry) {
+	err = -110;
+	goto on_return;
+    }
+
+    for (i=0; i<count; ++i)
+	pj_timer_entry_init(&entry[i], 0, NULL, &stress_callback);
+
+    rc = pj_timer_heap_create(pool, count, &timer);
+    if (rc != PJ_SUCCESS) {
+        app_perror("...error: unable to create timer heap", rc);
+	err = -120;
+	goto on_return;
+    }
+
+    /* Schedule entries far in the future (60 to 120 seconds). */
+    pj_get_timestamp(&t1);
+    for (i=0; i<count; ++i) {
+	delay.sec = 60;
+	delay.msec = (i * 7919) % 60000;
+	pj_time_val_normalize(&delay);
+	rc = pj_timer_heap_schedule(timer, &entry[i], &delay);
+	if (rc != PJ_SUCCESS) {
+	    err = -130;
+	    goto on_return;
+	}
+    }
+    pj_get_timestamp(&t2);
+    print_rate("sched", count, pj_elapsed_usec(&t1, &t2));
+
+    if (pj_timer_heap_count(timer) != count) {
+	err = -140;
+	goto on_return;
+    }
+
+    /* Cancel them all */
+    pj_get_timestamp(&t1);
+    for (i=0; i<count; ++i) {
+	if (pj_timer_heap_cancel(timer, &entry[i]) != 1) {
+	    err = -150;
+	    goto on_return;
+	}
+    }
+    pj_get_timestamp(&t2);
+    print_rate("cancel", count, pj_elapsed_usec(&t1, &t2));
+
+    if (pj_timer_heap_count(timer) != 0) {
+	err = -160;
+	goto on_return;
+    }
+
+    /* Schedule entries to expire within 50 ms, wait until they all have
+     * expired, then measure how fast the poll processes them.
+     */
+    stress_fired = stress_early = 0;
+    for (i=0; i<count; ++i) {
+	delay.sec = 0;
+	delay.msec = (i * 7919) % 50;
+	rc = pj_timer_heap_schedule(timer, &entry[i], &delay);
+	if (rc != PJ_SUCCESS) {
+	    err = -170;
+	    goto on_return;
+	}
+    }
+
+    pj_thread_sleep(100);
+    pj_timer_heap_set_max_timed_out_per_poll(timer, count);
+
+    polled = 0;
+    pj_get_timestamp(&t1);
+    while (pj_timer_heap_count(timer) > 0 && polled < count) {
+	unsigned cnt = pj_timer_heap_poll(timer, NULL);
+	if (cnt == 0)
+	    break;
+	polled += cnt;
+    }
+    pj_get_timestamp(&t2);
+    print_rate("poll", count, pj_elapsed_usec(&t1, &t2));
+
+    if (stress_fired != count || pj_timer_heap_count(timer) != 0) {
+	PJ_LOG(3,(THIS_FILE, "...error: only %u of %u entries fired",
+		  stress_fired, count));
+	err = -180;
+	goto on_return;
+    }
+    if (stress_early) {
+	PJ_LOG(3,(THIS_FILE, "...error: %u entries fired early",
+		  stress_early));
+	err = -190;
+	goto on_return;
+    }
+
+    pj_timer_heap_destroy(timer);
+
+on_return:
+    pj_pool_release(pool);
+    return err;
+}
+
+/*
+ * Multithreaded test, with several threads scheduling, cancelling and
+ * polling a (sharded) timer heap concurrently.
+ */
+#define MT_THREAD_CNT	4
+#define MT_ENTRY_CNT	20000
+
+typedef struct mt_arg
+{
+    pj_timer_heap_t *ht;
+    pj_timer_entry  *entries;	/* entries of this thread */
+    pj_timer_entry  *other;	/* entries of the next thread */
+} mt_arg;
+
+static pj_atomic_t *mt_scheduled;
+static pj_atomic_t *mt_fired;
+static pj_atomic_t *mt_cancelled;
+static pj_atomic_t *mt_early;
+static pj_atomic_t *mt_quit;
+
+static void mt_callback(pj_timer_heap_t *ht, pj_timer_entry *e)
+{
+    pj_time_val now;
+
+    PJ_UNUSED_ARG(ht);
+
+    pj_gettickcount(&now);
+    if (PJ_TIME_VAL_LT(now, e->_timer_value))
+	pj_atomic_inc(mt_early);
+    pj_atomic_inc(mt_fired);
+}
+
+static int mt_thread(void *p)
+{
+    mt_arg *arg = (mt_arg*)p;
+    pj_time_val delay, start, now;
+    unsigned i;
+
+    for (i=0; i<MT_ENTRY_CNT; ++i) {
+	delay.sec = 0;
+	delay.msec = i % 20;
+	if (pj_timer_heap_schedule(arg->ht, &arg->entries[i], &delay) !=
+	    PJ_SUCCESS)
+	{
+	    return -10;
+	}
+    }
+
+    /* Wait until all threads have scheduled their entries, since an entry
+     * must not be scheduled and cancelled concurrently.
+     */
+    pj_atomic_inc(mt_scheduled);
+    while (pj_atomic_get(mt_scheduled) < MT_THREAD_CNT) {
+	if (pj_atomic_get(mt_quit))
+	    return -15;
+	pj_timer_heap_poll(arg->ht, NULL);
+	pj_thread_sleep(0);
+    }
+
+    /* Cancel some entries of the next thread, which are scheduled in
+     * another shard, and may have fired.
+     */
+    for (i=0; i<MT_ENTRY_CNT; i+=4) {
+	if (pj_timer_heap_cancel(arg->ht, &arg->other[i]) == 1)
+	    pj_atomic_inc(mt_cancelled);
+    }
+
+    /* Poll until all entries have been processed. */
+    pj_gettickcount(&start);
+    for (;;) {
+	pj_timer_heap_poll(arg->ht, NULL);
+
+	if (pj_atomic_get(mt_fired) + pj_atomic_get(mt_cancelled) ==
+	    MT_THREAD_CNT * MT_ENTRY_CNT)
+	{
+	    break;
+	}
+
+	pj_gettickcount(&now);
+	if (now.sec - start.sec > 10)
+	    return -20;
+
+	pj_thread_sleep(1);
+    }
+
+    return 0;
+}
+
+static int mt_test(unsigned shard_cnt)
+{
+    pj_pool_t *pool;
+    pj_timer_heap_t *ht;
+    pj_thread_t *threads[MT_THREAD_CNT];
+    mt_arg args[MT_THREAD_CNT];
+    pj_timestamp t1, t2;
+    unsigned i, thread_cnt;
+    pj_status_t rc;
+    int err = 0;
+
+    PJ_LOG(3,(THIS_FILE, "...multithreaded test with %d threads, %u shards",
+	      MT_THREAD_CNT, shard_cnt));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+
+    if (shard_cnt > 1) {
+	rc = pj_timer_heap_create_sharded(pool, MT_THREAD_CNT*MT_ENTRY_CNT,
+					  shard_cnt, &ht);
+    } else {
+	rc = pj_timer_heap_create(pool, MT_THREAD_CNT*MT_ENTRY_CNT, &ht);
+	if (rc == PJ_SUCCESS) {
+	    pj_lock_t *lock;
+
+	    rc = pj_lock_create_recursive_mutex(pool, NULL, &lock);
+	    if (rc == PJ_SUCCESS)
+		pj_timer_heap_set_lock(ht, lock, PJ_TRUE);
+	}
+    }
+    if (rc != PJ_SUCCESS) {
+	app_perror("...error: unable to create timer heap", rc);
+	pj_pool_release(pool);
+	return -200;
+    }
+
+    pj_atomic_create(pool, 0, &mt_scheduled);
+    pj_atomic_create(pool, 0, &mt_fired);
+    pj_atomic_create(pool, 0, &mt_cancelled);
+    pj_atomic_create(pool, 0, &mt_early);
+    pj_atomic_create(pool, 0, &mt_quit);
+
+    for (i=0; i<MT_THREAD_CNT; ++i) {
+	unsigned j;
+
+	args[i].ht = ht;
+	args[i].entries = (pj_timer_entry*)
+			  pj_pool_calloc(pool, MT_ENTRY_CNT,
+					 sizeof(pj_timer_entry));
+	for (j=0; j<MT_ENTRY_CNT; ++j)
+	    pj_timer_entry_init(&args[i].entries[j], 0, NULL, &mt_callback);
+    }
+    for (i=0; i<MT_THREAD_CNT; ++i)
+	args[i].other = args[(i+1) % MT_THREAD_CNT].entries;
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<MT_THREAD_CNT; ++i) {
+	rc = pj_thread_create(pool, "timermt", &mt_thread, &args[i], 0, 0,
+			      &threads[i]);
+	if (rc != PJ_SUCCESS) {
+	    app_perror("...error: unable to create thread", rc);
+	    err = -210;
+	    break;
+	}
+    }
+
+    /* Threads that have been started would wait forever for the others
+     * if some failed to start, so tell them to quit.
+     */
+    if (err)
+	pj_atomic_set(mt_quit, 1);
+
+    thread_cnt = i;
+    for (i=0; i<thread_cnt; ++i) {
+	pj_thread_join(threads[i]);
+	pj_thread_destroy(threads[i]);
+    }
+    pj_get_timestamp(&t2);
+
+    if (err)
+	goto on_return;
+
+    PJ_LOG(3,(THIS_FILE, "    %u fired, %u cancelled, elapsed %u usec",
+	      (unsigned)pj_atomic_get(mt_fired),
+	      (unsigned)pj_atomic_get(mt_cancelled),
+	      pj_elapsed_usec(&t1, &t2)));
+
+    if (pj_atomic_get(mt_fired) + pj_atomic_get(mt_cancelled) !=
+	MT_THREAD_CNT * MT_ENTRY_CNT || pj_timer_heap_count(ht) != 0)
+    {
+	PJ_LOG(3,(THIS_FILE, "...error: not all entries are processed"));
+	err = -220;
+    } else if (pj_atomic_get(mt_early)) {
+	PJ_LOG(3,(THIS_FILE, "...error: %u entries fired early",
+		  (unsigned)pj_atomic_get(mt_early)));
+	err = -230;
+    }
+
+on_return:
+    pj_timer_heap_destroy(ht);
+    pj_atomic_destroy(mt_scheduled);
+    pj_atomic_destroy(mt_fired);
+    pj_atomic_destroy(mt_cancelled);
+    pj_atomic_destroy(mt_early);
+    pj_atomic_destroy(mt_quit);
+    pj_pool_release(pool);
+    return err;
+}
+
+static pj_bool_t idle_fired;
+
+static void idle_callback(pj_timer_heap_t *ht, pj_timer_entry *e)
+{
+    PJ_UNUSED_ARG(ht);
+    PJ_UNUSED_ARG(e);
+    idle_fired = PJ_TRUE;
+}
+
+static int idle_poll_thread(void *p)
+{
+    pj_timer_heap_t *ht = (pj_timer_heap_t*)p;
+    unsigned i;
+
+    for (i=0; i<PJ_TIMER_SHARD_IDLE_TIMEOUT * 4 && !idle_fired; ++i) {
+	pj_timer_heap_poll(ht, NULL);
+	pj_thread_sleep(1);
+    }
+    return 0;
+}
+
+/* A shard whose owner thread stops polling must be polled by the other
+ * threads.
+ */
+static int idle_shard_test(void)
+{
+    pj_pool_t *pool;
+    pj_timer_heap_t *ht;
+    pj_timer_entry entry;
+    pj_thread_t *thread;
+    pj_time_val delay = { 0, 0 };
+    pj_status_t rc;
+    int err = 0;
+
+    PJ_LOG(3,(THIS_FILE, "...idle shard test"));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    rc = pj_timer_heap_create_sharded(pool, 16, 2, &ht);
+    if (rc != PJ_SUCCESS) {
+	app_perror("...error: unable to create timer heap", rc);
+	pj_pool_release(pool);
+	return -300;
+    }
+
+    /* Bind this thread to a shard, schedule to it, then stop polling */
+    idle_fired = PJ_FALSE;
+    pj_timer_heap_poll(ht, NULL);
+    pj_timer_entry_init(&entry, 0, NULL, &idle_callback);
+    pj_timer_heap_schedule(ht, &entry, &delay);
+
+    rc = pj_thread_create(pool, "timeridle", &idle_poll_thread, ht, 0, 0,
+			  &thread);
+    if (rc != PJ_SUCCESS) {
+	app_perror("...error: unable to create thread", rc);
+	err = -310;
+	goto on_return;
+    }
+    pj_thread_join(thread);
+    pj_thread_destroy(thread);
+
+    if (!idle_fired) {
+	PJ_LOG(3,(THIS_FILE, "...error: timer in idle shard is not fired"));
+	err = -320;
+    }
+
+on_return:
+    pj_timer_heap_cancel(ht, &entry);
+    pj_timer_heap_destroy(ht);
+    pj_pool_release(pool);
+    return err;
+}
+
 int timer_test()
 {
-    return test_timer_heap();
+    static const unsigned stress_counts[] = { 10000, 100000, 1000000 };
+    unsigned i;
+    int rc;
+
+    rc = test_timer_heap();
+    if (rc != 0)
+	return rc;
+
+    PJ_LOG(3,(THIS_FILE, "...timer heap benchmark (implementation=%s)",
+	      (PJ_TIMER_HEAP_IMPLEMENTATION==PJ_TIMER_HEAP_WHEEL ?
+		  "timing wheel" : "binary heap")));
+
+    for (i=0; i<PJ_ARRAY_SIZE(stress_counts); ++i) {
+	rc = stress_test(stress_counts[i]);
+	if (rc != 0)
+	    return rc;
+    }
+
+    rc = mt_test(1);
+    if (rc != 0)
+	return rc;
+
+    rc = mt_test(MT_THREAD_CNT);
+    if (rc != 0)
+	return rc;
+
+    rc = idle_shard_test();
+    if (rc != 0)
+	return rc;
+
+    return 0;
 }
 
 #else
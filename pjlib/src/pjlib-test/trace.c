@@ -0,0 +1,283 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+/**
+ * \page page_pjlib_trace_test Test: Tracing
+ *
+ * This file provides implementation of \b trace_test(). It tests the
+ * tracing facility:
+ *  - events from several threads are written to the Chrome trace event
+ *    format, with the thread names.
+ *  - the oldest events are overwritten when the ring buffer is full.
+ *  - no event is recorded after the tracing is stopped.
+ *  - the cost of recording an event.
+ *
+ *
+ * This file is <b>pjlib-test/trace.c</b>
+ *
+ * \include pjlib-test/trace.c
+ */
+
+#if INCLUDE_TRACE_TEST
+
+#include <pjlib.h>
+
+#define THIS_FILE	"trace.c"
+#define TRACE_FILE	"trace-test.json"
+#define WORKER_CNT	2
+#define LOOP_CNT	10
+#define FLOOD_CNT	100000
+#define BENCH_CNT	1000000
+
+/* Count the occurrences of str in buf */
+static unsigned count_str(const char *buf, const char *str)
+{
+    unsigned cnt = 0;
+
+    while ((buf = pj_ansi_strstr(buf, str)) != NULL) {
+	++cnt;
+	buf += pj_ansi_strlen(str);
+    }
+    return cnt;
+}
+
+/* Read the dumped trace file into a NULL terminated buffer */
+static char *read_dump(pj_pool_t *pool)
+{
+    pj_oshandle_t fd;
+    pj_off_t size;
+    pj_ssize_t len;
+    char *buf;
+
+    size = pj_file_size(TRACE_FILE);
+    if (size <= 0)
+	return NULL;
+
+    if (pj_file_open(pool, TRACE_FILE, PJ_O_RDONLY, &fd) != PJ_SUCCESS)
+	return NULL;
+
+    buf = (char*) pj_pool_alloc(pool, (pj_size_t)size + 1);
+    len = (pj_ssize_t)size;
+    if (pj_file_read(fd, buf, &len) != PJ_SUCCESS)
+	len = 0;
+    buf[len] = '\0';
+    pj_file_close(fd);
+
+    return buf;
+}
+
+static int worker_thread(void *arg)
+{
+    unsigned i;
+
+    PJ_UNUSED_ARG(arg);
+
+    for (i=0; i<LOOP_CNT; ++i) {
+	pj_trace_event("test", "worker_loop", PJ_TRACE_PHASE_BEGIN);
+	pj_trace_event("test", "worker_tick", PJ_TRACE_PHASE_INSTANT);
+	pj_trace_event("test", "worker_loop", PJ_TRACE_PHASE_END);
+    }
+    return 0;
+}
+
+static int flood_thread(void *arg)
+{
+    unsigned i;
+
+    PJ_UNUSED_ARG(arg);
+
+    for (i=0; i<FLOOD_CNT; ++i)
+	pj_trace_event("test", "flood", PJ_TRACE_PHASE_INSTANT);
+    return 0;
+}
+
+static int run_threads(pj_pool_t *pool, pj_thread_proc *proc, unsigned cnt)
+{
+    pj_thread_t *thread[WORKER_CNT];
+    unsigned i;
+
+    for (i=0; i<cnt; ++i) {
+	if (pj_thread_create(pool, "tracer%p", proc, NULL, 0, 0,
+			     &thread[i]) != PJ_SUCCESS)
+	{
+	    return -1;
+	}
+    }
+    for (i=0; i<cnt; ++i) {
+	pj_thread_join(thread[i]);
+	pj_thread_destroy(thread[i]);
+    }
+    return 0;
+}
+
+static int dump_test(pj_pool_t *pool)
+{
+    char *buf;
+    unsigned cnt;
+
+    PJ_LOG(3,(THIS_FILE, "  dump test.."));
+
+    pj_trace_stop();
+    pj_trace_clear();
+    if (pj_trace_start(0) != PJ_SUCCESS)
+	return -10;
+
+    pj_trace_event("test", "main \"quoted\"", PJ_TRACE_PHASE_BEGIN);
+    if (run_threads(pool, &worker_thread, WORKER_CNT) != 0)
+	return -20;
+    pj_trace_event("test", "main \"quoted\"", PJ_TRACE_PHASE_END);
+
+    pj_trace_stop();
+
+    /* Not recorded */
+    pj_trace_event("test", "after_stop", PJ_TRACE_PHASE_INSTANT);
+
+    if (pj_trace_dump(TRACE_FILE) != PJ_SUCCESS)
+	return -30;
+
+    buf = read_dump(pool);
+    if (!buf)
+	return -40;
+
+    if (pj_ansi_strncmp(buf, "{\"traceEvents\":[", 16) != 0 ||
+	pj_ansi_strstr(buf, "\n]") == NULL)
+    {
+	return -50;
+    }
+
+    cnt = count_str(buf, "\"name\":\"worker_loop\"");
+    if (cnt != WORKER_CNT * LOOP_CNT * 2)
+	return -60;
+    cnt = count_str(buf, "\"name\":\"worker_tick\"");
+    if (cnt != WORKER_CNT * LOOP_CNT)
+	return -61;
+    if (count_str(buf, "\"ph\":\"i\"") != cnt)
+	return -62;
+    if (count_str(buf, "\"name\":\"main \\\"quoted\\\"\"") != 2)
+	return -63;
+    if (count_str(buf, "after_stop") != 0)
+	return -64;
+
+    /* Main thread and the workers */
+    if (count_str(buf, "\"name\":\"thread_name\"") < WORKER_CNT + 1 ||
+	count_str(buf, "\"args\":{\"name\":\"tracer") != WORKER_CNT)
+    {
+	return -65;
+    }
+
+    return 0;
+}
+
+static int overflow_test(pj_pool_t *pool)
+{
+    char *buf;
+    unsigned cnt;
+
+    PJ_LOG(3,(THIS_FILE, "  overflow test.."));
+
+    pj_trace_clear();
+    pj_trace_start(0);
+
+    if (run_threads(pool, &flood_thread, 1) != 0)
+	return -110;
+
+    pj_trace_stop();
+
+    if (pj_trace_dump(TRACE_FILE) != PJ_SUCCESS)
+	return -120;
+
+    buf = read_dump(pool);
+    if (!buf)
+	return -130;
+
+    /* Only the most recent events of the thread are kept */
+    cnt = count_str(buf, "\"name\":\"flood\"");
+    if (cnt == 0 || cnt >= FLOOD_CNT)
+	return -140;
+    PJ_LOG(3,(THIS_FILE, "   %u of %u events kept", cnt, FLOOD_CNT));
+
+    /* The earlier events are gone */
+    if (count_str(buf, "worker_loop") != 0)
+	return -150;
+
+    return 0;
+}
+
+static void benchmark(void)
+{
+    pj_timestamp t0, t1;
+    unsigned i;
+
+    pj_trace_clear();
+    pj_trace_start(0);
+
+    pj_get_timestamp(&t0);
+    for (i=0; i<BENCH_CNT; ++i)
+	pj_trace_event("test", "bench", PJ_TRACE_PHASE_INSTANT);
+    pj_get_timestamp(&t1);
+
+    pj_trace_stop();
+    pj_trace_clear();
+
+    PJ_LOG(3,(THIS_FILE, "  recording an event takes %u nsec",
+	      (unsigned)(pj_elapsed_usec(&t0, &t1) * 1000.0 / BENCH_CNT)));
+}
+
+int trace_test(void)
+{
+    pj_pool_t *pool;
+    int rc;
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+	return -1;
+
+    if (pj_trace_start(0) == PJ_ENOTSUP) {
+	PJ_LOG(3,(THIS_FILE, "  tracing is not supported, skipped"));
+	pj_pool_release(pool);
+	return 0;
+    }
+
+    /* The ring buffers are only allocated once */
+    if (pj_trace_start(PJ_TRACE_RING_SIZE) != PJ_SUCCESS)
+	rc = -2;
+    else if (pj_trace_start(PJ_TRACE_RING_SIZE * 2) != PJ_EINVALIDOP)
+	rc = -3;
+    else
+	rc = dump_test(pool);
+    if (rc == 0)
+	rc = overflow_test(pool);
+    if (rc == 0)
+	benchmark();
+
+    pj_trace_stop();
+    pj_trace_clear();
+    pj_file_delete(TRACE_FILE);
+    pj_pool_release(pool);
+    return rc;
+}
+
+#else
+/* To prevent warning about "translation unit is empty"
+ * when this test is disabled.
+ */
+int dummy_trace_test;
+#endif	/* INCLUDE_TRACE_TEST */
@@ -25,6 +25,7 @@
  * @brief Media clock.
  */
 #include <pjmedia/types.h>
+#include <pj/os.h>
 
 
 /**
@@ -260,6 +261,26 @@ PJ_DECL(pj_status_t) pjmedia_clock_create2(pj_pool_t *pool,
 					   void *user_data,
 					   pjmedia_clock **p_clock);
 
+/**
+ * Set the CPU affinity and scheduling policy of the clock's worker thread,
+ * e.g. to pin the thread that drives the audio frames to its own CPU. The
+ * settings are applied when the thread is started, or immediately if the
+ * thread is already running. They are applied after the thread priority
+ * has been raised, unless PJMEDIA_CLOCK_NO_HIGHEST_PRIO is set. This has
+ * no effect for clock created with PJMEDIA_CLOCK_NO_ASYNC.
+ *
+ * @param clock		    The media clock.
+ * @param param		    The thread settings.
+ *
+ * @return		    PJ_SUCCESS on success, or the error code if the
+ *			    settings failed to be applied to the running
+ *			    thread.
+ */
+PJ_DECL(pj_status_t) pjmedia_clock_set_thread_sched(
+					pjmedia_clock *clock,
+					const pj_thread_sched_param *param);
+
+
 /**
  * Start the clock. For clock created with asynchronous flag set to TRUE,
  * this may start a worker thread for the clock (depending on the 
@@ -401,6 +401,19 @@
 #endif
 
 
+/**
+ * Maximum number of RTP packets to be read at once by the UDP media
+ * transport when the PJMEDIA_UDP_RX_BATCH option is specified. The
+ * transport will allocate (PJMEDIA_TRANSPORT_UDP_RX_BATCH - 1) extra
+ * receive buffers of PJMEDIA_MAX_MRU size each.
+ *
+ * Default: 8
+ */
+#ifndef PJMEDIA_TRANSPORT_UDP_RX_BATCH
+#  define PJMEDIA_TRANSPORT_UDP_RX_BATCH		8
+#endif
+
+
 /**
  * DTMF/telephone-event duration, in timestamp.
  */
@@ -464,6 +477,21 @@
 #endif
 
 
+/**
+ * Specify whether RTCP takes the arrival time of RTP packets for the
+ * jitter calculation from pj_gettickcount_coarse(), which doesn't read
+ * the clock for every packet while the ioqueue is dispatching, instead of
+ * from pj_get_timestamp(). The arrival time then has a resolution of one
+ * millisecond, and packets received in the same ioqueue poll get the
+ * same arrival time.
+ *
+ * Default: 1 (yes).
+ */
+#ifndef PJMEDIA_RTCP_COARSE_ARRIVAL_TIME
+#   define PJMEDIA_RTCP_COARSE_ARRIVAL_TIME	1
+#endif
+
+
 /**
  * Specify whether RTCP statistics includes raw jitter statistics.
  * Raw jitter is defined as absolute value of network transit time
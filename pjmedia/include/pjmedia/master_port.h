@@ -26,6 +26,7 @@
  * @brief Master port.
  */
 #include <pjmedia/port.h>
+#include <pj/os.h>
 
 /**
  * @defgroup PJMEDIA_MASTER_PORT Master Port
@@ -85,6 +86,20 @@ PJ_DECL(pj_status_t) pjmedia_master_port_create(pj_pool_t *pool,
 						pjmedia_master_port **p_m);
 
 
+/**
+ * Set the CPU affinity and scheduling policy of the thread that drives
+ * the media flow, see #pjmedia_clock_set_thread_sched().
+ *
+ * @param m		The master port.
+ * @param param		The thread settings.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjmedia_master_port_set_thread_sched(
+					pjmedia_master_port *m,
+					const pj_thread_sched_param *param);
+
+
 /**
  * Start the media flow.
  *
@@ -96,6 +96,15 @@ typedef struct pjmedia_snd_port_param
      */
     unsigned ec_options;
 
+    /**
+     * CPU affinity and scheduling policy of the sound device threads,
+     * which are applied by the sound port on the first callback in each
+     * thread.
+     *
+     * Default: the threads are left untouched.
+     */
+    pj_thread_sched_param thread_sched;
+
 } pjmedia_snd_port_param;
 
 /**
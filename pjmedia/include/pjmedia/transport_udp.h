@@ -56,7 +56,17 @@ enum pjmedia_transport_udp_options
      * received.
      * Specifying this option will disable this feature.
      */
-    PJMEDIA_UDP_NO_SRC_ADDR_CHECKING = 1
+    PJMEDIA_UDP_NO_SRC_ADDR_CHECKING = 1,
+
+    /**
+     * Read incoming RTP packets in batches. When this option is specified,
+     * every time the ioqueue reports an incoming RTP packet, the UDP
+     * transport will also read up to (PJMEDIA_TRANSPORT_UDP_RX_BATCH - 1)
+     * more packets that are already queued in the socket with a single
+     * call to #pj_sock_recvmmsg(), instead of reading them one by one
+     * with the ioqueue.
+     */
+    PJMEDIA_UDP_RX_BATCH = 2
 };
 
 
@@ -21,11 +21,14 @@
 #include <pjmedia/errno.h>
 #include <pj/assert.h>
 #include <pj/lock.h>
+#include <pj/log.h>
 #include <pj/os.h>
 #include <pj/pool.h>
 #include <pj/string.h>
 #include <pj/compat/high_precision.h>
 
+#define THIS_FILE   "clock_thread.c"
+
 /* API: Init clock source */
 PJ_DEF(pj_status_t) pjmedia_clock_src_init( pjmedia_clock_src *clocksrc,
                                             pjmedia_type media_type,
@@ -120,6 +123,7 @@ struct pjmedia_clock
     pjmedia_clock_callback  *cb;
     void		    *user_data;
     pj_thread_t		    *thread;
+    pj_thread_sched_param    thread_sched;
     pj_bool_t		     running;
     pj_bool_t		     quitting;
     pj_lock_t		    *lock;
@@ -184,6 +188,7 @@ PJ_DEF(pj_status_t) pjmedia_clock_create2(pj_pool_t *pool,
     clock->cb = cb;
     clock->user_data = user_data;
     clock->thread = NULL;
+    pj_thread_sched_param_default(&clock->thread_sched);
     clock->running = PJ_FALSE;
     clock->quitting = PJ_FALSE;
     
@@ -198,6 +203,24 @@ PJ_DEF(pj_status_t) pjmedia_clock_create2(pj_pool_t *pool,
 }
 
 
+/*
+ * Set the CPU affinity and scheduling policy of the clock thread.
+ */
+PJ_DEF(pj_status_t) pjmedia_clock_set_thread_sched(
+					pjmedia_clock *clock,
+					const pj_thread_sched_param *param)
+{
+    PJ_ASSERT_RETURN(clock && param, PJ_EINVAL);
+
+    pj_memcpy(&clock->thread_sched, param, sizeof(*param));
+
+    if (clock->thread)
+	return pj_thread_set_sched_param(clock->thread, param);
+
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Start the clock. 
  */
@@ -348,6 +371,20 @@ static int clock_thread(void *arg)
 	    pj_thread_set_prio(pj_thread_this(), max);
     }
 
+    /* Apply the CPU affinity and scheduling policy, if set. */
+    if (clock->thread_sched.use_affinity ||
+	clock->thread_sched.policy != PJ_THREAD_SCHED_DEFAULT)
+    {
+	pj_status_t status;
+
+	status = pj_thread_set_sched_param(pj_thread_this(),
+					   &clock->thread_sched);
+	if (status != PJ_SUCCESS) {
+	    PJ_PERROR(3,(THIS_FILE, status,
+			 "Unable to set clock thread affinity/scheduling"));
+	}
+    }
+
     /* Get the first tick */
     pj_get_timestamp(&clock->next_tick);
     clock->next_tick.u64 += clock->interval.u64;
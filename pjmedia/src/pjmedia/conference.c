@@ -31,6 +31,7 @@
 #include <pj/log.h>
 #include <pj/pool.h>
 #include <pj/string.h>
+#include <pj/trace.h>
 
 #if !defined(PJMEDIA_CONF_USE_SWITCH_BOARD) || PJMEDIA_CONF_USE_SWITCH_BOARD==0
 
@@ -1789,6 +1790,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
     pj_int16_t *p_in;
     
     TRACE_((THIS_FILE, "- clock -"));
+    PJ_TRACE_BEGIN("media", "conf_tick");
 
     /* Check that correct size is specified. */
     pj_assert(frame->size == conf->samples_per_frame *
@@ -1823,6 +1825,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
     /* Get frames from all ports, and "mix" the signal 
      * to mix_buf of all listeners of the port.
      */
+    PJ_TRACE_BEGIN("media", "conf_mix");
     for (i=0, ci=0; i < conf->max_ports && ci < conf->port_cnt; ++i) {
 	struct conf_port *conf_port = conf->ports[i];
 	pj_int32_t level = 0;
@@ -1980,10 +1983,12 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 	    }
 	} /* loop the listeners of conf port */
     } /* loop of all conf ports */
+    PJ_TRACE_END("media", "conf_mix");
 
     /* Time for all ports to transmit whetever they have in their
      * buffer. 
      */
+    PJ_TRACE_BEGIN("media", "conf_transmit");
     for (i=0, ci=0; i<conf->max_ports && ci<conf->port_cnt; ++i) {
 	struct conf_port *conf_port = conf->ports[i];
 	pjmedia_frame_type frm_type;
@@ -2020,6 +2025,7 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 	if (i == 0)
 	    speaker_frame_type = frm_type;
     }
+    PJ_TRACE_END("media", "conf_transmit");
 
     /* Return sound playback frame. */
     if (conf->ports[0]->tx_level) {
@@ -2045,6 +2051,8 @@ static pj_status_t get_frame(pjmedia_port *this_port,
 	fwrite(frame->buf, frame->size, 1, fhnd_rec);
 #endif
 
+    PJ_TRACE_END("media", "conf_tick");
+
     return PJ_SUCCESS;
 }
 
@@ -23,6 +23,7 @@
 #include <pj/log.h>
 #include <pj/os.h>
 #include <pj/pool.h>
+#include <pj/ringbuf.h>
 #include <pj/string.h>
 
 #define THIS_FILE	"event.c"
@@ -54,7 +55,8 @@ struct pjmedia_event_mgr
     pj_bool_t       is_quitting;
     pj_sem_t       *sem;
     pj_mutex_t     *mutex;
-    event_queue     ev_queue;
+    pj_ringbuf_t   *post_queue;         /**< posted events, lock-free.  */
+    pj_atomic_t    *post_pending;       /**< posts since worker wakeup. */
     event_queue    *pub_ev_queue;       /**< publish() event queue.     */
     esub            esub_list;          /**< list of subscribers.       */
     esub            free_esub_list;     /**< list of subscribers.       */
@@ -64,18 +66,22 @@ struct pjmedia_event_mgr
 
 static pjmedia_event_mgr *event_manager_instance;
 
+static void event_lost(pjmedia_event *event)
+{
+    char ev_name[5];
+
+    PJ_LOG(4, (THIS_FILE, "Lost event %s from publisher [0x%p] "
+                          "due to full queue.",
+                          pjmedia_fourcc_name(event->type, ev_name),
+                          event->epub));
+}
+
 static pj_status_t event_queue_add_event(event_queue* ev_queue,
                                          pjmedia_event *event)
 {
     if (ev_queue->is_full) {
-        char ev_name[5];
-
         /* This event will be ignored. */
-        PJ_LOG(4, (THIS_FILE, "Lost event %s from publisher [0x%p] "
-                              "due to full queue.",
-                              pjmedia_fourcc_name(event->type, ev_name),
-                              event->epub));
-
+        event_lost(event);
         return PJ_ETOOMANY;
     }
 
@@ -88,13 +94,12 @@ static pj_status_t event_queue_add_event(event_queue* ev_queue,
 }
 
 static pj_status_t event_mgr_distribute_events(pjmedia_event_mgr *mgr,
-                                               event_queue *ev_queue,
+                                               pjmedia_event *ev,
                                                esub **next_sub,
                                                pj_bool_t rls_lock)
 {
     pj_status_t err = PJ_SUCCESS;
     esub * sub = mgr->esub_list.next;
-    pjmedia_event *ev = &ev_queue->events[ev_queue->head];
 
     while (sub != &mgr->esub_list) {
         *next_sub = sub->next;
@@ -121,9 +126,6 @@ static pj_status_t event_mgr_distribute_events(pjmedia_event_mgr *mgr,
     }
     *next_sub = NULL;
 
-    ev_queue->head = (ev_queue->head + 1) % MAX_EVENTS;
-    ev_queue->is_full = PJ_FALSE;
-
     return err;
 }
 
@@ -133,16 +135,26 @@ static int event_worker_thread(void *arg)
     pjmedia_event_mgr *mgr = (pjmedia_event_mgr *)arg;
 
     while (1) {
+        pjmedia_event ev;
+
 	/* Wait until there is an event. */
         pj_sem_wait(mgr->sem);
 
         if (mgr->is_quitting)
             break;
 
-        pj_mutex_lock(mgr->mutex);
-        event_mgr_distribute_events(mgr, &mgr->ev_queue,
-                                    &mgr->th_next_sub, PJ_TRUE);
-        pj_mutex_unlock(mgr->mutex);
+	/* Only the first post after this point wakes the worker up again,
+	 * and the events posted until then are picked up by the loop below.
+	 * A producer may not have finished publishing the event that its
+	 * post was for, and it would then be picked up with the next post.
+	 */
+        pj_atomic_set(mgr->post_pending, 0);
+        while (pj_ringbuf_pop(mgr->post_queue, &ev) == PJ_SUCCESS) {
+            pj_mutex_lock(mgr->mutex);
+            event_mgr_distribute_events(mgr, &ev, &mgr->th_next_sub,
+                                        PJ_TRUE);
+            pj_mutex_unlock(mgr->mutex);
+        }
     }
 
     return 0;
@@ -160,6 +172,18 @@ PJ_DEF(pj_status_t) pjmedia_event_mgr_create(pj_pool_t *pool,
     pj_list_init(&mgr->esub_list);
     pj_list_init(&mgr->free_esub_list);
 
+    /* Posted events are handed to the worker thread without the mutex,
+     * as they may come from the media threads.
+     */
+    status = pj_ringbuf_create(mgr->pool, sizeof(pjmedia_event), MAX_EVENTS,
+                               PJ_RINGBUF_MULTI_PRODUCER, &mgr->post_queue);
+    if (status != PJ_SUCCESS)
+        return status;
+
+    status = pj_atomic_create(mgr->pool, 0, &mgr->post_pending);
+    if (status != PJ_SUCCESS)
+        return status;
+
     if (!(options & PJMEDIA_EVENT_MGR_NO_THREAD)) {
         status = pj_sem_create(mgr->pool, "ev_sem", 0, MAX_EVENTS + 1,
                                &mgr->sem);
@@ -221,6 +245,16 @@ PJ_DEF(void) pjmedia_event_mgr_destroy(pjmedia_event_mgr *mgr)
         mgr->mutex = NULL;
     }
 
+    if (mgr->post_queue) {
+        pj_ringbuf_destroy(mgr->post_queue);
+        mgr->post_queue = NULL;
+    }
+
+    if (mgr->post_pending) {
+        pj_atomic_destroy(mgr->post_pending);
+        mgr->post_pending = NULL;
+    }
+
     if (mgr->pool)
         pj_pool_release(mgr->pool);
 
@@ -337,11 +371,17 @@ PJ_DEF(pj_status_t) pjmedia_event_publish( pjmedia_event_mgr *mgr,
 
     event->epub = epub;
 
-    pj_mutex_lock(mgr->mutex);
     if (flag & PJMEDIA_EVENT_PUBLISH_POST_EVENT) {
-        if (event_queue_add_event(&mgr->ev_queue, event) == PJ_SUCCESS)
+        /* Posting doesn't need the mutex. The worker drains the queue on
+         * each wakeup, so the semaphore is only posted once until then.
+         */
+        if (pj_ringbuf_push(mgr->post_queue, event) != PJ_SUCCESS)
+            event_lost(event);
+        else if (pj_atomic_inc_and_get(mgr->post_pending) == 1)
             pj_sem_post(mgr->sem);
     } else {
+        pj_mutex_lock(mgr->mutex);
+
         /* For nested pjmedia_event_publish() calls, i.e. calling publish()
          * inside the subscriber's callback, the function will only add
          * the event to the event queue of the first publish() call. It
@@ -361,17 +401,21 @@ PJ_DEF(pj_status_t) pjmedia_event_publish( pjmedia_event_mgr *mgr,
             event_queue_add_event(mgr->pub_ev_queue, event);
 
             do {
-                status = event_mgr_distribute_events(mgr, mgr->pub_ev_queue,
-                                                     &mgr->pub_next_sub,
-                                                     PJ_FALSE);
+                status = event_mgr_distribute_events(
+                             mgr, &ev_queue.events[ev_queue.head],
+                             &mgr->pub_next_sub, PJ_FALSE);
                 if (status != PJ_SUCCESS && err == PJ_SUCCESS)
 	            err = status;
+
+                ev_queue.head = (ev_queue.head + 1) % MAX_EVENTS;
+                ev_queue.is_full = PJ_FALSE;
             } while(ev_queue.head != ev_queue.tail || ev_queue.is_full);
 
             mgr->pub_ev_queue = NULL;
         }
+
+        pj_mutex_unlock(mgr->mutex);
     }
-    pj_mutex_unlock(mgr->mutex);
 
     return err;
 }
@@ -127,6 +127,19 @@ PJ_DEF(pj_status_t) pjmedia_master_port_create( pj_pool_t *pool,
 }
 
 
+/*
+ * Set the CPU affinity and scheduling policy of the clock thread.
+ */
+PJ_DEF(pj_status_t) pjmedia_master_port_set_thread_sched(
+					pjmedia_master_port *m,
+					const pj_thread_sched_param *param)
+{
+    PJ_ASSERT_RETURN(m && m->clock && param, PJ_EINVAL);
+
+    return pjmedia_clock_set_thread_sched(m->clock, param);
+}
+
+
 /*
  * Start the media flow.
  */
@@ -363,8 +363,16 @@ PJ_DEF(void) pjmedia_rtcp_rx_rtp2(pjmedia_rtcp_session *sess,
      */
     if (seq_st.diff == 1 && rtp_ts != sess->rtp_last_ts) {
 	/* Get arrival time and convert timestamp to samples */
+#if PJMEDIA_RTCP_COARSE_ARRIVAL_TIME
+	pj_time_val now;
+
+	pj_gettickcount_coarse(&now);
+	ts.u64 = ((pj_uint64_t)now.sec * 1000 + now.msec) *
+		 sess->clock_rate / 1000;
+#else
 	pj_get_timestamp(&ts);
 	ts.u64 = ts.u64 * sess->clock_rate / sess->ts_freq.u64;
+#endif
 	arrival = ts.u32.lo;
 
 	transit = arrival - rtp_ts;
@@ -53,6 +53,9 @@ struct pjmedia_snd_port
     unsigned		 bits_per_sample;
     unsigned		 options;
     unsigned		 prm_ec_options;
+    pj_thread_sched_param thread_sched;
+    pj_bool_t		 play_sched_done;
+    pj_bool_t		 rec_sched_done;
 
     /* software ec */
     pjmedia_echo_state	*ec_state;
@@ -63,6 +66,32 @@ struct pjmedia_snd_port
     unsigned		 ec_suspend_limit;
 };
 
+/*
+ * Apply the CPU affinity and scheduling policy to the calling sound
+ * device thread, once per stream direction.
+ */
+static void apply_thread_sched(pjmedia_snd_port *snd_port, pj_bool_t *done)
+{
+    pj_status_t status;
+
+    if (*done)
+	return;
+
+    *done = PJ_TRUE;
+    if (!snd_port->thread_sched.use_affinity &&
+	snd_port->thread_sched.policy == PJ_THREAD_SCHED_DEFAULT)
+    {
+	return;
+    }
+
+    status = pj_thread_set_sched_param(pj_thread_this(),
+				       &snd_port->thread_sched);
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(3,(THIS_FILE, status,
+		     "Unable to set sound thread affinity/scheduling"));
+    }
+}
+
 /*
  * The callback called by sound player when it needs more samples to be
  * played.
@@ -74,6 +103,8 @@ static pj_status_t play_cb(void *user_data, pjmedia_frame *frame)
     const unsigned required_size = (unsigned)frame->size;
     pj_status_t status;
 
+    apply_thread_sched(snd_port, &snd_port->play_sched_done);
+
     pjmedia_clock_src_update(&snd_port->play_clocksrc, &frame->timestamp);
 
     port = snd_port->port;
@@ -133,6 +164,8 @@ static pj_status_t rec_cb(void *user_data, pjmedia_frame *frame)
     pjmedia_snd_port *snd_port = (pjmedia_snd_port*) user_data;
     pjmedia_port *port;
 
+    apply_thread_sched(snd_port, &snd_port->rec_sched_done);
+
     pjmedia_clock_src_update(&snd_port->cap_clocksrc, &frame->timestamp);
 
     port = snd_port->port;
@@ -159,6 +192,8 @@ static pj_status_t play_cb_ext(void *user_data, pjmedia_frame *frame)
     pjmedia_snd_port *snd_port = (pjmedia_snd_port*) user_data;
     pjmedia_port *port = snd_port->port;
 
+    apply_thread_sched(snd_port, &snd_port->play_sched_done);
+
     if (port == NULL) {
 	frame->type = PJMEDIA_FRAME_TYPE_NONE;
 	return PJ_SUCCESS;
@@ -179,6 +214,8 @@ static pj_status_t rec_cb_ext(void *user_data, pjmedia_frame *frame)
     pjmedia_snd_port *snd_port = (pjmedia_snd_port*) user_data;
     pjmedia_port *port;
 
+    apply_thread_sched(snd_port, &snd_port->rec_sched_done);
+
     port = snd_port->port;
     if (port == NULL)
 	return PJ_SUCCESS;
@@ -188,10 +225,11 @@ static pj_status_t rec_cb_ext(void *user_data, pjmedia_frame *frame)
     return PJ_SUCCESS;
 }
 
-/* Initialize with default values (zero) */
+/* Initialize with default values */
 PJ_DEF(void) pjmedia_snd_port_param_default(pjmedia_snd_port_param *prm)
 {
     pj_bzero(prm, sizeof(*prm));
+    pj_thread_sched_param_default(&prm->thread_sched);
 }
 
 /*
@@ -210,6 +248,10 @@ static pj_status_t start_sound_device( pj_pool_t *pool,
     if (snd_port->aud_stream != NULL)
 	return PJ_SUCCESS;
 
+    /* The new stream may run in new threads. */
+    snd_port->play_sched_done = PJ_FALSE;
+    snd_port->rec_sched_done = PJ_FALSE;
+
     PJ_ASSERT_RETURN(snd_port->dir == PJMEDIA_DIR_CAPTURE ||
 		     snd_port->dir == PJMEDIA_DIR_PLAYBACK ||
 		     snd_port->dir == PJMEDIA_DIR_CAPTURE_PLAYBACK,
@@ -464,6 +506,8 @@ PJ_DEF(pj_status_t) pjmedia_snd_port_create2(pj_pool_t *pool,
     pj_memcpy(&snd_port->aud_param, &prm->base, sizeof(snd_port->aud_param));
     snd_port->options = prm->options;
     snd_port->prm_ec_options = prm->ec_options;
+    pj_memcpy(&snd_port->thread_sched, &prm->thread_sched,
+	      sizeof(snd_port->thread_sched));
 
     ptime_usec = prm->base.samples_per_frame * 1000 / prm->base.channel_count /
                  prm->base.clock_rate * 1000;
@@ -35,6 +35,7 @@
 #include <pj/rand.h>
 #include <pj/sock_select.h>
 #include <pj/string.h>	    /* memcpy() */
+#include <pj/trace.h>
 
 
 #define THIS_FILE			"stream.c"
@@ -116,6 +117,7 @@ struct pjmedia_stream
     pjmedia_channel	    *dec;	    /**< Decoding channel.	    */
 
     pj_pool_t		    *own_pool;	    /**< Only created if not given  */
+    pj_pool_t		    *jb_pool;	    /**< Jitter buffer pool.	    */
 
     pjmedia_dir		     dir;	    /**< Stream direction.	    */
     void		    *user_data;	    /**< User data.		    */
@@ -492,6 +494,8 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
      * until we have enough frames according to codec's ptime.
      */
 
+    PJ_TRACE_BEGIN("media", "stream_get_frame");
+
     /* Lock jitter buffer mutex first */
     pj_mutex_lock( stream->jb_mutex );
 
@@ -725,6 +729,8 @@ static pj_status_t get_frame( pjmedia_port *port, pjmedia_frame *frame)
 	frame->timestamp.u64 = 0;
     }
 
+    PJ_TRACE_END("media", "stream_get_frame");
+
     return PJ_SUCCESS;
 }
 
@@ -1418,6 +1424,9 @@ static pj_status_t put_frame( pjmedia_port *port,
     pjmedia_stream *stream = (pjmedia_stream*) port->port_data.pdata;
     pjmedia_frame tmp_zero_frame;
     unsigned samples_per_frame;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_TRACE_BEGIN("media", "stream_put_frame");
 
     samples_per_frame = stream->enc_samples_per_pkt;
 
@@ -1475,7 +1484,6 @@ static pj_status_t put_frame( pjmedia_port *port,
      */
     if (stream->enc_buf != NULL) {
 	pjmedia_frame tmp_rebuffer_frame;
-	pj_status_t status = PJ_SUCCESS;
 
 	/* Copy original frame to temporary frame since we need
 	 * to modify it.
@@ -1508,11 +1516,13 @@ static pj_status_t put_frame( pjmedia_port *port,
 	    }
 	}
 
-	return status;
-
     } else {
-	return put_frame_imp(port, frame);
+	status = put_frame_imp(port, frame);
     }
+
+    PJ_TRACE_END("media", "stream_put_frame");
+
+    return status;
 }
 
 
@@ -1648,6 +1658,8 @@ static void on_rx_rtp( void *data,
 	return;
     }
 
+    PJ_TRACE_BEGIN("media", "stream_rx_rtp");
+
     /* Ignore the packet if decoder is paused */
     if (channel->paused)
 	goto on_return;
@@ -1873,6 +1885,8 @@ on_return:
 	    stream->initial_rr = PJ_TRUE;
 	}
     }
+
+    PJ_TRACE_END("media", "stream_rx_rtp");
 }
 
 
@@ -2239,8 +2253,19 @@ PJ_DEF(pj_status_t) pjmedia_stream_create( pjmedia_endpt *endpt,
 	//jb_init = (jb_min_pre + jb_max_pre) / 2;
 	jb_init = 0;
 
-    /* Create jitter buffer */
-    status = pjmedia_jbuf_create(pool, &stream->port.info.name,
+    /* Create jitter buffer, in its own pool so that its memory is
+     * accounted separately from the stream.
+     */
+    stream->jb_pool = pjmedia_endpt_create_pool(endpt, "jbuf%p",
+						jb_max * (stream->frame_size +
+							  32) + 512,
+						256);
+    if (!stream->jb_pool) {
+	status = PJ_ENOMEM;
+	goto err_cleanup;
+    }
+
+    status = pjmedia_jbuf_create(stream->jb_pool, &stream->port.info.name,
 				 stream->frame_size,
 				 stream->codec_param.info.frm_ptime,
 				 jb_max, &stream->jb);
@@ -2521,6 +2546,11 @@ PJ_DEF(pj_status_t) pjmedia_stream_destroy( pjmedia_stream *stream )
     if (stream->jb)
 	pjmedia_jbuf_destroy(stream->jb);
 
+    if (stream->jb_pool) {
+	pj_pool_release(stream->jb_pool);
+	stream->jb_pool = NULL;
+    }
+
 #if TRACE_JB
     if (TRACE_JB_OPENED(stream)) {
 	pj_file_close(stream->trace_jb_fd);
@@ -79,6 +79,7 @@ struct transport_udp
     unsigned		rtp_src_cnt;	/**< How many pkt from this addr.   */
     int			rtp_addrlen;	/**< Address length.		    */
     char		rtp_pkt[RTP_LEN];/**< Incoming RTP packet buffer    */
+    pj_sock_msg	       *rtp_batch;	/**< Extra RTP buffers for batch rx */
 
     pj_sock_t		rtcp_sock;	/**< RTCP socket		    */
     pj_sockaddr		rtcp_addr_name;	/**< Published RTCP address.	    */
@@ -349,6 +350,21 @@ PJ_DEF(pj_status_t) pjmedia_transport_udp_attach( pjmedia_endpt *endpt,
 	pj_ioqueue_op_key_init(&tp->rtp_pending_write[i].op_key, 
 			       sizeof(tp->rtp_pending_write[i].op_key));
 
+    /* Allocate extra buffers for batch read. The extra packets are read
+     * directly from the socket, which only keeps them in order if the
+     * ioqueue doesn't submit the reads beforehand.
+     */
+    if ((options & PJMEDIA_UDP_RX_BATCH) && 
+	PJMEDIA_TRANSPORT_UDP_RX_BATCH > 1 &&
+	(pj_ioqueue_get_features() & PJ_IOQUEUE_FEATURE_DIRECT_READ))
+    {
+	tp->rtp_batch = (pj_sock_msg*)
+			pj_pool_calloc(pool, PJMEDIA_TRANSPORT_UDP_RX_BATCH-1,
+				       sizeof(pj_sock_msg));
+	for (i=0; i<PJMEDIA_TRANSPORT_UDP_RX_BATCH-1; ++i)
+	    tp->rtp_batch[i].buf = pj_pool_alloc(pool, RTP_LEN);
+    }
+
     /* Kick of pending RTP read from the ioqueue */
     tp->rtp_addrlen = sizeof(tp->rtp_src_addr);
     size = sizeof(tp->rtp_pkt);
@@ -438,99 +454,136 @@ static pj_status_t transport_destroy(pjmedia_transport *tp)
 }
 
 
-/* Notification from ioqueue about incoming RTP packet */
-static void on_rx_rtp( pj_ioqueue_key_t *key, 
-                       pj_ioqueue_op_key_t *op_key, 
-                       pj_ssize_t bytes_read)
+/* Process incoming RTP packet which source address is in rtp_src_addr */
+static void rx_rtp_packet(struct transport_udp *udp,
+			  void *pkt,
+			  pj_ssize_t bytes_read)
 {
-    struct transport_udp *udp;
-    pj_status_t status;
-
-    PJ_UNUSED_ARG(op_key);
+    void (*cb)(void*,void*,pj_ssize_t);
+    void *user_data;
+    pj_bool_t discard = PJ_FALSE;
 
-    udp = (struct transport_udp*) pj_ioqueue_get_user_data(key);
+    cb = udp->rtp_cb;
+    user_data = udp->user_data;
 
-    do {
-	void (*cb)(void*,void*,pj_ssize_t);
-	void *user_data;
-	pj_bool_t discard = PJ_FALSE;
+    /* Simulate packet lost on RX direction */
+    if (udp->rx_drop_pct) {
+	if ((pj_rand() % 100) <= (int)udp->rx_drop_pct) {
+	    PJ_LOG(5,(udp->base.name, 
+		      "RX RTP packet dropped because of pkt lost "
+		      "simulation"));
+	    discard = PJ_TRUE;
+	}
+    }
 
-	cb = udp->rtp_cb;
-	user_data = udp->user_data;
+    /* See if source address of RTP packet is different than the 
+     * configured address, and switch RTP remote address to 
+     * source packet address after several consecutive packets
+     * have been received.
+     */
+    if (bytes_read>0 && 
+	(udp->options & PJMEDIA_UDP_NO_SRC_ADDR_CHECKING)==0) 
+    {
+	if (pj_sockaddr_cmp(&udp->rem_rtp_addr, &udp->rtp_src_addr) == 0) {
+	    /* We're still receiving from rem_rtp_addr. Don't switch. */
+	    udp->rtp_src_cnt = 0;
+	} else {
+	    udp->rtp_src_cnt++;
 
-	/* Simulate packet lost on RX direction */
-	if (udp->rx_drop_pct) {
-	    if ((pj_rand() % 100) <= (int)udp->rx_drop_pct) {
-		PJ_LOG(5,(udp->base.name, 
-			  "RX RTP packet dropped because of pkt lost "
-			  "simulation"));
+	    if (udp->rtp_src_cnt < PJMEDIA_RTP_NAT_PROBATION_CNT) {
 		discard = PJ_TRUE;
-	    }
-	}
+	    } else {
+		
+		char addr_text[80];
 
-	/* See if source address of RTP packet is different than the 
-	 * configured address, and switch RTP remote address to 
-	 * source packet address after several consecutive packets
-	 * have been received.
-	 */
-	if (bytes_read>0 && 
-	    (udp->options & PJMEDIA_UDP_NO_SRC_ADDR_CHECKING)==0) 
-	{
-	    if (pj_sockaddr_cmp(&udp->rem_rtp_addr, &udp->rtp_src_addr) == 0) {
-		/* We're still receiving from rem_rtp_addr. Don't switch. */
+		/* Set remote RTP address to source address */
+		pj_memcpy(&udp->rem_rtp_addr, &udp->rtp_src_addr,
+			  sizeof(pj_sockaddr));
+
+		/* Reset counter */
 		udp->rtp_src_cnt = 0;
-	    } else {
-		udp->rtp_src_cnt++;
 
-		if (udp->rtp_src_cnt < PJMEDIA_RTP_NAT_PROBATION_CNT) {
-		    discard = PJ_TRUE;
-		} else {
-		
-		    char addr_text[80];
+		PJ_LOG(4,(udp->base.name,
+			  "Remote RTP address switched to %s",
+			  pj_sockaddr_print(&udp->rtp_src_addr, addr_text,
+					    sizeof(addr_text), 3)));
+
+		/* Also update remote RTCP address if actual RTCP source
+		 * address is not heard yet.
+		 */
+		if (!pj_sockaddr_has_addr(&udp->rtcp_src_addr)) {
+		    pj_uint16_t port;
 
-		    /* Set remote RTP address to source address */
-		    pj_memcpy(&udp->rem_rtp_addr, &udp->rtp_src_addr,
+		    pj_memcpy(&udp->rem_rtcp_addr, &udp->rem_rtp_addr, 
 			      sizeof(pj_sockaddr));
+		    pj_sockaddr_copy_addr(&udp->rem_rtcp_addr,
+					  &udp->rem_rtp_addr);
+		    port = (pj_uint16_t)
+			   (pj_sockaddr_get_port(&udp->rem_rtp_addr)+1);
+		    pj_sockaddr_set_port(&udp->rem_rtcp_addr, port);
 
-		    /* Reset counter */
-		    udp->rtp_src_cnt = 0;
+		    pj_memcpy(&udp->rtcp_src_addr, &udp->rem_rtcp_addr, 
+			      sizeof(pj_sockaddr));
 
 		    PJ_LOG(4,(udp->base.name,
-			      "Remote RTP address switched to %s",
-			      pj_sockaddr_print(&udp->rtp_src_addr, addr_text,
+			      "Remote RTCP address switched to predicted"
+			      " address %s",
+			      pj_sockaddr_print(&udp->rtcp_src_addr, 
+						addr_text,
 						sizeof(addr_text), 3)));
 
-		    /* Also update remote RTCP address if actual RTCP source
-		     * address is not heard yet.
-		     */
-		    if (!pj_sockaddr_has_addr(&udp->rtcp_src_addr)) {
-			pj_uint16_t port;
-
-			pj_memcpy(&udp->rem_rtcp_addr, &udp->rem_rtp_addr, 
-				  sizeof(pj_sockaddr));
-			pj_sockaddr_copy_addr(&udp->rem_rtcp_addr,
-					      &udp->rem_rtp_addr);
-			port = (pj_uint16_t)
-			       (pj_sockaddr_get_port(&udp->rem_rtp_addr)+1);
-			pj_sockaddr_set_port(&udp->rem_rtcp_addr, port);
-
-			pj_memcpy(&udp->rtcp_src_addr, &udp->rem_rtcp_addr, 
-				  sizeof(pj_sockaddr));
-
-			PJ_LOG(4,(udp->base.name,
-				  "Remote RTCP address switched to predicted"
-				  " address %s",
-				  pj_sockaddr_print(&udp->rtcp_src_addr, 
-						    addr_text,
-						    sizeof(addr_text), 3)));
-
-		    }
 		}
 	    }
 	}
+    }
+
+    if (!discard && udp->attached && cb)
+	(*cb)(user_data, pkt, bytes_read);
+}
+
+
+/* Read and process RTP packets that are already queued in the socket */
+static void rx_rtp_batch(struct transport_udp *udp)
+{
+    unsigned i, count = PJMEDIA_TRANSPORT_UDP_RX_BATCH - 1;
+
+    for (i=0; i<count; ++i) {
+	udp->rtp_batch[i].len = RTP_LEN;
+	udp->rtp_batch[i].addr_len = sizeof(udp->rtp_batch[i].addr);
+    }
+
+    if (pj_sock_recvmmsg(udp->rtp_sock, udp->rtp_batch, &count, 0) 
+	    != PJ_SUCCESS)
+    {
+	return;
+    }
+
+    for (i=0; i<count && udp->rtp_key; ++i) {
+	pj_memcpy(&udp->rtp_src_addr, &udp->rtp_batch[i].addr,
+		  udp->rtp_batch[i].addr_len);
+	udp->rtp_addrlen = udp->rtp_batch[i].addr_len;
+	rx_rtp_packet(udp, udp->rtp_batch[i].buf, udp->rtp_batch[i].len);
+    }
+}
+
+
+/* Notification from ioqueue about incoming RTP packet */
+static void on_rx_rtp( pj_ioqueue_key_t *key, 
+                       pj_ioqueue_op_key_t *op_key, 
+                       pj_ssize_t bytes_read)
+{
+    struct transport_udp *udp;
+    pj_status_t status;
+
+    PJ_UNUSED_ARG(op_key);
+
+    udp = (struct transport_udp*) pj_ioqueue_get_user_data(key);
+
+    do {
+	rx_rtp_packet(udp, udp->rtp_pkt, bytes_read);
 
-	if (!discard && udp->attached && cb)
-	    (*cb)(user_data, udp->rtp_pkt, bytes_read);
+	if (bytes_read > 0 && udp->rtp_batch)
+	    rx_rtp_batch(udp);
 
 	bytes_read = sizeof(udp->rtp_pkt);
 	udp->rtp_addrlen = sizeof(udp->rtp_src_addr);
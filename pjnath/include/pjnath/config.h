@@ -457,9 +457,29 @@
 #   define PJNATH_POOL_INC_STUN_SESS		    1000
 #endif
 
-/** STUN session transmit data pool initial size */
+/**
+ * Number of STUN packet buffers (of PJ_STUN_MAX_PKT_LEN bytes each) to
+ * allocate at once in the object pool shared by the STUN sessions of the
+ * same pool factory. The encoded packet of the transmit data is kept in
+ * this object pool rather than in the transmit data pool, so the transmit
+ * data pool can be smaller, and the buffer is reused by the next transmit
+ * data. Set to zero to allocate the packet buffer from the transmit data
+ * pool.
+ */
+#ifndef PJNATH_STUN_PKT_SLAB_CNT
+#   define PJNATH_STUN_PKT_SLAB_CNT		    16
+#endif
+
+/**
+ * STUN session transmit data pool initial size. The encoded packet is
+ * not allocated from this pool when PJNATH_STUN_PKT_SLAB_CNT is set.
+ */
 #ifndef PJNATH_POOL_LEN_STUN_TDATA
-#   define PJNATH_POOL_LEN_STUN_TDATA		    1000
+#   if PJNATH_STUN_PKT_SLAB_CNT
+#	define PJNATH_POOL_LEN_STUN_TDATA	    500
+#   else
+#	define PJNATH_POOL_LEN_STUN_TDATA	    1000
+#   endif
 #endif
 
 /** STUN session transmit data pool increment size */
@@ -33,6 +33,7 @@ struct pj_stun_session
     pj_bool_t		 use_fingerprint;
 
     pj_pool_t		*rx_pool;
+    pj_objpool_t	*pkt_pool;
 
 #if PJ_LOG_MAX_LEVEL >= 5
     char		 dump_buf[1000];
@@ -65,6 +66,75 @@ struct pj_stun_session
 #define TDATA_POOL_SIZE		    PJNATH_POOL_LEN_STUN_TDATA
 #define TDATA_POOL_INC		    PJNATH_POOL_INC_STUN_TDATA
 
+#if PJNATH_STUN_PKT_SLAB_CNT
+/* The packet buffer object pools, shared by all STUN sessions which use
+ * the same pool factory. A session which finds no free entry allocates
+ * its packet buffers from the tdata pool.
+ */
+#define MAX_PKT_POOL		    4
+
+static struct pkt_pool_entry
+{
+    pj_pool_factory	*pf;
+    pj_objpool_t	*objpool;
+    unsigned		 ref_cnt;
+} pkt_pool[MAX_PKT_POOL];
+
+/* Get the packet buffer object pool of the pool factory */
+static pj_objpool_t *get_pkt_pool(pj_pool_factory *pf)
+{
+    pj_objpool_t *objpool = NULL;
+    unsigned i, free_idx = MAX_PKT_POOL;
+
+    pj_enter_critical_section();
+
+    for (i=0; i<MAX_PKT_POOL; ++i) {
+	if (pkt_pool[i].ref_cnt && pkt_pool[i].pf == pf)
+	    break;
+	if (!pkt_pool[i].ref_cnt && free_idx == MAX_PKT_POOL)
+	    free_idx = i;
+    }
+
+    if (i == MAX_PKT_POOL && free_idx != MAX_PKT_POOL &&
+	pj_objpool_create(pf, "stunpkt", PJ_STUN_MAX_PKT_LEN,
+			  PJNATH_STUN_PKT_SLAB_CNT, PJ_OBJPOOL_THREAD_CACHE,
+			  &pkt_pool[free_idx].objpool) == PJ_SUCCESS)
+    {
+	i = free_idx;
+	pkt_pool[i].pf = pf;
+    }
+
+    if (i < MAX_PKT_POOL) {
+	++pkt_pool[i].ref_cnt;
+	objpool = pkt_pool[i].objpool;
+    }
+
+    pj_leave_critical_section();
+    return objpool;
+}
+
+/* Release the packet buffer object pool of a session */
+static void put_pkt_pool(pj_objpool_t *objpool)
+{
+    unsigned i;
+
+    pj_enter_critical_section();
+
+    for (i=0; i<MAX_PKT_POOL; ++i) {
+	if (pkt_pool[i].ref_cnt && pkt_pool[i].objpool == objpool) {
+	    if (--pkt_pool[i].ref_cnt == 0) {
+		pj_objpool_destroy(objpool);
+		pkt_pool[i].objpool = NULL;
+		pkt_pool[i].pf = NULL;
+	    }
+	    break;
+	}
+    }
+
+    pj_leave_critical_section();
+}
+#endif	/* PJNATH_STUN_PKT_SLAB_CNT */
+
 
 static void stun_tsx_on_complete(pj_stun_client_tsx *tsx,
 				 pj_status_t status, 
@@ -142,6 +212,14 @@ static pj_status_t create_tdata(pj_stun_session *sess,
     return PJ_SUCCESS;
 }
 
+/* Release the packet buffer and the pool of the transmit data. */
+static void release_tdata(pj_stun_tx_data *tdata)
+{
+    if (tdata->pkt && tdata->sess->pkt_pool)
+	pj_objpool_free(tdata->sess->pkt_pool, tdata->pkt);
+    pj_pool_release(tdata->pool);
+}
+
 static void stun_tsx_on_destroy(pj_stun_client_tsx *tsx)
 {
     pj_stun_tx_data *tdata;
@@ -150,7 +228,7 @@ static void stun_tsx_on_destroy(pj_stun_client_tsx *tsx)
     pj_stun_client_tsx_stop(tsx);
     if (tdata) {
 	tsx_erase(tdata->sess, tdata);
-	pj_pool_release(tdata->pool);
+	release_tdata(tdata);
     }
 
     TRACE_((THIS_FILE, "STUN transaction %p destroyed", tsx));
@@ -173,7 +251,7 @@ static void destroy_tdata(pj_stun_tx_data *tdata, pj_bool_t force)
 	    pj_stun_client_tsx_stop(tdata->client_tsx);
 	    pj_stun_client_tsx_set_data(tdata->client_tsx, NULL);
 	}
-	pj_pool_release(tdata->pool);
+	release_tdata(tdata);
 
     } else {
 	if (tdata->client_tsx) {
@@ -182,7 +260,7 @@ static void destroy_tdata(pj_stun_tx_data *tdata, pj_bool_t force)
 	    pj_stun_client_tsx_schedule_destroy(tdata->client_tsx, &delay);
 
 	} else {
-	    pj_pool_release(tdata->pool);
+	    release_tdata(tdata);
 	}
     }
 }
@@ -531,6 +609,11 @@ PJ_DEF(pj_status_t) pj_stun_session_create( pj_stun_config *cfg,
 				   PJNATH_POOL_LEN_STUN_TDATA,
 				   PJNATH_POOL_INC_STUN_TDATA, NULL);
 
+#if PJNATH_STUN_PKT_SLAB_CNT
+    /* Packet buffers will be allocated from the tdata pool if this fails */
+    sess->pkt_pool = get_pkt_pool(sess->cfg->pf);
+#endif
+
     pj_list_init(&sess->pending_request_list);
     pj_list_init(&sess->cached_response_list);
 
@@ -558,6 +641,13 @@ static void stun_sess_on_destroy(void *comp)
 	sess->rx_pool = NULL;
     }
 
+#if PJNATH_STUN_PKT_SLAB_CNT
+    if (sess->pkt_pool) {
+	put_pkt_pool(sess->pkt_pool);
+	sess->pkt_pool = NULL;
+    }
+#endif
+
     pj_pool_release(sess->pool);
 
     TRACE_((THIS_FILE, "STUN session %p destroyed", sess));
@@ -788,7 +878,7 @@ PJ_DEF(pj_status_t) pj_stun_session_create_req(pj_stun_session *sess,
 
 on_error:
     if (tdata)
-	pj_pool_release(tdata->pool);
+	release_tdata(tdata);
     pj_grp_lock_release(sess->grp_lock);
     return status;
 }
@@ -819,7 +909,7 @@ PJ_DEF(pj_status_t) pj_stun_session_create_ind(pj_stun_session *sess,
     status = pj_stun_msg_create(tdata->pool, msg_type,  PJ_STUN_MAGIC, 
 				NULL, &tdata->msg);
     if (status != PJ_SUCCESS) {
-	pj_pool_release(tdata->pool);
+	release_tdata(tdata);
 	pj_grp_lock_release(sess->grp_lock);
 	return status;
     }
@@ -858,7 +948,7 @@ PJ_DEF(pj_status_t) pj_stun_session_create_res( pj_stun_session *sess,
     status = pj_stun_msg_create_response(tdata->pool, rdata->msg, 
 					 err_code, err_msg, &tdata->msg);
     if (status != PJ_SUCCESS) {
-	pj_pool_release(tdata->pool);
+	release_tdata(tdata);
 	pj_grp_lock_release(sess->grp_lock);
 	return status;
     }
@@ -933,7 +1023,17 @@ PJ_DEF(pj_status_t) pj_stun_session_send_msg( pj_stun_session *sess,
 
     /* Allocate packet */
     tdata->max_len = PJ_STUN_MAX_PKT_LEN;
-    tdata->pkt = pj_pool_alloc(tdata->pool, tdata->max_len);
+    if (sess->pkt_pool) {
+	if (!tdata->pkt)
+	    tdata->pkt = pj_objpool_alloc(sess->pkt_pool);
+	if (!tdata->pkt) {
+	    pj_stun_msg_destroy_tdata(sess, tdata);
+	    status = PJ_ENOMEM;
+	    goto on_return;
+	}
+    } else {
+	tdata->pkt = pj_pool_alloc(tdata->pool, tdata->max_len);
+    }
 
     tdata->token = token;
     tdata->retransmit = retransmit;
@@ -321,10 +321,10 @@ PJ_DEF(pj_status_t) pj_turn_allocation_create(pj_turn_transport *transport,
     }
 
     /* Create peer hash table */
-    alloc->peer_table = pj_hash_create(pool, PEER_TABLE_SIZE);
+    alloc->peer_table = pj_hash_create_resizable(pool, PEER_TABLE_SIZE);
 
     /* Create channel hash table */
-    alloc->ch_table = pj_hash_create(pool, PEER_TABLE_SIZE);
+    alloc->ch_table = pj_hash_create_resizable(pool, PEER_TABLE_SIZE);
 
     /* Print info */
     pj_ansi_strcpy(alloc->info,
@@ -129,8 +129,8 @@ PJ_DEF(pj_status_t) pj_turn_srv_create(pj_pool_factory *pf,
 					sizeof(srv->core.listener[0]));
 
     /* Create hash tables */
-    srv->tables.alloc = pj_hash_create(pool, MAX_CLIENTS);
-    srv->tables.res = pj_hash_create(pool, MAX_CLIENTS);
+    srv->tables.alloc = pj_hash_create_resizable(pool, MAX_CLIENTS);
+    srv->tables.res = pj_hash_create_resizable(pool, MAX_CLIENTS);
 
     /* Init ports settings */
     srv->ports.min_udp = srv->ports.next_udp = MIN_PORT;
@@ -24,6 +24,7 @@
  * @file sip_config.h
  * @brief Compile time configuration.
  */
+#include <pj/os.h>
 #include <pj/types.h>
 
 /**
@@ -128,6 +129,16 @@ typedef struct pjsip_cfg_t
 	 */
 	pj_bool_t req_has_via_alias;
 
+	/**
+	 * CPU affinity and scheduling policy of the threads of the worker
+	 * ioqueues of the endpoint (see #pjsip_endpt_get_worker_ioqueue()).
+	 * When \a use_affinity is set, the thread of the worker ioqueue
+	 * with index N is pinned to CPU (cpu + N).
+	 *
+	 * Default is to leave the threads untouched.
+	 */
+	pj_thread_sched_param worker_sched;
+
     } endpt;
 
     /** Transaction layer settings. */
@@ -240,6 +251,20 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #   define PJSIP_MAX_DIALOG_COUNT	(512-1)
 #endif
 
+/**
+ * Use resizable hash tables (see #pj_hash_create_resizable()) for the
+ * transaction and dialog tables. The tables then start with
+ * PJSIP_MAX_TSX_COUNT and PJSIP_MAX_DIALOG_COUNT slots and grow as
+ * needed, so lookups stay fast with many more transactions or dialogs.
+ * When disabled, the chained hash tables with a fixed number of buckets
+ * are used.
+ *
+ * Default value is 1.
+ */
+#ifndef PJSIP_RESIZABLE_HTABLE
+#   define PJSIP_RESIZABLE_HTABLE	1
+#endif
+
 
 /**
  * Specify maximum number of transports.
@@ -251,6 +276,20 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Maximum number of worker ioqueues of the endpoint (see
+ * #pjsip_endpt_get_worker_ioqueue()), which is also the maximum number of
+ * sockets that a UDP transport or a TCP listener can open on the same
+ * address with SO_REUSEPORT (see the \a shard_cnt setting of
+ * pjsip_udp_transport_cfg and pjsip_tcp_transport_cfg).
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_MAX_WORKER_IOQUEUE
+#   define PJSIP_MAX_WORKER_IOQUEUE	16
+#endif
+
+
 /**
  * Transport manager hash table size (must be 2^n-1). 
  * See also PJSIP_MAX_TRANSPORTS
@@ -364,6 +403,22 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Maximum number of packets to be read at once by the SIP UDP transport.
+ * When this is set to more than one, every time the ioqueue reports an
+ * incoming packet, the UDP transport will also read up to
+ * (PJSIP_UDP_RX_BATCH - 1) more packets that are already queued in the
+ * socket with a single call to pj_sock_recvmmsg(). This requires
+ * (PJSIP_UDP_RX_BATCH - 1) extra rdata for each asynchronous read
+ * operation of the transport.
+ *
+ * Default is 1 (batch read is disabled).
+ */
+#ifndef PJSIP_UDP_RX_BATCH
+#   define PJSIP_UDP_RX_BATCH		1
+#endif
+
+
 /**
  * Encode SIP headers in their short forms to reduce size. By default,
  * SIP headers in outgoing messages will be encoded in their full names. 
@@ -493,14 +548,19 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
  * events so far is less than this value, PJSIP will call pj_ioqueue_poll()
  * again to get more events.
  *
- * Value 1 works best for ioqueue with select() back-end, while for IOCP it is
- * probably best to set this value equal to PJSIP_MAX_TIMED_OUT_ENTRIES
- * since IOCP only processes one event at a time.
+ * A single pj_ioqueue_poll() may already dispatch up to
+ * PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL events (see
+ * pj_ioqueue_set_max_events()), so by default PJSIP keeps polling while
+ * events arrive until that many have been processed, before it polls the
+ * timer heap again. For IOCP, which only processes one event at a time,
+ * it is probably best to set this value equal to
+ * PJSIP_MAX_TIMED_OUT_ENTRIES. Set it to 1 to poll the ioqueue only once
+ * per pjsip_endpt_handle_events() call.
  *
- * Default: 1
+ * Default: PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL
  */
 #ifndef PJSIP_MAX_NET_EVENTS
-#   define PJSIP_MAX_NET_EVENTS		1
+#   define PJSIP_MAX_NET_EVENTS		PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL
 #endif
 
 
@@ -714,6 +774,22 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #define PJSIP_MAX_TIMER_COUNT		(2*pjsip_cfg()->tsx.max_count + \
 					 2*PJSIP_MAX_DIALOG_COUNT)
 
+/**
+ * Number of shards of the endpoint's timer heap. When this is greater
+ * than one, the endpoint creates a sharded timer heap (see
+ * #pj_timer_heap_create_sharded()), so that worker threads which call
+ * #pjsip_endpt_handle_events() each poll their own timer shard and do not
+ * contend for a single timer heap lock. This is normally set to the number
+ * of worker threads. Note that with a sharded timer heap, all threads
+ * which poll the endpoint must keep polling it for the lifetime of the
+ * endpoint.
+ *
+ * Default: 0 (not sharded)
+ */
+#ifndef PJSIP_TIMER_HEAP_SHARD_CNT
+#   define PJSIP_TIMER_HEAP_SHARD_CNT	0
+#endif
+
 /**
  * Initial memory block for the endpoint.
  */
@@ -749,10 +825,26 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #define PJSIP_POOL_INC_TRANSPORT	512
 
 /**
- * Initial memory block size for tdata.
+ * Number of print buffers (of PJSIP_MAX_PKT_LEN bytes each) to allocate
+ * at once in the transport manager's object pool. The print buffer of
+ * tdata is taken from this object pool rather than from the tdata pool,
+ * and it is reused by the next tdata once the tdata is destroyed. Set to
+ * zero to allocate the print buffer from the tdata pool.
+ */
+#ifndef PJSIP_TDATA_BUF_SLAB_CNT
+#   define PJSIP_TDATA_BUF_SLAB_CNT	16
+#endif
+
+/**
+ * Initial memory block size for tdata. The print buffer is not allocated
+ * from this pool when PJSIP_TDATA_BUF_SLAB_CNT is set.
  */
 #ifndef PJSIP_POOL_LEN_TDATA
-#   define PJSIP_POOL_LEN_TDATA		4000
+#   if PJSIP_TDATA_BUF_SLAB_CNT
+#	define PJSIP_POOL_LEN_TDATA	2000
+#   else
+#	define PJSIP_POOL_LEN_TDATA	4000
+#   endif
 #endif
 
 /**
@@ -435,6 +435,31 @@ PJ_DECL(pjsip_tpmgr*) pjsip_endpt_get_tpmgr(pjsip_endpoint *endpt);
  */
 PJ_DECL(pj_ioqueue_t*) pjsip_endpt_get_ioqueue(pjsip_endpoint *endpt);
 
+/**
+ * Get a worker ioqueue of the endpoint. Unlike the ioqueue returned by
+ * #pjsip_endpt_get_ioqueue(), which is polled by the application with
+ * #pjsip_endpt_handle_events(), each worker ioqueue is polled by its own
+ * thread which is owned by the endpoint. The worker ioqueue and its thread
+ * are created on the first call with the index, and are destroyed when the
+ * endpoint is destroyed, after all transports have been destroyed.
+ *
+ * Transports use the worker ioqueues to spread the processing of their
+ * sockets across threads, for example the sockets that are opened on the
+ * same address with SO_REUSEPORT. Note that incoming messages on these
+ * sockets are processed by the worker threads, so the modules must be
+ * prepared to receive messages from several threads at once.
+ *
+ * @param endpt	    The endpoint.
+ * @param index	    The index of the worker ioqueue, which must be less
+ *		    than #PJSIP_MAX_WORKER_IOQUEUE.
+ * @param p_ioqueue Pointer to receive the ioqueue.
+ *
+ * @return	    PJ_SUCCESS on success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_get_worker_ioqueue(pjsip_endpoint *endpt,
+						    unsigned index,
+						    pj_ioqueue_t **p_ioqueue);
+
 /**
  * Find a SIP transport suitable for sending SIP message to the specified
  * address. If transport selector ("sel") is set, then the function will
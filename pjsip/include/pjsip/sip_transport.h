@@ -628,6 +628,13 @@ struct pjsip_tx_data
      */
     pjsip_host_port          via_addr;      /**< Via address.	        */
     const void              *via_tp;        /**< Via transport.	        */
+
+    /**
+     * Print buffer taken from the transport manager's object pool, to be
+     * returned to the object pool when the tdata is destroyed. This is
+     * internal to the transport manager.
+     */
+    char		    *obj_buf;
 };
 
 
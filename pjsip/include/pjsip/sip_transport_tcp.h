@@ -104,6 +104,26 @@ typedef struct pjsip_tcp_transport_cfg
      */
     pj_qos_params	qos_params;
 
+    /**
+     * Number of listener sockets to open on the same address and port.
+     * When this is more than one, the sockets are opened with SO_REUSEPORT
+     * so that the operating system spreads the incoming connections among
+     * them, and each socket is registered to its own worker ioqueue of the
+     * endpoint (see #pjsip_endpt_get_worker_ioqueue()). An incoming
+     * connection is then served by the worker ioqueue of the socket that
+     * accepted it, so that the messages of different connections are
+     * received and processed by several threads in parallel. Outgoing
+     * connections still use the ioqueue of the endpoint.
+     *
+     * The value must not exceed #PJSIP_MAX_WORKER_IOQUEUE, and
+     * PJ_ENOTSUP is returned if SO_REUSEPORT is not supported by the
+     * platform.
+     *
+     * Default is 1 (one listener socket, registered to the ioqueue of the
+     * endpoint).
+     */
+    unsigned		shard_cnt;
+
 } pjsip_tcp_transport_cfg;
 
 
@@ -205,6 +205,16 @@ typedef struct pjsip_tls_setting
      */
     pj_bool_t qos_ignore_error;
 
+    /**
+     * Executor to run the TLS handshakes on, so that a burst of incoming
+     * or outgoing TLS connections doesn't delay the other transports that
+     * share the endpoint's ioqueue. See \a handshake_exec in
+     * #pj_ssl_sock_param.
+     *
+     * Default: NULL (the handshake is run by the ioqueue thread)
+     */
+    pj_executor_t *handshake_exec;
+
 } pjsip_tls_setting;
 
 
@@ -92,6 +92,92 @@ PJ_DECL(pj_status_t) pjsip_udp_transport_start6(pjsip_endpoint *endpt,
 						pjsip_transport **p_transport);
 
 
+/**
+ * Settings to be specified when creating the UDP transport with
+ * #pjsip_udp_transport_start2(). Application should initialize this
+ * structure with its default values by calling
+ * #pjsip_udp_transport_cfg_default().
+ */
+typedef struct pjsip_udp_transport_cfg
+{
+    /**
+     * Address family to use. Valid values are pj_AF_INET() and
+     * pj_AF_INET6(). Default is pj_AF_INET().
+     */
+    int			af;
+
+    /**
+     * Optional address to bind the socket to. Default is to bind to
+     * PJ_INADDR_ANY and to any available port.
+     */
+    pj_sockaddr		bind_addr;
+
+    /**
+     * Optional published address, which is the address to be
+     * advertised as the address of this SIP transport. 
+     * By default the bound address will be used as the published address.
+     */
+    pjsip_host_port	addr_name;
+
+    /**
+     * Number of simultaneous asynchronous read operations on each socket
+     * of the transport.
+     *
+     * Default is 1.
+     */
+    unsigned		async_cnt;
+
+    /**
+     * Number of sockets to open on the same address and port. When this is
+     * more than one, the sockets are opened with SO_REUSEPORT so that the
+     * operating system spreads the incoming packets among them, and each
+     * socket is registered to its own worker ioqueue of the endpoint (see
+     * #pjsip_endpt_get_worker_ioqueue()), so that the incoming messages are
+     * received and processed by several threads in parallel. Outgoing
+     * messages are sent with the first socket. A sharded transport cannot
+     * be paused or restarted.
+     *
+     * The value must not exceed #PJSIP_MAX_WORKER_IOQUEUE, and
+     * PJ_ENOTSUP is returned if SO_REUSEPORT is not supported by the
+     * platform.
+     *
+     * Default is 1 (the transport has one socket, registered to the
+     * ioqueue of the endpoint).
+     */
+    unsigned		shard_cnt;
+
+} pjsip_udp_transport_cfg;
+
+
+/**
+ * Initialize pjsip_udp_transport_cfg structure with default values for
+ * the specified address family.
+ *
+ * @param cfg		The structure to initialize.
+ * @param af		Address family to be used.
+ */
+PJ_DECL(void) pjsip_udp_transport_cfg_default(pjsip_udp_transport_cfg *cfg,
+					      int af);
+
+
+/**
+ * Start UDP IPv4 or IPv6 transport with the specified settings.
+ *
+ * @param endpt		The SIP endpoint.
+ * @param cfg		UDP transport settings. Application should initialize
+ *			this setting with #pjsip_udp_transport_cfg_default().
+ * @param p_transport	Pointer to receive the transport.
+ *
+ * @return		PJ_SUCCESS when the transport has been successfully
+ *			started and registered to transport manager, or
+ *			the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_udp_transport_start2(
+					pjsip_endpoint *endpt,
+					const pjsip_udp_transport_cfg *cfg,
+					pjsip_transport **p_transport);
+
+
 /**
  * Attach IPv4 UDP socket as a new transport and start the transport.
  *
@@ -176,7 +262,9 @@ PJ_DECL(pj_sock_t) pjsip_udp_transport_get_socket(pjsip_transport *transport);
  * @param option	Pause option.
  *
  * @return		PJ_SUCCESS if transport is paused successfully,
- *			or the appropriate error code.
+ *			PJ_EINVALIDOP if the transport has several sockets
+ *			(see pjsip_udp_transport_cfg), or the appropriate
+ *			error code.
  */
 PJ_DECL(pj_status_t) pjsip_udp_transport_pause(pjsip_transport *transport,
 					       unsigned option);
@@ -216,8 +304,10 @@ PJ_DECL(pj_status_t) pjsip_udp_transport_pause(pjsip_transport *transport,
  *			address will be used as the published address 
  *			of the transport.
  *
- * @return		PJ_SUCCESS if transport can be restarted, or
- *			the appropriate error code.
+ * @return		PJ_SUCCESS if transport can be restarted,
+ *			PJ_EINVALIDOP if the transport has several sockets
+ *			(see pjsip_udp_transport_cfg), or the appropriate
+ *			error code.
  */
 PJ_DECL(pj_status_t) pjsip_udp_transport_restart(pjsip_transport *transport,
 					         unsigned option,
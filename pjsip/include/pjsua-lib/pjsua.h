@@ -1422,6 +1422,15 @@ typedef struct pjsua_config
      */
     unsigned	    thread_cnt;
 
+    /**
+     * CPU affinity and scheduling policy of the worker threads. When
+     * \a use_affinity is set, the worker threads are pinned to consecutive
+     * CPUs starting from \a cpu, one CPU per thread.
+     *
+     * Default: the threads are left untouched.
+     */
+    pj_thread_sched_param thread_sched;
+
     /**
      * Number of nameservers. If no name server is configured, the SIP SRV
      * resolution would be disabled, and domain will be resolved with
@@ -5539,6 +5548,26 @@ struct pjsua_media_config
      */
     unsigned		thread_cnt;
 
+    /**
+     * CPU affinity and scheduling policy of the media worker threads
+     * above. When \a use_affinity is set, the threads are pinned to
+     * consecutive CPUs starting from \a cpu, one CPU per thread.
+     *
+     * Default: the threads are left untouched.
+     */
+    pj_thread_sched_param thread_sched;
+
+    /**
+     * CPU affinity and scheduling policy of the thread that drives the
+     * conference bridge, which is the sound device thread(s), or the clock
+     * thread of the null sound device. Pinning it to a CPU of its own,
+     * apart from the worker threads, gives the audio frames a more
+     * predictable latency.
+     *
+     * Default: the threads are left untouched.
+     */
+    pj_thread_sched_param snd_thread_sched;
+
     /**
      * Media quality, 0-10, according to this table:
      *   5-10: resampling use large filter,
@@ -583,6 +583,13 @@ PJ_INLINE(pj_bool_t) PJSUA_LOCK_IS_LOCKED()
 /* Core */
 void pjsua_set_state(pjsua_state new_state);
 
+/* Apply the thread settings to the index-th thread of a group of threads,
+ * which is pinned to the index-th CPU from the configured CPU.
+ */
+void pjsua_set_thread_sched(pj_thread_t *thread,
+			    const pj_thread_sched_param *param,
+			    unsigned index);
+
 /******
  * STUN resolution
  */
@@ -34,6 +34,7 @@
 #include <pj/assert.h>
 #include <pj/errno.h>
 #include <pj/lock.h>
+#include <pj/trace.h>
 
 #define PJSIP_EX_NO_MEMORY  pj_NO_MEMORY_EXCEPTION()
 #define THIS_FILE	    "sip_endpoint.c"
@@ -49,6 +50,15 @@ typedef struct exit_cb
 } exit_cb;
 
 
+/* Worker ioqueue, see pjsip_endpt_get_worker_ioqueue() */
+typedef struct worker_ioq
+{
+    pjsip_endpoint		   *endpt;
+    pj_ioqueue_t		   *ioqueue;
+    pj_thread_t			   *thread;
+} worker_ioq;
+
+
 /**
  * The SIP endpoint.
  */
@@ -78,6 +88,12 @@ struct pjsip_endpoint
     /** Last ioqueue err */
     pj_status_t		 ioq_last_err;
 
+    /** Worker ioqueues, created on demand. */
+    worker_ioq		 worker[PJSIP_MAX_WORKER_IOQUEUE];
+
+    /** Flag to stop the worker threads. */
+    pj_bool_t		 worker_quit;
+
     /** DNS Resolver. */
     pjsip_resolver_t	*resolver;
 
@@ -120,6 +136,7 @@ static pj_status_t endpt_on_tx_msg( pjsip_endpoint *endpt,
 				    pjsip_tx_data *tdata );
 static pj_status_t unload_module(pjsip_endpoint *endpt,
 				 pjsip_module *mod);
+static void destroy_worker_ioqueues(pjsip_endpoint *endpt);
 
 /* Defined in sip_parser.c */
 void init_sip_parser(void);
@@ -486,8 +503,14 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
     }
 
     /* Create timer heap to manage all timers within this endpoint. */
+#if PJSIP_TIMER_HEAP_SHARD_CNT > 1
+    status = pj_timer_heap_create_sharded( endpt->pool, PJSIP_MAX_TIMER_COUNT,
+					   PJSIP_TIMER_HEAP_SHARD_CNT,
+					   &endpt->timer_heap);
+#else
     status = pj_timer_heap_create( endpt->pool, PJSIP_MAX_TIMER_COUNT, 
                                    &endpt->timer_heap);
+#endif
     if (status != PJ_SUCCESS) {
 	goto on_error;
     }
@@ -603,6 +626,9 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
     /* Shutdown and destroy all transports. */
     pjsip_tpmgr_destroy(endpt->transport_mgr);
 
+    /* Stop and destroy worker ioqueues */
+    destroy_worker_ioqueues(endpt);
+
     /* Destroy ioqueue */
     pj_ioqueue_destroy(endpt->ioqueue);
 
@@ -1033,7 +1059,9 @@ static void endpt_on_rx_msg( pjsip_endpoint *endpt,
     pjsip_process_rdata_param_default(&proc_prm);
     proc_prm.silent = PJ_TRUE;
 
+    PJ_TRACE_BEGIN("sip", "endpt_rx");
     pjsip_endpt_process_rx_data(endpt, rdata, &proc_prm, &handled);
+    PJ_TRACE_END("sip", "endpt_rx");
 
     /* No module is able to handle the message */
     if (!handled) {
@@ -1062,6 +1090,8 @@ static pj_status_t endpt_on_tx_msg( pjsip_endpoint *endpt,
     pj_status_t status = PJ_SUCCESS;
     pjsip_module *mod;
 
+    PJ_TRACE_BEGIN("sip", "endpt_tx");
+
     /* Distribute to modules, starting from modules with LOWEST priority */
     LOCK_MODULE_ACCESS(endpt);
 
@@ -1087,6 +1117,8 @@ static pj_status_t endpt_on_tx_msg( pjsip_endpoint *endpt,
 
     UNLOCK_MODULE_ACCESS(endpt);
 
+    PJ_TRACE_END("sip", "endpt_tx");
+
     return status;
 }
 
@@ -1164,6 +1196,108 @@ PJ_DEF(pj_ioqueue_t*) pjsip_endpt_get_ioqueue(pjsip_endpoint *endpt)
     return endpt->ioqueue;
 }
 
+/* Poll a worker ioqueue until the endpoint is destroyed */
+static int worker_ioq_thread(void *arg)
+{
+    worker_ioq *w = (worker_ioq*) arg;
+
+    while (!w->endpt->worker_quit) {
+	pj_time_val timeout = { 0, 10 };
+
+	if (pj_ioqueue_poll(w->ioqueue, &timeout) < 0)
+	    pj_thread_sleep(PJ_TIME_VAL_MSEC(timeout));
+    }
+
+    return 0;
+}
+
+/*
+ * Get worker ioqueue.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_get_worker_ioqueue(pjsip_endpoint *endpt,
+						   unsigned index,
+						   pj_ioqueue_t **p_ioqueue)
+{
+    worker_ioq *w;
+    pj_status_t status = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(endpt && p_ioqueue, PJ_EINVAL);
+    PJ_ASSERT_RETURN(index < PJSIP_MAX_WORKER_IOQUEUE, PJ_ETOOMANY);
+
+    w = &endpt->worker[index];
+
+    pj_mutex_lock(endpt->mutex);
+
+    if (w->ioqueue == NULL) {
+	char name[PJ_MAX_OBJ_NAME];
+	pj_ioqueue_t *ioqueue;
+
+	status = pj_ioqueue_create(endpt->pool, PJSIP_MAX_TRANSPORTS,
+				   &ioqueue);
+	if (status != PJ_SUCCESS)
+	    goto on_return;
+
+	w->endpt = endpt;
+	w->ioqueue = ioqueue;
+
+	pj_ansi_snprintf(name, sizeof(name), "eptw%u", index);
+	status = pj_thread_create(endpt->pool, name, &worker_ioq_thread, w,
+				  0, 0, &w->thread);
+	if (status != PJ_SUCCESS) {
+	    pj_ioqueue_destroy(ioqueue);
+	    w->ioqueue = NULL;
+	    goto on_return;
+	}
+
+	/* Apply the thread settings, pinning each worker to its own CPU */
+	if (pjsip_cfg()->endpt.worker_sched.use_affinity ||
+	    pjsip_cfg()->endpt.worker_sched.policy != PJ_THREAD_SCHED_DEFAULT)
+	{
+	    pj_thread_sched_param prm = pjsip_cfg()->endpt.worker_sched;
+
+	    if (prm.use_affinity)
+		prm.cpu += index;
+
+	    status = pj_thread_set_sched_param(w->thread, &prm);
+	    if (status != PJ_SUCCESS) {
+		PJ_PERROR(3,(THIS_FILE, status, "Unable to set affinity/"
+			     "scheduling of worker ioqueue %u", index));
+		status = PJ_SUCCESS;
+	    }
+	}
+
+	PJ_LOG(4,(THIS_FILE, "Worker ioqueue %u started", index));
+    }
+
+    *p_ioqueue = w->ioqueue;
+
+on_return:
+    pj_mutex_unlock(endpt->mutex);
+    return status;
+}
+
+/* Stop the worker threads and destroy the worker ioqueues */
+static void destroy_worker_ioqueues(pjsip_endpoint *endpt)
+{
+    unsigned i;
+
+    endpt->worker_quit = PJ_TRUE;
+
+    for (i=0; i<PJ_ARRAY_SIZE(endpt->worker); ++i) {
+	worker_ioq *w = &endpt->worker[i];
+
+	if (w->thread) {
+	    pj_thread_join(w->thread);
+	    pj_thread_destroy(w->thread);
+	    w->thread = NULL;
+	}
+	if (w->ioqueue) {
+	    pj_ioqueue_destroy(w->ioqueue);
+	    w->ioqueue = NULL;
+	}
+    }
+}
+
 /*
  * Find/create transport.
  */
@@ -1275,6 +1409,9 @@ PJ_DEF(void) pjsip_endpt_dump( pjsip_endpoint *endpt, pj_bool_t detail )
      */
     pjsip_tpmgr_dump_transports( endpt->transport_mgr );
 
+    /* Ioqueue. */
+    pj_ioqueue_dump(endpt->ioqueue, detail);
+
     /* Timer. */
 #if PJ_TIMER_DEBUG
     pj_timer_heap_dump(endpt->timer_heap);
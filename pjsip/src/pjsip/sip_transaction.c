@@ -32,6 +32,7 @@
 #include <pj/assert.h>
 #include <pj/guid.h>
 #include <pj/log.h>
+#include <pj/trace.h>
 
 #define THIS_FILE   "sip_transaction.c"
 
@@ -467,7 +468,12 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
 
 
     /* Create hash table. */
+#if PJSIP_RESIZABLE_HTABLE
+    mod_tsx_layer.htable = pj_hash_create_resizable(pool,
+						    pjsip_cfg()->tsx.max_count);
+#else
     mod_tsx_layer.htable = pj_hash_create( pool, pjsip_cfg()->tsx.max_count );
+#endif
     if (!mod_tsx_layer.htable) {
 	pjsip_endpt_release_pool(endpt, pool);
 	return PJ_ENOMEM;
@@ -815,7 +821,9 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
     PJ_RACE_ME(5);
 
     /* Pass the message to the transaction. */
+    PJ_TRACE_BEGIN("sip", "tsx_rx_request");
     pjsip_tsx_recv_msg(tsx, rdata );
+    PJ_TRACE_END("sip", "tsx_rx_request");
     
     pj_grp_lock_dec_ref(tsx->grp_lock);
 
@@ -869,7 +877,9 @@ static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
     PJ_RACE_ME(5);
 
     /* Pass the message to the transaction. */
+    PJ_TRACE_BEGIN("sip", "tsx_rx_response");
     pjsip_tsx_recv_msg(tsx, rdata );
+    PJ_TRACE_END("sip", "tsx_rx_response");
     
     pj_grp_lock_dec_ref(tsx->grp_lock);
 
@@ -1207,7 +1217,9 @@ static void tsx_set_state( pjsip_transaction *tsx,
 	pjsip_event e;
 	PJSIP_EVENT_INIT_TSX_STATE(e, tsx, event_src_type, event_src,
 				   prev_state);
+	PJ_TRACE_BEGIN("sip", "tsx_on_state");
 	(*tsx->tsx_user->on_tsx_state)(tsx, &e);
+	PJ_TRACE_END("sip", "tsx_on_state");
     }
     
 
@@ -1724,7 +1736,9 @@ PJ_DEF(pj_status_t) pjsip_tsx_send_msg( pjsip_transaction *tsx,
     pjsip_tx_data_set_transport(tdata, &tsx->tp_sel);
 
     /* Dispatch to state handler */
+    PJ_TRACE_BEGIN("sip", "tsx_send");
     status = (*tsx->state_handler)(tsx, &event);
+    PJ_TRACE_END("sip", "tsx_send");
 
     pj_grp_lock_release(tsx->grp_lock);
 
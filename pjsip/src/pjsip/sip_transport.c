@@ -28,6 +28,7 @@
 #include <pj/except.h>
 #include <pj/os.h>
 #include <pj/log.h>
+#include <pj/objpool.h>
 #include <pj/ioqueue.h>
 #include <pj/hash.h>
 #include <pj/string.h>
@@ -93,6 +94,12 @@ struct pjsip_tpmgr
     pj_status_t	   (*on_tx_msg)(pjsip_endpoint*, pjsip_tx_data*);
     pjsip_tp_state_callback tp_state_cb;
 
+    /* Object pool of tdata print buffers, or NULL. It is referenced by
+     * the transport manager and by each tdata holding a buffer from it.
+     */
+    pj_objpool_t    *tdata_buf_pool;
+    pj_atomic_t	    *tdata_buf_ref;
+
     /* Transmit data list, for transmit data cleanup when transport manager
      * is destroyed.
      */
@@ -450,6 +457,18 @@ PJ_DEF(void) pjsip_tx_data_add_ref( pjsip_tx_data *tdata )
     pj_atomic_inc(tdata->ref_cnt);
 }
 
+/* Release a reference to the object pool of tdata print buffers. The
+ * object pool is destroyed when both the transport manager and the last
+ * tdata using it are gone.
+ */
+static void tdata_buf_pool_dec_ref(pjsip_tpmgr *mgr)
+{
+    if (pj_atomic_dec_and_get(mgr->tdata_buf_ref) == 0) {
+	pj_objpool_destroy(mgr->tdata_buf_pool);
+	pj_atomic_destroy(mgr->tdata_buf_ref);
+    }
+}
+
 static void tx_data_destroy(pjsip_tx_data *tdata)
 {
     PJ_LOG(5,(tdata->obj_name, "Destroying txdata %s",
@@ -466,6 +485,11 @@ static void tx_data_destroy(pjsip_tx_data *tdata)
     pj_lock_release(tdata->mgr->lock);
 #endif
 
+    if (tdata->obj_buf) {
+	pj_objpool_free(tdata->mgr->tdata_buf_pool, tdata->obj_buf);
+	tdata_buf_pool_dec_ref(tdata->mgr);
+    }
+
     pj_atomic_destroy( tdata->ref_cnt );
     pj_lock_destroy( tdata->lock );
     pjsip_endpt_release_pool( tdata->mgr->endpt, tdata->pool );
@@ -505,14 +529,24 @@ PJ_DEF(pj_status_t) pjsip_tx_data_encode(pjsip_tx_data *tdata)
     if (tdata->buf.start == NULL) {
 	PJ_USE_EXCEPTION;
 
-	PJ_TRY {
-	    tdata->buf.start = (char*) 
-			       pj_pool_alloc(tdata->pool, PJSIP_MAX_PKT_LEN);
-	}
-	PJ_CATCH_ANY {
-	    return PJ_ENOMEM;
+	if (tdata->mgr->tdata_buf_pool) {
+	    tdata->obj_buf = (char*)
+			     pj_objpool_alloc(tdata->mgr->tdata_buf_pool);
+	    if (!tdata->obj_buf)
+		return PJ_ENOMEM;
+	    pj_atomic_inc(tdata->mgr->tdata_buf_ref);
+	    tdata->buf.start = tdata->obj_buf;
+
+	} else {
+	    PJ_TRY {
+		tdata->buf.start = (char*) pj_pool_alloc(tdata->pool,
+							 PJSIP_MAX_PKT_LEN);
+	    }
+	    PJ_CATCH_ANY {
+		return PJ_ENOMEM;
+	    }
+	    PJ_END
 	}
-	PJ_END
 
 	tdata->buf.cur = tdata->buf.start;
 	tdata->buf.end = tdata->buf.start + PJSIP_MAX_PKT_LEN;
@@ -1253,6 +1287,24 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_create( pj_pool_t *pool,
     }
 #endif
 
+#if PJSIP_TDATA_BUF_SLAB_CNT
+    status = pj_objpool_create(pool->factory, "tbuf%p", PJSIP_MAX_PKT_LEN,
+			       PJSIP_TDATA_BUF_SLAB_CNT,
+			       PJ_OBJPOOL_THREAD_CACHE, &mgr->tdata_buf_pool);
+    if (status == PJ_SUCCESS) {
+	status = pj_atomic_create(pool, 1, &mgr->tdata_buf_ref);
+	if (status != PJ_SUCCESS)
+	    pj_objpool_destroy(mgr->tdata_buf_pool);
+    }
+    if (status != PJ_SUCCESS) {
+#if defined(PJ_DEBUG) && PJ_DEBUG!=0
+	pj_atomic_destroy(mgr->tdata_counter);
+#endif
+	pj_lock_destroy(mgr->lock);
+	return status;
+    }
+#endif
+
     /* Set transport state callback */
     pjsip_tpmgr_set_state_cb(mgr, &tp_state_callback);
 
@@ -1556,6 +1608,10 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_destroy( pjsip_tpmgr *mgr )
     pj_atomic_destroy(mgr->tdata_counter);
 #endif
 
+    /* The tdata which are still alive keep the print buffer pool. */
+    if (mgr->tdata_buf_pool)
+	tdata_buf_pool_dec_ref(mgr);
+
     pj_lock_destroy(mgr->lock);
 
     /* Unregister mod_msg_print. */
@@ -1986,6 +2042,16 @@ PJ_DEF(void) pjsip_tpmgr_dump_transports(pjsip_tpmgr *mgr)
 	      pj_atomic_get(mgr->tdata_counter)));
 #endif
 
+    if (mgr->tdata_buf_pool) {
+	pj_objpool_stat stat;
+
+	pj_objpool_get_stat(mgr->tdata_buf_pool, &stat);
+	PJ_LOG(3,(THIS_FILE, " Print buffers: %u used (peak %u), %u "
+		  "allocated, %u allocs (%u from thread cache)",
+		  stat.used_cnt, stat.peak_cnt, stat.capacity,
+		  stat.alloc_cnt, stat.cache_hit_cnt));
+    }
+
     PJ_LOG(3, (THIS_FILE, " Dumping listeners:"));
     factory = mgr->factory_list.next;
     while (factory != &mgr->factory_list) {
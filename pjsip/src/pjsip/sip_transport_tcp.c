@@ -56,7 +56,9 @@ struct tcp_listener
     pj_bool_t		     is_registered;
     pjsip_endpoint	    *endpt;
     pjsip_tpmgr		    *tpmgr;
-    pj_activesock_t	    *asock;
+    unsigned		     asock_cnt;
+    pj_activesock_t	    *asock[PJSIP_MAX_WORKER_IOQUEUE];
+    pj_ioqueue_t	    *ioqueue[PJSIP_MAX_WORKER_IOQUEUE];
     pj_sockaddr		     bound_addr;
     pj_qos_type		     qos_type;
     pj_qos_params	     qos_params;
@@ -140,7 +142,7 @@ static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
 
 /* Common function to create and initialize transport */
 static pj_status_t tcp_create(struct tcp_listener *listener,
-			      pj_pool_t *pool,
+			      pj_pool_t *pool, pj_ioqueue_t *ioqueue,
 			      pj_sock_t sock, pj_bool_t is_server,
 			      const pj_sockaddr *local,
 			      const pj_sockaddr *remote,
@@ -224,6 +226,7 @@ PJ_DEF(void) pjsip_tcp_transport_cfg_default(pjsip_tcp_transport_cfg *cfg,
     pj_sockaddr_init(cfg->af, &cfg->bind_addr, NULL, 0);
     cfg->async_cnt = 1;
     cfg->reuse_addr = PJSIP_TCP_TRANSPORT_REUSEADDR;
+    cfg->shard_cnt = 1;
 }
 
 
@@ -231,6 +234,68 @@ PJ_DEF(void) pjsip_tcp_transport_cfg_default(pjsip_tcp_transport_cfg *cfg,
  * The TCP listener/transport factory.
  */
 
+/*
+ * Create a listener socket, bind it to the address, and start listening.
+ */
+static pj_status_t create_lis_sock(struct tcp_listener *listener,
+				   const pjsip_tcp_transport_cfg *cfg,
+				   const pj_sockaddr *addr,
+				   pj_bool_t reuse_port,
+				   pj_sock_t *p_sock)
+{
+    pj_sock_t sock;
+    pj_status_t status;
+
+    /* Create socket */
+    status = pj_sock_socket(cfg->af, pj_SOCK_STREAM(), 0, &sock);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    /* Apply QoS, if specified */
+    status = pj_sock_apply_qos2(sock, cfg->qos_type, &cfg->qos_params, 
+				2, listener->factory.obj_name, 
+				"SIP TCP listener socket");
+
+    /* Apply SO_REUSEADDR */
+    if (cfg->reuse_addr) {
+	int enabled = 1;
+	status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEADDR(),
+				    &enabled, sizeof(enabled));
+	if (status != PJ_SUCCESS) {
+	    PJ_PERROR(4,(listener->factory.obj_name, status,
+		         "Warning: error applying SO_REUSEADDR"));
+	}
+    }
+
+    /* Apply SO_REUSEPORT, which is required to open several listener
+     * sockets on the same address.
+     */
+    if (reuse_port) {
+	int enabled = 1;
+	status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEPORT(),
+				    &enabled, sizeof(enabled));
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
+    /* Bind socket */
+    status = pj_sock_bind(sock, addr, pj_sockaddr_get_len(addr));
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    /* Start listening to the address */
+    status = pj_sock_listen(sock, PJSIP_TCP_TRANSPORT_BACKLOG);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
+    *p_sock = sock;
+    return PJ_SUCCESS;
+
+on_error:
+    pj_sock_close(sock);
+    return status;
+}
+
 /*
  * This is the public API to create, initialize, register, and start the
  * TCP listener.
@@ -247,11 +312,19 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
     pj_activesock_cfg asock_cfg;
     pj_activesock_cb listener_cb;
     pj_sockaddr *listener_addr;
+    pj_sockaddr shard_addr;
+    unsigned i, sock_cnt;
     int addr_len;
     pj_status_t status;
 
     /* Sanity check */
     PJ_ASSERT_RETURN(endpt && cfg->async_cnt, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cfg->shard_cnt <= PJSIP_MAX_WORKER_IOQUEUE,
+		     PJ_ETOOMANY);
+
+    sock_cnt = cfg->shard_cnt ? cfg->shard_cnt : 1;
+    if (sock_cnt > 1 && pj_SO_REUSEPORT() == 0xFFFF)
+	return PJ_ENOTSUP;
 
     /* Verify that address given in a_name (if any) is valid */
     if (cfg->addr_name.host.slen) {
@@ -295,38 +368,17 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
 	goto on_error;
 
 
-    /* Create socket */
-    status = pj_sock_socket(cfg->af, pj_SOCK_STREAM(), 0, &sock);
-    if (status != PJ_SUCCESS)
-	goto on_error;
-
-    /* Apply QoS, if specified */
-    status = pj_sock_apply_qos2(sock, cfg->qos_type, &cfg->qos_params, 
-				2, listener->factory.obj_name, 
-				"SIP TCP listener socket");
-
-    /* Apply SO_REUSEADDR */
-    if (cfg->reuse_addr) {
-	int enabled = 1;
-	status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEADDR(),
-				    &enabled, sizeof(enabled));
-	if (status != PJ_SUCCESS) {
-	    PJ_PERROR(4,(listener->factory.obj_name, status,
-		         "Warning: error applying SO_REUSEADDR"));
-	}
-    }
-
     /* Bind address may be different than factory.local_addr because
      * factory.local_addr will be resolved below.
      */
     pj_sockaddr_cp(&listener->bound_addr, &cfg->bind_addr);
 
-    /* Bind socket */
+    /* Create the first listener socket */
     listener_addr = &listener->factory.local_addr;
     pj_sockaddr_cp(listener_addr, &cfg->bind_addr);
 
-    status = pj_sock_bind(sock, listener_addr, 
-			  pj_sockaddr_get_len(listener_addr));
+    status = create_lis_sock(listener, cfg, listener_addr, (sock_cnt > 1),
+			     &sock);
     if (status != PJ_SUCCESS)
 	goto on_error;
 
@@ -336,6 +388,10 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
     if (status != PJ_SUCCESS)
 	goto on_error;
 
+    /* The other listener sockets are bound to the same address and port */
+    pj_sockaddr_cp(&shard_addr, &listener->bound_addr);
+    pj_sockaddr_set_port(&shard_addr, pj_sockaddr_get_port(listener_addr));
+
     /* If published host/IP is specified, then use that address as the
      * listener advertised address.
      */
@@ -379,13 +435,9 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
 		     "tcplis:%d",  listener->factory.addr_name.port);
 
 
-    /* Start listening to the address */
-    status = pj_sock_listen(sock, PJSIP_TCP_TRANSPORT_BACKLOG);
-    if (status != PJ_SUCCESS)
-	goto on_error;
-
-
-    /* Create active socket */
+    /* Create active sockets. When there are several listener sockets,
+     * each of them is registered to its own worker ioqueue.
+     */
     pj_activesock_cfg_default(&asock_cfg);
     if (cfg->async_cnt > MAX_ASYNC_CNT) 
 	asock_cfg.async_cnt = MAX_ASYNC_CNT;
@@ -394,10 +446,35 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
 
     pj_bzero(&listener_cb, sizeof(listener_cb));
     listener_cb.on_accept_complete = &on_accept_complete;
-    status = pj_activesock_create(pool, sock, pj_SOCK_STREAM(), &asock_cfg,
-				  pjsip_endpt_get_ioqueue(endpt), 
-				  &listener_cb, listener,
-				  &listener->asock);
+
+    for (i=0; i<sock_cnt; ++i) {
+	pj_ioqueue_t *ioqueue;
+
+	if (i > 0) {
+	    status = create_lis_sock(listener, cfg, &shard_addr, PJ_TRUE,
+				     &sock);
+	    if (status != PJ_SUCCESS)
+		goto on_error;
+	}
+
+	if (sock_cnt > 1) {
+	    status = pjsip_endpt_get_worker_ioqueue(endpt, i, &ioqueue);
+	    if (status != PJ_SUCCESS)
+		goto on_error;
+	} else {
+	    ioqueue = pjsip_endpt_get_ioqueue(endpt);
+	}
+
+	status = pj_activesock_create(pool, sock, pj_SOCK_STREAM(),
+				      &asock_cfg, ioqueue, &listener_cb,
+				      listener, &listener->asock[i]);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	listener->ioqueue[i] = ioqueue;
+	listener->asock_cnt++;
+	sock = PJ_INVALID_SOCKET;
+    }
 
     /* Register to transport manager */
     listener->endpt = endpt;
@@ -413,9 +490,11 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
     }
 
     /* Start pending accept() operations */
-    status = pj_activesock_start_accept(listener->asock, pool);
-    if (status != PJ_SUCCESS)
-	goto on_error;
+    for (i=0; i<listener->asock_cnt; ++i) {
+	status = pj_activesock_start_accept(listener->asock[i], pool);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
 
     PJ_LOG(4,(listener->factory.obj_name, 
 	     "SIP TCP listener ready for incoming connections at %.*s:%d",
@@ -423,13 +502,19 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
 	     listener->factory.addr_name.host.ptr,
 	     listener->factory.addr_name.port));
 
+    if (listener->asock_cnt > 1) {
+	PJ_LOG(4,(listener->factory.obj_name, 
+		  "Accepting with %u sockets (SO_REUSEPORT)",
+		  listener->asock_cnt));
+    }
+
     /* Return the pointer to user */
     if (p_factory) *p_factory = &listener->factory;
 
     return PJ_SUCCESS;
 
 on_error:
-    if (listener->asock==NULL && sock!=PJ_INVALID_SOCKET)
+    if (sock != PJ_INVALID_SOCKET)
 	pj_sock_close(sock);
     lis_destroy(&listener->factory);
     return status;
@@ -488,9 +573,10 @@ static pj_status_t lis_destroy(pjsip_tpfactory *factory)
 	listener->is_registered = PJ_FALSE;
     }
 
-    if (listener->asock) {
-	pj_activesock_close(listener->asock);
-	listener->asock = NULL;
+    while (listener->asock_cnt) {
+	--listener->asock_cnt;
+	pj_activesock_close(listener->asock[listener->asock_cnt]);
+	listener->asock[listener->asock_cnt] = NULL;
     }
 
     if (listener->factory.lock) {
@@ -561,14 +647,13 @@ static void tcp_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e);
  * pending connect() complete.
  */
 static pj_status_t tcp_create( struct tcp_listener *listener,
-			       pj_pool_t *pool,
+			       pj_pool_t *pool, pj_ioqueue_t *ioqueue,
 			       pj_sock_t sock, pj_bool_t is_server,
 			       const pj_sockaddr *local,
 			       const pj_sockaddr *remote,
 			       struct tcp_transport **p_tcp)
 {
     struct tcp_transport *tcp;
-    pj_ioqueue_t *ioqueue;
     pj_activesock_cfg asock_cfg;
     pj_activesock_cb tcp_callback;
     const pj_str_t ka_pkt = PJSIP_TCP_KEEP_ALIVE_DATA;
@@ -642,7 +727,6 @@ static pj_status_t tcp_create( struct tcp_listener *listener,
     tcp_callback.on_data_sent = &on_data_sent;
     tcp_callback.on_connect_complete = &on_connect_complete;
 
-    ioqueue = pjsip_endpt_get_ioqueue(listener->endpt);
     status = pj_activesock_create(pool, sock, pj_SOCK_STREAM(), &asock_cfg,
 				  ioqueue, &tcp_callback, tcp, &tcp->asock);
     if (status != PJ_SUCCESS) {
@@ -944,8 +1028,8 @@ static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
     }
 
     /* Create the transport descriptor */
-    status = tcp_create(listener, NULL, sock, PJ_FALSE, &local_addr, 
-			rem_addr, &tcp);
+    status = tcp_create(listener, NULL, pjsip_endpt_get_ioqueue(endpt), sock,
+			PJ_FALSE, &local_addr, rem_addr, &tcp);
     if (status != PJ_SUCCESS)
 	return status;
 
@@ -1013,12 +1097,25 @@ static pj_bool_t on_accept_complete(pj_activesock_t *asock,
     char addr[PJ_INET6_ADDRSTRLEN+10];
     pjsip_tp_state_callback state_cb;
     pj_sockaddr tmp_src_addr;
+    pj_ioqueue_t *ioqueue;
+    unsigned i;
     pj_status_t status;
 
     PJ_UNUSED_ARG(src_addr_len);
 
     listener = (struct tcp_listener*) pj_activesock_get_user_data(asock);
 
+    /* The connection is served by the ioqueue of the listener socket
+     * which accepted it.
+     */
+    ioqueue = listener->ioqueue[0];
+    for (i=1; i<listener->asock_cnt; ++i) {
+	if (listener->asock[i] == asock) {
+	    ioqueue = listener->ioqueue[i];
+	    break;
+	}
+    }
+
     PJ_ASSERT_RETURN(sock != PJ_INVALID_SOCKET, PJ_TRUE);
 
     PJ_LOG(4,(listener->factory.obj_name, 
@@ -1046,7 +1143,7 @@ static pj_bool_t on_accept_complete(pj_activesock_t *asock,
      * Incoming connection!
      * Create TCP transport for the new socket.
      */
-    status = tcp_create( listener, NULL, sock, PJ_TRUE,
+    status = tcp_create( listener, NULL, ioqueue, sock, PJ_TRUE,
 			 &listener->factory.local_addr,
 			 &tmp_src_addr, &tcp);
     if (status == PJ_SUCCESS) {
@@ -1062,7 +1159,7 @@ static pj_bool_t on_accept_complete(pj_activesock_t *asock,
 					   &tcp->ka_timer, 
 					   &delay);
 		tcp->ka_timer.id = PJ_TRUE;
-		pj_gettimeofday(&tcp->last_activity);
+		pj_gettimeofday_coarse(&tcp->last_activity);
 	    }
 
 	    /* Notify application of transport state accepted */
@@ -1107,7 +1204,7 @@ static pj_bool_t on_data_sent(pj_activesock_t *asock,
 	tdata_op_key->callback(&tcp->base, tdata_op_key->token, bytes_sent);
 
 	/* Mark last activity time */
-	pj_gettimeofday(&tcp->last_activity);
+	pj_gettimeofday_coarse(&tcp->last_activity);
 
     }
 
@@ -1283,14 +1380,14 @@ static pj_bool_t on_data_read(pj_activesock_t *asock,
 	pj_size_t size_eaten;
 
 	/* Mark this as an activity */
-	pj_gettimeofday(&tcp->last_activity);
+	pj_gettimeofday_coarse(&tcp->last_activity);
 
 	pj_assert((void*)rdata->pkt_info.packet == data);
 
 	/* Init pkt_info part. */
 	rdata->pkt_info.len = size;
 	rdata->pkt_info.zero = 0;
-	pj_gettimeofday(&rdata->pkt_info.timestamp);
+	pj_gettimeofday_coarse(&rdata->pkt_info.timestamp);
 
 	/* Report to transport manager.
 	 * The transport manager will tell us how many bytes of the packet
@@ -1418,7 +1515,7 @@ static pj_bool_t on_connect_complete(pj_activesock_t *asock,
 	pjsip_endpt_schedule_timer(tcp->base.endpt, &tcp->ka_timer, 
 				   &delay);
 	tcp->ka_timer.id = PJ_TRUE;
-	pj_gettimeofday(&tcp->last_activity);
+	pj_gettimeofday_coarse(&tcp->last_activity);
     }
 
     return PJ_TRUE;
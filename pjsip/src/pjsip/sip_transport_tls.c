@@ -348,6 +348,7 @@ PJ_DEF(pj_status_t) pjsip_tls_transport_start2( pjsip_endpoint *endpt,
     ssock_param.qos_ignore_error = listener->tls_setting.qos_ignore_error;
     pj_memcpy(&ssock_param.qos_params, &listener->tls_setting.qos_params,
 	      sizeof(ssock_param.qos_params));
+    ssock_param.handshake_exec = listener->tls_setting.handshake_exec;
 
     has_listener = PJ_FALSE;
 
@@ -952,6 +953,7 @@ static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
     ssock_param.qos_ignore_error = listener->tls_setting.qos_ignore_error;
     pj_memcpy(&ssock_param.qos_params, &listener->tls_setting.qos_params,
 	      sizeof(ssock_param.qos_params));
+    ssock_param.handshake_exec = listener->tls_setting.handshake_exec;
 
     switch(listener->tls_setting.method) {
     case PJSIP_TLSV1_METHOD:
@@ -1178,7 +1180,7 @@ static pj_bool_t on_accept_complete(pj_ssl_sock_t *ssock,
 				       &tls->ka_timer, 
 				       &delay);
 	    tls->ka_timer.id = PJ_TRUE;
-	    pj_gettimeofday(&tls->last_activity);
+	    pj_gettimeofday_coarse(&tls->last_activity);
 	}
     }
 
@@ -1213,7 +1215,7 @@ static pj_bool_t on_data_sent(pj_ssl_sock_t *ssock,
 	tdata_op_key->callback(&tls->base, tdata_op_key->token, bytes_sent);
 
 	/* Mark last activity time */
-	pj_gettimeofday(&tls->last_activity);
+	pj_gettimeofday_coarse(&tls->last_activity);
 
     }
 
@@ -1389,14 +1391,14 @@ static pj_bool_t on_data_read(pj_ssl_sock_t *ssock,
 	pj_size_t size_eaten;
 
 	/* Mark this as an activity */
-	pj_gettimeofday(&tls->last_activity);
+	pj_gettimeofday_coarse(&tls->last_activity);
 
 	pj_assert((void*)rdata->pkt_info.packet == data);
 
 	/* Init pkt_info part. */
 	rdata->pkt_info.len = size;
 	rdata->pkt_info.zero = 0;
-	pj_gettimeofday(&rdata->pkt_info.timestamp);
+	pj_gettimeofday_coarse(&rdata->pkt_info.timestamp);
 
 	/* Report to transport manager.
 	 * The transport manager will tell us how many bytes of the packet
@@ -1634,7 +1636,7 @@ static pj_bool_t on_connect_complete(pj_ssl_sock_t *ssock,
 	pjsip_endpt_schedule_timer(tls->base.endpt, &tls->ka_timer, 
 				   &delay);
 	tls->ka_timer.id = PJ_TRUE;
-	pj_gettimeofday(&tls->last_activity);
+	pj_gettimeofday_coarse(&tls->last_activity);
     }
 
     return PJ_TRUE;
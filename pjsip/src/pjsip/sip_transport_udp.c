@@ -66,14 +66,29 @@
 #endif
 
 
+/* Extra socket of a transport that is sharded with SO_REUSEPORT */
+struct udp_shard
+{
+    pj_sock_t		sock;
+    pj_ioqueue_key_t   *key;
+};
+
+
 /* Struct udp_transport "inherits" struct pjsip_transport */
 struct udp_transport
 {
     pjsip_transport	base;
     pj_sock_t		sock;
     pj_ioqueue_key_t   *key;
+    pj_ioqueue_t       *ioqueue;
     int			rdata_cnt;
     pjsip_rx_data     **rdata;
+    unsigned		async_cnt;
+    unsigned		shard_cnt;
+    struct udp_shard   *shard;
+#if PJSIP_UDP_RX_BATCH > 1
+    pjsip_rx_data     **batch_rdata;
+#endif
     int			is_closing;
     pj_bool_t		is_paused;
 };
@@ -108,6 +123,132 @@ static void init_rdata(struct udp_transport *tp, unsigned rdata_index,
 }
 
 
+/*
+ * Get the ioqueue key of the socket which the rdata reads from. The first
+ * async_cnt rdata belong to the first socket, and the next ones to the
+ * extra sockets of a sharded transport, in order.
+ */
+static pj_ioqueue_key_t *rdata_key(struct udp_transport *tp,
+				   unsigned rdata_index)
+{
+    unsigned i = rdata_index / tp->async_cnt;
+
+    return i==0 ? tp->key : tp->shard[i-1].key;
+}
+
+
+/*
+ * Report the packet that has been received in rdata to the transport
+ * manager.
+ */
+static void udp_on_packet(pjsip_rx_data *rdata, pj_ssize_t bytes_read)
+{
+    pj_size_t size_eaten;
+    const pj_sockaddr *src_addr = &rdata->pkt_info.src_addr;
+
+    /* Init pkt_info part. */
+    rdata->pkt_info.len = bytes_read;
+    rdata->pkt_info.zero = 0;
+    pj_gettimeofday_coarse(&rdata->pkt_info.timestamp);
+    if (src_addr->addr.sa_family == pj_AF_INET()) {
+	pj_ansi_strcpy(rdata->pkt_info.src_name,
+		       pj_inet_ntoa(src_addr->ipv4.sin_addr));
+	rdata->pkt_info.src_port = pj_ntohs(src_addr->ipv4.sin_port);
+    } else {
+	pj_inet_ntop(pj_AF_INET6(), 
+		     pj_sockaddr_get_addr(&rdata->pkt_info.src_addr),
+		     rdata->pkt_info.src_name,
+		     sizeof(rdata->pkt_info.src_name));
+	rdata->pkt_info.src_port = pj_ntohs(src_addr->ipv6.sin6_port);
+    }
+
+    size_eaten = 
+	pjsip_tpmgr_receive_packet(rdata->tp_info.transport->tpmgr, 
+				   rdata);
+
+    if (size_eaten < 0) {
+	pj_assert(!"It shouldn't happen!");
+	size_eaten = rdata->pkt_info.len;
+    }
+
+    /* Since this is UDP, the whole buffer is the message. */
+    rdata->pkt_info.len = 0;
+}
+
+
+#if PJSIP_UDP_RX_BATCH > 1
+/*
+ * Initialize one of the extra rdata used for batch receive.
+ */
+static void init_batch_rdata(struct udp_transport *tp, unsigned batch_index,
+			     pj_pool_t *pool)
+{
+    pjsip_rx_data *rdata;
+
+    rdata = PJ_POOL_ZALLOC_T(pool, pjsip_rx_data);
+    rdata->tp_info.pool = pool;
+    rdata->tp_info.transport = &tp->base;
+    rdata->tp_info.tp_data = (void*)(pj_ssize_t)batch_index;
+    rdata->tp_info.op_key.rdata = rdata;
+
+    tp->batch_rdata[batch_index] = rdata;
+}
+
+
+/*
+ * Get the socket which the rdata reads from, see rdata_key().
+ */
+static pj_sock_t rdata_sock(struct udp_transport *tp, unsigned rdata_index)
+{
+    unsigned i = rdata_index / tp->async_cnt;
+
+    return i==0 ? tp->sock : tp->shard[i-1].sock;
+}
+
+
+/*
+ * Read the packets that are already queued in the socket with a single
+ * call, using the extra rdata that belong to the specified rdata index.
+ */
+static void udp_read_batch(struct udp_transport *tp, unsigned rdata_index)
+{
+    enum { MIN_SIZE = 32, BATCH = PJSIP_UDP_RX_BATCH - 1 };
+    pj_sock_msg msg[BATCH];
+    unsigned i, count = BATCH;
+    unsigned first = rdata_index * BATCH;
+
+    for (i=0; i<count; ++i) {
+	pjsip_rx_data *rdata = tp->batch_rdata[first+i];
+
+	msg[i].buf = rdata->pkt_info.packet;
+	msg[i].len = sizeof(rdata->pkt_info.packet);
+	msg[i].addr_len = sizeof(msg[i].addr);
+    }
+
+    if (pj_sock_recvmmsg(rdata_sock(tp, rdata_index), msg, &count,
+			 0) != PJ_SUCCESS)
+    {
+	return;
+    }
+
+    for (i=0; i<count; ++i) {
+	pjsip_rx_data *rdata = tp->batch_rdata[first+i];
+	pj_pool_t *rdata_pool = rdata->tp_info.pool;
+
+	if (msg[i].len > MIN_SIZE && !tp->is_closing) {
+	    pj_memcpy(&rdata->pkt_info.src_addr, &msg[i].addr,
+		      msg[i].addr_len);
+	    rdata->pkt_info.src_addr_len = msg[i].addr_len;
+	    udp_on_packet(rdata, msg[i].len);
+	}
+
+	pj_pool_reset(rdata_pool);
+	init_batch_rdata(tp, first+i, rdata_pool);
+    }
+}
+#endif	/* PJSIP_UDP_RX_BATCH > 1 */
+
+
 /*
  * udp_on_read_complete()
  *
@@ -150,36 +291,7 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
 	 * is relatively big enough for a SIP packet.
 	 */
 	if (bytes_read > MIN_SIZE) {
-	    pj_size_t size_eaten;
-	    const pj_sockaddr *src_addr = &rdata->pkt_info.src_addr;
-
-	    /* Init pkt_info part. */
-	    rdata->pkt_info.len = bytes_read;
-	    rdata->pkt_info.zero = 0;
-	    pj_gettimeofday(&rdata->pkt_info.timestamp);
-	    if (src_addr->addr.sa_family == pj_AF_INET()) {
-		pj_ansi_strcpy(rdata->pkt_info.src_name,
-			       pj_inet_ntoa(src_addr->ipv4.sin_addr));
-		rdata->pkt_info.src_port = pj_ntohs(src_addr->ipv4.sin_port);
-	    } else {
-		pj_inet_ntop(pj_AF_INET6(), 
-			     pj_sockaddr_get_addr(&rdata->pkt_info.src_addr),
-			     rdata->pkt_info.src_name,
-			     sizeof(rdata->pkt_info.src_name));
-		rdata->pkt_info.src_port = pj_ntohs(src_addr->ipv6.sin6_port);
-	    }
-
-	    size_eaten = 
-		pjsip_tpmgr_receive_packet(rdata->tp_info.transport->tpmgr, 
-					   rdata);
-
-	    if (size_eaten < 0) {
-		pj_assert(!"It shouldn't happen!");
-		size_eaten = rdata->pkt_info.len;
-	    }
-
-	    /* Since this is UDP, the whole buffer is the message. */
-	    rdata->pkt_info.len = 0;
+	    udp_on_packet(rdata, bytes_read);
 
 	} else if (bytes_read <= MIN_SIZE) {
 
@@ -198,6 +310,14 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
 				   " callback error"));
 	}
 
+#if PJSIP_UDP_RX_BATCH > 1
+	/* Also read packets that are already queued in the socket */
+	if (bytes_read > 0 && !tp->is_paused && tp->batch_rdata) {
+	    udp_read_batch(tp, (unsigned)(unsigned long)(pj_ssize_t)
+			       rdata->tp_info.tp_data);
+	}
+#endif
+
 	if (i >= MAX_IMMEDIATE_PACKET) {
 	    /* Force ioqueue_recvfrom() to return PJ_EPENDING */
 	    flags = PJ_IOQUEUE_ALWAYS_ASYNC;
@@ -383,6 +503,17 @@ static pj_status_t udp_destroy( pjsip_transport *transport )
 	}
     }
 
+    /* Likewise for the extra sockets of a sharded transport. */
+    for (i=0; i<(int)tp->shard_cnt; ++i) {
+	if (tp->shard[i].key) {
+	    pj_ioqueue_unregister(tp->shard[i].key);
+	    tp->shard[i].key = NULL;
+	} else if (tp->shard[i].sock != PJ_INVALID_SOCKET) {
+	    pj_sock_close(tp->shard[i].sock);
+	    tp->shard[i].sock = PJ_INVALID_SOCKET;
+	}
+    }
+
     /* Must poll ioqueue because IOCP calls the callback when socket
      * is closed. We poll the ioqueue until all pending callbacks 
      * have been called.
@@ -391,8 +522,7 @@ static pj_status_t udp_destroy( pjsip_transport *transport )
 	int cnt;
 	pj_time_val timeout = {0, 1};
 
-	cnt = pj_ioqueue_poll(pjsip_endpt_get_ioqueue(transport->endpt), 
-			      &timeout);
+	cnt = pj_ioqueue_poll(tp->ioqueue, &timeout);
 	if (cnt == 0)
 	    break;
     }
@@ -401,6 +531,12 @@ static pj_status_t udp_destroy( pjsip_transport *transport )
     for (i=0; i<tp->rdata_cnt; ++i) {
 	pj_pool_release(tp->rdata[i]->tp_info.pool);
     }
+#if PJSIP_UDP_RX_BATCH > 1
+    for (i=0; tp->batch_rdata && i<tp->rdata_cnt*(PJSIP_UDP_RX_BATCH-1); ++i) {
+	if (tp->batch_rdata[i])
+	    pj_pool_release(tp->batch_rdata[i]->tp_info.pool);
+    }
+#endif
 
     /* Destroy reference counter. */
     if (tp->base.ref_cnt)
@@ -430,7 +566,8 @@ static pj_status_t udp_shutdown(pjsip_transport *transport)
 
 /* Create socket */
 static pj_status_t create_socket(int af, const pj_sockaddr_t *local_a,
-				 int addr_len, pj_sock_t *p_sock)
+				 int addr_len, pj_bool_t reuse_port,
+				 pj_sock_t *p_sock)
 {
     pj_sock_t sock;
     pj_sockaddr_in tmp_addr;
@@ -441,6 +578,20 @@ static pj_status_t create_socket(int af, const pj_sockaddr_t *local_a,
     if (status != PJ_SUCCESS)
 	return status;
 
+    /* Allow the other sockets of a sharded transport to be bound to
+     * the same address.
+     */
+    if (reuse_port) {
+	int enabled = 1;
+
+	status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEPORT(),
+				    &enabled, sizeof(enabled));
+	if (status != PJ_SUCCESS) {
+	    pj_sock_close(sock);
+	    return status;
+	}
+    }
+
     if (local_a == NULL) {
 	if (af == pj_AF_INET6()) {
 	    pj_bzero(&tmp_addr6, sizeof(tmp_addr6));
@@ -600,21 +751,43 @@ static void udp_set_socket(struct udp_transport *tp,
 /* Register socket to ioqueue */
 static pj_status_t register_to_ioqueue(struct udp_transport *tp)
 {
-    pj_ioqueue_t *ioqueue;
     pj_ioqueue_callback ioqueue_cb;
+    unsigned i;
+    pj_status_t status;
 
     /* Ignore if already registered */
     if (tp->key != NULL)
     	return PJ_SUCCESS;
     
     /* Register to ioqueue. */
-    ioqueue = pjsip_endpt_get_ioqueue(tp->base.endpt);
     pj_memset(&ioqueue_cb, 0, sizeof(ioqueue_cb));
     ioqueue_cb.on_read_complete = &udp_on_read_complete;
     ioqueue_cb.on_write_complete = &udp_on_write_complete;
 
-    return pj_ioqueue_register_sock(tp->base.pool, ioqueue, tp->sock, tp,
-				    &ioqueue_cb, &tp->key);
+    status = pj_ioqueue_register_sock(tp->base.pool, tp->ioqueue, tp->sock,
+				      tp, &ioqueue_cb, &tp->key);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    /* Each extra socket of a sharded transport is registered to the next
+     * worker ioqueue of the endpoint.
+     */
+    for (i=0; i<tp->shard_cnt; ++i) {
+	pj_ioqueue_t *ioqueue;
+
+	status = pjsip_endpt_get_worker_ioqueue(tp->base.endpt, i+1,
+						&ioqueue);
+	if (status != PJ_SUCCESS)
+	    return status;
+
+	status = pj_ioqueue_register_sock(tp->base.pool, ioqueue,
+					  tp->shard[i].sock, tp, &ioqueue_cb,
+					  &tp->shard[i].key);
+	if (status != PJ_SUCCESS)
+	    return status;
+    }
+
+    return PJ_SUCCESS;
 }
 
 /* Start ioqueue asynchronous reading to all rdata */
@@ -625,11 +798,12 @@ static pj_status_t start_async_read(struct udp_transport *tp)
 
     /* Start reading the ioqueue. */
     for (i=0; i<tp->rdata_cnt; ++i) {
+	pj_ioqueue_key_t *key = rdata_key(tp, i);
 	pj_ssize_t size;
 
 	size = sizeof(tp->rdata[i]->pkt_info.packet);
 	tp->rdata[i]->pkt_info.src_addr_len = sizeof(tp->rdata[i]->pkt_info.src_addr);
-	status = pj_ioqueue_recvfrom(tp->key, 
+	status = pj_ioqueue_recvfrom(key, 
 				     &tp->rdata[i]->tp_info.op_key.op_key,
 				     tp->rdata[i]->pkt_info.packet,
 				     &size, PJ_IOQUEUE_ALWAYS_ASYNC,
@@ -637,7 +811,7 @@ static pj_status_t start_async_read(struct udp_transport *tp)
 				     &tp->rdata[i]->pkt_info.src_addr_len);
 	if (status == PJ_SUCCESS) {
 	    pj_assert(!"Shouldn't happen because PJ_IOQUEUE_ALWAYS_ASYNC!");
-	    udp_on_read_complete(tp->key, &tp->rdata[i]->tp_info.op_key.op_key,
+	    udp_on_read_complete(key, &tp->rdata[i]->tp_info.op_key.op_key,
 				 size);
 	} else if (status != PJ_EPENDING) {
 	    /* Error! */
@@ -659,12 +833,14 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
 				     pj_sock_t sock,
 				     const pjsip_host_port *a_name,
 				     unsigned async_cnt,
+				     const pj_sock_t shard_sock[],
+				     unsigned shard_cnt,
 				     pjsip_transport **p_transport)
 {
     pj_pool_t *pool;
     struct udp_transport *tp;
     const char *format, *ipv6_quoteb, *ipv6_quotee;
-    unsigned i;
+    unsigned i, rdata_cnt;
     pj_status_t status;
 
     PJ_ASSERT_RETURN(endpt && sock!=PJ_INVALID_SOCKET && a_name && async_cnt>0,
@@ -694,6 +870,24 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
 
     pj_memcpy(tp->base.obj_name, pool->obj_name, PJ_MAX_OBJ_NAME);
 
+    /* Attach the extra sockets of a sharded transport. The first socket
+     * is then polled by the first worker ioqueue of the endpoint instead
+     * of the endpoint's ioqueue.
+     */
+    tp->ioqueue = pjsip_endpt_get_ioqueue(endpt);
+    tp->async_cnt = async_cnt;
+    if (shard_cnt) {
+	tp->shard_cnt = shard_cnt;
+	tp->shard = (struct udp_shard*)
+		    pj_pool_calloc(pool, shard_cnt, sizeof(struct udp_shard));
+	for (i=0; i<shard_cnt; ++i)
+	    tp->shard[i].sock = shard_sock[i];
+
+	status = pjsip_endpt_get_worker_ioqueue(endpt, 0, &tp->ioqueue);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
     /* Init reference counter. */
     status = pj_atomic_create(pool, 0, &tp->base.ref_cnt);
     if (status != PJ_SUCCESS)
@@ -769,12 +963,13 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
 	goto on_error;
 
 
-    /* Create rdata and put it in the array. */
+    /* Create rdata for each socket and put it in the array. */
+    rdata_cnt = async_cnt * (shard_cnt + 1);
     tp->rdata_cnt = 0;
     tp->rdata = (pjsip_rx_data**)
-    		pj_pool_calloc(tp->base.pool, async_cnt, 
+    		pj_pool_calloc(tp->base.pool, rdata_cnt, 
 			       sizeof(pjsip_rx_data*));
-    for (i=0; i<async_cnt; ++i) {
+    for (i=0; i<rdata_cnt; ++i) {
 	pj_pool_t *rdata_pool = pjsip_endpt_create_pool(endpt, "rtd%p", 
 							PJSIP_POOL_RDATA_LEN,
 							PJSIP_POOL_RDATA_INC);
@@ -788,6 +983,33 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
 	tp->rdata_cnt++;
     }
 
+#if PJSIP_UDP_RX_BATCH > 1
+    /* Create the extra rdata for batch receive. The extra packets are read
+     * directly from the socket, which only keeps them in order if the
+     * ioqueue doesn't submit the reads beforehand.
+     */
+    if (pj_ioqueue_get_features() & PJ_IOQUEUE_FEATURE_DIRECT_READ) {
+	tp->batch_rdata = (pjsip_rx_data**)
+			  pj_pool_calloc(tp->base.pool, 
+					 rdata_cnt * (PJSIP_UDP_RX_BATCH-1),
+					 sizeof(pjsip_rx_data*));
+	for (i=0; i<rdata_cnt * (PJSIP_UDP_RX_BATCH-1); ++i) {
+	    pj_pool_t *rdata_pool;
+
+	    rdata_pool = pjsip_endpt_create_pool(endpt, "rtb%p",
+						 PJSIP_POOL_RDATA_LEN,
+						 PJSIP_POOL_RDATA_INC);
+	    if (!rdata_pool) {
+		pj_atomic_set(tp->base.ref_cnt, 0);
+		pjsip_transport_destroy(&tp->base);
+		return PJ_ENOMEM;
+	    }
+
+	    init_batch_rdata(tp, i, rdata_pool);
+	}
+    }
+#endif
+
     /* Start reading the ioqueue. */
     status = start_async_read(tp);
     if (status != PJ_SUCCESS) {
@@ -808,6 +1030,12 @@ static pj_status_t transport_attach( pjsip_endpoint *endpt,
 	      ipv6_quotee,
 	      tp->base.local_name.port));
 
+    if (tp->shard_cnt) {
+	PJ_LOG(4,(tp->base.obj_name,
+		  "Receiving with %u sockets (SO_REUSEPORT)",
+		  tp->shard_cnt + 1));
+    }
+
     return PJ_SUCCESS;
 
 on_error:
@@ -823,7 +1051,7 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_attach( pjsip_endpoint *endpt,
 						pjsip_transport **p_transport)
 {
     return transport_attach(endpt, PJSIP_TRANSPORT_UDP, sock, a_name,
-			    async_cnt, p_transport);
+			    async_cnt, NULL, 0, p_transport);
 }
 
 PJ_DEF(pj_status_t) pjsip_udp_transport_attach2( pjsip_endpoint *endpt,
@@ -834,7 +1062,7 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_attach2( pjsip_endpoint *endpt,
 						 pjsip_transport **p_transport)
 {
     return transport_attach(endpt, type, sock, a_name,
-			    async_cnt, p_transport);
+			    async_cnt, NULL, 0, p_transport);
 }
 
 /*
@@ -856,7 +1084,7 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start( pjsip_endpoint *endpt,
     PJ_ASSERT_RETURN(endpt && async_cnt, PJ_EINVAL);
 
     status = create_socket(pj_AF_INET(), local_a, sizeof(pj_sockaddr_in), 
-			   &sock);
+			   PJ_FALSE, &sock);
     if (status != PJ_SUCCESS)
 	return status;
 
@@ -898,7 +1126,7 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start6(pjsip_endpoint *endpt,
     PJ_ASSERT_RETURN(endpt && async_cnt, PJ_EINVAL);
 
     status = create_socket(pj_AF_INET6(), local_a, sizeof(pj_sockaddr_in6), 
-			   &sock);
+			   PJ_FALSE, &sock);
     if (status != PJ_SUCCESS)
 	return status;
 
@@ -920,6 +1148,103 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_start6(pjsip_endpoint *endpt,
 				       sock, a_name, async_cnt, p_transport);
 }
 
+/*
+ * Initialize pjsip_udp_transport_cfg structure with default values.
+ */
+PJ_DEF(void) pjsip_udp_transport_cfg_default(pjsip_udp_transport_cfg *cfg,
+					     int af)
+{
+    pj_bzero(cfg, sizeof(*cfg));
+    cfg->af = af;
+    pj_sockaddr_init(cfg->af, &cfg->bind_addr, NULL, 0);
+    cfg->async_cnt = 1;
+    cfg->shard_cnt = 1;
+}
+
+
+/*
+ * pjsip_udp_transport_start2()
+ *
+ * Create the UDP socket(s) with the specified settings and start a
+ * transport.
+ */
+PJ_DEF(pj_status_t) pjsip_udp_transport_start2(
+					pjsip_endpoint *endpt,
+					const pjsip_udp_transport_cfg *cfg,
+					pjsip_transport **p_transport)
+{
+    pjsip_transport_type_e type;
+    pj_sock_t sock[PJSIP_MAX_WORKER_IOQUEUE];
+    unsigned i, sock_cnt = 0, shard_cnt;
+    pj_sockaddr bound_addr;
+    char addr_buf[PJ_INET6_ADDRSTRLEN];
+    pjsip_host_port bound_name;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt && cfg && cfg->async_cnt, PJ_EINVAL);
+    PJ_ASSERT_RETURN(cfg->af==pj_AF_INET() || cfg->af==pj_AF_INET6(),
+		     PJ_EAFNOTSUP);
+    PJ_ASSERT_RETURN(cfg->shard_cnt <= PJSIP_MAX_WORKER_IOQUEUE,
+		     PJ_ETOOMANY);
+
+    shard_cnt = cfg->shard_cnt ? cfg->shard_cnt : 1;
+    if (shard_cnt > 1 && pj_SO_REUSEPORT() == 0xFFFF)
+	return PJ_ENOTSUP;
+
+    /* The first socket is bound to the specified address, and the others
+     * to the same address and the port that the first one is bound to.
+     */
+    pj_sockaddr_cp(&bound_addr, &cfg->bind_addr);
+    for (i=0; i<shard_cnt; ++i) {
+	status = create_socket(cfg->af, &bound_addr,
+			       pj_sockaddr_get_len(&bound_addr),
+			       (shard_cnt > 1), &sock[i]);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	++sock_cnt;
+
+	if (i == 0 && pj_sockaddr_get_port(&bound_addr) == 0) {
+	    pj_sockaddr tmp_addr;
+	    int addr_len = sizeof(tmp_addr);
+
+	    status = pj_sock_getsockname(sock[0], &tmp_addr, &addr_len);
+	    if (status != PJ_SUCCESS)
+		goto on_error;
+
+	    pj_sockaddr_set_port(&bound_addr,
+				 pj_sockaddr_get_port(&tmp_addr));
+	}
+    }
+
+    if (cfg->addr_name.host.slen) {
+	/* Use the published address, with the bound port if the port
+	 * is not specified.
+	 */
+	bound_name = cfg->addr_name;
+	if (bound_name.port == 0)
+	    bound_name.port = pj_sockaddr_get_port(&bound_addr);
+    } else {
+	/* Address name is not specified. 
+	 * Build a name based on bound address.
+	 */
+	status = get_published_name(sock[0], addr_buf, sizeof(addr_buf), 
+				    &bound_name);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
+
+    type = (cfg->af==pj_AF_INET6()) ? PJSIP_TRANSPORT_UDP6 :
+				      PJSIP_TRANSPORT_UDP;
+    return transport_attach(endpt, type, sock[0], &bound_name, cfg->async_cnt,
+			    &sock[1], shard_cnt-1, p_transport);
+
+on_error:
+    for (i=0; i<sock_cnt; ++i)
+	pj_sock_close(sock[i]);
+    return status;
+}
+
 /*
  * Retrieve the internal socket handle used by the UDP transport.
  */
@@ -951,6 +1276,9 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_pause(pjsip_transport *transport,
 
     tp = (struct udp_transport*) transport;
 
+    /* Sharded transport cannot be paused */
+    PJ_ASSERT_RETURN(tp->shard_cnt == 0, PJ_EINVALIDOP);
+
     /* Transport must not have been paused */
     PJ_ASSERT_RETURN(tp->is_paused==0, PJ_EINVALIDOP);
 
@@ -1013,6 +1341,9 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_restart(pjsip_transport *transport,
 
     tp = (struct udp_transport*) transport;
 
+    /* Sharded transport cannot be restarted */
+    PJ_ASSERT_RETURN(tp->shard_cnt == 0, PJ_EINVALIDOP);
+
     if (option & PJSIP_UDP_TRANSPORT_DESTROY_SOCKET) {
 	char addr_buf[PJ_INET6_ADDRSTRLEN];
 	pjsip_host_port bound_name;
@@ -1036,7 +1367,7 @@ PJ_DEF(pj_status_t) pjsip_udp_transport_restart(pjsip_transport *transport,
 	/* Create the socket if it's not specified */
 	if (sock == PJ_INVALID_SOCKET) {
 	    status = create_socket(pj_AF_INET(), local, 
-				   sizeof(pj_sockaddr_in), &sock);
+				   sizeof(pj_sockaddr_in), PJ_FALSE, &sock);
 	    if (status != PJ_SUCCESS)
 		return status;
 	}
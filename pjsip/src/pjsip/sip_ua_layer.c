@@ -122,7 +122,12 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
     if (status != PJ_SUCCESS)
 	return status;
 
+#if PJSIP_RESIZABLE_HTABLE
+    mod_ua.dlg_table = pj_hash_create_resizable(mod_ua.pool,
+						PJSIP_MAX_DIALOG_COUNT);
+#else
     mod_ua.dlg_table = pj_hash_create(mod_ua.pool, PJSIP_MAX_DIALOG_COUNT);
+#endif
     if (mod_ua.dlg_table == NULL)
 	return PJ_ENOMEM;
 
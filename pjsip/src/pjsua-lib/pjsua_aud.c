@@ -1663,6 +1663,10 @@ static pj_status_t open_snd_dev(pjmedia_snd_port_param *param)
 	      1000 / param->base.clock_rate));
     pj_log_push_indent();
 
+    /* The sound device threads drive the conference bridge. */
+    pj_memcpy(&param->thread_sched, &pjsua_var.media_cfg.snd_thread_sched,
+	      sizeof(param->thread_sched));
+
     status = pjmedia_snd_port_create2( pjsua_var.snd_pool,
 				       param, &pjsua_var.snd_port);
     if (status != PJ_SUCCESS)
@@ -2002,6 +2006,10 @@ PJ_DEF(pj_status_t) pjsua_set_null_snd_dev(void)
 	return status;
     }
 
+    /* The master port clock thread drives the conference bridge. */
+    pjmedia_master_port_set_thread_sched(pjsua_var.null_snd,
+				&pjsua_var.media_cfg.snd_thread_sched);
+
     /* Start the master port */
     status = pjmedia_master_port_start(pjsua_var.null_snd);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
@@ -104,6 +104,7 @@ PJ_DEF(void) pjsua_config_default(pjsua_config *cfg)
 
     cfg->max_calls = ((PJSUA_MAX_CALLS) < 4) ? (PJSUA_MAX_CALLS) : 4;
     cfg->thread_cnt = 1;
+    pj_thread_sched_param_default(&cfg->thread_sched);
     cfg->nat_type_in_sdp = 1;
     cfg->stun_ignore_failure = PJ_TRUE;
     cfg->force_lr = PJ_TRUE;
@@ -331,6 +332,8 @@ PJ_DEF(void) pjsua_media_config_default(pjsua_media_config *cfg)
     cfg->max_media_ports = PJSUA_MAX_CONF_PORTS;
     cfg->has_ioqueue = PJ_TRUE;
     cfg->thread_cnt = 1;
+    pj_thread_sched_param_default(&cfg->thread_sched);
+    pj_thread_sched_param_default(&cfg->snd_thread_sched);
     cfg->quality = PJSUA_DEFAULT_CODEC_QUALITY;
     cfg->ilbc_mode = PJSUA_DEFAULT_ILBC_MODE;
     cfg->ec_tail_len = PJSUA_DEFAULT_EC_TAIL_LEN;
@@ -1108,6 +1111,9 @@ PJ_DEF(pj_status_t) pjsua_init( const pjsua_config *ua_cfg,
 				      NULL, 0, 0, &pjsua_var.thread[i]);
 	    if (status != PJ_SUCCESS)
 		goto on_error;
+
+	    pjsua_set_thread_sched(pjsua_var.thread[i],
+				   &pjsua_var.ua_cfg.thread_sched, i);
 	}
 	PJ_LOG(4,(THIS_FILE, "%d SIP worker threads created", 
 		  pjsua_var.ua_cfg.thread_cnt));
@@ -1764,6 +1770,27 @@ void pjsua_set_state(pjsua_state new_state)
 	      state_name[old_state], state_name[new_state]));
 }
 
+void pjsua_set_thread_sched(pj_thread_t *thread,
+			    const pj_thread_sched_param *param,
+			    unsigned index)
+{
+    pj_thread_sched_param prm;
+    pj_status_t status;
+
+    if (!param->use_affinity && param->policy == PJ_THREAD_SCHED_DEFAULT)
+	return;
+
+    pj_memcpy(&prm, param, sizeof(prm));
+    if (prm.use_affinity)
+	prm.cpu += index;
+
+    status = pj_thread_set_sched_param(thread, &prm);
+    if (status != PJ_SUCCESS) {
+	pjsua_perror(THIS_FILE, "Unable to set thread affinity/scheduling",
+		     status);
+    }
+}
+
 /* Get state */
 PJ_DEF(pjsua_state) pjsua_get_state(void)
 {
@@ -2979,6 +3006,9 @@ PJ_DEF(void) pjsua_dump(pj_bool_t detail)
 
     pjmedia_endpt_dump(pjsua_get_pjmedia_endpt());
 
+    if (detail)
+	pj_grp_lock_dump_stat(0);
+
     PJ_LOG(3,(THIS_FILE, "Dumping media transports:"));
     for (i=0; i<pjsua_var.ua_cfg.max_calls; ++i) {
 	pjsua_call *call = &pjsua_var.calls[i];
@@ -44,6 +44,7 @@ static void pjsua_media_config_dup(pj_pool_t *pool,
  */
 pj_status_t pjsua_media_subsys_init(const pjsua_media_config *cfg)
 {
+    unsigned i;
     pj_status_t status;
 
     pj_log_push_indent();
@@ -89,6 +90,13 @@ pj_status_t pjsua_media_subsys_init(const pjsua_media_config *cfg)
 	goto on_error;
     }
 
+    /* Apply the thread settings to the media worker threads. */
+    for (i=0; i<pjmedia_endpt_get_thread_count(pjsua_var.med_endpt); ++i) {
+	pj_thread_t *thread = pjmedia_endpt_get_thread(pjsua_var.med_endpt, i);
+
+	pjsua_set_thread_sched(thread, &pjsua_var.media_cfg.thread_sched, i);
+    }
+
     status = pjsua_aud_subsys_init();
     if (status != PJ_SUCCESS)
 	goto on_error;
@@ -325,6 +325,10 @@ int test_main(void)
     DO_TEST(transport_tcp_test());
 #endif
 
+#if INCLUDE_SHARD_TEST
+    DO_TEST(transport_shard_test());
+#endif
+
 #if INCLUDE_RESOLVE_TEST
     DO_TEST(resolve_test());
 #endif
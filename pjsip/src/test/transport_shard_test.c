@@ -0,0 +1,347 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include <pjsip.h>
+#include <pjlib.h>
+
+#define THIS_FILE   "transport_shard_test.c"
+
+/*
+ * Test for transports which are sharded with SO_REUSEPORT: several
+ * clients send a request to the loopback address of the transport, and
+ * the requests must all be received, by more than one worker thread of
+ * the endpoint.
+ */
+
+#define SHARD_CNT	4
+#define CLIENT_CNT	16
+#define CALL_ID_PREFIX	"shard-test-"
+#define WAIT_MSEC	5000
+
+static struct
+{
+    pj_mutex_t	    *mutex;
+    pj_thread_t	    *main_thread;
+    unsigned	     rx_cnt;
+    pj_bool_t	     rx_on_main;
+    unsigned	     thread_cnt;
+    pj_thread_t	    *thread[CLIENT_CNT];
+} shard_test;
+
+static pj_bool_t shard_on_rx_request(pjsip_rx_data *rdata);
+
+static pjsip_module shard_module =
+{
+    NULL, NULL,				/* prev and next	*/
+    { "Transport-Shard-Test", 20},	/* Name.		*/
+    -1,					/* Id			*/
+    PJSIP_MOD_PRIORITY_TSX_LAYER-1,	/* Priority		*/
+    NULL,				/* load()		*/
+    NULL,				/* start()		*/
+    NULL,				/* stop()		*/
+    NULL,				/* unload()		*/
+    &shard_on_rx_request,		/* on_rx_request()	*/
+    NULL,				/* on_rx_response()	*/
+    NULL,				/* on_tsx_state()	*/
+};
+
+
+static pj_bool_t shard_on_rx_request(pjsip_rx_data *rdata)
+{
+    pj_str_t prefix = pj_str(CALL_ID_PREFIX);
+    pj_thread_t *this_thread = pj_thread_this();
+    unsigned i;
+
+    /* Check that this is our request. */
+    if (pj_strncmp(&rdata->msg_info.cid->id, &prefix, prefix.slen) != 0)
+	return PJ_FALSE;
+
+    pj_mutex_lock(shard_test.mutex);
+
+    ++shard_test.rx_cnt;
+    if (this_thread == shard_test.main_thread)
+	shard_test.rx_on_main = PJ_TRUE;
+
+    for (i=0; i<shard_test.thread_cnt; ++i) {
+	if (shard_test.thread[i] == this_thread)
+	    break;
+    }
+    if (i == shard_test.thread_cnt && i < PJ_ARRAY_SIZE(shard_test.thread))
+	shard_test.thread[shard_test.thread_cnt++] = this_thread;
+
+    pj_mutex_unlock(shard_test.mutex);
+
+    return PJ_TRUE;
+}
+
+
+/* Build the request of the specified client. */
+static int build_request(char *buf, int len, const char *tp_name,
+			 unsigned client)
+{
+    return pj_ansi_snprintf(buf, len,
+			    "OPTIONS sip:shard@127.0.0.1 SIP/2.0\r\n"
+			    "Via: SIP/2.0/%s 127.0.0.1:5060;"
+			    "branch=z9hG4bKshard%u\r\n"
+			    "From: <sip:client@127.0.0.1>;tag=%u\r\n"
+			    "To: <sip:shard@127.0.0.1>\r\n"
+			    "Call-ID: " CALL_ID_PREFIX "%s-%u\r\n"
+			    "CSeq: 1 OPTIONS\r\n"
+			    "Content-Length: 0\r\n"
+			    "\r\n",
+			    tp_name, client, client, tp_name, client);
+}
+
+
+/* Wait until all requests have been received, and check them. */
+static int check_rx(const char *tp_name)
+{
+    unsigned i;
+
+    for (i=0; i<WAIT_MSEC/10 && shard_test.rx_cnt < CLIENT_CNT; ++i)
+	flush_events(10);
+
+    PJ_LOG(3,(THIS_FILE, "   %s: %u of %u requests received by %u threads",
+	      tp_name, shard_test.rx_cnt, CLIENT_CNT, shard_test.thread_cnt));
+
+    if (shard_test.rx_cnt != CLIENT_CNT)
+	return -10;
+
+    /* The sockets are polled by the worker ioqueues of the endpoint. */
+    if (shard_test.rx_on_main)
+	return -20;
+
+    /* The requests are spread among the sockets. */
+    if (shard_test.thread_cnt < 2)
+	return -30;
+
+    return 0;
+}
+
+
+static void reset_rx(void)
+{
+    shard_test.rx_cnt = 0;
+    shard_test.rx_on_main = PJ_FALSE;
+    shard_test.thread_cnt = 0;
+}
+
+
+static int udp_shard_test(void)
+{
+    pjsip_udp_transport_cfg cfg;
+    pjsip_transport *udp_tp;
+    pj_sock_t client[CLIENT_CNT];
+    pj_str_t s;
+    unsigned i;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  UDP with %d sockets", SHARD_CNT));
+
+    for (i=0; i<CLIENT_CNT; ++i)
+	client[i] = PJ_INVALID_SOCKET;
+
+    pjsip_udp_transport_cfg_default(&cfg, pj_AF_INET());
+    pj_sockaddr_init(pj_AF_INET(), &cfg.bind_addr,
+		     pj_cstr(&s, "127.0.0.1"), 0);
+    cfg.shard_cnt = SHARD_CNT;
+
+    status = pjsip_udp_transport_start2(endpt, &cfg, &udp_tp);
+    if (status != PJ_SUCCESS) {
+	app_perror("   Error: unable to start sharded UDP transport", status);
+	return -100;
+    }
+
+    reset_rx();
+
+    /* Each client sends from its own port. */
+    for (i=0; i<CLIENT_CNT; ++i) {
+	char pkt[512];
+	pj_ssize_t len;
+
+	status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &client[i]);
+	if (status != PJ_SUCCESS) {
+	    rc = -110;
+	    goto on_return;
+	}
+
+	len = build_request(pkt, sizeof(pkt), "UDP", i);
+	status = pj_sock_sendto(client[i], pkt, &len, 0,
+				&udp_tp->local_addr,
+				pj_sockaddr_get_len(&udp_tp->local_addr));
+	if (status != PJ_SUCCESS) {
+	    app_perror("   Error: sendto() error", status);
+	    rc = -120;
+	    goto on_return;
+	}
+    }
+
+    rc = check_rx("UDP");
+    if (rc != 0)
+	rc -= 100;
+
+on_return:
+    for (i=0; i<CLIENT_CNT; ++i) {
+	if (client[i] != PJ_INVALID_SOCKET)
+	    pj_sock_close(client[i]);
+    }
+
+    /* Destroy the transport. */
+    pjsip_transport_dec_ref(udp_tp);
+    status = pjsip_transport_destroy(udp_tp);
+    if (status != PJ_SUCCESS && rc == 0)
+	rc = -190;
+
+    return rc;
+}
+
+
+#if PJ_HAS_TCP
+static int tcp_shard_test(void)
+{
+    pjsip_tcp_transport_cfg cfg;
+    pjsip_tpfactory *tpfactory;
+    pj_sock_t client[CLIENT_CNT];
+    pj_sockaddr lis_addr;
+    pj_str_t s;
+    unsigned i;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  TCP with %d listener sockets", SHARD_CNT));
+
+    for (i=0; i<CLIENT_CNT; ++i)
+	client[i] = PJ_INVALID_SOCKET;
+
+    pjsip_tcp_transport_cfg_default(&cfg, pj_AF_INET());
+    pj_sockaddr_init(pj_AF_INET(), &cfg.bind_addr,
+		     pj_cstr(&s, "127.0.0.1"), 0);
+    cfg.shard_cnt = SHARD_CNT;
+
+    status = pjsip_tcp_transport_start3(endpt, &cfg, &tpfactory);
+    if (status != PJ_SUCCESS) {
+	app_perror("   Error: unable to start sharded TCP listener", status);
+	return -200;
+    }
+
+    pj_sockaddr_init(pj_AF_INET(), &lis_addr, &tpfactory->addr_name.host,
+		     (pj_uint16_t)tpfactory->addr_name.port);
+
+    reset_rx();
+
+    /* Each client sends on its own connection. */
+    for (i=0; i<CLIENT_CNT; ++i) {
+	char pkt[512];
+	pj_ssize_t len;
+
+	status = pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0,
+				&client[i]);
+	if (status != PJ_SUCCESS) {
+	    rc = -210;
+	    goto on_return;
+	}
+
+	status = pj_sock_connect(client[i], &lis_addr,
+				 pj_sockaddr_get_len(&lis_addr));
+	if (status != PJ_SUCCESS) {
+	    app_perror("   Error: connect() error", status);
+	    rc = -220;
+	    goto on_return;
+	}
+
+	len = build_request(pkt, sizeof(pkt), "TCP", i);
+	status = pj_sock_send(client[i], pkt, &len, 0);
+	if (status != PJ_SUCCESS) {
+	    app_perror("   Error: send() error", status);
+	    rc = -230;
+	    goto on_return;
+	}
+    }
+
+    rc = check_rx("TCP");
+    if (rc != 0)
+	rc -= 200;
+
+on_return:
+    /* Closing the connections shuts down the server transports. */
+    for (i=0; i<CLIENT_CNT; ++i) {
+	if (client[i] != PJ_INVALID_SOCKET)
+	    pj_sock_close(client[i]);
+    }
+    flush_events(500);
+
+    /* Destroy the listener. */
+    tpfactory->destroy(tpfactory);
+
+    return rc;
+}
+#endif	/* PJ_HAS_TCP */
+
+
+int transport_shard_test(void)
+{
+    pj_pool_t *pool;
+    pj_status_t status;
+    int rc;
+
+    if (pj_SO_REUSEPORT() == 0xFFFF) {
+	PJ_LOG(3,(THIS_FILE, "  SO_REUSEPORT is not supported, skipped"));
+	return 0;
+    }
+
+    pool = pjsip_endpt_create_pool(endpt, "shardtest", 512, 512);
+    if (!pool)
+	return -1;
+
+    status = pj_mutex_create_simple(pool, "shardtest", &shard_test.mutex);
+    if (status != PJ_SUCCESS) {
+	pjsip_endpt_release_pool(endpt, pool);
+	return -2;
+    }
+
+    shard_test.main_thread = pj_thread_this();
+
+    status = pjsip_endpt_register_module(endpt, &shard_module);
+    if (status != PJ_SUCCESS) {
+	app_perror("   Error: unable to register module", status);
+	rc = -3;
+	goto on_return;
+    }
+
+    rc = udp_shard_test();
+
+#if PJ_HAS_TCP
+    if (rc == 0)
+	rc = tcp_shard_test();
+#endif
+
+    pjsip_endpt_unregister_module(endpt, &shard_module);
+
+    /* Flush events. */
+    flush_events(500);
+
+on_return:
+    pj_mutex_destroy(shard_test.mutex);
+    shard_test.mutex = NULL;
+    pjsip_endpt_release_pool(endpt, pool);
+    return rc;
+}